@@ -0,0 +1,512 @@
+/****************************************************************************/
+// Copyright SN Systems Ltd 2013
+//
+// String table reader, builder and live reload support.
+//****************************************************************************/
+
+#include "StringTable.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define STRING_TABLE_MAX_DISPLACEMENT	(1u << 24)
+
+//****************************************************************************
+// StringTable
+//****************************************************************************
+
+StringTable::StringTable()
+: m_pHeader(NULL)
+, m_pDisplacement(NULL)
+, m_pSlots(NULL)
+, m_pStrings(NULL)
+, m_mappedSize(0)
+#if defined(_WIN32)
+, m_hMapping(NULL)
+#endif
+{
+}
+
+StringTable::~StringTable()
+{
+	Close();
+}
+
+bool StringTable::Open(const char* pszPath)
+{
+	Close();
+
+	const void* pView = NULL;
+
+#if defined(_WIN32)
+	// FILE_SHARE_DELETE lets a newer table be renamed over this one once it has been unmapped.
+	HANDLE hFile = CreateFileA(pszPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart < (LONGLONG)sizeof(StringTableHeader))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (m_hMapping == NULL)
+		return false;
+
+	pView = MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (pView == NULL)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+		return false;
+	}
+	m_mappedSize = (uint64_t)size.QuadPart;
+#else
+	int fd = open(pszPath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(StringTableHeader))
+	{
+		close(fd);
+		return false;
+	}
+
+	pView = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pView == MAP_FAILED)
+		return false;
+	m_mappedSize = (uint64_t)st.st_size;
+#endif
+
+	const char* pBase = static_cast<const char*>(pView);
+	const StringTableHeader* pHeader = reinterpret_cast<const StringTableHeader*>(pBase);
+
+	bool bValid = pHeader->magic == STRING_TABLE_MAGIC
+		&& pHeader->version == STRING_TABLE_VERSION
+		&& pHeader->fileSize == m_mappedSize
+		&& pHeader->bucketCount > 0 && pHeader->slotCount >= pHeader->count
+		&& pHeader->displacementOffset <= m_mappedSize
+		&& (uint64_t)pHeader->bucketCount * sizeof(uint32_t) <= m_mappedSize - pHeader->displacementOffset
+		&& pHeader->slotOffset <= m_mappedSize
+		&& (uint64_t)pHeader->slotCount * sizeof(StringTableSlot) <= m_mappedSize - pHeader->slotOffset
+		&& pHeader->stringOffset <= m_mappedSize
+		&& pHeader->stringSize <= m_mappedSize - pHeader->stringOffset;
+
+	m_pHeader = pHeader;
+	if (!bValid)
+	{
+		Close();
+		return false;
+	}
+
+	m_pDisplacement = reinterpret_cast<const uint32_t*>(pBase + pHeader->displacementOffset);
+	m_pSlots = reinterpret_cast<const StringTableSlot*>(pBase + pHeader->slotOffset);
+	m_pStrings = pBase + pHeader->stringOffset;
+
+	return true;
+}
+
+void StringTable::Close()
+{
+	if (m_pHeader)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(m_pHeader);
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+#else
+		munmap(const_cast<StringTableHeader*>(m_pHeader), (size_t)m_mappedSize);
+#endif
+	}
+
+	m_pHeader = NULL;
+	m_pDisplacement = NULL;
+	m_pSlots = NULL;
+	m_pStrings = NULL;
+	m_mappedSize = 0;
+}
+
+bool StringTable::GetSlotId(uint32_t slot, uint32_t& id) const
+{
+	if (!m_pHeader || slot >= m_pHeader->slotCount || m_pSlots[slot].length == STRING_TABLE_EMPTY)
+		return false;
+
+	id = m_pSlots[slot].id;
+	return true;
+}
+
+//****************************************************************************
+// StringTableBuilder
+//****************************************************************************
+
+void StringTableBuilder::Add(uint32_t id, const char* pszString, uint32_t length)
+{
+	Entry entry;
+	entry.id = id;
+	entry.length = length;
+	entry.offset = m_strings.size();
+	m_entries.push_back(entry);
+
+	m_strings.insert(m_strings.end(), pszString, pszString + length);
+	m_strings.push_back('\0');
+}
+
+bool StringTableBuilder::AddFromFile(const char* pszPath, std::string& error)
+{
+	// One string per line: "<id> <text>", where the text runs to the end of the line.
+	FILE* fp = fopen(pszPath, "rb");
+	if (!fp)
+	{
+		error = std::string("Cannot open ") + pszPath;
+		return false;
+	}
+
+	std::string line;
+	unsigned lineNumber = 0;
+	bool bOK = true;
+
+	for (;;)
+	{
+		int c = fgetc(fp);
+		if (c != EOF && c != '\n')
+		{
+			line += (char)c;
+			continue;
+		}
+
+		++lineNumber;
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.erase(line.size() - 1);
+
+		if (!line.empty() && line[0] != '#')
+		{
+			char* pEnd = NULL;
+			unsigned long id = strtoul(line.c_str(), &pEnd, 0);
+			if (pEnd == line.c_str() || (*pEnd != ' ' && *pEnd != '\t' && *pEnd != '\0'))
+			{
+				char msg[64];
+				sprintf(msg, "Bad string ID on line %u", lineNumber);
+				error = msg;
+				bOK = false;
+				break;
+			}
+
+			if (*pEnd != '\0')
+				++pEnd;
+			Add((uint32_t)id, pEnd, (uint32_t)strlen(pEnd));
+		}
+
+		line.clear();
+		if (c == EOF)
+			break;
+	}
+
+	fclose(fp);
+	return bOK;
+}
+
+bool StringTableBuilder::Write(const char* pszPath, std::string& error)
+{
+	const uint32_t count = (uint32_t)m_entries.size();
+
+	std::vector<uint32_t> ids(count);
+	for (uint32_t i = 0; i < count; ++i)
+		ids[i] = m_entries[i].id;
+	std::sort(ids.begin(), ids.end());
+	std::vector<uint32_t>::iterator dup = std::adjacent_find(ids.begin(), ids.end());
+	if (dup != ids.end())
+	{
+		char msg[64];
+		sprintf(msg, "Duplicate string ID %u", *dup);
+		error = msg;
+		return false;
+	}
+
+	// About four keys per bucket and 80% slot occupancy keeps the
+	// displacement search short while the index stays small.
+	StringTableHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = STRING_TABLE_MAGIC;
+	header.version = STRING_TABLE_VERSION;
+	header.count = count;
+	header.bucketCount = count / 4 + 1;
+	header.slotCount = count + count / 4 + 1;
+
+	std::vector<uint32_t> displacement(header.bucketCount, 0);
+	std::vector<StringTableSlot> slots(header.slotCount);
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		slots[i].id = 0;
+		slots[i].length = STRING_TABLE_EMPTY;
+		slots[i].offset = 0;
+	}
+
+	// Order entries by bucket, then place the largest buckets first.
+	std::vector< std::pair<uint32_t, uint32_t> > byBucket(count);
+	for (uint32_t i = 0; i < count; ++i)
+		byBucket[i] = std::make_pair(StringTableBucket(m_entries[i].id, header.bucketCount), i);
+	std::sort(byBucket.begin(), byBucket.end());
+
+	std::vector< std::pair<uint32_t, uint32_t> > buckets;	// (size, first index into byBucket)
+	for (uint32_t i = 0; i < count; )
+	{
+		uint32_t j = i;
+		while (j < count && byBucket[j].first == byBucket[i].first)
+			++j;
+		buckets.push_back(std::make_pair(j - i, i));
+		i = j;
+	}
+	std::sort(buckets.begin(), buckets.end(), std::greater< std::pair<uint32_t, uint32_t> >());
+
+	std::vector<uint32_t> positions;
+	for (size_t b = 0; b < buckets.size(); ++b)
+	{
+		const uint32_t size = buckets[b].first;
+		const uint32_t first = buckets[b].second;
+		const uint32_t bucket = byBucket[first].first;
+
+		uint32_t d = 0;
+		for (; d < STRING_TABLE_MAX_DISPLACEMENT; ++d)
+		{
+			positions.clear();
+			bool bFits = true;
+
+			for (uint32_t k = 0; k < size && bFits; ++k)
+			{
+				const Entry& entry = m_entries[byBucket[first + k].second];
+				uint32_t pos = StringTableSlotIndex(entry.id, d, header.slotCount);
+
+				if (slots[pos].length != STRING_TABLE_EMPTY
+					|| std::find(positions.begin(), positions.end(), pos) != positions.end())
+				{
+					bFits = false;
+				}
+				positions.push_back(pos);
+			}
+
+			if (bFits)
+				break;
+		}
+
+		if (d == STRING_TABLE_MAX_DISPLACEMENT)
+		{
+			error = "Failed to build string index";
+			return false;
+		}
+
+		displacement[bucket] = d;
+		for (uint32_t k = 0; k < size; ++k)
+		{
+			const Entry& entry = m_entries[byBucket[first + k].second];
+			StringTableSlot& slot = slots[positions[k]];
+			slot.id = entry.id;
+			slot.length = entry.length;
+			slot.offset = entry.offset;
+		}
+	}
+
+	header.displacementOffset = sizeof(header);
+	header.slotOffset = (header.displacementOffset + displacement.size() * sizeof(uint32_t) + 15) & ~(uint64_t)15;
+	header.stringOffset = header.slotOffset + slots.size() * sizeof(StringTableSlot);
+	header.stringSize = m_strings.size();
+	header.fileSize = header.stringOffset + header.stringSize;
+
+	FILE* fp = fopen(pszPath, "wb");
+	if (!fp)
+	{
+		error = std::string("Cannot create ") + pszPath;
+		return false;
+	}
+
+	static const char padding[16] = { 0 };
+	size_t padSize = (size_t)(header.slotOffset - header.displacementOffset - displacement.size() * sizeof(uint32_t));
+
+	bool bOK = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(&displacement[0], sizeof(uint32_t), displacement.size(), fp) == displacement.size()
+		&& fwrite(padding, 1, padSize, fp) == padSize
+		&& fwrite(&slots[0], sizeof(StringTableSlot), slots.size(), fp) == slots.size()
+		&& (m_strings.empty() || fwrite(&m_strings[0], 1, m_strings.size(), fp) == m_strings.size());
+
+	if (fclose(fp) != 0 || !bOK)
+	{
+		error = std::string("Failed writing ") + pszPath;
+		remove(pszPath);
+		return false;
+	}
+
+	return true;
+}
+
+//****************************************************************************
+// LiveStringTable
+//****************************************************************************
+
+LiveStringTable::LiveStringTable()
+: m_pCurrent(NULL)
+, m_currentReaders(0)
+{
+#if defined(_WIN32)
+	InitializeCriticalSection(&m_lock);
+#else
+	pthread_mutex_init(&m_lock, NULL);
+#endif
+}
+
+LiveStringTable::~LiveStringTable()
+{
+	delete m_pCurrent;
+	for (size_t i = 0; i < m_retired.size(); ++i)
+		delete m_retired[i].pTable;
+
+#if defined(_WIN32)
+	DeleteCriticalSection(&m_lock);
+#else
+	pthread_mutex_destroy(&m_lock);
+#endif
+}
+
+void LiveStringTable::Lock()
+{
+#if defined(_WIN32)
+	EnterCriticalSection(&m_lock);
+#else
+	pthread_mutex_lock(&m_lock);
+#endif
+}
+
+void LiveStringTable::Unlock()
+{
+#if defined(_WIN32)
+	LeaveCriticalSection(&m_lock);
+#else
+	pthread_mutex_unlock(&m_lock);
+#endif
+}
+
+const StringTable* LiveStringTable::Acquire()
+{
+	Lock();
+	const StringTable* pTable = m_pCurrent;
+	if (pTable)
+		++m_currentReaders;
+	Unlock();
+	return pTable;
+}
+
+void LiveStringTable::Release(const StringTable* pTable)
+{
+	if (!pTable)
+		return;
+
+	Lock();
+	if (pTable == m_pCurrent)
+	{
+		--m_currentReaders;
+	}
+	else
+	{
+		for (size_t i = 0; i < m_retired.size(); ++i)
+		{
+			if (m_retired[i].pTable == pTable)
+			{
+				--m_retired[i].readers;
+				break;
+			}
+		}
+	}
+	Unlock();
+}
+
+void LiveStringTable::Replace(StringTable* pTable)
+{
+	Lock();
+	if (m_pCurrent)
+	{
+		Generation old;
+		old.pTable = m_pCurrent;
+		old.readers = m_currentReaders;
+		m_retired.push_back(old);
+	}
+	m_pCurrent = pTable;
+	m_currentReaders = 0;
+	Unlock();
+
+	ReleaseRetired();
+}
+
+void LiveStringTable::ReleaseRetired()
+{
+	std::vector<StringTable*> unused;
+
+	Lock();
+	for (size_t i = 0; i < m_retired.size(); )
+	{
+		if (m_retired[i].readers == 0)
+		{
+			unused.push_back(m_retired[i].pTable);
+			m_retired.erase(m_retired.begin() + i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	Unlock();
+
+	for (size_t i = 0; i < unused.size(); ++i)
+		delete unused[i];
+}
+
+bool LiveStringTable::ReloadIfPublished(const char* pszPath)
+{
+	ReleaseRetired();
+
+	std::string published = std::string(pszPath) + ".new";
+
+	StringTable* pTable = new StringTable;
+	if (!pTable->Open(published.c_str()))
+	{
+		delete pTable;
+		return false;
+	}
+
+	Replace(pTable);
+
+	// The previous table has to be unmapped before it can be replaced on disk.
+	for (;;)
+	{
+		Lock();
+		bool bIdle = m_retired.empty();
+		Unlock();
+		if (bIdle)
+			break;
+
+#if defined(_WIN32)
+		Sleep(1);
+#else
+		usleep(1000);
+#endif
+		ReleaseRetired();
+	}
+
+#if defined(_WIN32)
+	MoveFileExA(published.c_str(), pszPath, MOVEFILE_REPLACE_EXISTING);
+#else
+	rename(published.c_str(), pszPath);
+#endif
+
+	return true;
+}
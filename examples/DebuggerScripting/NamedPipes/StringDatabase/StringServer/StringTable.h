@@ -0,0 +1,184 @@
+/****************************************************************************/
+// Copyright SN Systems Ltd 2013
+//
+// Packed string table: string IDs resolved through a memory-mapped file with
+// a hash-and-displace perfect hash index. A lookup hashes the ID twice and
+// reads one slot, so it is O(1) and never allocates.
+//****************************************************************************/
+
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define STRING_TABLE_MAGIC		(0x31425453)	// 'STB1'
+#define STRING_TABLE_VERSION	(1)
+#define STRING_TABLE_EMPTY		(0xFFFFFFFF)
+
+// On-disk layout, host byte order:
+//   StringTableHeader
+//   uint32_t				displacement[bucketCount]
+//   StringTableSlot		slots[slotCount]
+//   char					strings[stringSize]	(each NUL terminated)
+struct StringTableHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	count;
+	uint32_t	bucketCount;
+	uint32_t	slotCount;
+	uint32_t	reserved;
+	uint64_t	displacementOffset;
+	uint64_t	slotOffset;
+	uint64_t	stringOffset;
+	uint64_t	stringSize;
+	uint64_t	fileSize;
+};
+
+struct StringTableSlot
+{
+	uint32_t	id;
+	uint32_t	length;		// STRING_TABLE_EMPTY for unused slots
+	uint64_t	offset;		// Into the string area
+};
+
+class StringTable
+{
+public:
+					StringTable();
+					~StringTable();
+
+	bool			Open(const char* pszPath);
+	void			Close();
+	bool			IsOpen() const { return m_pHeader != NULL; }
+	uint32_t		GetCount() const { return m_pHeader ? m_pHeader->count : 0; }
+
+	// Returns the ID stored in a slot, for enumerating the table.
+	bool			GetSlotId(uint32_t slot, uint32_t& id) const;
+	uint32_t		GetSlotCount() const { return m_pHeader ? m_pHeader->slotCount : 0; }
+
+	inline bool		Lookup(uint32_t id, const char*& pszString, uint32_t& length) const;
+
+private:
+					StringTable(const StringTable&);
+	StringTable&	operator=(const StringTable&);
+
+	const StringTableHeader*	m_pHeader;
+	const uint32_t*				m_pDisplacement;
+	const StringTableSlot*		m_pSlots;
+	const char*					m_pStrings;
+	uint64_t					m_mappedSize;
+#if defined(_WIN32)
+	HANDLE						m_hMapping;
+#endif
+};
+
+class StringTableBuilder
+{
+public:
+	void			Add(uint32_t id, const char* pszString, uint32_t length);
+	bool			AddFromFile(const char* pszPath, std::string& error);
+	size_t			GetCount() const { return m_entries.size(); }
+
+	// Writes the table to pszPath. Fails on duplicate IDs.
+	bool			Write(const char* pszPath, std::string& error);
+
+private:
+	struct Entry
+	{
+		uint32_t	id;
+		uint32_t	length;
+		uint64_t	offset;
+	};
+
+	std::vector<Entry>	m_entries;
+	std::vector<char>	m_strings;
+};
+
+// Current table shared between request threads. Replace() swaps in a newly
+// opened table; the old one is unmapped once the last reader releases it,
+// so clients are never stopped for a reload.
+class LiveStringTable
+{
+public:
+					LiveStringTable();
+					~LiveStringTable();
+
+	const StringTable*	Acquire();
+	void				Release(const StringTable* pTable);
+	void				Replace(StringTable* pTable);
+
+	// Reloads from "<path>.new" if it exists, then moves it over <path>.
+	bool				ReloadIfPublished(const char* pszPath);
+
+private:
+	struct Generation
+	{
+		StringTable*	pTable;
+		uint32_t		readers;
+	};
+
+	void				Lock();
+	void				Unlock();
+	void				ReleaseRetired();
+
+	StringTable*				m_pCurrent;
+	uint32_t					m_currentReaders;
+	std::vector<Generation>		m_retired;
+#if defined(_WIN32)
+	CRITICAL_SECTION			m_lock;
+#else
+	pthread_mutex_t				m_lock;
+#endif
+};
+
+// Hash functions shared by the builder and the reader.
+inline uint32_t StringTableMix(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (uint32_t)key;
+}
+
+inline uint32_t StringTableBucket(uint32_t id, uint32_t bucketCount)
+{
+	return StringTableMix(id) % bucketCount;
+}
+
+inline uint32_t StringTableSlotIndex(uint32_t id, uint32_t displacement, uint32_t slotCount)
+{
+	return StringTableMix(((uint64_t)(displacement + 1) << 32) | id) % slotCount;
+}
+
+inline bool StringTable::Lookup(uint32_t id, const char*& pszString, uint32_t& length) const
+{
+	if (!m_pHeader || m_pHeader->count == 0)
+		return false;
+
+	uint32_t bucket = StringTableBucket(id, m_pHeader->bucketCount);
+	const StringTableSlot& slot = m_pSlots[StringTableSlotIndex(id, m_pDisplacement[bucket], m_pHeader->slotCount)];
+
+	if (slot.length == STRING_TABLE_EMPTY || slot.id != id)
+		return false;
+
+	// A damaged table must not point outside its string area.
+	if (slot.offset > m_pHeader->stringSize || slot.length > m_pHeader->stringSize - slot.offset)
+		return false;
+
+	pszString = m_pStrings + slot.offset;
+	length = slot.length;
+	return true;
+}
+
+#endif
@@ -1,105 +1,328 @@
 /****************************************************************************/
 // Copyright SN Systems Ltd 2011
 //
-// String server which creates a named pipe and waits for a connection
-// from a debugger script, waits for and processes any string requests.
+// String server which creates a named pipe and waits for connections
+// from debugger scripts, then answers batches of string ID requests from
+// a memory-mapped string table.
+//
+// Usage:
+//   Server [table.stb]                    Serve the table (default strings.stb)
+//   Server -build <strings.txt> <table.stb> Pack a text file into a table
+//   Server -bench [count]                 Benchmark 1M random lookups
+//
+// Publishing a table while the server runs writes <table.stb>.new, which
+// the server picks up without disconnecting its clients.
 //****************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "StringTable.h"
+#include "StreamServer.h"
+
+#if defined(_WIN32)
 #include <Windows.h>
+#define PIPE_NAME		"\\\\.\\pipe\\MyNamedPipe"
+#define BENCH_PIPE_NAME	"\\\\.\\pipe\\StringTableBench"
+#else
+#include <unistd.h>
+#include <time.h>
+#define PIPE_NAME		"/tmp/MyNamedPipe"
+#define BENCH_PIPE_NAME	"/tmp/StringTableBench"
+#endif
+
+#define DEFAULT_TABLE		"strings.stb"
+#define RELOAD_POLL_MS		(500)
+#define BENCH_LOOKUPS		(1000000)
+#define BENCH_BATCH			(1000)
+
+// Requests are a list of big-endian 32-bit string IDs. The reply holds, for
+// each ID in order, a big-endian 32-bit length followed by the string
+// bytes, or a length of STRING_TABLE_EMPTY for unknown IDs.
+class StringRequestHandler : public StreamRequestHandler
+{
+public:
+	StringRequestHandler(LiveStringTable& live, bool bVerbose)
+		: m_live(live)
+		, m_bVerbose(bVerbose)
+	{
+	}
+
+	virtual bool OnRequest(uint32_t clientId, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& response)
+	{
+		if (size % sizeof(uint32_t))
+			return false;
+
+		const StringTable* pTable = m_live.Acquire();
+
+		for (uint32_t i = 0; i < size; i += sizeof(uint32_t))
+		{
+			uint32_t id = StreamReadLength(pData + i);
+			const char* pszString = NULL;
+			uint32_t length = STRING_TABLE_EMPTY;
+
+			if (pTable && !pTable->Lookup(id, pszString, length))
+				length = STRING_TABLE_EMPTY;
+
+			size_t pos = response.size();
+			response.resize(pos + sizeof(uint32_t));
+			StreamWriteLength(&response[pos], length);
+
+			if (length != STRING_TABLE_EMPTY)
+				response.insert(response.end(), pszString, pszString + length);
+
+			if (m_bVerbose)
+				printf("[%u] ID %u: %s\n", clientId, id, length != STRING_TABLE_EMPTY ? pszString : "<unknown>");
+		}
+
+		m_live.Release(pTable);
+		return true;
+	}
+
+	virtual void OnConnect(uint32_t clientId)
+	{
+		if (m_bVerbose)
+			printf("Success! Client %u connected\n", clientId);
+	}
+
+	virtual void OnDisconnect(uint32_t clientId)
+	{
+		if (m_bVerbose)
+			printf("Client %u disconnected\n", clientId);
+	}
+
+private:
+	LiveStringTable&	m_live;
+	bool				m_bVerbose;
+};
+
+static void SleepMs(unsigned ms)
+{
+#if defined(_WIN32)
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+static double GetSeconds()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static bool FileExists(const char* pszPath)
+{
+	FILE* fp = fopen(pszPath, "rb");
+	if (fp)
+		fclose(fp);
+	return fp != NULL;
+}
+
+// Writes the table straight to its final name the first time, and to
+// <path>.new when a table is already there so a running server can swap it in.
+static bool PublishTable(StringTableBuilder& builder, const char* pszPath)
+{
+	std::string target = pszPath;
+	if (FileExists(pszPath))
+		target += ".new";
+
+	std::string error;
+	if (!builder.Write(target.c_str(), error))
+	{
+		printf("Error: %s\n", error.c_str());
+		return false;
+	}
+
+	printf("Wrote %u strings to %s\n", (unsigned)builder.GetCount(), target.c_str());
+	return true;
+}
+
+static int BuildTable(const char* pszInput, const char* pszOutput)
+{
+	StringTableBuilder builder;
+	std::string error;
+	if (!builder.AddFromFile(pszInput, error))
+	{
+		printf("Error: %s\n", error.c_str());
+		return 0;
+	}
 
-#define BUF_SIZE 256
-#define TIME_OUT 3000
-#define NUM_INSTANCES 255
+	return PublishTable(builder, pszOutput) ? 1 : 0;
+}
 
-HANDLE hPipe; 
+static bool CreateDefaultTable(const char* pszPath)
+{
+	StringTableBuilder builder;
+	builder.Add(0, "This is ZERO!", 13);
+	builder.Add(1, "Numero Uno", 10);
+	builder.Add(2, "2 Bananas", 9);
+	builder.Add(3, "Three Elephants", 15);
+	return PublishTable(builder, pszPath);
+}
 
-int CreateAndConnect(void)
+static int Serve(const char* pszTable)
 {
-	DWORD dwError;
-	char pszPipeName[] = "\\\\.\\pipe\\MyNamedPipe";
-	hPipe = CreateNamedPipe(pszPipeName,  PIPE_ACCESS_DUPLEX | PIPE_TYPE_BYTE | PIPE_READMODE_BYTE, PIPE_NOWAIT, NUM_INSTANCES, BUF_SIZE, BUF_SIZE, TIME_OUT, NULL);
-	if (hPipe == INVALID_HANDLE_VALUE)
-	{ 
-		printf("Error creating pipe: %d \n", GetLastError());
+	if (!FileExists(pszTable) && !CreateDefaultTable(pszTable))
+		return 0;
+
+	LiveStringTable live;
+	StringTable* pTable = new StringTable;
+	if (!pTable->Open(pszTable))
+	{
+		printf("Error opening string table %s\n", pszTable);
+		delete pTable;
+		return 0;
+	}
+	live.Replace(pTable);
+	printf("Loaded %u strings from %s\n", pTable->GetCount(), pszTable);
+
+	StringRequestHandler handler(live, true);
+	StreamServer server;
+	if (!server.Start(PIPE_NAME, &handler))
+	{
+		printf("Error creating pipe %s\n", PIPE_NAME);
 		return 0;
 	}
 
-	printf("Connect to Named Pipe\n");
+	printf("Listening on %s\n", PIPE_NAME);
 
-	while (!ConnectNamedPipe(hPipe, NULL))
+	for (;;)
 	{
-		dwError = GetLastError();
-		if (dwError == ERROR_PIPE_CONNECTED)
-		{
-			printf("Success! There is a process connected\n");
-			return 1;
-		}
+		SleepMs(RELOAD_POLL_MS);
 
-		if (dwError != ERROR_PIPE_LISTENING)
+		if (live.ReloadIfPublished(pszTable))
 		{
-			printf("Connect Error: 0x%x\n", dwError);
-			return 0;
+			const StringTable* pCurrent = live.Acquire();
+			printf("Reloaded %u strings from %s\n", pCurrent ? pCurrent->GetCount() : 0, pszTable);
+			live.Release(pCurrent);
 		}
 	}
 
-	return 0;
+	return 1;
 }
 
-int main(int argc, char *argv[])
+static int Benchmark(uint32_t count)
 {
-	DWORD nBytesRead, dwError;
-	if(!CreateAndConnect())
+	const char* pszPath = "StringTableBench.stb";
+
+	printf("Building %u strings...\n", count);
+
+	StringTableBuilder builder;
+	char buffer[64];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		// Odd multiplier, so the IDs are unique but sparse.
+		uint32_t id = i * 2654435761u;
+		int length = sprintf(buffer, "String %u for ID %u", i, id);
+		builder.Add(id, buffer, (uint32_t)length);
+	}
+
+	double start = GetSeconds();
+	std::string error;
+	if (!builder.Write(pszPath, error))
+	{
+		printf("Error: %s\n", error.c_str());
 		return 0;
+	}
+	printf("Build: %.2f s\n", GetSeconds() - start);
 
-	while(1)
+	StringTable* pTable = new StringTable;
+	if (!pTable->Open(pszPath))
 	{
-		char pInBuffer[BUF_SIZE];
-		char pOutBuffer[BUF_SIZE];
+		printf("Error opening %s\n", pszPath);
+		delete pTable;
+		return 0;
+	}
+
+	std::vector<uint32_t> ids(BENCH_LOOKUPS);
+	srand(1234);
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		uint32_t index = (((uint32_t)rand() << 15) ^ (uint32_t)rand()) % count;
+		ids[i] = index * 2654435761u;
+	}
 
-		while(!ReadFile(hPipe, pInBuffer, BUF_SIZE, &nBytesRead, NULL))
+	// Local lookups.
+	uint64_t totalLength = 0;
+	uint32_t found = 0;
+	start = GetSeconds();
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		const char* pszString;
+		uint32_t length;
+		if (pTable->Lookup(ids[i], pszString, length))
 		{
-			dwError = GetLastError();
-			if (dwError == ERROR_BROKEN_PIPE)
-			{
-				if(!CreateAndConnect())
-					return 0;
-			}
+			totalLength += length;
+			++found;
 		}
+	}
+	double elapsed = GetSeconds() - start;
+	printf("Lookup: %u of %u found, %.1f ns/lookup (%llu bytes)\n", found, (unsigned)ids.size(),
+		elapsed * 1e9 / ids.size(), (unsigned long long)totalLength);
 
-		printf("\nClient request, ID: %s", pInBuffer);
+	// The same lookups through the pipe, batched.
+	LiveStringTable live;
+	live.Replace(pTable);
 
-		int nStringID = atoi(pInBuffer);
+	StringRequestHandler handler(live, false);
+	StreamServer server;
+	StreamClient client;
+	if (!server.Start(BENCH_PIPE_NAME, &handler) || !client.Connect(BENCH_PIPE_NAME))
+	{
+		printf("Error creating pipe %s\n", BENCH_PIPE_NAME);
+		return 0;
+	}
 
-		switch(nStringID) 
+	std::vector<uint8_t> request(BENCH_BATCH * sizeof(uint32_t));
+	std::vector<uint8_t> response;
+	start = GetSeconds();
+	for (size_t i = 0; i < ids.size(); i += BENCH_BATCH)
+	{
+		for (size_t j = 0; j < BENCH_BATCH; ++j)
+			StreamWriteLength(&request[j * sizeof(uint32_t)], ids[(i + j) % ids.size()]);
+
+		if (!client.Transact(&request[0], (uint32_t)request.size(), response))
 		{
-		case 0:
-			_snprintf_s(pOutBuffer, BUF_SIZE, "%s", "This is ZERO!");
-			break;
-		case 1:
-			_snprintf_s(pOutBuffer, BUF_SIZE, "%s", "Numero Uno");
-			break;
-		case 2:
-			_snprintf_s(pOutBuffer, BUF_SIZE, "%s", "2 Bananas");
-			break;
-		case 3:
-			_snprintf_s(pOutBuffer, BUF_SIZE, "%s", "Three Elephants");
-			break;
-		default:
-			_snprintf_s(pOutBuffer, BUF_SIZE, "%s", "Huh?");
+			printf("Error: request failed\n");
+			return 0;
 		}
+	}
+	elapsed = GetSeconds() - start;
+	printf("Pipe: %u round trips of %u IDs, %.1f us/round trip, %.1f ns/lookup\n",
+		(unsigned)(ids.size() / BENCH_BATCH), BENCH_BATCH,
+		elapsed * 1e6 * BENCH_BATCH / ids.size(), elapsed * 1e9 / ids.size());
 
-		printf("\nResponding\n");
+	client.Close();
+	server.Stop();
+	return 1;
+}
 
-		DWORD dwBytesWritten;
-		if (!WriteFile(hPipe, pOutBuffer, BUF_SIZE, &dwBytesWritten, NULL))
+int main(int argc, char *argv[])
+{
+	if (argc >= 2 && strcmp(argv[1], "-build") == 0)
+	{
+		if (argc != 4)
 		{
-			dwError = GetLastError();
-			printf("\nWriting Response: 0x%x\n", dwError);
+			printf("Usage: Server -build <strings.txt> <table.stb>\n");
 			return 0;
 		}
+		return BuildTable(argv[2], argv[3]);
 	}
 
-	system("pause");
-	return 1;
-}
\ No newline at end of file
+	if (argc >= 2 && strcmp(argv[1], "-bench") == 0)
+	{
+		uint32_t count = (argc >= 3) ? (uint32_t)strtoul(argv[2], NULL, 0) : 2000000;
+		return Benchmark(count ? count : 1);
+	}
+
+	return Serve(argc >= 2 ? argv[1] : DEFAULT_TABLE);
+}
@@ -16,6 +16,7 @@
 #include <sys/interrupt.h>
 #include <sys/raw_spu.h>
 #include "raw_spu_mmio.h"
+#include "../spu_loader/overlay_cache.h"
 #include <libsn.h>
 
 extern const char _binary_spu_module_1_bin_start[];
@@ -42,6 +43,14 @@ extern const char _binary_spu_loader_elf_size[];
 #define EIEIO __asm__ volatile("eieio")
 
 #define SPU_PROG  "/app_home/spu_loader.elf"
+
+//Module ELF files by the index the spu loader calls them by, for the debugger
+static const char* const moduleFileName[] =
+{
+	"/app_home/spu_module_1.spu.elf",
+	"/app_home/spu_module_2.spu.elf",
+};
+
 #define DMA_TAG      0
 #define DMA_PUT   0x20
 #define BUF_SIZE   128  /* 128 bytes buffer */
@@ -111,6 +120,20 @@ void handle_syscall (uint64_t arg)
 			//restart the SPU
 			mmio_write_prob_reg( id, SPU_RunCntl, 0x1 );
 			break;
+		case OV_NOTIFY_STOP_CODE:
+			{
+				// the spu loader's overlay cache has loaded new module code; tell the
+				// debugger where it is and let the SPU carry on
+				const volatile OverlayNotify* notify = (const volatile OverlayNotify*)(size_t )(LS_BASE_ADDR( id ) + OV_LS_NOTIFY);
+				uint32_t module = notify->module;
+				uint32_t entry = notify->entry;
+
+				if (module < sizeof(moduleFileName) / sizeof(moduleFileName[0]))
+					snRawSPUNotifyElfLoadNoWait(id, entry, moduleFileName[module]);
+
+				mmio_write_prob_reg( id, SPU_RunCntl, 0x1 );
+			}
+			break;
 		default:
 			snRawSPUNotifySPUStopped(id);
 			break;
@@ -326,7 +349,8 @@ int main(int argc, char **argv)
 	} while ((mmio_read_prob_reg(id, Prxy_TagStatus) & tag_mask) == 0);
 
 	// Output the recv buffer. 
-	// It should contain the result from 2 spu modules in the first 4 bytes 
+	// It should contain the total of the spu module results in the first 4 bytes,
+	// the overlay cache calls, hits, misses and bytes loaded in the next 16,
 	// followed by 0xFEEDBEEF in the remaining entries.
 
 	printf("printing dma_recv_buf\n");
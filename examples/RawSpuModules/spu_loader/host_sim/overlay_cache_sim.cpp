@@ -0,0 +1,506 @@
+/*
+*  Description:
+*  Host simulation of the overlay cache (overlay_cache.h). Module call traces
+*  are replayed against fake modules in a simulated local store and main
+*  memory, and the code bytes each eviction policy fetches are compared with
+*  the offline optimum for the same number of slots, found by dynamic
+*  programming over the possible sets of resident modules.
+*
+*  Build:
+*    g++ -std=c++11 -O2 -I.. -I../../../../spu/include/sn overlay_cache_sim.cpp -o overlay_cache_sim
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+static void			sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag);
+static void			sim_notify(const uint8_t *ls_entry, uint32_t module);
+static uint32_t		sim_call(const uint8_t *ls_entry);
+
+#define OV_GET(ls, ea, size, tag)		sim_get((ls), (ea), (size), (tag))
+#define OV_WAIT(tag)					((void)(tag))
+#define OV_NOTIFY(ls, module)			sim_notify((ls), (module))
+#define OV_CALL(ls)						sim_call(ls)
+
+#include "overlay_cache.h"
+
+static const uint32_t LS_SIZE			= 256 * 1024;
+static const uint32_t SLOT_SIZE			= 16 * 1024;
+static const uint64_t EA_BASE			= 0x100000;
+static const uint32_t MAIN_SIZE			= 2 * 1024 * 1024;
+static const uint32_t MODULE_MAGIC		= 0x4f564c59;		// 'OVLY'
+static const uint32_t MARKER			= 0x534e4d48;
+static const uint32_t MAX_MODULES		= 12;
+
+// What a fake module has at its entry point.
+struct FakeCode
+{
+	uint32_t	magic;
+	uint32_t	image;			//which image this is
+	uint32_t	checksum;		//over the first code_size bytes, this field as zero
+	uint32_t	code_size;
+	uint32_t	bss_start;
+	uint32_t	bss_size;
+	uint32_t	pad[2];
+};
+
+struct Sim
+{
+	std::vector<uint8_t>	ls;
+	std::vector<uint8_t>	main;
+	uint64_t				next_ea;
+	uint64_t				dma_bytes;
+	uint32_t				notifies;
+	uint32_t				expected_image;
+	uint32_t				fresh_image;		//image just loaded, ~0 if none
+	uint32_t				errors;
+};
+
+static Sim g_sim;
+static OverlayCache g_cache;		//stands in for the loader's own local store variables
+
+static void fail(const char *message)
+{
+	printf("FAILED: %s\n", message);
+	exit(1);
+}
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("check failed: %s\n", message);
+		g_sim.errors++;
+	}
+}
+
+static uint8_t* main_at(uint64_t ea, uint32_t size)
+{
+	if (ea < EA_BASE || ea + size > EA_BASE + g_sim.main.size())
+		fail("DMA outside main memory");
+	return &g_sim.main[ea - EA_BASE];
+}
+
+static void sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag)
+{
+	uint8_t *p = (uint8_t*)ls;
+
+	(void)tag;
+	if (size == 0 || size > OV_DMA_MAX || (size & 15) || ((uintptr_t)p & 15) || (ea & 15))
+		fail("DMA size or alignment");
+	if ((p < g_sim.ls.data() || p + size > g_sim.ls.data() + g_sim.ls.size())
+		&& (p < (uint8_t*)&g_cache || p + size > (uint8_t*)(&g_cache + 1)))
+		fail("DMA outside local store");
+
+	memcpy(p, main_at(ea, size), size);
+	g_sim.dma_bytes += size;
+}
+
+static uint32_t checksum(const uint8_t *data, uint32_t size, uint32_t skip_offset)
+{
+	uint32_t sum = 2166136261u;
+	for (uint32_t i = 0; i < size; i++)
+	{
+		uint8_t byte = (i >= skip_offset && i < skip_offset + 4) ? 0 : data[i];
+		sum = (sum ^ byte) * 16777619u;
+	}
+	return sum;
+}
+
+static void sim_notify(const uint8_t *ls_entry, uint32_t module)
+{
+	FakeCode code;
+
+	(void)module;
+	memcpy(&code, ls_entry, sizeof(code));
+	if (code.magic != MODULE_MAGIC)
+		fail("notified an entry point that is not a module");
+
+	g_sim.notifies++;
+	g_sim.fresh_image = code.image;
+}
+
+static uint32_t sim_call(const uint8_t *ls_entry)
+{
+	FakeCode code;
+	const uint8_t *image;
+	uint32_t entry;
+
+	memcpy(&code, ls_entry, sizeof(code));
+	if (code.magic != MODULE_MAGIC)
+		fail("called something that is not a module");
+	if (code.image != g_sim.expected_image)
+		fail("called the wrong module");
+
+	entry = (uint32_t)((ls_entry - g_sim.ls.data()) % SLOT_SIZE);
+	image = ls_entry - entry;
+
+	if (checksum(image, code.code_size, entry + offsetof(FakeCode, checksum)) != code.checksum)
+		fail("module image corrupt");
+
+	if (code.bss_size)
+	{
+		uint8_t *bss = (uint8_t*)image + code.bss_start;
+
+		//BSS is only cleared on a real load; after that it is the module's...
+		if (g_sim.fresh_image == code.image)
+			for (uint32_t i = 0; i < code.bss_size; i++)
+				if (bss[i])
+					fail("BSS not cleared on load");
+		memset(bss, 0xa5, code.bss_size);
+	}
+
+	g_sim.fresh_image = ~0u;
+	return code.image * 1000 + 7;
+}
+
+//
+// Module images
+//
+
+struct Image
+{
+	uint64_t	ea;
+	uint32_t	size;
+};
+
+// Builds an image in simulated main memory; guid_from copies another image's
+// GUID, corrupt is the OV_ERROR_* the header should fail with.
+static Image make_image(uint32_t index, uint32_t size, uint32_t bss_size, int corrupt = OV_OK, const Image *guid_from = 0)
+{
+	Image image;
+	spu_mod_hdr header;
+	FakeCode code;
+	uint8_t *p;
+
+	image.ea = g_sim.next_ea;
+	image.size = size;
+	g_sim.next_ea += (size + 127) & ~127;
+	p = main_at(image.ea, size);
+
+	for (uint32_t i = 0; i < size; i++)
+		p[i] = (uint8_t)(i * 13 + index);
+
+	header.mark1 = MARKER;
+	header.rand1 = 0x1000 + index;
+	header.rand2 = (uint32_t)rand();
+	header.mark2 = MARKER;
+	header.entry = 0x20;
+	header.bss_start = bss_size ? ((size - bss_size / 2) & ~3) : 0;
+	header.bss_size = bss_size;
+	header.pad = 0;
+
+	if (guid_from)
+		memcpy(&header, main_at(guid_from->ea, 16), 16);
+	if (corrupt == OV_ERROR_BAD_MARKERS)
+		header.mark2 = 0;
+	else if (corrupt == OV_ERROR_BAD_ENTRY)
+		header.entry = size;
+	else if (corrupt == OV_ERROR_BAD_BSS)
+		header.bss_size = SLOT_SIZE;
+	memcpy(p, &header, sizeof(header));
+
+	code.magic = MODULE_MAGIC;
+	code.image = index;
+	code.checksum = 0;
+	code.code_size = bss_size ? header.bss_start : size;
+	code.bss_start = header.bss_start;
+	code.bss_size = bss_size;
+	code.pad[0] = code.pad[1] = 0;
+	memcpy(p + 0x20, &code, sizeof(code));
+	code.checksum = checksum(p, code.code_size, 0x20 + offsetof(FakeCode, checksum));
+	memcpy(p + 0x20, &code, sizeof(code));
+
+	return image;
+}
+
+static void reset_memory()
+{
+	g_sim.ls.assign(LS_SIZE, 0xcd);
+	g_sim.main.assign(MAIN_SIZE, 0);
+	g_sim.next_ea = EA_BASE;
+	g_sim.dma_bytes = 0;
+	g_sim.notifies = 0;
+	g_sim.fresh_image = ~0u;
+}
+
+static void reset_cache(uint32_t slots)
+{
+	ov_init(&g_cache, &g_sim.ls[0], SLOT_SIZE, SLOT_SIZE, slots);
+	g_sim.notifies = 0;
+	g_sim.fresh_image = ~0u;
+}
+
+static uint32_t call(uint32_t module, const Image &image, uint32_t image_index, uint32_t *status = 0)
+{
+	uint32_t result = 0;
+	uint32_t error;
+
+	g_sim.expected_image = image_index;
+	error = ov_call(&g_cache, module, image.ea, image.size, &result);
+	if (status)
+		*status = error;
+	else
+		check(error == OV_OK, "call failed");
+	return result;
+}
+
+//
+// Unit checks
+//
+
+static void testBasics()
+{
+	reset_memory();
+	Image a = make_image(0, 4096, 512);
+	Image b = make_image(1, 6000, 0);
+	Image c = make_image(2, 2048, 100);
+	Image a_copy = make_image(3, 4096, 512, OV_OK, &a);		//same GUID at another address
+	Image a_new = make_image(4, 3000, 64);						//new build of module 0
+	Image bad[3] = { make_image(5, 1024, 0, OV_ERROR_BAD_MARKERS), make_image(6, 1024, 0, OV_ERROR_BAD_ENTRY), make_image(7, 1024, 64, OV_ERROR_BAD_BSS) };
+	Image big = make_image(8, SLOT_SIZE + 16, 0);
+	uint32_t status;
+
+	reset_cache(2);
+	check(call(0, a, 0) == 7, "result");
+	check(call(1, b, 1) == 1007, "result");
+	check(call(0, a, 0) == 7, "hit result");
+	check(g_cache.stats.misses == 2 && g_cache.stats.hits == 1, "a then b then a: one hit");
+	check(g_sim.notifies == 2, "notify only on loads");
+	check(g_cache.stats.header_bytes == 3 * OV_HEADER_SIZE, "header fetched every call");
+
+	//The same GUID at another address is the same module...
+	g_sim.expected_image = 0;
+	uint32_t result = 0;
+	check(ov_call(&g_cache, 0, a_copy.ea, a_copy.size, &result) == OV_OK && result == 7, "same GUID runs the resident copy");
+	check(g_cache.stats.hits == 2, "same GUID is a hit");
+
+	//LRU: b is older than a, so c replaces b...
+	call(2, c, 2);
+	check(g_cache.stats.evictions == 1, "evicted one");
+	call(0, a, 0);
+	check(g_cache.stats.hits == 3, "a survived");
+	call(1, b, 1);
+	check(g_cache.stats.misses == 4, "b was evicted");
+
+	//A new build of module 0 has a new GUID and must be loaded...
+	call(0, a_new, 4);
+	check(g_cache.stats.misses == 5, "new GUID reloads");
+
+	for (int i = 0; i < 3; i++)
+	{
+		call(9, bad[i], 5 + i, &status);
+		check(status == (uint32_t)(OV_ERROR_BAD_MARKERS + i), "bad header rejected");
+	}
+	call(9, big, 8, &status);
+	check(status == OV_ERROR_TOO_LARGE, "too large rejected");
+	check(g_cache.stats.rejected == 4, "rejections counted");
+	check(g_sim.notifies == 5, "no notify for rejected modules");
+
+	//A slot still holding an older build of module 0 goes before live code...
+	reset_cache(2);
+	static const uint16_t sequence[] = { 0, 1, 0, 2, 0, 1 };
+	ov_declare_sequence(&g_cache, sequence, 6);
+	call(0, a, 0);
+	call(1, b, 1);
+	call(0, a_new, 4);		//goes over the old a, not over b
+	check(g_cache.slots[1].valid && g_cache.slots[1].module == 1 && g_cache.slots[0].module == 0, "stale build of a module evicted first");
+}
+
+//
+// Trace replay
+//
+
+struct Trace
+{
+	const char*				name;
+	std::vector<uint16_t>	calls;
+};
+
+static Trace cyclic(uint32_t modules, uint32_t length)
+{
+	Trace t;
+	t.name = "cyclic";
+	for (uint32_t i = 0; i < length; i++)
+		t.calls.push_back((uint16_t)(i % modules));
+	return t;
+}
+
+// Frames of jobs, each bouncing between a few of the modules.
+static Trace frames(uint32_t modules, uint32_t frame_count, uint32_t jobs, uint32_t hot)
+{
+	Trace t;
+	t.name = "frames";
+	for (uint32_t f = 0; f < frame_count; f++)
+	{
+		uint16_t set[MAX_MODULES];
+		for (uint32_t i = 0; i < hot; i++)
+			set[i] = (uint16_t)(rand() % modules);
+		for (uint32_t j = 0; j < jobs; j++)
+		{
+			t.calls.push_back(set[0]);				//setup module
+			t.calls.push_back(set[1 + rand() % (hot - 1)]);
+			t.calls.push_back(set[1 + rand() % (hot - 1)]);
+		}
+	}
+	return t;
+}
+
+static Trace skewed(uint32_t modules, uint32_t length)
+{
+	Trace t;
+	t.name = "skewed";
+	for (uint32_t i = 0; i < length; i++)
+	{
+		uint32_t r = rand() % 100;
+		uint32_t m = r < 50 ? 0 : r < 75 ? 1 : r < 87 ? 2 : 3 + rand() % (modules - 3);
+		t.calls.push_back((uint16_t)m);
+	}
+	return t;
+}
+
+// Fewest code bytes any policy could fetch for the trace with this many slots.
+static uint64_t optimal_bytes(const std::vector<uint16_t> &calls, const std::vector<uint32_t> &sizes, uint32_t slots)
+{
+	const uint64_t INF = ~0ull;
+	uint32_t states = 1u << sizes.size();
+	std::vector<uint64_t> cost(states, INF), next(states);
+
+	cost[0] = 0;
+	for (size_t t = 0; t < calls.size(); t++)
+	{
+		uint32_t m = 1u << calls[t];
+		std::fill(next.begin(), next.end(), INF);
+
+		for (uint32_t s = 0; s < states; s++)
+		{
+			if (cost[s] == INF)
+				continue;
+
+			if (s & m)
+			{
+				if (cost[s] < next[s])
+					next[s] = cost[s];
+				continue;
+			}
+
+			uint64_t c = cost[s] + sizes[calls[t]];
+			if ((uint32_t)__builtin_popcount(s) < slots)
+			{
+				if (c < next[s | m])
+					next[s | m] = c;
+				continue;
+			}
+			for (uint32_t v = s; v; v &= v - 1)
+			{
+				uint32_t n = (s & ~(v & -v)) | m;
+				if (c < next[n])
+					next[n] = c;
+			}
+		}
+		cost.swap(next);
+	}
+
+	uint64_t best = INF;
+	for (uint32_t s = 0; s < states; s++)
+		if (cost[s] < best)
+			best = cost[s];
+	return best;
+}
+
+struct ReplayResult
+{
+	uint64_t	bytes;
+	uint32_t	misses;
+	uint32_t	hits;
+};
+
+static ReplayResult replay(const Trace &trace, const std::vector<Image> &images, uint32_t slots, uint32_t window)
+{
+	ReplayResult r;
+	uint64_t expected = 0, total = 0;
+
+	reset_cache(slots);
+
+	for (size_t i = 0; i < trace.calls.size(); i++)
+	{
+		//Declare the next window of calls, as a frame's job list would...
+		if (window && i % window == 0)
+		{
+			uint32_t count = (uint32_t)(trace.calls.size() - i < window ? trace.calls.size() - i : window);
+			ov_declare_sequence(&g_cache, &trace.calls[i], count);
+		}
+
+		uint32_t m = trace.calls[i];
+		total += call(m, images[m], m);
+		expected += m * 1000 + 7;
+	}
+
+	check(total == expected, "replayed results");
+	check(g_cache.stats.hits + g_cache.stats.misses == trace.calls.size(), "every call a hit or a miss");
+	check(g_sim.notifies == g_cache.stats.misses, "one notify per load");
+
+	r.bytes = g_cache.stats.bytes_loaded;
+	r.misses = g_cache.stats.misses;
+	r.hits = g_cache.stats.hits;
+	return r;
+}
+
+static void evaluate(const Trace &trace, uint32_t modules, uint32_t slots)
+{
+	std::vector<Image> images;
+	std::vector<uint32_t> sizes;
+	uint64_t uncached = 0;
+
+	reset_memory();
+	for (uint32_t m = 0; m < modules; m++)
+	{
+		uint32_t size = 2048 + (rand() % 7) * 2048;
+		images.push_back(make_image(m, size, 256));
+		sizes.push_back((size + 15) & ~15);
+	}
+	for (size_t i = 0; i < trace.calls.size(); i++)
+		uncached += sizes[trace.calls[i]];
+
+	ReplayResult lru = replay(trace, images, slots, 0);
+	ReplayResult window = replay(trace, images, slots, 48);
+	ReplayResult full = replay(trace, images, slots, (uint32_t)trace.calls.size());
+	uint64_t best = optimal_bytes(trace.calls, sizes, slots);
+
+	check(best <= lru.bytes && best <= window.bytes && best <= full.bytes, "nothing beats the optimum");
+
+	printf("  %-7s %2u modules %u slots %5zu calls: reload every call %8.1f KB, LRU %8.1f KB (%4.1f%% hits), "
+		"declared 48 %8.1f KB, declared all %8.1f KB, optimum %8.1f KB\n",
+		trace.name, modules, slots, trace.calls.size(), uncached / 1024.0,
+		lru.bytes / 1024.0, 100.0 * lru.hits / trace.calls.size(),
+		window.bytes / 1024.0, full.bytes / 1024.0, best / 1024.0);
+}
+
+int main()
+{
+	srand(1);
+
+	printf("basics\n");
+	testBasics();
+
+	printf("traces\n");
+	evaluate(cyclic(5, 600), 5, 4);
+	evaluate(cyclic(8, 600), 8, 4);
+	evaluate(frames(10, 40, 16, 4), 10, 4);
+	evaluate(frames(10, 40, 16, 4), 10, 3);
+	evaluate(skewed(10, 1500), 10, 4);
+	evaluate(skewed(10, 1500), 10, 2);
+
+	if (g_sim.errors)
+	{
+		printf("%u checks failed\n", g_sim.errors);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
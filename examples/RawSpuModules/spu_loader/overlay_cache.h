@@ -0,0 +1,320 @@
+#ifndef __OVERLAY_CACHE_H__
+#define __OVERLAY_CACHE_H__
+
+// Keeps recently used code modules resident in a fixed set of local store
+// slots so a module that is called again does not pay for its code DMA.
+// Modules start with an spu_mod_hdr and are identified by its GUID
+// (mark1, rand1, rand2, mark2): a call fetches only the 32 byte header, and
+// if a slot already holds that GUID the module runs from there. Otherwise the
+// module is loaded into a free slot or over an evicted one, its BSS is
+// cleared and the debugger is told about the new code.
+//
+// Without further information the least recently used slot is evicted. A
+// caller that knows its upcoming calls can declare them with
+// ov_declare_sequence(); eviction then prefers modules that are not called
+// again, and otherwise weighs the bytes a refetch would cost against how
+// soon the module is next needed.
+//
+// A resident module keeps its data and BSS between calls, as with any
+// overlay manager.
+//
+// The types and layout are shared with the PPU. The cache itself is written
+// against primitives the includer defines, so it builds for the SPU and for
+// the host simulation in host_sim/:
+//
+//	OV_GET(ls, ea, size, tag)		start a DMA of up to OV_DMA_MAX bytes into local store
+//	OV_WAIT(tag)					wait for all DMAs on tag
+//	OV_NOTIFY(ls_entry, module)		new code for module now has its entry point at ls_entry
+//	OV_CALL(ls_entry)				run the entry point, returns its result
+
+#include <stdint.h>
+#include <string.h>
+
+#define OV_MAX_SLOTS			8
+#define OV_DMA_MAX				16384
+#define OV_HEADER_SIZE			32			//sizeof(spu_mod_hdr)
+#define OV_TAG					4
+
+#define OV_OK					0
+#define OV_ERROR_TOO_LARGE		1			//does not fit a slot, or is not 16 byte aligned
+#define OV_ERROR_BAD_MARKERS	2
+#define OV_ERROR_BAD_ENTRY		3
+#define OV_ERROR_BAD_BSS		4
+
+// The raw SPU loader keeps its overlay slots at a fixed local store address
+// so the PPU can read the notification block from its interrupt handler when
+// the SPU stops with OV_NOTIFY_STOP_CODE.
+#define OV_LS_BASE				0x20000
+#define OV_LS_SLOT_SIZE			0x4000
+#define OV_LS_SLOTS				4
+#define OV_LS_NOTIFY			OV_LS_BASE								//OverlayNotify
+#define OV_LS_SLOT(n)			(OV_LS_BASE + 128 + (n) * OV_LS_SLOT_SIZE)
+#define OV_NOTIFY_STOP_CODE		0x1000
+
+typedef struct OverlayNotify
+{
+	uint32_t	module;			//index the loader called the module by
+	uint32_t	entry;			//local store address of its entry point
+	uint32_t	pad[2];
+
+} OverlayNotify;
+
+typedef struct OverlayCacheStats
+{
+	uint32_t	calls;
+	uint32_t	hits;
+	uint32_t	misses;
+	uint32_t	evictions;
+	uint32_t	rejected;
+	uint32_t	bytes_loaded;		//code, not counting headers
+	uint32_t	header_bytes;
+
+} OverlayCacheStats;
+
+#ifdef OV_GET
+
+#ifdef __SPU__
+#include <libsn_spu.h>
+#else
+#include "LibSN_Module.h"
+#endif
+
+typedef struct OverlaySlot
+{
+	uint32_t	guid[4];
+	uint32_t	module;
+	uint32_t	size;			//bytes loaded
+	uint32_t	entry;
+	uint32_t	last_use;
+	uint32_t	valid;
+
+} OverlaySlot;
+
+typedef struct OverlayCache
+{
+	spu_mod_hdr			header __attribute__((__aligned__(128)));	//fetched on every call
+	OverlaySlot			slots[OV_MAX_SLOTS];
+	uint8_t*			base;
+	uint32_t			slot_stride;
+	uint32_t			slot_size;
+	uint32_t			slot_count;
+	uint32_t			clock;
+
+	const uint16_t*		sequence;		//declared upcoming calls, by module index
+	uint32_t			sequence_count;
+	uint32_t			cursor;			//next expected call in sequence
+
+	OverlayCacheStats	stats;
+
+} OverlayCache;
+
+// Slots are slot_size bytes each, slot_stride apart from base; base and the
+// stride must be 16 byte aligned.
+static inline void ov_init(OverlayCache *c, void *base, uint32_t slot_stride, uint32_t slot_size, uint32_t slot_count)
+{
+	uint32_t i;
+
+	if (slot_count > OV_MAX_SLOTS)
+		slot_count = OV_MAX_SLOTS;
+
+	c->base = (uint8_t*)base;
+	c->slot_stride = slot_stride;
+	c->slot_size = slot_size;
+	c->slot_count = slot_count;
+	c->clock = 0;
+	c->sequence = 0;
+	c->sequence_count = 0;
+	c->cursor = 0;
+
+	for (i = 0; i < OV_MAX_SLOTS; i++)
+		c->slots[i].valid = 0;
+
+	memset(&c->stats, 0, sizeof(c->stats));
+}
+
+// Declares the calls about to be made, by module index; the array must stay
+// valid until the next declaration. Pass 0 to go back to LRU eviction.
+static inline void ov_declare_sequence(OverlayCache *c, const uint16_t *sequence, uint32_t count)
+{
+	c->sequence = sequence;
+	c->sequence_count = count;
+	c->cursor = 0;
+}
+
+static inline uint8_t* ov_slot_ls(const OverlayCache *c, uint32_t slot)
+{
+	return c->base + slot * c->slot_stride;
+}
+
+// Distance from the cursor to the next declared call of module, or ~0 if it
+// is not called again within the declared sequence.
+static inline uint32_t ov_next_use(const OverlayCache *c, uint32_t module)
+{
+	uint32_t i;
+
+	for (i = c->cursor; i < c->sequence_count; i++)
+		if (c->sequence[i] == module)
+			return i - c->cursor + 1;
+
+	return ~0u;
+}
+
+static inline uint32_t ov_choose_victim(const OverlayCache *c, uint32_t module)
+{
+	uint32_t victim = 0;
+	uint32_t victim_next = 0;
+	uint32_t i;
+
+	for (i = 0; i < c->slot_count; i++)
+		if (!c->slots[i].valid)
+			return i;
+
+	if (c->cursor >= c->sequence_count)
+	{
+		for (i = 1; i < c->slot_count; i++)
+			if (c->slots[i].last_use < c->slots[victim].last_use)
+				victim = i;
+		return victim;
+	}
+
+	//Not needed again costs nothing, and a slot holding older code for this
+	//module index is not needed again. Otherwise weigh the bytes a refetch
+	//costs against how soon it would be needed, size / sqrt(distance), which
+	//replayed traces in host_sim/ put close to the offline optimum; plain
+	//furthest next use ignores size and size / distance keeps too many
+	//small modules. LRU breaks ties...
+	for (i = 0; i < c->slot_count; i++)
+	{
+		const OverlaySlot *slot = &c->slots[i];
+		uint32_t next = slot->module == module ? ~0u : ov_next_use(c, slot->module);
+		int better;
+
+		if (i == 0)
+		{
+			victim_next = next;
+			continue;
+		}
+
+		if (next == ~0u || victim_next == ~0u)
+			better = next == victim_next ? slot->last_use < c->slots[victim].last_use : next == ~0u;
+		else
+		{
+			//Compares size / sqrt(distance), squared...
+			uint64_t size = slot->size, victim_size = c->slots[victim].size;
+			uint64_t cost = size * size * (victim_next < 0xffff ? victim_next : 0xffff);
+			uint64_t victim_cost = victim_size * victim_size * (next < 0xffff ? next : 0xffff);
+			better = cost < victim_cost || (cost == victim_cost && slot->last_use < c->slots[victim].last_use);
+		}
+
+		if (better)
+		{
+			victim = i;
+			victim_next = next;
+		}
+	}
+
+	return victim;
+}
+
+static inline uint32_t ov_check_header(const OverlayCache *c, const spu_mod_hdr *header, uint32_t size)
+{
+	if (header->mark1 == 0 || header->mark1 != header->mark2)
+		return OV_ERROR_BAD_MARKERS;
+	if (header->entry < OV_HEADER_SIZE || header->entry >= size || (header->entry & 3))
+		return OV_ERROR_BAD_ENTRY;
+	if (header->bss_size && (header->bss_start < OV_HEADER_SIZE || header->bss_start > c->slot_size
+		|| header->bss_size > c->slot_size - header->bss_start))
+		return OV_ERROR_BAD_BSS;
+	return OV_OK;
+}
+
+static inline void ov_load(OverlayCache *c, uint32_t slot, uint64_t ea, uint32_t size)
+{
+	uint8_t *ls = ov_slot_ls(c, slot);
+	uint32_t remaining = size;
+
+	while (remaining)
+	{
+		uint32_t chunk = remaining < OV_DMA_MAX ? remaining : OV_DMA_MAX;
+		OV_GET(ls, ea, chunk, OV_TAG);
+		ls += chunk;
+		ea += chunk;
+		remaining -= chunk;
+	}
+	OV_WAIT(OV_TAG);
+
+	if (c->header.bss_size)
+		memset(ov_slot_ls(c, slot) + c->header.bss_start, 0, c->header.bss_size);
+}
+
+// Calls module, whose image of size bytes is at ea, loading it only if no
+// slot holds its GUID. module is the caller's index for it, as used in the
+// declared sequence and reported to the debugger.
+static inline uint32_t ov_call(OverlayCache *c, uint32_t module, uint64_t ea, uint32_t size, uint32_t *result)
+{
+	uint32_t image_size = (size + 15) & ~15;
+	uint32_t slot;
+	uint32_t error;
+
+	c->stats.calls++;
+	c->clock++;
+
+	if (c->cursor < c->sequence_count && c->sequence[c->cursor] == module)
+		c->cursor++;
+
+	if (image_size < OV_HEADER_SIZE || image_size > c->slot_size || (ea & 15))
+	{
+		c->stats.rejected++;
+		return OV_ERROR_TOO_LARGE;
+	}
+
+	OV_GET(&c->header, ea, OV_HEADER_SIZE, OV_TAG);
+	OV_WAIT(OV_TAG);
+	c->stats.header_bytes += OV_HEADER_SIZE;
+
+	for (slot = 0; slot < c->slot_count; slot++)
+	{
+		const OverlaySlot *s = &c->slots[slot];
+		if (s->valid && !memcmp(s->guid, &c->header.mark1, sizeof(s->guid)))
+			break;
+	}
+
+	if (slot < c->slot_count)
+	{
+		c->stats.hits++;
+	}
+	else
+	{
+		error = ov_check_header(c, &c->header, image_size);
+		if (error != OV_OK)
+		{
+			c->stats.rejected++;
+			return error;
+		}
+
+		slot = ov_choose_victim(c, module);
+		if (c->slots[slot].valid)
+			c->stats.evictions++;
+
+		ov_load(c, slot, ea, image_size);
+		c->stats.misses++;
+		c->stats.bytes_loaded += image_size;
+
+		memcpy(c->slots[slot].guid, &c->header.mark1, sizeof(c->slots[slot].guid));
+		c->slots[slot].size = image_size;
+		c->slots[slot].entry = c->header.entry;
+		c->slots[slot].valid = 1;
+
+		OV_NOTIFY(ov_slot_ls(c, slot) + c->header.entry, module);
+	}
+
+	c->slots[slot].module = module;
+	c->slots[slot].last_use = c->clock;
+
+	*result = OV_CALL(ov_slot_ls(c, slot) + c->slots[slot].entry);
+	return OV_OK;
+}
+
+#endif //#ifdef OV_GET
+
+#endif //#ifndef __OVERLAY_CACHE_H__
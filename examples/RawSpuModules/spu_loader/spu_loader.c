@@ -16,21 +16,35 @@ typedef qword uint128_t;
 
 #define BUF_SIZE  1280
 
-unsigned int dma_buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
-unsigned int code1Buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
-unsigned int code2Buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
+static void NotifyLoad( void* entry, unsigned int module );
 
-void DmaIn( void* spu_addr, unsigned int ydram_addr, unsigned int length, unsigned int id )
-{
-	spu_mfcdma64( spu_addr, 0, ydram_addr, length, id, MFC_GET_CMD);
-}
+typedef unsigned int (*LoadedFunc)( void );
 
-void DmaStall( void )
+#define OV_GET(ls, ea, size, tag)	spu_mfcdma64((ls), (unsigned int)((ea) >> 32), (unsigned int)(ea), (size), (tag), MFC_GET_CMD)
+#define OV_WAIT(tag)				(spu_writech(MFC_WrTagMask, 1 << (tag)), spu_mfcstat(MFC_TAG_UPDATE_ALL))
+#define OV_NOTIFY(ls, module)		NotifyLoad((ls), (module))
+#define OV_CALL(ls)					(spu_sync(), ((LoadedFunc)(ls))())
+
+#include "overlay_cache.h"
+
+//Tell the PPU where new module code is; its interrupt handler passes this
+//on to the debugger and restarts the SPU...
+static void NotifyLoad( void* entry, unsigned int module )
 {
-	spu_writech(MFC_WrTagMask, 0xFFFFFFFF);
-	spu_mfcstat(2);
+	OverlayNotify* notify = (OverlayNotify*) OV_LS_NOTIFY;
+	notify->module = module;
+	notify->entry = (unsigned int)entry;
+	spu_dsync();
+	spu_stop( OV_NOTIFY_STOP_CODE );
 }
 
+unsigned int dma_buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
+
+OverlayCache overlayCache;
+
+//Order the modules are called in; repeat calls run from the overlay cache...
+static const uint16_t callSequence[] = { 0, 1, 1, 0, 1, 0, 0, 1 };
+
 int main(void)
 {
     int i;
@@ -60,19 +74,12 @@ int main(void)
 	snPause();
 	////////////////////////////////////////////////////////////
 
-	//DMA modules into SPU memory...
-	DmaIn( code1Buffer, code1Addr, code1Size, 0 );
-	DmaIn( code2Buffer, code2Addr, code2Size, 1 );
-	DmaStall();
-
-	//Get pointers to module entry points...
-	typedef unsigned int (*LoadedFunc)( void );
-
-	unsigned int uCode1Entry = ((spu_mod_hdr*)code1Buffer)->entry + (unsigned int)code1Buffer;
-	unsigned int uCode2Entry = ((spu_mod_hdr*)code2Buffer)->entry + (unsigned int)code2Buffer;
+	//The overlay slots sit at a fixed address so the PPU can find the notification block...
+	ov_init(&overlayCache, (void*) OV_LS_SLOT(0), OV_LS_SLOT_SIZE, OV_LS_SLOT_SIZE, OV_LS_SLOTS);
+	ov_declare_sequence(&overlayCache, callSequence, sizeof(callSequence) / sizeof(callSequence[0]));
 
-	LoadedFunc loadedFuncPtr1 = (LoadedFunc) (uCode1Entry);
-	LoadedFunc loadedFuncPtr2 = (LoadedFunc) (uCode2Entry);
+	unsigned int moduleAddr[2] = { code1Addr, code2Addr };
+	unsigned int moduleSize[2] = { code1Size, code2Size };
 
 	////////////////////////////////////////////////////////////
 	//On seeing an "spu_stop(3)", the interrupt handler will do
@@ -82,15 +89,23 @@ int main(void)
 	snPause();
 	////////////////////////////////////////////////////////////
 
-	//Call modules...
-	unsigned int ret1 = loadedFuncPtr1();
-	unsigned int ret2 = loadedFuncPtr2();
+	//Call modules, loading each only when it is not already resident...
+	unsigned int total = 0;
+	for (i = 0; i < (int)(sizeof(callSequence) / sizeof(callSequence[0])); i++)
+	{
+		unsigned int module = callSequence[i];
+		unsigned int ret;
 
-	//Add up the return values...
-	unsigned int total = ret1 + ret2;
+		if (ov_call(&overlayCache, module, moduleAddr[module], moduleSize[module], &ret) == OV_OK)
+			total += ret;
+	}
 
-	//Store the result ready for the PPU...
+	//Store the result and the overlay cache statistics ready for the PPU...
 	dma_buffer[0] = total;
+	dma_buffer[1] = overlayCache.stats.calls;
+	dma_buffer[2] = overlayCache.stats.hits;
+	dma_buffer[3] = overlayCache.stats.misses;
+	dma_buffer[4] = overlayCache.stats.bytes_loaded;
 
     //Send the address of dma_buffer via PPU mailbox...
     spu_writech(SPU_WrOutMbox, (unsigned int)dma_buffer);
@@ -0,0 +1,598 @@
+/*
+*  Description:
+*  Portable job chain runtime, see host_job_chain.h.
+*
+*  Locks are always taken in the order pool, worker queue, chain, and
+*  HostJobPool::Notify is only called with no chain lock held.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include "host_job_chain.h"
+
+#define HOST_JOB_COMMAND_ADDRESS(cmd)	((cmd) & ~HOST_JOB_COMMAND_OPCODE_MASK)
+
+static inline uint32_t align16(uint32_t val)
+{
+	return (val + 15) & ~15;
+}
+
+int hostJobChainAttributeInitialize(
+	HostJobChainAttribute *attr,
+	const uint64_t *commandList,
+	uint32_t sizeJobDescriptor,
+	uint32_t maxGrabbedJob,
+	const uint8_t priority[8],
+	uint32_t maxContention,
+	bool autoReadyCount,
+	uint32_t readyCount)
+{
+	if (!attr || !commandList || !priority)
+		return HOST_JOB_ERROR_INVAL;
+	if ((uintptr_t)commandList & HOST_JOB_COMMAND_OPCODE_MASK)
+		return HOST_JOB_ERROR_ALIGN;
+	if (sizeJobDescriptor != sizeof(HostJob64) && sizeJobDescriptor != sizeof(HostJob128) && sizeJobDescriptor != sizeof(HostJob256))
+		return HOST_JOB_ERROR_INVAL;
+	if (maxGrabbedJob < 1 || maxGrabbedJob > HOST_JOB_MAX_GRAB || maxContention < 1)
+		return HOST_JOB_ERROR_INVAL;
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (priority[i] >= HOST_JOB_MAX_PRIORITY)
+			return HOST_JOB_ERROR_INVAL;
+	}
+
+	memset(attr, 0, sizeof(*attr));
+	attr->commandList = commandList;
+	attr->sizeJobDescriptor = sizeJobDescriptor;
+	attr->maxGrabbedJob = maxGrabbedJob;
+	memcpy(attr->priority, priority, sizeof(attr->priority));
+	attr->maxContention = maxContention;
+	attr->autoReadyCount = autoReadyCount;
+	attr->readyCount = readyCount;
+
+	return HOST_JOB_OK;
+}
+
+//
+// HostJobChain
+//
+
+HostJobChain::HostJobChain() :
+	m_pool(NULL),
+	m_state(CHAIN_IDLE),
+	m_cursor(NULL),
+	m_outstanding(0),
+	m_workers(0),
+	m_readyCount(0),
+	m_error(HOST_JOB_OK),
+	m_ended(false)
+{
+	memset(&m_attr, 0, sizeof(m_attr));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+HostJobChain::~HostJobChain()
+{
+	if (m_pool)
+		m_pool->RemoveJobChain(this);
+}
+
+int HostJobChain::Run()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_pool)
+			return HOST_JOB_ERROR_STAT;
+		if (m_state == CHAIN_RUNNING)
+			return HOST_JOB_ERROR_BUSY;
+
+		m_state = CHAIN_RUNNING;
+		m_cursor = m_attr.commandList;
+		m_outstanding = 0;
+		m_error = HOST_JOB_OK;
+		m_ended = false;
+		memset(&m_stats, 0, sizeof(m_stats));
+	}
+
+	m_pool->Notify();
+	return HOST_JOB_OK;
+}
+
+int HostJobChain::Join()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_state == CHAIN_IDLE)
+		return HOST_JOB_ERROR_STAT;
+
+	while (m_state != CHAIN_COMPLETE)
+		m_done.wait(lock);
+
+	return m_error;
+}
+
+int HostJobChain::SetReadyCount(uint32_t readyCount)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_attr.autoReadyCount)
+			return HOST_JOB_ERROR_STAT;
+
+		m_readyCount = readyCount;
+	}
+
+	if (m_pool)
+		m_pool->Notify();
+	return HOST_JOB_OK;
+}
+
+bool HostJobChain::IsComplete() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_state == CHAIN_COMPLETE;
+}
+
+HostJobChainStats HostJobChain::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+uint32_t HostJobChain::GetWorkerLimit() const
+{
+	//With an automatic ready count, the count follows the jobs available;
+	//workers only attach when a grab finds work, which has the same effect...
+	if (m_attr.autoReadyCount)
+		return m_attr.maxContention;
+
+	return std::min(m_attr.maxContention, m_readyCount);
+}
+
+bool HostJobChain::CanAttach(uint32_t worker) const
+{
+	return m_state == CHAIN_RUNNING
+		&& m_attr.priority[worker % 8] != 0
+		&& m_workers < GetWorkerLimit();
+}
+
+int HostJobChain::CheckJob(const HostJob256 *job) const
+{
+	uint32_t workArea = m_attr.sizeJobDescriptor - sizeof(HostJobHeader);
+	uint32_t size = 0;
+	uint32_t total = 0;
+
+	if ((uintptr_t)job & 15)
+		return HOST_JOB_ERROR_ALIGN;
+	if (!job->header.entry || (job->header.sizeDmaList & 7) || job->header.sizeDmaList > workArea)
+		return HOST_JOB_ERROR_INVAL;
+
+	for (uint32_t i = 0; i < job->header.sizeDmaList / 8u; i++)
+	{
+		uint32_t elementSize = HOST_JOB_DMA_SIZE(job->workArea.dmaList[i]);
+
+		if (elementSize == 0 || elementSize > HOST_JOB_MAX_DMA_SIZE)
+			return HOST_JOB_ERROR_INVAL;
+		if (((uintptr_t)HOST_JOB_DMA_EA(job->workArea.dmaList[i]) & 15) || (elementSize & 15))
+			return HOST_JOB_ERROR_ALIGN;
+
+		size += elementSize;
+		total += align16(elementSize);
+	}
+
+	if (size != job->header.sizeInOrInOut)
+		return HOST_JOB_ERROR_INVAL;
+	if ((uint64_t)total + (uint64_t)job->header.sizeScratch * 16 > HOST_JOB_LS_SIZE)
+		return HOST_JOB_ERROR_INVAL;
+
+	return HOST_JOB_OK;
+}
+
+// Takes up to maxGrabbedJob jobs from the cursor. Returns 0 when the chain is
+// waiting at a SYNC, has ended or has failed. Called with m_mutex held.
+uint32_t HostJobChain::Grab(std::vector<const HostJob256*> &jobs)
+{
+	jobs.clear();
+
+	while (!m_ended)
+	{
+		uint64_t cmd = *m_cursor;
+
+		switch (cmd & HOST_JOB_COMMAND_OPCODE_MASK)
+		{
+		case HOST_JOB_COMMAND_OP_JOB:
+			{
+				const HostJob256 *job = (const HostJob256*)(uintptr_t)HOST_JOB_COMMAND_ADDRESS(cmd);
+				int error = job ? CheckJob(job) : HOST_JOB_ERROR_INVAL;
+
+				if (error != HOST_JOB_OK)
+				{
+					Fail(error);
+					break;
+				}
+
+				jobs.push_back(job);
+				m_cursor++;
+
+				if (jobs.size() == m_attr.maxGrabbedJob || (*m_cursor & HOST_JOB_COMMAND_OPCODE_MASK) != HOST_JOB_COMMAND_OP_JOB)
+				{
+					m_outstanding += jobs.size();
+					m_stats.grabs++;
+					return (uint32_t)jobs.size();
+				}
+			}
+			break;
+
+		case HOST_JOB_COMMAND_OP_NEXT:
+			if (!HOST_JOB_COMMAND_ADDRESS(cmd))
+			{
+				Fail(HOST_JOB_ERROR_INVAL);
+				break;
+			}
+			m_cursor = (const uint64_t*)(uintptr_t)HOST_JOB_COMMAND_ADDRESS(cmd);
+			break;
+
+		case HOST_JOB_COMMAND_OP_SYNC:
+			if (m_outstanding)
+				return 0;
+			m_stats.syncs++;
+			m_cursor++;
+			break;
+
+		case HOST_JOB_COMMAND_OP_END:
+			m_ended = true;
+			break;
+
+		default:
+			Fail(HOST_JOB_ERROR_INVAL);
+			break;
+		}
+	}
+
+	//A bad job ends the chain, but jobs grabbed before it still run...
+	if (!jobs.empty())
+	{
+		m_outstanding += jobs.size();
+		m_stats.grabs++;
+		return (uint32_t)jobs.size();
+	}
+
+	//Ended with no jobs in flight, e.g. an empty chain...
+	CheckComplete();
+	return 0;
+}
+
+// The chain completes once it has ended, its jobs have run and every worker
+// has detached, so nothing touches it after Join returns. Called with
+// m_mutex held.
+void HostJobChain::CheckComplete()
+{
+	if (m_ended && m_outstanding == 0 && m_workers == 0 && m_state == CHAIN_RUNNING)
+	{
+		m_state = CHAIN_COMPLETE;
+		m_done.notify_all();
+	}
+}
+
+void HostJobChain::Fail(int error)
+{
+	if (m_error == HOST_JOB_OK)
+		m_error = error;
+	m_ended = true;
+}
+
+void HostJobChain::Complete(uint32_t count)
+{
+	bool notify = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_stats.jobs += count;
+		m_outstanding -= count;
+
+		if (m_outstanding == 0 && !m_ended)
+			notify = (*m_cursor & HOST_JOB_COMMAND_OPCODE_MASK) == HOST_JOB_COMMAND_OP_SYNC;
+	}
+
+	//Workers may be waiting on the SYNC this completes...
+	if (notify)
+		m_pool->Notify();
+}
+
+//
+// HostJobPool
+//
+
+HostJobPool::HostJobPool() :
+	m_generation(0),
+	m_nextChain(0),
+	m_exit(false)
+{
+}
+
+HostJobPool::~HostJobPool()
+{
+	Finalize();
+}
+
+int HostJobPool::Initialize(uint32_t workers)
+{
+	if (workers == 0 || !m_workers.empty())
+		return HOST_JOB_ERROR_INVAL;
+
+	m_exit = false;
+
+	for (uint32_t i = 0; i < workers; i++)
+	{
+		Worker *worker = new Worker;
+		worker->index = i;
+		worker->attached = NULL;
+		worker->localStore.assign(HOST_JOB_LS_SIZE, 0);
+		m_workers.push_back(worker);
+	}
+
+	for (uint32_t i = 0; i < workers; i++)
+		m_workers[i]->thread = std::thread(&HostJobPool::WorkerThread, this, m_workers[i]);
+
+	return HOST_JOB_OK;
+}
+
+void HostJobPool::Finalize()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->thread.join();
+		delete m_workers[i];
+	}
+	m_workers.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_chains.size(); i++)
+		m_chains[i]->m_pool = NULL;
+	m_chains.clear();
+}
+
+int HostJobPool::CreateJobChain(HostJobChain *chain, const HostJobChainAttribute &attr)
+{
+	if (!chain || !attr.commandList || attr.maxGrabbedJob < 1 || attr.maxGrabbedJob > HOST_JOB_MAX_GRAB || attr.maxContention < 1)
+		return HOST_JOB_ERROR_INVAL;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (chain->m_pool)
+		return HOST_JOB_ERROR_BUSY;
+
+	chain->m_pool = this;
+	chain->m_attr = attr;
+	chain->m_readyCount = attr.readyCount;
+	chain->m_state = HostJobChain::CHAIN_IDLE;
+	m_chains.push_back(chain);
+
+	return HOST_JOB_OK;
+}
+
+int HostJobPool::RemoveJobChain(HostJobChain *chain)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<HostJobChain*>::iterator it = std::find(m_chains.begin(), m_chains.end(), chain);
+	if (it == m_chains.end())
+		return HOST_JOB_ERROR_INVAL;
+
+	{
+		std::lock_guard<std::mutex> chainLock(chain->m_mutex);
+		if (chain->m_state == HostJobChain::CHAIN_RUNNING)
+			return HOST_JOB_ERROR_BUSY;
+		chain->m_pool = NULL;
+	}
+
+	m_chains.erase(it);
+	return HOST_JOB_OK;
+}
+
+void HostJobPool::Notify()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+	}
+	m_wake.notify_all();
+}
+
+void HostJobPool::WorkerThread(Worker *worker)
+{
+	QueuedJob job;
+
+	for (;;)
+	{
+		if (PopLocal(worker, job))
+		{
+			Execute(worker, job);
+			continue;
+		}
+
+		Detach(worker);
+
+		uint64_t generation;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_exit)
+				break;
+			generation = m_generation;
+		}
+
+		if (GrabFromChain(worker))
+			continue;
+
+		if (Steal(worker, job))
+		{
+			Execute(worker, job);
+			continue;
+		}
+
+		//Nothing to do until a chain, SYNC, ready count or queue changes...
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_exit && m_generation == generation)
+			m_wake.wait(lock);
+	}
+
+	Detach(worker);
+}
+
+bool HostJobPool::PopLocal(Worker *worker, QueuedJob &job)
+{
+	std::lock_guard<std::mutex> lock(worker->mutex);
+
+	if (worker->queue.empty())
+		return false;
+
+	job = worker->queue.front();
+	worker->queue.pop_front();
+	return true;
+}
+
+bool HostJobPool::GrabFromChain(Worker *worker)
+{
+	std::vector<const HostJob256*> jobs;
+	HostJobChain *chain = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t count = m_chains.size();
+
+		//Try chains in priority order, rotating between equal priorities...
+		for (uint32_t priority = 1; priority < HOST_JOB_MAX_PRIORITY && !chain; priority++)
+		{
+			for (size_t n = 0; n < count && !chain; n++)
+			{
+				HostJobChain *candidate = m_chains[(m_nextChain + n) % count];
+
+				if (candidate->m_attr.priority[worker->index % 8] != priority)
+					continue;
+
+				std::lock_guard<std::mutex> chainLock(candidate->m_mutex);
+				if (!candidate->CanAttach(worker->index) || !candidate->Grab(jobs))
+					continue;
+
+				chain = candidate;
+				chain->m_workers++;
+				chain->m_stats.maxWorkers = std::max(chain->m_stats.maxWorkers, chain->m_workers);
+				m_nextChain = (uint32_t)((m_nextChain + n + 1) % count);
+			}
+		}
+
+		if (!chain)
+			return false;
+
+		worker->attached = chain;
+
+		std::lock_guard<std::mutex> queueLock(worker->mutex);
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			QueuedJob queued = { jobs[i], chain };
+			worker->queue.push_back(queued);
+		}
+	}
+
+	//Let idle workers steal the rest of the grab...
+	if (jobs.size() > 1)
+		Notify();
+
+	return true;
+}
+
+bool HostJobPool::Steal(Worker *worker, QueuedJob &job)
+{
+	size_t count = m_workers.size();
+
+	for (size_t n = 1; n < count; n++)
+	{
+		Worker *victim = m_workers[(worker->index + n) % count];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+
+		if (victim->queue.empty())
+			continue;
+
+		//A queued job keeps its chain running, so the chain is safe to lock...
+		HostJobChain *chain = victim->queue.back().chain;
+		{
+			std::lock_guard<std::mutex> chainLock(chain->m_mutex);
+			if (!chain->CanAttach(worker->index))
+				continue;
+
+			chain->m_workers++;
+			chain->m_stats.maxWorkers = std::max(chain->m_stats.maxWorkers, chain->m_workers);
+			chain->m_stats.steals++;
+		}
+
+		job = victim->queue.back();
+		victim->queue.pop_back();
+		worker->attached = chain;
+		return true;
+	}
+
+	return false;
+}
+
+void HostJobPool::Detach(Worker *worker)
+{
+	HostJobChain *chain = worker->attached;
+	bool notify;
+
+	if (!chain)
+		return;
+
+	worker->attached = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(chain->m_mutex);
+		notify = chain->m_workers-- == chain->GetWorkerLimit() && !chain->m_ended;
+		chain->CheckComplete();
+	}
+
+	//Another worker may have been held back by max contention...
+	if (notify)
+		Notify();
+}
+
+void HostJobPool::Execute(Worker *worker, const QueuedJob &queued)
+{
+	const HostJob256 *job = queued.job;
+	uint8_t *ls = &worker->localStore[0];
+	uint32_t offset = 0;
+	HostJobContext context;
+
+	//Gather the DMA list inputs as the job streaming would...
+	for (uint32_t i = 0; i < job->header.sizeDmaList / 8u; i++)
+	{
+		uint64_t element = job->workArea.dmaList[i];
+		uint32_t size = HOST_JOB_DMA_SIZE(element);
+
+		memcpy(ls + offset, HOST_JOB_DMA_EA(element), size);
+		offset += align16(size);
+	}
+
+	context.ioBuffer = ls;
+	context.sizeIo = offset;
+	context.scratchBuffer = job->header.sizeScratch ? ls + offset : NULL;
+	context.sizeScratch = job->header.sizeScratch * 16;
+	context.workerIndex = worker->index;
+	context.chain = queued.chain;
+
+	//The descriptor is the job's own copy, as it is in local store on the SPU...
+	HostJob256 local;
+	memcpy(&local, job, queued.chain->m_attr.sizeJobDescriptor);
+	job->header.entry(&context, &local);
+
+	queued.chain->Complete(1);
+}
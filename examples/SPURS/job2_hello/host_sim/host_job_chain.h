@@ -0,0 +1,228 @@
+/*
+*  Description:
+*  Portable job chain runtime following the SPURS job chain model, so job
+*  decomposition can be prototyped and benchmarked on a host machine.
+*
+*  A chain is a command list of 64 bit words built with the HOST_JOB_COMMAND_*
+*  macros, in the same shape as the CELL_SPURS_JOB_COMMAND_* lists used with
+*  cellSpursCreateJobChainWithAttribute:
+*
+*	JOB(job)	run the job descriptor at job (16 byte aligned)
+*	SYNC		wait for every job before this point to complete
+*	NEXT(list)	continue at another command list
+*	END			the chain is complete once its jobs have finished
+*
+*  Worker threads stand in for SPUs. A worker grabs up to maxGrab consecutive
+*  jobs from a chain into its own queue; idle workers steal from other queues.
+*  A chain never has more workers than min(maxContention, ready count), and a
+*  worker only takes chains whose priority for it is non-zero, preferring the
+*  lowest value as SPURS does.
+*/
+
+#ifndef __HOST_JOB_CHAIN_H__
+#define __HOST_JOB_CHAIN_H__
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define HOST_JOB_OK						0
+#define HOST_JOB_ERROR_INVAL			1		//bad attribute or job descriptor
+#define HOST_JOB_ERROR_ALIGN			2		//command or descriptor misaligned
+#define HOST_JOB_ERROR_STAT				3		//chain in the wrong state
+#define HOST_JOB_ERROR_BUSY				4
+
+#define HOST_JOB_MAX_GRAB				16
+#define HOST_JOB_MAX_PRIORITY			16
+#define HOST_JOB_LS_SIZE				(256 * 1024)	//per worker input and scratch space
+#define HOST_JOB_MAX_DMA_SIZE			(16 * 1024)		//per DMA list element
+
+//Commands; a job command is the descriptor address itself, and command
+//lists must be 8 byte aligned...
+#define HOST_JOB_COMMAND_OPCODE_MASK	(0x7ULL)
+#define HOST_JOB_COMMAND_OP_JOB			(0x0ULL)
+#define HOST_JOB_COMMAND_OP_NEXT		(0x1ULL)
+#define HOST_JOB_COMMAND_OP_SYNC		(0x2ULL)
+#define HOST_JOB_COMMAND_OP_END			(0x3ULL)
+
+#define HOST_JOB_COMMAND_JOB(job)		((uint64_t)(uintptr_t)(job) | HOST_JOB_COMMAND_OP_JOB)
+#define HOST_JOB_COMMAND_NEXT(list)		((uint64_t)(uintptr_t)(list) | HOST_JOB_COMMAND_OP_NEXT)
+#define HOST_JOB_COMMAND_SYNC			(HOST_JOB_COMMAND_OP_SYNC)
+#define HOST_JOB_COMMAND_END			(HOST_JOB_COMMAND_OP_END)
+
+//DMA list element: size in the top 16 bits, address in the low 48...
+#define HOST_JOB_DMA_ELEMENT(ea, size)	(((uint64_t)(size) << 48) | ((uint64_t)(uintptr_t)(ea) & 0xffffffffffffULL))
+#define HOST_JOB_DMA_EA(element)		((const void*)(uintptr_t)((element) & 0xffffffffffffULL))
+#define HOST_JOB_DMA_SIZE(element)		((uint32_t)((element) >> 48))
+
+struct HostJobContext;
+struct HostJob256;
+
+typedef void (*HostJobEntry)(HostJobContext *context, HostJob256 *job);
+
+//Stands in for CellSpursJobHeader; the entry point replaces eaBinary.
+typedef struct HostJobHeader
+{
+	HostJobEntry	entry;
+	uint16_t		sizeDmaList;		//bytes of DMA list at the start of workArea
+	uint16_t		jobType;
+	uint32_t		sizeScratch;		//16 byte units
+	uint32_t		sizeInOrInOut;		//total bytes in the DMA list
+	uint32_t		pad[3];
+
+} HostJobHeader __attribute__((__aligned__(16)));
+
+#define HOST_JOB_DESCRIPTOR(name, size)										\
+	typedef struct name														\
+	{																		\
+		HostJobHeader header;												\
+		union																\
+		{																	\
+			uint64_t dmaList[((size) - sizeof(HostJobHeader)) / 8];		\
+			uint64_t userData[((size) - sizeof(HostJobHeader)) / 8];		\
+		} workArea;															\
+	} name __attribute__((__aligned__(16)))
+
+HOST_JOB_DESCRIPTOR(HostJob64, 64);
+HOST_JOB_DESCRIPTOR(HostJob128, 128);
+HOST_JOB_DESCRIPTOR(HostJob256, 256);
+
+class HostJobChain;
+
+//Passed to the job, as CellSpursJobContext2 is on the SPU.
+struct HostJobContext
+{
+	void*			ioBuffer;			//DMA list inputs, gathered in order
+	void*			scratchBuffer;
+	uint32_t		sizeIo;
+	uint32_t		sizeScratch;		//bytes
+	uint32_t		workerIndex;
+	HostJobChain*	chain;
+};
+
+struct HostJobChainAttribute
+{
+	const uint64_t*	commandList;
+	uint32_t		sizeJobDescriptor;
+	uint32_t		maxGrabbedJob;
+	uint8_t			priority[8];		//per worker (worker index % 8), 0 to never run
+	uint32_t		maxContention;
+	bool			autoReadyCount;
+	uint32_t		readyCount;			//ignored if autoReadyCount
+	const char*		name;
+};
+
+int hostJobChainAttributeInitialize(
+	HostJobChainAttribute *attr,
+	const uint64_t *commandList,
+	uint32_t sizeJobDescriptor,
+	uint32_t maxGrabbedJob,
+	const uint8_t priority[8],
+	uint32_t maxContention,
+	bool autoReadyCount,
+	uint32_t readyCount);
+
+struct HostJobChainStats
+{
+	uint64_t		jobs;
+	uint64_t		grabs;
+	uint64_t		steals;
+	uint64_t		syncs;
+	uint32_t		maxWorkers;			//most workers seen on the chain at once
+};
+
+class HostJobPool;
+
+class HostJobChain
+{
+public:
+					HostJobChain();
+					~HostJobChain();
+
+	int				Run();
+	int				Join();				//waits for END; returns the chain's error
+	int				SetReadyCount(uint32_t readyCount);
+	bool			IsComplete() const;
+	const char*		GetName() const { return m_attr.name ? m_attr.name : ""; }
+	HostJobChainStats GetStats() const;
+
+private:
+	friend class HostJobPool;
+
+	enum State { CHAIN_IDLE, CHAIN_RUNNING, CHAIN_COMPLETE };
+
+	uint32_t		GetWorkerLimit() const;
+	bool			CanAttach(uint32_t worker) const;
+	uint32_t		Grab(std::vector<const HostJob256*> &jobs);
+	int				CheckJob(const HostJob256 *job) const;
+	void			Complete(uint32_t count);
+	void			CheckComplete();
+	void			Fail(int error);
+
+	HostJobPool*			m_pool;
+	HostJobChainAttribute	m_attr;
+	mutable std::mutex		m_mutex;
+	std::condition_variable	m_done;
+	State					m_state;
+	const uint64_t*			m_cursor;
+	uint64_t				m_outstanding;	//jobs grabbed and not yet complete
+	uint32_t				m_workers;		//workers attached
+	uint32_t				m_readyCount;
+	int						m_error;
+	bool					m_ended;
+	HostJobChainStats		m_stats;
+};
+
+class HostJobPool
+{
+public:
+					HostJobPool();
+					~HostJobPool();
+
+	int				Initialize(uint32_t workers);
+	void			Finalize();
+	uint32_t		GetWorkerCount() const { return (uint32_t)m_workers.size(); }
+
+	int				CreateJobChain(HostJobChain *chain, const HostJobChainAttribute &attr);
+	int				RemoveJobChain(HostJobChain *chain);
+
+private:
+	friend class HostJobChain;
+
+	struct QueuedJob
+	{
+		const HostJob256*	job;
+		HostJobChain*		chain;
+	};
+
+	struct Worker
+	{
+		uint32_t				index;
+		std::thread				thread;
+		std::mutex				mutex;
+		std::deque<QueuedJob>	queue;			//owner pops the front, thieves the back
+		HostJobChain*			attached;
+		std::vector<uint8_t>	localStore;
+	};
+
+	void			WorkerThread(Worker *worker);
+	bool			PopLocal(Worker *worker, QueuedJob &job);
+	bool			GrabFromChain(Worker *worker);
+	bool			Steal(Worker *worker, QueuedJob &job);
+	void			Detach(Worker *worker);
+	void			Execute(Worker *worker, const QueuedJob &job);
+	void			Notify();
+
+	std::vector<Worker*>			m_workers;
+	std::vector<HostJobChain*>		m_chains;
+	std::mutex						m_mutex;		//m_chains, m_generation and sleeping workers
+	std::condition_variable			m_wake;
+	uint64_t						m_generation;
+	uint32_t						m_nextChain;	//round robin among equal priorities
+	bool							m_exit;
+};
+
+#endif //#ifndef __HOST_JOB_CHAIN_H__
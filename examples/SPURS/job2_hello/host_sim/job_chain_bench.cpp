@@ -0,0 +1,539 @@
+/*
+*  Description:
+*  Checks the host job chain runtime against the SPURS job chain rules, then
+*  measures how a job decomposition scales from 1 to N worker threads.
+*
+*  Build:
+*    g++ -std=c++11 -O2 -pthread host_job_chain.cpp job_chain_bench.cpp -o job_chain_bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "host_job_chain.h"
+
+static const uint8_t PRIORITY_ALL[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+
+static int g_failures = 0;
+
+#define CHECK(expr)																\
+	do {																		\
+		if (!(expr))															\
+		{																		\
+			fprintf(stderr, "FAILED: %s (%s:%d)\n", #expr, __FILE__, __LINE__);	\
+			g_failures++;														\
+		}																		\
+	} while (0)
+
+//
+// Rule checks
+//
+
+struct CheckState
+{
+	std::atomic<uint32_t>	stageDone[8];
+	std::atomic<uint32_t>	active;
+	std::atomic<uint32_t>	maxActive;
+	std::atomic<uint32_t>	orderViolations;
+	std::atomic<uint32_t>	sequence;
+	uint32_t				jobsPerStage;
+};
+
+static CheckState g_check;
+
+static void resetCheck(uint32_t jobsPerStage)
+{
+	for (int i = 0; i < 8; i++)
+		g_check.stageDone[i] = 0;
+	g_check.active = 0;
+	g_check.maxActive = 0;
+	g_check.orderViolations = 0;
+	g_check.sequence = 0;
+	g_check.jobsPerStage = jobsPerStage;
+}
+
+//userData[0] = stage, userData[1] = where to record the sequence number
+static void checkJob(HostJobContext *context, HostJob256 *job)
+{
+	uint32_t stage = (uint32_t)job->workArea.userData[0];
+	uint32_t active = ++g_check.active;
+	uint32_t seen = g_check.maxActive;
+
+	(void)context;
+
+	while (active > seen && !g_check.maxActive.compare_exchange_weak(seen, active))
+		;
+
+	//Everything before the SYNC must have finished...
+	if (stage > 0 && g_check.stageDone[stage - 1] != g_check.jobsPerStage)
+		g_check.orderViolations++;
+
+	std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+	if (job->workArea.userData[1])
+		*(uint32_t*)(uintptr_t)job->workArea.userData[1] = g_check.sequence++;
+
+	g_check.active--;
+	g_check.stageDone[stage]++;
+}
+
+static void initCheckJob(HostJob128 *job, uint32_t stage, uint32_t *sequence)
+{
+	memset(job, 0, sizeof(*job));
+	job->header.entry = checkJob;
+	job->workArea.userData[0] = stage;
+	job->workArea.userData[1] = (uint64_t)(uintptr_t)sequence;
+}
+
+static void checkSyncAndNext(HostJobPool &pool)
+{
+	const uint32_t STAGES = 4;
+	const uint32_t JOBS = 12;
+	static HostJob128 jobs[STAGES][JOBS];
+	static uint64_t first[64] __attribute__((__aligned__(16)));
+	static uint64_t second[64] __attribute__((__aligned__(16)));
+	uint64_t *list = first;
+	uint32_t n = 0;
+
+	resetCheck(JOBS);
+
+	//Stages 0-1 in the first list, 2-3 in the second, joined by NEXT...
+	for (uint32_t stage = 0; stage < STAGES; stage++)
+	{
+		if (stage > 0)
+			list[n++] = HOST_JOB_COMMAND_SYNC;
+
+		if (stage == 2)
+		{
+			list[n++] = HOST_JOB_COMMAND_NEXT(second);
+			list = second;
+			n = 0;
+		}
+
+		for (uint32_t i = 0; i < JOBS; i++)
+		{
+			initCheckJob(&jobs[stage][i], stage, NULL);
+			list[n++] = HOST_JOB_COMMAND_JOB(&jobs[stage][i]);
+		}
+	}
+	list[n++] = HOST_JOB_COMMAND_END;
+
+	HostJobChainAttribute attr;
+	HostJobChain chain;
+	CHECK(hostJobChainAttributeInitialize(&attr, first, sizeof(HostJob128), 4, PRIORITY_ALL, 16, true, 0) == HOST_JOB_OK);
+	CHECK(pool.CreateJobChain(&chain, attr) == HOST_JOB_OK);
+	CHECK(chain.Run() == HOST_JOB_OK);
+	CHECK(chain.Join() == HOST_JOB_OK);
+
+	HostJobChainStats stats = chain.GetStats();
+	CHECK(stats.jobs == STAGES * JOBS);
+	CHECK(stats.syncs == STAGES - 1);
+	CHECK(g_check.orderViolations == 0);
+	for (uint32_t stage = 0; stage < STAGES; stage++)
+		CHECK(g_check.stageDone[stage] == JOBS);
+
+	pool.RemoveJobChain(&chain);
+}
+
+static void checkMaxContention(HostJobPool &pool)
+{
+	const uint32_t JOBS = 32;
+	static HostJob128 jobs[JOBS];
+	static uint64_t list[JOBS + 1] __attribute__((__aligned__(16)));
+
+	resetCheck(JOBS);
+	for (uint32_t i = 0; i < JOBS; i++)
+	{
+		initCheckJob(&jobs[i], 0, NULL);
+		list[i] = HOST_JOB_COMMAND_JOB(&jobs[i]);
+	}
+	list[JOBS] = HOST_JOB_COMMAND_END;
+
+	HostJobChainAttribute attr;
+	HostJobChain chain;
+	CHECK(hostJobChainAttributeInitialize(&attr, list, sizeof(HostJob128), 1, PRIORITY_ALL, 2, true, 0) == HOST_JOB_OK);
+	CHECK(pool.CreateJobChain(&chain, attr) == HOST_JOB_OK);
+	CHECK(chain.Run() == HOST_JOB_OK);
+	CHECK(chain.Join() == HOST_JOB_OK);
+
+	CHECK(g_check.maxActive <= 2);
+	CHECK(chain.GetStats().maxWorkers <= 2);
+	CHECK(chain.GetStats().jobs == JOBS);
+
+	pool.RemoveJobChain(&chain);
+}
+
+static void checkReadyCountAndPriority(HostJobPool &pool)
+{
+	const uint32_t JOBS = 16;
+	static HostJob128 jobsHigh[JOBS], jobsLow[JOBS];
+	static uint64_t listHigh[JOBS + 1] __attribute__((__aligned__(16)));
+	static uint64_t listLow[JOBS + 1] __attribute__((__aligned__(16)));
+	static uint32_t orderHigh[JOBS], orderLow[JOBS];
+	const uint8_t high[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+	const uint8_t low[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	const uint32_t GRAB = 2;
+
+	resetCheck(JOBS * 2);
+	for (uint32_t i = 0; i < JOBS; i++)
+	{
+		initCheckJob(&jobsHigh[i], 0, &orderHigh[i]);
+		initCheckJob(&jobsLow[i], 0, &orderLow[i]);
+		listHigh[i] = HOST_JOB_COMMAND_JOB(&jobsHigh[i]);
+		listLow[i] = HOST_JOB_COMMAND_JOB(&jobsLow[i]);
+	}
+	listHigh[JOBS] = listLow[JOBS] = HOST_JOB_COMMAND_END;
+
+	HostJobChainAttribute attr;
+	HostJobChain chainHigh, chainLow;
+
+	//A fixed ready count of 0 holds a running chain back...
+	CHECK(hostJobChainAttributeInitialize(&attr, listHigh, sizeof(HostJob128), GRAB, high, 1, false, 0) == HOST_JOB_OK);
+	CHECK(pool.CreateJobChain(&chainHigh, attr) == HOST_JOB_OK);
+	CHECK(hostJobChainAttributeInitialize(&attr, listLow, sizeof(HostJob128), GRAB, low, 1, false, 0) == HOST_JOB_OK);
+	CHECK(pool.CreateJobChain(&chainLow, attr) == HOST_JOB_OK);
+	CHECK(chainLow.Run() == HOST_JOB_OK);
+	CHECK(chainHigh.Run() == HOST_JOB_OK);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(chainHigh.GetStats().jobs == 0 && chainLow.GetStats().jobs == 0);
+
+	//With one worker each, the higher priority chain should win every grab
+	//once both are ready; at most one grab of the low chain can sneak in...
+	CHECK(chainLow.SetReadyCount(1) == HOST_JOB_OK);
+	CHECK(chainHigh.SetReadyCount(1) == HOST_JOB_OK);
+	CHECK(chainHigh.Join() == HOST_JOB_OK);
+	CHECK(chainLow.Join() == HOST_JOB_OK);
+
+	if (pool.GetWorkerCount() == 1)
+	{
+		uint32_t lastHigh = 0, lowBefore = 0;
+		for (uint32_t i = 0; i < JOBS; i++)
+			lastHigh = orderHigh[i] > lastHigh ? orderHigh[i] : lastHigh;
+		for (uint32_t i = 0; i < JOBS; i++)
+			lowBefore += orderLow[i] < lastHigh ? 1 : 0;
+		CHECK(lowBefore <= GRAB);
+	}
+
+	CHECK(chainHigh.GetStats().maxWorkers <= 1 && chainLow.GetStats().maxWorkers <= 1);
+
+	pool.RemoveJobChain(&chainHigh);
+	pool.RemoveJobChain(&chainLow);
+}
+
+static void checkBadJob(HostJobPool &pool)
+{
+	static HostJob128 jobs[3];
+	static uint64_t list[8] __attribute__((__aligned__(16)));
+
+	resetCheck(3);
+	initCheckJob(&jobs[0], 0, NULL);
+	initCheckJob(&jobs[1], 0, NULL);
+	initCheckJob(&jobs[2], 0, NULL);
+	jobs[1].header.entry = NULL;
+
+	list[0] = HOST_JOB_COMMAND_JOB(&jobs[0]);
+	list[1] = HOST_JOB_COMMAND_SYNC;
+	list[2] = HOST_JOB_COMMAND_JOB(&jobs[1]);
+	list[3] = HOST_JOB_COMMAND_JOB(&jobs[2]);
+	list[4] = HOST_JOB_COMMAND_END;
+
+	HostJobChainAttribute attr;
+	HostJobChain chain;
+	CHECK(hostJobChainAttributeInitialize(&attr, list, sizeof(HostJob128), 4, PRIORITY_ALL, 4, true, 0) == HOST_JOB_OK);
+	CHECK(pool.CreateJobChain(&chain, attr) == HOST_JOB_OK);
+	CHECK(chain.Run() == HOST_JOB_OK);
+	CHECK(chain.Join() == HOST_JOB_ERROR_INVAL);
+	CHECK(chain.GetStats().jobs == 1);
+
+	pool.RemoveJobChain(&chain);
+}
+
+static bool runChecks(uint32_t workers)
+{
+	HostJobPool pool;
+	int before = g_failures;
+
+	if (pool.Initialize(workers) != HOST_JOB_OK)
+		return false;
+
+	checkSyncAndNext(pool);
+	checkMaxContention(pool);
+	checkReadyCountAndPriority(pool);
+	checkBadJob(pool);
+
+	pool.Finalize();
+	return g_failures == before;
+}
+
+//
+// Scaling benchmark
+//
+// Stage 0 jobs each stream sizeInput bytes through the DMA list and reduce
+// them with a configurable amount of arithmetic; stage 1 jobs combine the
+// partial results, after a SYNC, as a typical two pass decomposition would.
+//
+
+struct BenchConfig
+{
+	uint32_t	jobs;
+	uint32_t	inputKB;
+	uint32_t	passes;
+	uint32_t	grab;
+	uint32_t	maxWorkers;
+	uint32_t	repeat;
+};
+
+static BenchConfig g_bench;
+
+//userData after the DMA list: [0] = output address, [1] = passes
+static void reduceJob(HostJobContext *context, HostJob256 *job)
+{
+	const uint64_t *userData = &job->workArea.userData[job->header.sizeDmaList / 8];
+	const uint32_t *input = (const uint32_t*)context->ioBuffer;
+	uint32_t count = context->sizeIo / 4;
+	uint32_t passes = (uint32_t)userData[1];
+	uint64_t sum = 0;
+
+	for (uint32_t pass = 0; pass < passes; pass++)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			sum = sum * 31 + (input[i] ^ pass);
+	}
+
+	*(uint64_t*)(uintptr_t)userData[0] = sum;
+}
+
+//userData[0] = partials, [1] = count, [2] = output
+static void combineJob(HostJobContext *context, HostJob256 *job)
+{
+	const uint64_t *partials = (const uint64_t*)(uintptr_t)job->workArea.userData[0];
+	uint32_t count = (uint32_t)job->workArea.userData[1];
+	uint64_t total = 0;
+
+	(void)context;
+
+	for (uint32_t i = 0; i < count; i++)
+		total += partials[i];
+
+	*(uint64_t*)(uintptr_t)job->workArea.userData[2] = total;
+}
+
+static uint64_t referenceReduce(const uint32_t *input, uint32_t count, uint32_t passes)
+{
+	uint64_t sum = 0;
+
+	for (uint32_t pass = 0; pass < passes; pass++)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			sum = sum * 31 + (input[i] ^ pass);
+	}
+
+	return sum;
+}
+
+static bool runBenchmark()
+{
+	const uint32_t ELEMENT = 4 * 1024;
+	const uint32_t COMBINE = 64;							//partials per combine job
+	uint32_t elements = (g_bench.inputKB * 1024) / ELEMENT;
+	uint32_t inputWords = g_bench.inputKB * 1024 / 4;
+	uint32_t combineJobs = (g_bench.jobs + COMBINE - 1) / COMBINE;
+
+	std::vector<uint32_t> input((size_t)g_bench.jobs * inputWords + 4);
+	uint32_t *data = (uint32_t*)(((uintptr_t)&input[0] + 15) & ~(uintptr_t)15);
+	for (size_t i = 0; i < (size_t)g_bench.jobs * inputWords; i++)
+		data[i] = (uint32_t)(i * 2654435761u);
+
+	std::vector<HostJob128> jobs(g_bench.jobs + combineJobs);
+	std::vector<uint64_t> partials(g_bench.jobs);
+	std::vector<uint64_t> totals(combineJobs);
+	std::vector<uint64_t> list(g_bench.jobs + combineJobs + 4);
+	uint64_t *commands = &list[0];
+	uint32_t n = 0;
+
+	for (uint32_t j = 0; j < g_bench.jobs; j++)
+	{
+		HostJob128 &job = jobs[j];
+		const uint32_t *base = data + (size_t)j * inputWords;
+
+		memset(&job, 0, sizeof(job));
+		job.header.entry = reduceJob;
+		job.header.sizeDmaList = (uint16_t)(elements * 8);
+		job.header.sizeInOrInOut = elements * ELEMENT;
+		for (uint32_t e = 0; e < elements; e++)
+			job.workArea.dmaList[e] = HOST_JOB_DMA_ELEMENT(base + e * (ELEMENT / 4), ELEMENT);
+		job.workArea.userData[elements] = (uint64_t)(uintptr_t)&partials[j];
+		job.workArea.userData[elements + 1] = g_bench.passes;
+		commands[n++] = HOST_JOB_COMMAND_JOB(&job);
+	}
+
+	commands[n++] = HOST_JOB_COMMAND_SYNC;
+
+	for (uint32_t c = 0; c < combineJobs; c++)
+	{
+		HostJob128 &job = jobs[g_bench.jobs + c];
+		uint32_t first = c * COMBINE;
+
+		memset(&job, 0, sizeof(job));
+		job.header.entry = combineJob;
+		job.workArea.userData[0] = (uint64_t)(uintptr_t)&partials[first];
+		job.workArea.userData[1] = std::min(COMBINE, g_bench.jobs - first);
+		job.workArea.userData[2] = (uint64_t)(uintptr_t)&totals[c];
+		commands[n++] = HOST_JOB_COMMAND_JOB(&job);
+	}
+
+	commands[n++] = HOST_JOB_COMMAND_END;
+
+	//Expected result, computed once on this thread...
+	uint64_t expected = 0;
+	for (uint32_t j = 0; j < g_bench.jobs; j++)
+		expected += referenceReduce(data + (size_t)j * inputWords, inputWords, g_bench.passes);
+
+	printf("jobs=%u+%u input=%uKB/job passes=%u grab=%u\n\n", g_bench.jobs, combineJobs, g_bench.inputKB, g_bench.passes, g_bench.grab);
+	printf("%8s %10s %12s %9s %11s %8s %8s %8s\n", "workers", "ms", "jobs/s", "speedup", "efficiency", "grabs", "steals", "maxwkr");
+
+	double baseline = 0.0;
+	bool ok = true;
+
+	for (uint32_t workers = 1; workers <= g_bench.maxWorkers; workers++)
+	{
+		HostJobPool pool;
+		HostJobChain chain;
+		HostJobChainAttribute attr;
+		HostJobChainStats stats;
+		double best = 0.0;
+
+		memset(&stats, 0, sizeof(stats));
+		pool.Initialize(workers);
+		hostJobChainAttributeInitialize(&attr, commands, sizeof(HostJob128), g_bench.grab, PRIORITY_ALL, workers, true, 0);
+		pool.CreateJobChain(&chain, attr);
+
+		for (uint32_t r = 0; r < g_bench.repeat; r++)
+		{
+			std::fill(totals.begin(), totals.end(), 0);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			chain.Run();
+			int error = chain.Join();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+			uint64_t total = 0;
+			for (uint32_t c = 0; c < combineJobs; c++)
+				total += totals[c];
+
+			if (error != HOST_JOB_OK || total != expected)
+			{
+				fprintf(stderr, "Run with %u workers produced the wrong result (error %d)\n", workers, error);
+				ok = false;
+			}
+
+			if (r == 0 || ms < best)
+			{
+				best = ms;
+				stats = chain.GetStats();
+			}
+		}
+
+		pool.RemoveJobChain(&chain);
+		pool.Finalize();
+
+		if (workers == 1)
+			baseline = best;
+
+		double speedup = best > 0.0 ? baseline / best : 0.0;
+		printf("%8u %10.2f %12.0f %8.2fx %10.0f%% %8llu %8llu %8u\n",
+			workers,
+			best,
+			best > 0.0 ? (g_bench.jobs + combineJobs) * 1000.0 / best : 0.0,
+			speedup,
+			speedup * 100.0 / workers,
+			(unsigned long long)stats.grabs,
+			(unsigned long long)stats.steals,
+			stats.maxWorkers);
+	}
+
+	return ok;
+}
+
+static void usage()
+{
+	printf("job_chain_bench [options]\n");
+	printf("  -jobs <n>      stage 0 jobs (default 4096)\n");
+	printf("  -input <KB>    input streamed per job, multiple of 4, at most 40 (default 16)\n");
+	printf("  -passes <n>    arithmetic passes over each input (default 4)\n");
+	printf("  -grab <n>      max grabbed jobs, 1-%d (default 4)\n", HOST_JOB_MAX_GRAB);
+	printf("  -workers <n>   largest pool to measure (default: hardware threads)\n");
+	printf("  -repeat <n>    runs per pool size, best is reported (default 3)\n");
+	printf("  -nocheck       skip the rule checks\n");
+}
+
+int main(int argc, char **argv)
+{
+	bool check = true;
+
+	g_bench.jobs = 4096;
+	g_bench.inputKB = 16;
+	g_bench.passes = 4;
+	g_bench.grab = 4;
+	g_bench.maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+	g_bench.repeat = 3;
+
+	for (int i = 1; i < argc; i++)
+	{
+		uint32_t *value = NULL;
+
+		if (!strcmp(argv[i], "-jobs"))				value = &g_bench.jobs;
+		else if (!strcmp(argv[i], "-input"))		value = &g_bench.inputKB;
+		else if (!strcmp(argv[i], "-passes"))		value = &g_bench.passes;
+		else if (!strcmp(argv[i], "-grab"))			value = &g_bench.grab;
+		else if (!strcmp(argv[i], "-workers"))		value = &g_bench.maxWorkers;
+		else if (!strcmp(argv[i], "-repeat"))		value = &g_bench.repeat;
+		else if (!strcmp(argv[i], "-nocheck"))		check = false;
+		else
+		{
+			usage();
+			return 1;
+		}
+
+		if (value)
+		{
+			if (++i == argc)
+			{
+				usage();
+				return 1;
+			}
+			*value = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+
+	//The DMA list and two user words must fit the 96 byte work area...
+	if (!g_bench.jobs || !g_bench.maxWorkers || !g_bench.repeat || g_bench.grab < 1 || g_bench.grab > HOST_JOB_MAX_GRAB
+		|| g_bench.inputKB < 4 || (g_bench.inputKB & 3) || g_bench.inputKB > 40)
+	{
+		fprintf(stderr, "Invalid configuration\n");
+		return 1;
+	}
+
+	if (check)
+	{
+		const uint32_t sizes[] = {1, 2, g_bench.maxWorkers};
+
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		{
+			if (!runChecks(sizes[i]))
+			{
+				fprintf(stderr, "Rule checks failed with %u workers\n", sizes[i]);
+				return 1;
+			}
+		}
+		printf("Rule checks passed\n\n");
+	}
+
+	return runBenchmark() ? 0 : 1;
+}
@@ -0,0 +1,520 @@
+/*
+*  Description:
+*  Host simulation of the simple policy module scheduler (pm_scheduler.h).
+*  Each SPU is a host thread with its own local store; the reservation line
+*  is shared between threads and the MFC is modelled per SPU, so claim
+*  contention, code reloads and prefetch overlap can be measured without
+*  hardware. Time is modelled per SPU (atomic and DMA latency, DMA bandwidth
+*  and program run time) and throughput is reported against that clock.
+*
+*  Build:
+*    g++ -std=c++11 -O2 -pthread -I../spurs_policy_module pm_host_sim.cpp -o pm_host_sim
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+struct SimSpu;
+static int		sim_getllar(void *ls, uint64_t ea);
+static int		sim_putllc(const void *ls, uint64_t ea);
+static void		sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag);
+static void		sim_wait(uint32_t tag);
+
+#define PM_GETLLAR(ls, ea)				sim_getllar((ls), (ea))
+#define PM_PUTLLC(ls, ea)				sim_putllc((ls), (ea))
+#define PM_GET(ls, ea, size, tag)		sim_get((ls), (ea), (size), (tag))
+#define PM_WAIT(tag)					sim_wait(tag)
+
+#include "pm_scheduler.h"
+
+static const uint32_t LS_SIZE				= 256 * 1024;
+static const uint32_t PROGRAM_START			= 16 * 1024;
+static const uint32_t PROGRAM_SLOT_SIZE		= 64 * 1024;
+static const uint64_t EA_BASE				= 0x10000;
+static const uint32_t BINARY_MAGIC			= 0x53504d42;		// 'SPMB'
+
+struct SimConfig
+{
+	uint32_t	spus;
+	uint32_t	programs;
+	uint32_t	batch;
+	uint32_t	binaries;
+	uint32_t	bin_size;
+	uint32_t	work_ns;
+	uint32_t	dma_latency_ns;
+	uint32_t	dma_bytes_per_ns;
+	uint32_t	atomic_ns;
+	uint32_t	contend;		// yield inside the reservation window
+	uint32_t	mixed;			// binary 0 spills over both code slots
+};
+
+// Header the fake binaries carry at the entry point offset.
+struct BinaryHeader
+{
+	uint32_t	magic;
+	uint32_t	binary_id;
+	uint32_t	work_ns;
+	uint32_t	pad;
+};
+
+struct PendingDma
+{
+	void*		ls;
+	uint64_t	ea;
+	uint32_t	size;
+	uint32_t	tag;
+	uint64_t	done;
+};
+
+struct SimSpu
+{
+	std::vector<uint8_t>	ls;
+	std::vector<PendingDma>	pending;
+	uint64_t				clock;			// Modelled nanoseconds
+	uint64_t				dma_busy;		// When the MFC can start the next transfer
+	uint64_t				dma_bytes;
+	uint64_t				reservation;	// Line version seen by the last getllar
+	uint64_t				errors;
+	PmScheduler				scheduler;
+};
+
+static SimConfig					g_config;
+static std::vector<uint8_t>			g_memory;				// Main memory from EA_BASE
+static uint64_t						g_ea_pm;
+static std::atomic<uint64_t>		g_line_version;			// Odd while a putllc is writing
+static std::atomic<uint64_t>		g_line[128 / 8];
+static std::vector<uint32_t>		g_expected;				// Binary id per program arg
+static std::atomic<uint32_t>*		g_runs;
+static thread_local SimSpu*			t_spu;
+
+// PmScheduler is 128 byte aligned, which new only honours from C++17.
+static SimSpu* new_spu()
+{
+	void *p = NULL;
+	if (posix_memalign(&p, alignof(SimSpu), sizeof(SimSpu)) != 0)
+		return NULL;
+	return new (p) SimSpu();
+}
+
+static void delete_spu(SimSpu *spu)
+{
+	spu->~SimSpu();
+	free(spu);
+}
+
+static uint8_t* ea_to_host(uint64_t ea, uint32_t size)
+{
+	if (ea < EA_BASE || ea - EA_BASE + size > g_memory.size())
+	{
+		fprintf(stderr, "DMA outside main memory: ea=%llx size=%x\n", (unsigned long long)ea, size);
+		abort();
+	}
+	return &g_memory[(size_t)(ea - EA_BASE)];
+}
+
+static int sim_getllar(void *ls, uint64_t ea)
+{
+	uint64_t words[128 / 8];
+	uint64_t version;
+	uint32_t i;
+
+	if (ea != g_ea_pm)
+		abort();
+
+	for (;;)
+	{
+		version = g_line_version.load(std::memory_order_acquire);
+		if (version & 1)
+			continue;
+		for (i = 0; i < 128 / 8; i++)
+			words[i] = g_line[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (g_line_version.load(std::memory_order_relaxed) == version)
+			break;
+	}
+
+	memcpy(ls, words, sizeof(words));
+	t_spu->reservation = version;
+	t_spu->clock += g_config.atomic_ns;
+
+	if (g_config.contend)
+		std::this_thread::yield();
+
+	return 0;
+}
+
+static int sim_putllc(const void *ls, uint64_t ea)
+{
+	uint64_t words[128 / 8];
+	uint64_t version = t_spu->reservation;
+	uint32_t i;
+
+	if (ea != g_ea_pm)
+		abort();
+
+	t_spu->clock += g_config.atomic_ns;
+
+	if (!g_line_version.compare_exchange_strong(version, version + 1, std::memory_order_acquire))
+		return 1;
+
+	memcpy(words, ls, sizeof(words));
+	for (i = 0; i < 128 / 8; i++)
+		g_line[i].store(words[i], std::memory_order_relaxed);
+	g_line_version.store(version + 2, std::memory_order_release);
+
+	return 0;
+}
+
+// The copy is only made when the tag is waited on, so a missing PM_WAIT
+// shows up as stale local store.
+static void sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag)
+{
+	SimSpu *spu = t_spu;
+	PendingDma dma;
+	uint64_t start = spu->clock > spu->dma_busy ? spu->clock : spu->dma_busy;
+	uint64_t transfer = (size + g_config.dma_bytes_per_ns - 1) / g_config.dma_bytes_per_ns;
+
+	//The scheduler itself stands in for the policy module's own local store...
+	bool in_ls = (uint8_t*)ls >= &spu->ls[0] && (uint8_t*)ls + size <= &spu->ls[0] + LS_SIZE;
+	bool in_scheduler = (uint8_t*)ls >= (uint8_t*)&spu->scheduler && (uint8_t*)ls + size <= (uint8_t*)(&spu->scheduler + 1);
+	if (!in_ls && !in_scheduler)
+	{
+		fprintf(stderr, "DMA outside local store\n");
+		abort();
+	}
+
+	dma.ls = ls;
+	dma.ea = ea;
+	dma.size = size;
+	dma.tag = tag;
+	dma.done = start + transfer + g_config.dma_latency_ns;
+	spu->dma_busy = start + transfer;
+	spu->dma_bytes += size;
+	spu->pending.push_back(dma);
+}
+
+static void sim_wait(uint32_t tag)
+{
+	SimSpu *spu = t_spu;
+	size_t i = 0;
+
+	while (i < spu->pending.size())
+	{
+		PendingDma &dma = spu->pending[i];
+		if (dma.tag != tag)
+		{
+			i++;
+			continue;
+		}
+
+		memcpy(dma.ls, ea_to_host(dma.ea, dma.size), dma.size);
+		if (dma.done > spu->clock)
+			spu->clock = dma.done;
+		spu->pending.erase(spu->pending.begin() + i);
+	}
+}
+
+static void execute_program(SimSpu *spu, const SimplePolicyModuleProgram *program, void *code)
+{
+	BinaryHeader header;
+
+	memcpy(&header, (uint8_t*)code + 0x10, sizeof(header));
+
+	//The whole binary, so a slot overwritten past the header is caught too...
+	if (program->arg >= g_config.programs || header.magic != BINARY_MAGIC || header.binary_id != g_expected[program->arg]
+		|| memcmp(code, ea_to_host(program->ea_bin, program->bin_size), program->bin_size) != 0)
+	{
+		spu->errors++;
+		return;
+	}
+
+	g_runs[program->arg].fetch_add(1, std::memory_order_relaxed);
+	spu->clock += header.work_ns;
+}
+
+static void spu_thread(SimSpu *spu, int optimized)
+{
+	const SimplePolicyModuleProgram *program;
+	void *code;
+
+	t_spu = spu;
+
+	spu->scheduler.residency = optimized;
+	spu->scheduler.prefetch = optimized;
+	pm_scheduler_init(&spu->scheduler, g_ea_pm, &spu->ls[PROGRAM_START], &spu->ls[PROGRAM_START + PROGRAM_SLOT_SIZE], PROGRAM_SLOT_SIZE);
+
+	while ((program = pm_scheduler_next(&spu->scheduler, &code)) != NULL)
+		execute_program(spu, program, code);
+
+	if (!spu->pending.empty())
+		spu->errors++;
+}
+
+struct SimResult
+{
+	uint64_t			makespan_ns;
+	double				wall_ms;
+	uint64_t			dma_bytes;
+	uint64_t			errors;
+	PmSchedulerStats	stats;
+};
+
+// Binary 0 of a mixed run is larger than a code slot, so it loads over
+// both of them.
+static uint32_t binary_size(uint32_t id)
+{
+	if (g_config.mixed && id == 0)
+		return PROGRAM_SLOT_SIZE + g_config.bin_size;
+	return g_config.bin_size;
+}
+
+static void setup_memory()
+{
+	uint32_t programs_offset = 128;
+	uint32_t bins_offset = (programs_offset + g_config.programs * sizeof(SimplePolicyModuleProgram) + 127) & ~127;
+	std::vector<uint32_t> offsets(g_config.binaries);
+	uint32_t size = bins_offset;
+	uint32_t i;
+
+	for (i = 0; i < g_config.binaries; i++)
+	{
+		offsets[i] = size;
+		size += (binary_size(i) + 15) & ~15;
+	}
+
+	g_memory.assign(size, 0);
+	g_expected.assign(g_config.programs, 0);
+
+	for (i = 0; i < g_config.binaries; i++)
+	{
+		BinaryHeader header;
+		uint8_t *bin = &g_memory[offsets[i]];
+		uint32_t bin_size = binary_size(i);
+		uint32_t j;
+
+		//A pattern that differs along the binary, so a partial overwrite shows...
+		for (j = 0; j < bin_size; j++)
+			bin[j] = (uint8_t)((0xa5 ^ i) + j / 4096);
+		header.magic = BINARY_MAGIC;
+		header.binary_id = i;
+		header.work_ns = g_config.work_ns;
+		header.pad = 0;
+		memcpy(bin + 0x10, &header, sizeof(header));
+	}
+
+	SimplePolicyModuleProgram *programs = (SimplePolicyModuleProgram*)&g_memory[programs_offset];
+	for (i = 0; i < g_config.programs; i++)
+	{
+		//Runs of programs share a binary, as a job list would; a mixed run
+		//interleaves them so the large binary comes round between small ones...
+		uint32_t id = g_config.mixed ? i % g_config.binaries : (uint32_t)((uint64_t)i * g_config.binaries / g_config.programs);
+		programs[i].ea_bin = EA_BASE + offsets[id];
+		programs[i].bin_size = binary_size(id);
+		programs[i].arg = i;
+		g_expected[i] = id;
+	}
+
+	SimplePolicyModule pm;
+	memset(&pm, 0, sizeof(pm));
+	pm.ea_programs = EA_BASE + programs_offset;
+	pm.num_programs = g_config.programs;
+	pm.batch = (uint8_t)g_config.batch;
+
+	uint64_t words[128 / 8];
+	memcpy(words, &pm, sizeof(words));
+	for (i = 0; i < 128 / 8; i++)
+		g_line[i].store(words[i]);
+	g_line_version.store(0);
+	g_ea_pm = EA_BASE;
+}
+
+static bool run(int optimized, SimResult &result)
+{
+	std::vector<SimSpu*> spus;
+	std::vector<std::thread> threads;
+	uint32_t i;
+	bool ok = true;
+
+	setup_memory();
+	g_runs = new std::atomic<uint32_t>[g_config.programs];
+	for (i = 0; i < g_config.programs; i++)
+		g_runs[i].store(0);
+
+	for (i = 0; i < g_config.spus; i++)
+	{
+		SimSpu *spu = new_spu();
+		if (!spu)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		spu->ls.assign(LS_SIZE, 0);
+		spu->clock = 0;
+		spu->dma_busy = 0;
+		spu->dma_bytes = 0;
+		spu->reservation = 0;
+		spu->errors = 0;
+		spus.push_back(spu);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (i = 0; i < g_config.spus; i++)
+		threads.push_back(std::thread(spu_thread, spus[i], optimized));
+	for (i = 0; i < g_config.spus; i++)
+		threads[i].join();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	memset(&result, 0, sizeof(result));
+	result.wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	for (i = 0; i < g_config.spus; i++)
+	{
+		const PmSchedulerStats &stats = spus[i]->scheduler.stats;
+
+		if (spus[i]->clock > result.makespan_ns)
+			result.makespan_ns = spus[i]->clock;
+		result.dma_bytes += spus[i]->dma_bytes;
+		result.errors += spus[i]->errors;
+		result.stats.claims += stats.claims;
+		result.stats.claim_retries += stats.claim_retries;
+		result.stats.programs += stats.programs;
+		result.stats.code_loads += stats.code_loads;
+		result.stats.code_prefetched += stats.code_prefetched;
+		result.stats.code_resident += stats.code_resident;
+		delete_spu(spus[i]);
+	}
+
+	for (i = 0; i < g_config.programs; i++)
+	{
+		if (g_runs[i].load() != 1)
+		{
+			fprintf(stderr, "Program %u ran %u times\n", i, g_runs[i].load());
+			ok = false;
+		}
+	}
+	delete[] g_runs;
+
+	if (result.errors)
+	{
+		fprintf(stderr, "%llu programs ran with the wrong code\n", (unsigned long long)result.errors);
+		ok = false;
+	}
+
+	return ok;
+}
+
+static void print_result(const char *name, const SimResult &result)
+{
+	double programs_per_ms = result.makespan_ns ? (double)g_config.programs * 1e6 / (double)result.makespan_ns : 0.0;
+
+	printf("%-10s %12.3f %12.1f %8u %8u %8u %10u %9u %10.1f %9.2f\n",
+		name,
+		(double)result.makespan_ns / 1e6,
+		programs_per_ms,
+		result.stats.claims,
+		result.stats.claim_retries,
+		result.stats.code_loads,
+		result.stats.code_prefetched,
+		result.stats.code_resident,
+		(double)result.dma_bytes / 1024.0,
+		result.wall_ms);
+}
+
+static void usage()
+{
+	printf("pm_host_sim [options]\n");
+	printf("  -spus <n>        SPUs (threads) running the policy module (default 6)\n");
+	printf("  -programs <n>    programs in the queue (default 128)\n");
+	printf("  -batch <n>       programs claimed per atomic update, 1-%d (default %d)\n", PM_MAX_BATCH, PM_DEFAULT_BATCH);
+	printf("  -binaries <n>    distinct program binaries (default 1)\n");
+	printf("  -binsize <n>     bytes per binary (default 16384)\n");
+	printf("  -work <ns>       run time of each program (default 20000)\n");
+	printf("  -latency <ns>    DMA latency (default 500)\n");
+	printf("  -bandwidth <n>   DMA bytes per ns (default 25)\n");
+	printf("  -atomic <ns>     getllar/putllc latency (default 300)\n");
+	printf("  -contend         yield inside the reservation window to force retries\n");
+	printf("  -mixed           make binary 0 larger than a code slot and interleave the binaries\n");
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	g_config.spus = 6;
+	g_config.programs = 128;
+	g_config.batch = PM_DEFAULT_BATCH;
+	g_config.binaries = 1;
+	g_config.bin_size = 16 * 1024;
+	g_config.work_ns = 20000;
+	g_config.dma_latency_ns = 500;
+	g_config.dma_bytes_per_ns = 25;
+	g_config.atomic_ns = 300;
+	g_config.contend = 0;
+	g_config.mixed = 0;
+
+	for (i = 1; i < argc; i++)
+	{
+		uint32_t *value = NULL;
+
+		if (!strcmp(argv[i], "-spus"))				value = &g_config.spus;
+		else if (!strcmp(argv[i], "-programs"))		value = &g_config.programs;
+		else if (!strcmp(argv[i], "-batch"))		value = &g_config.batch;
+		else if (!strcmp(argv[i], "-binaries"))		value = &g_config.binaries;
+		else if (!strcmp(argv[i], "-binsize"))		value = &g_config.bin_size;
+		else if (!strcmp(argv[i], "-work"))			value = &g_config.work_ns;
+		else if (!strcmp(argv[i], "-latency"))		value = &g_config.dma_latency_ns;
+		else if (!strcmp(argv[i], "-bandwidth"))	value = &g_config.dma_bytes_per_ns;
+		else if (!strcmp(argv[i], "-atomic"))		value = &g_config.atomic_ns;
+		else if (!strcmp(argv[i], "-contend"))		g_config.contend = 1;
+		else if (!strcmp(argv[i], "-mixed"))		g_config.mixed = 1;
+		else
+		{
+			usage();
+			return 1;
+		}
+
+		if (value)
+		{
+			if (++i == argc)
+			{
+				usage();
+				return 1;
+			}
+			*value = (uint32_t)strtoul(argv[i], NULL, 0);
+		}
+	}
+
+	if (!g_config.spus || !g_config.programs || !g_config.binaries || !g_config.dma_bytes_per_ns
+		|| g_config.batch < 1 || g_config.batch > PM_MAX_BATCH
+		|| g_config.bin_size < 0x10 + sizeof(BinaryHeader) || binary_size(0) > LS_SIZE - PROGRAM_START - 16 * 1024
+		|| (g_config.mixed && (g_config.binaries < 2 || g_config.bin_size > PROGRAM_SLOT_SIZE)))
+	{
+		fprintf(stderr, "Invalid configuration\n");
+		return 1;
+	}
+
+	printf("spus=%u programs=%u batch=%u binaries=%u binsize=%u work=%uns latency=%uns bandwidth=%uB/ns atomic=%uns%s%s\n\n",
+		g_config.spus, g_config.programs, g_config.batch, g_config.binaries, g_config.bin_size, g_config.work_ns,
+		g_config.dma_latency_ns, g_config.dma_bytes_per_ns, g_config.atomic_ns, g_config.contend ? " contend" : "",
+		g_config.mixed ? " mixed" : "");
+	printf("%-10s %12s %12s %8s %8s %8s %10s %9s %10s %9s\n",
+		"", "model ms", "progs/ms", "claims", "retries", "loads", "prefetched", "resident", "DMA KB", "wall ms");
+
+	SimResult baseline, optimized;
+	bool ok = run(0, baseline);
+	print_result("baseline", baseline);
+	ok = run(1, optimized) && ok;
+	print_result("batched", optimized);
+
+	if (optimized.makespan_ns)
+		printf("\nspeedup %.2fx\n", (double)baseline.makespan_ns / (double)optimized.makespan_ns);
+
+	return ok ? 0 : 1;
+}
@@ -90,6 +90,7 @@ int runSpursSample(CellSpurs *spurs)
 	simple_pm->queue = queue;
 	simple_pm->port = port;
 	simple_pm->debug = DEBUG_POLICY_MODULE;
+	simple_pm->batch = PM_DEFAULT_BATCH;
 
 	static uint8_t priority[8] = {15, 15, 15, 15, 15, 15, 15, 15};
 
@@ -0,0 +1,261 @@
+#ifndef __PM_SCHEDULER_H__
+#define __PM_SCHEDULER_H__
+
+// Program scheduling for the simple policy module, written against a small
+// set of primitives so it builds both for the SPU and as portable C++ for
+// the host simulation in host_sim/. The includer defines:
+//
+//	PM_GETLLAR(ls, ea)				load the 128 byte line at ea and take a reservation
+//	PM_PUTLLC(ls, ea)				store it if the reservation held; non-zero if it was lost
+//	PM_GET(ls, ea, size, tag)		start a DMA from main memory into local store
+//	PM_WAIT(tag)					wait for all DMAs on tag
+//
+// Programs are claimed PM_MAX_BATCH at most per atomic update, and the next
+// batch is claimed as soon as the current one starts so its descriptors
+// arrive while programs run. Program code is position independent, so there
+// are two code slots: a program whose binary is already in either slot runs
+// without a reload, and the next program's code is fetched into the idle
+// slot on PM_TAG_PREFETCH while the current one runs.
+
+#include <string.h>
+#include "policy_module.h"
+
+#define PM_TAG_LOAD			3
+#define PM_TAG_PREFETCH		4
+
+#define PM_CODE_SLOTS		2
+
+typedef struct PmSchedulerStats
+{
+	uint32_t claims;				//atomic updates that claimed programs
+	uint32_t claim_retries;			//reservations lost to another SPU
+	uint32_t programs;
+	uint32_t code_loads;			//blocking code loads
+	uint32_t code_prefetched;		//code fetched while the previous program ran
+	uint32_t code_resident;			//programs whose code was already loaded
+
+} PmSchedulerStats;
+
+typedef struct PmScheduler
+{
+	SimplePolicyModule			pm;		//local copy of the reservation line
+	SimplePolicyModuleProgram	batch[2][PM_MAX_BATCH];
+	uint32_t					count[2];
+	uint32_t					current;
+	uint32_t					index;
+	uint32_t					max_batch;
+	uint64_t					ea_pm;
+
+	void*						slot[PM_CODE_SLOTS];
+	uint32_t					slot_capacity;
+	uint64_t					slot_ea[PM_CODE_SLOTS];
+	uint32_t					slot_size[PM_CODE_SLOTS];
+	uint32_t					slot_pending;	//mask of slots with a prefetch in flight
+	uint32_t					slot_prefetched;	//mask of slots prefetched but not yet run
+	uint32_t					last_slot;
+
+	int							residency;		//skip reloads of resident code
+	int							prefetch;		//claim ahead and fetch code ahead
+
+	PmSchedulerStats			stats;
+
+} PmScheduler __attribute__((__aligned__(128)));
+
+static inline uint32_t pm_code_size(const SimplePolicyModuleProgram *program)
+{
+	return (program->bin_size + 15) & ~15;
+}
+
+// Claims up to max_batch programs and starts fetching their descriptors
+// into batch[buffer] on PM_TAG_PREFETCH.
+static inline uint32_t pm_claim(PmScheduler *s, uint32_t buffer)
+{
+	uint32_t count;
+	uint64_t ea;
+
+	for (;;)
+	{
+		PM_GETLLAR(&s->pm, s->ea_pm);
+
+		count = s->pm.num_programs < s->max_batch ? s->pm.num_programs : s->max_batch;
+		if (count == 0)
+			break;
+
+		ea = s->pm.ea_programs;
+		s->pm.ea_programs += count * sizeof(SimplePolicyModuleProgram);
+		s->pm.num_programs -= count;
+
+		if (!PM_PUTLLC(&s->pm, s->ea_pm))
+			break;
+
+		s->stats.claim_retries++;
+	}
+
+	s->count[buffer] = count;
+	if (count)
+	{
+		s->stats.claims++;
+		PM_GET(s->batch[buffer], ea, count * sizeof(SimplePolicyModuleProgram), PM_TAG_PREFETCH);
+	}
+
+	return count;
+}
+
+static inline void pm_scheduler_init(PmScheduler *s, uint64_t ea_pm, void *slot0, void *slot1, uint32_t slot_capacity)
+{
+	memset(&s->stats, 0, sizeof(s->stats));
+
+	s->ea_pm = ea_pm;
+	s->slot[0] = slot0;
+	s->slot[1] = slot1;
+	s->slot_capacity = slot_capacity;
+	s->slot_ea[0] = s->slot_ea[1] = 0;
+	s->slot_size[0] = s->slot_size[1] = 0;
+	s->slot_pending = 0;
+	s->slot_prefetched = 0;
+	s->last_slot = 1;
+	s->current = 0;
+	s->index = 0;
+
+	PM_GETLLAR(&s->pm, s->ea_pm);
+	s->max_batch = s->pm.batch ? s->pm.batch : PM_DEFAULT_BATCH;
+	if (s->max_batch > PM_MAX_BATCH)
+		s->max_batch = PM_MAX_BATCH;
+	if (!s->prefetch)
+		s->max_batch = 1;
+
+	pm_claim(s, 0);
+	s->count[1] = 0;
+	PM_WAIT(PM_TAG_PREFETCH);
+
+	if (s->prefetch && s->count[0])
+		pm_claim(s, 1);
+}
+
+// Slot 0 holds a program too large for one slot only until slot 1 is
+// written again.
+static inline void pm_reuse_slot(PmScheduler *s, uint32_t slot)
+{
+	if (slot == 1 && s->slot_size[0] > s->slot_capacity)
+		s->slot_ea[0] = s->slot_size[0] = 0;
+}
+
+static inline int pm_find_slot(const PmScheduler *s, const SimplePolicyModuleProgram *program)
+{
+	uint32_t i;
+
+	for (i = 0; i < PM_CODE_SLOTS; i++)
+	{
+		if (s->slot_ea[i] == program->ea_bin && s->slot_size[i] == pm_code_size(program))
+			return (int)i;
+	}
+
+	return -1;
+}
+
+// Returns the next program to run with its code loaded at *code, or NULL
+// when there is no more work.
+static inline const SimplePolicyModuleProgram* pm_scheduler_next(PmScheduler *s, void **code)
+{
+	const SimplePolicyModuleProgram *program;
+	const SimplePolicyModuleProgram *next = NULL;
+	uint32_t size;
+	int slot;
+
+	if (s->index == s->count[s->current])
+	{
+		if (!s->prefetch)
+		{
+			if (!pm_claim(s, s->current))
+				return NULL;
+			PM_WAIT(PM_TAG_PREFETCH);
+		}
+		else
+		{
+			if (s->count[s->current ^ 1] == 0)
+				return NULL;
+
+			//Descriptors were requested when the previous batch started...
+			PM_WAIT(PM_TAG_PREFETCH);
+			s->slot_pending = 0;
+			s->current ^= 1;
+			pm_claim(s, s->current ^ 1);
+		}
+		s->index = 0;
+	}
+
+	program = &s->batch[s->current][s->index++];
+	size = pm_code_size(program);
+	s->stats.programs++;
+
+	slot = s->residency ? pm_find_slot(s, program) : -1;
+	if (slot >= 0)
+	{
+		if (s->slot_pending & (1 << slot))
+		{
+			PM_WAIT(PM_TAG_PREFETCH);
+			s->slot_pending = 0;
+		}
+
+		if (s->slot_prefetched & (1 << slot))
+			s->stats.code_prefetched++;
+		else
+			s->stats.code_resident++;
+	}
+	else
+	{
+		//Never overwrite a slot while a prefetch into it is in flight...
+		if (s->slot_pending)
+		{
+			PM_WAIT(PM_TAG_PREFETCH);
+			s->slot_pending = 0;
+		}
+
+		slot = (size > s->slot_capacity) ? 0 : (int)(s->last_slot ^ 1);
+		pm_reuse_slot(s, (uint32_t)slot);
+
+		PM_GET(s->slot[slot], program->ea_bin, size, PM_TAG_LOAD);
+		PM_WAIT(PM_TAG_LOAD);
+
+		s->slot_ea[slot] = program->ea_bin;
+		s->slot_size[slot] = size;
+		if (size > s->slot_capacity)
+			s->slot_ea[1] = s->slot_size[1] = 0;	//spilled over slot 1
+		s->stats.code_loads++;
+	}
+
+	s->slot_prefetched &= ~(1 << slot);
+	s->last_slot = (uint32_t)slot;
+	*code = s->slot[slot];
+
+	if (!s->prefetch || !s->residency)
+		return program;
+
+	//Fetch the following program's code into the idle slot...
+	if (s->index < s->count[s->current])
+	{
+		next = &s->batch[s->current][s->index];
+	}
+	else if (s->count[s->current ^ 1])
+	{
+		PM_WAIT(PM_TAG_PREFETCH);
+		s->slot_pending = 0;
+		next = &s->batch[s->current ^ 1][0];
+	}
+
+	if (next && pm_code_size(next) <= s->slot_capacity && size <= s->slot_capacity && pm_find_slot(s, next) < 0)
+	{
+		uint32_t idle = (uint32_t)slot ^ 1;
+
+		pm_reuse_slot(s, idle);
+		PM_GET(s->slot[idle], next->ea_bin, pm_code_size(next), PM_TAG_PREFETCH);
+		s->slot_ea[idle] = next->ea_bin;
+		s->slot_size[idle] = pm_code_size(next);
+		s->slot_pending |= 1 << idle;
+		s->slot_prefetched |= 1 << idle;
+	}
+
+	return program;
+}
+
+#endif //#ifndef __PM_SCHEDULER_H__
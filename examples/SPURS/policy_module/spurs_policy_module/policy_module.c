@@ -7,78 +7,25 @@
 
 #include "policy_module.h"
 
-static const uint32_t tag1 = 3;
+//Scheduler primitives...
+#define PM_GETLLAR(ls, ea)				(cellDmaGetllar((void*)(ls), (ea), 0, 0), cellDmaWaitAtomicStatus())
+#define PM_PUTLLC(ls, ea)				(cellDmaPutllc((void*)(ls), (ea), 0, 0), cellDmaWaitAtomicStatus())
+#define PM_GET(ls, ea, size, tag)		cellDmaLargeGet((void*)(ls), (ea), (size), (tag), 0, 0)
+#define PM_WAIT(tag)					cellDmaWaitTagStatusAll(1<<(tag))
 
-static const uintptr_t PROGRAM_START = (16 * 1024);
+#include "pm_scheduler.h"
 
-const uint32_t PM_PROGRAM_FOUND			= 0;
-const uint32_t PM_PROGRAM_FOUND_LAST	= 1;
-const uint32_t PM_PROGRAM_NOT_FOUND		= 2;
+//Two code slots; a program too large for one spills into the next...
+static const uintptr_t PROGRAM_START		= (16 * 1024);
+static const uint32_t PROGRAM_SLOT_SIZE		= (64 * 1024);
 
 SimplePolicyModule			simple_pm;
-SimplePolicyModuleProgram	spu_program;
-
-static
-int GetNextProgram(SimplePolicyModuleProgram *program, uint64_t ea_simple_pm)
-{
-	uint64_t ea;
-	int ret;
-	do
-	{
-		cellDmaGetllar((void*)&simple_pm, ea_simple_pm, 0, 0);
-		cellDmaWaitAtomicStatus();
-
-		if(simple_pm.num_programs > 0)
-		{
-			if(simple_pm.num_programs == 1)
-			{
-				ret = PM_PROGRAM_FOUND_LAST;
-			}
-			else
-			{
-				ret = PM_PROGRAM_FOUND;
-			}
-			
-			ea = simple_pm.ea_programs;
-			
-			simple_pm.ea_programs += sizeof(SimplePolicyModuleProgram);
-			simple_pm.num_programs--;
-		}
-		else
-		{
-			ret = PM_PROGRAM_NOT_FOUND;
-			ea = 0;
-		}
-
-		cellDmaPutllc((void*)&simple_pm, ea_simple_pm, 0, 0);
-
-	} while (cellDmaWaitAtomicStatus());
-
-	if (ret != PM_PROGRAM_NOT_FOUND)
-	{
-		//Get info about next program...
-		cellDmaGet((void*)program, ea, sizeof(SimplePolicyModuleProgram), tag1, 0, 0);
-		cellDmaWaitTagStatusAll(1<<tag1);
-
-		//Load program code into memory...
-		cellDmaGet(
-			(void*)PROGRAM_START, 
-			program->ea_bin, 
-			(program->bin_size+15)& ~15,
-			tag1,
-			0,
-			0);
-
-		cellDmaWaitTagStatusAll(1<<tag1);
-	}
-
-	return ret;
-}
+static PmScheduler			scheduler;
 
 static 
-void ExecuteProgram(SimplePolicyModuleProgram *program)
+void ExecuteProgram(const SimplePolicyModuleProgram *program, void *code)
 {
-	entry_t entry = (entry_t) PROGRAM_START + 0x10;
+	entry_t entry = (entry_t)((uintptr_t)code + 0x10);
 	
 	spu_sync();
 	
@@ -98,17 +45,20 @@ void pm_main(uintptr_t pKernelContext, uint64_t ea_simple_pm)
 		snPause();
 
 	//Dispatch work until no more available...
-	int ret;
-	do 
+	scheduler.residency = 1;
+	scheduler.prefetch = 1;
+	pm_scheduler_init(&scheduler, ea_simple_pm, (void*)PROGRAM_START, (void*)(PROGRAM_START + PROGRAM_SLOT_SIZE), PROGRAM_SLOT_SIZE);
+
+	const SimplePolicyModuleProgram *program;
+	void *code;
+	while ((program = pm_scheduler_next(&scheduler, &code)) != NULL)
 	{
-		ret = GetNextProgram(&spu_program, ea_simple_pm);
-	
-		if((ret == PM_PROGRAM_FOUND) || (ret == PM_PROGRAM_FOUND_LAST))
-		{
-			ExecuteProgram(&spu_program);
-		}
+		ExecuteProgram(program, code);
+	}
 
-	} while (ret == PM_PROGRAM_FOUND);
+	spu_printf("[SPU] Programs=%u claims=%u retries=%u loads=%u prefetched=%u resident=%u\n",
+		scheduler.stats.programs, scheduler.stats.claims, scheduler.stats.claim_retries,
+		scheduler.stats.code_loads, scheduler.stats.code_prefetched, scheduler.stats.code_resident);
 
 	spu_printf("[SPU] Policy module end... (entry=%x)\n", (unsigned int)entry);
 
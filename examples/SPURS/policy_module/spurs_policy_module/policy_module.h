@@ -2,7 +2,15 @@
 #define __POLICY_MODULE_H__
 
 #include <stdint.h>
+
+#if defined(__SPU__) || defined(__PPU__)
 #include <cell/spurs/types.h>
+#else
+typedef uint32_t CellSpursWorkloadId;	//host simulation build
+#endif
+
+#define PM_MAX_BATCH		32		//upper limit on programs claimed per atomic update
+#define PM_DEFAULT_BATCH	4		//used when SimplePolicyModule::batch is 0
 
 typedef struct SimplePolicyModule 
 {
@@ -13,11 +21,12 @@ typedef struct SimplePolicyModule
 	uint32_t queue;
 	uint8_t port;
 	uint8_t debug;			//add in a debug flag
+	uint8_t batch;			//programs claimed per atomic update, 0 for PM_DEFAULT_BATCH
 
 	char padding[128 
 		- sizeof(uint64_t)*2 
 		- sizeof(uint32_t)*2 
-		- sizeof(uint8_t)*2
+		- sizeof(uint8_t)*3
 		- sizeof(CellSpursWorkloadId)];
 
 } SimplePolicyModule __attribute__((__aligned__(128)));
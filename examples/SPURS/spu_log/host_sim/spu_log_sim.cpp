@@ -0,0 +1,536 @@
+/*
+ *  Description:
+ *  Host tests for the SPU log rings (spu_log.h). Threads stand in for SPUs,
+ *  each with a simulated MFC that completes DMAs in a random order, only
+ *  honouring fences and waits, so ordering mistakes in the writer show up as
+ *  corrupt or out of order records at the consumer.
+ *
+ *  Build:
+ *    g++ -std=c++11 -O2 -pthread -I.. spu_log_sim.cpp ../spu_log_consumer.c -o spu_log_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void		sim_dma(int put, int fenced, void *ls, uint64_t ea, uint32_t size, uint32_t tag);
+static int		sim_test(uint32_t tag);
+static void		sim_wait(uint32_t tag);
+static uint64_t	sim_time();
+
+#define SPU_LOG_PUT(ls, ea, size, tag)		sim_dma(1, 0, (void*)(ls), (ea), (size), (tag))
+#define SPU_LOG_PUTF(ls, ea, size, tag)		sim_dma(1, 1, (void*)(ls), (ea), (size), (tag))
+#define SPU_LOG_GET(ls, ea, size, tag)		sim_dma(0, 0, (void*)(ls), (ea), (size), (tag))
+#define SPU_LOG_TEST(tag)					sim_test(tag)
+#define SPU_LOG_WAIT(tag)					sim_wait(tag)
+#define SPU_LOG_TIME()						sim_time()
+
+#include "spu_log.h"
+
+static const uint32_t TAG_LOG = 5;
+static const uint32_t TAG_READ = 6;
+
+static int g_failures = 0;
+
+#define CHECK(expr)																\
+	do {																		\
+		if (!(expr))															\
+		{																		\
+			fprintf(stderr, "FAILED: %s (%s:%d)\n", #expr, __FILE__, __LINE__);	\
+			g_failures++;														\
+		}																		\
+	} while (0)
+
+//
+// Simulated MFC
+//
+
+struct SimDma
+{
+	int			put;
+	int			fenced;
+	uint8_t*	ls;
+	uint64_t	ea;
+	uint32_t	size;
+	uint32_t	tag;
+};
+
+struct SimMfc
+{
+	std::vector<SimDma>		pending;
+	std::mt19937			random;
+	uint32_t				completeOneIn;		//chance of each eligible DMA completing per call
+};
+
+static thread_local SimMfc* t_mfc;
+
+//Copies in 8 byte atomics so the consumer thread sees whole words; each
+//word of a put is a release and of a get an acquire, so a producer line
+//landing publishes the data before it (per word so TSAN can follow it).
+static void apply(const SimDma &dma)
+{
+	uint64_t *words;
+
+	if (dma.put)
+	{
+		words = (uint64_t*)(uintptr_t)dma.ea;
+		for (uint32_t i = 0; i < dma.size / 8; i++)
+		{
+			uint64_t value;
+			memcpy(&value, dma.ls + i * 8, 8);
+			__atomic_store_n(&words[i], value, __ATOMIC_RELEASE);
+		}
+	}
+	else
+	{
+		words = (uint64_t*)(uintptr_t)dma.ea;
+		for (uint32_t i = 0; i < dma.size / 8; i++)
+		{
+			uint64_t value = __atomic_load_n(&words[i], __ATOMIC_ACQUIRE);
+			memcpy(dma.ls + i * 8, &value, 8);
+		}
+	}
+}
+
+//A fenced DMA cannot complete before earlier DMAs on its tag...
+static bool eligible(const SimMfc *mfc, size_t index)
+{
+	if (!mfc->pending[index].fenced)
+		return true;
+
+	for (size_t i = 0; i < index; i++)
+	{
+		if (mfc->pending[i].tag == mfc->pending[index].tag)
+			return false;
+	}
+	return true;
+}
+
+static void progress(SimMfc *mfc)
+{
+	size_t i = 0;
+
+	while (i < mfc->pending.size())
+	{
+		if (eligible(mfc, i) && mfc->random() % mfc->completeOneIn == 0)
+		{
+			apply(mfc->pending[i]);
+			mfc->pending.erase(mfc->pending.begin() + i);
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+}
+
+static void sim_dma(int put, int fenced, void *ls, uint64_t ea, uint32_t size, uint32_t tag)
+{
+	SimDma dma;
+
+	if (((uintptr_t)ls & 15) || (ea & 15) || (size & 15) || size == 0 || size > 16 * 1024)
+	{
+		fprintf(stderr, "Bad DMA: ls=%p ea=%llx size=%u\n", ls, (unsigned long long)ea, size);
+		abort();
+	}
+
+	dma.put = put;
+	dma.fenced = fenced;
+	dma.ls = (uint8_t*)ls;
+	dma.ea = ea;
+	dma.size = size;
+	dma.tag = tag;
+	t_mfc->pending.push_back(dma);
+
+	progress(t_mfc);
+}
+
+static int sim_test(uint32_t tag)
+{
+	progress(t_mfc);
+
+	for (size_t i = 0; i < t_mfc->pending.size(); i++)
+	{
+		if (t_mfc->pending[i].tag == tag)
+			return 0;
+	}
+	return 1;
+}
+
+static void sim_wait(uint32_t tag)
+{
+	size_t i = 0;
+
+	while (i < t_mfc->pending.size())
+	{
+		if (t_mfc->pending[i].tag == tag && eligible(t_mfc, i))
+		{
+			apply(t_mfc->pending[i]);
+			t_mfc->pending.erase(t_mfc->pending.begin() + i);
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+}
+
+static uint64_t sim_time()
+{
+	return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+//
+// Format table
+//
+
+enum
+{
+	LOG_HELLO,
+	LOG_INTS,
+	LOG_WIDTHS,
+	LOG_UNSIGNED,
+	LOG_LONG,
+	LOG_SHORT,
+	LOG_CHAR,
+	LOG_FLOAT,
+	LOG_POINTER,
+	LOG_PERCENT,
+	LOG_STRING,
+	LOG_MISSING,
+	LOG_RECORD,
+	LOG_FORMAT_COUNT
+};
+
+static const char* const g_formats[LOG_FORMAT_COUNT] =
+{
+	"hello from spu\n",
+	"%d %i %d",
+	"[%5d|%-5d|%05d]",
+	"%u %x %X %o %#x",
+	"%lld %llx %ld",
+	"%hd %hu %hhd %hhu",
+	"%c%c%c",
+	"%.3f %e %g %8.2f",
+	"%p",
+	"100%% done",
+	"name=%s next=%d",
+	"%d %d %d",
+	"spu %u record %u value %u half %.1f\n",
+};
+
+static const SpuLogFormatTable g_table = { g_formats, LOG_FORMAT_COUNT };
+
+static std::string formatRecord(uint16_t format, uint32_t count, const uint64_t *args)
+{
+	SpuLogRecord record;
+	char out[512];
+
+	memset(&record, 0, sizeof(record));
+	record.format = format;
+	record.arg_count = (uint8_t)count;
+	memcpy(record.args, args, count * 8);
+	spu_log_format(&g_table, &record, out, sizeof(out));
+
+	return out;
+}
+
+#define FORMATTED(format, ...)															\
+	([]() { const uint64_t a[] = { __VA_ARGS__ }; return formatRecord(format, sizeof(a) / 8, a); }())
+
+static void testFormat()
+{
+	char expected[256];
+
+	CHECK(formatRecord(LOG_HELLO, 0, NULL) == "hello from spu\n");
+
+	CHECK(FORMATTED(LOG_INTS, (uint64_t)(int64_t)-5, 7, (uint64_t)0xffffffffULL) == "-5 7 -1");
+	CHECK(FORMATTED(LOG_WIDTHS, 42, 42, (uint64_t)(int64_t)-42) == "[   42|42   |-0042]");
+
+	snprintf(expected, sizeof(expected), "%u %x %X %o %#x", 4000000000u, 0xbeefu, 0xbeefu, 8u, 255u);
+	CHECK(FORMATTED(LOG_UNSIGNED, 4000000000ULL, 0xbeef, 0xbeef, 8, 255) == expected);
+
+	CHECK(FORMATTED(LOG_LONG, (uint64_t)(int64_t)-9000000000LL, 0x123456789aULL, 5) == "-9000000000 123456789a 5");
+	CHECK(FORMATTED(LOG_SHORT, 0x18001ULL, 0x1ffffULL, 0x1ffULL, 0x1ffULL) == "-32767 65535 -1 255");
+	CHECK(FORMATTED(LOG_CHAR, 'S', 'P', 'U') == "SPU");
+
+	snprintf(expected, sizeof(expected), "%.3f %e %g %8.2f", 3.14159, 1e-7, 2.5, -1.005);
+	CHECK(FORMATTED(LOG_FLOAT, spu_log_double(3.14159), spu_log_double(1e-7), spu_log_double(2.5), spu_log_double(-1.005)) == expected);
+
+	CHECK(FORMATTED(LOG_POINTER, 0x3f000ULL) == "0x3f000");
+	CHECK(formatRecord(LOG_PERCENT, 0, NULL) == "100% done");
+	CHECK(FORMATTED(LOG_STRING, 0x1000, 3) == "name=(%s) next=3");
+	CHECK(FORMATTED(LOG_MISSING, 1) == "1 <?> <?>");
+	CHECK(formatRecord(999, 0, NULL) == "<unknown log format 999>\n");
+
+	//Output is always terminated, however small the buffer...
+	SpuLogRecord record;
+	char small[8];
+	memset(&record, 0, sizeof(record));
+	record.format = LOG_HELLO;
+	CHECK(spu_log_format(&g_table, &record, small, sizeof(small)) == 7 && strcmp(small, "hello f") == 0);
+}
+
+//
+// Rings
+//
+
+struct TestRing
+{
+	SpuLogRing*		ring;
+	uint8_t*		data;
+};
+
+static TestRing allocRing(uint32_t size, uint32_t id)
+{
+	TestRing t;
+	t.ring = (SpuLogRing*)aligned_alloc(128, sizeof(SpuLogRing));
+	t.data = (uint8_t*)aligned_alloc(128, size);
+	memset(t.data, 0xcd, size);
+	if (spu_log_ring_init(t.ring, t.data, size, id) != 0)
+		abort();
+	return t;
+}
+
+static void freeRing(TestRing &t)
+{
+	free(t.ring);
+	free(t.data);
+}
+
+static void testSingleThreaded()
+{
+	SimMfc mfc;
+	mfc.random.seed(1);
+	mfc.completeOneIn = 3;
+	t_mfc = &mfc;
+
+	TestRing t = allocRing(16 * 1024, 3);
+	SpuLogConsumer consumer;
+	spu_log_consumer_init(&consumer, t.ring);
+
+	SpuLogWriter *w = (SpuLogWriter*)aligned_alloc(128, sizeof(SpuLogWriter));
+	spu_log_writer_init(w, (uint64_t)(uintptr_t)t.ring, t.ring, TAG_LOG, TAG_READ);
+
+	char out[64 * 1024];
+	std::string text;
+	uint32_t expectRecord = 1;
+
+	//Several laps of the ring, draining often enough that nothing is dropped...
+	for (uint32_t i = 1; i <= 2000; i++)
+	{
+		SPU_LOG(w, LOG_RECORD, 3, i, i * 3, spu_log_double(i / 2.0));
+		if (i % 100 == 0)
+		{
+			spu_log_flush(w);
+			sim_wait(TAG_LOG);
+			spu_log_consume(&consumer, &g_table, out, sizeof(out), 1000);
+			text += out;
+		}
+	}
+
+	const char *p = text.c_str();
+	unsigned spu, record, value;
+	double half;
+	int consumed;
+	while (sscanf(p, "[SPU 3] spu %u record %u value %u half %lf\n%n", &spu, &record, &value, &half, &consumed) == 4)
+	{
+		CHECK(record == expectRecord && value == record * 3 && half == record / 2.0);
+		expectRecord++;
+		p += consumed;
+	}
+	CHECK(*p == '\0');
+	CHECK(expectRecord == 2001);
+	CHECK(consumer.dropped == 0 && consumer.missing == 0 && consumer.malformed == 0);
+
+	//Without a consumer the ring fills, and the SPU drops rather than waits...
+	for (uint32_t i = 0; i < 1000; i++)
+		SPU_LOG(w, LOG_RECORD, 3, 0, 0, 0);
+	sim_wait(TAG_READ);
+	spu_log_flush(w);
+	sim_wait(TAG_LOG);
+
+	CHECK(w->dropped > 0);
+	spu_log_consume(&consumer, &g_table, out, sizeof(out), 100000);
+	CHECK(strstr(out, "log records dropped, ring full") != NULL);
+	CHECK(consumer.dropped == w->dropped);
+	CHECK(consumer.consumed + consumer.dropped == 3000);
+
+	//A writer started again on the same ring carries on where it left off...
+	spu_log_writer_init(w, (uint64_t)(uintptr_t)t.ring, t.ring, TAG_LOG, TAG_READ);
+	SPU_LOG0(w, LOG_HELLO);
+	spu_log_flush(w);
+	sim_wait(TAG_LOG);
+	spu_log_consume(&consumer, &g_table, out, sizeof(out), 100);
+	CHECK(strcmp(out, "[SPU 3] hello from spu\n") == 0);
+	CHECK(consumer.missing <= consumer.dropped);
+
+	free(w);
+	freeRing(t);
+	t_mfc = NULL;
+}
+
+struct Producer
+{
+	TestRing			ring;
+	uint32_t			id;
+	uint32_t			count;
+	uint32_t			yieldEvery;		//0 to log flat out
+	uint32_t			stalls;
+	uint32_t			dropped;
+	double				nsPerRecord;
+};
+
+static void producerThread(Producer *producer)
+{
+	SimMfc mfc;
+	mfc.random.seed(producer->id + 100);
+	mfc.completeOneIn = 4;
+	t_mfc = &mfc;
+
+	SpuLogWriter *w = (SpuLogWriter*)aligned_alloc(128, sizeof(SpuLogWriter));
+	spu_log_writer_init(w, (uint64_t)(uintptr_t)producer->ring.ring, producer->ring.ring, TAG_LOG, TAG_READ);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 1; i <= producer->count; i++)
+	{
+		SPU_LOG(w, LOG_RECORD, producer->id, i, i * 3, spu_log_double(i / 2.0));
+		if (mfc.random() % 512 == 0)
+			spu_log_flush(w);
+		if (producer->yieldEvery && i % producer->yieldEvery == 0)
+			std::this_thread::yield();
+	}
+	spu_log_flush(w);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	sim_wait(TAG_LOG);
+	sim_wait(TAG_READ);
+
+	producer->stalls = w->stalls;
+	producer->dropped = w->dropped;
+	producer->nsPerRecord = std::chrono::duration<double, std::nano>(end - start).count() / producer->count;
+
+	free(w);
+}
+
+static void testConcurrent(uint32_t spus, uint32_t records, uint32_t ringSize, uint32_t yieldEvery)
+{
+	std::vector<Producer> producers(spus);
+	std::vector<SpuLogConsumer> consumers(spus);
+	std::vector<uint32_t> lastRecord(spus, 0);
+	std::vector<std::thread> threads;
+	std::atomic<bool> done(false);
+	uint64_t badLines = 0;
+
+	for (uint32_t i = 0; i < spus; i++)
+	{
+		producers[i].ring = allocRing(ringSize, i);
+		producers[i].id = i;
+		producers[i].count = records;
+		producers[i].yieldEvery = yieldEvery;
+		spu_log_consumer_init(&consumers[i], producers[i].ring.ring);
+	}
+
+	std::vector<char> out(64 * 1024);
+
+	//Drains a batch from every ring and checks each line...
+	auto drain = [&]() -> uint64_t
+	{
+		uint64_t lines = 0;
+		for (uint32_t i = 0; i < spus; i++)
+		{
+			uint64_t before = consumers[i].consumed;
+			spu_log_consume(&consumers[i], &g_table, &out[0], out.size(), 256);
+			lines += consumers[i].consumed - before;
+
+			const char *p = &out[0];
+			while (*p)
+			{
+				unsigned ring, spu, record, value;
+				double half;
+				int consumed = 0;
+
+				if (sscanf(p, "[SPU %u] spu %u record %u value %u half %lf\n%n", &ring, &spu, &record, &value, &half, &consumed) == 5)
+				{
+					if (ring != i || spu != i || record <= lastRecord[i] || value != record * 3 || half != record / 2.0)
+						badLines++;
+					lastRecord[i] = record;
+					p += consumed;
+				}
+				else
+				{
+					const char *eol = strchr(p, '\n');
+					if (!strstr(p, "log records dropped") || !eol || strstr(p, "log records dropped") > eol)
+						badLines++;
+					p = eol ? eol + 1 : p + strlen(p);
+				}
+			}
+		}
+		return lines;
+	};
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < spus; i++)
+		threads.push_back(std::thread(producerThread, &producers[i]));
+
+	std::thread consumer([&]()
+	{
+		while (!done)
+		{
+			if (drain() == 0)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		while (drain())
+			;
+	});
+
+	for (uint32_t i = 0; i < spus; i++)
+		threads[i].join();
+	done = true;
+	consumer.join();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t consumed = 0, dropped = 0, stalls = 0;
+	double ns = 0.0;
+	for (uint32_t i = 0; i < spus; i++)
+	{
+		CHECK(consumers[i].consumed + consumers[i].dropped == records);
+		CHECK(consumers[i].dropped == producers[i].dropped);
+		CHECK(consumers[i].missing <= consumers[i].dropped);
+		CHECK(consumers[i].malformed == 0);
+		consumed += consumers[i].consumed;
+		dropped += consumers[i].dropped;
+		stalls += producers[i].stalls;
+		ns += producers[i].nsPerRecord;
+		freeRing(producers[i].ring);
+	}
+	CHECK(badLines == 0);
+
+	printf("%4u SPUs %8u records each, %6u byte rings: %9llu consumed %9llu dropped %6llu flush stalls %7.1f ns/record %8.1f ms\n",
+		spus, records, ringSize, (unsigned long long)consumed, (unsigned long long)dropped, (unsigned long long)stalls, ns / spus, ms);
+}
+
+int main()
+{
+	testFormat();
+	testSingleThreaded();
+
+	//Logging flat out overruns the consumer; paced logging should not...
+	testConcurrent(1, 100000, 64 * 1024, 0);
+	testConcurrent(6, 100000, 64 * 1024, 0);
+	testConcurrent(6, 100000, SPU_LOG_MIN_RING_SIZE, 0);
+	testConcurrent(6, 100000, 64 * 1024, 64);
+
+	if (g_failures)
+	{
+		fprintf(stderr, "%d checks failed\n", g_failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,323 @@
+/*
+ *  Description:
+ *  Binary SPU logging through per-SPU rings in main memory.
+ *
+ *  spu_printf costs each SPU a full PPU round trip per call. Here an SPU
+ *  appends fixed form records (format id, up to SPU_LOG_MAX_ARGS 64 bit
+ *  arguments) to a staging buffer in local store, and a full buffer is
+ *  written to its ring by DMA without waiting for the consumer. When the ring
+ *  is full, records are dropped and counted rather than blocking the SPU. A
+ *  PPU thread (spu_log_server.h) or a host program drains the rings in
+ *  batches and formats them with the table of format strings.
+ *
+ *  Format strings are never sent; the SPU and consumer share a table,
+ *  normally generated from one list of SPU_LOG_FORMAT(id, string) entries.
+ *  %s is not supported as a string pointer is meaningless off the SPU.
+ *
+ *  The writer is built on primitives the includer defines, so it builds for
+ *  the SPU (spu_log_spu.h) and for the host simulation in host_sim/:
+ *
+ *	SPU_LOG_PUT(ls, ea, size, tag)		start a DMA to main memory
+ *	SPU_LOG_PUTF(ls, ea, size, tag)		as SPU_LOG_PUT, fenced behind earlier DMAs on tag
+ *	SPU_LOG_GET(ls, ea, size, tag)		start a DMA from main memory
+ *	SPU_LOG_TEST(tag)					non-zero if every DMA on tag is complete, never waits
+ *	SPU_LOG_WAIT(tag)					wait for every DMA on tag
+ *	SPU_LOG_TIME()						64 bit time stamp
+ *
+ *  The consumer side only needs SPU_LOG_LOAD_ACQUIRE and SPU_LOG_STORE_RELEASE,
+ *  which have defaults for the PPU and GCC compatible hosts.
+ */
+
+#ifndef __SPU_LOG_H__
+#define __SPU_LOG_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#define SPU_LOG_MAX_ARGS			8
+#define SPU_LOG_STAGING_SIZE		2048			//bytes batched per DMA
+#define SPU_LOG_MIN_RING_SIZE		(SPU_LOG_STAGING_SIZE * 2)
+#define SPU_LOG_RECORD_MAX_SIZE		(16 + SPU_LOG_MAX_ARGS * 8)
+
+//Ring header in main memory; each line has a single writer...
+typedef struct SpuLogProducerLine
+{
+	uint64_t	write;			//bytes ever written; data up to here is valid
+	uint32_t	dropped;		//records dropped because the ring was full
+	uint32_t	records;		//records written
+	uint8_t		pad[128 - 16];
+
+} SpuLogProducerLine;
+
+typedef struct SpuLogConsumerLine
+{
+	uint64_t	read;			//bytes ever consumed
+	uint8_t		pad[128 - 8];
+
+} SpuLogConsumerLine;
+
+typedef struct SpuLogRing
+{
+	SpuLogProducerLine	producer;		//written by the SPU, by DMA only
+	SpuLogConsumerLine	consumer;		//written by the consumer
+	uint64_t			ea_data;		//size bytes, 128 byte aligned
+	uint32_t			size;			//power of two, at least SPU_LOG_MIN_RING_SIZE
+	uint32_t			id;				//shown by the consumer, e.g. the SPU number
+	uint8_t				pad[128 - 16];
+
+} SpuLogRing __attribute__((__aligned__(128)));
+
+//A record is 16 bytes plus its arguments, padded to 16 bytes. Records may
+//wrap around the end of the ring.
+typedef struct SpuLogRecord
+{
+	uint16_t	format;
+	uint8_t		arg_count;
+	uint8_t		flags;
+	uint32_t	sequence;		//counts dropped records too, so gaps show where
+	uint64_t	time;
+	uint64_t	args[SPU_LOG_MAX_ARGS];
+
+} SpuLogRecord;
+
+static inline uint32_t spu_log_record_size(uint32_t arg_count)
+{
+	return (16 + arg_count * 8 + 15) & ~15;
+}
+
+#ifdef SPU_LOG_PUT
+
+//
+// Writer
+//
+
+typedef struct SpuLogWriter
+{
+	uint8_t				staging[2][SPU_LOG_STAGING_SIZE] __attribute__((__aligned__(128)));
+	SpuLogProducerLine	producer[2] __attribute__((__aligned__(128)));
+	SpuLogConsumerLine	consumer __attribute__((__aligned__(128)));	//target of the read refresh
+
+	uint64_t			ea_ring;
+	uint64_t			ea_data;
+	uint32_t			size;
+	uint32_t			tag;			//data and producer line
+	uint32_t			read_tag;		//consumer line refresh
+	uint32_t			buffer;
+	uint32_t			fill;
+	uint32_t			sequence;
+	uint32_t			dropped;
+	uint32_t			dropped_published;
+	uint32_t			records;
+	uint64_t			write;			//bytes handed to the MFC
+	uint64_t			read;			//last consumer position seen
+	uint32_t			stalls;			//flushes that had to wait for the previous one
+
+} SpuLogWriter;
+
+// ring is the local store copy of the ring header; only ea_data and size
+// are used.
+static inline void spu_log_writer_init(SpuLogWriter *w, uint64_t ea_ring, const SpuLogRing *ring, uint32_t tag, uint32_t read_tag)
+{
+	w->ea_ring = ea_ring;
+	w->ea_data = ring->ea_data;
+	w->size = ring->size;
+	w->tag = tag;
+	w->read_tag = read_tag;
+	w->buffer = 0;
+	w->fill = 0;
+	w->sequence = 0;
+	w->dropped = 0;
+	w->records = 0;
+	w->write = 0;
+	w->read = 0;
+	w->stalls = 0;
+
+	//The ring may be reused, so continue from where it was...
+	SPU_LOG_GET(&w->producer[0], ea_ring, sizeof(SpuLogProducerLine), tag);
+	SPU_LOG_GET(&w->consumer, ea_ring + sizeof(SpuLogProducerLine), sizeof(SpuLogConsumerLine), read_tag);
+	SPU_LOG_WAIT(tag);
+	SPU_LOG_WAIT(read_tag);
+
+	w->write = w->producer[0].write;
+	w->dropped = w->producer[0].dropped;
+	w->records = w->producer[0].records;
+	w->read = w->consumer.read;
+	w->dropped_published = w->dropped;
+	w->sequence = w->records + w->dropped;
+}
+
+// Picks up the consumer position fetched last time, if it has arrived, and
+// asks for a new one. Never waits.
+static inline void spu_log_poll_read(SpuLogWriter *w)
+{
+	if (SPU_LOG_TEST(w->read_tag))
+	{
+		w->read = w->consumer.read;
+		SPU_LOG_GET(&w->consumer, w->ea_ring + sizeof(SpuLogProducerLine), sizeof(SpuLogConsumerLine), w->read_tag);
+	}
+}
+
+// Hands the staging buffer to the MFC. Only waits if the previous flush has
+// not finished yet, which the ordering of the producer line relies on.
+static inline void spu_log_flush(SpuLogWriter *w)
+{
+	uint32_t b = w->buffer;
+	uint32_t offset = (uint32_t)(w->write & (w->size - 1));
+	uint32_t first = w->size - offset;
+	SpuLogProducerLine *line = &w->producer[b];
+
+	//Nothing new, not even a drop to report...
+	if (w->fill == 0 && w->dropped == w->dropped_published)
+		return;
+
+	if (!SPU_LOG_TEST(w->tag))
+	{
+		w->stalls++;
+		SPU_LOG_WAIT(w->tag);
+	}
+
+	spu_log_poll_read(w);
+
+	if (w->fill && first >= w->fill)
+	{
+		SPU_LOG_PUT(w->staging[b], w->ea_data + offset, w->fill, w->tag);
+	}
+	else if (w->fill)
+	{
+		SPU_LOG_PUT(w->staging[b], w->ea_data + offset, first, w->tag);
+		SPU_LOG_PUT(w->staging[b] + first, w->ea_data, w->fill - first, w->tag);
+	}
+
+	w->write += w->fill;
+	line->write = w->write;
+	line->dropped = w->dropped;
+	line->records = w->records;
+	w->dropped_published = w->dropped;
+	SPU_LOG_PUTF(line, w->ea_ring, 16, w->tag);
+
+	w->buffer = b ^ 1;
+	w->fill = 0;
+}
+
+static inline void spu_log_write(SpuLogWriter *w, uint16_t format, uint32_t arg_count, const uint64_t *args)
+{
+	uint32_t size = spu_log_record_size(arg_count);
+	SpuLogRecord *record;
+
+	w->sequence++;
+
+	if (arg_count > SPU_LOG_MAX_ARGS)
+	{
+		w->dropped++;
+		return;
+	}
+
+	if (w->fill + size > SPU_LOG_STAGING_SIZE)
+		spu_log_flush(w);
+
+	//The consumer position may be stale, which only makes this cautious...
+	if (w->write + w->fill + size - w->read > w->size)
+	{
+		spu_log_poll_read(w);
+		if (w->write + w->fill + size - w->read > w->size)
+		{
+			w->dropped++;
+			return;
+		}
+	}
+
+	record = (SpuLogRecord*)(w->staging[w->buffer] + w->fill);
+	record->format = format;
+	record->arg_count = (uint8_t)arg_count;
+	record->flags = 0;
+	record->sequence = w->sequence;
+	record->time = SPU_LOG_TIME();
+	memcpy(record->args, args, arg_count * 8);
+
+	w->fill += size;
+	w->records++;
+}
+
+//Bit pattern of a double for a %f, %e or %g argument.
+static inline uint64_t spu_log_double(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+#define SPU_LOG0(w, format)											\
+	spu_log_write((w), (uint16_t)(format), 0, NULL)
+
+#define SPU_LOG(w, format, ...)										\
+	do {															\
+		const uint64_t _spu_log_args[] = { __VA_ARGS__ };			\
+		spu_log_write((w), (uint16_t)(format),						\
+			sizeof(_spu_log_args) / sizeof(uint64_t), _spu_log_args);	\
+	} while (0)
+
+#endif //#ifdef SPU_LOG_PUT
+
+//
+// Consumer
+//
+
+#ifndef SPU_LOG_LOAD_ACQUIRE
+#if defined(__PPU__)
+#include <ppu_intrinsics.h>
+#define SPU_LOG_LOAD_ACQUIRE(p)			({ __typeof__(*(p)) _v = *(volatile __typeof__(*(p))*)(p); __lwsync(); _v; })
+#define SPU_LOG_STORE_RELEASE(p, v)		do { __lwsync(); *(volatile __typeof__(*(p))*)(p) = (v); } while (0)
+#elif defined(__GNUC__)
+#define SPU_LOG_LOAD_ACQUIRE(p)			__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SPU_LOG_STORE_RELEASE(p, v)		__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+#endif
+
+#ifndef __SPU__
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SpuLogFormatTable
+{
+	const char* const*	formats;
+	uint32_t			count;
+
+} SpuLogFormatTable;
+
+typedef struct SpuLogConsumer
+{
+	SpuLogRing*			ring;
+	const uint8_t*		data;			//host address of ring->ea_data
+	uint32_t			next_sequence;
+	uint32_t			dropped_seen;
+	uint64_t			consumed;
+	uint64_t			dropped;		//as reported by the SPU
+	uint64_t			missing;		//sequence gaps, should match dropped
+	uint64_t			malformed;
+
+} SpuLogConsumer;
+
+//Sets up a ring for a producer; data must be size bytes, 128 byte aligned.
+int  spu_log_ring_init(SpuLogRing *ring, void *data, uint32_t size, uint32_t id);
+
+void spu_log_consumer_init(SpuLogConsumer *consumer, SpuLogRing *ring);
+
+//Formats one record into out, returns the length written (truncated to out_size - 1).
+int  spu_log_format(const SpuLogFormatTable *table, const SpuLogRecord *record, char *out, size_t out_size);
+
+//Formats up to max_records available records, one per line prefixed with
+//the ring id, into out; the consumer position is only published for whole
+//records. Returns the number of bytes written.
+size_t spu_log_consume(SpuLogConsumer *consumer, const SpuLogFormatTable *table, char *out, size_t out_size, uint32_t max_records);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //#ifndef __SPU__
+
+#endif //#ifndef __SPU_LOG_H__
@@ -0,0 +1,294 @@
+/*
+ *  Description:
+ *  Consumer side of the SPU log rings, see spu_log.h. Portable C so it
+ *  builds for the PPU server and for host tools and tests.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "spu_log.h"
+
+int spu_log_ring_init(SpuLogRing *ring, void *data, uint32_t size, uint32_t id)
+{
+	if (!ring || !data || ((uintptr_t)data & 127) || size < SPU_LOG_MIN_RING_SIZE || (size & (size - 1)))
+		return -1;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->ea_data = (uint64_t)(uintptr_t)data;
+	ring->size = size;
+	ring->id = id;
+
+	return 0;
+}
+
+void spu_log_consumer_init(SpuLogConsumer *consumer, SpuLogRing *ring)
+{
+	memset(consumer, 0, sizeof(*consumer));
+	consumer->ring = ring;
+	consumer->data = (const uint8_t*)(uintptr_t)ring->ea_data;
+	consumer->next_sequence = ring->producer.records + ring->producer.dropped + 1;
+	consumer->dropped_seen = ring->producer.dropped;
+}
+
+static void copy_from_ring(const SpuLogConsumer *consumer, uint64_t position, void *out, uint32_t size)
+{
+	uint32_t ring_size = consumer->ring->size;
+	uint32_t offset = (uint32_t)(position & (ring_size - 1));
+	uint32_t first = ring_size - offset;
+
+	if (first >= size)
+	{
+		memcpy(out, consumer->data + offset, size);
+	}
+	else
+	{
+		memcpy(out, consumer->data + offset, first);
+		memcpy((uint8_t*)out + first, consumer->data, size - first);
+	}
+}
+
+//Appends to out without overrunning it; *used stops at out_size - 1.
+static void append(char *out, size_t out_size, size_t *used, const char *text, int length)
+{
+	size_t room = out_size - 1 - *used;
+
+	if (length < 0)
+		return;
+	if ((size_t)length > room)
+		length = (int)room;
+
+	memcpy(out + *used, text, (size_t)length);
+	*used += (size_t)length;
+	out[*used] = '\0';
+}
+
+int spu_log_format(const SpuLogFormatTable *table, const SpuLogRecord *record, char *out, size_t out_size)
+{
+	const char *format;
+	uint32_t arg = 0;
+	size_t used = 0;
+	char value[128];
+
+	if (out_size == 0)
+		return 0;
+	out[0] = '\0';
+
+	if (record->format >= table->count || !table->formats[record->format])
+	{
+		int length = snprintf(value, sizeof(value), "<unknown log format %u>\n", record->format);
+		append(out, out_size, &used, value, length);
+		return (int)used;
+	}
+
+	format = table->formats[record->format];
+
+	while (*format)
+	{
+		const char *start = format;
+		char spec[32];
+		size_t spec_length;
+		int length_modifier = 0;		//-2 hh, -1 h, 0 none, 1 l or wider
+		char conversion;
+
+		if (*format != '%')
+		{
+			while (*format && *format != '%')
+				format++;
+			append(out, out_size, &used, start, (int)(format - start));
+			continue;
+		}
+
+		if (format[1] == '%')
+		{
+			append(out, out_size, &used, "%", 1);
+			format += 2;
+			continue;
+		}
+
+		//Flags, width and precision are passed through; * is not supported...
+		format++;
+		while (*format && strchr("-+ #0", *format))
+			format++;
+		while (*format >= '0' && *format <= '9')
+			format++;
+		if (*format == '.')
+		{
+			format++;
+			while (*format >= '0' && *format <= '9')
+				format++;
+		}
+
+		spec_length = (size_t)(format - start);
+
+		while (*format && strchr("hlLqjzt", *format))
+		{
+			if (*format == 'h')
+				length_modifier--;
+			else
+				length_modifier = 1;
+			format++;
+		}
+
+		conversion = *format;
+		if (!conversion || spec_length + 4 > sizeof(spec) || !strchr("diouxXcfFeEgGaAps", conversion))
+		{
+			//Print anything unrecognised as it stands...
+			append(out, out_size, &used, start, (int)(format - start) + (conversion ? 1 : 0));
+			if (conversion)
+				format++;
+			continue;
+		}
+		format++;
+
+		if (conversion == 's')
+		{
+			append(out, out_size, &used, "(%s)", 4);
+			arg++;
+			continue;
+		}
+
+		if (arg >= record->arg_count)
+		{
+			append(out, out_size, &used, "<?>", 3);
+			continue;
+		}
+
+		{
+			uint64_t bits = record->args[arg++];
+			int length;
+
+			memcpy(spec, start, spec_length);
+
+			switch (conversion)
+			{
+			case 'd':
+			case 'i':
+				{
+					long long v = (long long)(int64_t)bits;
+					if (length_modifier == 0)
+						v = (int32_t)bits;
+					else if (length_modifier == -1)
+						v = (int16_t)bits;
+					else if (length_modifier < -1)
+						v = (int8_t)bits;
+					memcpy(spec + spec_length, "lld", 4);
+					length = snprintf(value, sizeof(value), spec, v);
+				}
+				break;
+
+			case 'o':
+			case 'u':
+			case 'x':
+			case 'X':
+				{
+					unsigned long long v = bits;
+					if (length_modifier == 0)
+						v = (uint32_t)bits;
+					else if (length_modifier == -1)
+						v = (uint16_t)bits;
+					else if (length_modifier < -1)
+						v = (uint8_t)bits;
+					spec[spec_length] = 'l';
+					spec[spec_length + 1] = 'l';
+					spec[spec_length + 2] = conversion;
+					spec[spec_length + 3] = '\0';
+					length = snprintf(value, sizeof(value), spec, v);
+				}
+				break;
+
+			case 'c':
+				spec[spec_length] = 'c';
+				spec[spec_length + 1] = '\0';
+				length = snprintf(value, sizeof(value), spec, (int)(uint8_t)bits);
+				break;
+
+			case 'p':
+				length = snprintf(value, sizeof(value), "0x%llx", (unsigned long long)bits);
+				break;
+
+			default:
+				{
+					double v;
+					memcpy(&v, &bits, sizeof(v));
+					spec[spec_length] = conversion;
+					spec[spec_length + 1] = '\0';
+					length = snprintf(value, sizeof(value), spec, v);
+				}
+				break;
+			}
+
+			if (length >= (int)sizeof(value))
+				length = (int)sizeof(value) - 1;
+			append(out, out_size, &used, value, length);
+		}
+	}
+
+	return (int)used;
+}
+
+size_t spu_log_consume(SpuLogConsumer *consumer, const SpuLogFormatTable *table, char *out, size_t out_size, uint32_t max_records)
+{
+	SpuLogRing *ring = consumer->ring;
+	uint64_t write = SPU_LOG_LOAD_ACQUIRE(&ring->producer.write);
+	uint32_t dropped = SPU_LOG_LOAD_ACQUIRE(&ring->producer.dropped);
+	uint64_t read = ring->consumer.read;
+	uint32_t count = 0;
+	size_t used = 0;
+	char line[512];
+	char prefix[32];
+	int prefix_length;
+
+	if (out_size == 0)
+		return 0;
+	out[0] = '\0';
+
+	prefix_length = snprintf(prefix, sizeof(prefix), "[SPU %u] ", ring->id);
+
+	if (dropped != consumer->dropped_seen)
+	{
+		int length = snprintf(line, sizeof(line), "%s%u log records dropped, ring full\n", prefix, dropped - consumer->dropped_seen);
+		consumer->dropped += dropped - consumer->dropped_seen;
+		consumer->dropped_seen = dropped;
+		append(out, out_size, &used, line, length);
+	}
+
+	while (read < write && count < max_records)
+	{
+		SpuLogRecord record;
+		uint32_t size;
+		int length;
+
+		copy_from_ring(consumer, read, &record, 16);
+		size = spu_log_record_size(record.arg_count);
+
+		if (record.arg_count > SPU_LOG_MAX_ARGS || read + size > write)
+		{
+			//Nothing after this can be trusted; skip to the end...
+			consumer->malformed++;
+			read = write;
+			break;
+		}
+
+		copy_from_ring(consumer, read + 16, record.args, size - 16);
+
+		length = spu_log_format(table, &record, line, sizeof(line));
+		if (used + (size_t)prefix_length + (size_t)length + 2 > out_size)
+			break;
+
+		append(out, out_size, &used, prefix, prefix_length);
+		append(out, out_size, &used, line, length);
+		if (length == 0 || line[length - 1] != '\n')
+			append(out, out_size, &used, "\n", 1);
+
+		if (record.sequence != consumer->next_sequence && (int32_t)(record.sequence - consumer->next_sequence) > 0)
+			consumer->missing += record.sequence - consumer->next_sequence;
+		consumer->next_sequence = record.sequence + 1;
+
+		read += size;
+		consumer->consumed++;
+		count++;
+	}
+
+	SPU_LOG_STORE_RELEASE(&ring->consumer.read, read);
+	return used;
+}
@@ -0,0 +1,36 @@
+/*
+ *  Description:
+ *  Log formats of the spu_log sample, shared by the SPU task that writes
+ *  them and the PPU that prints them. Only the PPU holds the strings.
+ */
+
+#ifndef __SPU_LOG_FORMATS_H__
+#define __SPU_LOG_FORMATS_H__
+
+#define SPU_LOG_SAMPLE_FORMATS																\
+	SPU_LOG_FORMAT(LOG_TASK_START,	"task %u started on ring %u\n")						\
+	SPU_LOG_FORMAT(LOG_TASK_STEP,	"task %u step %u: sum %llu, mean %.2f\n")			\
+	SPU_LOG_FORMAT(LOG_TASK_END,	"task %u finished, %u records dropped, %u flushes waited\n")
+
+enum SpuLogSampleFormat
+{
+#define SPU_LOG_FORMAT(id, string)	id,
+	SPU_LOG_SAMPLE_FORMATS
+#undef SPU_LOG_FORMAT
+	LOG_FORMAT_COUNT
+};
+
+#ifndef __SPU__
+
+static const char* const g_spu_log_formats[LOG_FORMAT_COUNT] =
+{
+#define SPU_LOG_FORMAT(id, string)	string,
+	SPU_LOG_SAMPLE_FORMATS
+#undef SPU_LOG_FORMAT
+};
+
+static const SpuLogFormatTable g_spu_log_format_table = { g_spu_log_formats, LOG_FORMAT_COUNT };
+
+#endif //#ifndef __SPU__
+
+#endif //#ifndef __SPU_LOG_FORMATS_H__
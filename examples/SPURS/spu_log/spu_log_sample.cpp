@@ -0,0 +1,84 @@
+/*
+ *  Description:
+ *  Runs one SPURS task for each log ring; each task logs to its own ring
+ *  while the log service prints them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cell/spurs.h>
+
+#include "spu_log_server.h"
+
+extern char _binary_task_spurs_task_log_elf_start[];
+
+int runSpursSample (CellSpurs *spurs, spuLogServer *logService, uint32_t num_tasks)
+{
+	int ret;
+
+	// Create taskset...
+	CellSpursTaskset *taskset = (CellSpursTaskset *) memalign(CELL_SPURS_TASKSET_ALIGN, sizeof(CellSpursTaskset));
+
+	uint8_t prios[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+
+	ret = cellSpursCreateTaskset (
+		spurs,
+		taskset,
+		(uint64_t)0,
+		prios,
+		num_tasks);
+
+	if (ret)
+	{
+		fprintf(stderr, "cellSpursCreateTaskset failed: %d\n", ret);
+		free(taskset);
+		return ret;
+	}
+
+	// Create the tasks, passing each the effective address of its ring...
+	for (uint32_t i = 0; i < num_tasks; i++)
+	{
+		CellSpursTaskArgument Args;
+		Args.u64[0] = (uint64_t)(uintptr_t)logService->GetRing(i);
+		Args.u64[1] = i;
+
+		CellSpursTaskId	tid;
+		ret = cellSpursCreateTask(
+			taskset,
+			&tid,
+			_binary_task_spurs_task_log_elf_start,
+			(void*)0,
+			0,
+			(CellSpursTaskLsPattern*) 0,
+			&Args);
+
+		if (ret)
+		{
+			fprintf(stderr, "cellSpursCreateTask failed : %d\n", ret);
+			break;
+		}
+	}
+
+	// The taskset finishes once every task has exited...
+	int shutdown = cellSpursShutdownTaskset(taskset);
+	if (shutdown)
+	{
+		fprintf(stderr, "cellSpursShutdownTaskset failed : %d\n", shutdown);
+		return shutdown;
+	}
+
+	int join = cellSpursJoinTaskset(taskset);
+	if (join)
+	{
+		fprintf(stderr, "cellSpursJoinTaskset failed : %d\n", join);
+		return join;
+	}
+
+	free(taskset);
+
+	if (ret)
+		return ret;
+
+	printf("Sample completed.\n");
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ *  Description:
+ *  ppu-side SPU log service, see spu_log_server.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/timer.h>
+#include <cell/error.h>
+#include "spu_log_server.h"
+
+#define	STACK_SIZE				(1024 * 64)
+#define OUTPUT_SIZE				(64 * 1024)
+#define RECORDS_PER_BATCH		256
+
+void spuLogServer::spu_log_handler_entry(uint64_t arg)
+{
+	spuLogServer *p = (spuLogServer *)(uintptr_t) arg;
+
+	while (!p->m_terminate)
+	{
+		//Only sleep once every ring has been emptied...
+		if (p->Drain(RECORDS_PER_BATCH) == 0)
+			sys_timer_usleep(SPU_LOG_SERVER_POLL_USEC);
+	}
+
+	//Whatever the SPUs flushed before shutdown...
+	while (p->Drain(RECORDS_PER_BATCH))
+		;
+
+	sys_ppu_thread_exit(0);
+}
+
+uint32_t spuLogServer::Drain(uint32_t max_records)
+{
+	uint32_t total = 0;
+
+	for (uint32_t i = 0; i < m_num_rings; i++)
+	{
+		uint64_t before = m_consumers[i].consumed;
+		size_t length = spu_log_consume(&m_consumers[i], m_table, m_output, OUTPUT_SIZE, max_records);
+
+		if (length)
+			fwrite(m_output, 1, length, stdout);
+
+		total += (uint32_t)(m_consumers[i].consumed - before);
+	}
+
+	if (total)
+		fflush(stdout);
+
+	return total;
+}
+
+int spuLogServer::Initialize(const SpuLogFormatTable *table, uint32_t num_rings, int priority, uint32_t ring_size)
+{
+	int ret;
+
+	if (!table || num_rings == 0 || num_rings > SPU_LOG_SERVER_MAX_RINGS)
+	{
+		fprintf (stderr, "spuLogServer::Initialize() - invalid arguments\n");
+		return -1;
+	}
+
+	m_table = table;
+	m_num_rings = num_rings;
+	m_terminate = false;
+	m_rings = (SpuLogRing*)memalign(128, sizeof(SpuLogRing) * num_rings);
+	m_data = (uint8_t*)memalign(128, ring_size * num_rings);
+	m_output = (char*)malloc(OUTPUT_SIZE);
+
+	if (!m_rings || !m_data || !m_output)
+	{
+		fprintf (stderr, "spuLogServer::Initialize() - out of memory\n");
+		FreeBuffers();
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < num_rings; i++)
+	{
+		ret = spu_log_ring_init(&m_rings[i], m_data + i * ring_size, ring_size, i);
+		if (ret)
+		{
+			fprintf (stderr, "spuLogServer::Initialize() - ring size %u must be a power of two of at least %u\n", ring_size, SPU_LOG_MIN_RING_SIZE);
+			FreeBuffers();
+			return ret;
+		}
+		spu_log_consumer_init(&m_consumers[i], &m_rings[i]);
+	}
+
+	// Create a thread to drain the rings ...
+	ret = sys_ppu_thread_create (
+		&m_spu_log_handler, 
+		spu_log_handler_entry,
+		(uint64_t)(uintptr_t)this, 
+		priority, 
+		STACK_SIZE, 
+		SYS_PPU_THREAD_CREATE_JOINABLE, 
+		"spu_log_handler");
+
+	if (ret) 
+	{
+		fprintf (stderr, "spuLogServer::Initialize() - sys_ppu_thread_create failed (%d)\n", ret);
+		FreeBuffers();
+		return ret;
+	}
+
+	return CELL_OK;
+}
+
+uint64_t spuLogServer::GetConsumedCount() const
+{
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < m_num_rings; i++)
+		count += m_consumers[i].consumed;
+	return count;
+}
+
+uint64_t spuLogServer::GetDroppedCount() const
+{
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < m_num_rings; i++)
+		count += m_consumers[i].dropped;
+	return count;
+}
+
+int spuLogServer::Destroy()
+{
+	int ret;
+
+	// Ask the handler to drain and exit, then wait for it ...
+	m_terminate = true;
+
+	uint64_t exit_code;
+	ret = sys_ppu_thread_join (m_spu_log_handler, &exit_code);
+	if (ret) 
+	{
+		fprintf (stderr, "spuLogServer::Destroy() - sys_ppu_thread_join failed (%d)\n", ret);
+		return ret;
+	}
+
+	FreeBuffers();
+
+	return CELL_OK;
+}
+
+void spuLogServer::FreeBuffers()
+{
+	free(m_output);
+	free(m_data);
+	free(m_rings);
+	m_output = NULL;
+	m_data = NULL;
+	m_rings = NULL;
+}
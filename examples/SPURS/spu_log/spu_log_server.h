@@ -0,0 +1,46 @@
+/*
+ *  Description:
+ *  ppu-side SPU log service; drains the per-SPU rings of spu_log.h in
+ *  batches and prints them, without the SPUs waiting on the PPU.
+ */
+
+#ifndef _SPU_LOG_SERVER_H_INC_
+#define _SPU_LOG_SERVER_H_INC_
+
+#include <sys/ppu_thread.h>
+#include "spu_log.h"
+
+#define SPU_LOG_SERVER_MAX_RINGS		16
+#define SPU_LOG_SERVER_RING_SIZE		(64 * 1024)
+#define SPU_LOG_SERVER_POLL_USEC		1000
+
+class spuLogServer
+{
+public:
+	int Initialize(const SpuLogFormatTable *table, uint32_t num_rings, int priority = 200, uint32_t ring_size = SPU_LOG_SERVER_RING_SIZE);
+	int Destroy();
+
+	//Pass the effective address of a ring to the SPU program that writes it.
+	SpuLogRing* GetRing(uint32_t index) const { return m_rings && index < m_num_rings ? &m_rings[index] : NULL; }
+
+	//Totals across the rings, for reporting when the log is shut down.
+	uint64_t GetConsumedCount() const;
+	uint64_t GetDroppedCount() const;
+
+protected:
+	static void spu_log_handler_entry(uint64_t arg);
+	uint32_t Drain(uint32_t max_records);
+	void FreeBuffers();
+
+	const SpuLogFormatTable*	m_table;
+	SpuLogRing*					m_rings;
+	uint8_t*					m_data;
+	uint32_t					m_num_rings;
+	SpuLogConsumer				m_consumers[SPU_LOG_SERVER_MAX_RINGS];
+	char*						m_output;
+	sys_ppu_thread_t			m_spu_log_handler;
+	volatile bool				m_terminate;
+
+};
+
+#endif //#ifndef _SPU_LOG_SERVER_H_INC_
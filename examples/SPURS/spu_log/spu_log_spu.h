@@ -0,0 +1,54 @@
+/*
+ *  Description:
+ *  spu-side binding of spu_log.h onto the MFC. Include this rather than
+ *  spu_log.h in SPU programs that write a log ring.
+ *
+ *  SPU_LOG_TEST and SPU_LOG_WAIT set the tag mask, so a program that also
+ *  waits on its own tags must set its mask again before doing so.
+ *
+ *  Time stamps count up from the decrementer, which must be running; they
+ *  only order the records of one SPU.
+ */
+
+#ifndef __SPU_LOG_SPU_H__
+#define __SPU_LOG_SPU_H__
+
+#include <stdint.h>
+#include <spu_mfcio.h>
+
+static inline int spu_log_spu_test(uint32_t tag)
+{
+	mfc_write_tag_mask(1 << tag);
+	return mfc_read_tag_status_immediate() != 0;
+}
+
+static inline void spu_log_spu_wait(uint32_t tag)
+{
+	mfc_write_tag_mask(1 << tag);
+	mfc_read_tag_status_all();
+}
+
+//The decrementer counts down and wraps every 2^32 ticks...
+static inline uint64_t spu_log_spu_time(void)
+{
+	static uint32_t last = 0;
+	static uint32_t high = 0;
+	uint32_t now = ~spu_read_decrementer();
+
+	if (now < last)
+		high++;
+	last = now;
+
+	return ((uint64_t)high << 32) | now;
+}
+
+#define SPU_LOG_PUT(ls, ea, size, tag)		mfc_put((volatile void*)(ls), (ea), (size), (tag), 0, 0)
+#define SPU_LOG_PUTF(ls, ea, size, tag)		mfc_putf((volatile void*)(ls), (ea), (size), (tag), 0, 0)
+#define SPU_LOG_GET(ls, ea, size, tag)		mfc_get((volatile void*)(ls), (ea), (size), (tag), 0, 0)
+#define SPU_LOG_TEST(tag)					spu_log_spu_test(tag)
+#define SPU_LOG_WAIT(tag)					spu_log_spu_wait(tag)
+#define SPU_LOG_TIME()						spu_log_spu_time()
+
+#include "spu_log.h"
+
+#endif //#ifndef __SPU_LOG_SPU_H__
@@ -0,0 +1,53 @@
+/*
+ *  Description:
+ *  SPURS task of the spu_log sample. Writes a few records a step to the
+ *  log ring it is given, without waiting on the PPU to print them.
+ */
+
+#include <stdint.h>
+#include <spu_intrinsics.h>
+#include <cell/spurs.h>
+#include "../spu_log_spu.h"
+#include "../spu_log_formats.h"
+
+#define NUM_STEPS		1000
+
+static const uint32_t TAG_LOG = 1;
+static const uint32_t TAG_READ = 2;
+
+static SpuLogRing s_ring __attribute__((__aligned__(128)));
+static SpuLogWriter s_writer;
+
+int cellSpursTaskMain(qword argTask, uint64_t argTaskset)
+{
+	(void)argTaskset;
+
+	//The ring's effective address and the task's number are passed as parameters...
+	uint64_t ea_ring = spu_extract((vec_ullong2)argTask, 0);
+	uint32_t task = (uint32_t)spu_extract((vec_ullong2)argTask, 1);
+
+	//Only the size and data address of the ring header are used...
+	mfc_get(&s_ring, ea_ring, sizeof(s_ring), TAG_LOG, 0, 0);
+	mfc_write_tag_mask(1 << TAG_LOG);
+	mfc_read_tag_status_all();
+
+	spu_log_writer_init(&s_writer, ea_ring, &s_ring, TAG_LOG, TAG_READ);
+
+	SPU_LOG(&s_writer, LOG_TASK_START, task, s_ring.id);
+
+	uint64_t sum = 0;
+	for (uint32_t step = 1; step <= NUM_STEPS; step++)
+	{
+		sum += step * (task + 1);
+		SPU_LOG(&s_writer, LOG_TASK_STEP, task, step, sum, spu_log_double((double)sum / step));
+	}
+
+	SPU_LOG(&s_writer, LOG_TASK_END, task, s_writer.dropped, s_writer.stalls);
+
+	//Whatever is still staged, then wait for it to reach the ring...
+	spu_log_flush(&s_writer);
+	SPU_LOG_WAIT(TAG_LOG);
+
+	cellSpursExit ();
+	return 0;
+}
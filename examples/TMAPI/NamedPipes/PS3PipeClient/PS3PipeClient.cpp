@@ -1,6 +1,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <stdint.h>
 #include <cell/cell_fs.h>
 #include <cell/sysmodule.h>
 #include <sys/process.h>
@@ -28,9 +29,17 @@ int main(int argc, char* argv[])
 	if (err == CELL_FS_SUCCEEDED)
 	{
 		char msg[] = "Hello World!\n";
-		uint64_t tx;
+		uint64_t tx, rx;
 
-		cellFsWrite(pipe, msg, std::strlen(msg)+1, &tx);
+		// Messages are prefixed with their big-endian length, which is
+		// the PPU's native byte order.
+		uint32_t length = std::strlen(msg);
+		cellFsWrite(pipe, &length, sizeof(length), &tx);
+		cellFsWrite(pipe, msg, length, &tx);
+
+		// Wait for the server's (empty) acknowledgement.
+		uint32_t replyLength = 0;
+		cellFsRead(pipe, &replyLength, sizeof(replyLength), &rx);
 
 		cellFsClose(pipe);
 	}
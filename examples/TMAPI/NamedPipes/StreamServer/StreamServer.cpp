@@ -0,0 +1,1095 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "StreamServer.h"
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#endif
+
+#define STREAM_PIPE_BUFFER_SIZE		(64 * 1024)
+#define STREAM_MAX_PENDING			(64)	// Queued requests per client before reads are paused
+
+/////////////////////////////////////////////////////////////////////////
+// Common
+/////////////////////////////////////////////////////////////////////////
+
+StreamServer::StreamServer()
+: m_pHandler(NULL)
+, m_maxMessageSize(STREAM_DEFAULT_MAX_MESSAGE)
+, m_nextClientId(0)
+#if defined(_WIN32)
+, m_hPort(NULL)
+#else
+, m_listenFd(-1)
+, m_epollFd(-1)
+, m_wakeFd(-1)
+, m_bIoThreadStarted(false)
+#endif
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+#if defined(_WIN32)
+	InitializeCriticalSection(&m_lock);
+#else
+	pthread_mutex_init(&m_lock, NULL);
+	pthread_cond_init(&m_workReady, NULL);
+#endif
+}
+
+StreamServer::~StreamServer()
+{
+	Stop();
+#if defined(_WIN32)
+	DeleteCriticalSection(&m_lock);
+#else
+	pthread_cond_destroy(&m_workReady);
+	pthread_mutex_destroy(&m_lock);
+#endif
+}
+
+void StreamServer::GetStats(StreamServerStats& stats)
+{
+	Lock();
+	stats = m_stats;
+	Unlock();
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Windows: overlapped named pipes on an I/O completion port
+/////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+
+enum CONNECTION_STATE { CS_LISTENING, CS_READ_HEADER, CS_READ_BODY, CS_WRITING };
+
+struct StreamServer::Connection
+{
+	OVERLAPPED				overlapped;
+	HANDLE					hPipe;
+	uint32_t				id;
+	CONNECTION_STATE		state;
+	uint8_t					header[STREAM_LENGTH_PREFIX_SIZE];
+	std::vector<uint8_t>	inBuf;
+	std::vector<uint8_t>	outBuf;
+	uint32_t				expected;
+	uint32_t				done;
+};
+
+void StreamServer::Lock()
+{
+	EnterCriticalSection(&m_lock);
+}
+
+void StreamServer::Unlock()
+{
+	LeaveCriticalSection(&m_lock);
+}
+
+uint32_t StreamServer::DefaultWorkerCount() const
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+}
+
+bool StreamServer::Start(const char* pszName, StreamRequestHandler* pHandler, uint32_t numWorkers, uint32_t maxMessageSize)
+{
+	if (m_bRunning.Get() || !pszName || !pHandler)
+		return false;
+
+	m_name = pszName;
+	m_pHandler = pHandler;
+	m_maxMessageSize = maxMessageSize;
+	m_bStopping.Set(false);
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	m_hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+	if (m_hPort == NULL)
+		return false;
+
+	m_bRunning.Set(true);
+
+	for (int i = 0; i < STREAM_DEFAULT_LISTENERS; ++i)
+	{
+		if (!AddListener())
+		{
+			Stop();
+			return false;
+		}
+	}
+
+	if (numWorkers == 0)
+		numWorkers = DefaultWorkerCount();
+
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		HANDLE hThread = CreateThread(NULL, 0, WorkerThreadEntry, this, 0, NULL);
+		if (hThread == NULL)
+		{
+			Stop();
+			return false;
+		}
+		m_workers.push_back(hThread);
+	}
+
+	return true;
+}
+
+void StreamServer::Stop()
+{
+	if (!m_bRunning.Get())
+		return;
+
+	m_bStopping.Set(true);
+
+	// Cancel outstanding I/O; every connection is then closed by the
+	// completion handler that sees the failure. Connections between two
+	// operations notice m_bStopping before issuing the next one.
+	for (;;)
+	{
+		Lock();
+		bool bEmpty = m_connections.empty();
+		std::set<Connection*>::iterator it = m_connections.begin();
+		for (; it != m_connections.end(); ++it)
+			CancelIoEx((*it)->hPipe, NULL);
+		Unlock();
+
+		if (bEmpty || m_workers.empty())
+			break;
+		Sleep(10);
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		PostQueuedCompletionStatus(m_hPort, 0, 0, NULL);
+
+	if (!m_workers.empty())
+		WaitForMultipleObjects((DWORD)m_workers.size(), &m_workers[0], TRUE, INFINITE);
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		CloseHandle(m_workers[i]);
+	m_workers.clear();
+
+	// Only reached with connections left if no worker ever started, so
+	// wait for the cancelled connects here before freeing them.
+	while (!m_connections.empty())
+	{
+		Connection* pConn = *m_connections.begin();
+		DWORD dwBytes;
+		CancelIoEx(pConn->hPipe, NULL);
+		GetOverlappedResult(pConn->hPipe, &pConn->overlapped, &dwBytes, TRUE);
+		CloseConnection(pConn);
+	}
+
+	CloseHandle(m_hPort);
+	m_hPort = NULL;
+	m_bRunning.Set(false);
+}
+
+bool StreamServer::AddListener()
+{
+	HANDLE hPipe = CreateNamedPipeA(m_name.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, PIPE_UNLIMITED_INSTANCES,
+		STREAM_PIPE_BUFFER_SIZE, STREAM_PIPE_BUFFER_SIZE, 0, NULL);
+
+	if (hPipe == INVALID_HANDLE_VALUE)
+		return false;
+
+	Connection* pConn = new Connection;
+	memset(&pConn->overlapped, 0, sizeof(pConn->overlapped));
+	pConn->hPipe = hPipe;
+	pConn->id = 0;
+	pConn->state = CS_LISTENING;
+	pConn->expected = 0;
+	pConn->done = 0;
+
+	if (CreateIoCompletionPort(hPipe, m_hPort, (ULONG_PTR)pConn, 0) == NULL)
+	{
+		CloseHandle(hPipe);
+		delete pConn;
+		return false;
+	}
+
+	Lock();
+	m_connections.insert(pConn);
+	Unlock();
+
+	if (!ConnectNamedPipe(hPipe, &pConn->overlapped))
+	{
+		DWORD dwError = GetLastError();
+		if (dwError == ERROR_PIPE_CONNECTED)
+		{
+			// A client got in between create and connect; no packet is queued for that.
+			PostQueuedCompletionStatus(m_hPort, 0, (ULONG_PTR)pConn, &pConn->overlapped);
+		}
+		else if (dwError != ERROR_IO_PENDING)
+		{
+			CloseConnection(pConn);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+DWORD WINAPI StreamServer::WorkerThreadEntry(LPVOID pParam)
+{
+	static_cast<StreamServer*>(pParam)->WorkerThread();
+	return 0;
+}
+
+void StreamServer::WorkerThread()
+{
+	for (;;)
+	{
+		DWORD dwBytes = 0;
+		ULONG_PTR key = 0;
+		LPOVERLAPPED pOverlapped = NULL;
+
+		BOOL bOK = GetQueuedCompletionStatus(m_hPort, &dwBytes, &key, &pOverlapped, INFINITE);
+
+		// A packet without an OVERLAPPED is either a quit request or a failure of the port itself.
+		if (pOverlapped == NULL)
+			break;
+
+		OnCompletion(reinterpret_cast<Connection*>(key), bOK, dwBytes);
+	}
+}
+
+bool StreamServer::IssueRead(Connection* pConn)
+{
+	if (m_bStopping.Get())
+		return false;
+
+	uint8_t* pDest = (pConn->state == CS_READ_HEADER) ? pConn->header : &pConn->inBuf[0];
+
+	memset(&pConn->overlapped, 0, sizeof(pConn->overlapped));
+	if (!ReadFile(pConn->hPipe, pDest + pConn->done, pConn->expected - pConn->done, NULL, &pConn->overlapped))
+		return GetLastError() == ERROR_IO_PENDING;
+
+	return true;
+}
+
+bool StreamServer::IssueWrite(Connection* pConn)
+{
+	if (m_bStopping.Get())
+		return false;
+
+	memset(&pConn->overlapped, 0, sizeof(pConn->overlapped));
+	if (!WriteFile(pConn->hPipe, &pConn->outBuf[pConn->done], pConn->expected - pConn->done, NULL, &pConn->overlapped))
+		return GetLastError() == ERROR_IO_PENDING;
+
+	return true;
+}
+
+void StreamServer::OnCompletion(Connection* pConn, BOOL bOK, DWORD dwBytes)
+{
+	if (pConn->state == CS_LISTENING)
+	{
+		if (!bOK || m_bStopping.Get())
+		{
+			CloseConnection(pConn);
+			if (!m_bStopping.Get())
+				AddListener();
+			return;
+		}
+
+		Lock();
+		pConn->id = ++m_nextClientId;
+		m_stats.uActiveClients++;
+		m_stats.uTotalClients++;
+		Unlock();
+
+		// Replace this instance so there is always one waiting for the next client.
+		AddListener();
+
+		m_pHandler->OnConnect(pConn->id);
+
+		pConn->state = CS_READ_HEADER;
+		pConn->expected = STREAM_LENGTH_PREFIX_SIZE;
+		pConn->done = 0;
+		if (!IssueRead(pConn))
+			CloseConnection(pConn);
+		return;
+	}
+
+	if (!bOK || dwBytes == 0)
+	{
+		CloseConnection(pConn);
+		return;
+	}
+
+	pConn->done += dwBytes;
+	bool bIssued = false;
+
+	switch (pConn->state)
+	{
+	case CS_READ_HEADER:
+		if (pConn->done < pConn->expected)
+		{
+			bIssued = IssueRead(pConn);
+			break;
+		}
+
+		pConn->expected = StreamReadLength(pConn->header);
+		if (pConn->expected > m_maxMessageSize)
+			break;
+
+		pConn->inBuf.resize(pConn->expected);
+		pConn->state = CS_READ_BODY;
+		pConn->done = 0;
+
+		if (pConn->expected > 0)
+		{
+			bIssued = IssueRead(pConn);
+			break;
+		}
+		// Zero length request, dispatch straight away.
+
+	case CS_READ_BODY:
+		if (pConn->done < pConn->expected)
+		{
+			bIssued = IssueRead(pConn);
+			break;
+		}
+
+		if (!HandleRequest(pConn, pConn->inBuf.empty() ? NULL : &pConn->inBuf[0], pConn->expected, pConn->outBuf))
+			break;
+
+		pConn->state = CS_WRITING;
+		pConn->expected = (uint32_t)pConn->outBuf.size();
+		pConn->done = 0;
+		bIssued = IssueWrite(pConn);
+		break;
+
+	case CS_WRITING:
+		if (pConn->done < pConn->expected)
+		{
+			bIssued = IssueWrite(pConn);
+			break;
+		}
+
+		pConn->state = CS_READ_HEADER;
+		pConn->expected = STREAM_LENGTH_PREFIX_SIZE;
+		pConn->done = 0;
+		bIssued = IssueRead(pConn);
+		break;
+
+	default:
+		break;
+	}
+
+	if (!bIssued)
+		CloseConnection(pConn);
+}
+
+void StreamServer::CloseConnection(Connection* pConn)
+{
+	bool bWasClient = (pConn->state != CS_LISTENING);
+
+	Lock();
+	m_connections.erase(pConn);
+	if (bWasClient)
+		m_stats.uActiveClients--;
+	Unlock();
+
+	if (bWasClient)
+		DisconnectNamedPipe(pConn->hPipe);
+	CloseHandle(pConn->hPipe);
+
+	if (bWasClient)
+		m_pHandler->OnDisconnect(pConn->id);
+
+	delete pConn;
+}
+
+#else
+
+/////////////////////////////////////////////////////////////////////////
+// POSIX: Unix domain socket with an epoll loop and a worker pool
+/////////////////////////////////////////////////////////////////////////
+
+struct StreamServer::Connection
+{
+	int										fd;
+	uint32_t								id;
+	bool									bBusy;		// A worker owns 'request' and 'reply'
+	bool									bClosed;
+	uint32_t								events;
+	std::vector<uint8_t>					inBuf;
+	std::deque< std::vector<uint8_t> >		pending;
+	std::vector<uint8_t>					request;
+	std::vector<uint8_t>					reply;
+	bool									bReplyOK;
+	std::vector<uint8_t>					outBuf;
+	size_t									outPos;
+};
+
+static bool SetNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void StreamServer::Lock()
+{
+	pthread_mutex_lock(&m_lock);
+}
+
+void StreamServer::Unlock()
+{
+	pthread_mutex_unlock(&m_lock);
+}
+
+uint32_t StreamServer::DefaultWorkerCount() const
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (uint32_t)n : 1;
+}
+
+bool StreamServer::Start(const char* pszName, StreamRequestHandler* pHandler, uint32_t numWorkers, uint32_t maxMessageSize)
+{
+	if (m_bRunning.Get() || !pszName || !pHandler)
+		return false;
+
+	struct sockaddr_un addr;
+	if (strlen(pszName) >= sizeof(addr.sun_path))
+		return false;
+
+	m_name = pszName;
+	m_pHandler = pHandler;
+	m_maxMessageSize = maxMessageSize;
+	m_bStopping.Set(false);
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pszName);
+	unlink(pszName);
+
+	m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	m_epollFd = epoll_create1(0);
+	m_wakeFd = eventfd(0, EFD_NONBLOCK);
+
+	if (m_listenFd < 0 || m_epollFd < 0 || m_wakeFd < 0
+		|| bind(m_listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+		|| listen(m_listenFd, SOMAXCONN) != 0
+		|| !SetNonBlocking(m_listenFd))
+	{
+		m_bRunning.Set(true);
+		Stop();
+		return false;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+	ev.data.ptr = &m_wakeFd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+	m_bRunning.Set(true);
+
+	if (numWorkers == 0)
+		numWorkers = DefaultWorkerCount();
+
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, WorkerThreadEntry, this) != 0)
+		{
+			Stop();
+			return false;
+		}
+		m_workers.push_back(thread);
+	}
+
+	if (pthread_create(&m_ioThread, NULL, IoThreadEntry, this) != 0)
+	{
+		Stop();
+		return false;
+	}
+	m_bIoThreadStarted = true;
+
+	return true;
+}
+
+void StreamServer::Stop()
+{
+	if (!m_bRunning.Get())
+		return;
+
+	Lock();
+	m_bStopping.Set(true);
+	pthread_cond_broadcast(&m_workReady);
+	Unlock();
+
+	if (m_bIoThreadStarted)
+	{
+		Wake();
+		pthread_join(m_ioThread, NULL);
+		m_bIoThreadStarted = false;
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		pthread_join(m_workers[i], NULL);
+	m_workers.clear();
+
+	m_workQueue.clear();
+	m_doneQueue.clear();
+
+	while (!m_connections.empty())
+	{
+		Connection* pConn = *m_connections.begin();
+		if (!pConn->bClosed)
+		{
+			pConn->bBusy = false;
+			CloseConnection(pConn);
+		}
+		m_connections.erase(pConn);
+		delete pConn;
+	}
+
+	if (m_listenFd >= 0)
+	{
+		close(m_listenFd);
+		unlink(m_name.c_str());
+	}
+	if (m_epollFd >= 0)
+		close(m_epollFd);
+	if (m_wakeFd >= 0)
+		close(m_wakeFd);
+
+	m_listenFd = m_epollFd = m_wakeFd = -1;
+	m_bRunning.Set(false);
+}
+
+void StreamServer::Wake()
+{
+	uint64_t one = 1;
+	ssize_t res = write(m_wakeFd, &one, sizeof(one));
+	(void)res;
+}
+
+void* StreamServer::IoThreadEntry(void* pParam)
+{
+	static_cast<StreamServer*>(pParam)->IoThread();
+	return NULL;
+}
+
+void* StreamServer::WorkerThreadEntry(void* pParam)
+{
+	static_cast<StreamServer*>(pParam)->WorkerThread();
+	return NULL;
+}
+
+void StreamServer::WorkerThread()
+{
+	for (;;)
+	{
+		Lock();
+		while (m_workQueue.empty() && !m_bStopping.Get())
+			pthread_cond_wait(&m_workReady, &m_lock);
+
+		if (m_bStopping.Get())
+		{
+			Unlock();
+			break;
+		}
+
+		Connection* pConn = m_workQueue.front();
+		m_workQueue.pop_front();
+		Unlock();
+
+		pConn->bReplyOK = HandleRequest(pConn, pConn->request.empty() ? NULL : &pConn->request[0],
+			(uint32_t)pConn->request.size(), pConn->reply);
+
+		Lock();
+		m_doneQueue.push_back(pConn);
+		Unlock();
+		Wake();
+	}
+}
+
+void StreamServer::IoThread()
+{
+	struct epoll_event events[64];
+	std::vector<Connection*> graveyard;
+
+	while (!m_bStopping.Get())
+	{
+		int n = epoll_wait(m_epollFd, events, 64, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			void* pTag = events[i].data.ptr;
+
+			if (pTag == NULL)
+			{
+				AcceptClients();
+			}
+			else if (pTag == &m_wakeFd)
+			{
+				uint64_t count;
+				while (read(m_wakeFd, &count, sizeof(count)) > 0)
+					;
+
+				Lock();
+				std::deque<Connection*> done;
+				done.swap(m_doneQueue);
+				Unlock();
+
+				for (size_t j = 0; j < done.size(); ++j)
+				{
+					Connection* pConn = done[j];
+					pConn->bBusy = false;
+
+					if (pConn->bClosed)
+					{
+						graveyard.push_back(pConn);
+						continue;
+					}
+
+					if (!pConn->bReplyOK)
+					{
+						CloseConnection(pConn);
+						graveyard.push_back(pConn);
+						continue;
+					}
+
+					pConn->outBuf.insert(pConn->outBuf.end(), pConn->reply.begin(), pConn->reply.end());
+					FlushClient(pConn);
+					if (!pConn->bClosed)
+						DispatchNext(pConn);
+					else
+						graveyard.push_back(pConn);
+				}
+			}
+			else
+			{
+				Connection* pConn = static_cast<Connection*>(pTag);
+				if (pConn->bClosed)
+					continue;
+
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					ReadClient(pConn);
+				if (!pConn->bClosed && (events[i].events & EPOLLOUT))
+					FlushClient(pConn);
+
+				if (pConn->bClosed && !pConn->bBusy)
+					graveyard.push_back(pConn);
+			}
+		}
+
+		// Deleted only once the whole batch is processed, as later events may still refer to them.
+		for (size_t j = 0; j < graveyard.size(); ++j)
+		{
+			m_connections.erase(graveyard[j]);
+			delete graveyard[j];
+		}
+		graveyard.clear();
+	}
+}
+
+void StreamServer::AcceptClients()
+{
+	for (;;)
+	{
+		int fd = accept(m_listenFd, NULL, NULL);
+		if (fd < 0)
+			return;
+
+		if (!SetNonBlocking(fd))
+		{
+			close(fd);
+			continue;
+		}
+
+		Connection* pConn = new Connection;
+		pConn->fd = fd;
+		pConn->bBusy = false;
+		pConn->bClosed = false;
+		pConn->bReplyOK = false;
+		pConn->outPos = 0;
+		pConn->events = EPOLLIN;
+
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = pConn->events;
+		ev.data.ptr = pConn;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			close(fd);
+			delete pConn;
+			continue;
+		}
+
+		Lock();
+		pConn->id = ++m_nextClientId;
+		m_stats.uActiveClients++;
+		m_stats.uTotalClients++;
+		Unlock();
+
+		m_connections.insert(pConn);
+		m_pHandler->OnConnect(pConn->id);
+	}
+}
+
+static void UpdateEvents(int epollFd, int fd, uint32_t& current, uint32_t wanted, void* pTag)
+{
+	if (current == wanted)
+		return;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = wanted;
+	ev.data.ptr = pTag;
+	epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+	current = wanted;
+}
+
+void StreamServer::ReadClient(Connection* pConn)
+{
+	uint8_t buffer[STREAM_PIPE_BUFFER_SIZE];
+
+	for (;;)
+	{
+		ssize_t got = read(pConn->fd, buffer, sizeof(buffer));
+		if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			CloseConnection(pConn);
+			return;
+		}
+		if (got < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		pConn->inBuf.insert(pConn->inBuf.end(), buffer, buffer + got);
+		if ((size_t)got < sizeof(buffer))
+			break;
+	}
+
+	// Split whatever has arrived into complete requests.
+	size_t pos = 0;
+	while (pConn->inBuf.size() - pos >= STREAM_LENGTH_PREFIX_SIZE)
+	{
+		uint32_t length = StreamReadLength(&pConn->inBuf[pos]);
+		if (length > m_maxMessageSize)
+		{
+			CloseConnection(pConn);
+			return;
+		}
+
+		if (pConn->inBuf.size() - pos - STREAM_LENGTH_PREFIX_SIZE < length)
+			break;
+
+		std::vector<uint8_t>::iterator begin = pConn->inBuf.begin() + pos + STREAM_LENGTH_PREFIX_SIZE;
+		pConn->pending.push_back(std::vector<uint8_t>(begin, begin + length));
+		pos += STREAM_LENGTH_PREFIX_SIZE + length;
+	}
+	pConn->inBuf.erase(pConn->inBuf.begin(), pConn->inBuf.begin() + pos);
+
+	DispatchNext(pConn);
+}
+
+void StreamServer::DispatchNext(Connection* pConn)
+{
+	if (!pConn->bBusy && !pConn->pending.empty())
+	{
+		pConn->request.swap(pConn->pending.front());
+		pConn->pending.pop_front();
+		pConn->bBusy = true;
+
+		Lock();
+		m_workQueue.push_back(pConn);
+		pthread_cond_signal(&m_workReady);
+		Unlock();
+	}
+
+	// Stop reading from clients that are far ahead of the workers.
+	uint32_t wanted = 0;
+	if (pConn->pending.size() < STREAM_MAX_PENDING)
+		wanted |= EPOLLIN;
+	if (pConn->outPos < pConn->outBuf.size())
+		wanted |= EPOLLOUT;
+	UpdateEvents(m_epollFd, pConn->fd, pConn->events, wanted, pConn);
+}
+
+void StreamServer::FlushClient(Connection* pConn)
+{
+	while (pConn->outPos < pConn->outBuf.size())
+	{
+		ssize_t sent = send(pConn->fd, &pConn->outBuf[pConn->outPos], pConn->outBuf.size() - pConn->outPos, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				CloseConnection(pConn);
+				return;
+			}
+			break;
+		}
+		pConn->outPos += sent;
+	}
+
+	if (pConn->outPos == pConn->outBuf.size())
+	{
+		pConn->outBuf.clear();
+		pConn->outPos = 0;
+	}
+
+	uint32_t wanted = pConn->events & ~EPOLLOUT;
+	if (pConn->outPos < pConn->outBuf.size())
+		wanted |= EPOLLOUT;
+	UpdateEvents(m_epollFd, pConn->fd, pConn->events, wanted, pConn);
+}
+
+void StreamServer::CloseConnection(Connection* pConn)
+{
+	if (pConn->bClosed)
+		return;
+
+	pConn->bClosed = true;
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, pConn->fd, NULL);
+	close(pConn->fd);
+
+	Lock();
+	m_stats.uActiveClients--;
+	Unlock();
+
+	m_pHandler->OnDisconnect(pConn->id);
+}
+
+#endif
+
+bool StreamServer::HandleRequest(Connection* pConn, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& out)
+{
+	out.resize(STREAM_LENGTH_PREFIX_SIZE);
+
+	if (!m_pHandler->OnRequest(pConn->id, pData, size, out) || out.size() < STREAM_LENGTH_PREFIX_SIZE)
+		return false;
+
+	uint32_t replySize = (uint32_t)(out.size() - STREAM_LENGTH_PREFIX_SIZE);
+	if (replySize > m_maxMessageSize)
+		return false;
+
+	StreamWriteLength(&out[0], replySize);
+
+	Lock();
+	m_stats.uRequests++;
+	m_stats.uBytesIn += size + STREAM_LENGTH_PREFIX_SIZE;
+	m_stats.uBytesOut += out.size();
+	Unlock();
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// StreamClient
+/////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+
+StreamClient::StreamClient()
+: m_hPipe(INVALID_HANDLE_VALUE)
+{
+}
+
+StreamClient::~StreamClient()
+{
+	Close();
+}
+
+bool StreamClient::Connect(const char* pszName, uint32_t timeoutMs)
+{
+	Close();
+
+	DWORD dwStart = GetTickCount();
+	for (;;)
+	{
+		m_hPipe = CreateFileA(pszName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+		if (m_hPipe != INVALID_HANDLE_VALUE)
+			return true;
+
+		DWORD dwElapsed = GetTickCount() - dwStart;
+		if (dwElapsed >= timeoutMs)
+			return false;
+
+		if (GetLastError() == ERROR_PIPE_BUSY)
+			WaitNamedPipeA(pszName, timeoutMs - dwElapsed);
+		else
+			Sleep(10);
+	}
+}
+
+void StreamClient::Close()
+{
+	if (m_hPipe != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hPipe);
+		m_hPipe = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool StreamClient::IsConnected() const
+{
+	return m_hPipe != INVALID_HANDLE_VALUE;
+}
+
+bool StreamClient::WriteAll(const void* pData, uint32_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pData);
+	while (size > 0)
+	{
+		DWORD dwWritten = 0;
+		if (!WriteFile(m_hPipe, p, size, &dwWritten, NULL) || dwWritten == 0)
+			return false;
+		p += dwWritten;
+		size -= dwWritten;
+	}
+	return true;
+}
+
+bool StreamClient::ReadAll(void* pData, uint32_t size)
+{
+	uint8_t* p = static_cast<uint8_t*>(pData);
+	while (size > 0)
+	{
+		DWORD dwRead = 0;
+		if (!ReadFile(m_hPipe, p, size, &dwRead, NULL) || dwRead == 0)
+			return false;
+		p += dwRead;
+		size -= dwRead;
+	}
+	return true;
+}
+
+#else
+
+StreamClient::StreamClient()
+: m_fd(-1)
+{
+}
+
+StreamClient::~StreamClient()
+{
+	Close();
+}
+
+bool StreamClient::Connect(const char* pszName, uint32_t timeoutMs)
+{
+	Close();
+
+	struct sockaddr_un addr;
+	if (strlen(pszName) >= sizeof(addr.sun_path))
+		return false;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pszName);
+
+	for (uint32_t waited = 0; ; waited += 10)
+	{
+		m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_fd < 0)
+			return false;
+
+		if (connect(m_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+			return true;
+
+		Close();
+		if (waited >= timeoutMs)
+			return false;
+
+		struct timespec ts = { 0, 10 * 1000 * 1000 };
+		nanosleep(&ts, NULL);
+	}
+}
+
+void StreamClient::Close()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool StreamClient::IsConnected() const
+{
+	return m_fd >= 0;
+}
+
+bool StreamClient::WriteAll(const void* pData, uint32_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pData);
+	while (size > 0)
+	{
+		ssize_t sent = send(m_fd, p, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		p += sent;
+		size -= (uint32_t)sent;
+	}
+	return true;
+}
+
+bool StreamClient::ReadAll(void* pData, uint32_t size)
+{
+	uint8_t* p = static_cast<uint8_t*>(pData);
+	while (size > 0)
+	{
+		ssize_t got = read(m_fd, p, size);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return false;
+		p += got;
+		size -= (uint32_t)got;
+	}
+	return true;
+}
+
+#endif
+
+bool StreamClient::Transact(const void* pRequest, uint32_t size, std::vector<uint8_t>& response)
+{
+	if (!IsConnected())
+		return false;
+
+	uint8_t header[STREAM_LENGTH_PREFIX_SIZE];
+	StreamWriteLength(header, size);
+
+	if (!WriteAll(header, sizeof(header)) || (size > 0 && !WriteAll(pRequest, size)))
+		return false;
+
+	if (!ReadAll(header, sizeof(header)))
+		return false;
+
+	response.resize(StreamReadLength(header));
+	return response.empty() || ReadAll(&response[0], (uint32_t)response.size());
+}
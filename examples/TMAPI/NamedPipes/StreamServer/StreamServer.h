@@ -0,0 +1,207 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// Multi-client message server for host named pipes.
+//
+// PS3 processes open the server through file serving
+// ("/app_home/\\\\.\\pipe\\<name>") and debugger scripts open it with
+// ScriptCreateFile("\\\\.\\pipe\\<name>"). Every message in either direction
+// is a 32-bit big-endian payload length followed by the payload, so the
+// PS3 side can write the prefix natively. Each request gets exactly one
+// reply (possibly zero length) and requests from one client are handled
+// in order.
+//
+// On Windows the server keeps several overlapped pipe instances listening
+// and services all of them from one I/O completion port; the threads
+// waiting on the port are the request handler pool. On other platforms
+// the same interface is served over a Unix domain socket with an epoll
+// loop and a worker pool, so request handlers can be exercised on Linux.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <deque>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <atomic>
+#endif
+
+#define STREAM_LENGTH_PREFIX_SIZE		(4)
+#define STREAM_DEFAULT_MAX_MESSAGE		(16 * 1024 * 1024)
+#define STREAM_DEFAULT_LISTENERS		(4)
+
+// Length prefix helpers (big-endian).
+inline void StreamWriteLength(uint8_t* p, uint32_t length)
+{
+	p[0] = (uint8_t)(length >> 24);
+	p[1] = (uint8_t)(length >> 16);
+	p[2] = (uint8_t)(length >> 8);
+	p[3] = (uint8_t)(length);
+}
+
+inline uint32_t StreamReadLength(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// A flag one thread sets and others read without taking the server lock.
+class StreamFlag
+{
+public:
+#if defined(_WIN32)
+					StreamFlag() : m_value(0) {}
+
+	void			Set(bool bValue)	{ InterlockedExchange(&m_value, bValue ? 1 : 0); }
+	bool			Get() const			{ return InterlockedCompareExchange(const_cast<volatile LONG*>(&m_value), 0, 0) != 0; }
+#else
+					StreamFlag() : m_value(false) {}
+
+	void			Set(bool bValue)	{ m_value.store(bValue); }
+	bool			Get() const			{ return m_value.load(); }
+#endif
+
+private:
+					StreamFlag(const StreamFlag&);
+	StreamFlag&		operator=(const StreamFlag&);
+
+#if defined(_WIN32)
+	volatile LONG		m_value;
+#else
+	std::atomic<bool>	m_value;
+#endif
+};
+
+class StreamRequestHandler
+{
+public:
+	virtual			~StreamRequestHandler() {}
+
+	// Called on a pool thread for each complete request. The reply payload
+	// must be appended to 'response'; the bytes already in it are reserved
+	// for the length prefix, which the server fills in. Return false to
+	// drop the client without replying.
+	virtual bool	OnRequest(uint32_t clientId, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& response) = 0;
+
+	virtual void	OnConnect(uint32_t clientId)		{ (void)clientId; }
+	virtual void	OnDisconnect(uint32_t clientId)		{ (void)clientId; }
+};
+
+struct StreamServerStats
+{
+	uint32_t	uActiveClients;
+	uint64_t	uTotalClients;
+	uint64_t	uRequests;
+	uint64_t	uBytesIn;
+	uint64_t	uBytesOut;
+};
+
+class StreamServer
+{
+public:
+					StreamServer();
+					~StreamServer();
+
+	// pszName is the pipe name ("\\\\.\\pipe\\Name") on Windows or the
+	// socket path elsewhere. numWorkers of 0 uses one per processor.
+	bool			Start(const char* pszName, StreamRequestHandler* pHandler, uint32_t numWorkers = 0,
+						uint32_t maxMessageSize = STREAM_DEFAULT_MAX_MESSAGE);
+	void			Stop();
+	bool			IsRunning() const { return m_bRunning.Get(); }
+	void			GetStats(StreamServerStats& stats);
+
+private:
+	struct Connection;
+
+					StreamServer(const StreamServer&);
+	StreamServer&	operator=(const StreamServer&);
+
+	bool			HandleRequest(Connection* pConn, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& out);
+	void			Lock();
+	void			Unlock();
+	uint32_t		DefaultWorkerCount() const;
+
+	std::string				m_name;
+	StreamRequestHandler*	m_pHandler;
+	uint32_t				m_maxMessageSize;
+	uint32_t				m_nextClientId;
+	StreamFlag				m_bRunning;
+	StreamFlag				m_bStopping;
+	std::set<Connection*>	m_connections;
+	StreamServerStats		m_stats;
+
+#if defined(_WIN32)
+	static DWORD WINAPI		WorkerThreadEntry(LPVOID pParam);
+	void					WorkerThread();
+	bool					AddListener();
+	bool					IssueRead(Connection* pConn);
+	bool					IssueWrite(Connection* pConn);
+	void					OnCompletion(Connection* pConn, BOOL bOK, DWORD dwBytes);
+	void					CloseConnection(Connection* pConn);
+
+	HANDLE					m_hPort;
+	std::vector<HANDLE>		m_workers;
+	CRITICAL_SECTION		m_lock;
+#else
+	static void*			WorkerThreadEntry(void* pParam);
+	static void*			IoThreadEntry(void* pParam);
+	void					WorkerThread();
+	void					IoThread();
+	void					AcceptClients();
+	void					ReadClient(Connection* pConn);
+	void					FlushClient(Connection* pConn);
+	void					DispatchNext(Connection* pConn);
+	void					CloseConnection(Connection* pConn);
+	void					Wake();
+
+	int						m_listenFd;
+	int						m_epollFd;
+	int						m_wakeFd;
+	pthread_t				m_ioThread;
+	bool					m_bIoThreadStarted;
+	std::vector<pthread_t>	m_workers;
+	pthread_mutex_t			m_lock;
+	pthread_cond_t			m_workReady;
+	std::deque<Connection*>	m_workQueue;
+	std::deque<Connection*>	m_doneQueue;
+#endif
+};
+
+// Blocking client for the same protocol, for host tools and testing.
+class StreamClient
+{
+public:
+					StreamClient();
+					~StreamClient();
+
+	bool			Connect(const char* pszName, uint32_t timeoutMs = 5000);
+	void			Close();
+	bool			IsConnected() const;
+	bool			Transact(const void* pRequest, uint32_t size, std::vector<uint8_t>& response);
+
+private:
+					StreamClient(const StreamClient&);
+	StreamClient&	operator=(const StreamClient&);
+
+	bool			WriteAll(const void* pData, uint32_t size);
+	bool			ReadAll(void* pData, uint32_t size);
+
+#if defined(_WIN32)
+	HANDLE			m_hPipe;
+#else
+	int				m_fd;
+#endif
+};
+
+#endif
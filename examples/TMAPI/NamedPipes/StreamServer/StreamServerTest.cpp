@@ -0,0 +1,233 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// Exercises StreamServer with several clients at once: each client echoes
+// messages through the server until the server is stopped underneath it,
+// then checks every reply it got back. Each round starts the server,
+// waits until every client has had a reply, stops it with all of them
+// still connected and joins the clients. Exits non-zero on any failure.
+//
+//   StreamServerTest [<clients> [<rounds> [<name>]]]
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "StreamServer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#define TEST_DEFAULT_NAME			"\\\\.\\pipe\\StreamServerTest"
+#else
+#define TEST_DEFAULT_NAME			"/tmp/StreamServerTest.sock"
+#endif
+
+#define TEST_DEFAULT_CLIENTS		(8)
+#define TEST_DEFAULT_ROUNDS			(4)
+#define TEST_MAX_CLIENTS			(256)
+#define TEST_START_TIMEOUT_MS		(10000)
+
+class EchoHandler : public StreamRequestHandler
+{
+public:
+	virtual bool OnRequest(uint32_t clientId, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& response)
+	{
+		(void)clientId;
+		response.insert(response.end(), pData, pData + size);
+		return true;
+	}
+};
+
+struct ClientTest
+{
+	const char*		pszName;
+	uint32_t		index;
+	bool			bConnected;
+	uint32_t		replies;
+	uint32_t		badReplies;
+};
+
+static void SleepMs(uint32_t ms)
+{
+#if defined(_WIN32)
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+static void RunClient(ClientTest* pTest)
+{
+	StreamClient client;
+	pTest->bConnected = client.Connect(pTest->pszName);
+	if (!pTest->bConnected)
+		return;
+
+	// Runs until the server goes away; a stopped server fails the transaction.
+	for (uint32_t sequence = 0; ; ++sequence)
+	{
+		char request[64];
+		int length = sprintf(request, "client %u message %u", pTest->index, sequence);
+
+		std::vector<uint8_t> response;
+		if (!client.Transact(request, (uint32_t)length, response))
+			break;
+
+		if (response.size() != (size_t)length || memcmp(&response[0], request, length) != 0)
+			pTest->badReplies++;
+		pTest->replies++;
+	}
+}
+
+#if defined(_WIN32)
+
+typedef HANDLE TestThread;
+
+static DWORD WINAPI ClientThreadEntry(LPVOID pParam)
+{
+	RunClient(static_cast<ClientTest*>(pParam));
+	return 0;
+}
+
+static bool StartClient(TestThread& thread, ClientTest* pTest)
+{
+	thread = CreateThread(NULL, 0, ClientThreadEntry, pTest, 0, NULL);
+	return thread != NULL;
+}
+
+static void JoinClient(TestThread thread)
+{
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+#else
+
+typedef pthread_t TestThread;
+
+static void* ClientThreadEntry(void* pParam)
+{
+	RunClient(static_cast<ClientTest*>(pParam));
+	return NULL;
+}
+
+static bool StartClient(TestThread& thread, ClientTest* pTest)
+{
+	return pthread_create(&thread, NULL, ClientThreadEntry, pTest) == 0;
+}
+
+static void JoinClient(TestThread thread)
+{
+	pthread_join(thread, NULL);
+}
+
+#endif
+
+static bool RunRound(const char* pszName, uint32_t numClients, uint32_t round)
+{
+	EchoHandler handler;
+	StreamServer server;
+
+	if (!server.Start(pszName, &handler, 2))
+	{
+		printf("round %u: failed to start the server on %s\n", round, pszName);
+		return false;
+	}
+
+	std::vector<ClientTest> tests(numClients);
+	std::vector<TestThread> threads;
+	bool bOK = true;
+
+	for (uint32_t i = 0; i < numClients; ++i)
+	{
+		tests[i].pszName = pszName;
+		tests[i].index = i;
+		tests[i].bConnected = false;
+		tests[i].replies = 0;
+		tests[i].badReplies = 0;
+
+		TestThread thread;
+		if (!StartClient(thread, &tests[i]))
+		{
+			printf("round %u: failed to start client %u\n", round, i);
+			bOK = false;
+			break;
+		}
+		threads.push_back(thread);
+	}
+
+	// Stop only once every client is connected and has been answered, so
+	// the stop lands on live connections with requests in flight.
+	StreamServerStats stats;
+	uint32_t waited = 0;
+	for (;;)
+	{
+		server.GetStats(stats);
+		if (stats.uActiveClients == threads.size() && stats.uRequests >= 4 * threads.size())
+			break;
+
+		if (waited >= TEST_START_TIMEOUT_MS)
+		{
+			printf("round %u: only %u of %u clients active after %ums\n", round, stats.uActiveClients,
+				(uint32_t)threads.size(), waited);
+			bOK = false;
+			break;
+		}
+
+		SleepMs(10);
+		waited += 10;
+	}
+
+	server.Stop();
+
+	for (size_t i = 0; i < threads.size(); ++i)
+		JoinClient(threads[i]);
+
+	if (server.IsRunning())
+	{
+		printf("round %u: server still running after Stop()\n", round);
+		bOK = false;
+	}
+
+	uint32_t replies = 0;
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		if (!tests[i].bConnected || tests[i].replies == 0 || tests[i].badReplies)
+		{
+			printf("round %u: client %u connected %d, %u replies, %u bad\n", round, tests[i].index,
+				tests[i].bConnected ? 1 : 0, tests[i].replies, tests[i].badReplies);
+			bOK = false;
+		}
+		replies += tests[i].replies;
+	}
+
+	printf("round %u: %u clients, %u replies, stopped with %u connected: %s\n", round, (uint32_t)threads.size(),
+		replies, stats.uActiveClients, bOK ? "ok" : "FAILED");
+	return bOK;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t numClients = argc > 1 ? (uint32_t)atoi(argv[1]) : TEST_DEFAULT_CLIENTS;
+	uint32_t numRounds = argc > 2 ? (uint32_t)atoi(argv[2]) : TEST_DEFAULT_ROUNDS;
+	const char* pszName = argc > 3 ? argv[3] : TEST_DEFAULT_NAME;
+
+	if (numClients == 0 || numClients > TEST_MAX_CLIENTS || numRounds == 0)
+	{
+		printf("usage: StreamServerTest [<clients> [<rounds> [<name>]]]\n");
+		return 2;
+	}
+
+	bool bOK = true;
+	for (uint32_t round = 1; round <= numRounds; ++round)
+		bOK = RunRound(pszName, numClients, round) && bOK;
+
+	return bOK ? 0 : 1;
+}
@@ -2,39 +2,52 @@
 //
 
 #include "stdafx.h"
+#include "StreamServer.h"
 
-int _tmain(int argc, _TCHAR* argv[])
-{
-	DWORD dwBufferSize = 1024;
-	BYTE Buffer[1024];
-	DWORD dwRead;
+#define PIPE_NAME "\\\\.\\pipe\\NamedPipeExample.pipe"
 
-	HANDLE hPipe = ::CreateNamedPipe("\\\\.\\pipe\\NamedPipeExample.pipe", PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE|PIPE_WAIT, 1, 1024, 1024, 500/*ms*/, NULL);
+class PrintHandler : public StreamRequestHandler
+{
+public:
+	virtual bool OnRequest(uint32_t clientId, const uint8_t* pData, uint32_t size, std::vector<uint8_t>& response)
+	{
+		// Just print out what we've received. The empty reply acknowledges it.
+		printf("[%u] %.*s", clientId, (int)size, (const char*)pData);
+		return true;
+	}
 
-	if (hPipe == INVALID_HANDLE_VALUE) 
+	virtual void OnConnect(uint32_t clientId)
 	{
-		printf("CreatePipe failed"); 
-		return EXIT_FAILURE;
+		printf("[%u] connected\n", clientId);
 	}
 
-	// Wait for the client to connect; if it succeeds, 
-	// the function returns a nonzero value. If the function
-	// returns zero, GetLastError returns ERROR_PIPE_CONNECTED. 
+	virtual void OnDisconnect(uint32_t clientId)
+	{
+		printf("[%u] disconnected\n", clientId);
+	}
+};
 
-	BOOL bOK = ::ConnectNamedPipe(hPipe, NULL) || (::GetLastError() == ERROR_PIPE_CONNECTED);
+int _tmain(int argc, _TCHAR* argv[])
+{
+	PrintHandler handler;
+	StreamServer server;
 
-	while (bOK)
+	// Any number of clients may connect; each is serviced from the
+	// server's completion port threads.
+	if (!server.Start(PIPE_NAME, &handler))
 	{
-		bOK = ::ReadFile(hPipe, &Buffer, 1024, &dwRead, NULL);
-
-		// Just print out what we've received.
-		if (bOK)
-		{
-			printf("%s", (char*)Buffer);
-		}
+		printf("CreatePipe failed"); 
+		return EXIT_FAILURE;
 	}
 
-	::CloseHandle(hPipe);
+	printf("Listening on %s, press Enter to quit\n", PIPE_NAME);
+	getchar();
+
+	StreamServerStats stats;
+	server.GetStats(stats);
+	printf("%llu clients, %llu messages\n", stats.uTotalClients, stats.uRequests);
+
+	server.Stop();
 
 	return EXIT_SUCCESS;
 }
@@ -5,6 +5,11 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "BDCommand.h"
+#include <sstream>
+
+#define BD_DEPLOY_NO_FORMAT			(0xffffffff)
+#define BD_PHASE_NOT_RUN			(0xffffffff)
+#define BD_PROGRESS_INTERVAL_MS		(2000)
 
 TargetCommand* BDCommandFactory(void)
 {
@@ -17,9 +22,19 @@ m_Command(BDCMD_NONE),
 m_bWait(false),
 m_Result(SN_S_OK),
 m_bFinished(false),
-m_uXferid(0)
+m_uXferid(0),
+m_bForceTransfer(false),
+m_bRehash(false),
+m_bNoMount(false),
+m_uFormatMode(BD_DEPLOY_NO_FORMAT),
+m_uThreads(0),
+m_uAwaitedEvent(0),
+m_uBytesTransferred(0),
+m_pManifest(NULL),
+m_dwHashStart(0)
 {
-
+	for (UINT32 i = 0; i < BDPHASE_COUNT; ++i)
+		m_phaseTimes[i] = BD_PHASE_NOT_RUN;
 }
 
 BDCommand::~BDCommand()
@@ -42,6 +57,18 @@ bool BDCommand::ParseArgs(std::vector<std::string>& arguments)
 	StandardOption f("fn", "format");
 	StandardOption w("w", "wait");
 	StandardOption info("info", "info");
+	StandardOption dep("dep", "deploy");
+	StandardOption force("force", "force");
+	StandardOption rehash("rehash", "rehash");
+	StandardOption nm("nm", "no-mount");
+	SingleArgOption<UINT32> threads("j", "threads", 0);
+	SingleArgOption<std::string> ledger("ledger", "ledger", "");
+
+	force.SetParentDependency(&dep);
+	rehash.SetParentDependency(&dep);
+	nm.SetParentDependency(&dep);
+	threads.SetParentDependency(&dep);
+	ledger.SetParentDependency(&dep);
 
 	m_cmdLineHandler.AddArgument(w);
 	m_cmdLineHandler.AddArgument(c);
@@ -52,6 +79,12 @@ bool BDCommand::ParseArgs(std::vector<std::string>& arguments)
 	m_cmdLineHandler.AddArgument(d);
 	m_cmdLineHandler.AddArgument(s);
 	m_cmdLineHandler.AddArgument(info);
+	m_cmdLineHandler.AddArgument(dep);
+	m_cmdLineHandler.AddArgument(force);
+	m_cmdLineHandler.AddArgument(rehash);
+	m_cmdLineHandler.AddArgument(nm);
+	m_cmdLineHandler.AddArgument(threads);
+	m_cmdLineHandler.AddArgument(ledger);
 
 	m_cmdLineHandler.Parse(arguments);
 
@@ -61,7 +94,28 @@ bool BDCommand::ParseArgs(std::vector<std::string>& arguments)
 		m_bWait = true;
 	}
 
-	if (f.IsPassed())
+	if (dep.IsPassed())
+	{
+		m_Command = BDCommand::BDCMD_DEPLOY;
+		if (!s.IsPassed() || !d.IsPassed())
+		{
+			throw ArgumentException("Error - \"-dep\" requires -src and -dev parameters to be set!");
+		}
+		m_strFile = s.GetValue();
+		m_strDevice = d.GetValue();
+		m_bForceTransfer = force.IsSet();
+		m_bRehash = rehash.IsSet();
+		m_bNoMount = nm.IsSet();
+		m_uThreads = threads.GetValue();
+		m_strLedgerPath = ledger.GetValue();
+
+		// A format is part of the deployment, done only if the image has to be transferred.
+		if (f.IsPassed())
+			m_uFormatMode = SNPS3_BD_FORMAT_TYPE_NORMAL;
+		else if (q.IsPassed())
+			m_uFormatMode = SNPS3_BD_FORMAT_TYPE_QUICK;
+	}
+	else if (f.IsPassed())
 	{
 		m_Command =BDCommand::BDCMD_FORMAT;
 	}
@@ -140,6 +194,10 @@ int BDCommand::Run()
 			if(!DoQuery())
 				return GetErrorCodeOnError();
 			break;
+		case BDCMD_DEPLOY:
+			if (!DoDeploy())
+				return GetErrorCodeOnError();
+			break;
 		default:
 			DisplayUsageHelp();
 			return PS3CTRL_EXIT_ERROR;
@@ -343,6 +401,356 @@ bool BDCommand::DoQuery()
 	return true;
 }
 
+std::string BDCommand::GetTargetIdentity() const
+{
+	SNPS3TargetInfo info;
+	info.hTarget = m_targetId;
+	info.nFlags = SN_TI_TARGETID | SN_TI_NAME;
+	if (SN_SUCCEEDED(SNPS3GetTargetInfo(&info)) && info.pszName && info.pszName[0])
+		return info.pszName;
+
+	if (!m_targetName.empty())
+		return m_targetName;
+
+	std::ostringstream strId;
+	strId << "target " << m_targetId;
+	return strId.str();
+}
+
+bool BDCommand::PollHashing(DWORD dwMilliseconds)
+{
+	if (!m_pManifest || !m_pManifest->IsBuilding())
+		return true;
+
+	if (!m_pManifest->WaitForBuild(dwMilliseconds))
+		return false;
+
+	m_phaseTimes[BDPHASE_HASH] = GetTickCount() - m_dwHashStart;
+	return true;
+}
+
+bool BDCommand::QueryDevice(const char* pszImage, UINT64 uImageSize, bool bRequired, bool& bHoldsImage, bool& bMounted)
+{
+	bHoldsImage = false;
+	bMounted = false;
+
+	SNRESULT snr;
+	SNPS3_BD_QUERY_DATA BdInfo;
+	memset(&BdInfo, 0, sizeof(BdInfo));
+	if (SN_FAILED(snr = SNPS3BDQuery(m_targetId, m_strDevice.c_str(), &BdInfo)))
+	{
+		if (bRequired)
+			PrintError(snr, L"Query has returned an error!\n");
+		return !bRequired;
+	}
+
+	// The device only knows the name and size of the file it was given.
+	char szDeviceImage[sizeof(BdInfo.image_file_name) + 1];
+	memcpy(szDeviceImage, BdInfo.image_file_name, sizeof(BdInfo.image_file_name));
+	szDeviceImage[sizeof(BdInfo.image_file_name)] = '\0';
+
+	const char* pszDeviceName = strrchr(szDeviceImage, '\\');
+	if (!pszDeviceName)
+		pszDeviceName = strrchr(szDeviceImage, '/');
+	pszDeviceName = pszDeviceName ? pszDeviceName + 1 : szDeviceImage;
+
+	const char* pszImageName = strrchr(pszImage, '\\');
+	if (!pszImageName)
+		pszImageName = strrchr(pszImage, '/');
+	pszImageName = pszImageName ? pszImageName + 1 : pszImage;
+
+	bHoldsImage = BdInfo.image_type != 0 && BdInfo.image_file_size == uImageSize && _stricmp(pszDeviceName, pszImageName) == 0;
+	bMounted = BdInfo.image_type != 0 && BdInfo.bdemu_selected_index == BdInfo.image_index;
+	return true;
+}
+
+bool BDCommand::WaitForBDEvent(UINT32 uEvent)
+{
+	DWORD dwStart = GetTickCount();
+	DWORD dwLastReport = dwStart;
+
+	// TMAPI has no handle to wait on; the event handler only runs inside
+	// SNPS3Kick() on this thread, so the target is polled. Each poll drains
+	// every queued event, and the sleep between them keeps it off the CPU.
+	while (!m_bFinished)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bFinished)
+			/* Do nothing */;
+
+		if (m_bFinished)
+			break;
+
+		// The image is still being hashed while the target works.
+		PollHashing(0);
+
+		DWORD dwNow = GetTickCount();
+		if (uEvent == SN_TGT_BD_ISOTRANSFER_FINISHED && m_uBytesTransferred && dwNow - dwLastReport >= BD_PROGRESS_INTERVAL_MS)
+		{
+			DWORD dwElapsed = dwNow - dwStart;
+			PrintMessage(ML_INFO, L"Transferred %I64u MB (%.1f MB/s)\n", m_uBytesTransferred / (1024 * 1024),
+				(double)m_uBytesTransferred / (1024.0 * 1024.0) / (dwElapsed / 1000.0));
+			dwLastReport = dwNow;
+		}
+
+		if (CheckForEscape())
+		{
+			if (uEvent == SN_TGT_BD_ISOTRANSFER_FINISHED)
+				SNPS3CancelFileTransfer(m_targetId, m_uXferid);
+			PrintMessage(ML_WARN, L"Deployment stopped\n");
+			return false;
+		}
+
+		::Sleep(10);
+	}
+
+	return true;
+}
+
+bool BDCommand::DoDeploy()
+{
+	char szFullPath[MAX_PATH+1];
+
+	if (0 == GetFullPathNameA(m_strFile.c_str(),MAX_PATH+1,szFullPath,NULL))
+	{
+		PrintError(SN_E_FILE_ERROR, L"Cannot resolve the source path!\n");
+		return false;
+	}
+
+	UINT64 uImageSize, uWriteTime;
+	if (!BDImageManifest::GetImageAttributes(UTF8ToWChar(szFullPath).c_str(), uImageSize, uWriteTime))
+	{
+		PrintError(SN_E_FILE_ERROR, L"Cannot open the source file!\n");
+		return false;
+	}
+
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3RegisterTargetEventHandler(m_targetId,BDCommand::TargetEventCallback,(void*)this)))
+	{
+		PrintError(snr, L"Error registering for target events!\n");
+		return false;
+	}
+
+	// Progress only; the transfer's completion comes as a target event.
+	bool bProgress = SN_SUCCEEDED(SNPS3RegisterFTPEventHandler(m_targetId,BDCommand::FTPEventCallback,(void*)this));
+
+	bool bOK = RunDeploySequence(szFullPath, uImageSize);
+	m_pManifest = NULL;
+
+	SNPS3CancelTargetEvents(m_targetId);
+	if (bProgress)
+		SNPS3CancelFTPEvents(m_targetId);
+
+	return bOK;
+}
+
+bool BDCommand::RunDeploySequence(const char* pszImage, UINT64 uImageSize)
+{
+	DWORD dwStart = GetTickCount();
+	DWORD dwPhase;
+	SNRESULT snr;
+
+	std::wstring strImage = UTF8ToWChar(pszImage);
+	std::wstring strManifest = BDImageManifest::GetManifestPath(strImage.c_str());
+
+	// Hashing starts first and carries on underneath the target operations;
+	// it is only waited for when its digest is needed.
+	BDImageManifest previous;
+	BDImageManifest manifest;
+	bool bPrevious = previous.Load(strManifest.c_str());
+
+	if (bPrevious && !m_bRehash && previous.IsCurrent(strImage.c_str()))
+	{
+		m_pManifest = &previous;
+		m_phaseTimes[BDPHASE_HASH] = 0;
+		PrintMessage(ML_INFO, L"Image is unchanged since %s was written\n", strManifest.c_str());
+	}
+	else
+	{
+		m_pManifest = &manifest;
+		m_dwHashStart = GetTickCount();
+		if (!manifest.StartBuild(strImage.c_str(), BD_MANIFEST_DEFAULT_BLOCK_SIZE, m_uThreads))
+		{
+			PrintError(SN_E_FILE_ERROR, L"Cannot read the source file!\n");
+			return false;
+		}
+		PrintMessage(ML_INFO, L"Hashing %s...\n", strImage.c_str());
+	}
+
+	std::wstring strLedger = m_strLedgerPath.empty() ? BDDeployLedger::GetDefaultPath() : UTF8ToWChar(m_strLedgerPath);
+	std::string strTarget = GetTargetIdentity();
+	BDDeployLedger ledger;
+	if (!ledger.Load(strLedger.c_str()))
+		PrintMessage(ML_WARN, L"Cannot read %s, every device will be treated as holding an unknown image\n", strLedger.c_str());
+
+	bool bHoldsImage, bMounted;
+	dwPhase = GetTickCount();
+	if (!QueryDevice(pszImage, uImageSize, false, bHoldsImage, bMounted))
+		return false;
+	m_phaseTimes[BDPHASE_QUERY] = GetTickCount() - dwPhase;
+
+	bool bTransfer = m_bForceTransfer || !bHoldsImage;
+	if (!bTransfer)
+	{
+		// A device can only be trusted to hold this image, and not another
+		// of the same name and size, if we recorded putting it there.
+		PrintMessage(ML_INFO, L"%s holds an image of the same name and size, checking its contents...\n", UTF8ToWChar(m_strDevice).c_str());
+		PollHashing(INFINITE);
+
+		const BDDeployRecord* pRecord = ledger.Find(strTarget, m_strDevice);
+		bTransfer = !m_pManifest->IsValid() || !pRecord || pRecord->uDigest != m_pManifest->GetDigest() || pRecord->uImageSize != uImageSize;
+	}
+
+	if (bTransfer)
+	{
+		// Whatever the device held is about to be replaced.
+		if (m_uFormatMode != BD_DEPLOY_NO_FORMAT)
+			ledger.RemoveTarget(strTarget);
+		else
+			ledger.Remove(strTarget, m_strDevice);
+		ledger.Save(strLedger.c_str());
+
+		if (bMounted)
+		{
+			dwPhase = GetTickCount();
+			if (SN_FAILED(snr = SNPS3BDEject(m_targetId,m_strDevice.c_str())))
+			{
+				PrintError(snr, L"Error unmounting disc image!\n");
+				return false;
+			}
+			m_phaseTimes[BDPHASE_UNMOUNT] = GetTickCount() - dwPhase;
+			bMounted = false;
+		}
+
+		if (m_uFormatMode != BD_DEPLOY_NO_FORMAT)
+		{
+			PrintMessage(ML_INFO, L"Formatting BD emulator, please wait...\n");
+			dwPhase = GetTickCount();
+			m_uAwaitedEvent = SN_TGT_BD_FORMAT_FINISHED;
+			m_bFinished = false;
+			if (SN_FAILED(snr = SNPS3BDFormat(m_targetId,"/dev_bdemu",m_uFormatMode)))
+			{
+				PrintError(snr, L"Error formatting the BD emulator!\n");
+				return false;
+			}
+			if (!WaitForBDEvent(SN_TGT_BD_FORMAT_FINISHED))
+				return false;
+			if (SN_FAILED(m_Result))
+			{
+				PrintError(m_Result, L"Error formatting BD emulator!\n");
+				return false;
+			}
+			m_phaseTimes[BDPHASE_FORMAT] = GetTickCount() - dwPhase;
+		}
+
+		PrintMessage(ML_INFO, L"Transferring %I64u MB disc image, press ESC to stop...\n", uImageSize / (1024 * 1024));
+		dwPhase = GetTickCount();
+		m_uAwaitedEvent = SN_TGT_BD_ISOTRANSFER_FINISHED;
+		m_bFinished = false;
+		m_uBytesTransferred = 0;
+		if (SN_FAILED(snr = SNPS3BDTransferImage(m_targetId,pszImage,m_strDevice.c_str(),&m_uXferid)))
+		{
+			PrintError(snr, L"Error copying disc image!\n");
+			return false;
+		}
+		if (!WaitForBDEvent(SN_TGT_BD_ISOTRANSFER_FINISHED))
+			return false;
+		if (SN_FAILED(m_Result))
+		{
+			PrintError(m_Result, L"Error copying disc image!\n");
+			return false;
+		}
+		m_phaseTimes[BDPHASE_TRANSFER] = GetTickCount() - dwPhase;
+
+		DWORD dwElapsed = m_phaseTimes[BDPHASE_TRANSFER];
+		PrintMessage(ML_INFO, L"Disc image successfully transferred (%.1f MB/s)\n",
+			dwElapsed ? (double)uImageSize / (1024.0 * 1024.0) / (dwElapsed / 1000.0) : 0.0);
+
+		// Recorded straight away, so a deployment that stops after this
+		// point picks up at the mount next time.
+		PollHashing(INFINITE);
+		if (m_pManifest->IsValid())
+		{
+			BDDeployRecord record;
+			record.strTarget = strTarget;
+			record.strDevice = m_strDevice;
+			record.uDigest = m_pManifest->GetDigest();
+			record.uImageSize = uImageSize;
+			record.strImage = pszImage;
+
+			// Reloaded, another instance may have deployed to another target meanwhile.
+			ledger.Load(strLedger.c_str());
+			ledger.Set(record);
+			if (!ledger.Save(strLedger.c_str()))
+				PrintMessage(ML_WARN, L"Failed to write %s\n", strLedger.c_str());
+		}
+		else
+		{
+			PrintMessage(ML_WARN, L"Failed to hash %s, the deployment has not been recorded\n", strImage.c_str());
+		}
+	}
+	else
+	{
+		PrintMessage(ML_INFO, L"%s already holds this image, skipping the transfer\n", UTF8ToWChar(m_strDevice).c_str());
+	}
+
+	if (!m_bNoMount && !bMounted)
+	{
+		dwPhase = GetTickCount();
+		if (SN_FAILED(snr = SNPS3BDInsert(m_targetId,m_strDevice.c_str())))
+		{
+			PrintError(snr, L"Error mounting disc image!\n");
+			return false;
+		}
+		m_phaseTimes[BDPHASE_MOUNT] = GetTickCount() - dwPhase;
+	}
+
+	dwPhase = GetTickCount();
+	if (!QueryDevice(pszImage, uImageSize, true, bHoldsImage, bMounted))
+		return false;
+	if (!bHoldsImage || (!m_bNoMount && !bMounted))
+	{
+		if (!bHoldsImage)
+		{
+			ledger.Load(strLedger.c_str());
+			ledger.Remove(strTarget, m_strDevice);
+			ledger.Save(strLedger.c_str());
+		}
+		PrintMessage(ML_ERROR, L"%s does not report the image as %s\n", UTF8ToWChar(m_strDevice).c_str(), bHoldsImage ? L"mounted" : L"transferred");
+		return false;
+	}
+	m_phaseTimes[BDPHASE_VERIFY] = GetTickCount() - dwPhase;
+
+	PollHashing(INFINITE);
+
+	if (m_pManifest == &manifest && manifest.IsValid())
+	{
+		UINT32 uChanged = bPrevious ? manifest.CountChangedBlocks(previous) : ~0U;
+		if (uChanged != ~0U)
+			PrintMessage(ML_INFO, L"%u of %u blocks changed since the last manifest\n", uChanged, manifest.GetBlockCount());
+
+		if (!manifest.Save(strManifest.c_str()))
+			PrintMessage(ML_WARN, L"Failed to write %s\n", strManifest.c_str());
+	}
+
+	PrintMessage(ML_INFO, L"Disc image deployed to %s\n", UTF8ToWChar(m_strDevice).c_str());
+	PrintPhaseTimes(GetTickCount() - dwStart);
+
+	return true;
+}
+
+void BDCommand::PrintPhaseTimes(DWORD dwTotal) const
+{
+	static const WCHAR* s_phaseNames[BDPHASE_COUNT] = { L"hash", L"query", L"unmount", L"format", L"transfer", L"mount", L"verify" };
+
+	// Hashing overlaps the other phases, so they add up to more than the total.
+	for (UINT32 i = 0; i < BDPHASE_COUNT; ++i)
+	{
+		if (m_phaseTimes[i] != BD_PHASE_NOT_RUN)
+			PrintMessage(ML_INFO, L"  %-10s %6u.%03u s\n", s_phaseNames[i], m_phaseTimes[i] / 1000, m_phaseTimes[i] % 1000);
+	}
+	PrintMessage(ML_INFO, L"  %-10s %6u.%03u s\n", L"total", dwTotal / 1000, dwTotal % 1000);
+}
+
 void BDCommand::DisplayUsageHelp() const
 {
 	std::cout << "The bdemu command allows you to use the BD emulator" << std::endl << std::endl;
@@ -355,6 +763,13 @@ void BDCommand::DisplayUsageHelp() const
 	std::cout << "  -umt" << "\t\t" << "Unmount the emulator device" << std::endl;
 	std::cout << "  -fq" << "\t\t" << "Quick format the emulator device" << std::endl;
 	std::cout << "  -fn" << "\t\t" << "Full format the emulator device" << std::endl;
+	std::cout << "  -dep" << "\t\t" << "Deploy an ISO image: transfer it unless the device already holds it, then mount" << std::endl;
+	std::cout << "      " << "\t\t" << "and verify it (with -src and -dev, and -fq or -fn to format before a transfer)" << std::endl;
+	std::cout << "  -force" << "\t\t" << "Transfer the image even if the device already holds it (-dep only)" << std::endl;
+	std::cout << "  -rehash" << "\t" << "Hash the image even if its <image>.bdmf manifest is up to date (-dep only)" << std::endl;
+	std::cout << "  -nm" << "\t\t" << "Do not mount the image once deployed (-dep only)" << std::endl;
+	std::cout << "  -j <threads>" << "\t" << "Number of hashing threads (default one per core) (-dep only)" << std::endl;
+	std::cout << "  -ledger <path>" << "\t" << "Record of the images deployed to each device (default in %TEMP%) (-dep only)" << std::endl;
 	std::cout << "  -src" << "\t\t" << "Disc image file" << std::endl;
 	std::cout << "  -dev" << "\t\t" << "Destination device (/dev_bdemu/0 etc...)" << std::endl;
 	std::cout << "  -w" << "\t\t" << "Wait until the operation finishes (-cp, -fq, -fn only)" << std::endl;
@@ -382,6 +797,17 @@ void BDCommand::TargetEventCallback(HTARGET target,UINT32 uType,UINT32 uEventSpe
 
 	SN_TM_EVENT_TGT_BD_DATA *pData = (SN_TM_EVENT_TGT_BD_DATA *)(pDataHdr+1);
 
+	// A deployment runs several operations in turn and waits on one event at a time.
+	if (pThis->m_Command == BDCommand::BDCMD_DEPLOY)
+	{
+		if (pDataHdr->uEvent == pThis->m_uAwaitedEvent)
+		{
+			pThis->m_Result = pData->uResult;
+			pThis->m_bFinished = true;
+		}
+		return;
+	}
+
 	switch (pDataHdr->uEvent)
 	{
 		case SN_TGT_BD_ISOTRANSFER_FINISHED:
@@ -414,3 +840,20 @@ void BDCommand::TargetEventCallback(HTARGET target,UINT32 uType,UINT32 uEventSpe
 			break;
 	}
 }
+
+void BDCommand::FTPEventCallback(HTARGET target,UINT32 uType,UINT32 /*uEventSpecific*/,SNRESULT resultCode,UINT32 udataLength,BYTE* data ,void* pUserdata)
+{
+	BDCommand* pThis = static_cast<BDCommand*>(pUserdata);
+
+	if (!pThis || !data || SN_FAILED(resultCode) || pThis->m_targetId != target || uType != SN_EVENT_FTP)
+		return;
+
+	TMAPI_FT_NOTIFICATION* pNotification = (TMAPI_FT_NOTIFICATION*)data;
+	UINT32 uCount = udataLength / sizeof(TMAPI_FT_NOTIFICATION);
+
+	for (UINT32 i = 0; i < uCount; ++i, ++pNotification)
+	{
+		if (pNotification->m_TransferID == pThis->m_uXferid && pNotification->m_Type == TMAPI_FT_PROGRESS)
+			pThis->m_uBytesTransferred = pNotification->m_BytesTransferred;
+	}
+}
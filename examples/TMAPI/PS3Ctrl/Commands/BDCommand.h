@@ -9,6 +9,7 @@
 
 #include "TargetCommand.h"
 #include "SingleArgOption.h"
+#include "BDImageManifest.h"
 
 class BDCommand : public TargetCommand
 {
@@ -19,13 +20,21 @@ public:
 	virtual int		Run();
 
 protected:
-	typedef enum	{BDCMD_NONE=-1,BDCMD_COPY=0,BDCMD_MOUNT,BDCMD_UNMOUNT,BDCMD_FORMAT,BDCMD_QUICKFORMAT,BDCMD_QUERY} bdcmd_t;
+	typedef enum	{BDCMD_NONE=-1,BDCMD_COPY=0,BDCMD_MOUNT,BDCMD_UNMOUNT,BDCMD_FORMAT,BDCMD_QUICKFORMAT,BDCMD_QUERY,BDCMD_DEPLOY} bdcmd_t;
+	typedef enum	{BDPHASE_HASH=0,BDPHASE_QUERY,BDPHASE_UNMOUNT,BDPHASE_FORMAT,BDPHASE_TRANSFER,BDPHASE_MOUNT,BDPHASE_VERIFY,BDPHASE_COUNT} bdphase_t;
 
 	bool			DoFormat(UINT32 mode);
 	bool			DoCopy();
 	bool			DoMount();
 	bool			DoUnmount();
 	bool			DoQuery();
+	bool			DoDeploy();
+	bool			RunDeploySequence(const char* pszImage, UINT64 uImageSize);
+	bool			QueryDevice(const char* pszImage, UINT64 uImageSize, bool bRequired, bool& bHoldsImage, bool& bMounted);
+	bool			WaitForBDEvent(UINT32 uEvent);
+	bool			PollHashing(DWORD dwMilliseconds);
+	std::string		GetTargetIdentity() const;
+	void			PrintPhaseTimes(DWORD dwTotal) const;
 	virtual void	DisplayUsageHelp() const;
 
 	bdcmd_t			m_Command;
@@ -38,7 +47,22 @@ protected:
 
 	std::string			m_strDevice;
 	std::string			m_strFile;
+
+	// Deployment
+	bool				m_bForceTransfer;
+	bool				m_bRehash;
+	bool				m_bNoMount;
+	UINT32				m_uFormatMode;			// BD_DEPLOY_NO_FORMAT or SNPS3_BD_FORMAT_TYPE_*
+	UINT32				m_uThreads;
+	std::string			m_strLedgerPath;
+	UINT32				m_uAwaitedEvent;
+	UINT64				m_uBytesTransferred;
+	BDImageManifest*	m_pManifest;
+	DWORD				m_dwHashStart;
+	DWORD				m_phaseTimes[BDPHASE_COUNT];
+
 	static void __stdcall TargetEventCallback(HTARGET target,UINT32 uType,UINT32 uEventSpecific,SNRESULT resultCode,UINT32 udataLength,BYTE* data ,void* pUserdata);		
+	static void __stdcall FTPEventCallback(HTARGET target,UINT32 uType,UINT32 uEventSpecific,SNRESULT resultCode,UINT32 udataLength,BYTE* data ,void* pUserdata);
 };
 
 TargetCommand* BDCommandFactory(void);
@@ -0,0 +1,224 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "BreakCommand.h"
+
+TargetCommand* BreakCommandFactory(void)
+{
+	return new BreakCommand();
+}
+
+BreakCommand::BreakCommand()
+: DebugEventCommand()
+, m_pBreakpoints(NULL)
+, m_uHits(0)
+, m_uOtherHits(0)
+{
+
+}
+
+BreakCommand::~BreakCommand()
+{
+	delete m_pBreakpoints;
+}
+
+bool BreakCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS, true);
+	SingleArgOption<std::string> f("f", "file", "");
+	StandardOption c("c", "continue");
+	SingleArgOption<UINT32> to("to", "timeout", 0);
+
+	m_cmdLineHandler.AddArgument(pid);
+	m_cmdLineHandler.AddArgument(f);
+	m_cmdLineHandler.AddArgument(c);
+	m_cmdLineHandler.AddArgument(to);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	m_processId = pid.GetValue();
+	m_bContinue = c.IsSet();
+	m_uTimeout = to.GetValue();
+
+	AddSpecs(f.GetValue(), m_cmdLineHandler.GetRemainingArguments(), "tracepoint", "<address>[:<name>]");
+
+	if (m_tracepoints.empty())
+		throw ArgumentException("Error - No tracepoints specified");
+
+	return true;
+}
+
+int BreakCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	m_pBreakpoints = new BreakpointManager(m_targetId);
+
+	if (!RegisterHandler())
+		return GetErrorCodeOnError();
+
+	bool bOk = AddTracepoints() && WaitForHits();
+
+	// Breakpoints set by anything else are left as they are.
+	m_pBreakpoints->RemoveAll();
+	SNRESULT snr;
+	if (SN_FAILED(snr = m_pBreakpoints->Apply()))
+	{
+		PrintError(snr, L"Failed to clear breakpoints");
+		bOk = false;
+	}
+	else
+	{
+		PrintMessage(ML_INFO, L"Cleared %u breakpoints\n", m_pBreakpoints->GetClearedCount());
+	}
+
+	UnRegisterHandler();
+
+	if (!bOk)
+		return GetErrorCodeOnError();
+
+	return bRes;
+}
+
+bool BreakCommand::ParseTracepoint(const std::string& strSpec, Tracepoint& tracepoint) const
+{
+	// <address>[:<name>]
+	size_t uColon = strSpec.find(':');
+	std::string strAddress = strSpec.substr(0, uColon);
+	if (strAddress.empty())
+		return false;
+
+	char* pEnd = NULL;
+	tracepoint.uAddress = _strtoui64(strAddress.c_str(), &pEnd, 0);
+	if (*pEnd || (tracepoint.uAddress & 3))
+		return false;
+
+	tracepoint.strName = uColon == std::string::npos || uColon + 1 == strSpec.size() ? strAddress : strSpec.substr(uColon + 1);
+	tracepoint.uHits = 0;
+	tracepoint.bContinue = m_bContinue;
+	return true;
+}
+
+bool BreakCommand::AddSpec(const std::string& strSpec)
+{
+	Tracepoint tracepoint;
+	if (!ParseTracepoint(strSpec, tracepoint))
+		return false;
+
+	m_tracepoints.push_back(tracepoint);
+	return true;
+}
+
+bool BreakCommand::AddTracepoints()
+{
+	// PPU breakpoints are set for the whole process.
+	BreakpointScope scope;
+	scope.uProcessId = m_processId;
+	scope.uUnit = PS3_UI_CPU;
+	scope.uThreadId = 0;
+
+	for (size_t i = 0; i < m_tracepoints.size(); ++i)
+		m_pBreakpoints->Add(scope, m_tracepoints[i].uAddress, CountHit, &m_tracepoints[i]);
+
+	SNRESULT snr = m_pBreakpoints->Apply();
+
+	PrintMessage(ML_INFO, L"%u tracepoints: %u breakpoints set, %u failed, process stopped %u times\n", m_pBreakpoints->GetWantedCount(),
+		m_pBreakpoints->GetSetCount(), m_pBreakpoints->GetFailedCount(), m_pBreakpoints->GetStopCount());
+
+	if (SN_FAILED(snr))
+	{
+		PrintError(snr, L"Failed to set breakpoints");
+		return false;
+	}
+
+	return true;
+}
+
+bool BreakCommand::WaitForHits()
+{
+	PrintMessage(ML_INFO, L"Tracing process 0x%x, press ESC to stop...\n", m_processId);
+
+	PumpEvents();
+
+	PrintMessage(ML_INFO, L"%u hits, %u of them not at a tracepoint\n", m_uHits, m_uOtherHits);
+
+	for (size_t i = 0; i < m_tracepoints.size(); ++i)
+	{
+		if (m_tracepoints[i].uHits)
+			PrintMessage(ML_INFO, L"  %6u  %s\n", m_tracepoints[i].uHits, UTF8ToWChar(m_tracepoints[i].strName).c_str());
+	}
+
+	return true;
+}
+
+void BreakCommand::HandleHit(const BreakpointHit& hit)
+{
+	m_uHits++;
+
+	bool bContinue = false;
+	if (!m_pBreakpoints->Dispatch(hit, bContinue))
+	{
+		m_uOtherHits++;
+		PrintMessage(ML_WARN, L"Thread 0x%I64x stopped at 0x%08I64x, which is not a tracepoint\n", hit.uThreadId, hit.uAddress);
+		return;
+	}
+
+	if (!bContinue)
+		return;
+
+	// The debug agent steps the thread over the breakpoint it is stopped at.
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3ThreadContinue(m_targetId, PS3_UI_CPU, m_processId, hit.uThreadId)))
+		PrintError(snr, L"Failed to continue thread 0x%I64x", hit.uThreadId);
+}
+
+bool BreakCommand::CountHit(void* pUser, const BreakpointHit& /*hit*/)
+{
+	Tracepoint* pTracepoint = static_cast<Tracepoint*>(pUser);
+	pTracepoint->uHits++;
+	return pTracepoint->bContinue;
+}
+
+void BreakCommand::OnDebugEvent(const SNPS3_DBG_EVENT_DATA& data)
+{
+	if (data.uEventType != SNPS3_DBG_EVENT_PPU_EXP_TRAP)
+		return;
+
+	BreakpointHit hit;
+	hit.scope.uProcessId = m_processId;
+	hit.scope.uUnit = PS3_UI_CPU;
+	hit.scope.uThreadId = 0;
+	hit.uAddress = data.ppu_exc_trap.uPC;
+	hit.uThreadId = data.ppu_exc_trap.uPPUThreadID;
+	m_pending.push_back(hit);
+}
+
+void BreakCommand::HandleEvents()
+{
+	for (size_t i = 0; i < m_pending.size(); ++i)
+		HandleHit(m_pending[i]);
+	m_pending.clear();
+}
+
+void BreakCommand::DisplayUsageHelp() const
+{
+	std::cout << "The break command sets tracepoints in a process and counts the times each is hit" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl break <options> -pid <process id> [<tracepoint1> [<tracepoint2> [...]]]" << std::endl << std::endl;
+	std::cout << "  Where each <tracepoint> is <address>[:<name>], the address of a PPU instruction" << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -f <file>" << "\t" << "Read tracepoints from <file>, one a line" << std::endl;
+	std::cout << "  -c" << "\t\t" << "Continue threads that hit a tracepoint" << std::endl;
+	std::cout << "  -to <secs>" << "\t" << "Stop tracing after <secs> seconds" << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
@@ -0,0 +1,52 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BREAK_COMMAND_H
+#define BREAK_COMMAND_H
+
+#include "DebugEventCommand.h"
+#include "SingleArgOption.h"
+#include "Breakpoints.h"
+
+class BreakCommand : public DebugEventCommand
+{
+public:
+					BreakCommand();
+	virtual			~BreakCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	struct Tracepoint
+	{
+		UINT64		uAddress;
+		std::string	strName;
+		UINT32		uHits;
+		bool		bContinue;
+	};
+
+	bool			ParseTracepoint(const std::string& strSpec, Tracepoint& tracepoint) const;
+	virtual bool	AddSpec(const std::string& strSpec);
+	bool			AddTracepoints();
+	bool			WaitForHits();
+	void			HandleHit(const BreakpointHit& hit);
+	virtual void	OnDebugEvent(const SNPS3_DBG_EVENT_DATA& data);
+	virtual void	HandleEvents();
+	virtual void	DisplayUsageHelp() const;
+
+	static bool		CountHit(void* pUser, const BreakpointHit& hit);
+
+	std::vector<Tracepoint>	m_tracepoints;
+
+	BreakpointManager*		m_pBreakpoints;
+	std::vector<BreakpointHit> m_pending;		// Reported by the target, not yet handled
+	UINT32					m_uHits;
+	UINT32					m_uOtherHits;		// Traps that are not tracepoints
+};
+
+TargetCommand* BreakCommandFactory(void);
+
+#endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "CaptureCommand.h"
+#include <sstream>
 
 TargetCommand* CaptureCommandFactory(void)
 {
@@ -13,8 +14,16 @@ TargetCommand* CaptureCommandFactory(void)
 
 CaptureCommand::CaptureCommand()
 : TargetCommand()
+, m_processId(INVALID_PROCESS)
+, m_uCount(1)
+, m_uInterval(0)
+, m_uKeyInterval(VRAM_DEFAULT_KEY_INTERVAL)
+, m_uThreads(0)
+, m_bNoBreakpoint(false)
+, m_bExtract(false)
+, m_uExtractFrame(0)
 {
-
+	memset(&m_vramInfo, 0, sizeof(m_vramInfo));
 }
 
 CaptureCommand::~CaptureCommand()
@@ -28,19 +37,55 @@ bool CaptureCommand::ParseArgs(std::vector<std::string>& arguments)
 		return false;
 
 	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS);
+	SingleArgOption<UINT32> n("n", "count", 1);
+	SingleArgOption<UINT32> iv("iv", "interval", 0);
+	SingleArgOption<UINT32> kf("kf", "key-interval", VRAM_DEFAULT_KEY_INTERVAL);
+	SingleArgOption<UINT32> threads("j", "threads", 0);
+	StandardOption nb("nb", "no-breakpoint");
+	SingleArgOption<UINT32> xf("xf", "extract-frame", 0);
 
 	m_cmdLineHandler.AddArgument(pid);
+	m_cmdLineHandler.AddArgument(n);
+	m_cmdLineHandler.AddArgument(iv);
+	m_cmdLineHandler.AddArgument(kf);
+	m_cmdLineHandler.AddArgument(threads);
+	m_cmdLineHandler.AddArgument(nb);
+	m_cmdLineHandler.AddArgument(xf);
 
 	m_cmdLineHandler.Parse(arguments);
 
 	m_processId = pid.GetValue();
+	m_uCount = n.GetValue();
+	m_uInterval = iv.GetValue();
+	m_uKeyInterval = kf.GetValue();
+	m_uThreads = threads.GetValue();
+	m_bNoBreakpoint = nb.IsSet();
 
 	std::vector<std::string>& remainingArgs = m_cmdLineHandler.GetRemainingArguments();
-	if (remainingArgs.size() == 0)
+
+	if (xf.IsPassed())
+	{
+		m_bExtract = true;
+		m_uExtractFrame = xf.GetValue();
+		m_bConnectToTarget = false;
+
+		if (remainingArgs.size() < 2)
+			throw ArgumentException("Error - you need to specify the capture sequence and the output path for the frame!");
+
+		m_strSequencePath = remainingArgs[0];
+		m_vramOutputPath = remainingArgs[1];
+	}
+	else if (remainingArgs.size() == 0)
 		throw ArgumentException("You need to specify the output path for the image capture file!");
 	else
 		m_vramOutputPath = remainingArgs[0];
 
+	if (m_uCount == 0)
+		throw ArgumentException("Error - -n must be at least 1!");
+
+	if (m_uKeyInterval == 0)
+		throw ArgumentException("Error - -kf must be at least 1!");
+
 	return true;
 }
 
@@ -50,6 +95,14 @@ int CaptureCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
+	if (m_bExtract)
+	{
+		if (!DoExtractFrame())
+			return GetErrorCodeOnError();
+
+		return m_exitCode;
+	}
+
 	if (m_processId == INVALID_PROCESS)
 	{
 		// Since user didn't specfy the target process ID, attempt to get it.
@@ -64,7 +117,10 @@ int CaptureCommand::Run()
 		}
 	}
 
-	if (!DoVramCapture())
+	if (!PrepareVramCapture())
+		return GetErrorCodeOnError();
+
+	if (!(m_uCount > 1 ? DoVramSequence() : DoVramCapture()))
 		return GetErrorCodeOnError();
 
 	return m_exitCode;
@@ -101,6 +157,42 @@ bool CaptureCommand::AutoGetProcessId(UINT32 &processId) const
 	return true;
 }
 
+bool CaptureCommand::PrepareVramCapture()
+{
+	SNRESULT snr;
+	UINT64 uFlags = 0;
+	if (SN_FAILED(snr = SNPS3GetVRAMCaptureFlags(m_targetId, &uFlags)))
+	{
+		PrintError(snr, L"Failed to get VRAM capture flags!\n");
+		return false;
+	}
+
+	if (!(uFlags & SNPS3_ENABLE_VRAM_CAPTURE))
+	{
+		if (SN_FAILED(snr = SNPS3SetVRAMCaptureFlags(m_targetId, uFlags | SNPS3_ENABLE_VRAM_CAPTURE)))
+		{
+			PrintError(snr, L"Failed to enable VRAM capture!\n");
+			return false;
+		}
+		PrintMessage(ML_WARN, L"VRAM capture was disabled and has been enabled, the process may need to be restarted\n");
+	}
+
+	// Looked up once here rather than by every SNPS3VRAMCapture() call.
+	if (SN_FAILED(snr = SNPS3GetVRAMInformation(m_targetId, m_processId, &m_vramInfo, NULL)))
+	{
+		PrintError(snr, L"Failed to get VRAM information!\n");
+		return false;
+	}
+
+	if (m_bNoBreakpoint)
+		m_vramInfo.uBPAddress = 0;
+
+	PrintMessage(ML_INFO, L"VRAM %ux%u, pitch %u, colour mode %u\n", m_vramInfo.uWidth, m_vramInfo.uHeight,
+		m_vramInfo.uPitch, (UINT32)m_vramInfo.colour);
+
+	return true;
+}
+
 bool CaptureCommand::DoVramCapture()
 {
 	_ASSERT(!m_vramOutputPath.empty() && m_processId != 0xffffffff);
@@ -108,7 +200,7 @@ bool CaptureCommand::DoVramCapture()
 		return false;
 
 	SNRESULT snr;
-	if (SN_FAILED(snr = SNPS3VRAMCapture(m_targetId, m_processId, NULL, m_vramOutputPath.c_str())))
+	if (SN_FAILED(snr = SNPS3VRAMCapture(m_targetId, m_processId, &m_vramInfo, m_vramOutputPath.c_str())))
 	{
 		PrintError(snr, L"Failed to do VRAM capture!\n");
 		return false;
@@ -119,13 +211,151 @@ bool CaptureCommand::DoVramCapture()
 	return true;
 }
 
+bool CaptureCommand::DoVramSequence()
+{
+	VramSequenceHeader info;
+	memset(&info, 0, sizeof(info));
+	info.uWidth = m_vramInfo.uWidth;
+	info.uHeight = m_vramInfo.uHeight;
+	info.uPitch = m_vramInfo.uPitch;
+	info.uColour = m_vramInfo.colour;
+	info.uKeyInterval = m_uKeyInterval;
+
+	std::wstring strOutput = UTF8ToWChar(m_vramOutputPath);
+
+	// Each capture lands in a temporary bitmap next to the sequence. While
+	// the target is busy with the next capture, the worker threads load and
+	// delta encode the earlier ones and delete them.
+	VramCapturePipeline pipeline;
+	if (!pipeline.Start(strOutput.c_str(), info, m_uThreads))
+	{
+		PrintMessage(ML_ERROR, L"Failed to start the capture threads\n");
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Capturing %u frames to %s, press ESC to stop...\n", m_uCount, strOutput.c_str());
+
+	bool bOK = true;
+	bool bStopped = false;
+	UINT32 uCaptured = 0;
+	DWORD dwStart = GetTickCount();
+
+	for (UINT32 i = 0; i < m_uCount && bOK && !bStopped; ++i)
+	{
+		// Drain between captures so the window never fills while waiting.
+		DWORD dwDue = i * m_uInterval;
+		while (GetTickCount() - dwStart < dwDue)
+		{
+			if (CheckForEscape())
+			{
+				bStopped = true;
+				break;
+			}
+			if (!pipeline.Drain(false))
+				bOK = false;
+			::Sleep(1);
+		}
+
+		if (bStopped || !bOK)
+			break;
+
+		std::ostringstream strFrame;
+		strFrame << m_vramOutputPath << "." << i << ".bmp";
+
+		DWORD dwTimestamp = GetTickCount() - dwStart;
+
+		SNRESULT snr;
+		if (SN_FAILED(snr = SNPS3VRAMCapture(m_targetId, m_processId, &m_vramInfo, strFrame.str().c_str())))
+		{
+			PrintError(snr, L"Failed to do VRAM capture %u!\n", i);
+			bOK = false;
+			break;
+		}
+
+		if (!pipeline.Submit(UTF8ToWChar(strFrame.str()).c_str(), dwTimestamp))
+		{
+			bOK = false;
+			break;
+		}
+
+		++uCaptured;
+		bStopped = CheckForEscape();
+	}
+
+	if (bStopped)
+		PrintMessage(ML_WARN, L"Capture stopped after %u frames\n", uCaptured);
+
+	DWORD dwCaptureTime = GetTickCount() - dwStart;
+
+	// Frames captured before a failure are still written.
+	if (!pipeline.Finish())
+	{
+		PrintMessage(ML_ERROR, L"Failed to write %s\n", strOutput.c_str());
+		return false;
+	}
+
+	if (pipeline.GetFrameCount() == 0)
+	{
+		PrintMessage(ML_ERROR, L"No frames were captured\n");
+		return false;
+	}
+
+	UINT64 uCapturedBytes = pipeline.GetCapturedBytes();
+	UINT64 uWritten = pipeline.GetBytesWritten();
+
+	PrintMessage(ML_INFO, L"Captured %u frames in %u.%03u s, %u key frames, %u dropped\n", pipeline.GetFrameCount(),
+		dwCaptureTime / 1000, dwCaptureTime % 1000, pipeline.GetKeyFrameCount(), pipeline.GetFailedCount());
+	PrintMessage(ML_INFO, L"Wrote %I64u bytes for %I64u bytes of bitmaps (%.1f%%), %I64u ms spent encoding\n", uWritten,
+		uCapturedBytes, uCapturedBytes ? 100.0 * (double)uWritten / (double)uCapturedBytes : 0.0,
+		pipeline.GetEncodeMicroseconds() / 1000);
+
+	return bOK;
+}
+
+bool CaptureCommand::DoExtractFrame()
+{
+	std::wstring strSequence = UTF8ToWChar(m_strSequencePath);
+	std::wstring strOutput = UTF8ToWChar(m_vramOutputPath);
+
+	VramSequenceReader reader;
+	if (!reader.Open(strSequence.c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a VRAM capture sequence\n", strSequence.c_str());
+		return false;
+	}
+
+	UINT32 uFrameCount = reader.GetHeader().uFrameCount;
+	if (m_uExtractFrame >= uFrameCount)
+	{
+		PrintMessage(ML_ERROR, L"Frame %u is out of range, %s has %u frames\n", m_uExtractFrame, strSequence.c_str(), uFrameCount);
+		return false;
+	}
+
+	if (!reader.WriteBitmap(m_uExtractFrame, strOutput.c_str()))
+	{
+		PrintMessage(ML_ERROR, L"Failed to extract frame %u to %s\n", m_uExtractFrame, strOutput.c_str());
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Extracted frame %u of %u to %s\n", m_uExtractFrame, uFrameCount, strOutput.c_str());
+
+	return true;
+}
+
 void CaptureCommand::DisplayUsageHelp() const
 {
 	std::cout << "The capture command allows you to perform an image capture." << std::endl << std::endl;
 
-	std::cout << "Usage: PS3Ctrl capture <options> <output_path>" << std::endl << std::endl;
+	std::cout << "Usage: PS3Ctrl capture <options> <output_path>" << std::endl;
+	std::cout << "       PS3Ctrl capture -xf <frame> <sequence_path> <output_path>" << std::endl << std::endl;
 	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
 	std::cout << "  -pid <hex>" << "\t" << "Process ID to perform image capture on (optional)" << std::endl;
+	std::cout << "  -n <count>" << "\t" << "Number of captures; more than one writes a delta compressed sequence" << std::endl;
+	std::cout << "  -iv <ms>" << "\t" << "Interval between the start of each capture (default as fast as possible)" << std::endl;
+	std::cout << "  -kf <n>" << "\t" << "Store a key frame every n frames of a sequence (default " << VRAM_DEFAULT_KEY_INTERVAL << ")" << std::endl;
+	std::cout << "  -j <threads>" << "\t" << "Number of encoding threads (default one per core, less one)" << std::endl;
+	std::cout << "  -nb" << "\t\t" << "Capture without stopping the process at the flip breakpoint" << std::endl;
+	std::cout << "  -xf <frame>" << "\t" << "Extract a frame of a sequence to a bitmap, without connecting to a target" << std::endl;
 	std::cout << std::endl;
 	
 	DisplayCommonOptions();
@@ -9,6 +9,7 @@
 
 #include "TargetCommand.h"
 #include "SingleArgOption.h"
+#include "VramSequence.h"
 
 class CaptureCommand : public TargetCommand
 {
@@ -19,12 +20,26 @@ public:
 	virtual int		Run();
 
 protected:
+	bool			PrepareVramCapture();
 	bool			DoVramCapture();
+	bool			DoVramSequence();
+	bool			DoExtractFrame();
 	virtual void	DisplayUsageHelp() const;
 	bool			AutoGetProcessId(UINT32 &processId) const;
 
 	std::string		m_vramOutputPath;
 	UINT32			m_processId;
+
+	UINT32			m_uCount;				// Captures to take, more than one writes a sequence
+	UINT32			m_uInterval;			// Milliseconds between captures
+	UINT32			m_uKeyInterval;
+	UINT32			m_uThreads;
+	bool			m_bNoBreakpoint;
+	SNPS3VRAMInfo	m_vramInfo;
+
+	bool			m_bExtract;
+	UINT32			m_uExtractFrame;
+	std::string		m_strSequencePath;
 };
 
 TargetCommand* CaptureCommandFactory(void);
@@ -5,6 +5,7 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "ConsoleCommand.h"
+#include "TimeoutProfile.h"
 
 TargetCommand* ConsoleCommandFactory(void)
 {
@@ -163,10 +164,7 @@ int ConsoleCommand::Run()
 	}
 
 	if (m_bAbsTimeoutSet)
-	{
-		_time64(&m_absTimeoutTime);
-		m_absTimeoutTime += m_absTimeoutDuration;
-	}
+		m_absTimeoutTime = GetMonotonicMilliseconds() + m_absTimeoutDuration * 1000;
 
 	ClearMessagesBeforeExit();
 	if (ProcessEvents() == false)
@@ -300,10 +298,7 @@ bool ConsoleCommand::ProcessEvents()
 {
 	// Initialize the the timeout time
 	if (m_bRelTimeoutSet) 
-	{
-		_time64(&m_relTimeoutTime);
-		m_relTimeoutTime += m_relTimeoutDuration;
-	}	
+		m_relTimeoutTime = GetMonotonicMilliseconds() + m_relTimeoutDuration * 1000;
 
 	if (IS_VERBOSE)
 	{
@@ -411,12 +406,7 @@ SNRESULT ConsoleCommand::ClearPendingMessages()
 void ConsoleCommand::UpdateTimeout()
 {
 	if (m_bRelTimeoutSet)
-	{
-		__time64_t uNow;
-		_time64(&uNow);
-
-		m_relTimeoutTime = uNow + m_relTimeoutDuration;
-	}
+		m_relTimeoutTime = GetMonotonicMilliseconds() + m_relTimeoutDuration * 1000;
 }
 
 bool ConsoleCommand::ProcessRequestTTY()
@@ -523,8 +513,7 @@ void ConsoleCommand::CheckTimeout()
 
 	if (m_bAbsTimeoutSet || m_bRelTimeoutSet)
 	{
-		__time64_t uNow;
-		_time64(&uNow);
+		UINT64 uNow = GetMonotonicMilliseconds();
 
 		if ((m_bRelTimeoutSet) && uNow > m_relTimeoutTime)
 		{
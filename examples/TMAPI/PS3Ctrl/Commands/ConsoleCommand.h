@@ -59,9 +59,9 @@ protected:
 	bool						m_bCheckForAbort;
 	std::wstring				m_consoleBuffer;
 	bool						m_bRelTimeoutSet;
-	__time64_t					m_relTimeoutTime;
+	UINT64						m_relTimeoutTime;		// Monotonic milliseconds
 	bool						m_bAbsTimeoutSet;
-	__time64_t					m_absTimeoutTime;
+	UINT64						m_absTimeoutTime;
 	UINT64						m_relTimeoutDuration;
 	UINT64						m_absTimeoutDuration;
 	bool						m_bReadStdInFromFile;
@@ -5,6 +5,7 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "CoreDumpCommand.h"
+#include <string.h>
 
 TargetCommand* CoreDumpCommandFactory(void)
 {
@@ -17,6 +18,17 @@ CoreDumpCommand::CoreDumpCommand()
 , m_userData2(0)
 , m_userData3(0)
 , m_processId(INVALID_PROCESS)
+, m_bWait(false)
+, m_bIndex(true)
+, m_uTimeout(0)
+, m_uOriginalFlags(0)
+, m_bRestoreFlags(false)
+, m_bDumpStarted(false)
+, m_bDumpComplete(false)
+, m_uTransferId(0)
+, m_bTransferDone(false)
+, m_bTransferFailed(false)
+, m_uBytesTransferred(0)
 {
 
 }
@@ -31,15 +43,27 @@ bool CoreDumpCommand::ParseArgs(std::vector<std::string>& arguments)
 	if (!TargetCommand::ParseArgs(arguments))
 		return false;
 
-	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS, true);
+	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS, false);
 	MultiArgOption<UINT64> ud("ud", "user-data", false, 3);
+	StandardOption wt("wt", "wait");
+	StandardOption ni("ni", "no-index");
+	SingleArgOption<std::string> dp("dp", "dest-path", "", false);
+	SingleArgOption<UINT32> to("to", "timeout", 0, false);
 
 	m_cmdLineHandler.AddArgument(pid);
 	m_cmdLineHandler.AddArgument(ud);
+	m_cmdLineHandler.AddArgument(wt);
+	m_cmdLineHandler.AddArgument(ni);
+	m_cmdLineHandler.AddArgument(dp);
+	m_cmdLineHandler.AddArgument(to);
 
 	m_cmdLineHandler.Parse(arguments);
 
 	m_processId = pid.GetValue();
+	m_strDestPath = dp.GetValue();
+	m_bWait = wt.IsSet() || !m_strDestPath.empty();
+	m_bIndex = !ni.IsSet();
+	m_uTimeout = to.GetValue();
 
 	if (ud.IsPassed())
 	{
@@ -58,7 +82,48 @@ int CoreDumpCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
-	if (!DoTriggerCoreDump())
+	if (m_processId == INVALID_PROCESS && !m_bWait)
+	{
+		PrintMessage(ML_ERROR, L"No PID was specified using the -pid option\n");
+		return GetErrorCodeOnError();
+	}
+
+	// Register before triggering, the dump can start straight away.
+	if (m_bWait && !RegisterHandlers())
+	{
+		// Puts back the core dump flags, if they were changed before it failed.
+		UnRegisterHandlers();
+		return GetErrorCodeOnError();
+	}
+
+	bool bOk = true;
+
+	if (m_processId != INVALID_PROCESS)
+		bOk = DoTriggerCoreDump();
+
+	if (bOk && m_bWait)
+	{
+		bOk = WaitForDump();
+
+		if (bOk && !m_strDestPath.empty())
+		{
+			bOk = DownloadDump();
+		}
+		else if (bOk && m_bIndex)
+		{
+			// app_home may be served from this PC, in which case the dump
+			// can be indexed where it is.
+			std::wstring strLocal = UTF8ToWChar(m_strDumpFile);
+			WIN32_FILE_ATTRIBUTE_DATA data;
+			if (::GetFileAttributesExW(strLocal.c_str(), GetFileExInfoStandard, &data))
+				bOk = IndexDump(m_strDumpFile, ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow);
+		}
+	}
+
+	if (m_bWait)
+		UnRegisterHandlers();
+
+	if (!bOk)
 		return GetErrorCodeOnError();
 
 	return bRes;
@@ -78,14 +143,309 @@ bool CoreDumpCommand::DoTriggerCoreDump()
 	return true;
 }
 
+bool CoreDumpCommand::RegisterHandlers()
+{
+	// The target only reports dumps it writes to app_home.
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3GetCoreDumpFlags(m_targetId, &m_uOriginalFlags)))
+	{
+		PrintError(snr, L"Failed to get core dump flags");
+		return false;
+	}
+
+	if (!(m_uOriginalFlags & SNPS3TM_CORE_DUMP_TO_APP_HOME))
+	{
+		if (SN_FAILED(snr = SNPS3SetCoreDumpFlags(m_targetId, m_uOriginalFlags | SNPS3TM_CORE_DUMP_TO_APP_HOME)))
+		{
+			PrintError(snr, L"Failed to set core dump flags");
+			return false;
+		}
+		m_bRestoreFlags = true;
+		PrintMessage(ML_INFO, L"Writing core dumps to app_home until the dump has been retrieved\n");
+	}
+
+	if (SN_FAILED(snr = SNPS3RegisterTargetEventHandler(m_targetId, EventCallback, this)))
+	{
+		PrintError(snr, L"Failed to register for target events");
+		return false;
+	}
+
+	if (!m_strDestPath.empty() && SN_FAILED(snr = SNPS3RegisterFTPEventHandler(m_targetId, EventCallback, this)))
+	{
+		PrintError(snr, L"Failed to register for file transfer events");
+		return false;
+	}
+
+	return true;
+}
+
+void CoreDumpCommand::UnRegisterHandlers()
+{
+	SNPS3CancelTargetEvents(m_targetId);
+
+	if (!m_strDestPath.empty())
+		SNPS3CancelFTPEvents(m_targetId);
+
+	if (m_bRestoreFlags)
+	{
+		SNRESULT snr;
+		if (SN_FAILED(snr = SNPS3SetCoreDumpFlags(m_targetId, m_uOriginalFlags)))
+			PrintError(snr, L"Failed to restore core dump flags");
+		m_bRestoreFlags = false;
+	}
+}
+
+void __stdcall CoreDumpCommand::EventCallback(HTARGET /*hTarget*/, UINT uEventType, UINT /*uEventParam*/, SNRESULT snr,
+	UINT uDataLen, BYTE* pData, void* pUser)
+{
+	CoreDumpCommand* pCommand = static_cast<CoreDumpCommand*>(pUser);
+
+	if (SN_FAILED(snr) || !pCommand || !pData)
+		return;
+
+	switch (uEventType)
+	{
+	case SN_EVENT_TARGET:
+		pCommand->ProcessTargetEvent(uDataLen, pData);
+		break;
+	case SN_EVENT_FTP:
+		pCommand->ProcessTransferEvent(uDataLen, pData);
+		break;
+	}
+}
+
+void CoreDumpCommand::ProcessTargetEvent(UINT uDataLen, BYTE* pData)
+{
+	UINT uDataRemaining = uDataLen;
+
+	while (uDataRemaining >= sizeof(SN_EVENT_TARGET_HDR))
+	{
+		SN_EVENT_TARGET_HDR* pHeader = (SN_EVENT_TARGET_HDR*)pData;
+		if (pHeader->uSize < sizeof(SN_EVENT_TARGET_HDR) || pHeader->uSize > uDataRemaining)
+			break;
+
+		if (pHeader->uEvent == SN_TGT_EVENT_TARGET_SPECIFIC &&
+			pHeader->uSize >= sizeof(SN_EVENT_TARGET_HDR) + sizeof(SNPS3_DBG_EVENT_HDR) + sizeof(SNPS3_DBG_EVENT_DATA))
+		{
+			SNPS3_DBG_EVENT_HDR* pDbgHeader = (SNPS3_DBG_EVENT_HDR*)(pData + sizeof(SN_EVENT_TARGET_HDR));
+			SNPS3_DBG_EVENT_DATA* pDbgData = (SNPS3_DBG_EVENT_DATA*)(pData + sizeof(SN_EVENT_TARGET_HDR) + sizeof(SNPS3_DBG_EVENT_HDR));
+
+			// With -pid, only the dump of that process is waited for.
+			if (m_processId == INVALID_PROCESS || pDbgHeader->uProcessID == m_processId)
+			{
+				switch (pDbgData->uEventType)
+				{
+				case SNPS3_DBG_EVENT_CORE_DUMP_START:
+					if (!m_bDumpStarted)
+					{
+						m_bDumpStarted = true;
+						std::string strFile(pDbgData->core_dump_start.filename,
+							strnlen(pDbgData->core_dump_start.filename, sizeof(pDbgData->core_dump_start.filename)));
+						PrintMessage(ML_INFO, L"Core dump started: %s\n", UTF8ToWChar(strFile).c_str());
+					}
+					break;
+				case SNPS3_DBG_EVENT_CORE_DUMP_COMPLETE:
+					if (!m_bDumpComplete)
+					{
+						m_bDumpComplete = true;
+						m_strDumpFile.assign(pDbgData->core_dump_complete.filename,
+							strnlen(pDbgData->core_dump_complete.filename, sizeof(pDbgData->core_dump_complete.filename)));
+						PrintMessage(ML_INFO, L"Core dump complete: %s\n", UTF8ToWChar(m_strDumpFile).c_str());
+					}
+					break;
+				}
+			}
+		}
+
+		uDataRemaining -= pHeader->uSize;
+		pData += pHeader->uSize;
+	}
+}
+
+void CoreDumpCommand::ProcessTransferEvent(UINT uDataLen, BYTE* pData)
+{
+	TMAPI_FT_NOTIFICATION* pNotification = (TMAPI_FT_NOTIFICATION*)pData;
+	UINT uCount = uDataLen / sizeof(TMAPI_FT_NOTIFICATION);
+
+	for (UINT i = 0; i < uCount; ++i, ++pNotification)
+	{
+		if (pNotification->m_TransferID != m_uTransferId)
+			continue;
+
+		switch (pNotification->m_Type)
+		{
+		case TMAPI_FT_PROGRESS:
+			m_uBytesTransferred = pNotification->m_BytesTransferred;
+			break;
+		case TMAPI_FT_FINISH:
+		case TMAPI_FT_SKIPPED:
+			m_bTransferDone = true;
+			break;
+		case TMAPI_FT_ERROR:
+		case TMAPI_FT_CANCELLED:
+			m_bTransferDone = true;
+			m_bTransferFailed = true;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+bool CoreDumpCommand::WaitForDump()
+{
+	PrintMessage(ML_INFO, L"Waiting for the core dump, press ESC to stop...\n");
+
+	DWORD dwStart = GetTickCount();
+
+	while (!m_bDumpComplete)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bDumpComplete)
+			/* Do nothing */;
+
+		if (m_bDumpComplete)
+			break;
+
+		if (CheckForEscape())
+		{
+			PrintMessage(ML_WARN, L"Stopped waiting for the core dump\n");
+			return false;
+		}
+
+		if (m_uTimeout && GetTickCount() - dwStart >= m_uTimeout * 1000)
+		{
+			PrintMessage(ML_ERROR, L"Timed out waiting for the core dump\n");
+			return false;
+		}
+
+		::Sleep(10);
+	}
+
+	return true;
+}
+
+bool CoreDumpCommand::DownloadDump()
+{
+	SNRESULT snr;
+	SNPS3DirEntry entry;
+	if (SN_FAILED(snr = SNPS3StatTargetFile(m_targetId, m_strDumpFile.c_str(), &entry)))
+	{
+		PrintError(snr, L"Failed to stat %s", UTF8ToWChar(m_strDumpFile).c_str());
+		return false;
+	}
+
+	std::string strLocal = m_strDestPath;
+	strLocal += '/';
+	std::string::size_type uSlash = m_strDumpFile.find_last_of("/\\");
+	strLocal += uSlash == std::string::npos ? m_strDumpFile : m_strDumpFile.substr(uSlash + 1);
+
+	// The index is built from the part of the dump already on disk while the
+	// rest downloads; only the headers and notes are read, and they come first.
+	std::wstring strLocalW = UTF8ToWChar(strLocal);
+	if (m_bIndex)
+		m_indexer.Begin(strLocalW.c_str());
+
+	m_uTransferId = TXID_FORCE_FLAG;
+	if (SN_FAILED(snr = SNPS3DownloadFile(m_targetId, m_strDumpFile.c_str(), strLocal.c_str(), &m_uTransferId)))
+	{
+		PrintError(snr, L"Failed to download %s", UTF8ToWChar(m_strDumpFile).c_str());
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Downloading %I64u bytes to %s, press ESC to stop...\n", entry.Size, strLocalW.c_str());
+
+	DWORD dwStart = GetTickCount();
+	UINT64 uIndexedAt = 0;
+
+	while (!m_bTransferDone)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bTransferDone)
+			/* Do nothing */;
+
+		if (m_bIndex && !m_indexer.IsComplete() && !m_indexer.IsCorrupt())
+		{
+			m_indexer.Update(m_uBytesTransferred);
+			if (m_indexer.IsComplete())
+				uIndexedAt = m_uBytesTransferred;
+		}
+
+		if (m_bTransferDone)
+			break;
+
+		if (CheckForEscape())
+		{
+			SNPS3CancelFileTransfer(m_targetId, m_uTransferId);
+			PrintMessage(ML_WARN, L"Download cancelled\n");
+			return false;
+		}
+
+		if (m_uTimeout && GetTickCount() - dwStart >= m_uTimeout * 1000)
+		{
+			SNPS3CancelFileTransfer(m_targetId, m_uTransferId);
+			PrintMessage(ML_ERROR, L"Timed out downloading %s\n", UTF8ToWChar(m_strDumpFile).c_str());
+			return false;
+		}
+
+		::Sleep(10);
+	}
+
+	if (m_bTransferFailed)
+	{
+		PrintMessage(ML_ERROR, L"Failed to download %s\n", UTF8ToWChar(m_strDumpFile).c_str());
+		return false;
+	}
+
+	DWORD dwElapsed = GetTickCount() - dwStart;
+	PrintMessage(ML_INFO, L"Downloaded %s in %u.%03u s (%.1f MB/s)\n", strLocalW.c_str(), dwElapsed / 1000, dwElapsed % 1000,
+		dwElapsed ? (double)entry.Size / (1024.0 * 1024.0) / (dwElapsed / 1000.0) : 0.0);
+
+	if (!m_bIndex)
+		return true;
+
+	if (uIndexedAt)
+		PrintMessage(ML_INFO, L"Index complete after %I64u of %I64u bytes\n", uIndexedAt, entry.Size);
+
+	return IndexDump(strLocal, entry.Size);
+}
+
+bool CoreDumpCommand::IndexDump(const std::string& strLocalPath, UINT64 uDumpSize)
+{
+	std::wstring strDump = UTF8ToWChar(strLocalPath);
+	std::wstring strIndex = CoreDumpIndex::GetIndexPath(strDump.c_str());
+
+	// Picks up where the download left off, or starts from scratch for a
+	// dump that was already on this PC.
+	if (m_strDestPath.empty())
+		m_indexer.Begin(strDump.c_str());
+
+	if (!m_indexer.Finish(uDumpSize, strIndex.c_str()))
+	{
+		if (m_indexer.IsCorrupt())
+			PrintMessage(ML_ERROR, L"%s is not a valid core dump\n", strDump.c_str());
+		else
+			PrintMessage(ML_ERROR, L"Failed to write %s\n", strIndex.c_str());
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Indexed %u memory segments, %u threads, %u register sets, %u modules and %u other records in %s\n",
+		(UINT32)m_indexer.GetSegmentCount(), m_indexer.GetKindCount(CDK_THREAD), m_indexer.GetKindCount(CDK_REGISTERS),
+		m_indexer.GetKindCount(CDK_MODULE), m_indexer.GetKindCount(CDK_OTHER) + m_indexer.GetKindCount(CDK_PROCESS), strIndex.c_str());
+
+	return true;
+}
+
 void CoreDumpCommand::DisplayUsageHelp() const
 {
 	std::cout << "The coredump command allows you to perform a coredump on a process." << std::endl << std::endl;
 
 	std::cout << "Usage: PS3Ctrl coredump <options>" << std::endl << std::endl;
 	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
-	std::cout << "  -pid <hex>" << "\t" << "Process ID to do the dump on" << std::endl;
+	std::cout << "  -pid <hex>" << "\t" << "Process ID to do the dump on. Without it, -wt waits for a dump from any process" << std::endl;
 	std::cout << "  -ud x y z" << "\t" << "User data 1,2 and 3 in hex for core dump" << std::endl;
+	std::cout << "  -wt" << "\t\t" << "Wait for the dump to be written to app_home" << std::endl;
+	std::cout << "  -dp <path>" << "\t" << "Download the dump to this directory once written (implies -wt)" << std::endl;
+	std::cout << "  -ni" << "\t\t" << "Do not build the <dump>.cdix index alongside the dump" << std::endl;
+	std::cout << "  -to <secs>" << "\t" << "Give up waiting for the dump, and then downloading it, after this many seconds each" << std::endl;
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
@@ -9,6 +9,7 @@
 
 #include "TargetCommand.h"
 #include "SingleArgOption.h"
+#include "CoreDumpIndex.h"
 
 class CoreDumpCommand : public TargetCommand
 {
@@ -20,14 +21,40 @@ public:
 
 protected:
 	bool			DoTriggerCoreDump();
+	bool			RegisterHandlers();
+	void			UnRegisterHandlers();
+	bool			WaitForDump();
+	bool			DownloadDump();
+	bool			IndexDump(const std::string& strLocalPath, UINT64 uDumpSize);
+	void			ProcessTargetEvent(UINT uDataLen, BYTE* pData);
+	void			ProcessTransferEvent(UINT uDataLen, BYTE* pData);
 	virtual void	DisplayUsageHelp() const;
 
+	static void __stdcall EventCallback(HTARGET hTarget, UINT uEventType, UINT uEventParam, SNRESULT snr,
+		UINT uDataLen, BYTE* pData, void* pUser);
+
 	UINT64			m_userData1;
 	UINT64			m_userData2;
 	UINT64			m_userData3;
 	UINT32			m_processId;
+
+	bool			m_bWait;
+	bool			m_bIndex;
+	UINT32			m_uTimeout;				// Seconds to wait for the dump, and to download it; 0 for no limit
+	std::string		m_strDestPath;
+	UINT64			m_uOriginalFlags;
+	bool			m_bRestoreFlags;
+
+	std::string		m_strDumpFile;			// As reported by the target
+	bool			m_bDumpStarted;
+	bool			m_bDumpComplete;
+	UINT32			m_uTransferId;
+	bool			m_bTransferDone;
+	bool			m_bTransferFailed;
+	UINT64			m_uBytesTransferred;
+	CoreDumpIndexer	m_indexer;
 };
 
 TargetCommand* CoreDumpCommandFactory(void);
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
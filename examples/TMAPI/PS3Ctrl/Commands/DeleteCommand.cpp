@@ -5,8 +5,10 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "DeleteCommand.h"
+#include "RemoteDelete.h"
+#include "DeployPreflight.h"
 
-DeleteCommand::DeleteCommand(void) : m_timeoutValue(-1)
+DeleteCommand::DeleteCommand(void) : m_timeoutValue(-1), m_uMaxInFlight(1)
 {
 }
 
@@ -25,10 +27,16 @@ bool DeleteCommand::ParseArgs(std::vector<std::string>& arguments)
 		return false;
 
 	SingleArgOption<int> to("to", "timeout", -1);
+	SingleArgOption<UINT32> j("j", "jobs", 1);
 	m_cmdLineHandler.AddArgument(to);
+	m_cmdLineHandler.AddArgument(j);
 	m_cmdLineHandler.Parse(arguments);
 	m_timeoutValue = to.GetValue();
 
+	if (j.GetValue() == 0)
+		throw ArgumentException("Error - The number of deletes in flight must be at least 1");
+	m_uMaxInFlight = j.GetValue();
+
 	std::vector<std::string>& remainingArgs = m_cmdLineHandler.GetRemainingArguments();
 		
 	if (remainingArgs.size() == 0)
@@ -59,6 +67,9 @@ int DeleteCommand::Run()
 
 bool DeleteCommand::DoDeleteFile()
 {
+	if (m_uMaxInFlight > 1)
+		return DoDeleteInParallel();
+
 	SNRESULT snr;
 	std::vector<std::string>::const_reverse_iterator it = m_filesToDelete.rbegin();
 	for (; it != m_filesToDelete.rend(); ++it)
@@ -83,3 +94,87 @@ bool DeleteCommand::DoDeleteFile()
 
 	return true;
 }
+
+bool DeleteCommand::DoDeleteInParallel()
+{
+	RemoteTreeCache cache(m_targetId);
+	RemoteDeleter deleter(cache, m_timeoutValue);
+
+	std::vector<std::string>::const_reverse_iterator it = m_filesToDelete.rbegin();
+	for (; it != m_filesToDelete.rend(); ++it)
+		deleter.Add(*it);
+
+	// What was reclaimed is measured on the file system of the first path.
+	const std::string& strFirst = m_filesToDelete.back();
+	UINT32 uBlockSize = 0;
+	UINT64 uFreeBefore = 0;
+	UINT64 uFreeAfter = 0;
+	bool bFreeSpace = SN_SUCCEEDED(GetFileSystemFreeSpace(m_targetId, strFirst, uBlockSize, uFreeBefore));
+
+	deleter.Split(m_uMaxInFlight);
+
+	if (!deleter.Start(m_uMaxInFlight))
+	{
+		PrintMessage(ML_ERROR, L"Failed to create worker threads\n");
+		return false;
+	}
+
+	while (!deleter.Wait(100))
+	{
+		if (!deleter.IsCancelled() && CheckForEscape())
+		{
+			deleter.Cancel();
+			PrintMessage(ML_WARN, L"Cancelled, waiting for the %u deletes in flight to finish\n", deleter.GetInFlight());
+		}
+	}
+
+	bool bOK = !deleter.IsCancelled();
+	for (size_t i = 0; i < deleter.GetCount(); ++i)
+	{
+		const RemoteDeleteItem& item = deleter.GetItem(i);
+		if (SN_SUCCEEDED(item.snr))
+			continue;
+
+		if (item.snr == SN_E_FILE_ERROR)
+		{
+			// A tree split from a path may simply be gone; deleting the path
+			// reports anything left.
+			if (item.bRequested)
+				PrintError(item.snr, UTF8ToWChar(std::string("Error - Cannot find " + item.strPath + " on target.")).c_str());
+		}
+		else if (item.snr == SN_E_COMMS_ERR)
+		{
+			PrintError(item.snr, UTF8ToWChar(std::string("Error - Problem communicating with target.")).c_str());
+			bOK = false;
+		}
+		else
+		{
+			PrintError(item.snr, UTF8ToWChar(std::string("Error - Failed to delete " + item.strPath + " on target.")).c_str());
+			bOK = false;
+		}
+	}
+
+	PrintMessage(ML_INFO, L"%u deletes, at most %u at a time, took %.2fs\n", (UINT32)deleter.GetCount(), m_uMaxInFlight,
+		deleter.GetElapsedMilliseconds() / 1000.0);
+
+	if (bFreeSpace && SN_SUCCEEDED(GetFileSystemFreeSpace(m_targetId, strFirst, uBlockSize, uFreeAfter)))
+	{
+		PrintMessage(ML_INFO, L"Reclaimed %.1f MB on %s\n", (uFreeAfter > uFreeBefore ? uFreeAfter - uFreeBefore : 0) / (1024.0 * 1024.0),
+			UTF8ToWChar(GetFileSystemRoot(strFirst)).c_str());
+	}
+
+	return bOK;
+}
+
+void DeleteCommand::DisplayUsageHelp() const
+{
+	std::cout << "The delete command deletes files and directories from a target" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl delete <options> <path1> [<path2> [...]]" << std::endl << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -to <ms>" << "\t" << "Timeout of each delete in milliseconds" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "Number of deletes in flight at once; directories are split to keep them busy (default 1, one path at a time in order)" << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
@@ -8,6 +8,7 @@
 #define DELETE_COMMAND_H
 
 #include "TargetCommand.h"
+#include "SingleArgOption.h"
 
 class DeleteCommand : public TargetCommand
 {
@@ -19,9 +20,12 @@ public:
 
 protected:
 	bool			DoDeleteFile();
+	bool			DoDeleteInParallel();
+	virtual void	DisplayUsageHelp() const;
 
 	std::vector<std::string> m_filesToDelete;
 	int m_timeoutValue;
+	UINT32 m_uMaxInFlight;
 
 };
 
@@ -0,0 +1,219 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "DirCommand.h"
+#include <time.h>
+#include <algorithm>
+
+namespace
+{
+	bool ComparePath(const RemoteListing::value_type& left, const RemoteListing::value_type& right)
+	{
+		return left.first < right.first;
+	}
+}
+
+TargetCommand* DirCommandFactory(void)
+{
+	return new DirCommand();
+}
+
+DirCommand::DirCommand()
+: TargetCommand()
+, m_bRecursive(false)
+, m_bSummary(false)
+, m_uMaxInFlight(REMOTE_TREE_DEFAULT_MAX)
+, m_uFiles(0)
+, m_uDirectories(0)
+, m_uBytes(0)
+{
+
+}
+
+DirCommand::~DirCommand()
+{
+
+}
+
+bool DirCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	StandardOption r("r", "recursive");
+	StandardOption s("s", "summary");
+	SingleArgOption<UINT32> j("j", "jobs", REMOTE_TREE_DEFAULT_MAX);
+
+	m_cmdLineHandler.AddArgument(r);
+	m_cmdLineHandler.AddArgument(s);
+	m_cmdLineHandler.AddArgument(j);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	m_bSummary = s.IsSet();
+	m_bRecursive = r.IsSet() || m_bSummary;
+
+	if (j.IsPassed() && j.GetValue() == 0)
+		throw ArgumentException("Error - The number of directories listed at once must be at least 1");
+	m_uMaxInFlight = j.GetValue();
+
+	std::vector<std::string>& remainingArgs = m_cmdLineHandler.GetRemainingArguments();
+	if (remainingArgs.empty())
+		throw ArgumentException("Error - You must specify at least one target path to list");
+
+	m_paths.assign(remainingArgs.begin(), remainingArgs.end());
+
+	return true;
+}
+
+int DirCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	LARGE_INTEGER freq, start, end;
+	::QueryPerformanceFrequency(&freq);
+	::QueryPerformanceCounter(&start);
+
+	// Shared by the paths, so a path under one already listed costs nothing.
+	RemoteTreeCache cache(m_targetId);
+
+	bool bOK = true;
+	for (size_t i = 0; i < m_paths.size(); ++i)
+	{
+		if (!DoDir(cache, m_paths[i]))
+			bOK = false;
+	}
+
+	::QueryPerformanceCounter(&end);
+	PrintMessage(ML_INFO, L"Took %.2fs, %I64u target calls, %I64u answered from the cache\n",
+		(end.QuadPart - start.QuadPart) / (double)freq.QuadPart, cache.GetTargetCalls(), cache.GetHits());
+
+	if (!bOK)
+		return GetErrorCodeOnError();
+
+	return m_exitCode;
+}
+
+bool DirCommand::DoDir(RemoteTreeCache& cache, const std::string& strPath)
+{
+	RemoteFileInfo info;
+	SNRESULT snr;
+	if (SN_FAILED( snr = cache.Stat(strPath, info) ))
+	{
+		PrintError(snr, L"Cannot find %s on target", UTF8ToWChar(strPath).c_str());
+		return false;
+	}
+
+	m_found.clear();
+	m_uFiles = 0;
+	m_uDirectories = 0;
+	m_uBytes = 0;
+
+	if (info.uType != SNPS3_DIRENT_TYPE_DIRECTORY)
+	{
+		EntryFound(this, RemoteTreeCache::Normalize(strPath), info);
+	}
+	else
+	{
+		RemoteTreeWalker walker(cache);
+		if (!walker.Start(strPath, m_bRecursive, m_uMaxInFlight, EntryFound, this))
+		{
+			PrintMessage(ML_ERROR, L"Failed to create worker threads\n");
+			return false;
+		}
+
+		while (!walker.Wait(100))
+		{
+			if (!walker.IsCancelled() && CheckForEscape())
+			{
+				walker.Cancel();
+				PrintMessage(ML_WARN, L"Cancelled, waiting for the directories being listed\n");
+			}
+		}
+
+		if (walker.GetFailedCount())
+		{
+			PrintError(walker.GetResult(), L"Could not list %u of %u directories under %s",
+				walker.GetFailedCount(), walker.GetDirectoryCount(), UTF8ToWChar(strPath).c_str());
+		}
+
+		if (walker.IsCancelled())
+			return false;
+	}
+
+	if (m_bSummary)
+	{
+		WCHAR szLine[SNPS3_MAX_TARGET_PATH + 128];
+		swprintf(szLine, _countof(szLine), L"%16I64u bytes %10I64u files %8I64u directories  %s",
+			m_uBytes, m_uFiles, m_uDirectories, UTF8ToWChar(strPath).c_str());
+		std::wcout << szLine << std::endl;
+	}
+	else
+	{
+		// Found in whatever order the directories were listed.
+		std::sort(m_found.begin(), m_found.end(), ComparePath);
+		for (size_t i = 0; i < m_found.size(); ++i)
+			PrintEntry(m_found[i].first, m_found[i].second);
+	}
+
+	return true;
+}
+
+bool DirCommand::EntryFound(void* pUser, const std::string& strPath, const RemoteFileInfo& info)
+{
+	DirCommand* pThis = static_cast<DirCommand*>(pUser);
+
+	if (info.uType == SNPS3_DIRENT_TYPE_DIRECTORY)
+	{
+		pThis->m_uDirectories++;
+	}
+	else
+	{
+		pThis->m_uFiles++;
+		pThis->m_uBytes += info.uSize;
+	}
+
+	if (!pThis->m_bSummary)
+		pThis->m_found.push_back(std::make_pair(strPath, info));
+
+	return true;
+}
+
+void DirCommand::PrintEntry(const std::string& strPath, const RemoteFileInfo& info) const
+{
+	WCHAR cType = L'-';
+	if (info.uType == SNPS3_DIRENT_TYPE_DIRECTORY)
+		cType = L'd';
+	else if (info.uType == SNPS3_DIRENT_TYPE_SYMLINK)
+		cType = L'l';
+
+	WCHAR szTime[32] = L"";
+	struct tm modified;
+	__time64_t time = (__time64_t)info.uModifiedTime;
+	if (_gmtime64_s(&modified, &time) == 0)
+		wcsftime(szTime, _countof(szTime), L"%Y-%m-%d %H:%M", &modified);
+
+	WCHAR szLine[SNPS3_MAX_TARGET_PATH + 128];
+	swprintf(szLine, _countof(szLine), L"%c %04o %14I64u %16s  %s", cType, info.uMode & 07777, info.uSize, szTime,
+		UTF8ToWChar(strPath).c_str());
+	std::wcout << szLine << std::endl;
+}
+
+void DirCommand::DisplayUsageHelp() const
+{
+	std::cout << "The dir command lists files and directories on a target" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl dir <options> <path1> [<path2> [...]]" << std::endl << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -r" << "\t\t" << "List the directories under each path too" << std::endl;
+	std::cout << "  -s" << "\t\t" << "Only show the total size and number of files under each path (implies -r)" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "Number of directories listed at once (default " << REMOTE_TREE_DEFAULT_MAX << ")" << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
@@ -0,0 +1,43 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef DIR_COMMAND_H
+#define DIR_COMMAND_H
+
+#include "TargetCommand.h"
+#include "SingleArgOption.h"
+#include "RemoteTree.h"
+
+class DirCommand : public TargetCommand
+{
+public:
+					DirCommand();
+	virtual			~DirCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	bool			DoDir(RemoteTreeCache& cache, const std::string& strPath);
+	void			PrintEntry(const std::string& strPath, const RemoteFileInfo& info) const;
+	virtual void	DisplayUsageHelp() const;
+
+	static bool		EntryFound(void* pUser, const std::string& strPath, const RemoteFileInfo& info);
+
+	std::vector<std::string>	m_paths;
+	bool						m_bRecursive;
+	bool						m_bSummary;
+	UINT32						m_uMaxInFlight;
+
+	// Of the path being walked
+	RemoteListing				m_found;
+	UINT64						m_uFiles;
+	UINT64						m_uDirectories;
+	UINT64						m_uBytes;
+};
+
+TargetCommand* DirCommandFactory(void);
+
+#endif
\ No newline at end of file
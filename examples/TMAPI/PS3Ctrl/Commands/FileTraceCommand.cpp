@@ -0,0 +1,868 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "FileTraceCommand.h"
+#include <map>
+
+namespace
+{
+	// Builds synthetic records to the SNPS3_FILE_TRACE_LOG layout, for
+	// exercising the analyzer and indexer without a target.
+	class SyntheticTraceBuilder
+	{
+	public:
+		SyntheticTraceBuilder(UINT32 uSeed, UINT64 uTraceStart) : m_uRandom(uSeed), m_uTraceStart(uTraceStart) {}
+
+		UINT32 Random(UINT32 uRange)
+		{
+			m_uRandom = m_uRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (UINT32)((m_uRandom >> 33) % uRange);
+		}
+
+		void Header(std::vector<BYTE>& record, UINT64 uSerial, UINT32 uApi, UINT32 uStatus, UINT32 uThread,
+			UINT64 uTimeBase, const std::vector<UINT32>& backTrace)
+		{
+			SNPS3_FILE_TRACE_LOG log;
+			memset(&log, 0, sizeof(log));
+			log.ulSerialID = uSerial;
+			log.ulAPIType = uApi;
+			log.ulStatus = uStatus;
+			log.ulProcessID = 0x01010200;
+			log.ulThreadID = uThread;
+			log.ulTimeBaseStartOfTrace = m_uTraceStart;
+			log.ulTimeBase = uTimeBase;
+			log.ulBackTraceLength = (UINT32)(backTrace.size() * sizeof(UINT32));
+
+			record.clear();
+			Append(record, &log, sizeof(log));
+			if (!backTrace.empty())
+				Append(record, &backTrace[0], backTrace.size() * sizeof(UINT32));
+		}
+
+		void Append(std::vector<BYTE>& record, const void* pData, size_t uLength)
+		{
+			const BYTE* pBytes = static_cast<const BYTE*>(pData);
+			record.insert(record.end(), pBytes, pBytes + uLength);
+		}
+
+		void AppendPath(std::vector<BYTE>& record, const std::string& strPath)
+		{
+			Append(record, strPath.c_str(), strPath.size() + 1);
+		}
+
+	private:
+		UINT64	m_uRandom;
+		UINT64	m_uTraceStart;
+	};
+
+	struct SyntheticThread
+	{
+		UINT64		uFd;			// 0 when no file is open
+		UINT32		uReadsLeft;
+		UINT32		uFile;
+	};
+}
+
+TargetCommand* FileTraceCommandFactory(void)
+{
+	return new FileTraceCommand();
+}
+
+FileTraceCommand::FileTraceCommand()
+: TargetCommand()
+, m_Command(FTCMD_NONE)
+, m_processId(INVALID_PROCESS)
+, m_uDuration(0)
+, m_uTop(FILETRACE_DEFAULT_TOP)
+, m_uThreads(0)
+, m_uGenCount(FILETRACE_DEFAULT_GEN_COUNT)
+, m_uLimit(FILETRACE_DEFAULT_LIMIT)
+, m_bSaving(false)
+, m_bWriteFailed(false)
+, m_bOfflineEnd(false)
+{
+
+}
+
+FileTraceCommand::~FileTraceCommand()
+{
+
+}
+
+bool FileTraceCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS);
+	SingleArgOption<UINT32> y("y", "timeout", 0);
+	SingleArgOption<std::string> tf("tf", "target-file", FILETRACE_DEFAULT_TARGET_FILE);
+	SingleArgOption<std::string> offline("offline", "offline", "");
+	SingleArgOption<std::string> read("read", "read", "");
+	SingleArgOption<std::string> save("save", "save", "");
+	SingleArgOption<UINT32> top("top", "top", FILETRACE_DEFAULT_TOP);
+	SingleArgOption<std::string> index("index", "index", "");
+	SingleArgOption<std::string> out("o", "output", "");
+	SingleArgOption<UINT32> threads("j", "threads", 0);
+	SingleArgOption<std::string> query("query", "query", "");
+	SingleArgOption<std::string> api("api", "api", "");
+	SingleArgOption<double> minMs("min", "min-duration", 0.0);
+	SingleArgOption<UINT64> minSize("size", "min-size", 0);
+	SingleArgOption<std::string> path("path", "path", "");
+	SingleArgOption<UINT32> limit("limit", "limit", FILETRACE_DEFAULT_LIMIT);
+	SingleArgOption<std::string> gen("gen", "generate", "");
+	SingleArgOption<UINT64> count("count", "count", FILETRACE_DEFAULT_GEN_COUNT);
+
+	out.SetParentDependency(&index);
+	threads.SetParentDependency(&index);
+	api.SetParentDependency(&query);
+	minMs.SetParentDependency(&query);
+	minSize.SetParentDependency(&query);
+	path.SetParentDependency(&query);
+	limit.SetParentDependency(&query);
+	count.SetParentDependency(&gen);
+
+	m_cmdLineHandler.AddArgument(pid);
+	m_cmdLineHandler.AddArgument(y);
+	m_cmdLineHandler.AddArgument(tf);
+	m_cmdLineHandler.AddArgument(offline);
+	m_cmdLineHandler.AddArgument(read);
+	m_cmdLineHandler.AddArgument(save);
+	m_cmdLineHandler.AddArgument(top);
+	m_cmdLineHandler.AddArgument(index);
+	m_cmdLineHandler.AddArgument(out);
+	m_cmdLineHandler.AddArgument(threads);
+	m_cmdLineHandler.AddArgument(query);
+	m_cmdLineHandler.AddArgument(api);
+	m_cmdLineHandler.AddArgument(minMs);
+	m_cmdLineHandler.AddArgument(minSize);
+	m_cmdLineHandler.AddArgument(path);
+	m_cmdLineHandler.AddArgument(limit);
+	m_cmdLineHandler.AddArgument(gen);
+	m_cmdLineHandler.AddArgument(count);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	if ((offline.IsPassed() ? 1 : 0) + (read.IsPassed() ? 1 : 0) + (index.IsPassed() ? 1 : 0) +
+		(query.IsPassed() ? 1 : 0) + (gen.IsPassed() ? 1 : 0) > 1)
+		throw ArgumentException("Error - only one of -offline, -read, -index, -query or -gen can be used!");
+
+	if (gen.IsPassed())
+	{
+		m_Command = FileTraceCommand::FTCMD_GENERATE;
+		m_strFile = gen.GetValue();
+		m_uGenCount = count.GetValue();
+		m_bConnectToTarget = false;
+	}
+	else if (index.IsPassed())
+	{
+		m_Command = FileTraceCommand::FTCMD_INDEX;
+		m_strFile = index.GetValue();
+		m_strOutFile = out.IsPassed() ? out.GetValue() : m_strFile + ".idx";
+		m_uThreads = threads.GetValue();
+		m_bConnectToTarget = false;
+
+		if (m_strOutFile.empty())
+			throw ArgumentException("Error - you need to specify an index file!");
+	}
+	else if (query.IsPassed())
+	{
+		m_Command = FileTraceCommand::FTCMD_QUERY;
+		m_strFile = query.GetValue();
+		m_uLimit = limit.GetValue();
+		m_bConnectToTarget = false;
+
+		if (api.IsPassed())
+		{
+			static const char* s_classNames[] = { "other", "open", "close", "read", "write", "seek" };
+
+			m_query.bAnyApi = true;
+			for (UINT32 i = 0; i < _countof(s_classNames); ++i)
+			{
+				if (api.GetValue() == s_classNames[i])
+				{
+					m_query.uApiClass = (FileTraceApiClass)i;
+					m_query.bAnyApi = false;
+				}
+			}
+
+			if (m_query.bAnyApi)
+				throw ArgumentException("Error - -api must be one of open, close, read, write, seek or other!");
+		}
+
+		if (minMs.GetValue() < 0.0)
+			throw ArgumentException("Error - -min must not be negative!");
+
+		m_query.uMinDuration = (UINT32)(minMs.GetValue() * 1000.0 + 0.5);
+		m_query.uMinSize = minSize.GetValue();
+		m_query.strPath = path.GetValue();
+	}
+	else if (read.IsPassed())
+	{
+		m_Command = FileTraceCommand::FTCMD_READ;
+		m_strFile = read.GetValue();
+		m_bConnectToTarget = false;
+	}
+	else if (offline.IsPassed())
+	{
+		m_Command = FileTraceCommand::FTCMD_OFFLINE;
+		m_strFile = offline.GetValue();
+	}
+	else
+	{
+		m_Command = FileTraceCommand::FTCMD_LIVE;
+		m_processId = pid.GetValue();
+		m_uDuration = y.GetValue();
+		m_strTargetFile = tf.GetValue();
+
+		if (m_strTargetFile.empty())
+			throw ArgumentException("Error - you need to specify a target trace file!");
+	}
+
+	if (m_Command != FTCMD_LIVE && m_strFile.empty())
+		throw ArgumentException("Error - you need to specify a trace file!");
+
+	if (save.IsPassed())
+	{
+		if (m_Command != FTCMD_LIVE && m_Command != FTCMD_OFFLINE)
+			throw ArgumentException("Error - -save can only be used when tracing or with -offline!");
+
+		m_strSaveFile = save.GetValue();
+		m_bSaving = true;
+		if (m_strSaveFile.empty())
+			throw ArgumentException("Error - you need to specify a file to save the trace to!");
+	}
+
+	m_uTop = top.GetValue();
+
+	m_cmdLineHandler.Reset();
+
+	return true;
+}
+
+int FileTraceCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	bool bOK = false;
+	switch (m_Command)
+	{
+	case FTCMD_LIVE:
+		bOK = DoLive();
+		break;
+	case FTCMD_OFFLINE:
+		bOK = DoOffline();
+		break;
+	case FTCMD_READ:
+		bOK = DoRead();
+		break;
+	case FTCMD_INDEX:
+		bOK = DoIndex();
+		break;
+	case FTCMD_QUERY:
+		bOK = DoQuery();
+		break;
+	case FTCMD_GENERATE:
+		bOK = DoGenerate();
+		break;
+	default:
+		break;
+	}
+
+	if (!bOK)
+		return GetErrorCodeOnError();
+
+	if (m_Command == FTCMD_LIVE || m_Command == FTCMD_OFFLINE || m_Command == FTCMD_READ)
+		DisplayReport();
+
+	return m_exitCode;
+}
+
+bool FileTraceCommand::AutoGetProcessId(UINT32 &processId) const
+{
+	processId = INVALID_PROCESS;
+	UINT32 nProcessCount = 0;
+	UINT32* pProcessListBuff = NULL;
+	SNRESULT snr;
+
+	if (SN_FAILED(snr = SNPS3UserProcessList(m_targetId, &nProcessCount, NULL)))
+	{
+		PrintError(snr, L"Failed to get user process list!\n");
+		return false;
+	}
+
+	if (nProcessCount > 0)
+	{
+		pProcessListBuff = new UINT32[nProcessCount];
+		if (SN_FAILED(snr = SNPS3UserProcessList(m_targetId, &nProcessCount, pProcessListBuff)))
+		{
+			PrintError(snr, L"Failed to get user process list!\n");
+			delete [] pProcessListBuff;
+			return false;
+		}
+
+		processId = pProcessListBuff[nProcessCount - 1];
+		delete [] pProcessListBuff;
+	}
+
+	return true;
+}
+
+UINT64 FileTraceCommand::GetTargetTimebase()
+{
+	UINT32 uMask = SYS_INFO_TIMEBASE_FREQ;
+	SNPS3SystemInfo sysInfo;
+	memset(&sysInfo, 0, sizeof(sysInfo));
+
+	SNRESULT snr = SNPS3GetSystemInfo(m_targetId, 0, &uMask, &sysInfo);
+	if (SN_FAILED(snr) || !(uMask & SYS_INFO_TIMEBASE_FREQ) || sysInfo.uTimebaseFrequency == 0)
+	{
+		PrintMessage(ML_WARN, L"Could not read the target timebase frequency, assuming %u Hz\n", FILE_TRACE_DEFAULT_TIMEBASE);
+		return FILE_TRACE_DEFAULT_TIMEBASE;
+	}
+
+	return sysInfo.uTimebaseFrequency;
+}
+
+void __stdcall FileTraceCommand::FileTraceCallback(HTARGET /*hTarget*/, UINT32 uType, UINT32 /*uParam*/,
+	SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser)
+{
+	FileTraceCommand* pCommand = static_cast<FileTraceCommand*>(pUser);
+
+	if (uType != SN_EVENT_FILE_TRACE || SN_FAILED(snr) || !pCommand || !pData)
+		return;
+
+	// uLength covers the SNPS3_FILE_TRACE_LOG header and everything after it.
+	pCommand->m_analyzer.AddRecord(pData, uLength);
+
+	if (pCommand->m_bSaving && !pCommand->m_bWriteFailed && !pCommand->m_writer.Write(pData, uLength))
+	{
+		pCommand->m_bWriteFailed = true;
+		pCommand->SetAbortKick();
+	}
+
+	if (uLength >= sizeof(SNPS3_FILE_TRACE_LOG) &&
+		reinterpret_cast<const SNPS3_FILE_TRACE_LOG*>(pData)->ulAPIType == SNPS3_FT_OFFLINE_END)
+	{
+		pCommand->m_bOfflineEnd = true;
+		pCommand->SetAbortKick();
+	}
+}
+
+bool FileTraceCommand::RegisterHandler()
+{
+	UINT64 uTimebase = GetTargetTimebase();
+	m_analyzer.SetTimebaseFrequency(uTimebase);
+
+	if (m_bSaving && !m_writer.Open(UTF8ToWChar(m_strSaveFile).c_str(), uTimebase))
+	{
+		PrintMessage(ML_ERROR, L"Failed to create %s\n", UTF8ToWChar(m_strSaveFile).c_str());
+		return false;
+	}
+
+	SNRESULT snr;
+	if (SN_FAILED( snr = SNPS3RegisterFileTraceHandler(m_targetId, FileTraceCallback, this) ))
+	{
+		PrintError(snr, L"Failed to register file trace handler");
+		return false;
+	}
+
+	return true;
+}
+
+void FileTraceCommand::UnRegisterHandler()
+{
+	SNPS3UnRegisterFileTraceHandler(m_targetId);
+
+	if (m_bSaving)
+	{
+		if (!m_writer.Close() || m_bWriteFailed)
+			PrintMessage(ML_ERROR, L"Failed writing %s\n", UTF8ToWChar(m_strSaveFile).c_str());
+		else
+			PrintMessage(ML_INFO, L"Saved %I64u records to %s\n", m_writer.GetRecordCount(), UTF8ToWChar(m_strSaveFile).c_str());
+	}
+}
+
+bool FileTraceCommand::DoLive()
+{
+	if (m_processId == INVALID_PROCESS)
+	{
+		if (!AutoGetProcessId(m_processId))
+			return false;
+
+		if (m_processId == INVALID_PROCESS)
+		{
+			PrintMessage(ML_ERROR, L"No process was loaded and no PID was explicitly specified using the -pid option\n");
+			return false;
+		}
+	}
+
+	if (!RegisterHandler())
+		return false;
+
+	SNRESULT snr;
+	if (SN_FAILED( snr = SNPS3StartFileTrace(m_targetId, m_processId, FILETRACE_CONTAINER_SIZE, m_strTargetFile.c_str()) ))
+	{
+		PrintError(snr, L"Failed to start file trace");
+		UnRegisterHandler();
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Tracing file access of process 0x%08X, press ESC to stop...\n", m_processId);
+
+	DWORD dwStart = GetTickCount();
+	DWORD dwLastFlush = dwStart;
+
+	while (!m_bAbortKick)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bAbortKick)
+			/* Do nothing */;
+
+		if (CheckForEscape())
+			break;
+
+		DWORD dwNow = GetTickCount();
+		if (m_uDuration && dwNow - dwStart >= m_uDuration * 1000)
+			break;
+
+		if (m_bSaving && dwNow - dwLastFlush >= FILETRACE_FLUSH_INTERVAL_MS)
+		{
+			if (!m_writer.Flush())
+				m_bWriteFailed = true;
+			dwLastFlush = dwNow;
+		}
+
+		::Sleep(10);
+	}
+
+	if (SN_FAILED( snr = SNPS3StopFileTrace(m_targetId, m_processId) ))
+		PrintError(snr, L"Failed to stop file trace");
+
+	// Collect anything the target sent before it stopped.
+	::Sleep(100);
+	while (SNPS3Kick() == SN_S_OK && !m_bWriteFailed)
+		/* Do nothing */;
+
+	UnRegisterHandler();
+
+	return !m_bWriteFailed;
+}
+
+bool FileTraceCommand::DoOffline()
+{
+	if (!RegisterHandler())
+		return false;
+
+	SNRESULT snr;
+	if (SN_FAILED( snr = SNPS3ProcessOfflineFileTrace(m_targetId, m_strFile.c_str()) ))
+	{
+		PrintError(snr, L"Failed to process offline file trace %s", UTF8ToWChar(m_strFile).c_str());
+		UnRegisterHandler();
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Processing %s, press ESC to stop...\n", UTF8ToWChar(m_strFile).c_str());
+
+	// The trace ends with an SNPS3_FT_OFFLINE_END record.
+	while (!m_bAbortKick)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bAbortKick)
+			/* Do nothing */;
+
+		if (CheckForEscape())
+			break;
+
+		::Sleep(10);
+	}
+
+	UnRegisterHandler();
+
+	if (!m_bOfflineEnd)
+		PrintMessage(ML_WARN, L"Stopped before the end of %s\n", UTF8ToWChar(m_strFile).c_str());
+
+	return !m_bWriteFailed;
+}
+
+bool FileTraceCommand::DoRead()
+{
+	FileTraceReader reader;
+	if (!reader.Open(UTF8ToWChar(m_strFile).c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a saved file trace\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	m_analyzer.SetTimebaseFrequency(reader.GetHeader().uTimebaseFrequency);
+
+	const BYTE* pRecords = NULL;
+	FileTraceBlockHeader block;
+	UINT64 uOffset = reader.GetFirstBlockOffset();
+	bool bCorrupt = false;
+
+	while (!bCorrupt && reader.MapBlock(uOffset, pRecords, block, uOffset))
+	{
+		FileTraceBlockCursor cursor(pRecords, block);
+		const BYTE* pRecord;
+		UINT32 uLength;
+
+		while (cursor.Next(pRecord, uLength, bCorrupt))
+			m_analyzer.AddRecord(pRecord, uLength);
+	}
+
+	if (reader.GetHeader().uRecordCount == 0)
+		PrintMessage(ML_WARN, L"Trace was not closed cleanly\n");
+	if (bCorrupt || reader.IsCorrupt())
+		PrintMessage(ML_WARN, L"Trace is damaged after record %I64u\n", m_analyzer.GetRecordCount());
+
+	return true;
+}
+
+bool FileTraceCommand::DoIndex()
+{
+	FileTraceIndexer indexer;
+	DWORD dwStart = GetTickCount();
+
+	PrintMessage(ML_INFO, L"Indexing %s...\n", UTF8ToWChar(m_strFile).c_str());
+
+	if (!indexer.Build(UTF8ToWChar(m_strFile).c_str(), UTF8ToWChar(m_strOutFile).c_str(), m_uThreads))
+	{
+		PrintMessage(ML_ERROR, L"Failed to index %s into %s\n", UTF8ToWChar(m_strFile).c_str(), UTF8ToWChar(m_strOutFile).c_str());
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Indexed %I64u records into %I64u rows, %I64u paths and %I64u back-traces in %.2fs\n",
+		indexer.GetRecordCount(), indexer.GetRowCount(), indexer.GetPathCount(), indexer.GetBackTraceCount(),
+		(GetTickCount() - dwStart) / 1000.0);
+
+	if (indexer.GetMalformedCount())
+		PrintMessage(ML_WARN, L"%I64u records could not be parsed\n", indexer.GetMalformedCount());
+	if (indexer.IsCorrupt())
+		PrintMessage(ML_WARN, L"Trace is damaged, only the readable part was indexed\n");
+
+	return true;
+}
+
+bool FileTraceCommand::DoQuery()
+{
+	FileTraceIndex index;
+	if (!index.Open(UTF8ToWChar(m_strFile).c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a file trace index\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	LARGE_INTEGER freq, start, end;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+
+	std::vector<UINT64> rows;
+	index.Query(m_query, rows);
+
+	QueryPerformanceCounter(&end);
+
+	WCHAR szLine[1024];
+	swprintf(szLine, _countof(szLine), L"%14s %-18s %12s %12s %6s  %s",
+		L"Time(s)", L"API", L"Duration(us)", L"Size", L"Handle", L"File");
+	std::wcout << szLine << std::endl;
+
+	double fFrequency = (double)index.GetHeader().uTimebaseFrequency;
+	for (size_t i = 0; i < rows.size() && i < m_uLimit; ++i)
+	{
+		UINT64 uRow = rows[i];
+		UINT32 uFile = index.GetFile(uRow);
+		UINT32 uDuration = index.GetDuration(uRow);
+
+		WCHAR szDuration[16];
+		if (uDuration == FILE_TRACE_NO_DURATION)
+			swprintf(szDuration, _countof(szDuration), L"-");
+		else
+			swprintf(szDuration, _countof(szDuration), L"%u", uDuration);
+
+		swprintf(szLine, _countof(szLine), L"%14.6f %-18s %12s %12I64u %6I64u  %s",
+			index.GetTimeBase(uRow) / fFrequency, CUTF8ToWChar(GetFileTraceApiName(index.GetApiType(uRow))).c_str(),
+			szDuration, index.GetSize(uRow), index.GetHandle(uRow),
+			uFile == FILE_TRACE_NO_ID ? L"<unknown>" : UTF8ToWChar(index.GetPath(uFile)).c_str());
+		std::wcout << szLine << std::endl;
+	}
+
+	PrintMessage(ML_INFO, L"Matched %I64u of %I64u rows in %.2fms\n", (UINT64)rows.size(), index.GetRowCount(),
+		(end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+	return true;
+}
+
+bool FileTraceCommand::DoGenerate()
+{
+	const UINT32 uThreadCount = 8;
+	const UINT32 uFileCount = 512;
+	const UINT32 uCallSiteCount = 64;
+	const UINT64 uTraceStart = 0x100000000ULL;
+	const UINT64 uMicrosecond = FILE_TRACE_DEFAULT_TIMEBASE / 1000000;
+
+	SyntheticTraceBuilder builder(0x5eed, uTraceStart);
+
+	if (!m_writer.Open(UTF8ToWChar(m_strFile).c_str(), FILE_TRACE_DEFAULT_TIMEBASE))
+	{
+		PrintMessage(ML_ERROR, L"Failed to create %s\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	std::vector<std::string> paths(uFileCount);
+	for (UINT32 i = 0; i < uFileCount; ++i)
+	{
+		char szPath[128];
+		sprintf_s(szPath, _countof(szPath), "/dev_bdvd/PS3_GAME/USRDIR/data/level%02u/chunk%04u.dat", i % 24, i);
+		paths[i] = szPath;
+	}
+
+	std::vector<std::vector<UINT32> > backTraces(uCallSiteCount);
+	for (UINT32 i = 0; i < uCallSiteCount; ++i)
+	{
+		backTraces[i].resize(4 + builder.Random(5));
+		for (size_t j = 0; j < backTraces[i].size(); ++j)
+			backTraces[i][j] = (0x10000 + builder.Random(0x400000)) & ~3;
+	}
+
+	// Threads issue calls one at a time; each call is reported as received,
+	// processing and processed, interleaved with the other threads' calls.
+	std::vector<SyntheticThread> threads(uThreadCount);
+	std::multimap<UINT64, UINT32> ready;
+	for (UINT32 i = 0; i < uThreadCount; ++i)
+	{
+		threads[i].uFd = 0;
+		threads[i].uReadsLeft = 0;
+		threads[i].uFile = 0;
+		ready.insert(std::make_pair(uTraceStart + builder.Random(10000), i));
+	}
+
+	std::multimap<UINT64, std::vector<BYTE> > queued;
+	std::vector<BYTE> payload;
+	std::vector<BYTE> record;
+	UINT64 uSerial = 1;
+	UINT64 uNextFd = 3;
+	bool bOK = true;
+
+	while (bOK && m_writer.GetRecordCount() < m_uGenCount)
+	{
+		UINT64 uNow = ready.begin()->first;
+		UINT32 uThread = ready.begin()->second;
+		ready.erase(ready.begin());
+
+		while (bOK && !queued.empty() && queued.begin()->first <= uNow)
+		{
+			bOK = m_writer.Write(&queued.begin()->second[0], (UINT32)queued.begin()->second.size());
+			queued.erase(queued.begin());
+		}
+
+		SyntheticThread& thread = threads[uThread];
+		SNPS3_FT_PROCESS_INFO info;
+		info.ulVFSID = 1;
+		info.ulFD = thread.uFd;
+
+		UINT32 uApi;
+		UINT64 uService;
+		payload.clear();
+
+		if (thread.uFd == 0 && builder.Random(16) == 0)
+		{
+			const std::string& strPath = paths[builder.Random(uFileCount)];
+			SNPS3_FILE_TRACE_LOG_TYPE_1 stat;
+			stat.ulPathLength = (UINT32)strPath.size() + 1;
+			builder.Append(payload, &stat, sizeof(stat));
+			builder.AppendPath(payload, strPath);
+
+			uApi = SNPS3_FT_STAT;
+			uService = (100 + builder.Random(200)) * uMicrosecond;
+		}
+		else if (thread.uFd == 0)
+		{
+			thread.uFile = builder.Random(uFileCount);
+			thread.uFd = uNextFd++;
+			thread.uReadsLeft = 1 + builder.Random(24);
+			info.ulFD = thread.uFd;
+
+			const std::string& strPath = paths[thread.uFile];
+			SNPS3_FILE_TRACE_LOG_TYPE_8 open;
+			memset(&open, 0, sizeof(open));
+			open.ProcessInfo = info;
+			open.ulVArgLength = 4;
+			open.ulPathLength = (UINT32)strPath.size() + 1;
+			UINT32 uVArg = 0;
+			builder.Append(payload, &open, sizeof(open));
+			builder.Append(payload, &uVArg, sizeof(uVArg));
+			builder.AppendPath(payload, strPath);
+
+			uApi = SNPS3_FT_OPEN;
+			uService = (200 + builder.Random(800)) * uMicrosecond;
+		}
+		else if (thread.uReadsLeft == 0)
+		{
+			SNPS3_FILE_TRACE_LOG_TYPE_9 close;
+			close.ProcessInfo = info;
+			builder.Append(payload, &close, sizeof(close));
+			thread.uFd = 0;
+
+			uApi = SNPS3_FT_CLOSE;
+			uService = (10 + builder.Random(20)) * uMicrosecond;
+		}
+		else if (builder.Random(5) == 0)
+		{
+			SNPS3_FILE_TRACE_LOG_TYPE_13 seek;
+			memset(&seek, 0, sizeof(seek));
+			seek.ProcessInfo = info;
+			seek.ulOffset = (UINT64)builder.Random(4096) * 2048;
+			seek.ulCurPos = seek.ulOffset;
+			builder.Append(payload, &seek, sizeof(seek));
+
+			uApi = SNPS3_FT_LSEEK;
+			uService = (2 + builder.Random(8)) * uMicrosecond;
+		}
+		else
+		{
+			// Reads at about 30MB/s, with the occasional slow one.
+			UINT32 uSize = (1 + builder.Random(64)) * 4096;
+			uService = (50 + uSize / 30) * uMicrosecond;
+			if (builder.Random(200) == 0)
+				uService += (5000 + builder.Random(15000)) * uMicrosecond;
+
+			if (builder.Random(4) == 0)
+			{
+				SNPS3_FILE_TRACE_LOG_TYPE_11 read;
+				memset(&read, 0, sizeof(read));
+				read.ProcessInfo = info;
+				read.ulSize = uSize;
+				read.ulAddress = 0x30000000 + builder.Random(0x1000000);
+				read.ulOffset = (UINT64)builder.Random(4096) * 2048;
+				read.ulTxSize = uSize;
+				builder.Append(payload, &read, sizeof(read));
+				uApi = SNPS3_FT_READ_OFFSET;
+			}
+			else
+			{
+				SNPS3_FILE_TRACE_LOG_TYPE_10 read;
+				memset(&read, 0, sizeof(read));
+				read.ProcessInfo = info;
+				read.ulSize = uSize;
+				read.ulAddress = 0x30000000 + builder.Random(0x1000000);
+				read.ulTxSize = uSize;
+				builder.Append(payload, &read, sizeof(read));
+				uApi = SNPS3_FT_READ;
+			}
+			--thread.uReadsLeft;
+		}
+
+		const std::vector<UINT32>& backTrace = backTraces[(uThread * 7 + uApi) % uCallSiteCount];
+		UINT64 uProcessing = uNow + builder.Random(50) * uMicrosecond;
+		UINT64 uDone = uProcessing + uService;
+
+		const UINT32 statuses[] = { SNPS3_FILE_TRACE_STATUS_RECEIVED, SNPS3_FILE_TRACE_STATUS_PROCESSING, SNPS3_FILE_TRACE_STATUS_PROCESSED };
+		const UINT64 times[] = { uNow, uProcessing, uDone };
+		for (UINT32 i = 0; i < _countof(statuses); ++i)
+		{
+			builder.Header(record, uSerial, uApi, statuses[i], 0x100 + uThread, times[i], backTrace);
+			builder.Append(record, &payload[0], payload.size());
+			queued.insert(std::make_pair(times[i], record));
+		}
+
+		++uSerial;
+		ready.insert(std::make_pair(uDone + builder.Random(200) * uMicrosecond, uThread));
+	}
+
+	// Complete the calls in flight and mark the end of the trace.
+	for (std::multimap<UINT64, std::vector<BYTE> >::iterator iter = queued.begin(); bOK && iter != queued.end(); ++iter)
+		bOK = m_writer.Write(&iter->second[0], (UINT32)iter->second.size());
+
+	if (bOK)
+	{
+		builder.Header(record, uSerial, SNPS3_FT_OFFLINE_END, SNPS3_FILE_TRACE_STATUS_PROCESSED, 0, 0, std::vector<UINT32>());
+		bOK = m_writer.Write(&record[0], (UINT32)record.size());
+	}
+
+	if (!m_writer.Close() || !bOK)
+	{
+		PrintMessage(ML_ERROR, L"Failed writing %s\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Generated %I64u records for %I64u calls in %s\n", m_writer.GetRecordCount(), uSerial - 1, UTF8ToWChar(m_strFile).c_str());
+	return true;
+}
+
+void FileTraceCommand::DisplayReport()
+{
+	WCHAR szLine[1024];
+
+	std::wcout << L"Records:   " << m_analyzer.GetRecordCount() << L" (" << m_analyzer.GetMalformedCount() << L" malformed)" << std::endl;
+	std::wcout << L"Calls:     " << m_analyzer.GetCallCount() << L" (" << m_analyzer.GetUnpairedCount() << L" without timing)" << std::endl;
+	std::wcout << L"Duration:  " << m_analyzer.GetDuration() << L"s" << std::endl;
+	std::wcout << std::endl;
+
+	swprintf(szLine, _countof(szLine), L"%-20s %10s %14s %10s %10s %10s %10s",
+		L"API", L"Calls", L"Bytes", L"Mean(us)", L"p50(us)", L"p99(us)", L"Max(us)");
+	std::wcout << szLine << std::endl;
+
+	const FileTraceAnalyzer::ApiStatsMap& apis = m_analyzer.GetApiStats();
+	for (FileTraceAnalyzer::ApiStatsMap::const_iterator iter = apis.begin(); iter != apis.end(); ++iter)
+	{
+		const FileTraceApiStats& api = iter->second;
+		swprintf(szLine, _countof(szLine), L"%-20s %10I64u %14I64u %10.1f %10I64u %10I64u %10I64u",
+			CUTF8ToWChar(GetFileTraceApiName(iter->first)).c_str(), api.uCalls, api.uBytes, api.latency.GetMean(),
+			api.latency.GetValueAtPercentile(50.0), api.latency.GetValueAtPercentile(99.0), api.latency.GetMax());
+		std::wcout << szLine << std::endl;
+	}
+
+	std::vector<UINT32> hot;
+	m_analyzer.GetHotFiles(m_uTop, hot);
+	if (hot.empty())
+		return;
+
+	const std::vector<FileTraceFileStats>& files = m_analyzer.GetFiles();
+
+	std::wcout << std::endl;
+	swprintf(szLine, _countof(szLine), L"%12s %8s %8s %14s %8s %10s  %s",
+		L"I/O(ms)", L"Opens", L"Reads", L"Bytes read", L"Seeks", L"p99(us)", L"File");
+	std::wcout << szLine << std::endl;
+
+	for (size_t i = 0; i < hot.size(); ++i)
+	{
+		const FileTraceFileStats& file = files[hot[i]];
+		swprintf(szLine, _countof(szLine), L"%12.1f %8I64u %8I64u %14I64u %8I64u %10I64u  %s",
+			file.uIoTime / 1000.0, file.uOpens, file.uReads, file.uBytesRead, file.uSeeks,
+			file.latency.GetValueAtPercentile(99.0), UTF8ToWChar(file.strPath).c_str());
+		std::wcout << szLine << std::endl;
+	}
+}
+
+void FileTraceCommand::DisplayUsageHelp() const
+{
+	std::cout << "The filetrace command allows you to trace and analyse the file access of a process" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl filetrace <options>" << std::endl << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -pid <hex>" << "\t" << "Process ID to trace (optional, defaults to the last process loaded)" << std::endl;
+	std::cout << "  -y <timeout>" << "\t" << "Stop tracing after <timeout> seconds, otherwise trace until ESC is pressed" << std::endl;
+	std::cout << "  -tf <path>" << "\t" << "Trace file the target writes to (default " << FILETRACE_DEFAULT_TARGET_FILE << ")" << std::endl;
+	std::cout << "  -offline <path>" << "\t" << "Analyse a trace file written by the target instead of tracing" << std::endl;
+	std::cout << "  -read <file>" << "\t" << "Analyse a trace saved with -save, without connecting to a target" << std::endl;
+	std::cout << "  -save <file>" << "\t" << "Save the trace records to <file> for later analysis" << std::endl;
+	std::cout << "  -top <count>" << "\t" << "Number of files to list, by time spent in I/O (default " << FILETRACE_DEFAULT_TOP << ")" << std::endl;
+	std::cout << "  -index <file>" << "\t" << "Build a columnar index of a trace saved with -save" << std::endl;
+	std::cout << "   -o <file>" << "\t" << "Index file to write (default <file>.idx)" << std::endl;
+	std::cout << "   -j <threads>" << "\t" << "Number of parsing threads (default one per core)" << std::endl;
+	std::cout << "  -query <index>" << "\t" << "List the calls in an index that match all of the following" << std::endl;
+	std::cout << "   -api <class>" << "\t" << "open, close, read, write, seek or other" << std::endl;
+	std::cout << "   -min <ms>" << "\t" << "Calls taking at least <ms> milliseconds" << std::endl;
+	std::cout << "   -size <bytes>" << "\t" << "Calls transferring at least <bytes> bytes" << std::endl;
+	std::cout << "   -path <text>" << "\t" << "Calls on files whose path contains <text>" << std::endl;
+	std::cout << "   -limit <count>" << "\t" << "Number of matching calls to list (default " << FILETRACE_DEFAULT_LIMIT << ")" << std::endl;
+	std::cout << "  -gen <file>" << "\t" << "Write a synthetic trace, for testing -read, -index and -query" << std::endl;
+	std::cout << "   -count <records>" << "\t" << "Number of records to generate (default " << FILETRACE_DEFAULT_GEN_COUNT << ")" << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
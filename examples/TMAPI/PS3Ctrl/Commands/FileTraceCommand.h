@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef FILE_TRACE_COMMAND_H
+#define FILE_TRACE_COMMAND_H
+
+#include "TargetCommand.h"
+#include "SingleArgOption.h"
+#include "FileTrace.h"
+#include "FileTraceAnalyzer.h"
+#include "FileTraceIndex.h"
+
+#define FILETRACE_DEFAULT_TARGET_FILE	"/app_home/filetrace.log"
+#define FILETRACE_CONTAINER_SIZE		(1024 * 1024)
+#define FILETRACE_DEFAULT_TOP			(20)
+#define FILETRACE_FLUSH_INTERVAL_MS		(5000)
+#define FILETRACE_DEFAULT_GEN_COUNT		(1000000)
+#define FILETRACE_DEFAULT_LIMIT			(20)
+
+class FileTraceCommand : public TargetCommand
+{
+public:
+					FileTraceCommand();
+	virtual			~FileTraceCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	typedef enum	{FTCMD_NONE=-1,FTCMD_LIVE=0,FTCMD_OFFLINE,FTCMD_READ,FTCMD_INDEX,FTCMD_QUERY,FTCMD_GENERATE} ftcmd_t;
+
+	bool			DoLive();
+	bool			DoOffline();
+	bool			DoRead();
+	bool			DoIndex();
+	bool			DoQuery();
+	bool			DoGenerate();
+	bool			RegisterHandler();
+	void			UnRegisterHandler();
+	bool			AutoGetProcessId(UINT32 &processId) const;
+	UINT64			GetTargetTimebase();
+	void			DisplayReport();
+	virtual void	DisplayUsageHelp() const;
+
+	ftcmd_t				m_Command;
+	UINT32				m_processId;
+	UINT32				m_uDuration;
+	UINT32				m_uTop;
+	std::string			m_strTargetFile;
+	std::string			m_strFile;
+	std::string			m_strSaveFile;
+	std::string			m_strOutFile;
+	UINT32				m_uThreads;
+	UINT64				m_uGenCount;
+	UINT32				m_uLimit;
+	FileTraceQuery		m_query;
+	FileTraceAnalyzer	m_analyzer;
+	FileTraceWriter		m_writer;
+	bool				m_bSaving;
+	bool				m_bWriteFailed;
+	bool				m_bOfflineEnd;
+
+	static void __stdcall FileTraceCallback(HTARGET hTarget, UINT32 uType, UINT32 uParam, SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser);
+};
+
+TargetCommand* FileTraceCommandFactory(void);
+
+#endif
@@ -0,0 +1,168 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "GroupInstallCommand.h"
+
+GroupInstallCommand::GroupInstallCommand()
+: TargetCommand()
+, m_uMaxInFlight(TARGET_GROUP_DEFAULT_MAX)
+, m_bForceInstall(false)
+, m_bLedgerSaveFailed(false)
+{
+	m_identity.uContentStamp = 0;
+	::InitializeCriticalSection(&m_ledgerLock);
+}
+
+GroupInstallCommand::~GroupInstallCommand()
+{
+	::DeleteCriticalSection(&m_ledgerLock);
+}
+
+bool GroupInstallCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<std::string> tg("tg", "target-group", "");
+	SingleArgOption<UINT32> j("j", "jobs", TARGET_GROUP_DEFAULT_MAX);
+	StandardOption force("force", "force");
+	SingleArgOption<std::string> ledger("ledger", "ledger", "");
+
+	j.SetParentDependency(&tg);
+	force.SetParentDependency(&tg);
+	ledger.SetParentDependency(&tg);
+
+	m_cmdLineHandler.AddArgument(tg);
+	m_cmdLineHandler.AddArgument(j);
+	m_cmdLineHandler.AddArgument(force);
+	m_cmdLineHandler.AddArgument(ledger);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	if (tg.IsPassed())
+	{
+		m_targetGroup = tg.GetValue();
+		if (m_targetGroup.empty())
+			throw ArgumentException("Error - You need to specify the targets to install on, or \"all\"");
+
+		if (j.IsPassed() && j.GetValue() == 0)
+			throw ArgumentException("Error - The number of installs in flight must be at least 1");
+
+		m_uMaxInFlight = j.GetValue();
+		m_bForceInstall = force.IsSet();
+		m_ledgerPath = ledger.IsPassed() ? UTF8ToWChar(ledger.GetValue()) : InstallLedger::GetDefaultPath();
+
+		// Each member is connected by its install.
+		m_bConnectToTarget = false;
+	}
+
+	m_cmdLineHandler.Reset();
+
+	return true;
+}
+
+bool GroupInstallCommand::DoGroupInstall()
+{
+	if (!ReadIdentity(m_identity))
+		return false;
+
+	PrintMessage(ML_INFO, L"Title %s version %s, content stamp %016I64x\n", UTF8ToWChar(m_identity.strTitleId).c_str(),
+		UTF8ToWChar(m_identity.strVersion).c_str(), m_identity.uContentStamp);
+
+	if (!m_ledger.Load(m_ledgerPath.c_str()))
+		PrintMessage(ML_WARN, L"Could not read install ledger %s, installing on every target\n", m_ledgerPath.c_str());
+
+	TargetGroup group;
+	if (!group.Resolve(m_targetGroup))
+		return false;
+
+	for (size_t i = 0; i < group.GetCount(); ++i)
+	{
+		TargetGroupMember& member = group.GetMember(i);
+		if (!m_bForceInstall && m_ledger.IsInstalled(member.strName, m_identity))
+		{
+			member.result = TGR_SKIPPED;
+			member.strDetail = "Already installed";
+		}
+	}
+
+	UINT32 uPending = group.GetResultCount(TGR_PENDING);
+	if (uPending)
+	{
+		PrintMessage(ML_INFO, L"Installing on %u of %u targets, at most %u at a time. Press ESC to cancel.\n",
+			uPending, (UINT32)group.GetCount(), m_uMaxInFlight);
+
+		if (!group.Start(InstallWork, this, m_uMaxInFlight))
+			return false;
+
+		bool bCancelled = false;
+		while (!group.Wait(100))
+		{
+			if (!bCancelled && CheckForEscape())
+			{
+				bCancelled = true;
+				group.Cancel();
+				PrintMessage(ML_WARN, L"Cancelled, waiting for the %u installs in flight to finish\n", group.GetInFlight());
+			}
+		}
+	}
+
+	group.PrintReport(L"Installed on");
+
+	if (m_bLedgerSaveFailed)
+		PrintMessage(ML_WARN, L"Could not save install ledger %s\n", m_ledgerPath.c_str());
+
+	for (size_t i = 0; i < group.GetCount(); ++i)
+	{
+		const TargetGroupMember& member = group.GetMember(i);
+		if (member.result == TGR_FAILED)
+			SetExitCode(member.snr);
+	}
+
+	return group.GetResultCount(TGR_FAILED) == 0 && group.GetResultCount(TGR_CANCELLED) == 0;
+}
+
+void GroupInstallCommand::DisplayGroupOptions() const
+{
+	std::cout << "  -tg <targets>" << "\t" << "Install on a group of targets at once: comma separated names, or \"all\"" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "With -tg, the most installs in flight at once (default " << TARGET_GROUP_DEFAULT_MAX << ")" << std::endl;
+	std::cout << "  -force" << "\t" << "With -tg, install even where the ledger says the content is installed" << std::endl;
+	std::cout << "  -ledger <path>" << "\t" << "With -tg, the install ledger to use (default %TEMP%\\PS3Ctrl_install.ledger)" << std::endl;
+}
+
+TargetGroupResult GroupInstallCommand::InstallWork(void* pUser, TargetGroupMember& member)
+{
+	GroupInstallCommand* pThis = static_cast<GroupInstallCommand*>(pUser);
+
+	bool bWasConnected = false;
+	if (!TargetGroup::Connect(member, pThis->m_bForceDC, bWasConnected))
+		return TGR_FAILED;
+
+	TargetGroupResult result = pThis->InstallOnTarget(member);
+
+	if (pThis->m_bAlwaysDC || (!bWasConnected && pThis->m_bDCifNotConnected))
+		SNPS3Disconnect(member.hTarget);
+
+	if (result == TGR_SUCCEEDED)
+	{
+		InstallRecord record;
+		record.strTarget = member.strName;
+		record.strTitleId = pThis->m_identity.strTitleId;
+		record.strVersion = pThis->m_identity.strVersion;
+		record.uContentStamp = pThis->m_identity.uContentStamp;
+		record.strSource = pThis->GetSourcePath();
+
+		// Saved after every install, so a run that is cut short still skips
+		// the targets it finished.
+		::EnterCriticalSection(&pThis->m_ledgerLock);
+		pThis->m_ledger.Set(record);
+		if (!pThis->m_ledger.Save(pThis->m_ledgerPath.c_str()))
+			pThis->m_bLedgerSaveFailed = true;
+		::LeaveCriticalSection(&pThis->m_ledgerLock);
+	}
+
+	return result;
+}
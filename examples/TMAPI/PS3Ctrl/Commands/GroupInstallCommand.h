@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef GROUP_INSTALL_COMMAND_H
+#define GROUP_INSTALL_COMMAND_H
+
+#include "TargetCommand.h"
+#include "SingleArgOption.h"
+#include "TargetGroup.h"
+#include "InstallLedger.h"
+
+// Base of the install commands. With -tg the install goes onto every target
+// in a group at once instead of the one target the common options pick:
+// the content is identified once, targets the install ledger says already
+// have it are skipped, and the rest are installed with at most -j in flight.
+class GroupInstallCommand : public TargetCommand
+{
+public:
+					GroupInstallCommand();
+	virtual			~GroupInstallCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+
+protected:
+	bool			IsGroupInstall() const { return !m_targetGroup.empty(); }
+	bool			DoGroupInstall();
+	void			DisplayGroupOptions() const;
+
+	// Implemented by the commands; InstallOnTarget() runs on a worker thread.
+	virtual bool				ReadIdentity(InstallIdentity& identity) = 0;
+	virtual TargetGroupResult	InstallOnTarget(TargetGroupMember& member) = 0;
+	virtual const std::string&	GetSourcePath() const = 0;
+
+	std::string		m_targetGroup;
+	UINT32			m_uMaxInFlight;
+	bool			m_bForceInstall;
+	std::wstring	m_ledgerPath;
+
+private:
+	static TargetGroupResult	InstallWork(void* pUser, TargetGroupMember& member);
+
+	InstallIdentity		m_identity;
+	InstallLedger		m_ledger;
+	CRITICAL_SECTION	m_ledgerLock;
+	bool				m_bLedgerSaveFailed;
+};
+
+#endif
\ No newline at end of file
@@ -12,7 +12,7 @@ TargetCommand* InstallGameCommandFactory(void)
 }
 
 InstallGameCommand::InstallGameCommand()
-: TargetCommand()
+: GroupInstallCommand()
 , m_bWaitForTransfer(false)
 , m_waitTimeout(0)
 {
@@ -26,7 +26,7 @@ InstallGameCommand::~InstallGameCommand()
 
 bool InstallGameCommand::ParseArgs(std::vector<std::string>& arguments)
 {
-	if (!TargetCommand::ParseArgs(arguments))
+	if (!GroupInstallCommand::ParseArgs(arguments))
 		return false;
 
 	SingleArgOption<UINT32> wf("wf", "wait-for-transfer", 0, false, false);
@@ -56,7 +56,7 @@ int InstallGameCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
-	if (!DoInstallGame())
+	if (IsGroupInstall() ? !DoGroupInstall() : !DoInstallGame())
 		return GetErrorCodeOnError();
 
 	return m_exitCode;
@@ -101,6 +101,47 @@ bool InstallGameCommand::DoInstallGame()
 	return true;
 }
 
+bool InstallGameCommand::ReadIdentity(InstallIdentity& identity)
+{
+	SNRESULT snr;
+	if (SN_FAILED(snr = ReadGameIdentity(m_sfoPath, identity)))
+	{
+		PrintError(snr, L"Error reading game parameters. SFO path supplied:%s\n", UTF8ToWChar(m_sfoPath).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+TargetGroupResult InstallGameCommand::InstallOnTarget(TargetGroupMember& member)
+{
+	char* pszTitle;
+	char* pszTargetPath;
+	UINT32 transferId = 0;
+
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3InstallGameEx(member.hTarget, m_sfoPath.c_str(), &pszTitle, &pszTargetPath, &transferId)))
+		return TargetGroup::Fail(member, snr, "Error installing game");
+
+	member.strDetail = pszTargetPath;
+
+	// No transfer is started when PARAM.SFO is the only file.
+	if (transferId == 0)
+		return TGR_SUCCEEDED;
+
+	TMAPI_FT_NOTIFY ftValue = TMAPI_FT_UNKNOWN;
+	if (SN_FAILED(snr = SNPS3WaitForFileTransfer(member.hTarget, transferId, &ftValue, m_bWaitForTransfer ? m_waitTimeout : INFINITE)))
+		return TargetGroup::Fail(member, snr, "Error waiting for game to install");
+
+	if (ftValue != TMAPI_FT_FINISH)
+	{
+		member.strDetail = "Transfer did not finish: " + GetFTText(ftValue);
+		return TGR_FAILED;
+	}
+
+	return TGR_SUCCEEDED;
+}
+
 std::string InstallGameCommand::GetFTText(TMAPI_FT_NOTIFY& val)
 {
 	std::string strVal;
@@ -137,6 +178,7 @@ void InstallGameCommand::DisplayUsageHelp() const
 	std::cout << "Usage: PS3Ctrl install-game <options> <file>" << std::endl << std::endl;
 	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
 	std::cout << "  -wf <timeout>" << "\t" << "Waits for install game to finish before exiting. Timeout in (ms)" << std::endl;
+	DisplayGroupOptions();
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
@@ -7,10 +7,9 @@
 #ifndef INSTALL_GAME_COMMAND_H
 #define INSTALL_GAME_COMMAND_H
 
-#include "TargetCommand.h"
-#include "SingleArgOption.h"
+#include "GroupInstallCommand.h"
 
-class InstallGameCommand : public TargetCommand
+class InstallGameCommand : public GroupInstallCommand
 {
 public:
 					InstallGameCommand();
@@ -23,6 +22,10 @@ protected:
 	std::string		GetFTText(TMAPI_FT_NOTIFY& val);
 	virtual void	DisplayUsageHelp() const;
 
+	virtual bool				ReadIdentity(InstallIdentity& identity);
+	virtual TargetGroupResult	InstallOnTarget(TargetGroupMember& member);
+	virtual const std::string&	GetSourcePath() const { return m_sfoPath; }
+
 	std::string		m_sfoPath;
 	bool			m_bWaitForTransfer;
 	UINT32			m_waitTimeout;
@@ -12,7 +12,7 @@ TargetCommand* InstallPackageCommandFactory(void)
 }
 
 InstallPackageCommand::InstallPackageCommand()
-: TargetCommand()
+: GroupInstallCommand()
 {
 
 }
@@ -24,7 +24,7 @@ InstallPackageCommand::~InstallPackageCommand()
 
 bool InstallPackageCommand::ParseArgs(std::vector<std::string>& arguments)
 {
-	if (!TargetCommand::ParseArgs(arguments))
+	if (!GroupInstallCommand::ParseArgs(arguments))
 		return false;
 
 
@@ -45,7 +45,7 @@ int InstallPackageCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
-	if (!DoInstallPackage())
+	if (IsGroupInstall() ? !DoGroupInstall() : !DoInstallPackage())
 		return GetErrorCodeOnError();
 
 	return m_exitCode;
@@ -69,12 +69,33 @@ bool InstallPackageCommand::DoInstallPackage()
 	return true;
 }
 
+bool InstallPackageCommand::ReadIdentity(InstallIdentity& identity)
+{
+	if (!ReadPackageIdentity(m_pkgPath, identity))
+	{
+		PrintMessage(ML_ERROR, L"Error reading package header. Package path supplied:%s\n", UTF8ToWChar(m_pkgPath).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+TargetGroupResult InstallPackageCommand::InstallOnTarget(TargetGroupMember& member)
+{
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3InstallPackage(member.hTarget, m_pkgPath.c_str())))
+		return TargetGroup::Fail(member, snr, "Error installing package");
+
+	return TGR_SUCCEEDED;
+}
+
 void InstallPackageCommand::DisplayUsageHelp() const
 {
 	std::cout << "The install-package command allows you to install a package." << std::endl << std::endl;
 
 	std::cout << "Usage: PS3Ctrl install-package <options> <file>" << std::endl << std::endl;
 	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	DisplayGroupOptions();
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
@@ -7,10 +7,9 @@
 #ifndef INSTALL_PACKAGE_COMMAND_H
 #define INSTALL_PACKAGE_COMMAND_H
 
-#include "TargetCommand.h"
-#include "SingleArgOption.h"
+#include "GroupInstallCommand.h"
 
-class InstallPackageCommand : public TargetCommand
+class InstallPackageCommand : public GroupInstallCommand
 {
 public:
 					InstallPackageCommand();
@@ -22,6 +21,10 @@ protected:
 	bool			DoInstallPackage();
 	virtual void	DisplayUsageHelp() const;
 
+	virtual bool				ReadIdentity(InstallIdentity& identity);
+	virtual TargetGroupResult	InstallOnTarget(TargetGroupMember& member);
+	virtual const std::string&	GetSourcePath() const { return m_pkgPath; }
+
 	std::string		m_pkgPath;
 };
 
@@ -26,6 +26,7 @@ PS3RunCommand::PS3RunCommand()
 , m_threadId(0xffffffffffffffff)
 , m_bWaitForProcessExit(false)
 , m_bShowTM(false)
+, m_bAdaptiveTimeouts(false)
 {
 
 }
@@ -79,6 +80,9 @@ bool PS3RunCommand::ParseArgs(std::vector<std::string>& arguments)
 	StandardOption showTM("show", "showTargetManager");
 	m_cmdLineHandler.AddArgument(showTM);
 
+	SingleArgOption<std::string> at("at", "adaptive-timeouts", "", false, false);
+	m_cmdLineHandler.AddArgument(at);
+
 	m_cmdLineHandler.Parse(arguments);
 
 	std::vector<std::string>& remainingArgs = m_cmdLineHandler.GetRemainingArguments();
@@ -171,6 +175,12 @@ bool PS3RunCommand::ParseArgs(std::vector<std::string>& arguments)
 	if (showTM.IsSet())
 		m_bShowTM = true;
 
+	if (at.IsPassed())
+	{
+		m_bAdaptiveTimeouts = true;
+		m_timeoutProfilePath = at.GetValue().empty() ? TimeoutProfile::GetDefaultPath() : UTF8ToWChar(at.GetValue());
+	}
+
 	if (nc.IsSet())
 	{
 		m_bConnectToTarget = false;
@@ -185,6 +195,9 @@ int PS3RunCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
+	if (m_bAdaptiveTimeouts)
+		ApplyAdaptiveTimeouts();
+
 	if (m_bShowTM)
 	{
 		STARTUPINFO startupInfo = {0};
@@ -251,10 +264,7 @@ int PS3RunCommand::Run()
 	}
 
 	if (m_bAbsTimeoutSet)
-	{
-		_time64(&m_absTimeoutTime);
-		m_absTimeoutTime += m_absTimeoutDuration;
-	}
+		m_absTimeoutTime = GetMonotonicMilliseconds() + m_absTimeoutDuration * 1000;
 
 	if (m_bWaitForProcessExit || m_bConsoleIn || m_bConsoleOut)
 	{
@@ -340,10 +350,12 @@ bool PS3RunCommand::ResetTargetFirst()
 	if (!m_bResetFirst)
 		return false;
 
+	UINT64 uStart = GetMonotonicMilliseconds();
 	SNRESULT snr = SNPS3ResetEx(m_targetId, 
 		m_bootParam, m_bootMask,
 		static_cast<UINT64>(m_resetParam), (UINT64) -1,
 		0, 0);
+	RecordLatency(TOP_RESET, uStart, snr);
 
 	if (SN_FAILED( snr ))
 	{
@@ -411,9 +423,11 @@ bool PS3RunCommand::ProcessLoadELF()
 	}
 
 	// Download the ELF into target memory.
+	UINT64 uStart = GetMonotonicMilliseconds();
 	SNRESULT snr = SNPS3ProcessLoad(m_targetId, m_modulePriority, m_elfPath.c_str(), 
 		(int)numArgs, (const char**)myArgV,
 		0, NULL, &m_processId, &m_threadId, m_debugFlags);
+	RecordLatency(TOP_LOAD, uStart, snr);
 	if (SN_FAILED( snr ))
 	{
 		PrintError(snr, L"Failed to load \"%s\"", UTF8ToWChar(m_elfPath).c_str());
@@ -529,6 +543,47 @@ bool PS3RunCommand::ProcessSDKCheck(void)
 	return true;
 }
 
+void PS3RunCommand::ApplyAdaptiveTimeouts()
+{
+	if (!m_timeoutProfile.Load(m_timeoutProfilePath.c_str()))
+		PrintMessage(ML_WARN, L"Failed to read timeout profile %s\n", m_timeoutProfilePath.c_str());
+
+	if (m_uConnectTime)
+		RecordLatency(TOP_CONNECT, GetMonotonicMilliseconds() - m_uConnectTime, SN_S_OK);
+
+	UINT32 uApplied = 0;
+	SNRESULT snr = m_timeoutProfile.Apply(m_targetId, m_targetName, uApplied);
+	if (SN_FAILED(snr))
+	{
+		PrintMessage(ML_WARN, L"Failed to set timeouts, keeping the target manager's\n");
+		return;
+	}
+
+	for (int i = 0; i < TOP_COUNT; ++i)
+	{
+		TimedOperation eOperation = (TimedOperation)i;
+		UINT32 uTimeout = m_timeoutProfile.GetTimeout(m_targetName, eOperation);
+		if (uTimeout)
+		{
+			PrintMessage(ML_INFO, L"%s timeout %.1fs, from %u samples\n", UTF8ToWChar(TimeoutProfile::GetOperationName(eOperation)).c_str(),
+				uTimeout / 1000.0, m_timeoutProfile.GetSampleCount(m_targetName, eOperation));
+		}
+	}
+
+	if (uApplied == 0)
+		PrintMessage(ML_INFO, L"Too few samples for adaptive timeouts yet, keeping the target manager's\n");
+}
+
+void PS3RunCommand::RecordLatency(TimedOperation eOperation, UINT64 uStart, SNRESULT snr)
+{
+	if (!m_bAdaptiveTimeouts)
+		return;
+
+	m_timeoutProfile.RecordResult(m_targetName, eOperation, uStart, snr);
+	if (!m_timeoutProfile.Save(m_timeoutProfilePath.c_str()))
+		PrintMessage(ML_WARN, L"Failed to save timeout profile %s\n", m_timeoutProfilePath.c_str());
+}
+
 bool PS3RunCommand::WaitOnEvents()
 {
 	return ConsoleCommand::WaitOnEvents() || m_bWaitForProcessExit;
@@ -562,6 +617,8 @@ void PS3RunCommand::DisplayUsageHelp() const
 	std::cout << "  -e <text>" << "\t" << "Exit if console text found in output" << std::endl;
 	std::cout << "  -y <timeout>" << "\t" << "Terminate after <timeout> seconds" << std::endl;
 	std::cout << "  -z <timeout>" << "\t" << "Terminate after <timeout> seconds without event" << std::endl;
+	std::cout << "  -at <file>" << "\t" << "Time reset, connect and load, keeping the times in <file>, and set" << std::endl;
+	std::cout << "   " << "\t\t" << "the target's timeouts from them. No value = PS3Ctrl_timeouts.profile in %TEMP%" << std::endl;
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
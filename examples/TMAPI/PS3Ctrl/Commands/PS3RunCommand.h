@@ -8,6 +8,7 @@
 #define PS3RUN_COMMAND_H
 
 #include "ConsoleCommand.h"
+#include "TimeoutProfile.h"
 
 class PS3RunCommand : public ConsoleCommand
 {
@@ -25,6 +26,8 @@ protected:
 	bool			GetResetParameters(RESET_PARAMETERS& rp);
 	bool			SetBootParameters(RESET_PARAMETERS const& rp);
 	bool			ProcessSDKCheck(void);
+	void			ApplyAdaptiveTimeouts();
+	void			RecordLatency(TimedOperation eOperation, UINT64 uStart, SNRESULT snr);
 	virtual bool	WaitOnEvents();
 	virtual void	DisplayUsageHelp() const;
 
@@ -38,6 +41,9 @@ protected:
 	RESET_PARAMETERS			m_originalResetParams;
 	bool						m_bWaitForProcessExit;
 	bool						m_bShowTM; // shows the TM on execute, false by default
+	bool						m_bAdaptiveTimeouts;
+	std::wstring				m_timeoutProfilePath;
+	TimeoutProfile				m_timeoutProfile;
 
 	// Elf stuff
 	std::string					m_elfPath;
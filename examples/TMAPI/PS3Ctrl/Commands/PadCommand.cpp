@@ -0,0 +1,501 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "PadCommand.h"
+#include "HdrHistogram.h"
+
+namespace
+{
+	const UINT32 s_notifyCodes[] =
+	{
+		SNPS3TM_CTRLP_OK, SNPS3TM_CTRLP_EINVAL, SNPS3TM_CTRLP_ENOMEM, SNPS3TM_CTRLP_EBUSY, SNPS3TM_CTRLP_ENODEV
+	};
+	const WCHAR* s_notifyNames[] =
+	{
+		L"ok", L"invalid", L"out of memory", L"busy", L"no device"
+	};
+
+	// Converts target timebase ticks to host performance counter ticks
+	// without overflowing on multi-hour recordings.
+	INT64 TimebaseToHost(UINT64 uTicks, UINT64 uTimebaseFreq, UINT64 uHostFreq)
+	{
+		return (INT64)((uTicks / uTimebaseFreq) * uHostFreq + (uTicks % uTimebaseFreq) * uHostFreq / uTimebaseFreq);
+	}
+
+	INT64 GetHostTime()
+	{
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+}
+
+TargetCommand* PadCommandFactory(void)
+{
+	return new PadCommand();
+}
+
+PadCommand::PadCommand()
+: TargetCommand()
+, m_Command(PADCMD_NONE)
+, m_uDuration(0)
+, m_uLeadTimeMs(PAD_DEFAULT_LEAD_MS)
+, m_bWriteFailed(false)
+{
+	memset(m_uNotifyCounts, 0, sizeof(m_uNotifyCounts));
+}
+
+PadCommand::~PadCommand()
+{
+
+}
+
+bool PadCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<std::string> cap("cap", "capture", "");
+	SingleArgOption<std::string> play("play", "playback", "");
+	SingleArgOption<std::string> info("info", "info", "");
+	SingleArgOption<UINT32> y("y", "timeout", 0);
+	SingleArgOption<UINT32> lead("lead", "lead-time", PAD_DEFAULT_LEAD_MS);
+
+	y.SetParentDependency(&cap);
+	lead.SetParentDependency(&play);
+
+	m_cmdLineHandler.AddArgument(cap);
+	m_cmdLineHandler.AddArgument(play);
+	m_cmdLineHandler.AddArgument(info);
+	m_cmdLineHandler.AddArgument(y);
+	m_cmdLineHandler.AddArgument(lead);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	if (cap.IsPassed())
+	{
+		m_Command = PadCommand::PADCMD_CAPTURE;
+		m_strFile = cap.GetValue();
+		m_uDuration = y.GetValue();
+	}
+	else if (play.IsPassed())
+	{
+		m_Command = PadCommand::PADCMD_PLAYBACK;
+		m_strFile = play.GetValue();
+		m_uLeadTimeMs = lead.GetValue();
+	}
+	else if (info.IsPassed())
+	{
+		m_Command = PadCommand::PADCMD_INFO;
+		m_strFile = info.GetValue();
+		m_bConnectToTarget = false;
+	}
+	else
+	{
+		throw ArgumentException("Error - specify one of -cap, -play or -info!");
+	}
+
+	if (m_strFile.empty())
+		throw ArgumentException("Error - you need to specify a recording file!");
+
+	m_cmdLineHandler.Reset();
+
+	return true;
+}
+
+int PadCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	bool bOK = false;
+	switch (m_Command)
+	{
+	case PADCMD_CAPTURE:
+		bOK = DoCapture();
+		break;
+	case PADCMD_PLAYBACK:
+		bOK = DoPlayback();
+		break;
+	case PADCMD_INFO:
+		bOK = DoInfo();
+		break;
+	default:
+		break;
+	}
+
+	if (!bOK)
+		return GetErrorCodeOnError();
+
+	return m_exitCode;
+}
+
+UINT64 PadCommand::GetTargetTimebase()
+{
+	UINT32 uMask = SYS_INFO_TIMEBASE_FREQ;
+	SNPS3SystemInfo sysInfo;
+	memset(&sysInfo, 0, sizeof(sysInfo));
+
+	SNRESULT snr = SNPS3GetSystemInfo(m_targetId, 0, &uMask, &sysInfo);
+	if (SN_FAILED(snr) || !(uMask & SYS_INFO_TIMEBASE_FREQ) || sysInfo.uTimebaseFrequency == 0)
+	{
+		PrintMessage(ML_WARN, L"Could not read the target timebase frequency, assuming %u Hz\n", PAD_DEFAULT_TIMEBASE);
+		return PAD_DEFAULT_TIMEBASE;
+	}
+
+	return sysInfo.uTimebaseFrequency;
+}
+
+void __stdcall PadCommand::PadCaptureCallback(HTARGET /*hTarget*/, UINT32 uType, UINT32 /*uParam*/,
+	SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser)
+{
+	PadCommand* pCommand = static_cast<PadCommand*>(pUser);
+
+	if (uType != SN_EVENT_PAD || SN_FAILED(snr) || !pCommand || pCommand->m_bWriteFailed)
+		return;
+
+	// uLength is the number of SNPS3PadData records in pData.
+	if (!pCommand->m_writer.Write(reinterpret_cast<SNPS3PadData*>(pData), uLength))
+	{
+		pCommand->m_bWriteFailed = true;
+		pCommand->SetAbortKick();
+	}
+}
+
+void __stdcall PadCommand::PadNotifyCallback(HTARGET /*hTarget*/, UINT32 uType, UINT32 /*uParam*/,
+	SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser)
+{
+	PadCommand* pCommand = static_cast<PadCommand*>(pUser);
+
+	if (uType != SN_EVENT_PAD_NOTIFY || SN_FAILED(snr) || !pCommand)
+		return;
+
+	// uLength is the number of UINT32 result codes in pData.
+	const UINT32* pCodes = reinterpret_cast<const UINT32*>(pData);
+	for (UINT32 i = 0; i < uLength; ++i)
+	{
+		for (UINT32 j = 0; j < _countof(s_notifyCodes); ++j)
+		{
+			if (pCodes[i] == s_notifyCodes[j])
+				++pCommand->m_uNotifyCounts[j];
+		}
+	}
+}
+
+bool PadCommand::DoCapture()
+{
+	UINT64 uTimebase = GetTargetTimebase();
+
+	if (!m_writer.Open(UTF8ToWChar(m_strFile).c_str(), uTimebase))
+	{
+		PrintMessage(ML_ERROR, L"Failed to create %s\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	SNRESULT snr;
+	if (SN_FAILED( snr = SNPS3RegisterPadCaptureHandler(m_targetId, PadCaptureCallback, this) ))
+	{
+		PrintError(snr, L"Failed to register pad capture handler");
+		return false;
+	}
+
+	if (SN_FAILED( snr = SNPS3StartPadCapture(m_targetId) ))
+	{
+		PrintError(snr, L"Failed to start pad capture");
+		SNPS3UnRegisterPadCaptureHandler(m_targetId);
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Capturing pad data to %s, press ESC to stop...\n", UTF8ToWChar(m_strFile).c_str());
+
+	DWORD dwStart = GetTickCount();
+	DWORD dwLastFlush = dwStart;
+
+	while (!m_bAbortKick)
+	{
+		while (SNPS3Kick() == SN_S_OK && !m_bAbortKick)
+			/* Do nothing */;
+
+		if (CheckForEscape())
+			break;
+
+		DWORD dwNow = GetTickCount();
+		if (m_uDuration && dwNow - dwStart >= m_uDuration * 1000)
+			break;
+
+		if (dwNow - dwLastFlush >= PAD_FLUSH_INTERVAL_MS)
+		{
+			if (!m_writer.Flush())
+				m_bWriteFailed = true;
+			dwLastFlush = dwNow;
+		}
+
+		::Sleep(10);
+	}
+
+	if (SN_FAILED( snr = SNPS3StopPadCapture(m_targetId) ))
+		PrintError(snr, L"Failed to stop pad capture");
+
+	// Collect anything the target sent before it stopped.
+	::Sleep(100);
+	while (SNPS3Kick() == SN_S_OK && !m_bWriteFailed)
+		/* Do nothing */;
+
+	SNPS3UnRegisterPadCaptureHandler(m_targetId);
+
+	if (!m_writer.Close() || m_bWriteFailed)
+	{
+		PrintMessage(ML_ERROR, L"Failed writing %s\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	UINT64 uRecords = m_writer.GetRecordCount();
+	UINT64 uRawBytes = uRecords * sizeof(SNPS3PadData);
+	UINT64 uBytes = m_writer.GetBytesWritten();
+
+	PrintMessage(ML_INFO, L"Captured %I64u records, %I64u bytes (%I64u raw, %.1fx smaller)\n",
+		uRecords, uBytes, uRawBytes, uBytes ? (double)uRawBytes / uBytes : 0.0);
+
+	return true;
+}
+
+bool PadCommand::SendPadData(SNPS3PadData& data, UINT32& uBusyRetries)
+{
+	DWORD dwStart = GetTickCount();
+
+	for (;;)
+	{
+		SNRESULT snr = SNPS3SendPadPlaybackData(m_targetId, &data);
+		if (snr != SN_E_BUSY)
+		{
+			if (SN_FAILED(snr))
+			{
+				PrintError(snr, L"Failed to send pad playback data");
+				return false;
+			}
+			return true;
+		}
+
+		// The previous send has not completed; let the API pump its messages.
+		++uBusyRetries;
+		SNPS3Kick();
+
+		if (GetTickCount() - dwStart > 1000)
+		{
+			PrintError(snr, L"Timed out sending pad playback data");
+			return false;
+		}
+	}
+}
+
+bool PadCommand::DoPlayback()
+{
+	PadRecordReader reader;
+	if (!reader.Open(UTF8ToWChar(m_strFile).c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a pad recording\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	UINT64 uTimebase = reader.GetHeader().uTimebaseFrequency;
+	UINT64 uTargetTimebase = GetTargetTimebase();
+	if (uTargetTimebase != uTimebase)
+	{
+		PrintMessage(ML_WARN, L"Recording timebase %I64u Hz differs from target timebase %I64u Hz\n",
+			uTimebase, uTargetTimebase);
+	}
+
+	std::vector<SNPS3PadData> records;
+	if (!reader.ReadBlock(records))
+	{
+		PrintMessage(ML_ERROR, L"%s contains no pad data\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	SNRESULT snr;
+	if (SN_FAILED( snr = SNPS3RegisterPadPlaybackNotificationHandler(m_targetId, PadNotifyCallback, this) ))
+	{
+		PrintError(snr, L"Failed to register pad playback notification handler");
+		return false;
+	}
+
+	if (SN_FAILED( snr = SNPS3StartPadPlayback(m_targetId) ))
+	{
+		PrintError(snr, L"Failed to start pad playback");
+		SNPS3UnRegisterPadPlaybackNotificationHandler(m_targetId);
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Playing back %s, press ESC to stop...\n", UTF8ToWChar(m_strFile).c_str());
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	const INT64 nHostFreq = freq.QuadPart;
+	const INT64 nSpinTicks = nHostFreq / 500;	// Spin for the last 2ms
+
+	// Every record is scheduled against the first record's timestamp rather
+	// than the previous send, so per-record latency never accumulates into drift.
+	const UINT64 uFirstTimestamp = PadTimestamp(records[0]);
+	const INT64 nStart = GetHostTime() + nHostFreq * m_uLeadTimeMs / 1000;
+
+	HdrHistogram lateness;			// Microseconds
+	UINT64 uLastTimestamp = uFirstTimestamp;
+	INT64 nLastDue = nStart;
+	INT64 nLastSent = nStart;
+	UINT32 uBusyRetries = 0;
+	bool bOK = true;
+	bool bAborted = false;
+	size_t nIndex = 0;
+
+	while (bOK)
+	{
+		if (nIndex == records.size())
+		{
+			// Decode the next block while we are still ahead of schedule.
+			nIndex = 0;
+			if (!reader.ReadBlock(records))
+				break;
+		}
+
+		SNPS3PadData& data = records[nIndex++];
+		UINT64 uTimestamp = PadTimestamp(data);
+		INT64 nDue = nStart;
+		if (uTimestamp > uFirstTimestamp)
+			nDue += TimebaseToHost(uTimestamp - uFirstTimestamp, uTimebase, nHostFreq);
+		if (nDue < nLastDue)
+			nDue = nLastDue;
+
+		INT64 nNow = GetHostTime();
+		while (nNow < nDue)
+		{
+			if (nDue - nNow > nSpinTicks)
+			{
+				SNPS3Kick();
+				if (CheckForEscape())
+				{
+					bAborted = true;
+					break;
+				}
+				::Sleep(1);
+			}
+			else
+			{
+				YieldProcessor();
+			}
+			nNow = GetHostTime();
+		}
+
+		if (bAborted)
+			break;
+
+		// Records already due (several ports sharing a timestamp, or catching
+		// up after a stall) go out back to back without waiting.
+		bOK = SendPadData(data, uBusyRetries);
+
+		nLastSent = GetHostTime();
+		lateness.Record((UINT64)(nLastSent - nDue) * 1000000 / nHostFreq);
+		nLastDue = nDue;
+		uLastTimestamp = uTimestamp;
+	}
+
+	::Sleep(100);
+	while (SNPS3Kick() == SN_S_OK)
+		/* Do nothing */;
+
+	if (SN_FAILED( snr = SNPS3StopPadPlayback(m_targetId) ))
+		PrintError(snr, L"Failed to stop pad playback");
+
+	SNPS3UnRegisterPadPlaybackNotificationHandler(m_targetId);
+
+	if (reader.IsCorrupt())
+		PrintMessage(ML_WARN, L"%s is damaged, playback stopped at the last good block\n", UTF8ToWChar(m_strFile).c_str());
+
+	double fRecorded = (double)(uLastTimestamp - uFirstTimestamp) / uTimebase;
+	double fPlayed = (double)(nLastSent - nStart) / nHostFreq;
+
+	PrintMessage(ML_INFO, L"Sent %I64u records: recorded span %.3fs, played span %.3fs (drift %+.3fms)\n",
+		lateness.GetCount(), fRecorded, fPlayed, (fPlayed - fRecorded) * 1000.0);
+	PrintMessage(ML_INFO, L"Lateness (us): mean %.1f, p50 %I64u, p99 %I64u, p99.9 %I64u, max %I64u; busy retries %u\n",
+		lateness.GetMean(), lateness.GetValueAtPercentile(50.0), lateness.GetValueAtPercentile(99.0),
+		lateness.GetValueAtPercentile(99.9), lateness.GetMax(), uBusyRetries);
+
+	for (UINT32 i = 1; i < _countof(s_notifyCodes); ++i)
+	{
+		if (m_uNotifyCounts[i])
+			PrintMessage(ML_WARN, L"Target reported %u '%s' playback errors\n", m_uNotifyCounts[i], s_notifyNames[i]);
+	}
+
+	return bOK;
+}
+
+bool PadCommand::DoInfo()
+{
+	PadRecordReader reader;
+	if (!reader.Open(UTF8ToWChar(m_strFile).c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a pad recording\n", UTF8ToWChar(m_strFile).c_str());
+		return false;
+	}
+
+	const PadRecordingHeader& header = reader.GetHeader();
+	std::vector<SNPS3PadData> records;
+	UINT64 uRecords = 0;
+	UINT64 uBlocks = 0;
+	UINT64 uFirst = 0;
+	UINT64 uLast = 0;
+	UINT32 uPorts = 0;
+
+	while (reader.ReadBlock(records))
+	{
+		if (uRecords == 0)
+			uFirst = PadTimestamp(records[0]);
+		uLast = PadTimestamp(records.back());
+		uRecords += records.size();
+		++uBlocks;
+
+		for (size_t i = 0; i < records.size(); ++i)
+			if (records[i].ucPort < 32)
+				uPorts |= 1 << records[i].ucPort;
+	}
+
+	UINT64 uRawBytes = uRecords * sizeof(SNPS3PadData);
+	UINT64 uBytes = reader.GetFileSize();
+
+	std::wcout << L"File:      " << UTF8ToWChar(m_strFile) << std::endl;
+	std::wcout << L"Records:   " << uRecords << L" in " << uBlocks << L" blocks" << std::endl;
+	std::wcout << L"Duration:  " << (double)(uLast - uFirst) / header.uTimebaseFrequency << L"s at " << header.uTimebaseFrequency << L" Hz" << std::endl;
+	std::wcout << L"Ports:     ";
+	for (UINT32 i = 0; i < 32; ++i)
+		if (uPorts & (1 << i))
+			std::wcout << i << L" ";
+	std::wcout << std::endl;
+	std::wcout << L"Size:      " << uBytes << L" bytes (" << uRawBytes << L" raw, "
+		<< (uBytes ? (double)uRawBytes / uBytes : 0.0) << L"x smaller)" << std::endl;
+
+	if (header.uRecordCount == 0)
+		PrintMessage(ML_WARN, L"Recording was not closed cleanly\n");
+	if (reader.IsCorrupt())
+		PrintMessage(ML_WARN, L"Recording is damaged after record %I64u\n", uRecords);
+
+	return true;
+}
+
+void PadCommand::DisplayUsageHelp() const
+{
+	std::cout << "The pad command allows you to capture and play back control pad input" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl pad <options>" << std::endl << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -cap <file>" << "\t" << "Capture pad input to a recording until ESC is pressed" << std::endl;
+	std::cout << "   -y <timeout>" << "\t" << "Stop capturing after <timeout> seconds" << std::endl;
+	std::cout << "  -play <file>" << "\t" << "Play back a recording at its captured timing" << std::endl;
+	std::cout << "   -lead <ms>" << "\t" << "Delay before the first record is sent (default 200)" << std::endl;
+	std::cout << "  -info <file>" << "\t" << "Display information about a recording" << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef PAD_COMMAND_H
+#define PAD_COMMAND_H
+
+#include "TargetCommand.h"
+#include "SingleArgOption.h"
+#include "PadRecording.h"
+
+#define PAD_DEFAULT_TIMEBASE		(79800000)
+#define PAD_DEFAULT_LEAD_MS			(200)
+#define PAD_FLUSH_INTERVAL_MS		(5000)
+
+class PadCommand : public TargetCommand
+{
+public:
+					PadCommand();
+	virtual			~PadCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	typedef enum	{PADCMD_NONE=-1,PADCMD_CAPTURE=0,PADCMD_PLAYBACK,PADCMD_INFO} padcmd_t;
+
+	bool			DoCapture();
+	bool			DoPlayback();
+	bool			DoInfo();
+	UINT64			GetTargetTimebase();
+	bool			SendPadData(SNPS3PadData& data, UINT32& uBusyRetries);
+	virtual void	DisplayUsageHelp() const;
+
+	padcmd_t			m_Command;
+	std::string			m_strFile;
+	UINT32				m_uDuration;
+	UINT32				m_uLeadTimeMs;
+	PadRecordWriter		m_writer;
+	bool				m_bWriteFailed;
+	UINT32				m_uNotifyCounts[5];
+
+	static void __stdcall PadCaptureCallback(HTARGET hTarget, UINT32 uType, UINT32 uParam, SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser);
+	static void __stdcall PadNotifyCallback(HTARGET hTarget, UINT32 uType, UINT32 uParam, SNRESULT snr, UINT32 uLength, BYTE* pData, void* pUser);
+};
+
+TargetCommand* PadCommandFactory(void);
+
+#endif
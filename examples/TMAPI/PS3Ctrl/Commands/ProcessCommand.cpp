@@ -15,6 +15,7 @@ ProcessCommand::ProcessCommand()
 : TargetCommand()
 , m_terTimeout(0)
 , m_processId(INVALID_PROCESS)
+, m_bAdaptiveTimeouts(false)
 {
 
 }
@@ -40,12 +41,15 @@ bool ProcessCommand::ParseArgs(std::vector<std::string>& arguments)
 
 	SingleArgOption<UINT32> tt("tt", "terminate-timeout", 0, false);
 	tt.SetParentDependency(&tp);
+	SingleArgOption<std::string> at("at", "adaptive-timeouts", "", false, false);
+	at.SetParentDependency(&tp);
 
 	m_cmdLineHandler.AddArgument(kp);
 	m_cmdLineHandler.AddArgument(sp);
 	m_cmdLineHandler.AddArgument(cp);
 	m_cmdLineHandler.AddArgument(tp);
 	m_cmdLineHandler.AddArgument(tt);
+	m_cmdLineHandler.AddArgument(at);
 
 	m_cmdLineHandler.Parse(arguments);
 
@@ -70,6 +74,12 @@ bool ProcessCommand::ParseArgs(std::vector<std::string>& arguments)
 		m_processId = tp.GetValue();
 		if (tt.IsPassed())
 			m_terTimeout = tt.GetValue();
+
+		if (at.IsPassed())
+		{
+			m_bAdaptiveTimeouts = true;
+			m_timeoutProfilePath = at.GetValue().empty() ? TimeoutProfile::GetDefaultPath() : UTF8ToWChar(at.GetValue());
+		}
 	}
 
 	return true;
@@ -167,8 +177,32 @@ bool ProcessCommand::TerminateProcess()
 	if (m_processId == 0xffffffff)
 		return false;
 
-	SNRESULT snr;
-	if (SN_FAILED(snr = SNPS3TerminateGameProcess(m_targetId, m_processId, m_terTimeout)))
+	TimeoutProfile profile;
+	if (m_bAdaptiveTimeouts)
+	{
+		if (!profile.Load(m_timeoutProfilePath.c_str()))
+			PrintMessage(ML_WARN, L"Failed to read timeout profile %s\n", m_timeoutProfilePath.c_str());
+
+		// A timeout given with -tt is kept.
+		UINT32 uTimeout = profile.GetTimeout(m_targetName, TOP_EXIT);
+		if (uTimeout && m_terTimeout == 0)
+		{
+			m_terTimeout = uTimeout;
+			PrintMessage(ML_INFO, L"Terminate timeout %.1fs, from %u samples\n", uTimeout / 1000.0, profile.GetSampleCount(m_targetName, TOP_EXIT));
+		}
+	}
+
+	UINT64 uStart = GetMonotonicMilliseconds();
+	SNRESULT snr = SNPS3TerminateGameProcess(m_targetId, m_processId, m_terTimeout);
+
+	if (m_bAdaptiveTimeouts)
+	{
+		profile.RecordResult(m_targetName, TOP_EXIT, uStart, snr);
+		if (!profile.Save(m_timeoutProfilePath.c_str()))
+			PrintMessage(ML_WARN, L"Failed to save timeout profile %s\n", m_timeoutProfilePath.c_str());
+	}
+
+	if (SN_FAILED(snr))
 	{
 		PrintError(snr, L"Error terminating process!\n");
 		return false;
@@ -191,6 +225,8 @@ void ProcessCommand::DisplayUsageHelp() const
 	std::cout << "  -kp <pid>" << "\t" << "Kills all threads in the process with process id of <pid> (hex)" << std::endl;
 	std::cout << "  -tp <pid>" << "\t" << "Terminates the process with process id of <pid> (hex)" << std::endl;
 	std::cout << "   -tt <timeout>" << "\t" << "Timeout (ms) to use for terminate process" << std::endl;
+	std::cout << "   -at <file>" << "\t" << "Time the terminate, keeping the times in <file>, and without -tt take" << std::endl;
+	std::cout << "   " << "\t\t" << "the timeout from them. No value = PS3Ctrl_timeouts.profile in %TEMP%" << std::endl;
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
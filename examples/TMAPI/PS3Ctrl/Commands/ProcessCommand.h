@@ -10,6 +10,7 @@
 #include "TargetCommand.h"
 #include "SingleArgOption.h"
 #include "StandardOption.h"
+#include "TimeoutProfile.h"
 
 class ProcessCommand : public TargetCommand
 {
@@ -35,6 +36,8 @@ protected:
 	UINT32		m_terTimeout;
 	Task		m_task;
 	UINT32		m_processId;
+	bool		m_bAdaptiveTimeouts;
+	std::wstring m_timeoutProfilePath;
 };
 
 TargetCommand* ProcessCommandFactory(void);
@@ -14,6 +14,8 @@ TargetCommand* SettingsCommandFactory(void)
 SettingsCommand::SettingsCommand()
 : TargetCommand()
 	,m_Mode(MODE_NONE)
+	,m_uMaxInFlight(TARGET_GROUP_DEFAULT_MAX)
+	,m_bNoReset(false)
 {
 }
 
@@ -29,9 +31,24 @@ bool SettingsCommand::ParseArgs(std::vector<std::string>& arguments)
 
 	SingleArgOption<std::string> imp("i", "import", "");
 	SingleArgOption<std::string> exp("e", "export", "");
+	SingleArgOption<std::string> snap("snap", "snapshot", "");
+	SingleArgOption<std::string> diff("diff", "diff", "");
+	SingleArgOption<std::string> apply("apply", "apply", "");
+	StandardOption noreset("noreset", "noreset");
+	SingleArgOption<std::string> tg("tg", "target-group", "");
+	SingleArgOption<UINT32> j("j", "jobs", TARGET_GROUP_DEFAULT_MAX);
+
+	noreset.SetParentDependency(&apply);
+	j.SetParentDependency(&tg);
 
 	m_cmdLineHandler.AddArgument(imp);
 	m_cmdLineHandler.AddArgument(exp);
+	m_cmdLineHandler.AddArgument(snap);
+	m_cmdLineHandler.AddArgument(diff);
+	m_cmdLineHandler.AddArgument(apply);
+	m_cmdLineHandler.AddArgument(noreset);
+	m_cmdLineHandler.AddArgument(tg);
+	m_cmdLineHandler.AddArgument(j);
 
 	m_cmdLineHandler.Parse(arguments);
 
@@ -45,11 +62,50 @@ bool SettingsCommand::ParseArgs(std::vector<std::string>& arguments)
 		m_strPath = exp.GetValue();
 		m_Mode = MODE_EXPORT;
 	}
+	else if (snap.IsPassed())
+	{
+		m_strPath = snap.GetValue();
+		m_Mode = MODE_SNAPSHOT;
+	}
+	else if (diff.IsPassed())
+	{
+		m_strPath = diff.GetValue();
+		m_Mode = MODE_DIFF;
+	}
+	else if (apply.IsPassed())
+	{
+		m_strPath = apply.GetValue();
+		m_Mode = MODE_APPLY;
+		m_bNoReset = noreset.IsSet();
+	}
 	else
 	{
 		m_Mode = MODE_NONE;
 	}
 
+	if ((m_Mode == MODE_SNAPSHOT || m_Mode == MODE_DIFF || m_Mode == MODE_APPLY) && m_strPath.empty())
+		throw ArgumentException("Error - You need to specify a directory for -snap, or a golden profile for -diff and -apply");
+
+	if (tg.IsPassed())
+	{
+		if (m_Mode != MODE_SNAPSHOT && m_Mode != MODE_DIFF && m_Mode != MODE_APPLY)
+			throw ArgumentException("Error - A target group can only be used with -snap, -diff or -apply");
+
+		m_targetGroup = tg.GetValue();
+		if (m_targetGroup.empty())
+			throw ArgumentException("Error - You need to specify the targets, or \"all\"");
+
+		if (j.IsPassed() && j.GetValue() == 0)
+			throw ArgumentException("Error - The number of targets in flight must be at least 1");
+
+		m_uMaxInFlight = j.GetValue();
+
+		// Each member is connected by its own worker.
+		m_bConnectToTarget = false;
+	}
+
+	m_cmdLineHandler.Reset();
+
 	return true;
 }
 
@@ -70,6 +126,13 @@ int SettingsCommand::Run()
 		if (!DoExport())
 			return GetErrorCodeOnError();
 		break;
+
+	case MODE_SNAPSHOT:
+	case MODE_DIFF:
+	case MODE_APPLY:
+		if (!DoGroupSettings())
+			return GetErrorCodeOnError();
+		break;
 	default:
 		DisplayUsageHelp();
 		return PS3CTRL_EXIT_ERROR;
@@ -107,23 +170,251 @@ bool SettingsCommand::DoExport()
 	SNRESULT snr;
 	if (SN_FAILED(snr = SNPS3ExportTargetSettings(m_targetId, m_strPath.c_str())))
 	{
-		PrintError(snr, L"Error importing settings file. Path supplied:%s\n", UTF8ToWChar(m_strPath).c_str());
+		PrintError(snr, L"Error exporting settings file. Path supplied:%s\n", UTF8ToWChar(m_strPath).c_str());
 		return false;
 	}
 
-	PrintMessage(ML_INFO, L"Settings imported from %s", UTF8ToWChar(m_strPath).c_str());
+	PrintMessage(ML_INFO, L"Settings exported to %s", UTF8ToWChar(m_strPath).c_str());
 
 	return true;
 }
 
+bool SettingsCommand::DoGroupSettings()
+{
+	std::wstring strPath = UTF8ToWChar(m_strPath);
+
+	if (m_Mode == MODE_SNAPSHOT)
+	{
+		DWORD dwAttributes = ::GetFileAttributesW(strPath.c_str());
+		if (dwAttributes == INVALID_FILE_ATTRIBUTES || !(dwAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			PrintMessage(ML_ERROR, L"Snapshot directory %s does not exist", strPath.c_str());
+			return false;
+		}
+	}
+	else
+	{
+		UINT32 uErrorLine = 0;
+		if (!LoadXmbProfile(strPath.c_str(), m_golden, uErrorLine))
+		{
+			if (uErrorLine)
+				PrintMessage(ML_ERROR, L"Line %u of golden profile %s is not key=value", uErrorLine, strPath.c_str());
+			else
+				PrintMessage(ML_ERROR, L"Could not read golden profile %s", strPath.c_str());
+			return false;
+		}
+	}
+
+	// Without a group, the target the common options picked is a group of one.
+	std::string strTargets = m_targetGroup;
+	if (strTargets.empty())
+	{
+		SNPS3TargetInfo ti = {};
+		ti.hTarget = m_targetId;
+		ti.nFlags = SN_TI_TARGETID;
+		SNRESULT snr;
+		if (SN_FAILED( snr = SNPS3GetTargetInfo(&ti) ))
+		{
+			PrintError(snr, L"Failed to get target info");
+			return false;
+		}
+		if (!ti.pszName)
+		{
+			PrintMessage(ML_ERROR, L"Target has no name to find it by\n");
+			return false;
+		}
+		strTargets = ti.pszName;
+	}
+
+	TargetGroup group;
+	if (!group.Resolve(strTargets))
+		return false;
+
+	m_targetSettings.clear();
+	for (size_t i = 0; i < group.GetCount(); ++i)
+		m_targetSettings[group.GetMember(i).strName].bReset = false;
+
+	if (group.GetCount() > 1)
+		PrintMessage(ML_INFO, L"Reading the XMB settings of %u targets, at most %u at a time. Press ESC to cancel.",
+			(UINT32)group.GetCount(), m_uMaxInFlight);
+
+	if (!group.Start(SettingsWork, this, m_uMaxInFlight))
+		return false;
+
+	bool bCancelled = false;
+	while (!group.Wait(100))
+	{
+		if (!bCancelled && CheckForEscape())
+		{
+			bCancelled = true;
+			group.Cancel();
+			PrintMessage(ML_WARN, L"Cancelled, waiting for the %u targets in flight to finish", group.GetInFlight());
+		}
+	}
+
+	group.PrintReport(m_Mode == MODE_SNAPSHOT ? L"Took snapshots of" : m_Mode == MODE_DIFF ? L"Checked" : L"Applied to");
+
+	if (m_Mode != MODE_SNAPSHOT)
+		PrintChanges(group);
+
+	bool bDiffers = false;
+	for (size_t i = 0; i < group.GetCount(); ++i)
+	{
+		const TargetGroupMember& member = group.GetMember(i);
+		if (member.result == TGR_FAILED)
+			SetExitCode(member.snr);
+		if (member.result == TGR_SUCCEEDED && m_Mode == MODE_DIFF && !m_targetSettings[member.strName].changes.empty())
+			bDiffers = true;
+	}
+
+	// Like diff, a check fails if anything differs, so a script can tell.
+	return !bDiffers && group.GetResultCount(TGR_FAILED) == 0 && group.GetResultCount(TGR_CANCELLED) == 0;
+}
+
+TargetGroupResult SettingsCommand::SettingsWork(void* pUser, TargetGroupMember& member)
+{
+	SettingsCommand* pThis = static_cast<SettingsCommand*>(pUser);
+
+	bool bWasConnected = false;
+	if (!TargetGroup::Connect(member, pThis->m_bForceDC, bWasConnected))
+		return TGR_FAILED;
+
+	TargetGroupResult result = pThis->SettingsOnTarget(member, pThis->m_targetSettings.find(member.strName)->second);
+
+	if (pThis->m_bAlwaysDC || (!bWasConnected && pThis->m_bDCifNotConnected))
+		SNPS3Disconnect(member.hTarget);
+
+	return result;
+}
+
+TargetGroupResult SettingsCommand::SettingsOnTarget(TargetGroupMember& member, TargetSettings& settings)
+{
+	// Straight from the target, as Target Manager's copy is only as recent as
+	// the last time something asked.
+	XmbSettingMap actual;
+	SNRESULT snr = GetXmbSettings(member.hTarget, true, actual);
+	if (SN_FAILED(snr))
+		return TargetGroup::Fail(member, snr, "Failed to read XMB settings");
+
+	char szDetail[MAX_PATH + 64];
+
+	if (m_Mode == MODE_SNAPSHOT)
+	{
+		std::string strFile = member.strName;
+		for (size_t i = 0; i < strFile.size(); ++i)
+		{
+			if (strchr("\\/:*?\"<>|", strFile[i]))
+				strFile[i] = '_';
+		}
+
+		std::string strPath = m_strPath + "\\" + strFile + ".xmb";
+		if (!SaveXmbProfile(UTF8ToWChar(strPath).c_str(), actual, member.strName))
+			return TargetGroup::Fail(member, SN_E_FILE_ERROR, "Failed to write snapshot");
+
+		sprintf_s(szDetail, _countof(szDetail), "%u keys to %s", (UINT32)actual.size(), strPath.c_str());
+		member.strDetail = szDetail;
+		return TGR_SUCCEEDED;
+	}
+
+	DiffXmbSettings(actual, m_golden, settings.changes);
+
+	UINT32 uNeedReset = 0;
+	for (size_t i = 0; i < settings.changes.size(); ++i)
+	{
+		if (settings.changes[i].bNeedsReset)
+			uNeedReset++;
+	}
+
+	if (settings.changes.empty())
+	{
+		member.strDetail = "Matches";
+		return m_Mode == MODE_APPLY ? TGR_SKIPPED : TGR_SUCCEEDED;
+	}
+
+	if (m_Mode == MODE_DIFF)
+	{
+		sprintf_s(szDetail, _countof(szDetail), "%u keys differ, %u needing a reset", (UINT32)settings.changes.size(), uNeedReset);
+		member.strDetail = szDetail;
+		return TGR_SUCCEEDED;
+	}
+
+	// Only the keys that differ are sent, with the version they are in.
+	XmbSettingMap wanted;
+	XmbSettingMap::const_iterator version = actual.find(XMB_SETTINGS_VERSION_KEY);
+	if (version != actual.end())
+		wanted[version->first] = version->second;
+
+	for (size_t i = 0; i < settings.changes.size(); ++i)
+	{
+		// The list is split at commas, and has no way of quoting them.
+		if (settings.changes[i].strWanted.find(',') != std::string::npos)
+		{
+			member.snr = SN_E_BAD_PARAM;
+			member.strDetail = "The value of " + settings.changes[i].strKey + " has a comma, which cannot be set";
+			return TGR_FAILED;
+		}
+		wanted[settings.changes[i].strKey] = settings.changes[i].strWanted;
+	}
+
+	settings.bReset = uNeedReset && !m_bNoReset;
+	if (SN_FAILED( snr = SNPS3SetXMBSettings(member.hTarget, FormatXmbSettings(wanted).c_str(), settings.bReset) ))
+		return TargetGroup::Fail(member, snr, "Failed to set XMB settings");
+
+	sprintf_s(szDetail, _countof(szDetail), "Set %u keys%s", (UINT32)settings.changes.size(),
+		settings.bReset ? ", reset" : uNeedReset ? ", a reset is needed for them to take effect" : "");
+	member.strDetail = szDetail;
+	return TGR_SUCCEEDED;
+}
+
+void SettingsCommand::PrintChanges(const TargetGroup& group) const
+{
+	// How many targets each key differs on, which for a farm says more than
+	// the targets one by one.
+	std::map<std::string, UINT32> keyCounts;
+
+	for (size_t i = 0; i < group.GetCount(); ++i)
+	{
+		const TargetGroupMember& member = group.GetMember(i);
+		if (member.result != TGR_SUCCEEDED)
+			continue;
+
+		const std::vector<XmbSettingChange>& changes = m_targetSettings.find(member.strName)->second.changes;
+		for (size_t j = 0; j < changes.size(); ++j)
+		{
+			const XmbSettingChange& change = changes[j];
+			PrintMessage(ML_INFO, L"  %-24s %s: %s -> %s%s", UTF8ToWChar(member.strName).c_str(), UTF8ToWChar(change.strKey).c_str(),
+				change.bMissing ? L"(missing)" : UTF8ToWChar(change.strActual).c_str(), UTF8ToWChar(change.strWanted).c_str(),
+				change.bNeedsReset ? L" (needs reset)" : L"");
+			keyCounts[change.strKey]++;
+		}
+	}
+
+	if (group.GetCount() < 2)
+		return;
+
+	for (std::map<std::string, UINT32>::const_iterator it = keyCounts.begin(); it != keyCounts.end(); ++it)
+	{
+		PrintMessage(ML_INFO, L"%s %s on %u of %u targets", UTF8ToWChar(it->first).c_str(),
+			m_Mode == MODE_DIFF ? L"differs" : L"was set", it->second, (UINT32)group.GetCount());
+	}
+}
+
 void SettingsCommand::DisplayUsageHelp() const
 {
-	std::cout << "The install-game command allows you to install a game." << std::endl << std::endl;
+	std::cout << "The settings command allows you to import, export and check target settings." << std::endl << std::endl;
 
 	std::cout << "Usage: PS3Ctrl settings <options>" << std::endl << std::endl;
 	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
 	std::cout << "  -i <filename>" << "\t" << "Imports the target settings from the file" << std::endl;
 	std::cout << "  -e <filename>" << "\t" << "Exports the target settings to the file" << std::endl;
+	std::cout << "  -snap <dir>" << "\t" << "Saves the XMB settings of each target to <dir>\\<target>.xmb" << std::endl;
+	std::cout << "  -diff <file>" << "\t" << "Shows the XMB settings that differ from a golden profile of key=value lines" << std::endl;
+	std::cout << "  -apply <file>" << "\t" << "Sets the XMB settings that differ from a golden profile, resetting only" << std::endl;
+	std::cout << "\t\t" << "targets where one of them needs a reset" << std::endl;
+	std::cout << "  -noreset" << "\t" << "With -apply, never reset" << std::endl;
+	std::cout << "  -tg <targets>" << "\t" << "With -snap, -diff or -apply, work on a group of targets at once:" << std::endl;
+	std::cout << "\t\t" << "comma separated names, or \"all\"" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "With -tg, the most targets in flight at once (default " << TARGET_GROUP_DEFAULT_MAX << ")" << std::endl;
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
@@ -9,7 +9,14 @@
 
 #include "TargetCommand.h"
 #include "SingleArgOption.h"
+#include "TargetGroup.h"
+#include "XmbSettings.h"
+#include <map>
 
+// Besides importing and exporting Target Manager's settings for a target,
+// works on the XMB settings of a group of targets at once: snapshots them to
+// profiles, checks them against a golden profile, or sets just the keys that
+// differ from it, resetting only targets where one of those needs a reset.
 class SettingsCommand : public TargetCommand
 {
 public:
@@ -21,10 +28,31 @@ public:
 protected:
 	bool			DoImport();
 	bool			DoExport();
+	bool			DoGroupSettings();
 	virtual void	DisplayUsageHelp() const;
 
 	std::string		m_strPath;
-	enum {MODE_NONE=0,MODE_IMPORT,MODE_EXPORT} m_Mode;
+	enum {MODE_NONE=0,MODE_IMPORT,MODE_EXPORT,MODE_SNAPSHOT,MODE_DIFF,MODE_APPLY} m_Mode;
+
+	std::string		m_targetGroup;
+	UINT32			m_uMaxInFlight;
+	bool			m_bNoReset;
+
+private:
+	struct TargetSettings
+	{
+		std::vector<XmbSettingChange>	changes;
+		bool							bReset;
+	};
+
+	static TargetGroupResult	SettingsWork(void* pUser, TargetGroupMember& member);
+	TargetGroupResult			SettingsOnTarget(TargetGroupMember& member, TargetSettings& settings);
+	void			PrintChanges(const TargetGroup& group) const;
+
+	XmbSettingMap	m_golden;
+	// An entry for each member is made before the group starts, so each
+	// worker only writes its own.
+	std::map<std::string, TargetSettings>	m_targetSettings;
 };
 
 TargetCommand* SettingsCommandFactory(void);
@@ -5,6 +5,38 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "SyncCommand.h"
+#include "RemoteDelete.h"
+#include "DeployPreflight.h"
+#include <algorithm>
+
+#define SYNC_DEFAULT_KEEP_BUILDS	(2)
+
+namespace
+{
+	bool NewestFirst(const std::pair<std::string, RemoteFileInfo>& a, const std::pair<std::string, RemoteFileInfo>& b)
+	{
+		return a.second.uModifiedTime > b.second.uModifiedTime;
+	}
+
+	double ToMegabytes(UINT64 uBytes)
+	{
+		return uBytes / (1024.0 * 1024.0);
+	}
+
+	void SplitList(const std::string& strList, std::vector<std::string>& items)
+	{
+		size_t uStart = 0;
+		while (uStart <= strList.size())
+		{
+			size_t uEnd = strList.find(',', uStart);
+			if (uEnd == std::string::npos)
+				uEnd = strList.size();
+			if (uEnd > uStart)
+				items.push_back(strList.substr(uStart, uEnd - uStart));
+			uStart = uEnd + 1;
+		}
+	}
+}
 
 TargetCommand* SyncCommandFactory(void)
 {
@@ -16,13 +48,20 @@ SyncCommand::SyncCommand()
 , m_bWaitForTransfers(false)
 , m_bForceSync(false)
 , m_Direction (TX_DIRECTION_UPLOAD)
+, m_pRemoteTree(NULL)
+, m_bPreflight(false)
+, m_uKeepBuilds(SYNC_DEFAULT_KEEP_BUILDS)
+, m_uMaxInFlight(REMOTE_TREE_DEFAULT_MAX)
+, m_bResume(false)
+, m_bRestart(false)
+, m_pDownload(NULL)
 {
 
 }
 
 SyncCommand::~SyncCommand()
 {
-
+	delete m_pRemoteTree;
 }
 
 bool SyncCommand::ParseArgs(std::vector<std::string>& arguments)
@@ -33,6 +72,13 @@ bool SyncCommand::ParseArgs(std::vector<std::string>& arguments)
 	StandardOption dl("dl", "download");
 	StandardOption fs("fs", "force-sync");
 	StandardOption wt("wt", "wait");
+	StandardOption pf("pf", "preflight");
+	SingleArgOption<std::string> pr("pr", "prune", "");
+	SingleArgOption<UINT32> k("k", "keep", SYNC_DEFAULT_KEEP_BUILDS);
+	SingleArgOption<UINT32> j("j", "jobs", REMOTE_TREE_DEFAULT_MAX);
+	StandardOption rs("rs", "resume");
+	StandardOption restart("restart", "restart");
+	SingleArgOption<std::string> pri("pri", "priority", "");
 
 	MultiArgOption<std::string> fl("fl","files", true);
 
@@ -41,6 +87,16 @@ bool SyncCommand::ParseArgs(std::vector<std::string>& arguments)
 	m_cmdLineHandler.AddArgument(dl);
 	m_cmdLineHandler.AddArgument(fs);
 	m_cmdLineHandler.AddArgument(wt);
+	m_cmdLineHandler.AddArgument(pf);
+	m_cmdLineHandler.AddArgument(pr);
+	m_cmdLineHandler.AddArgument(k);
+	m_cmdLineHandler.AddArgument(j);
+	m_cmdLineHandler.AddArgument(rs);
+	m_cmdLineHandler.AddArgument(restart);
+	m_cmdLineHandler.AddArgument(pri);
+	k.SetParentDependency(&pr);
+	restart.SetParentDependency(&rs);
+	pri.SetParentDependency(&rs);
 
 	m_cmdLineHandler.Parse(arguments);
 
@@ -50,6 +106,27 @@ bool SyncCommand::ParseArgs(std::vector<std::string>& arguments)
 
 	m_Direction = dl.IsSet()?TX_DIRECTION_DOWNLOAD:TX_DIRECTION_UPLOAD;
 
+	m_bPreflight = pf.IsSet();
+	m_strPruneDir = pr.GetValue();
+	m_uKeepBuilds = k.GetValue();
+	m_uMaxInFlight = j.GetValue();
+	m_bResume = rs.IsSet();
+	m_bRestart = restart.IsSet();
+	SplitList(pri.GetValue(), m_priorities);
+
+	if ((m_bPreflight || !m_strPruneDir.empty()) && m_Direction == TX_DIRECTION_DOWNLOAD)
+		throw ArgumentException("Error - Preflight and prune only apply to uploads");
+
+	if (m_bResume && m_Direction != TX_DIRECTION_DOWNLOAD)
+		throw ArgumentException("Error - Resume only applies to downloads");
+
+	// The files are queued as others finish, which needs the events.
+	if (m_bResume)
+		m_bWaitForTransfers = true;
+
+	if (m_uMaxInFlight == 0)
+		throw ArgumentException("Error - The number of target calls in flight must be at least 1");
+
 	std::vector<std::string>& remainingArgs = m_cmdLineHandler.GetRemainingArguments();
 
 	if (remainingArgs.size() > 1)
@@ -72,9 +149,20 @@ int SyncCommand::Run()
 	if (SN_FAILED(bRes))
 		return bRes;
 
+	m_pRemoteTree = new RemoteTreeCache(m_targetId);
+
 	// Determine the type of transfer
 	TransferType TxType = IdentifyTransferType();
 
+	// Pruning first leaves the room it makes to the preflight.
+	if (!m_strPruneDir.empty())
+		if (!PruneBuilds())
+			return GetErrorCodeOnError();
+
+	if (m_bPreflight)
+		if (!DoPreflight(TxType))
+			return GetErrorCodeOnError();
+
 	if (m_bWaitForTransfers)
 		if (!SetupFileEvents())
 			return GetErrorCodeOnError();
@@ -82,6 +170,12 @@ int SyncCommand::Run()
 	if (m_bForceSync)
 		PrintMessage(ML_INFO, L"Doing a force transfer\n");
 
+	if (m_bResume && TxType != TX_TYPE_DIRECTORY_TO_DIRECTORY)
+	{
+		PrintMessage(ML_ERROR, L"Resume needs a target directory and a local directory\n");
+		return PS3CTRL_EXIT_ERROR;
+	}
+
 	switch (TxType)
 	{
 	case TX_TYPE_UNKNOWN:
@@ -94,7 +188,7 @@ int SyncCommand::Run()
 		break;
 	case TX_TYPE_DIRECTORY_TO_DIRECTORY:
 		{
-			if (!PerformDirectoryToDirectory())
+			if (m_bResume ? !DoResumableDownload() : !PerformDirectoryToDirectory())
 				return GetErrorCodeOnError();
 		}
 		break;
@@ -106,6 +200,10 @@ int SyncCommand::Run()
 		break;
 	}
 
+	// What the uploads write is no longer known.
+	if (m_Direction == TX_DIRECTION_UPLOAD)
+		m_pRemoteTree->Invalidate(m_dstPath);
+
 	if (m_bWaitForTransfers)
 	{
 		// Go into event processing loop.
@@ -122,13 +220,13 @@ SyncCommand::TransferType SyncCommand::IdentifyTransferType()
 
 	if (m_Direction==TX_DIRECTION_DOWNLOAD)
 	{
-		SNPS3DirEntry Entry;
+		RemoteFileInfo Entry;
 		BOOL bSrcIsDir = FALSE;
 		BOOL bDstIsDir = FALSE;
 
-		if (SN_SUCCEEDED(SNPS3StatTargetFile(m_targetId, m_srcFiles[0].c_str(),&Entry)))
+		if (SN_SUCCEEDED(m_pRemoteTree->Stat(m_srcFiles[0], Entry)))
 		{
-			if (Entry.Mode & SNPS3_DIRENT_TYPE_DIRECTORY)
+			if (Entry.uType == SNPS3_DIRENT_TYPE_DIRECTORY)
 				bSrcIsDir = TRUE;
 		}
 		else
@@ -174,10 +272,10 @@ SyncCommand::TransferType SyncCommand::IdentifyTransferType()
 			}
 		}
 
-		SNPS3DirEntry Entry;
-		if (SN_SUCCEEDED( SNPS3StatTargetFile(m_targetId, m_dstPath.c_str(), &Entry) ))
+		RemoteFileInfo Entry;
+		if (SN_SUCCEEDED( m_pRemoteTree->Stat(m_dstPath, Entry) ))
 		{
-			if (Entry.Mode & SNPS3_DIRENT_TYPE_DIRECTORY)
+			if (Entry.uType == SNPS3_DIRENT_TYPE_DIRECTORY)
 				return TX_TYPE_FILE_TO_DIRECTORY;
 		}
 	}
@@ -309,6 +407,12 @@ void SyncCommand::ProcessTransferEvent(HTARGET hTarget, UINT uLength, BYTE* pDat
 
 	for (UINT i = 0 ; i < uCount ; ++i, ++pNotification)
 	{
+		if (m_pDownload)
+		{
+			m_pDownload->OnTransferEvent(*pNotification);
+			continue;
+		}
+
 		switch (pNotification->m_Type)
 		{
 		case TMAPI_FT_ERROR:
@@ -384,6 +488,248 @@ SNRESULT SyncCommand::ClearPendingMessages(void)
 	return snr;
 }
 
+bool SyncCommand::PruneBuilds()
+{
+	std::string strPruneDir = RemoteTreeCache::Normalize(m_strPruneDir);
+	std::string strDestination = RemoteTreeCache::Normalize(m_dstPath);
+
+	RemoteListing listing;
+	SNRESULT snr = m_pRemoteTree->List(strPruneDir, listing);
+	if (SN_FAILED(snr))
+	{
+		PrintError(snr, L"Cannot list %s on target", UTF8ToWChar(strPruneDir).c_str());
+		return false;
+	}
+
+	// Never the destination, nor a directory it is in.
+	RemoteListing builds;
+	for (size_t i = 0; i < listing.size(); ++i)
+	{
+		if (listing[i].second.uType != SNPS3_DIRENT_TYPE_DIRECTORY)
+			continue;
+
+		std::string strBuild = RemoteTreeCache::Join(strPruneDir, listing[i].first);
+		if (strDestination == strBuild || strDestination.compare(0, strBuild.size() + 1, strBuild + "/") == 0)
+			continue;
+
+		builds.push_back(listing[i]);
+	}
+
+	if (builds.size() <= m_uKeepBuilds)
+	{
+		PrintMessage(ML_INFO, L"Nothing to prune in %s\n", UTF8ToWChar(strPruneDir).c_str());
+		return true;
+	}
+
+	std::sort(builds.begin(), builds.end(), NewestFirst);
+
+	UINT32 uBlockSize = 0;
+	UINT64 uFreeBefore = 0;
+	UINT64 uFreeAfter = 0;
+	bool bFreeSpace = SN_SUCCEEDED(GetFileSystemFreeSpace(m_targetId, strPruneDir, uBlockSize, uFreeBefore));
+
+	RemoteDeleter deleter(*m_pRemoteTree, -1);
+	for (size_t i = m_uKeepBuilds; i < builds.size(); ++i)
+	{
+		std::string strBuild = RemoteTreeCache::Join(strPruneDir, builds[i].first);
+		PrintMessage(ML_INFO, L"Pruning %s\n", UTF8ToWChar(strBuild).c_str());
+		deleter.Add(strBuild);
+	}
+
+	if (m_uMaxInFlight > 1)
+		deleter.Split(m_uMaxInFlight);
+
+	if (!deleter.Start(m_uMaxInFlight))
+	{
+		PrintMessage(ML_ERROR, L"Failed to create worker threads\n");
+		return false;
+	}
+
+	while (!deleter.Wait(100))
+	{
+		if (!deleter.IsCancelled() && CheckForEscape())
+		{
+			deleter.Cancel();
+			PrintMessage(ML_WARN, L"Cancelled, waiting for the %u deletes in flight to finish\n", deleter.GetInFlight());
+		}
+	}
+
+	bool bOK = !deleter.IsCancelled();
+	for (size_t i = 0; i < deleter.GetCount(); ++i)
+	{
+		const RemoteDeleteItem& item = deleter.GetItem(i);
+		if (SN_FAILED(item.snr) && (item.bRequested || item.snr != SN_E_FILE_ERROR))
+		{
+			PrintError(item.snr, L"Failed to delete %s on target", UTF8ToWChar(item.strPath).c_str());
+			bOK = false;
+		}
+	}
+
+	PrintMessage(ML_INFO, L"Pruned %u of %u builds in %s with %u deletes in %.2fs\n", (UINT32)(builds.size() - m_uKeepBuilds),
+		(UINT32)builds.size(), UTF8ToWChar(strPruneDir).c_str(), (UINT32)deleter.GetCount(), deleter.GetElapsedMilliseconds() / 1000.0);
+
+	if (bFreeSpace && SN_SUCCEEDED(GetFileSystemFreeSpace(m_targetId, strPruneDir, uBlockSize, uFreeAfter)))
+		PrintMessage(ML_INFO, L"Reclaimed %.1f MB\n", ToMegabytes(uFreeAfter > uFreeBefore ? uFreeAfter - uFreeBefore : 0));
+
+	return bOK;
+}
+
+bool SyncCommand::DoPreflight(TransferType TxType)
+{
+	DeployPreflight preflight(*m_pRemoteTree);
+	bool bRead = true;
+
+	switch (TxType)
+	{
+	case TX_TYPE_FILE_TO_FILE:
+		bRead = preflight.AddFile(m_srcFiles[0], m_dstPath);
+		break;
+	case TX_TYPE_DIRECTORY_TO_DIRECTORY:
+		bRead = preflight.AddDirectory(m_srcFiles[0], m_dstPath);
+		break;
+	case TX_TYPE_FILE_TO_DIRECTORY:
+		{
+			StringIterator it = m_srcFiles.begin();
+			for (; it != m_srcFiles.end(); ++it)
+			{
+				if (!preflight.AddFile(*it, m_dstPath + "/" + GetFileNameWithExt(it->c_str())))
+					bRead = false;
+			}
+		}
+		break;
+	default:
+		return true;
+	}
+
+	if (!bRead)
+		PrintMessage(ML_WARN, L"Some of the files to upload could not be read and are not counted\n");
+
+	SNRESULT snr = preflight.Check(m_uMaxInFlight);
+	if (SN_FAILED(snr))
+	{
+		// SNPS3FSGetFreeSize() only supports some file systems.
+		PrintMessage(ML_WARN, L"Cannot get the free space of %s (%ld), skipping the preflight\n",
+			UTF8ToWChar(preflight.GetFileSystem()).c_str(), snr);
+		return true;
+	}
+
+	PrintMessage(ML_INFO, L"Preflight: %u files, %.1f MB, replacing %.1f MB; %.1f MB needed, %.1f MB free on %s\n",
+		preflight.GetFileCount(), ToMegabytes(preflight.GetSourceBytes()), ToMegabytes(preflight.GetReplacedBytes()),
+		ToMegabytes(preflight.GetRequiredBytes()), ToMegabytes(preflight.GetFreeBytes()), UTF8ToWChar(preflight.GetFileSystem()).c_str());
+
+	if (!preflight.HasRoom())
+	{
+		PrintMessage(ML_ERROR, L"Error - Not enough free space on %s for the upload\n", UTF8ToWChar(preflight.GetFileSystem()).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool SyncCommand::DoResumableDownload()
+{
+	DirectoryDownload download(*m_pRemoteTree, m_srcFiles[0], m_dstPath);
+
+	SNRESULT snr = download.Enumerate(m_uMaxInFlight);
+	if (SN_FAILED(snr))
+	{
+		if (download.GetFileCount() == 0)
+		{
+			PrintError(snr, L"Cannot list %s on target", UTF8ToWChar(m_srcFiles[0]).c_str());
+			return false;
+		}
+		PrintMessage(ML_WARN, L"Some directories under %s could not be listed and are not downloaded\n", UTF8ToWChar(m_srcFiles[0]).c_str());
+	}
+
+	if (!download.OpenJournal(m_bRestart))
+		PrintMessage(ML_WARN, L"Could not write download journal %s, an interrupted download will start again\n", download.GetJournalPath().c_str());
+
+	download.Prioritize(m_priorities);
+
+	UINT64 uRemaining = download.GetRemainingBytes();
+	PrintMessage(ML_INFO, L"%u files, %.1f MB; %u already downloaded, %.1f MB to go\n", (UINT32)download.GetFileCount(),
+		ToMegabytes(download.GetTotalBytes()), download.GetCount(DLS_JOURNALED), ToMegabytes(uRemaining));
+
+	// Files being replaced are counted as well, so this errs towards room.
+	ULARGE_INTEGER freeBytes;
+	if (::GetDiskFreeSpaceExW(UTF8ToWChar(m_dstPath).c_str(), &freeBytes, NULL, NULL) && freeBytes.QuadPart < uRemaining)
+	{
+		PrintMessage(ML_ERROR, L"Error - %.1f MB free on the host, not enough for the download\n", ToMegabytes(freeBytes.QuadPart));
+		return false;
+	}
+
+	PrintMessage(ML_INFO, L"Downloading with at most %u transfers in flight. Press ESC to cancel.\n", m_uMaxInFlight);
+
+	LARGE_INTEGER frequency, start, now;
+	::QueryPerformanceFrequency(&frequency);
+	::QueryPerformanceCounter(&start);
+	DWORD dwLastProgress = ::GetTickCount();
+
+	m_pDownload = &download;
+	snr = download.Pump(m_uMaxInFlight, m_bForceSync);
+	while (!download.IsFinished())
+	{
+		// Events are only delivered while kicking.
+		SNRESULT snrKick = ClearPendingMessages();
+		if (SN_FAILED(snrKick))
+		{
+			PrintError(snrKick, L"Lost contact with Target Manager");
+			break;
+		}
+
+		if (!download.IsCancelled() && CheckForEscape())
+		{
+			download.Cancel();
+			PrintMessage(ML_WARN, L"Cancelled, waiting for the %u transfers in flight to stop\n", download.GetInFlight());
+		}
+
+		SNRESULT snrPump = download.Pump(m_uMaxInFlight, m_bForceSync);
+		if (SN_SUCCEEDED(snr))
+			snr = snrPump;
+
+		if (::GetTickCount() - dwLastProgress >= 5000)
+		{
+			dwLastProgress = ::GetTickCount();
+			PrintDownloadProgress(download);
+		}
+
+		::Sleep(10);
+	}
+	m_pDownload = NULL;
+
+	::QueryPerformanceCounter(&now);
+	double dSeconds = (double)(now.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+	bool bOK = download.IsFinished() && download.GetCount(DLS_FAILED) == 0 && download.GetCount(DLS_CANCELLED) == 0;
+	for (size_t i = 0; i < download.GetFileCount(); ++i)
+	{
+		const DownloadFile& file = download.GetFile(i);
+		if (file.eState == DLS_FAILED)
+		{
+			if (SN_FAILED(file.snr))
+				PrintError(file.snr, L"Failed to download %s", UTF8ToWChar(file.strRelative).c_str());
+			else
+				PrintMessage(ML_ERROR, L"Failed to download %s after %u attempts\n", UTF8ToWChar(file.strRelative).c_str(), file.uAttempts);
+		}
+	}
+
+	PrintMessage(ML_INFO, L"Downloaded %u files, %.1f MB in %.1fs; %u unchanged, %u already downloaded, %u failed, %u cancelled\n",
+		download.GetCount(DLS_DONE), ToMegabytes(download.GetTransferredBytes()), dSeconds, download.GetCount(DLS_UNCHANGED),
+		download.GetCount(DLS_JOURNALED), download.GetCount(DLS_FAILED), download.GetCount(DLS_CANCELLED));
+
+	if (!bOK && SN_FAILED(snr))
+		SetExitCode(snr);
+
+	return bOK;
+}
+
+void SyncCommand::PrintDownloadProgress(const DirectoryDownload& download) const
+{
+	UINT32 uFinished = download.GetCount(DLS_DONE) + download.GetCount(DLS_UNCHANGED) + download.GetCount(DLS_JOURNALED);
+	PrintMessage(ML_INFO, L"%u of %u files, %.1f MB to go, %u in flight\n", uFinished, (UINT32)download.GetFileCount(),
+		ToMegabytes(download.GetRemainingBytes()), download.GetInFlight());
+}
+
 void SyncCommand::DisplayUsageHelp() const
 {
 	std::cout << "The sync command allows you to upload files to a target" << std::endl << std::endl;
@@ -393,6 +739,14 @@ void SyncCommand::DisplayUsageHelp() const
 	std::cout << "  -dl" << "\t\t" << "Download files. Default is upload if this flag not present." << std::endl;
 	std::cout << "  -fs" << "\t\t" << "Force synchronization (skip timestamp check)" << std::endl;
 	std::cout << "  -wt" << "\t\t" << "Wait for the transfers to complete" << std::endl;
+	std::cout << "  -pf" << "\t\t" << "Check there is room for an upload before starting it" << std::endl;
+	std::cout << "  -pr <dir>" << "\t" << "Delete all but the newest builds in <dir> before an upload" << std::endl;
+	std::cout << "  -k <count>" << "\t" << "Number of builds -pr keeps, besides the destination (default " << SYNC_DEFAULT_KEEP_BUILDS << ")" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "Number of target calls -pf, -pr and -rs have in flight at once (default " << REMOTE_TREE_DEFAULT_MAX << ")" << std::endl;
+	std::cout << "  -rs" << "\t\t" << "With -dl, download a directory file by file, keeping a journal in the" << std::endl;
+	std::cout << "\t\t" << "local directory so an interrupted download carries on where it stopped" << std::endl;
+	std::cout << "  -restart" << "\t" << "With -rs, ignore the journal and download everything" << std::endl;
+	std::cout << "  -pri <patterns>" << "\t" << "With -rs, comma separated file patterns to download first, e.g. *.log,core/*" << std::endl;
 	std::cout << std::endl;
 
 	DisplayCommonOptions();
@@ -9,6 +9,8 @@
 
 #include <queue>
 #include "TargetCommand.h"
+#include "RemoteTree.h"
+#include "DirectoryDownload.h"
 
 class SyncCommand : public TargetCommand
 {
@@ -44,6 +46,10 @@ protected:
 	void					CompleteTransfer(UINT id);
 	bool					ProcessEvents();
 	SNRESULT				ClearPendingMessages(void);
+	bool					PruneBuilds();
+	bool					DoPreflight(TransferType TxType);
+	bool					DoResumableDownload();
+	void					PrintDownloadProgress(const DirectoryDownload& download) const;
 	virtual void			DisplayUsageHelp() const;
 
 	std::vector<std::string>	m_srcFiles;
@@ -52,6 +58,15 @@ protected:
 	bool						m_bWaitForTransfers;
 	std::deque<UINT32>			m_PendingTransfers;
 	TransferDirection			m_Direction;
+	RemoteTreeCache*			m_pRemoteTree;
+	bool						m_bPreflight;
+	std::string					m_strPruneDir;
+	UINT32						m_uKeepBuilds;
+	UINT32						m_uMaxInFlight;
+	bool						m_bResume;
+	bool						m_bRestart;
+	std::vector<std::string>	m_priorities;
+	DirectoryDownload*			m_pDownload;		// While one is running
 };
 
 TargetCommand* SyncCommandFactory(void);
@@ -0,0 +1,492 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "TtyLogCommand.h"
+
+#define TTYLOG_FLUSH_INTERVAL_MS	(250)
+#define TTYLOG_DEFAULT_LIMIT		(1000)
+
+TargetCommand* TtyLogCommandFactory(void)
+{
+	return new TtyLogCommand();
+}
+
+TtyLogCommand::TtyLogCommand()
+: TargetCommand()
+, m_uMaxInFlight(TARGET_GROUP_DEFAULT_MAX)
+, m_uSegmentMB(TTY_DEFAULT_SEGMENT_BYTES / (1024 * 1024))
+, m_bQuiet(false)
+, m_uTimeout(0)
+, m_fFrom(0.0)
+, m_fUntil(-1.0)
+, m_uLimit(TTYLOG_DEFAULT_LIMIT)
+, m_bArchiveFailed(false)
+{
+
+}
+
+TtyLogCommand::~TtyLogCommand()
+{
+
+}
+
+bool TtyLogCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<std::string> tg("tg", "target-group", "");
+	SingleArgOption<UINT32> j("j", "jobs", TARGET_GROUP_DEFAULT_MAX);
+	SingleArgOption<std::string> o("o", "output", "");
+	SingleArgOption<UINT32> seg("seg", "segment-size", TTY_DEFAULT_SEGMENT_BYTES / (1024 * 1024));
+	StandardOption q("q", "quiet");
+	SingleArgOption<UINT32> to("to", "timeout", 0);
+	SingleArgOption<std::string> a("a", "archive", "");
+	SingleArgOption<std::string> query("query", "query", "");
+	SingleArgOption<std::string> find("find", "find", "");
+	SingleArgOption<double> from("from", "from", 0.0);
+	SingleArgOption<double> until("until", "until", 0.0);
+	SingleArgOption<std::string> stream("stream", "stream", "");
+	SingleArgOption<UINT32> limit("limit", "limit", TTYLOG_DEFAULT_LIMIT);
+
+	j.SetParentDependency(&tg);
+	seg.SetParentDependency(&o);
+	find.SetParentDependency(&query);
+	from.SetParentDependency(&query);
+	until.SetParentDependency(&query);
+	stream.SetParentDependency(&query);
+	limit.SetParentDependency(&query);
+
+	m_cmdLineHandler.AddArgument(tg);
+	m_cmdLineHandler.AddArgument(j);
+	m_cmdLineHandler.AddArgument(o);
+	m_cmdLineHandler.AddArgument(seg);
+	m_cmdLineHandler.AddArgument(q);
+	m_cmdLineHandler.AddArgument(to);
+	m_cmdLineHandler.AddArgument(a);
+	m_cmdLineHandler.AddArgument(query);
+	m_cmdLineHandler.AddArgument(find);
+	m_cmdLineHandler.AddArgument(from);
+	m_cmdLineHandler.AddArgument(until);
+	m_cmdLineHandler.AddArgument(stream);
+	m_cmdLineHandler.AddArgument(limit);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	if (query.IsPassed())
+	{
+		if (tg.IsPassed() || o.IsPassed() || q.IsSet() || to.IsPassed() || a.IsPassed())
+			throw ArgumentException("Error - -query cannot be used with -tg, -o, -q, -to or -a");
+
+		m_strQueryFile = query.GetValue();
+		if (m_strQueryFile.empty())
+			throw ArgumentException("Error - You need to specify an archive to query");
+
+		m_query.strText = find.GetValue();
+		m_query.strStream = stream.GetValue();
+		m_fFrom = from.GetValue();
+		m_fUntil = until.IsPassed() ? until.GetValue() : -1.0;
+		m_uLimit = limit.GetValue();
+
+		if (m_fFrom < 0.0 || (until.IsPassed() && m_fUntil < m_fFrom))
+			throw ArgumentException("Error - -from must not be negative, nor -until before it");
+
+		// The archive is read here, not from a target.
+		m_bConnectToTarget = false;
+		m_cmdLineHandler.Reset();
+		return true;
+	}
+
+	m_strDirectory = o.GetValue();
+	m_uSegmentMB = seg.GetValue();
+	m_bQuiet = q.IsSet();
+	m_uTimeout = to.GetValue();
+	m_strArchive = a.GetValue();
+
+	if (a.IsPassed() && m_strArchive.empty())
+		throw ArgumentException("Error - You need to specify a file to archive to");
+
+	if (seg.IsPassed() && m_uSegmentMB == 0)
+		throw ArgumentException("Error - The segment size must be at least 1 MB");
+
+	if (m_bQuiet && m_strDirectory.empty() && m_strArchive.empty())
+		throw ArgumentException("Error - With -q, you need to log with -o or archive with -a");
+
+	if (tg.IsPassed())
+	{
+		m_targetGroup = tg.GetValue();
+		if (m_targetGroup.empty())
+			throw ArgumentException("Error - You need to specify the targets, or \"all\"");
+
+		if (j.IsPassed() && j.GetValue() == 0)
+			throw ArgumentException("Error - The number of targets in flight must be at least 1");
+
+		m_uMaxInFlight = j.GetValue();
+
+		// Each member is connected by its own worker.
+		m_bConnectToTarget = false;
+	}
+
+	m_cmdLineHandler.Reset();
+
+	return true;
+}
+
+int TtyLogCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	if (!(m_strQueryFile.empty() ? DoTtyLog() : DoQuery()))
+		return GetErrorCodeOnError();
+
+	return m_exitCode;
+}
+
+bool TtyLogCommand::DoTtyLog()
+{
+	if (!m_strDirectory.empty() && !m_aggregator.SetStore(UTF8ToWChar(m_strDirectory), (UINT64)m_uSegmentMB * 1024 * 1024))
+	{
+		PrintMessage(ML_ERROR, L"Could not create log directory %s", UTF8ToWChar(m_strDirectory).c_str());
+		return false;
+	}
+
+	// Archived times are kept as they are, and shown from the same start as
+	// the live view.
+	if (!m_strArchive.empty() && !m_archive.Open(UTF8ToWChar(m_strArchive).c_str(), m_aggregator.GetStartTime()))
+	{
+		PrintMessage(ML_ERROR, L"Could not create archive %s", UTF8ToWChar(m_strArchive).c_str());
+		return false;
+	}
+
+	// Without a group, the target the common options picked is a group of one.
+	std::string strTargets = m_targetGroup;
+	if (strTargets.empty())
+	{
+		SNPS3TargetInfo ti = {};
+		ti.hTarget = m_targetId;
+		ti.nFlags = SN_TI_TARGETID;
+		SNRESULT snr;
+		if (SN_FAILED( snr = SNPS3GetTargetInfo(&ti) ))
+		{
+			PrintError(snr, L"Failed to get target info");
+			return false;
+		}
+		if (!ti.pszName)
+		{
+			PrintMessage(ML_ERROR, L"Target has no name to find it by\n");
+			return false;
+		}
+		strTargets = ti.pszName;
+	}
+
+	TargetGroup group;
+	if (!group.Resolve(strTargets))
+		return false;
+
+	m_targetStreams.clear();
+	for (size_t i = 0; i < group.GetCount(); ++i)
+		m_targetStreams[group.GetMember(i).strName].bWasConnected = false;
+
+	if (group.GetCount() > 1)
+		PrintMessage(ML_INFO, L"Connecting to %u targets, at most %u at a time. Press ESC to cancel.",
+			(UINT32)group.GetCount(), m_uMaxInFlight);
+
+	if (!group.Start(ConnectWork, this, m_uMaxInFlight))
+		return false;
+
+	bool bCancelled = false;
+	while (!group.Wait(100))
+	{
+		if (!bCancelled && CheckForEscape())
+		{
+			bCancelled = true;
+			group.Cancel();
+			PrintMessage(ML_WARN, L"Cancelled, waiting for the %u targets in flight to finish", group.GetInFlight());
+		}
+	}
+
+	if (group.GetCount() > 1 || group.GetResultCount(TGR_FAILED))
+		group.PrintReport(L"Connected to");
+
+	// The handlers are registered here rather than by the workers, so that
+	// every callback comes from this thread's SNPS3Kick().
+	std::vector<HTARGET> subscribed;
+	for (size_t i = 0; i < group.GetCount() && !bCancelled; ++i)
+	{
+		TargetGroupMember& member = group.GetMember(i);
+		if (member.result == TGR_FAILED)
+			SetExitCode(member.snr);
+		if (member.result != TGR_SUCCEEDED)
+			continue;
+
+		UINT32 uTarget = m_aggregator.AddTarget(member.hTarget, member.strName);
+		const std::vector<TTYSTREAM>& streams = m_targetStreams[member.strName].streams;
+		for (size_t j = 0; j < streams.size(); ++j)
+			m_aggregator.SetStreamName(uTarget, streams[j].nStreamIdx, streams[j].szName);
+
+		SNRESULT snr = m_aggregator.Subscribe(uTarget);
+		if (SN_FAILED(snr))
+		{
+			PrintError(snr, L"Failed to register for the TTY of %s", UTF8ToWChar(member.strName).c_str());
+			SetExitCode(snr);
+			continue;
+		}
+		subscribed.push_back(member.hTarget);
+	}
+
+	bool bOK = !subscribed.empty();
+	if (bOK)
+		bOK = Listen();
+	else if (!bCancelled)
+		PrintMessage(ML_ERROR, L"No target to listen to");
+
+	for (UINT32 i = 0; i < m_aggregator.GetTargetCount(); ++i)
+		m_aggregator.Unsubscribe(i);
+
+	// Lines cut off when listening stopped are still logged and shown.
+	std::vector<TtyRecord> records;
+	m_aggregator.Flush(true);
+	m_aggregator.Merge(records);
+	if (!m_bQuiet)
+		PrintRecords(records);
+	if (!Archive(records))
+		bOK = false;
+	if (m_archive.IsOpen() && !m_archive.Close() && !m_bArchiveFailed)
+	{
+		PrintMessage(ML_ERROR, L"Failed to finish archive %s", UTF8ToWChar(m_strArchive).c_str());
+		bOK = false;
+	}
+
+	for (size_t i = 0; i < group.GetCount(); ++i)
+	{
+		const TargetGroupMember& member = group.GetMember(i);
+		if (member.result == TGR_SUCCEEDED && (m_bAlwaysDC || (!m_targetStreams[member.strName].bWasConnected && m_bDCifNotConnected)))
+			SNPS3Disconnect(member.hTarget);
+	}
+
+	if (!subscribed.empty())
+	{
+		PrintMessage(ML_INFO, L"Received %I64u lines (%I64u bytes) from %u targets", m_aggregator.GetLineCount(),
+			m_aggregator.GetByteCount(), (UINT32)subscribed.size());
+		if (!m_strDirectory.empty())
+			PrintMessage(ML_INFO, L"Logged %I64u bytes to %s", m_aggregator.GetLoggedBytes(), UTF8ToWChar(m_strDirectory).c_str());
+		if (!m_strArchive.empty())
+			PrintMessage(ML_INFO, L"Archived %I64u lines, %I64u bytes of them in %I64u, to %s", m_archive.GetLineCount(),
+				m_archive.GetRawBytes(), m_archive.GetBytesWritten(), UTF8ToWChar(m_strArchive).c_str());
+	}
+
+	if (m_aggregator.GetStoreErrors())
+	{
+		PrintMessage(ML_ERROR, L"%u lines could not be logged", m_aggregator.GetStoreErrors());
+		bOK = false;
+	}
+
+	return bOK && group.GetResultCount(TGR_FAILED) == 0 && group.GetResultCount(TGR_CANCELLED) == 0;
+}
+
+TargetGroupResult TtyLogCommand::ConnectWork(void* pUser, TargetGroupMember& member)
+{
+	TtyLogCommand* pThis = static_cast<TtyLogCommand*>(pUser);
+	TargetStreams& target = pThis->m_targetStreams.find(member.strName)->second;
+
+	bool bWasConnected = false;
+	if (!TargetGroup::Connect(member, pThis->m_bForceDC, bWasConnected))
+		return TGR_FAILED;
+	target.bWasConnected = bWasConnected;
+
+	UINT32 uStreams = 0;
+	SNRESULT snr = SNPS3ListTTYStreams(member.hTarget, &uStreams, NULL);
+	if (SN_SUCCEEDED(snr) && uStreams)
+	{
+		target.streams.resize(uStreams);
+		snr = SNPS3ListTTYStreams(member.hTarget, &uStreams, &target.streams[0]);
+		target.streams.resize(uStreams);
+	}
+
+	if (SN_FAILED(snr))
+	{
+		if (pThis->m_bAlwaysDC || (!bWasConnected && pThis->m_bDCifNotConnected))
+			SNPS3Disconnect(member.hTarget);
+		return TargetGroup::Fail(member, snr, "Failed to list TTY streams");
+	}
+
+	char szDetail[64];
+	sprintf_s(szDetail, _countof(szDetail), "%u TTY streams", uStreams);
+	member.strDetail = szDetail;
+	return TGR_SUCCEEDED;
+}
+
+bool TtyLogCommand::Listen()
+{
+	PrintMessage(ML_INFO, L"Listening for TTY%s, press ESC to stop...", m_strDirectory.empty() ? L"" : L" and logging it");
+
+	DWORD dwStart = ::GetTickCount();
+	DWORD dwLastFlush = dwStart;
+	std::vector<TtyRecord> records;
+
+	for (;;)
+	{
+		SNRESULT snr;
+		while ((snr = SNPS3Kick()) == SN_S_OK)
+			/* Do nothing */;
+
+		if (SN_FAILED(snr))
+		{
+			PrintError(snr, L"Failed to process TTY events");
+			return false;
+		}
+
+		DWORD dwNow = ::GetTickCount();
+		bool bFlush = dwNow - dwLastFlush >= TTYLOG_FLUSH_INTERVAL_MS;
+		if (bFlush)
+		{
+			m_aggregator.Flush(false);
+			dwLastFlush = dwNow;
+		}
+
+		records.clear();
+		m_aggregator.Merge(records);
+		if (!m_bQuiet)
+			PrintRecords(records);
+
+		if (!Archive(records) || (bFlush && m_archive.IsOpen() && !m_bArchiveFailed && !m_archive.Flush(false)))
+		{
+			if (!m_bArchiveFailed)
+				PrintMessage(ML_ERROR, L"Failed to write archive %s", UTF8ToWChar(m_strArchive).c_str());
+			m_bArchiveFailed = true;
+			return false;
+		}
+
+		if (CheckForEscape())
+			break;
+
+		if (m_uTimeout && dwNow - dwStart >= m_uTimeout * 1000)
+		{
+			PrintMessage(ML_INFO, L"Stopped listening after %u seconds", m_uTimeout);
+			break;
+		}
+
+		::Sleep(10);
+	}
+
+	return true;
+}
+
+void TtyLogCommand::PrintRecords(const std::vector<TtyRecord>& records) const
+{
+	if (records.empty())
+		return;
+
+	UINT64 uStartTime = m_aggregator.GetStartTime();
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const TtyRecord& record = records[i];
+		printf("[+%9.3f] %s/%s: %s\n", (record.uTime - uStartTime) / 1000000.0, m_aggregator.GetTargetName(record.uTarget).c_str(),
+			m_aggregator.GetStreamName(record.uTarget, record.uStream).c_str(), record.strText.c_str());
+	}
+
+	fflush(stdout);
+}
+
+bool TtyLogCommand::Archive(const std::vector<TtyRecord>& records)
+{
+	if (!m_archive.IsOpen() || m_bArchiveFailed)
+		return !m_bArchiveFailed;
+
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const TtyRecord& record = records[i];
+
+		UINT64 uKey = ((UINT64)record.uTarget << 32) | record.uStream;
+		std::map<UINT64, UINT32>::iterator it = m_archiveStreams.find(uKey);
+		if (it == m_archiveStreams.end())
+		{
+			std::string strName = m_aggregator.GetTargetName(record.uTarget) + "/" + m_aggregator.GetStreamName(record.uTarget, record.uStream);
+			it = m_archiveStreams.insert(std::make_pair(uKey, m_archive.AddStream(strName))).first;
+		}
+
+		if (!m_archive.Write(it->second, record.uTime, record.strText))
+		{
+			m_bArchiveFailed = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TtyLogCommand::DoQuery()
+{
+	TtyArchiveReader reader;
+	if (!reader.Open(UTF8ToWChar(m_strQueryFile).c_str()))
+	{
+		PrintMessage(ML_ERROR, L"%s is not a TTY archive", UTF8ToWChar(m_strQueryFile).c_str());
+		return false;
+	}
+
+	if (!reader.IsClosed())
+		PrintMessage(ML_WARN, L"Archive was not closed cleanly, searching the blocks that were written");
+
+	UINT64 uStartTime = reader.GetHeader().uStartTime;
+	m_query.uFrom = uStartTime + (UINT64)(m_fFrom * 1000000.0);
+	if (m_fUntil >= 0.0)
+		m_query.uUntil = uStartTime + (UINT64)(m_fUntil * 1000000.0);
+
+	LARGE_INTEGER freq, start, end;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+
+	std::vector<TtyArchiveLine> lines;
+	reader.Query(m_query, m_uLimit, lines);
+
+	QueryPerformanceCounter(&end);
+
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		printf("[+%9.3f] %s: %s\n", (lines[i].uTime - uStartTime) / 1000000.0, reader.GetStreamName(lines[i].uStream).c_str(),
+			lines[i].strText.c_str());
+	}
+	fflush(stdout);
+
+	PrintMessage(ML_INFO, L"Matched %u lines in %.2fms, decompressing %I64u of the %I64u blocks in range of %I64u",
+		(UINT32)lines.size(), (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart,
+		reader.GetDecompressedBlocks(), reader.GetCandidateBlocks(), reader.GetBlockCount());
+
+	if (reader.IsCorrupt())
+		PrintMessage(ML_WARN, L"Archive is damaged, only the readable blocks were searched");
+
+	return true;
+}
+
+void TtyLogCommand::DisplayUsageHelp() const
+{
+	std::cout << "The ttylog command listens to every TTY stream of one or more targets at once." << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl ttylog <options>" << std::endl << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -tg <targets>" << "\t" << "Listen to a group of targets: comma separated names, or \"all\"" << std::endl;
+	std::cout << "  -j <count>" << "\t" << "With -tg, the most targets connected at once (default " << TARGET_GROUP_DEFAULT_MAX << ")" << std::endl;
+	std::cout << "  -o <dir>" << "\t" << "Logs each stream to <dir>\\<target>\\<stream>.<segment>.log, with a time" << std::endl;
+	std::cout << "\t\t" << "index of it in <stream>.<segment>.idx" << std::endl;
+	std::cout << "  -seg <MB>" << "\t" << "With -o, the size at which a new segment is started (default "
+		<< TTY_DEFAULT_SEGMENT_BYTES / (1024 * 1024) << ")" << std::endl;
+	std::cout << "  -q" << "\t\t" << "With -o or -a, only log, without showing the TTY" << std::endl;
+	std::cout << "  -to <seconds>" << "\t" << "Stops listening after this long" << std::endl;
+	std::cout << "  -a <file>" << "\t" << "Archives the TTY to a compressed, indexed file" << std::endl;
+	std::cout << "  -query <file>" << "\t" << "Shows lines from an archive, without connecting to a target:" << std::endl;
+	std::cout << "  -find <text>" << "\t" << "  containing the text, which is case sensitive" << std::endl;
+	std::cout << "  -from <seconds>" << "\t" << "  from this long after the archive started" << std::endl;
+	std::cout << "  -until <seconds>" << "\t" << "  until this long after it started" << std::endl;
+	std::cout << "  -stream <name>" << "\t" << "  of a stream, as <target>/<stream> or just <stream>" << std::endl;
+	std::cout << "  -limit <count>" << "\t" << "  at most this many, the earliest (default " << TTYLOG_DEFAULT_LIMIT << ")" << std::endl;
+	std::cout << std::endl;
+	std::cout << "  The TTY of all the streams is shown in the order it was received, each" << std::endl;
+	std::cout << "  line with the seconds since listening started, its target and its stream." << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
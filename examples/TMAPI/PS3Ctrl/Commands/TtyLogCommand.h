@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TTY_LOG_COMMAND_H
+#define TTY_LOG_COMMAND_H
+
+#include "TargetCommand.h"
+#include "SingleArgOption.h"
+#include "TargetGroup.h"
+#include "TtyAggregator.h"
+#include "TtyArchive.h"
+#include <map>
+
+// Listens to every TTY stream of a group of targets at once, logging each
+// target's streams to their own files and showing all of them as one view
+// in time order. The TTY can also be archived, and the archive searched by
+// time, stream and text afterwards.
+class TtyLogCommand : public TargetCommand
+{
+public:
+					TtyLogCommand();
+	virtual			~TtyLogCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	bool			DoTtyLog();
+	bool			DoQuery();
+	bool			Listen();
+	void			PrintRecords(const std::vector<TtyRecord>& records) const;
+	bool			Archive(const std::vector<TtyRecord>& records);
+	virtual void	DisplayUsageHelp() const;
+
+	std::string		m_targetGroup;
+	UINT32			m_uMaxInFlight;
+	std::string		m_strDirectory;
+	UINT32			m_uSegmentMB;
+	bool			m_bQuiet;
+	UINT32			m_uTimeout;			// Seconds to listen for, 0 for no limit
+	std::string		m_strArchive;
+
+	std::string		m_strQueryFile;
+	TtyArchiveQuery	m_query;
+	double			m_fFrom;			// Seconds since the archive started
+	double			m_fUntil;			// Negative for no limit
+	UINT32			m_uLimit;
+
+private:
+	struct TargetStreams
+	{
+		std::vector<TTYSTREAM>	streams;
+		bool					bWasConnected;
+	};
+
+	static TargetGroupResult	ConnectWork(void* pUser, TargetGroupMember& member);
+
+	TtyAggregator				m_aggregator;
+	TtyArchiveWriter			m_archive;
+	std::map<UINT64, UINT32>	m_archiveStreams;	// Archive stream of each target and stream
+	bool						m_bArchiveFailed;
+	// An entry for each member is made before the group starts, so each
+	// worker only writes its own.
+	std::map<std::string, TargetStreams>	m_targetStreams;
+};
+
+TargetCommand* TtyLogCommandFactory(void);
+
+#endif
\ No newline at end of file
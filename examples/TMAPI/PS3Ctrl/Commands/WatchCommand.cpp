@@ -0,0 +1,356 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "WatchCommand.h"
+
+TargetCommand* WatchCommandFactory(void)
+{
+	return new WatchCommand();
+}
+
+WatchCommand::WatchCommand()
+: DebugEventCommand()
+, m_uRotate(0)
+, m_uMatPages(0)
+, m_pMat(NULL)
+, m_pMux(NULL)
+, m_uHits(0)
+, m_uStrayHits(0)
+, m_dwRotated(0)
+{
+
+}
+
+WatchCommand::~WatchCommand()
+{
+	delete m_pMux;
+	delete m_pMat;
+}
+
+bool WatchCommand::ParseArgs(std::vector<std::string>& arguments)
+{
+	if (!TargetCommand::ParseArgs(arguments))
+		return false;
+
+	SingleArgOption<UINT32> pid("pid", "process-id", INVALID_PROCESS, true);
+	SingleArgOption<std::string> f("f", "file", "");
+	StandardOption c("c", "continue");
+	SingleArgOption<UINT32> to("to", "timeout", 0);
+	SingleArgOption<UINT32> r("r", "rotate", 0);
+	SingleArgOption<UINT32> mp("mp", "mat-pages", 0);
+	mp.SetParentDependency(&r);
+
+	m_cmdLineHandler.AddArgument(pid);
+	m_cmdLineHandler.AddArgument(f);
+	m_cmdLineHandler.AddArgument(c);
+	m_cmdLineHandler.AddArgument(to);
+	m_cmdLineHandler.AddArgument(r);
+	m_cmdLineHandler.AddArgument(mp);
+
+	m_cmdLineHandler.Parse(arguments);
+
+	m_processId = pid.GetValue();
+	m_bContinue = c.IsSet();
+	m_uTimeout = to.GetValue();
+	m_uRotate = r.GetValue();
+	m_uMatPages = mp.GetValue();
+
+	if (r.IsPassed() && m_uRotate == 0)
+		throw ArgumentException("Error - The rotation period must be at least 1 millisecond");
+
+	AddSpecs(f.GetValue(), m_cmdLineHandler.GetRemainingArguments(), "watch", "<address>:<size>[:w|rw[:<owner>]]");
+
+	if (m_specs.empty())
+		throw ArgumentException("Error - No watches specified");
+
+	return true;
+}
+
+int WatchCommand::Run()
+{
+	int bRes = TargetCommand::Run();
+	if (SN_FAILED(bRes))
+		return bRes;
+
+	m_pMat = new MatWatchManager(m_targetId, m_processId);
+
+	SNRESULT snr = m_pMat->Init();
+	if (SN_FAILED(snr) || m_pMat->GetRangeCount() == 0)
+	{
+		if (!m_uRotate)
+		{
+			PrintError(snr, L"Failed to get memory access trap ranges, the process must be loaded with SNPS3_XLF_ENABLE_MAT");
+			return GetErrorCodeOnError();
+		}
+
+		PrintMessage(ML_WARN, L"Memory access traps are not available, watching with the DABR alone\n");
+		delete m_pMat;
+		m_pMat = NULL;
+	}
+
+	m_pMux = new DabrMultiplexer(m_targetId, m_processId, m_pMat, m_uRotate != 0, m_uMatPages);
+
+	if (!RegisterHandler())
+		return GetErrorCodeOnError();
+
+	bool bOk = AddWatches() && WatchForHits();
+
+	// Gives the pages back the conditions they had, and clears the DABR.
+	m_pMux->RemoveAll(GetTickCount());
+	if (SN_FAILED(snr = m_pMux->Rotate(GetTickCount())))
+	{
+		PrintError(snr, L"Failed to clear watches");
+		bOk = false;
+	}
+
+	UnRegisterHandler();
+
+	if (!bOk)
+		return GetErrorCodeOnError();
+
+	return bRes;
+}
+
+bool WatchCommand::ParseWatch(const std::string& strSpec, WatchSpec& spec) const
+{
+	// <address>:<size>[:w|rw[:<owner>]]
+	std::string fields[4];
+	size_t uFields = 0;
+	size_t uStart = 0;
+	while (uFields < _countof(fields))
+	{
+		size_t uColon = uFields < _countof(fields) - 1 ? strSpec.find(':', uStart) : std::string::npos;
+		fields[uFields++] = strSpec.substr(uStart, uColon == std::string::npos ? std::string::npos : uColon - uStart);
+		if (uColon == std::string::npos)
+			break;
+		uStart = uColon + 1;
+	}
+
+	if (uFields < 2 || fields[0].empty() || fields[1].empty())
+		return false;
+
+	char* pEnd = NULL;
+	spec.uAddress = strtoul(fields[0].c_str(), &pEnd, 0);
+	if (*pEnd)
+		return false;
+	spec.uSize = strtoul(fields[1].c_str(), &pEnd, 0);
+	if (*pEnd || spec.uSize == 0)
+		return false;
+
+	if (fields[2].empty() || fields[2] == "w")
+		spec.uCondition = SNPS3_MAT_COND_WRITE;
+	else if (fields[2] == "rw")
+		spec.uCondition = SNPS3_MAT_COND_READ_WRITE;
+	else
+		return false;
+
+	spec.strOwner = fields[3].empty() ? strSpec : fields[3];
+	return true;
+}
+
+bool WatchCommand::AddSpec(const std::string& strSpec)
+{
+	WatchSpec spec;
+	if (!ParseWatch(strSpec, spec))
+		return false;
+
+	m_specs.push_back(spec);
+	return true;
+}
+
+bool WatchCommand::AddWatches()
+{
+	bool bOk = true;
+	for (size_t i = 0; i < m_specs.size(); ++i)
+	{
+		const WatchSpec& spec = m_specs[i];
+		if (!m_pMux->Add(spec.uAddress, spec.uSize, spec.uCondition, spec.strOwner, GetTickCount()))
+		{
+			PrintMessage(ML_ERROR, L"Cannot watch 0x%08x+0x%x for %s, it is not in a range memory access traps can be set in%s\n",
+				spec.uAddress, spec.uSize, UTF8ToWChar(spec.strOwner).c_str(), m_uRotate ? L" nor within a doubleword for the DABR" : L"");
+			bOk = false;
+		}
+	}
+
+	if (!bOk)
+		return false;
+
+	SNRESULT snr;
+	if (SN_FAILED(snr = m_pMux->Rotate(GetTickCount())))
+	{
+		PrintError(snr, L"Failed to set watches");
+		return false;
+	}
+
+	if (m_pMat)
+	{
+		PrintMessage(ML_INFO, L"%u watches on %u pages, set with %u ranges of %u pages\n", m_pMat->GetWatchCount(),
+			m_pMat->GetPageCount(), m_pMat->GetAppliedRanges(), m_pMat->GetAppliedPages());
+	}
+
+	if (m_uRotate)
+	{
+		PrintMessage(ML_INFO, L"%u watches, %u with the DABR and %u with memory access traps at a time, the DABR moving every %ums\n",
+			m_pMux->GetWatchCount(), m_pMux->GetDabrWatch() ? 1 : 0, m_pMux->GetMatArmedCount(), m_uRotate);
+	}
+	return true;
+}
+
+bool WatchCommand::WatchForHits()
+{
+	PrintMessage(ML_INFO, L"Watching process 0x%x, press ESC to stop...\n", m_processId);
+
+	m_dwRotated = GetTickCount();
+	PumpEvents();
+
+	PrintMessage(ML_INFO, L"%u hits, %u of them outside any watch\n", m_uHits, m_uStrayHits);
+
+	std::map<std::string, UINT32>::const_iterator it = m_hitCounts.begin();
+	for (; it != m_hitCounts.end(); ++it)
+		PrintMessage(ML_INFO, L"  %6u  %s\n", it->second, UTF8ToWChar(it->first).c_str());
+
+	if (m_uRotate)
+	{
+		// The share of the time each watch could have caught an access.
+		PrintMessage(ML_INFO, L"Coverage:    DABR     MAT   total\n");
+
+		DWORD dwNow = GetTickCount();
+		std::vector<UINT32> ids;
+		m_pMux->GetWatchIds(ids);
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			double dDabr, dMat;
+			m_pMux->GetCoverage(ids[i], dwNow, dDabr, dMat);
+			PrintMessage(ML_INFO, L"          %5.1f%%  %5.1f%%  %5.1f%%  %s\n", dDabr * 100.0, dMat * 100.0, (dDabr + dMat) * 100.0,
+				UTF8ToWChar(m_pMux->GetWatch(ids[i])->strOwner).c_str());
+		}
+	}
+
+	return true;
+}
+
+void WatchCommand::ReportHit(const TrapHit& hit)
+{
+	bool bStore = (hit.uDSISR & MAT_DSISR_STORE) != 0;
+	std::vector<UINT32> hits;
+	if (!hit.bDabr)
+		m_pMux->FindMatHits(hit.uDAR, bStore, hits);
+	else if (m_pMux->GetWatch(m_pMux->GetDabrWatch()))
+		hits.push_back(m_pMux->GetDabrWatch());
+
+	m_uHits++;
+	if (hits.empty())
+		m_uStrayHits++;
+
+	WCHAR buf[512];
+	if (hit.bDabr)
+		swprintf(buf, _countof(buf), L"dabr  thread 0x%I64x pc 0x%08I64x:", hit.uThreadId, hit.uPC);
+	else
+		swprintf(buf, _countof(buf), L"%s 0x%08I64x thread 0x%I64x pc 0x%08I64x:", bStore ? L"store" : L"load ", hit.uDAR, hit.uThreadId, hit.uPC);
+	std::wcout << buf;
+
+	if (hits.empty())
+		std::wcout << L" not in a watch";
+
+	for (size_t i = 0; i < hits.size(); ++i)
+	{
+		const LogicalWatch* pWatch = m_pMux->GetWatch(hits[i]);
+		swprintf(buf, _countof(buf), L" %s [0x%08x+0x%x]", UTF8ToWChar(pWatch->strOwner).c_str(), pWatch->uAddress, pWatch->uSize);
+		std::wcout << buf;
+
+		m_hitCounts[pWatch->strOwner]++;
+	}
+	std::wcout << std::endl;
+
+	if (!m_bContinue)
+		return;
+
+	// The access traps again for as long as its page is trapped or the DABR
+	// is set for it, so the watches that caught it are disarmed to let the
+	// thread past; while rotating they are armed again in a later turn.
+	std::vector<UINT32> watches = hits;
+	if (!hit.bDabr)
+	{
+		watches.clear();
+		m_pMux->GetMatPageWatches(hit.uDAR, watches);
+	}
+
+	SNRESULT snr = SN_S_OK;
+	for (size_t i = 0; i < watches.size() && SN_SUCCEEDED(snr); ++i)
+	{
+		PrintMessage(ML_INFO, L"Disarmed %s\n", UTF8ToWChar(m_pMux->GetWatch(watches[i])->strOwner).c_str());
+		snr = m_pMux->Disarm(watches[i], GetTickCount());
+	}
+
+	if (SN_FAILED(snr))
+		PrintError(snr, L"Failed to disarm watches");
+	else if (SN_FAILED(snr = SNPS3ThreadContinue(m_targetId, PS3_UI_CPU, m_processId, hit.uThreadId)))
+		PrintError(snr, L"Failed to continue thread 0x%I64x", hit.uThreadId);
+}
+
+void WatchCommand::OnDebugEvent(const SNPS3_DBG_EVENT_DATA& data)
+{
+	if (data.uEventType == SNPS3_DBG_EVENT_PPU_EXC_DATA_MAT)
+	{
+		TrapHit hit;
+		hit.uThreadId = data.ppu_exc_data_mat.uPPUThreadID;
+		hit.uPC = data.ppu_exc_data_mat.uPC;
+		hit.uDAR = data.ppu_exc_data_mat.uDAR;
+		hit.uDSISR = data.ppu_exc_data_mat.uDSISR;
+		hit.bDabr = false;
+		m_pending.push_back(hit);
+	}
+	else if (data.uEventType == SNPS3_DBG_EVENT_PPU_EXP_DABR_MATCH)
+	{
+		TrapHit hit;
+		hit.uThreadId = data.ppu_exc_dabr_match.uPPUThreadID;
+		hit.uPC = data.ppu_exc_dabr_match.uPC;
+		hit.uDAR = 0;
+		hit.uDSISR = 0;
+		hit.bDabr = true;
+		m_pending.push_back(hit);
+	}
+}
+
+void WatchCommand::HandleEvents()
+{
+	for (size_t i = 0; i < m_pending.size(); ++i)
+		ReportHit(m_pending[i]);
+	m_pending.clear();
+}
+
+void WatchCommand::OnIdle()
+{
+	if (!m_uRotate || GetTickCount() - m_dwRotated < m_uRotate)
+		return;
+
+	m_dwRotated = GetTickCount();
+
+	SNRESULT snr;
+	if (SN_FAILED(snr = m_pMux->Rotate(m_dwRotated)))
+		PrintError(snr, L"Failed to rotate watches");
+}
+
+void WatchCommand::DisplayUsageHelp() const
+{
+	std::cout << "The watch command traps accesses to ranges of a process's memory and reports who asked for them" << std::endl << std::endl;
+
+	std::cout << "Usage: PS3Ctrl watch <options> -pid <process id> [<watch1> [<watch2> [...]]]" << std::endl << std::endl;
+	std::cout << "  Where each <watch> is <address>:<size>[:w|rw[:<owner>]]; w traps stores, rw loads as well" << std::endl;
+	std::cout << "  Where <options> are the following:" << std::endl << std::endl;
+	std::cout << "  -f <file>" << "\t" << "Read watches from <file>, one a line" << std::endl;
+	std::cout << "  -c" << "\t\t" << "Continue threads that hit a watch, dropping the watches on the page hit" << std::endl;
+	std::cout << "  -to <secs>" << "\t" << "Stop watching after <secs> seconds" << std::endl;
+	std::cout << "  -r <ms>" << "\t" << "Move the data address breakpoint between watches every <ms> milliseconds," << std::endl;
+	std::cout << "\t\t" << "giving it to the least covered; the rest use memory access traps" << std::endl;
+	std::cout << "  -mp <pages>" << "\t" << "With -r, trap at most <pages> pages at a time; watches left over wait for a turn" << std::endl;
+	std::cout << std::endl;
+	std::cout << "  The process must be loaded with the SNPS3_XLF_ENABLE_MAT extra load flag, unless -r is used" << std::endl;
+	std::cout << "  and each watch is within a doubleword." << std::endl;
+	std::cout << std::endl;
+
+	DisplayCommonOptions();
+}
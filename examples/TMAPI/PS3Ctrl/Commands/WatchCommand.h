@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef WATCH_COMMAND_H
+#define WATCH_COMMAND_H
+
+#include "DebugEventCommand.h"
+#include "SingleArgOption.h"
+#include "DabrMultiplexer.h"
+
+class WatchCommand : public DebugEventCommand
+{
+public:
+					WatchCommand();
+	virtual			~WatchCommand();
+	virtual bool	ParseArgs(std::vector<std::string>& arguments);
+	virtual int		Run();
+
+protected:
+	struct WatchSpec
+	{
+		UINT32		uAddress;
+		UINT32		uSize;
+		BYTE		uCondition;
+		std::string	strOwner;
+	};
+
+	struct TrapHit
+	{
+		UINT64		uThreadId;
+		UINT64		uPC;
+		UINT64		uDAR;
+		UINT64		uDSISR;
+		bool		bDabr;			// A DABR match, which has no address
+	};
+
+	bool			ParseWatch(const std::string& strSpec, WatchSpec& spec) const;
+	virtual bool	AddSpec(const std::string& strSpec);
+	bool			AddWatches();
+	bool			WatchForHits();
+	void			ReportHit(const TrapHit& hit);
+	virtual void	OnDebugEvent(const SNPS3_DBG_EVENT_DATA& data);
+	virtual void	HandleEvents();
+	virtual void	OnIdle();
+	virtual void	DisplayUsageHelp() const;
+
+	UINT32					m_uRotate;			// Milliseconds each turn of the DABR lasts, 0 not to use it
+	UINT32					m_uMatPages;		// Most pages trapped at once while rotating, 0 for no limit
+	std::vector<WatchSpec>	m_specs;
+
+	MatWatchManager*		m_pMat;
+	DabrMultiplexer*		m_pMux;
+	std::vector<TrapHit>	m_pending;			// Reported by the target, not yet handled
+	std::map<std::string, UINT32> m_hitCounts;	// By owner
+	UINT32					m_uHits;
+	UINT32					m_uStrayHits;		// In a trapped page but outside its watches
+	DWORD					m_dwRotated;
+};
+
+TargetCommand* WatchCommandFactory(void);
+
+#endif
\ No newline at end of file
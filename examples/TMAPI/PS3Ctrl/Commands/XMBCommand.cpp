@@ -5,6 +5,7 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "XMBCommand.h"
+#include "XmbSettings.h"
 
 TargetCommand* XMBCommandFactory(void)
 {
@@ -94,18 +95,13 @@ int XMBCommand::Run()
 
 bool XMBCommand::DoGet()
 {
-	SNRESULT snr = 0;
-	UINT uSize = 4097;
-	char szBuf[4097]; //This is the maximum the server can allocate plus one for the \0
-	//TODO: Would be nice if the API returns the required buffer size if a NULL buffer pointer is passed.
-
-	ZeroMemory(szBuf,sizeof(szBuf));
-	snr = SNPS3GetXMBSettings(m_targetId,szBuf,&uSize,m_bSync);
+	std::string strSettings;
+	SNRESULT snr = GetXmbSettingString(m_targetId, m_bSync != FALSE, strSettings);
 
 	if (SUCCEEDED(snr))
 	{
 		// Don't be too verbose, the caller might want to parse the output string!
-		std::cout << szBuf << std::endl;
+		std::cout << strSettings << std::endl;
 	}
 	else
 	{
@@ -0,0 +1,424 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "BDImageManifest.h"
+#include "RecordFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BD_MANIFEST_MIN_BLOCK_SIZE		(64 * 1024)
+#define BD_LEDGER_FILE_NAME				L"PS3Ctrl_bdemu.ledger"
+#define BD_LEDGER_HEADER				"# PS3Ctrl bdemu ledger 1: target, device, digest, size, image"
+
+namespace
+{
+	const UINT64 PRIME1 = 0x9e3779b185ebca87ULL;
+	const UINT64 PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+	const UINT64 PRIME3 = 0x165667b19e3779f9ULL;
+	const UINT64 PRIME4 = 0x85ebca77c2b2ae63ULL;
+	const UINT64 PRIME5 = 0x27d4eb2f165667c5ULL;
+
+	inline UINT64 Rotl(UINT64 x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline UINT64 Read64(const BYTE* p)
+	{
+		UINT64 v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline UINT64 Round(UINT64 uAcc, UINT64 uInput)
+	{
+		return Rotl(uAcc + uInput * PRIME2, 31) * PRIME1;
+	}
+
+	inline UINT64 Merge(UINT64 uAcc, UINT64 uLane)
+	{
+		return (uAcc ^ Round(0, uLane)) * PRIME1 + PRIME4;
+	}
+
+	// xxHash64. FNV-1a, used for the other indexes, goes a byte at a time
+	// and would be the bottleneck on a disc image; this runs four 64 bit
+	// lanes, so hashing keeps up with the disk.
+	UINT64 HashBytes(const BYTE* p, size_t uSize, UINT64 uSeed)
+	{
+		const BYTE* pEnd = p + uSize;
+		UINT64 uHash;
+
+		if (uSize >= 32)
+		{
+			UINT64 v1 = uSeed + PRIME1 + PRIME2;
+			UINT64 v2 = uSeed + PRIME2;
+			UINT64 v3 = uSeed;
+			UINT64 v4 = uSeed - PRIME1;
+
+			const BYTE* pLimit = pEnd - 32;
+			do
+			{
+				v1 = Round(v1, Read64(p));
+				v2 = Round(v2, Read64(p + 8));
+				v3 = Round(v3, Read64(p + 16));
+				v4 = Round(v4, Read64(p + 24));
+				p += 32;
+			}
+			while (p <= pLimit);
+
+			uHash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+			uHash = Merge(uHash, v1);
+			uHash = Merge(uHash, v2);
+			uHash = Merge(uHash, v3);
+			uHash = Merge(uHash, v4);
+		}
+		else
+		{
+			uHash = uSeed + PRIME5;
+		}
+
+		uHash += uSize;
+
+		for (; p + 8 <= pEnd; p += 8)
+			uHash = Rotl(uHash ^ Round(0, Read64(p)), 27) * PRIME1 + PRIME4;
+
+		for (; p < pEnd; ++p)
+			uHash = Rotl(uHash ^ (*p * PRIME5), 11) * PRIME1;
+
+		uHash ^= uHash >> 33;
+		uHash *= PRIME2;
+		uHash ^= uHash >> 29;
+		uHash *= PRIME3;
+		uHash ^= uHash >> 32;
+		return uHash;
+	}
+
+	inline UINT64 HashBlockList(const std::vector<UINT64>& hashes, UINT64 uImageSize)
+	{
+		return HashBytes(reinterpret_cast<const BYTE*>(&hashes[0]), hashes.size() * sizeof(UINT64), uImageSize);
+	}
+}
+
+BDImageManifest::BDImageManifest()
+: m_nNextBlock(0)
+, m_nFailed(0)
+, m_nCancel(0)
+, m_nHashedBytes(0)
+, m_bValid(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+BDImageManifest::~BDImageManifest()
+{
+	CancelBuild();
+}
+
+std::wstring BDImageManifest::GetManifestPath(const WCHAR* pszImagePath)
+{
+	std::wstring strPath = pszImagePath;
+	strPath += BD_MANIFEST_EXTENSION;
+	return strPath;
+}
+
+bool BDImageManifest::GetImageAttributes(const WCHAR* pszImagePath, UINT64& uSize, UINT64& uWriteTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!::GetFileAttributesExW(pszImagePath, GetFileExInfoStandard, &data))
+		return false;
+
+	uSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	uWriteTime = ((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+bool BDImageManifest::Load(const WCHAR* pszManifestPath)
+{
+	CancelBuild();
+	m_bValid = false;
+
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszManifestPath, L"rb") != 0 || !pFile)
+		return false;
+
+	BDManifestHeader header;
+	bool bOK = fread(&header, sizeof(header), 1, pFile) == 1 &&
+		header.uMagic == BD_MANIFEST_MAGIC && header.uVersion == BD_MANIFEST_VERSION &&
+		header.uBlockSize >= BD_MANIFEST_MIN_BLOCK_SIZE && header.uImageSize != 0 &&
+		header.uBlockCount == (header.uImageSize + header.uBlockSize - 1) / header.uBlockSize;
+
+	if (bOK)
+	{
+		m_hashes.resize(header.uBlockCount);
+		bOK = fread(&m_hashes[0], sizeof(UINT64), m_hashes.size(), pFile) == m_hashes.size() &&
+			HashBlockList(m_hashes, header.uImageSize) == header.uDigest;
+	}
+
+	fclose(pFile);
+
+	if (!bOK)
+	{
+		m_hashes.clear();
+		return false;
+	}
+
+	m_header = header;
+	m_bValid = true;
+	return true;
+}
+
+bool BDImageManifest::Save(const WCHAR* pszManifestPath) const
+{
+	if (!m_bValid)
+		return false;
+
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszManifestPath, L"wb") != 0 || !pFile)
+		return false;
+
+	bool bOK = fwrite(&m_header, sizeof(m_header), 1, pFile) == 1 &&
+		fwrite(&m_hashes[0], sizeof(UINT64), m_hashes.size(), pFile) == m_hashes.size();
+
+	if (fclose(pFile) != 0)
+		bOK = false;
+
+	if (!bOK)
+		_wremove(pszManifestPath);
+
+	return bOK;
+}
+
+bool BDImageManifest::IsCurrent(const WCHAR* pszImagePath) const
+{
+	UINT64 uSize, uWriteTime;
+	return m_bValid && GetImageAttributes(pszImagePath, uSize, uWriteTime) &&
+		uSize == m_header.uImageSize && uWriteTime == m_header.uImageWriteTime;
+}
+
+UINT32 BDImageManifest::CountChangedBlocks(const BDImageManifest& other) const
+{
+	if (!m_bValid || !other.m_bValid || m_header.uBlockSize != other.m_header.uBlockSize)
+		return ~0U;
+
+	// Blocks past the end of the shorter image count as changed.
+	size_t uCommon = m_hashes.size() < other.m_hashes.size() ? m_hashes.size() : other.m_hashes.size();
+	size_t uLonger = m_hashes.size() < other.m_hashes.size() ? other.m_hashes.size() : m_hashes.size();
+
+	UINT32 uChanged = (UINT32)(uLonger - uCommon);
+	for (size_t i = 0; i < uCommon; ++i)
+	{
+		if (m_hashes[i] != other.m_hashes[i])
+			++uChanged;
+	}
+
+	return uChanged;
+}
+
+bool BDImageManifest::StartBuild(const WCHAR* pszImagePath, UINT32 uBlockSize, UINT32 uThreads)
+{
+	CancelBuild();
+	m_bValid = false;
+
+	if (uBlockSize < BD_MANIFEST_MIN_BLOCK_SIZE)
+		uBlockSize = BD_MANIFEST_MIN_BLOCK_SIZE;
+
+	memset(&m_header, 0, sizeof(m_header));
+	if (!GetImageAttributes(pszImagePath, m_header.uImageSize, m_header.uImageWriteTime) || m_header.uImageSize == 0)
+		return false;
+
+	m_header.uMagic = BD_MANIFEST_MAGIC;
+	m_header.uVersion = BD_MANIFEST_VERSION;
+	m_header.uBlockSize = uBlockSize;
+	m_header.uBlockCount = (UINT32)((m_header.uImageSize + uBlockSize - 1) / uBlockSize);
+
+	m_strImagePath = pszImagePath;
+	m_hashes.assign(m_header.uBlockCount, 0);
+	m_nNextBlock = 0;
+	m_nFailed = 0;
+	m_nCancel = 0;
+	m_nHashedBytes = 0;
+
+	if (uThreads == 0)
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		uThreads = si.dwNumberOfProcessors;
+	}
+	if (uThreads > m_header.uBlockCount)
+		uThreads = m_header.uBlockCount;
+
+	return m_workers.Start<BDImageManifest, &BDImageManifest::WorkerThread>(uThreads, this);
+}
+
+void BDImageManifest::WorkerThread()
+{
+	HANDLE hFile = CreateFileW(m_strImagePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		InterlockedIncrement(&m_nFailed);
+		return;
+	}
+
+	std::vector<BYTE> buffer(m_header.uBlockSize);
+
+	// Blocks are claimed in order, so the threads between them read the
+	// image front to back.
+	while (!m_nCancel && !m_nFailed)
+	{
+		UINT32 uBlock = (UINT32)(InterlockedIncrement(&m_nNextBlock) - 1);
+		if (uBlock >= m_header.uBlockCount)
+			break;
+
+		UINT64 uOffset = (UINT64)uBlock * m_header.uBlockSize;
+		UINT64 uRemaining = m_header.uImageSize - uOffset;
+		DWORD dwSize = uRemaining < m_header.uBlockSize ? (DWORD)uRemaining : m_header.uBlockSize;
+
+		LARGE_INTEGER position;
+		position.QuadPart = (LONGLONG)uOffset;
+		DWORD dwRead = 0;
+		if (!SetFilePointerEx(hFile, position, NULL, FILE_BEGIN) || !ReadFile(hFile, &buffer[0], dwSize, &dwRead, NULL) ||
+			dwRead != dwSize)
+		{
+			InterlockedIncrement(&m_nFailed);
+			break;
+		}
+
+		m_hashes[uBlock] = HashBytes(&buffer[0], dwSize, uOffset);
+		InterlockedExchangeAdd64(&m_nHashedBytes, dwSize);
+	}
+
+	CloseHandle(hFile);
+}
+
+bool BDImageManifest::WaitForBuild(DWORD dwMilliseconds)
+{
+	if (m_workers.IsEmpty())
+		return true;
+
+	if (!m_workers.Wait(dwMilliseconds))
+		return false;
+
+	if (m_nFailed || m_nCancel)
+		return true;
+
+	// An image rewritten while it was being read has no valid manifest.
+	UINT64 uSize, uWriteTime;
+	if (!GetImageAttributes(m_strImagePath.c_str(), uSize, uWriteTime) || uSize != m_header.uImageSize ||
+		uWriteTime != m_header.uImageWriteTime)
+		return true;
+
+	m_header.uDigest = HashBlockList(m_hashes, m_header.uImageSize);
+	m_bValid = true;
+	return true;
+}
+
+void BDImageManifest::CancelBuild()
+{
+	if (m_workers.IsEmpty())
+		return;
+
+	InterlockedExchange(&m_nCancel, 1);
+	WaitForBuild(INFINITE);
+}
+
+bool BDDeployLedger::Load(const WCHAR* pszPath)
+{
+	m_records.clear();
+
+	RecordFileReader reader;
+	if (!reader.Open(pszPath))
+		return false;
+
+	// target, device, digest, size, image
+	char* apFields[5];
+	while (UINT32 uFields = reader.Next(apFields, _countof(apFields)))
+	{
+		if (uFields != _countof(apFields) || apFields[0][0] == '\0' || apFields[1][0] == '\0')
+			continue;
+
+		BDDeployRecord record;
+		record.strTarget = apFields[0];
+		record.strDevice = apFields[1];
+		record.uDigest = _strtoui64(apFields[2], NULL, 16);
+		record.uImageSize = _strtoui64(apFields[3], NULL, 10);
+		record.strImage = apFields[4];
+		Set(record);
+	}
+
+	return true;
+}
+
+bool BDDeployLedger::Save(const WCHAR* pszPath) const
+{
+	RecordFileWriter writer;
+	if (!writer.Open(pszPath, BD_LEDGER_HEADER))
+		return false;
+
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		const BDDeployRecord& record = m_records[i];
+		writer.Print("%s\t%s\t%016llx\t%llu\t%s\n", record.strTarget.c_str(), record.strDevice.c_str(),
+			record.uDigest, record.uImageSize, record.strImage.c_str());
+	}
+
+	return writer.Commit();
+}
+
+const BDDeployRecord* BDDeployLedger::Find(const std::string& strTarget, const std::string& strDevice) const
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == strTarget && m_records[i].strDevice == strDevice)
+			return &m_records[i];
+	}
+	return NULL;
+}
+
+void BDDeployLedger::Set(const BDDeployRecord& record)
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == record.strTarget && m_records[i].strDevice == record.strDevice)
+		{
+			m_records[i] = record;
+			return;
+		}
+	}
+	m_records.push_back(record);
+}
+
+void BDDeployLedger::Remove(const std::string& strTarget, const std::string& strDevice)
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == strTarget && m_records[i].strDevice == strDevice)
+		{
+			m_records.erase(m_records.begin() + i);
+			return;
+		}
+	}
+}
+
+void BDDeployLedger::RemoveTarget(const std::string& strTarget)
+{
+	for (size_t i = m_records.size(); i-- > 0; )
+	{
+		if (m_records[i].strTarget == strTarget)
+			m_records.erase(m_records.begin() + i);
+	}
+}
+
+std::wstring BDDeployLedger::GetDefaultPath()
+{
+	WCHAR szTemp[MAX_PATH + 1];
+	DWORD dwLength = ::GetTempPathW(_countof(szTemp), szTemp);
+
+	std::wstring strPath = dwLength && dwLength < _countof(szTemp) ? szTemp : L"";
+	strPath += BD_LEDGER_FILE_NAME;
+	return strPath;
+}
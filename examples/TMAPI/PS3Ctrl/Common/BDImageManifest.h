@@ -0,0 +1,116 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BD_IMAGE_MANIFEST_H
+#define BD_IMAGE_MANIFEST_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "WorkerThreads.h"
+
+// Disc image manifest, written next to the image as <image>.bdmf:
+//
+//   BDManifestHeader
+//   UINT64 block hashes[uBlockCount]
+//
+// The image is hashed in uBlockSize blocks, on several threads at once, and
+// uDigest is the hash of the block hashes. The size and last write time of
+// the image are kept so an unchanged image is never hashed twice.
+
+#define BD_MANIFEST_MAGIC				(0x464d4442)	// 'BDMF'
+#define BD_MANIFEST_VERSION				(1)
+#define BD_MANIFEST_EXTENSION			L".bdmf"
+#define BD_MANIFEST_DEFAULT_BLOCK_SIZE	(16 * 1024 * 1024)
+
+struct BDManifestHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT32	uBlockSize;
+	UINT32	uBlockCount;
+	UINT64	uImageSize;
+	UINT64	uImageWriteTime;		// FILETIME of the image when it was hashed
+	UINT64	uDigest;
+};
+
+class BDImageManifest
+{
+public:
+					BDImageManifest();
+					~BDImageManifest();
+
+	bool			Load(const WCHAR* pszManifestPath);
+	bool			Save(const WCHAR* pszManifestPath) const;
+	// Whether the image still has the size and write time it was hashed at.
+	bool			IsCurrent(const WCHAR* pszImagePath) const;
+
+	// Hashes the image in the background; uThreads of 0 uses one per core.
+	bool			StartBuild(const WCHAR* pszImagePath, UINT32 uBlockSize, UINT32 uThreads);
+	// Returns true once the build has finished, successfully or not.
+	bool			WaitForBuild(DWORD dwMilliseconds);
+	void			CancelBuild();
+	bool			IsBuilding() const { return !m_workers.IsEmpty(); }
+
+	bool			IsValid() const { return m_bValid; }
+	UINT64			GetDigest() const { return m_header.uDigest; }
+	UINT64			GetImageSize() const { return m_header.uImageSize; }
+	UINT32			GetBlockCount() const { return m_header.uBlockCount; }
+	UINT64			GetHashedBytes() const { return (UINT64)m_nHashedBytes; }
+
+	// Blocks that differ from another manifest of the same image, or ~0 if
+	// the two cannot be compared.
+	UINT32			CountChangedBlocks(const BDImageManifest& other) const;
+
+	static std::wstring	GetManifestPath(const WCHAR* pszImagePath);
+	static bool		GetImageAttributes(const WCHAR* pszImagePath, UINT64& uSize, UINT64& uWriteTime);
+
+private:
+	void			WorkerThread();
+
+	BDManifestHeader			m_header;
+	std::vector<UINT64>			m_hashes;
+	std::wstring				m_strImagePath;
+	WorkerThreads				m_workers;
+	volatile LONG				m_nNextBlock;
+	volatile LONG				m_nFailed;
+	volatile LONG				m_nCancel;
+	volatile LONGLONG			m_nHashedBytes;
+	bool						m_bValid;
+};
+
+// What was last written to each BD emulator device, so a deployment can be
+// skipped when the device already holds the same image. The target can only
+// report the name and size of an image; the digest comes from its manifest.
+// Kept as text, one device per line.
+struct BDDeployRecord
+{
+	std::string		strTarget;
+	std::string		strDevice;
+	UINT64			uDigest;
+	UINT64			uImageSize;
+	std::string		strImage;
+};
+
+class BDDeployLedger
+{
+public:
+	// A missing ledger loads as empty.
+	bool			Load(const WCHAR* pszPath);
+	bool			Save(const WCHAR* pszPath) const;
+
+	const BDDeployRecord* Find(const std::string& strTarget, const std::string& strDevice) const;
+	void			Set(const BDDeployRecord& record);
+	void			Remove(const std::string& strTarget, const std::string& strDevice);
+	void			RemoveTarget(const std::string& strTarget);
+
+	static std::wstring	GetDefaultPath();
+
+private:
+	std::vector<BDDeployRecord>	m_records;
+};
+
+#endif
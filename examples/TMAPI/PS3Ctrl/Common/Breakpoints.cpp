@@ -0,0 +1,246 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "Breakpoints.h"
+#include "ProcessStop.h"
+#include <algorithm>
+#include <iterator>
+
+BreakpointManager::BreakpointManager(HTARGET hTarget)
+: m_hTarget(hTarget)
+, m_uSet(0)
+, m_uCleared(0)
+, m_uFailed(0)
+, m_uStops(0)
+{
+}
+
+void BreakpointManager::Add(const BreakpointScope& scope, UINT64 uAddress, BreakpointFunction pfnHit, void* pUser)
+{
+	Scope& state = m_scopes[scope];
+
+	Handler handler;
+	handler.pfnHit = pfnHit;
+	handler.pUser = pUser;
+	state.wanted[uAddress] = handler;
+	state.bDirty = true;
+}
+
+bool BreakpointManager::Remove(const BreakpointScope& scope, UINT64 uAddress)
+{
+	ScopeMap::iterator it = m_scopes.find(scope);
+	if (it == m_scopes.end() || it->second.wanted.erase(uAddress) == 0)
+		return false;
+
+	it->second.bDirty = true;
+	return true;
+}
+
+void BreakpointManager::RemoveAll()
+{
+	for (ScopeMap::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+	{
+		it->second.wanted.clear();
+		it->second.bDirty = true;
+	}
+}
+
+SNRESULT BreakpointManager::Apply()
+{
+	m_uSet = 0;
+	m_uCleared = 0;
+	m_uFailed = 0;
+	m_uStops = 0;
+
+	SNRESULT snrResult = SN_S_OK;
+
+	// The scopes of a process are next to each other, so each process is
+	// stopped once for all of them.
+	ScopeMap::iterator first = m_scopes.begin();
+	while (first != m_scopes.end())
+	{
+		UINT32 uProcessId = first->first.uProcessId;
+
+		ScopeMap::iterator last = first;
+		std::vector<std::vector<UINT64> > actual;
+		std::vector<bool> changed;
+		bool bChanges = false;
+
+		// Read while it runs; only the changes need it stopped.
+		for (; last != m_scopes.end() && last->first.uProcessId == uProcessId; ++last)
+		{
+			actual.push_back(std::vector<UINT64>());
+			changed.push_back(false);
+			if (!last->second.bDirty)
+				continue;
+
+			SNRESULT snr = GetBreakpoints(last->first, actual.back());
+			if (SN_FAILED(snr))
+			{
+				if (SN_SUCCEEDED(snrResult))
+					snrResult = snr;
+				continue;
+			}
+
+			// Nothing to do unless a wanted one is missing or one of ours is unwanted.
+			Scope& state = last->second;
+			for (HandlerMap::const_iterator it = state.wanted.begin(); it != state.wanted.end() && !changed.back(); ++it)
+				changed.back() = !std::binary_search(actual.back().begin(), actual.back().end(), it->first);
+			for (size_t i = 0; i < state.applied.size() && !changed.back(); ++i)
+				changed.back() = !state.wanted.count(state.applied[i]);
+
+			if (changed.back())
+				bChanges = true;
+			else
+				state.bDirty = false;
+		}
+
+		if (bChanges)
+		{
+			ProcessStop stop(m_hTarget, uProcessId);
+			SNRESULT snr = stop.Stop();
+			if (SN_FAILED(snr))
+			{
+				if (SN_SUCCEEDED(snrResult))
+					snrResult = snr;
+			}
+			else
+			{
+				if (stop.HasStopped())
+					m_uStops++;
+
+				size_t uScope = 0;
+				for (ScopeMap::iterator it = first; it != last; ++it, ++uScope)
+				{
+					if (changed[uScope])
+						ApplyScope(it->first, it->second, actual[uScope], snrResult);
+				}
+
+				snr = stop.Continue();
+				if (SN_FAILED(snr) && SN_SUCCEEDED(snrResult))
+					snrResult = snr;
+			}
+		}
+
+		// Scopes left with nothing are dropped.
+		while (first != last)
+		{
+			if (first->second.wanted.empty() && first->second.applied.empty() && !first->second.bDirty)
+				m_scopes.erase(first++);
+			else
+				++first;
+		}
+	}
+
+	return snrResult;
+}
+
+void BreakpointManager::ApplyScope(const BreakpointScope& scope, Scope& state, const std::vector<UINT64>& actual, SNRESULT& snrResult)
+{
+	std::vector<UINT64> wanted;
+	wanted.reserve(state.wanted.size());
+	for (HandlerMap::const_iterator it = state.wanted.begin(); it != state.wanted.end(); ++it)
+		wanted.push_back(it->first);
+	std::sort(wanted.begin(), wanted.end());
+
+	// Ours that are still set; any cleared by something else are forgotten.
+	std::vector<UINT64> ours;
+	std::set_intersection(state.applied.begin(), state.applied.end(), actual.begin(), actual.end(), std::back_inserter(ours));
+
+	std::vector<UINT64> toClear;
+	std::set_difference(ours.begin(), ours.end(), wanted.begin(), wanted.end(), std::back_inserter(toClear));
+
+	// Wanted ones set by something else are left to it.
+	std::vector<UINT64> toSet;
+	std::set_difference(wanted.begin(), wanted.end(), actual.begin(), actual.end(), std::back_inserter(toSet));
+
+	std::vector<UINT64> applied;
+	std::set_intersection(ours.begin(), ours.end(), wanted.begin(), wanted.end(), std::back_inserter(applied));
+
+	bool bFailed = false;
+	for (size_t i = 0; i < toClear.size(); ++i)
+	{
+		SNRESULT snr = SNPS3ClearBreakPoint(m_hTarget, scope.uUnit, scope.uProcessId, scope.uThreadId, toClear[i]);
+		if (SN_SUCCEEDED(snr))
+		{
+			m_uCleared++;
+			continue;
+		}
+
+		applied.push_back(toClear[i]);
+		m_uFailed++;
+		bFailed = true;
+		if (SN_SUCCEEDED(snrResult))
+			snrResult = snr;
+	}
+
+	for (size_t i = 0; i < toSet.size(); ++i)
+	{
+		SNRESULT snr = SNPS3SetBreakPoint(m_hTarget, scope.uUnit, scope.uProcessId, scope.uThreadId, toSet[i]);
+		if (SN_SUCCEEDED(snr))
+		{
+			applied.push_back(toSet[i]);
+			m_uSet++;
+			continue;
+		}
+
+		m_uFailed++;
+		bFailed = true;
+		if (SN_SUCCEEDED(snrResult))
+			snrResult = snr;
+	}
+
+	std::sort(applied.begin(), applied.end());
+	state.applied.swap(applied);
+
+	// Failures are tried again by the next Apply().
+	state.bDirty = bFailed;
+}
+
+bool BreakpointManager::Dispatch(const BreakpointHit& hit, bool& bContinue) const
+{
+	ScopeMap::const_iterator scope = m_scopes.find(hit.scope);
+	if (scope == m_scopes.end())
+		return false;
+
+	HandlerMap::const_iterator it = scope->second.wanted.find(hit.uAddress);
+	if (it == scope->second.wanted.end())
+		return false;
+
+	bContinue = it->second.pfnHit ? it->second.pfnHit(it->second.pUser, hit) : false;
+	return true;
+}
+
+UINT32 BreakpointManager::GetWantedCount() const
+{
+	UINT32 uCount = 0;
+	for (ScopeMap::const_iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+		uCount += (UINT32)it->second.wanted.size();
+	return uCount;
+}
+
+SNRESULT BreakpointManager::GetBreakpoints(const BreakpointScope& scope, std::vector<UINT64>& addresses)
+{
+	UINT32 uCount = 0;
+	SNRESULT snr = SNPS3GetBreakPoints(m_hTarget, scope.uUnit, scope.uProcessId, scope.uThreadId, &uCount, NULL);
+
+	// Another tool may set more between the calls.
+	for (UINT32 uAttempt = 0; SN_SUCCEEDED(snr) && uCount; ++uAttempt)
+	{
+		addresses.resize(uCount);
+		snr = SNPS3GetBreakPoints(m_hTarget, scope.uUnit, scope.uProcessId, scope.uThreadId, &uCount, &addresses[0]);
+		if (snr != SN_E_OUT_OF_MEM || uAttempt == 3)
+			break;
+		snr = SN_S_OK;
+	}
+
+	if (SN_FAILED(snr))
+		return snr;
+
+	addresses.resize(uCount);
+	std::sort(addresses.begin(), addresses.end());
+	return snr;
+}
@@ -0,0 +1,99 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include "TmapiTrace.h"
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+// What a set of breakpoints applies to. PPU breakpoints are process wide,
+// so uThreadId is 0 for them; SPU ones are per thread.
+struct BreakpointScope
+{
+	UINT32			uProcessId;
+	UINT32			uUnit;
+	UINT64			uThreadId;
+
+	bool operator<(const BreakpointScope& other) const
+	{
+		if (uProcessId != other.uProcessId)
+			return uProcessId < other.uProcessId;
+		if (uUnit != other.uUnit)
+			return uUnit < other.uUnit;
+		return uThreadId < other.uThreadId;
+	}
+};
+
+struct BreakpointHit
+{
+	BreakpointScope	scope;
+	UINT64			uAddress;
+	UINT64			uThreadId;			// Of the thread stopped at it
+};
+
+// Called for a breakpoint hit; returns whether to continue the thread.
+typedef bool (*BreakpointFunction)(void* pUser, const BreakpointHit& hit);
+
+// Keeps the breakpoints wanted in each scope, and makes the target match
+// them. SNPS3SetBreakPoint() and SNPS3ClearBreakPoint() take one address at
+// a time, so Apply() reads what each changed scope has set with one
+// SNPS3GetBreakPoints(), then stops each process once for all of the
+// difference, and continues only the threads it stopped. Breakpoints set by
+// anything else are left alone.
+class BreakpointManager
+{
+public:
+						BreakpointManager(HTARGET hTarget);
+
+	void				Add(const BreakpointScope& scope, UINT64 uAddress, BreakpointFunction pfnHit, void* pUser);
+	bool				Remove(const BreakpointScope& scope, UINT64 uAddress);
+	void				RemoveAll();
+	// Threads stopped before, at a breakpoint or by the user, stay stopped.
+	SNRESULT			Apply();
+
+	// Calls the function of the breakpoint hit, if it is one of these.
+	bool				Dispatch(const BreakpointHit& hit, bool& bContinue) const;
+
+	UINT32				GetWantedCount() const;
+	// Of the last Apply()
+	UINT32				GetSetCount() const { return m_uSet; }
+	UINT32				GetClearedCount() const { return m_uCleared; }
+	UINT32				GetFailedCount() const { return m_uFailed; }
+	UINT32				GetStopCount() const { return m_uStops; }
+
+private:
+	struct Handler
+	{
+		BreakpointFunction	pfnHit;
+		void*				pUser;
+	};
+
+	typedef std::unordered_map<UINT64, Handler> HandlerMap;
+
+	struct Scope
+	{
+		HandlerMap				wanted;
+		std::vector<UINT64>		applied;		// Set by Apply(), sorted
+		bool					bDirty;
+	};
+
+	typedef std::map<BreakpointScope, Scope> ScopeMap;
+
+	SNRESULT			GetBreakpoints(const BreakpointScope& scope, std::vector<UINT64>& addresses);
+	void				ApplyScope(const BreakpointScope& scope, Scope& state, const std::vector<UINT64>& actual, SNRESULT& snrResult);
+
+	HTARGET				m_hTarget;
+	ScopeMap			m_scopes;
+	UINT32				m_uSet;
+	UINT32				m_uCleared;
+	UINT32				m_uFailed;
+	UINT32				m_uStops;
+};
+
+#endif
@@ -0,0 +1,668 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "CoreDumpIndex.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define ELF_CLASS32					(1)
+#define ELF_CLASS64					(2)
+#define ELF_DATA2LSB				(1)
+#define ELF_DATA2MSB				(2)
+#define ELF_TYPE_CORE				(4)
+#define ELF_HEADER_SIZE_32			(52)
+#define ELF_HEADER_SIZE_64			(64)
+#define ELF_PHDR_SIZE_32			(32)
+#define ELF_PHDR_SIZE_64			(56)
+#define ELF_PT_LOAD					(1)
+#define ELF_PT_NOTE					(4)
+#define ELF_PN_XNUM					(0xffff)
+
+#define ELF_NT_PRSTATUS				(1)
+#define ELF_NT_FPREGSET				(2)
+#define ELF_NT_PRPSINFO				(3)
+#define ELF_NT_FILE					(0x46494c45)
+#define ELF_NT_PPC_VMX				(0x100)
+#define ELF_NT_PPC_VSX				(0x102)
+
+#define CORE_DUMP_MAX_NOTE_SEGMENT	(64 * 1024 * 1024)
+
+namespace
+{
+	UINT64 HashBytes(UINT64 uHash, const BYTE* pData, size_t uSize)
+	{
+		// FNV-1a
+		for (size_t i = 0; i < uSize; ++i)
+		{
+			uHash ^= pData[i];
+			uHash *= 0x100000001b3ULL;
+		}
+		return uHash;
+	}
+
+	const UINT64 HASH_SEED = 0xcbf29ce484222325ULL;
+
+	CoreDumpNoteKind ClassifyNote(const char* pszName, UINT32 uType)
+	{
+		if (strcmp(pszName, "CORE") == 0)
+		{
+			switch (uType)
+			{
+			case ELF_NT_PRSTATUS:	return CDK_THREAD;
+			case ELF_NT_FPREGSET:	return CDK_REGISTERS;
+			case ELF_NT_PRPSINFO:	return CDK_PROCESS;
+			case ELF_NT_FILE:		return CDK_MODULE;
+			}
+		}
+		else if (strcmp(pszName, "LINUX") == 0)
+		{
+			if (uType >= ELF_NT_PPC_VMX && uType <= ELF_NT_PPC_VSX)
+				return CDK_REGISTERS;
+		}
+		return CDK_OTHER;
+	}
+
+	bool SegmentAddressLess(const CoreDumpSegment& a, const CoreDumpSegment& b)
+	{
+		return a.uAddress < b.uAddress;
+	}
+
+	template <class T> bool OffsetLess(const T& a, const T& b)
+	{
+		return a.uOffset < b.uOffset;
+	}
+
+	template <class T> bool WriteArray(FILE* pFile, const std::vector<T>& values)
+	{
+		return values.empty() || fwrite(&values[0], sizeof(T), values.size(), pFile) == values.size();
+	}
+}
+
+CoreDumpIndexer::CoreDumpIndexer()
+: m_hFile(INVALID_HANDLE_VALUE)
+, m_state(CDI_ELF_HEADER)
+, m_uAvailable(0)
+, m_uParsed(0)
+, m_bBigEndian(true)
+, m_uProgramHeaderOffset(0)
+, m_uProgramHeaderSize(0)
+, m_uProgramHeaderCount(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+CoreDumpIndexer::~CoreDumpIndexer()
+{
+	Close();
+}
+
+void CoreDumpIndexer::Close()
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+void CoreDumpIndexer::Begin(const WCHAR* pszDumpPath)
+{
+	Close();
+
+	m_strDumpPath = pszDumpPath;
+	m_state = CDI_ELF_HEADER;
+	m_uAvailable = 0;
+	m_uParsed = 0;
+	m_layout.clear();
+	m_segments.clear();
+	m_notes.clear();
+	m_noteSegments.clear();
+	m_strings.clear();
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+bool CoreDumpIndexer::ReadAt(UINT64 uOffset, void* pBuffer, UINT32 uSize)
+{
+	LARGE_INTEGER position;
+	position.QuadPart = (LONGLONG)uOffset;
+
+	DWORD dwRead = 0;
+	return SetFilePointerEx(m_hFile, position, NULL, FILE_BEGIN) &&
+		ReadFile(m_hFile, pBuffer, uSize, &dwRead, NULL) && dwRead == uSize;
+}
+
+bool CoreDumpIndexer::Update(UINT64 uAvailable)
+{
+	if (m_state == CDI_DONE || m_state == CDI_CORRUPT)
+		return m_state == CDI_DONE;
+
+	// The file is still being written, so it is shared for writing and may
+	// not exist at all yet.
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		m_hFile = CreateFileW(m_strDumpPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE)
+			return true;
+	}
+
+	// Progress can be reported before the bytes reach the disk.
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size))
+		return true;
+	if (uAvailable > (UINT64)size.QuadPart)
+		uAvailable = (UINT64)size.QuadPart;
+	if (uAvailable > m_uAvailable)
+		m_uAvailable = uAvailable;
+
+	for (;;)
+	{
+		bool bProgress = false;
+
+		switch (m_state)
+		{
+		case CDI_ELF_HEADER:
+			if (m_uAvailable < ELF_HEADER_SIZE_64)
+				return true;
+			bProgress = ParseElfHeader();
+			break;
+
+		case CDI_PROGRAM_HEADERS:
+			if (m_uAvailable < m_uProgramHeaderOffset + (UINT64)m_uProgramHeaderSize * m_uProgramHeaderCount)
+				return true;
+			bProgress = ParseProgramHeaders();
+			break;
+
+		case CDI_NOTES:
+			if (m_noteSegments.empty())
+			{
+				std::sort(m_segments.begin(), m_segments.end(), SegmentAddressLess);
+				m_state = CDI_DONE;
+				return true;
+			}
+			if (m_uAvailable < m_noteSegments.front().uOffset + m_noteSegments.front().uSize)
+				return true;
+			bProgress = ParseNotes(m_noteSegments.front());
+			m_noteSegments.erase(m_noteSegments.begin());
+			break;
+
+		default:
+			return m_state == CDI_DONE;
+		}
+
+		if (!bProgress)
+		{
+			m_state = CDI_CORRUPT;
+			Close();
+			return false;
+		}
+	}
+}
+
+bool CoreDumpIndexer::ParseElfHeader()
+{
+	BYTE header[ELF_HEADER_SIZE_64];
+	if (!ReadAt(0, header, sizeof(header)))
+		return false;
+
+	if (header[0] != 0x7f || header[1] != 'E' || header[2] != 'L' || header[3] != 'F')
+		return false;
+	if (header[4] != ELF_CLASS32 && header[4] != ELF_CLASS64)
+		return false;
+	if (header[5] != ELF_DATA2LSB && header[5] != ELF_DATA2MSB)
+		return false;
+
+	m_bBigEndian = header[5] == ELF_DATA2MSB;
+	m_header.uClass = header[4];
+	m_header.uData = header[5];
+
+	if (Get16(header + 16) != ELF_TYPE_CORE)
+		return false;
+	m_header.uMachine = Get16(header + 18);
+
+	UINT32 uMinEntrySize;
+	if (m_header.uClass == ELF_CLASS64)
+	{
+		m_uProgramHeaderOffset = Get64(header + 32);
+		m_uProgramHeaderSize = Get16(header + 54);
+		m_uProgramHeaderCount = Get16(header + 56);
+		m_header.uElfHeaderSize = ELF_HEADER_SIZE_64;
+		uMinEntrySize = ELF_PHDR_SIZE_64;
+	}
+	else
+	{
+		m_uProgramHeaderOffset = Get32(header + 28);
+		m_uProgramHeaderSize = Get16(header + 42);
+		m_uProgramHeaderCount = Get16(header + 44);
+		m_header.uElfHeaderSize = ELF_HEADER_SIZE_32;
+		uMinEntrySize = ELF_PHDR_SIZE_32;
+	}
+
+	// Extended numbering is only used by dumps with more than 65534
+	// segments, far beyond what a PS3 process can map.
+	if (m_uProgramHeaderCount == ELF_PN_XNUM || m_uProgramHeaderCount == 0 ||
+		m_uProgramHeaderSize < uMinEntrySize || m_uProgramHeaderSize > 2 * uMinEntrySize ||
+		m_uProgramHeaderOffset < m_header.uElfHeaderSize || m_uProgramHeaderOffset > 0xffffffffULL)
+		return false;
+
+	m_layout.assign(header, header + m_header.uElfHeaderSize);
+	m_header.uProgramHeaderOffset = m_uProgramHeaderOffset;
+	m_header.uProgramHeaderBytes = m_uProgramHeaderSize * m_uProgramHeaderCount;
+	m_uParsed = m_header.uElfHeaderSize;
+	m_state = CDI_PROGRAM_HEADERS;
+	return true;
+}
+
+bool CoreDumpIndexer::ParseProgramHeaders()
+{
+	std::vector<BYTE> table(m_header.uProgramHeaderBytes);
+	if (!ReadAt(m_uProgramHeaderOffset, &table[0], (UINT32)table.size()))
+		return false;
+
+	m_layout.insert(m_layout.end(), table.begin(), table.end());
+	m_header.uLayoutHash = HashBytes(HASH_SEED, &m_layout[0], m_layout.size());
+
+	for (UINT32 i = 0; i < m_uProgramHeaderCount; ++i)
+	{
+		const BYTE* pEntry = &table[i * m_uProgramHeaderSize];
+		UINT32 uType = Get32(pEntry);
+		UINT32 uFlags;
+		UINT64 uOffset, uAddress, uFileSize, uMemorySize;
+
+		if (m_header.uClass == ELF_CLASS64)
+		{
+			uFlags = Get32(pEntry + 4);
+			uOffset = Get64(pEntry + 8);
+			uAddress = Get64(pEntry + 16);
+			uFileSize = Get64(pEntry + 32);
+			uMemorySize = Get64(pEntry + 40);
+		}
+		else
+		{
+			uOffset = Get32(pEntry + 4);
+			uAddress = Get32(pEntry + 8);
+			uFileSize = Get32(pEntry + 16);
+			uMemorySize = Get32(pEntry + 20);
+			uFlags = Get32(pEntry + 24);
+		}
+
+		if (uOffset + uFileSize < uOffset)
+			return false;
+
+		if (uType == ELF_PT_LOAD)
+		{
+			CoreDumpSegment segment;
+			segment.uAddress = uAddress;
+			segment.uFileOffset = uOffset;
+			segment.uFileSize = uFileSize;
+			segment.uMemorySize = uMemorySize;
+			segment.uFlags = uFlags;
+			segment.uProgramHeader = i;
+			m_segments.push_back(segment);
+		}
+		else if (uType == ELF_PT_NOTE && uFileSize)
+		{
+			if (uFileSize > CORE_DUMP_MAX_NOTE_SEGMENT)
+				return false;
+
+			NoteSegment note;
+			note.uOffset = uOffset;
+			note.uSize = uFileSize;
+			note.uProgramHeader = i;
+			m_noteSegments.push_back(note);
+		}
+	}
+
+	// Notes are parsed in file order, as their bytes arrive.
+	std::sort(m_noteSegments.begin(), m_noteSegments.end(), OffsetLess<NoteSegment>);
+
+	m_uParsed = std::max(m_uParsed, m_uProgramHeaderOffset + m_header.uProgramHeaderBytes);
+	m_state = CDI_NOTES;
+	return true;
+}
+
+bool CoreDumpIndexer::ParseNotes(const NoteSegment& segment)
+{
+	if (segment.uSize == 0)
+	{
+		m_uParsed = std::max(m_uParsed, segment.uOffset);
+		return true;
+	}
+
+	std::vector<BYTE> data((size_t)segment.uSize);
+	if (!ReadAt(segment.uOffset, &data[0], (UINT32)data.size()))
+		return false;
+
+	UINT64 uPos = 0;
+	while (uPos + 12 <= segment.uSize)
+	{
+		const BYTE* pRecord = &data[(size_t)uPos];
+		UINT32 uNameSize = Get32(pRecord);
+		UINT32 uDescSize = Get32(pRecord + 4);
+		UINT32 uType = Get32(pRecord + 8);
+
+		UINT64 uName = uPos + 12;
+		UINT64 uDesc = uName + ((uNameSize + 3ULL) & ~3ULL);
+		UINT64 uNext = uDesc + ((uDescSize + 3ULL) & ~3ULL);
+		if (uDesc + uDescSize > segment.uSize)
+			return false;
+
+		// An empty name may sit at the very end of the segment.
+		const char* pszName = uNameSize ? reinterpret_cast<const char*>(&data[(size_t)uName]) : "";
+		UINT32 uNameLength = 0;
+		while (uNameLength < uNameSize && pszName[uNameLength])
+			++uNameLength;
+
+		CoreDumpNote note;
+		note.uDescOffset = segment.uOffset + uDesc;
+		note.uDescSize = uDescSize;
+		note.uType = uType;
+		note.uName = Intern(pszName, uNameLength);
+		note.uKind = ClassifyNote(&m_strings[note.uName], uType);
+		note.uProgramHeader = segment.uProgramHeader;
+		m_notes.push_back(note);
+		m_header.uKindCount[note.uKind]++;
+
+		uPos = uNext;
+	}
+
+	m_uParsed = std::max(m_uParsed, segment.uOffset + segment.uSize);
+	return true;
+}
+
+UINT32 CoreDumpIndexer::Intern(const char* pszName, UINT32 uLength)
+{
+	// Dumps use a handful of owner names, so a scan is enough.
+	size_t uPos = 0;
+	while (uPos < m_strings.size())
+	{
+		const char* pszEntry = &m_strings[uPos];
+		size_t uEntryLength = strlen(pszEntry);
+		if (uEntryLength == uLength && memcmp(pszEntry, pszName, uLength) == 0)
+			return (UINT32)uPos;
+		uPos += uEntryLength + 1;
+	}
+
+	m_strings.insert(m_strings.end(), pszName, pszName + uLength);
+	m_strings.push_back('\0');
+	return (UINT32)uPos;
+}
+
+bool CoreDumpIndexer::Finish(UINT64 uDumpSize, const WCHAR* pszIndexPath)
+{
+	Update(uDumpSize);
+	Close();
+
+	if (m_state != CDI_DONE)
+		return false;
+
+	for (size_t i = 0; i < m_segments.size(); ++i)
+	{
+		if (m_segments[i].uFileOffset + m_segments[i].uFileSize > uDumpSize)
+		{
+			m_state = CDI_CORRUPT;
+			return false;
+		}
+	}
+
+	m_header.uMagic = CORE_DUMP_INDEX_MAGIC;
+	m_header.uVersion = CORE_DUMP_INDEX_VERSION;
+	m_header.uDumpSize = uDumpSize;
+	m_header.uSegmentCount = (UINT32)m_segments.size();
+	m_header.uNoteCount = (UINT32)m_notes.size();
+	m_header.uStringSize = (UINT32)m_strings.size();
+	m_header.uSegmentOffset = sizeof(CoreDumpIndexHeader);
+	m_header.uNoteOffset = m_header.uSegmentOffset + m_segments.size() * sizeof(CoreDumpSegment);
+	m_header.uStringOffset = m_header.uNoteOffset + m_notes.size() * sizeof(CoreDumpNote);
+
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszIndexPath, L"wb") != 0 || !pFile)
+		return false;
+
+	bool bOk = fwrite(&m_header, sizeof(m_header), 1, pFile) == 1 &&
+		WriteArray(pFile, m_segments) && WriteArray(pFile, m_notes) && WriteArray(pFile, m_strings);
+
+	if (fclose(pFile) != 0)
+		bOk = false;
+	if (!bOk)
+		_wremove(pszIndexPath);
+
+	return bOk;
+}
+
+CoreDumpIndex::CoreDumpIndex()
+: m_hIndexFile(INVALID_HANDLE_VALUE)
+, m_hIndexMapping(NULL)
+, m_pIndexView(NULL)
+, m_hDumpFile(INVALID_HANDLE_VALUE)
+, m_hDumpMapping(NULL)
+, m_uDumpSize(0)
+, m_uGranularity(0)
+, m_pHeader(NULL)
+, m_pSegments(NULL)
+, m_pNotes(NULL)
+, m_pStrings(NULL)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	m_uGranularity = info.dwAllocationGranularity;
+}
+
+CoreDumpIndex::~CoreDumpIndex()
+{
+	Close();
+}
+
+std::wstring CoreDumpIndex::GetIndexPath(const WCHAR* pszDumpPath)
+{
+	return std::wstring(pszDumpPath) + CORE_DUMP_INDEX_EXTENSION;
+}
+
+bool CoreDumpIndex::Open(const WCHAR* pszDumpPath, const WCHAR* pszIndexPath)
+{
+	Close();
+
+	std::wstring strIndexPath = pszIndexPath ? pszIndexPath : GetIndexPath(pszDumpPath);
+
+	m_hIndexFile = CreateFileW(strIndexPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (m_hIndexFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hIndexFile, &size) || (UINT64)size.QuadPart < sizeof(CoreDumpIndexHeader) ||
+		(UINT64)size.QuadPart != (SIZE_T)size.QuadPart)
+	{
+		Close();
+		return false;
+	}
+	UINT64 uIndexSize = (UINT64)size.QuadPart;
+
+	m_hIndexMapping = CreateFileMapping(m_hIndexFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hIndexMapping)
+		m_pIndexView = static_cast<const BYTE*>(MapViewOfFile(m_hIndexMapping, FILE_MAP_READ, 0, 0, (SIZE_T)uIndexSize));
+	if (!m_pIndexView)
+	{
+		Close();
+		return false;
+	}
+
+	const CoreDumpIndexHeader* pHeader = reinterpret_cast<const CoreDumpIndexHeader*>(m_pIndexView);
+	if (pHeader->uMagic != CORE_DUMP_INDEX_MAGIC || pHeader->uVersion != CORE_DUMP_INDEX_VERSION ||
+		pHeader->uSegmentOffset > uIndexSize || pHeader->uSegmentCount > (uIndexSize - pHeader->uSegmentOffset) / sizeof(CoreDumpSegment) ||
+		pHeader->uNoteOffset > uIndexSize || pHeader->uNoteCount > (uIndexSize - pHeader->uNoteOffset) / sizeof(CoreDumpNote) ||
+		pHeader->uStringOffset > uIndexSize || pHeader->uStringSize > uIndexSize - pHeader->uStringOffset ||
+		(pHeader->uSegmentOffset & 7) || (pHeader->uNoteOffset & 7))
+	{
+		Close();
+		return false;
+	}
+
+	m_pSegments = reinterpret_cast<const CoreDumpSegment*>(m_pIndexView + pHeader->uSegmentOffset);
+	m_pNotes = reinterpret_cast<const CoreDumpNote*>(m_pIndexView + pHeader->uNoteOffset);
+	m_pStrings = reinterpret_cast<const char*>(m_pIndexView + pHeader->uStringOffset);
+
+	if (pHeader->uNoteCount && (pHeader->uStringSize == 0 || m_pStrings[pHeader->uStringSize - 1] != '\0'))
+	{
+		Close();
+		return false;
+	}
+	for (UINT32 i = 0; i < pHeader->uNoteCount; ++i)
+	{
+		if (m_pNotes[i].uName >= pHeader->uStringSize || m_pNotes[i].uKind >= CDK_COUNT)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	// The dump itself is only mapped a range at a time.
+	m_hDumpFile = CreateFileW(pszDumpPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (m_hDumpFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_hDumpFile, &size) || (UINT64)size.QuadPart != pHeader->uDumpSize)
+	{
+		Close();
+		return false;
+	}
+	m_uDumpSize = (UINT64)size.QuadPart;
+
+	m_hDumpMapping = CreateFileMapping(m_hDumpFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_hDumpMapping)
+	{
+		Close();
+		return false;
+	}
+
+	// An index left over from an earlier dump of the same size must not be
+	// used, so the layout it was built from is compared.
+	UINT64 uHash = HASH_SEED;
+	CoreDumpView view;
+	bool bMatch = Map(0, pHeader->uElfHeaderSize, view);
+	if (bMatch)
+	{
+		uHash = HashBytes(uHash, view.pData, (size_t)view.uSize);
+		Unmap(view);
+		bMatch = Map(pHeader->uProgramHeaderOffset, pHeader->uProgramHeaderBytes, view);
+	}
+	if (bMatch)
+	{
+		uHash = HashBytes(uHash, view.pData, (size_t)view.uSize);
+		Unmap(view);
+		bMatch = uHash == pHeader->uLayoutHash;
+	}
+	if (!bMatch)
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	return true;
+}
+
+void CoreDumpIndex::Close()
+{
+	if (m_pIndexView)
+	{
+		UnmapViewOfFile(m_pIndexView);
+		m_pIndexView = NULL;
+	}
+	if (m_hIndexMapping)
+	{
+		CloseHandle(m_hIndexMapping);
+		m_hIndexMapping = NULL;
+	}
+	if (m_hIndexFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hIndexFile);
+		m_hIndexFile = INVALID_HANDLE_VALUE;
+	}
+	if (m_hDumpMapping)
+	{
+		CloseHandle(m_hDumpMapping);
+		m_hDumpMapping = NULL;
+	}
+	if (m_hDumpFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hDumpFile);
+		m_hDumpFile = INVALID_HANDLE_VALUE;
+	}
+
+	m_uDumpSize = 0;
+	m_pHeader = NULL;
+	m_pSegments = NULL;
+	m_pNotes = NULL;
+	m_pStrings = NULL;
+}
+
+UINT32 CoreDumpIndex::FindSegment(UINT64 uAddress) const
+{
+	UINT32 uLow = 0;
+	UINT32 uHigh = GetSegmentCount();
+
+	// First segment starting above uAddress; the one before it may hold it.
+	while (uLow < uHigh)
+	{
+		UINT32 uMid = uLow + (uHigh - uLow) / 2;
+		if (m_pSegments[uMid].uAddress <= uAddress)
+			uLow = uMid + 1;
+		else
+			uHigh = uMid;
+	}
+
+	if (uLow == 0)
+		return CORE_DUMP_NO_SEGMENT;
+
+	const CoreDumpSegment& segment = m_pSegments[uLow - 1];
+	if (uAddress - segment.uAddress >= segment.uMemorySize)
+		return CORE_DUMP_NO_SEGMENT;
+
+	return uLow - 1;
+}
+
+bool CoreDumpIndex::Map(UINT64 uOffset, UINT64 uSize, CoreDumpView& view) const
+{
+	view = CoreDumpView();
+
+	if (!m_hDumpMapping || uSize == 0 || uOffset > m_uDumpSize || uSize > m_uDumpSize - uOffset)
+		return false;
+
+	UINT64 uBase = uOffset - uOffset % m_uGranularity;
+	UINT64 uLength = uSize + (uOffset - uBase);
+	if (uLength != (SIZE_T)uLength)
+		return false;
+
+	view.pBase = MapViewOfFile(m_hDumpMapping, FILE_MAP_READ, (DWORD)(uBase >> 32), (DWORD)uBase, (SIZE_T)uLength);
+	if (!view.pBase)
+		return false;
+
+	view.pData = static_cast<const BYTE*>(view.pBase) + (uOffset - uBase);
+	view.uSize = uSize;
+	return true;
+}
+
+bool CoreDumpIndex::MapSegment(UINT32 uSegment, CoreDumpView& view) const
+{
+	if (uSegment >= GetSegmentCount())
+		return false;
+
+	// Fails for a segment none of whose pages were saved.
+	return Map(m_pSegments[uSegment].uFileOffset, m_pSegments[uSegment].uFileSize, view);
+}
+
+bool CoreDumpIndex::MapNote(UINT32 uNote, CoreDumpView& view) const
+{
+	if (uNote >= GetNoteCount())
+		return false;
+
+	return Map(m_pNotes[uNote].uDescOffset, m_pNotes[uNote].uDescSize, view);
+}
+
+void CoreDumpIndex::Unmap(CoreDumpView& view)
+{
+	if (view.pBase)
+		UnmapViewOfFile(view.pBase);
+	view = CoreDumpView();
+}
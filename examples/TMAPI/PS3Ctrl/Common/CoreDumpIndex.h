@@ -0,0 +1,210 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef CORE_DUMP_INDEX_H
+#define CORE_DUMP_INDEX_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+// Core dump index, written next to the dump as <dump>.cdix:
+//
+//   CoreDumpIndexHeader
+//   CoreDumpSegment[uSegmentCount], sorted by virtual address
+//   CoreDumpNote[uNoteCount], in file order
+//   string table of note owner names, NUL terminated
+//
+// Dumps are ELF core files. Memory segments come from the PT_LOAD program
+// headers and every record in the PT_NOTE segments gets an entry, so a tool
+// can map any segment or record straight out of the dump. uLayoutHash covers
+// the ELF header and program headers and is checked against the dump when
+// the index is opened.
+
+#define CORE_DUMP_INDEX_MAGIC			(0x58494443)	// 'CDIX'
+#define CORE_DUMP_INDEX_VERSION			(1)
+#define CORE_DUMP_INDEX_EXTENSION		L".cdix"
+#define CORE_DUMP_NO_SEGMENT			(0xffffffff)
+
+// Notes are classified by owner and type where the ELF core conventions give
+// them a meaning. Records under other owners, which includes the lv2 specific
+// ones, are indexed as CDK_OTHER and can still be mapped by owner and type.
+enum CoreDumpNoteKind
+{
+	CDK_OTHER,
+	CDK_PROCESS,			// Process status
+	CDK_THREAD,				// Thread status with its general purpose registers
+	CDK_REGISTERS,			// Floating point or vector registers of the preceding thread
+	CDK_MODULE,				// Mapped files
+	CDK_COUNT
+};
+
+struct CoreDumpIndexHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT64	uDumpSize;
+	UINT64	uLayoutHash;
+	UINT16	uMachine;
+	UINT8	uClass;					// ELFCLASS32 or ELFCLASS64
+	UINT8	uData;					// ELFDATA2LSB or ELFDATA2MSB
+	UINT32	uSegmentCount;
+	UINT32	uNoteCount;
+	UINT32	uStringSize;
+	UINT32	uKindCount[CDK_COUNT];
+	UINT32	uElfHeaderSize;			// uLayoutHash covers these bytes at the start of the dump...
+	UINT64	uProgramHeaderOffset;	// ...and the program headers
+	UINT32	uProgramHeaderBytes;
+	UINT32	uReserved;
+	UINT64	uSegmentOffset;
+	UINT64	uNoteOffset;
+	UINT64	uStringOffset;
+};
+
+struct CoreDumpSegment
+{
+	UINT64	uAddress;
+	UINT64	uFileOffset;
+	UINT64	uFileSize;				// Can be less than uMemorySize if pages were not saved
+	UINT64	uMemorySize;
+	UINT32	uFlags;					// PF_R, PF_W and PF_X
+	UINT32	uProgramHeader;
+};
+
+struct CoreDumpNote
+{
+	UINT64	uDescOffset;			// Offset of the record's data in the dump
+	UINT64	uDescSize;
+	UINT32	uType;
+	UINT32	uName;					// Offset in the string table
+	UINT32	uKind;					// CoreDumpNoteKind
+	UINT32	uProgramHeader;
+};
+
+// Builds an index while the dump is still arriving. Update() is called with
+// the number of bytes written so far and parses whatever has become
+// available: the ELF header, then the program headers, then each note
+// segment once all of it is on disk. Memory segments are never read, so the
+// index is usually complete long before the transfer is.
+class CoreDumpIndexer
+{
+public:
+					CoreDumpIndexer();
+					~CoreDumpIndexer();
+
+	void			Begin(const WCHAR* pszDumpPath);
+	bool			Update(UINT64 uAvailable);
+	bool			Finish(UINT64 uDumpSize, const WCHAR* pszIndexPath);
+
+	bool			IsComplete() const { return m_state == CDI_DONE; }
+	bool			IsCorrupt() const { return m_state == CDI_CORRUPT; }
+	UINT64			GetParsedBytes() const { return m_uParsed; }
+	size_t			GetSegmentCount() const { return m_segments.size(); }
+	size_t			GetNoteCount() const { return m_notes.size(); }
+	UINT32			GetKindCount(CoreDumpNoteKind kind) const { return m_header.uKindCount[kind]; }
+
+private:
+	enum State
+	{
+		CDI_ELF_HEADER,
+		CDI_PROGRAM_HEADERS,
+		CDI_NOTES,
+		CDI_DONE,
+		CDI_CORRUPT
+	};
+
+	struct NoteSegment
+	{
+		UINT64	uOffset;
+		UINT64	uSize;
+		UINT32	uProgramHeader;
+	};
+
+	UINT16			Get16(const BYTE* p) const { return m_bBigEndian ? (UINT16)((p[0] << 8) | p[1]) : (UINT16)((p[1] << 8) | p[0]); }
+	UINT32			Get32(const BYTE* p) const { return m_bBigEndian ? ((UINT32)Get16(p) << 16) | Get16(p + 2) : ((UINT32)Get16(p + 2) << 16) | Get16(p); }
+	UINT64			Get64(const BYTE* p) const { return m_bBigEndian ? ((UINT64)Get32(p) << 32) | Get32(p + 4) : ((UINT64)Get32(p + 4) << 32) | Get32(p); }
+
+	bool			ReadAt(UINT64 uOffset, void* pBuffer, UINT32 uSize);
+	bool			ParseElfHeader();
+	bool			ParseProgramHeaders();
+	bool			ParseNotes(const NoteSegment& segment);
+	UINT32			Intern(const char* pszName, UINT32 uLength);
+	void			Close();
+
+	std::wstring				m_strDumpPath;
+	HANDLE						m_hFile;
+	State						m_state;
+	UINT64						m_uAvailable;
+	UINT64						m_uParsed;		// Bytes the parsed structures end at
+
+	bool						m_bBigEndian;
+	UINT64						m_uProgramHeaderOffset;
+	UINT32						m_uProgramHeaderSize;
+	UINT32						m_uProgramHeaderCount;
+	std::vector<BYTE>			m_layout;		// ELF header and program headers, for the hash
+
+	CoreDumpIndexHeader			m_header;
+	std::vector<CoreDumpSegment>	m_segments;
+	std::vector<CoreDumpNote>	m_notes;
+	std::vector<NoteSegment>	m_noteSegments;	// Not yet parsed, by offset
+	std::vector<char>			m_strings;
+};
+
+// A view of part of the dump; Map() rounds down to the allocation
+// granularity, pData points at the requested offset.
+struct CoreDumpView
+{
+					CoreDumpView() : pBase(NULL), pData(NULL), uSize(0) {}
+
+	void*			pBase;
+	const BYTE*		pData;
+	UINT64			uSize;
+};
+
+// Opens a dump through its index. The index is mapped whole; the dump is
+// only mapped a range at a time, since a dump can be larger than the address
+// space left to a 32 bit process.
+class CoreDumpIndex
+{
+public:
+					CoreDumpIndex();
+					~CoreDumpIndex();
+
+	bool			Open(const WCHAR* pszDumpPath, const WCHAR* pszIndexPath = NULL);
+	void			Close();
+
+	const CoreDumpIndexHeader& GetHeader() const { return *m_pHeader; }
+	UINT32			GetSegmentCount() const { return m_pHeader ? m_pHeader->uSegmentCount : 0; }
+	const CoreDumpSegment& GetSegment(UINT32 uSegment) const { return m_pSegments[uSegment]; }
+	UINT32			GetNoteCount() const { return m_pHeader ? m_pHeader->uNoteCount : 0; }
+	const CoreDumpNote&	GetNote(UINT32 uNote) const { return m_pNotes[uNote]; }
+	const char*		GetNoteName(UINT32 uNote) const { return m_pStrings + m_pNotes[uNote].uName; }
+
+	// Segment holding uAddress, or CORE_DUMP_NO_SEGMENT.
+	UINT32			FindSegment(UINT64 uAddress) const;
+
+	bool			Map(UINT64 uOffset, UINT64 uSize, CoreDumpView& view) const;
+	bool			MapSegment(UINT32 uSegment, CoreDumpView& view) const;
+	bool			MapNote(UINT32 uNote, CoreDumpView& view) const;
+	static void		Unmap(CoreDumpView& view);
+
+	static std::wstring	GetIndexPath(const WCHAR* pszDumpPath);
+
+private:
+	HANDLE						m_hIndexFile;
+	HANDLE						m_hIndexMapping;
+	const BYTE*					m_pIndexView;
+	HANDLE						m_hDumpFile;
+	HANDLE						m_hDumpMapping;
+	UINT64						m_uDumpSize;
+	UINT32						m_uGranularity;
+	const CoreDumpIndexHeader*	m_pHeader;
+	const CoreDumpSegment*		m_pSegments;
+	const CoreDumpNote*			m_pNotes;
+	const char*					m_pStrings;
+};
+
+#endif
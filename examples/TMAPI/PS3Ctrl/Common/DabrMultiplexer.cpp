@@ -0,0 +1,278 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "DabrMultiplexer.h"
+#include "ProcessStop.h"
+#include <algorithm>
+
+DabrMultiplexer::DabrMultiplexer(HTARGET hTarget, UINT32 uProcessId, MatWatchManager* pMat, bool bUseDabr, UINT32 uMatPages)
+: m_hTarget(hTarget)
+, m_uProcessId(uProcessId)
+, m_pMat(pMat)
+, m_bUseDabr(bUseDabr)
+, m_uMatPages(uMatPages)
+, m_uNextId(1)
+, m_uDabrId(0)
+, m_uMatArmed(0)
+, m_uUnarmed(0)
+{
+}
+
+UINT32 DabrMultiplexer::Add(UINT32 uAddress, UINT32 uSize, BYTE uCondition, const std::string& strOwner, DWORD dwNow)
+{
+	if (uSize == 0 || (uCondition != SNPS3_MAT_COND_WRITE && uCondition != SNPS3_MAT_COND_READ_WRITE))
+		return 0;
+
+	LogicalWatch watch;
+	watch.uAddress = uAddress;
+	watch.uSize = uSize;
+	watch.uCondition = uCondition;
+	watch.strOwner = strOwner;
+	watch.bDabrFits = m_bUseDabr && uSize <= DABR_SIZE && (uAddress & ~(DABR_SIZE - 1)) == ((uAddress + uSize - 1) & ~(DABR_SIZE - 1));
+
+	// Tried and taken back at once; Apply() sends nothing for it.
+	UINT32 uMatId = m_pMat ? m_pMat->Add(uAddress, uSize, uCondition, strOwner) : 0;
+	watch.bMatFits = uMatId != 0;
+	if (uMatId)
+		m_pMat->Remove(uMatId);
+
+	if (!watch.bDabrFits && !watch.bMatFits)
+		return 0;
+
+	watch.eArmed = WA_NONE;
+	watch.uMatId = 0;
+	watch.dwAdded = dwNow;
+	watch.dwArmedSince = dwNow;
+	watch.dwDabrTime = 0;
+	watch.dwMatTime = 0;
+
+	UINT32 uId = m_uNextId++;
+	m_watches[uId] = watch;
+	return uId;
+}
+
+bool DabrMultiplexer::Remove(UINT32 uId, DWORD dwNow)
+{
+	std::map<UINT32, LogicalWatch>::iterator it = m_watches.find(uId);
+	if (it == m_watches.end())
+		return false;
+
+	SetArming(uId, WA_NONE, dwNow);
+	m_watches.erase(it);
+	return true;
+}
+
+void DabrMultiplexer::RemoveAll(DWORD dwNow)
+{
+	while (!m_watches.empty())
+		Remove(m_watches.begin()->first, dwNow);
+}
+
+SNRESULT DabrMultiplexer::Rotate(DWORD dwNow)
+{
+	std::vector<UINT32> order;
+	GetWatchIds(order);
+
+	CoverageOrder less;
+	less.pMux = this;
+	less.dwNow = dwNow;
+	std::stable_sort(order.begin(), order.end(), less);
+
+	// The least covered watch the DABR can take gets it; the rest are
+	// trapped with MAT in the same order, while the pages last.
+	UINT32 uDabrId = 0;
+	std::set<UINT32> pages;
+	m_uMatArmed = 0;
+	m_uUnarmed = 0;
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		LogicalWatch& watch = m_watches[order[i]];
+
+		if (!uDabrId && watch.bDabrFits)
+		{
+			uDabrId = order[i];
+			SetArming(order[i], WA_DABR, dwNow);
+			continue;
+		}
+
+		if (watch.bMatFits)
+		{
+			std::set<UINT32> watchPages;
+			UINT32 uLastPage = (watch.uAddress + (watch.uSize - 1)) & ~(UINT32)(MAT_PAGE_SIZE - 1);
+			for (UINT32 uPage = watch.uAddress & ~(UINT32)(MAT_PAGE_SIZE - 1); ; uPage += MAT_PAGE_SIZE)
+			{
+				if (!pages.count(uPage))
+					watchPages.insert(uPage);
+				if (uPage == uLastPage)
+					break;
+			}
+
+			if (!m_uMatPages || pages.size() + watchPages.size() <= m_uMatPages)
+			{
+				pages.insert(watchPages.begin(), watchPages.end());
+				SetArming(order[i], WA_MAT, dwNow);
+				m_uMatArmed++;
+				continue;
+			}
+		}
+
+		SetArming(order[i], WA_NONE, dwNow);
+		m_uUnarmed++;
+	}
+
+	SNRESULT snr = SN_S_OK;
+	if (m_pMat)
+		snr = m_pMat->Apply();
+
+	if (uDabrId != m_uDabrId)
+	{
+		SNRESULT snrDabr = SetDabr(uDabrId);
+		if (SN_SUCCEEDED(snr))
+			snr = snrDabr;
+	}
+
+	return snr;
+}
+
+SNRESULT DabrMultiplexer::Disarm(UINT32 uId, DWORD dwNow)
+{
+	std::map<UINT32, LogicalWatch>::iterator it = m_watches.find(uId);
+	if (it == m_watches.end())
+		return SN_S_OK;
+
+	WatchArming eArmed = it->second.eArmed;
+	SetArming(uId, WA_NONE, dwNow);
+
+	if (eArmed == WA_MAT)
+		return m_pMat->Apply();
+	if (eArmed == WA_DABR)
+		return SetDabr(0);
+	return SN_S_OK;
+}
+
+void DabrMultiplexer::FindMatHits(UINT64 uAddress, bool bStore, std::vector<UINT32>& hits) const
+{
+	if (!m_pMat)
+		return;
+
+	std::vector<UINT32> matHits;
+	m_pMat->FindHits(uAddress, bStore, matHits);
+	for (size_t i = 0; i < matHits.size(); ++i)
+		hits.push_back(m_matIds.find(matHits[i])->second);
+}
+
+void DabrMultiplexer::GetMatPageWatches(UINT64 uAddress, std::vector<UINT32>& watches) const
+{
+	if (!m_pMat)
+		return;
+
+	std::vector<UINT32> matWatches;
+	m_pMat->GetPageWatches(uAddress, matWatches);
+	for (size_t i = 0; i < matWatches.size(); ++i)
+		watches.push_back(m_matIds.find(matWatches[i])->second);
+}
+
+const LogicalWatch* DabrMultiplexer::GetWatch(UINT32 uId) const
+{
+	std::map<UINT32, LogicalWatch>::const_iterator it = m_watches.find(uId);
+	return it == m_watches.end() ? NULL : &it->second;
+}
+
+void DabrMultiplexer::GetWatchIds(std::vector<UINT32>& ids) const
+{
+	for (std::map<UINT32, LogicalWatch>::const_iterator it = m_watches.begin(); it != m_watches.end(); ++it)
+		ids.push_back(it->first);
+}
+
+void DabrMultiplexer::GetCoverage(UINT32 uId, DWORD dwNow, double& dDabr, double& dMat) const
+{
+	dDabr = 0.0;
+	dMat = 0.0;
+
+	const LogicalWatch* pWatch = GetWatch(uId);
+	if (!pWatch || dwNow == pWatch->dwAdded)
+		return;
+
+	DWORD dwDabr = pWatch->dwDabrTime + (pWatch->eArmed == WA_DABR ? dwNow - pWatch->dwArmedSince : 0);
+	DWORD dwMat = pWatch->dwMatTime + (pWatch->eArmed == WA_MAT ? dwNow - pWatch->dwArmedSince : 0);
+	dDabr = (double)dwDabr / (dwNow - pWatch->dwAdded);
+	dMat = (double)dwMat / (dwNow - pWatch->dwAdded);
+}
+
+bool DabrMultiplexer::CoverageOrder::operator()(UINT32 a, UINT32 b) const
+{
+	const LogicalWatch& watchA = pMux->m_watches.find(a)->second;
+	const LogicalWatch& watchB = pMux->m_watches.find(b)->second;
+
+	// armedA / lifeA < armedB / lifeB, without dividing by a life of 0.
+	UINT64 uLifeA = dwNow - watchA.dwAdded;
+	UINT64 uLifeB = dwNow - watchB.dwAdded;
+	if (uLifeA == 0 || uLifeB == 0)
+		return uLifeA == 0 && uLifeB != 0;
+
+	return pMux->GetArmedTime(watchA, dwNow) * uLifeB < pMux->GetArmedTime(watchB, dwNow) * uLifeA;
+}
+
+void DabrMultiplexer::SetArming(UINT32 uId, WatchArming eArmed, DWORD dwNow)
+{
+	LogicalWatch& watch = m_watches[uId];
+	if (watch.eArmed == eArmed)
+		return;
+
+	if (watch.eArmed == WA_DABR)
+		watch.dwDabrTime += dwNow - watch.dwArmedSince;
+	else if (watch.eArmed == WA_MAT)
+		watch.dwMatTime += dwNow - watch.dwArmedSince;
+
+	if (watch.eArmed == WA_MAT)
+	{
+		m_pMat->Remove(watch.uMatId);
+		m_matIds.erase(watch.uMatId);
+		watch.uMatId = 0;
+	}
+
+	if (eArmed == WA_MAT)
+	{
+		watch.uMatId = m_pMat->Add(watch.uAddress, watch.uSize, watch.uCondition, watch.strOwner);
+		m_matIds[watch.uMatId] = uId;
+	}
+
+	watch.eArmed = eArmed;
+	watch.dwArmedSince = dwNow;
+}
+
+DWORD DabrMultiplexer::GetArmedTime(const LogicalWatch& watch, DWORD dwNow) const
+{
+	return watch.dwDabrTime + watch.dwMatTime + (watch.eArmed != WA_NONE ? dwNow - watch.dwArmedSince : 0);
+}
+
+SNRESULT DabrMultiplexer::SetDabr(UINT32 uId)
+{
+	// All of the PPU threads have to be stopped to change it; those already
+	// stopped, at a trap or by the user, stay stopped.
+	ProcessStop stop(m_hTarget, m_uProcessId);
+	SNRESULT snr = stop.Stop();
+	if (SN_FAILED(snr))
+		return snr;
+
+	UINT64 uValue = uId ? GetDabrValue(m_watches[uId]) : 0;
+	snr = SNPS3SetDABR(m_hTarget, m_uProcessId, uValue);
+	if (SN_SUCCEEDED(snr))
+		m_uDabrId = uId;
+
+	SNRESULT snrContinue = stop.Continue();
+	return SN_FAILED(snr) ? snr : snrContinue;
+}
+
+UINT64 DabrMultiplexer::GetDabrValue(const LogicalWatch& watch)
+{
+	UINT64 uValue = watch.uAddress & ~(UINT64)(DABR_SIZE - 1);
+	uValue |= DABR_WRITE;
+	if (watch.uCondition == SNPS3_MAT_COND_READ_WRITE)
+		uValue |= DABR_READ;
+	return uValue;
+}
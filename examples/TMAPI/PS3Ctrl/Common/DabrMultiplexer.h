@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef DABR_MULTIPLEXER_H
+#define DABR_MULTIPLEXER_H
+
+#include "MatWatch.h"
+
+// The DABR covers one aligned doubleword; its low bits say which accesses
+// it breaks on.
+#define DABR_SIZE				(8)
+#define DABR_READ				(0x1)
+#define DABR_WRITE				(0x2)
+
+enum WatchArming
+{
+	WA_NONE,
+	WA_DABR,
+	WA_MAT
+};
+
+struct LogicalWatch
+{
+	UINT32			uAddress;
+	UINT32			uSize;
+	BYTE			uCondition;			// SNPS3_MAT_COND_WRITE or SNPS3_MAT_COND_READ_WRITE
+	std::string		strOwner;
+	bool			bDabrFits;			// Within one doubleword
+	bool			bMatFits;			// Within the ranges traps can be set in
+
+	WatchArming		eArmed;
+	UINT32			uMatId;				// While armed with MAT
+	DWORD			dwAdded;
+	DWORD			dwArmedSince;
+	DWORD			dwDabrTime;			// Milliseconds armed each way, before dwArmedSince
+	DWORD			dwMatTime;
+};
+
+// Shares the one data address breakpoint of a process between any number
+// of watches. Each Rotate() gives the DABR to the watch that has been armed
+// for the smallest share of its life, and traps the pages of the next ones
+// with MAT, up to a budget of pages; the rest wait for a later turn. Only
+// the arming that changed is sent, and the process is stopped only when the
+// DABR moves.
+class DabrMultiplexer
+{
+public:
+	// pMat may be NULL, to use the DABR alone; a uMatPages of 0 is no limit.
+						DabrMultiplexer(HTARGET hTarget, UINT32 uProcessId, MatWatchManager* pMat, bool bUseDabr, UINT32 uMatPages);
+
+	// Returns the id of the new watch, or 0 if nothing can arm it. Watches
+	// added or removed are armed or disarmed by the next Rotate().
+	UINT32				Add(UINT32 uAddress, UINT32 uSize, BYTE uCondition, const std::string& strOwner, DWORD dwNow);
+	bool				Remove(UINT32 uId, DWORD dwNow);
+	void				RemoveAll(DWORD dwNow);
+	SNRESULT			Rotate(DWORD dwNow);
+	// Until the next Rotate(), so a thread stopped by it can get past.
+	SNRESULT			Disarm(UINT32 uId, DWORD dwNow);
+
+	// A DABR match does not say what address it was for, so it goes to
+	// whichever watch has the DABR.
+	UINT32				GetDabrWatch() const { return m_uDabrId; }
+	void				FindMatHits(UINT64 uAddress, bool bStore, std::vector<UINT32>& hits) const;
+	void				GetMatPageWatches(UINT64 uAddress, std::vector<UINT32>& watches) const;
+
+	const LogicalWatch*	GetWatch(UINT32 uId) const;
+	void				GetWatchIds(std::vector<UINT32>& ids) const;
+	UINT32				GetWatchCount() const { return (UINT32)m_watches.size(); }
+	// Shares of the life of the watch it was armed for, by each
+	void				GetCoverage(UINT32 uId, DWORD dwNow, double& dDabr, double& dMat) const;
+	// Of the last Rotate()
+	UINT32				GetMatArmedCount() const { return m_uMatArmed; }
+	UINT32				GetUnarmedCount() const { return m_uUnarmed; }
+
+private:
+	struct CoverageOrder
+	{
+		const DabrMultiplexer*	pMux;
+		DWORD					dwNow;
+		bool operator()(UINT32 a, UINT32 b) const;
+	};
+
+	void				SetArming(UINT32 uId, WatchArming eArmed, DWORD dwNow);
+	DWORD				GetArmedTime(const LogicalWatch& watch, DWORD dwNow) const;
+	SNRESULT			SetDabr(UINT32 uId);
+	static UINT64		GetDabrValue(const LogicalWatch& watch);
+
+	HTARGET							m_hTarget;
+	UINT32							m_uProcessId;
+	MatWatchManager*				m_pMat;
+	bool							m_bUseDabr;
+	UINT32							m_uMatPages;
+	std::map<UINT32, LogicalWatch>	m_watches;
+	std::map<UINT32, UINT32>		m_matIds;		// Logical watch of each MAT watch
+	UINT32							m_uNextId;
+	UINT32							m_uDabrId;		// Watch the DABR is set for, 0 for none
+	UINT32							m_uMatArmed;
+	UINT32							m_uUnarmed;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "DebugEventCommand.h"
+
+DebugEventCommand::DebugEventCommand()
+: TargetCommand()
+, m_processId(INVALID_PROCESS)
+, m_bContinue(false)
+, m_uTimeout(0)
+{
+
+}
+
+DebugEventCommand::~DebugEventCommand()
+{
+
+}
+
+void DebugEventCommand::AddSpecs(const std::string& strFile, const std::vector<std::string>& arguments, const char* pszNoun,
+	const char* pszForm)
+{
+	if (!strFile.empty() && !ReadSpecFile(strFile, pszNoun))
+	{
+		std::string strError = std::string("Error - Could not read ") + pszNoun + " file " + strFile;
+		throw ArgumentException(strError);
+	}
+
+	for (size_t i = 0; i < arguments.size(); ++i)
+	{
+		if (!AddSpec(arguments[i]))
+		{
+			std::string strError = std::string("Error - Invalid ") + pszNoun + " " + arguments[i] + ", expected " + pszForm;
+			throw ArgumentException(strError);
+		}
+	}
+}
+
+bool DebugEventCommand::ReadSpecFile(const std::string& strPath, const char* pszNoun)
+{
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, UTF8ToWChar(strPath).c_str(), L"r") != 0 || !pFile)
+		return false;
+
+	// One a line, as on the command line; # starts a comment.
+	char szLine[1024];
+	UINT32 uLine = 0;
+	bool bOK = true;
+	while (fgets(szLine, sizeof(szLine), pFile))
+	{
+		uLine++;
+		szLine[strcspn(szLine, "#\r\n")] = '\0';
+
+		char* pStart = szLine + strspn(szLine, " \t");
+		char* pEnd = pStart + strlen(pStart);
+		while (pEnd > pStart && (pEnd[-1] == ' ' || pEnd[-1] == '\t'))
+			*--pEnd = '\0';
+
+		if (*pStart == '\0')
+			continue;
+
+		if (!AddSpec(pStart))
+		{
+			PrintMessage(ML_ERROR, L"%s(%u): invalid %s %s\n", UTF8ToWChar(strPath).c_str(), uLine, UTF8ToWChar(pszNoun).c_str(),
+				UTF8ToWChar(pStart).c_str());
+			bOK = false;
+		}
+	}
+
+	fclose(pFile);
+	return bOK;
+}
+
+bool DebugEventCommand::RegisterHandler()
+{
+	SNRESULT snr;
+	if (SN_FAILED(snr = SNPS3RegisterTargetEventHandler(m_targetId, EventCallback, this)))
+	{
+		PrintError(snr, L"Failed to register for target events");
+		return false;
+	}
+	return true;
+}
+
+void DebugEventCommand::UnRegisterHandler()
+{
+	SNPS3CancelTargetEvents(m_targetId);
+}
+
+void DebugEventCommand::PumpEvents()
+{
+	DWORD dwStart = GetTickCount();
+
+	for (;;)
+	{
+		while (SNPS3Kick() == SN_S_OK)
+			/* Do nothing */;
+
+		HandleEvents();
+
+		if (CheckForEscape())
+			break;
+
+		if (m_uTimeout && GetTickCount() - dwStart >= m_uTimeout * 1000)
+			break;
+
+		OnIdle();
+
+		::Sleep(10);
+	}
+}
+
+void __stdcall DebugEventCommand::EventCallback(HTARGET /*hTarget*/, UINT uEventType, UINT /*uEventParam*/, SNRESULT snr,
+	UINT uDataLen, BYTE* pData, void* pUser)
+{
+	DebugEventCommand* pCommand = static_cast<DebugEventCommand*>(pUser);
+
+	if (SN_FAILED(snr) || !pCommand || !pData)
+		return;
+
+	if (uEventType == SN_EVENT_TARGET)
+		pCommand->ProcessTargetEvent(uDataLen, pData);
+}
+
+void DebugEventCommand::ProcessTargetEvent(UINT uDataLen, BYTE* pData)
+{
+	UINT uDataRemaining = uDataLen;
+
+	while (uDataRemaining >= sizeof(SN_EVENT_TARGET_HDR))
+	{
+		SN_EVENT_TARGET_HDR* pHeader = (SN_EVENT_TARGET_HDR*)pData;
+		if (pHeader->uSize < sizeof(SN_EVENT_TARGET_HDR) || pHeader->uSize > uDataRemaining)
+			break;
+
+		if (pHeader->uEvent == SN_TGT_EVENT_TARGET_SPECIFIC &&
+			pHeader->uSize >= sizeof(SN_EVENT_TARGET_HDR) + sizeof(SNPS3_DBG_EVENT_HDR) + sizeof(SNPS3_DBG_EVENT_DATA))
+		{
+			SNPS3_DBG_EVENT_HDR* pDbgHeader = (SNPS3_DBG_EVENT_HDR*)(pData + sizeof(SN_EVENT_TARGET_HDR));
+			SNPS3_DBG_EVENT_DATA* pDbgData = (SNPS3_DBG_EVENT_DATA*)(pData + sizeof(SN_EVENT_TARGET_HDR) + sizeof(SNPS3_DBG_EVENT_HDR));
+
+			if (pDbgHeader->uProcessID == m_processId)
+				OnDebugEvent(*pDbgData);
+		}
+
+		uDataRemaining -= pHeader->uSize;
+		pData += pHeader->uSize;
+	}
+}
@@ -0,0 +1,54 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef DEBUG_EVENT_COMMAND_H
+#define DEBUG_EVENT_COMMAND_H
+
+#include "TargetCommand.h"
+
+// The skeleton of a command that arms something in a process, from specs on
+// the command line or in a file, then waits for the debug events it raises
+// until ESC or a timeout.
+//
+// The event handler only passes the debug events of the process to
+// OnDebugEvent(), during SNPS3Kick(); HandleEvents() then deals with them
+// between kicks, as handling them calls the target.
+class DebugEventCommand : public TargetCommand
+{
+public:
+					DebugEventCommand();
+	virtual			~DebugEventCommand();
+
+protected:
+	// Passes the specs in strFile, if any, then those in arguments to
+	// AddSpec(); pszNoun names what a spec is in errors, pszForm its form.
+	void			AddSpecs(const std::string& strFile, const std::vector<std::string>& arguments, const char* pszNoun,
+						const char* pszForm);
+	virtual bool	AddSpec(const std::string& strSpec) = 0;
+
+	bool			RegisterHandler();
+	void			UnRegisterHandler();
+	// Returns when ESC is pressed or m_uTimeout has passed.
+	void			PumpEvents();
+
+	virtual void	OnDebugEvent(const SNPS3_DBG_EVENT_DATA& data) = 0;
+	virtual void	HandleEvents() = 0;
+	// Between kicks, after HandleEvents().
+	virtual void	OnIdle() {}
+
+	UINT32			m_processId;
+	bool			m_bContinue;
+	UINT32			m_uTimeout;			// Seconds to wait for, 0 for no limit
+
+private:
+	bool			ReadSpecFile(const std::string& strPath, const char* pszNoun);
+	void			ProcessTargetEvent(UINT uDataLen, BYTE* pData);
+
+	static void __stdcall EventCallback(HTARGET hTarget, UINT uEventType, UINT uEventParam, SNRESULT snr,
+		UINT uDataLen, BYTE* pData, void* pUser);
+};
+
+#endif
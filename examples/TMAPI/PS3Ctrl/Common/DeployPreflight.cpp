@@ -0,0 +1,150 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "DeployPreflight.h"
+
+namespace
+{
+	UINT64 RoundToBlocks(UINT64 uBytes, UINT32 uBlockSize)
+	{
+		return uBlockSize ? (uBytes + uBlockSize - 1) / uBlockSize * uBlockSize : uBytes;
+	}
+}
+
+std::string GetFileSystemRoot(const std::string& strTargetPath)
+{
+	if (strTargetPath.empty() || strTargetPath[0] != '/')
+		return "";
+
+	size_t uSlash = strTargetPath.find('/', 1);
+	return uSlash == std::string::npos ? strTargetPath + "/" : strTargetPath.substr(0, uSlash + 1);
+}
+
+SNRESULT GetFileSystemFreeSpace(HTARGET hTarget, const std::string& strTargetPath, UINT32& uBlockSize, UINT64& uFreeBytes)
+{
+	std::string strRoot = GetFileSystemRoot(strTargetPath);
+	if (strRoot.empty())
+		return SN_E_BAD_PARAM;
+
+	UINT64 uFreeBlocks = 0;
+	SNRESULT snr = SNPS3FSGetFreeSize(hTarget, strRoot.c_str(), &uBlockSize, &uFreeBlocks);
+	if (SN_SUCCEEDED(snr))
+		uFreeBytes = uFreeBlocks * uBlockSize;
+	return snr;
+}
+
+DeployPreflight::DeployPreflight(RemoteTreeCache& cache)
+: m_cache(cache)
+, m_uSourceBytes(0)
+, m_uReplacedBytes(0)
+, m_uRequiredBytes(0)
+, m_uFreeBytes(0)
+{
+}
+
+bool DeployPreflight::AddFile(const std::string& strLocal, const std::string& strRemote)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!::GetFileAttributesExW(UTF8ToWChar(strLocal).c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	PlannedFile file;
+	file.strRemote = RemoteTreeCache::Normalize(strRemote);
+	file.uSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	m_files.push_back(file);
+
+	AddDestination(RemoteTreeCache::GetParent(file.strRemote), false);
+	return true;
+}
+
+bool DeployPreflight::AddDirectory(const std::string& strLocal, const std::string& strRemote)
+{
+	std::string strDestination = RemoteTreeCache::Normalize(strRemote);
+	AddDestination(strDestination, true);
+	return AddLocalDirectory(UTF8ToWChar(strLocal), strDestination);
+}
+
+bool DeployPreflight::AddLocalDirectory(const std::wstring& strLocal, const std::string& strRemote)
+{
+	WIN32_FIND_DATAW data;
+	HANDLE hFind = ::FindFirstFileW((strLocal + L"\\*").c_str(), &data);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool bOK = true;
+	do
+	{
+		if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+			continue;
+
+		std::string strName;
+		if (!WCharToUTF8(data.cFileName, strName))
+		{
+			bOK = false;
+			continue;
+		}
+
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (!AddLocalDirectory(strLocal + L"\\" + data.cFileName, RemoteTreeCache::Join(strRemote, strName)))
+				bOK = false;
+		}
+		else
+		{
+			PlannedFile file;
+			file.strRemote = RemoteTreeCache::Join(strRemote, strName);
+			file.uSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+			m_files.push_back(file);
+		}
+	}
+	while (::FindNextFileW(hFind, &data));
+
+	::FindClose(hFind);
+	return bOK;
+}
+
+void DeployPreflight::AddDestination(const std::string& strDirectory, bool bRecursive)
+{
+	if (m_strFileSystem.empty())
+		m_strFileSystem = GetFileSystemRoot(strDirectory);
+
+	bool& bListTree = m_destinations[strDirectory];
+	bListTree = bListTree || bRecursive;
+}
+
+SNRESULT DeployPreflight::Check(UINT32 uMaxInFlight)
+{
+	UINT32 uBlockSize = 0;
+	SNRESULT snr = GetFileSystemFreeSpace(m_cache.GetTarget(), m_strFileSystem, uBlockSize, m_uFreeBytes);
+	if (SN_FAILED(snr))
+		return snr;
+
+	// Listing the destinations up front answers every stat below from the
+	// cache, including those of files that do not exist yet. Destinations
+	// that do not exist yet simply fail to list.
+	for (std::map<std::string, bool>::const_iterator it = m_destinations.begin(); it != m_destinations.end(); ++it)
+	{
+		RemoteTreeWalker walker(m_cache);
+		if (walker.Start(it->first, it->second, uMaxInFlight, NULL, NULL))
+			walker.Wait(INFINITE);
+	}
+
+	UINT64 uWritten = 0;
+	m_uSourceBytes = 0;
+	m_uReplacedBytes = 0;
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		m_uSourceBytes += m_files[i].uSize;
+		uWritten += RoundToBlocks(m_files[i].uSize, uBlockSize);
+
+		RemoteFileInfo info;
+		if (SN_SUCCEEDED(m_cache.Stat(m_files[i].strRemote, info)) && info.uType == SNPS3_DIRENT_TYPE_REGULAR)
+			m_uReplacedBytes += RoundToBlocks(info.uSize, uBlockSize);
+	}
+
+	m_uRequiredBytes = uWritten > m_uReplacedBytes ? uWritten - m_uReplacedBytes : 0;
+	return snr;
+}
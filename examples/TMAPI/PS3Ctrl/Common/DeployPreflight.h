@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef DEPLOY_PREFLIGHT_H
+#define DEPLOY_PREFLIGHT_H
+
+#include "RemoteTree.h"
+
+// The file system a target path is on, as SNPS3FSGetFreeSize() takes it,
+// e.g. "/dev_hdd0/"; empty if the path is not absolute.
+std::string			GetFileSystemRoot(const std::string& strTargetPath);
+SNRESULT			GetFileSystemFreeSpace(HTARGET hTarget, const std::string& strTargetPath, UINT32& uBlockSize, UINT64& uFreeBytes);
+
+// Works out whether an upload fits before any of it is transferred: the
+// bytes to be written, less those of the target files they replace, in
+// whole blocks of the destination file system, against its free blocks.
+class DeployPreflight
+{
+public:
+						DeployPreflight(RemoteTreeCache& cache);
+
+	// strRemote is the target path the local file or directory is written to.
+	bool				AddFile(const std::string& strLocal, const std::string& strRemote);
+	bool				AddDirectory(const std::string& strLocal, const std::string& strRemote);
+
+	// Lists the destinations, up to uMaxInFlight directories at a time, to
+	// find the files replaced, then gets the free space.
+	SNRESULT			Check(UINT32 uMaxInFlight);
+	bool				HasRoom() const { return m_uRequiredBytes <= m_uFreeBytes; }
+
+	const std::string&	GetFileSystem() const { return m_strFileSystem; }
+	UINT32				GetFileCount() const { return (UINT32)m_files.size(); }
+	UINT64				GetSourceBytes() const { return m_uSourceBytes; }
+	UINT64				GetReplacedBytes() const { return m_uReplacedBytes; }
+	UINT64				GetRequiredBytes() const { return m_uRequiredBytes; }
+	UINT64				GetFreeBytes() const { return m_uFreeBytes; }
+
+private:
+	struct PlannedFile
+	{
+		std::string		strRemote;
+		UINT64			uSize;
+	};
+
+	void				AddDestination(const std::string& strDirectory, bool bRecursive);
+	bool				AddLocalDirectory(const std::wstring& strLocal, const std::string& strRemote);
+
+	RemoteTreeCache&					m_cache;
+	std::vector<PlannedFile>			m_files;
+	std::map<std::string, bool>			m_destinations;		// Directory, and whether to list the tree under it
+	std::string							m_strFileSystem;
+	UINT64								m_uSourceBytes;
+	UINT64								m_uReplacedBytes;
+	UINT64								m_uRequiredBytes;
+	UINT64								m_uFreeBytes;
+};
+
+#endif
@@ -0,0 +1,413 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "DirectoryDownload.h"
+#include "RecordFile.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOWNLOAD_JOURNAL_HEADER		"# PS3Ctrl download journal 1: relative path, size, modified time"
+
+namespace
+{
+	struct JournalEntry
+	{
+		UINT64	uSize;
+		UINT64	uModifiedTime;
+	};
+
+	bool GetLocalFileSize(const std::wstring& strPath, UINT64& uSize)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!::GetFileAttributesExW(strPath.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			return false;
+
+		uSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		return true;
+	}
+}
+
+DirectoryDownload::DirectoryDownload(RemoteTreeCache& cache, const std::string& strRemoteRoot, const std::string& strLocalRoot)
+: m_cache(cache)
+, m_strRemoteRoot(RemoteTreeCache::Normalize(strRemoteRoot))
+, m_strLocalRoot(strLocalRoot)
+, m_pJournal(NULL)
+, m_uNext(0)
+, m_uTotalBytes(0)
+, m_bCancel(false)
+{
+	while (!m_strLocalRoot.empty() && (m_strLocalRoot[m_strLocalRoot.size() - 1] == '\\' || m_strLocalRoot[m_strLocalRoot.size() - 1] == '/'))
+		m_strLocalRoot.erase(m_strLocalRoot.size() - 1);
+
+	m_strJournalPath = UTF8ToWChar(m_strLocalRoot + "\\" + DOWNLOAD_JOURNAL_FILE_NAME);
+	ZeroMemory(m_auCounts, sizeof(m_auCounts));
+}
+
+DirectoryDownload::~DirectoryDownload()
+{
+	if (m_pJournal)
+		fclose(m_pJournal);
+}
+
+SNRESULT DirectoryDownload::Enumerate(UINT32 uMaxInFlight)
+{
+	m_files.clear();
+	m_order.clear();
+	m_uNext = 0;
+	m_uTotalBytes = 0;
+	ZeroMemory(m_auCounts, sizeof(m_auCounts));
+
+	RemoteTreeWalker walker(m_cache);
+	if (!walker.Start(m_strRemoteRoot, true, uMaxInFlight, AddEntry, this))
+		return SN_E_ERROR;
+	walker.Wait(INFINITE);
+
+	// A directory below the root that cannot be listed is left out, rather
+	// than failing a collection of everything else.
+	if (SN_FAILED(walker.GetResult()) && walker.GetDirectoryCount() <= 1)
+		return walker.GetResult();
+
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		m_order.push_back(i);
+		m_uTotalBytes += m_files[i].uSize;
+	}
+	m_auCounts[DLS_QUEUED] = (UINT32)m_files.size();
+
+	Prioritize(std::vector<std::string>());
+	return walker.GetResult();
+}
+
+bool DirectoryDownload::OpenJournal(bool bRestart)
+{
+	if (m_pJournal)
+	{
+		fclose(m_pJournal);
+		m_pJournal = NULL;
+	}
+
+	std::map<std::string, JournalEntry> entries;
+
+	RecordFileReader reader;
+	if (!bRestart && reader.Open(m_strJournalPath.c_str()))
+	{
+		// path, size, modified time
+		char* apFields[3];
+		while (UINT32 uFields = reader.Next(apFields, _countof(apFields)))
+		{
+			if (uFields != _countof(apFields) || apFields[0][0] == '\0')
+				continue;
+
+			JournalEntry entry;
+			entry.uSize = _strtoui64(apFields[1], NULL, 10);
+			entry.uModifiedTime = _strtoui64(apFields[2], NULL, 10);
+			entries[apFields[0]] = entry;
+		}
+	}
+
+	// Only what still matches on both sides is kept.
+	std::vector<size_t> kept;
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		DownloadFile& file = m_files[i];
+		std::map<std::string, JournalEntry>::const_iterator it = entries.find(file.strRelative);
+		if (it == entries.end() || it->second.uSize != file.uSize || it->second.uModifiedTime != file.uModifiedTime)
+			continue;
+
+		UINT64 uLocalSize = 0;
+		if (!GetLocalFileSize(UTF8ToWChar(GetLocalPath(file)), uLocalSize) || uLocalSize != file.uSize)
+			continue;
+
+		SetState(file, DLS_JOURNALED);
+		kept.push_back(i);
+	}
+
+	RecordFileWriter writer;
+	if (!writer.Open(m_strJournalPath.c_str(), DOWNLOAD_JOURNAL_HEADER))
+		return false;
+
+	for (size_t i = 0; i < kept.size(); ++i)
+	{
+		const DownloadFile& file = m_files[kept[i]];
+		writer.Print("%s\t%llu\t%llu\n", file.strRelative.c_str(), file.uSize, file.uModifiedTime);
+	}
+
+	if (!writer.Commit())
+		return false;
+
+	// Appended to as files finish, so it is never more than a line behind.
+	return _wfopen_s(&m_pJournal, m_strJournalPath.c_str(), L"a") == 0 && m_pJournal;
+}
+
+void DirectoryDownload::Prioritize(const std::vector<std::string>& patterns)
+{
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		DownloadFile& file = m_files[i];
+		size_t uSlash = file.strRelative.rfind('/');
+		const char* pszName = file.strRelative.c_str() + (uSlash == std::string::npos ? 0 : uSlash + 1);
+
+		file.uPriority = (UINT32)patterns.size();
+		for (size_t j = 0; j < patterns.size(); ++j)
+		{
+			bool bPath = patterns[j].find('/') != std::string::npos;
+			if (MatchWildcard(patterns[j].c_str(), bPath ? file.strRelative.c_str() : pszName))
+			{
+				file.uPriority = (UINT32)j;
+				break;
+			}
+		}
+	}
+
+	// Only what has not been started is reordered.
+	PriorityOrder less;
+	less.pFiles = &m_files;
+	std::stable_sort(m_order.begin() + m_uNext, m_order.end(), less);
+}
+
+SNRESULT DirectoryDownload::Pump(UINT32 uMaxInFlight, bool bForce)
+{
+	SNRESULT snrResult = SN_S_OK;
+
+	while (!m_bCancel && m_inFlight.size() < uMaxInFlight)
+	{
+		// Retries go first, as they were due before anything still queued.
+		size_t uFile = 0;
+		if (!m_retries.empty())
+		{
+			uFile = m_retries.front();
+			m_retries.pop_front();
+		}
+		else
+		{
+			while (m_uNext < m_order.size() && m_files[m_order[m_uNext]].eState != DLS_QUEUED)
+				m_uNext++;
+			if (m_uNext == m_order.size())
+				break;
+			uFile = m_order[m_uNext++];
+		}
+
+		DownloadFile& file = m_files[uFile];
+		std::string strLocal = GetLocalPath(file);
+		std::wstring strLocalW = UTF8ToWChar(strLocal);
+		CreateLocalDirectory(strLocalW.substr(0, strLocalW.rfind(L'\\')));
+
+		file.uAttempts++;
+		file.uBytesTransferred = 0;
+		file.uTxId = bForce ? TXID_FORCE_FLAG : 0;
+		file.snr = SNPS3DownloadFile(m_cache.GetTarget(), RemoteTreeCache::Join(m_strRemoteRoot, file.strRelative).c_str(),
+			strLocal.c_str(), &file.uTxId);
+
+		if (SN_FAILED(file.snr))
+		{
+			SetState(file, DLS_FAILED);
+			if (SN_SUCCEEDED(snrResult))
+				snrResult = file.snr;
+			continue;
+		}
+
+		SetState(file, DLS_IN_FLIGHT);
+		m_inFlight[file.uTxId] = uFile;
+	}
+
+	return snrResult;
+}
+
+void DirectoryDownload::OnTransferEvent(const TMAPI_FT_NOTIFICATION& notification)
+{
+	std::map<UINT32, size_t>::iterator it = m_inFlight.find(notification.m_TransferID);
+	if (it == m_inFlight.end())
+		return;
+
+	DownloadFile& file = m_files[it->second];
+	switch (notification.m_Type)
+	{
+	case TMAPI_FT_PROGRESS:
+		file.uBytesTransferred = notification.m_BytesTransferred;
+		return;
+
+	case TMAPI_FT_FINISH:
+	case TMAPI_FT_SKIPPED:
+		file.uBytesTransferred = file.uSize;
+		SetState(file, notification.m_Type == TMAPI_FT_FINISH ? DLS_DONE : DLS_UNCHANGED);
+		Journal(file);
+		break;
+
+	case TMAPI_FT_ERROR:
+		// Transfers fail now and then with a busy target, so each gets
+		// another go before it counts as failed.
+		if (file.uAttempts < DOWNLOAD_MAX_ATTEMPTS && !m_bCancel)
+		{
+			SetState(file, DLS_QUEUED);
+			m_retries.push_back(it->second);
+		}
+		else
+		{
+			SetState(file, DLS_FAILED);
+		}
+		break;
+
+	case TMAPI_FT_CANCELLED:
+		SetState(file, DLS_CANCELLED);
+		break;
+
+	default:
+		return;
+	}
+
+	m_inFlight.erase(it);
+}
+
+void DirectoryDownload::Cancel()
+{
+	m_bCancel = true;
+
+	for (; m_uNext < m_order.size(); ++m_uNext)
+	{
+		DownloadFile& file = m_files[m_order[m_uNext]];
+		if (file.eState == DLS_QUEUED)
+			SetState(file, DLS_CANCELLED);
+	}
+
+	while (!m_retries.empty())
+	{
+		SetState(m_files[m_retries.front()], DLS_CANCELLED);
+		m_retries.pop_front();
+	}
+
+	// Each sends its cancelled event when it stops; a partly written file is
+	// not in the journal, so it is downloaded again next time.
+	for (std::map<UINT32, size_t>::const_iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it)
+		SNPS3CancelFileTransfer(m_cache.GetTarget(), it->first);
+}
+
+UINT64 DirectoryDownload::GetRemainingBytes() const
+{
+	UINT64 uBytes = 0;
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		if (m_files[i].eState == DLS_QUEUED || m_files[i].eState == DLS_IN_FLIGHT)
+			uBytes += m_files[i].uSize - m_files[i].uBytesTransferred;
+	}
+	return uBytes;
+}
+
+UINT64 DirectoryDownload::GetTransferredBytes() const
+{
+	UINT64 uBytes = 0;
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		if (m_files[i].eState != DLS_JOURNALED && m_files[i].eState != DLS_UNCHANGED)
+			uBytes += m_files[i].uBytesTransferred;
+	}
+	return uBytes;
+}
+
+std::string DirectoryDownload::GetLocalPath(const DownloadFile& file) const
+{
+	std::string strPath = m_strLocalRoot + "\\" + file.strRelative;
+	std::replace(strPath.begin() + m_strLocalRoot.size(), strPath.end(), '/', '\\');
+	return strPath;
+}
+
+bool DirectoryDownload::MatchWildcard(const char* pszPattern, const char* pszName)
+{
+	// Backtracks to the last * only, which is enough without character classes.
+	const char* pszStar = NULL;
+	const char* pszResume = NULL;
+
+	while (*pszName)
+	{
+		if (*pszPattern == '*')
+		{
+			pszStar = pszPattern++;
+			pszResume = pszName;
+		}
+		else if (*pszPattern == '?' || tolower((unsigned char)*pszPattern) == tolower((unsigned char)*pszName))
+		{
+			pszPattern++;
+			pszName++;
+		}
+		else if (pszStar)
+		{
+			pszPattern = pszStar + 1;
+			pszName = ++pszResume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (*pszPattern == '*')
+		pszPattern++;
+	return *pszPattern == '\0';
+}
+
+bool DirectoryDownload::PriorityOrder::operator()(size_t a, size_t b) const
+{
+	const DownloadFile& fileA = (*pFiles)[a];
+	const DownloadFile& fileB = (*pFiles)[b];
+	if (fileA.uPriority != fileB.uPriority)
+		return fileA.uPriority < fileB.uPriority;
+	return fileA.uSize < fileB.uSize;
+}
+
+bool DirectoryDownload::AddEntry(void* pUser, const std::string& strPath, const RemoteFileInfo& info)
+{
+	DirectoryDownload* pThis = static_cast<DirectoryDownload*>(pUser);
+	if (info.uType != SNPS3_DIRENT_TYPE_REGULAR)
+		return true;
+
+	size_t uRootLength = pThis->m_strRemoteRoot == "/" ? 1 : pThis->m_strRemoteRoot.size() + 1;
+
+	DownloadFile file;
+	file.strRelative = strPath.substr(uRootLength);
+	file.uSize = info.uSize;
+	file.uModifiedTime = info.uModifiedTime;
+	file.uPriority = 0;
+	file.eState = DLS_QUEUED;
+	file.uTxId = 0;
+	file.uAttempts = 0;
+	file.snr = SN_S_OK;
+	file.uBytesTransferred = 0;
+	pThis->m_files.push_back(file);
+	return true;
+}
+
+void DirectoryDownload::SetState(DownloadFile& file, DownloadState eState)
+{
+	m_auCounts[file.eState]--;
+	m_auCounts[eState]++;
+	file.eState = eState;
+}
+
+bool DirectoryDownload::CreateLocalDirectory(const std::wstring& strDirectory)
+{
+	if (m_directories.count(strDirectory))
+		return true;
+
+	// Target Manager does not make the directories a file goes in.
+	size_t uSlash = strDirectory.rfind(L'\\');
+	if (uSlash != std::wstring::npos && uSlash > 0 && strDirectory[uSlash - 1] != L':')
+		CreateLocalDirectory(strDirectory.substr(0, uSlash));
+
+	bool bOK = ::CreateDirectoryW(strDirectory.c_str(), NULL) || ::GetLastError() == ERROR_ALREADY_EXISTS;
+	if (bOK)
+		m_directories[strDirectory] = true;
+	return bOK;
+}
+
+void DirectoryDownload::Journal(const DownloadFile& file)
+{
+	if (!m_pJournal)
+		return;
+
+	// Flushed at once, as the journal is for when the run does not finish.
+	fprintf(m_pJournal, "%s\t%llu\t%llu\n", file.strRelative.c_str(), file.uSize, file.uModifiedTime);
+	fflush(m_pJournal);
+}
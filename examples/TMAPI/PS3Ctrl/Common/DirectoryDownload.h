@@ -0,0 +1,122 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef DIRECTORY_DOWNLOAD_H
+#define DIRECTORY_DOWNLOAD_H
+
+#include "RemoteTree.h"
+#include <stdio.h>
+
+#define DOWNLOAD_JOURNAL_FILE_NAME		"PS3Ctrl_download.journal"	// In the local directory
+#define DOWNLOAD_MAX_ATTEMPTS			(2)
+
+enum DownloadState
+{
+	DLS_QUEUED,
+	DLS_IN_FLIGHT,
+	DLS_DONE,
+	DLS_UNCHANGED,			// Target Manager found the local copy identical
+	DLS_JOURNALED,			// Downloaded by an earlier run
+	DLS_FAILED,
+	DLS_CANCELLED,
+	DLS_COUNT
+};
+
+struct DownloadFile
+{
+	std::string		strRelative;		// To the roots, with '/'
+	UINT64			uSize;
+	UINT64			uModifiedTime;
+	UINT32			uPriority;			// Lower goes first
+	DownloadState	eState;
+	UINT32			uTxId;
+	UINT32			uAttempts;
+	SNRESULT		snr;				// Of SNPS3DownloadFile(), if it failed
+	UINT64			uBytesTransferred;
+};
+
+// Downloads a target directory file by file, rather than with one
+// SNPS3DownloadDirectory() that can only be waited on as a whole. The tree
+// is listed first, the files are queued with Target Manager uMaxInFlight at
+// a time in priority order, and each one finished is appended to a journal
+// in the local directory, so a collection that is interrupted carries on
+// from where it stopped. TMAPI only transfers whole files, so a large file
+// is still one transfer.
+//
+// OnTransferEvent() is fed the FTP events, and Pump() called between them,
+// on the same thread.
+class DirectoryDownload
+{
+public:
+						DirectoryDownload(RemoteTreeCache& cache, const std::string& strRemoteRoot, const std::string& strLocalRoot);
+						~DirectoryDownload();
+
+	// Lists the remote tree, up to uMaxInFlight directories at a time.
+	SNRESULT			Enumerate(UINT32 uMaxInFlight);
+
+	// Files the journal has, which are the same size and age on the target
+	// and the same size here, are not downloaded again. The journal is
+	// rewritten with just those, or started afresh if bRestart; returns false
+	// if it cannot be written, when nothing finished will be recorded.
+	bool				OpenJournal(bool bRestart);
+
+	// Files matching an earlier pattern go first, then those matching none.
+	// Patterns with a '/' match the relative path, the rest the file name,
+	// with * and ?. Within each, smaller files go first, so an interrupted
+	// collection has as many files as possible.
+	void				Prioritize(const std::vector<std::string>& patterns);
+
+	// Queues files until uMaxInFlight are in flight; returns the first
+	// failure to queue one.
+	SNRESULT			Pump(UINT32 uMaxInFlight, bool bForce);
+	void				OnTransferEvent(const TMAPI_FT_NOTIFICATION& notification);
+	// Files not yet queued are cancelled, as are those in flight.
+	void				Cancel();
+	bool				IsCancelled() const { return m_bCancel; }
+	bool				IsFinished() const { return m_uNext == m_order.size() && m_retries.empty() && m_inFlight.empty(); }
+
+	size_t				GetFileCount() const { return m_files.size(); }
+	const DownloadFile&	GetFile(size_t uFile) const { return m_files[uFile]; }
+	UINT32				GetCount(DownloadState eState) const { return m_auCounts[eState]; }
+	UINT32				GetInFlight() const { return (UINT32)m_inFlight.size(); }
+	UINT64				GetTotalBytes() const { return m_uTotalBytes; }
+	// Of the files still to be downloaded
+	UINT64				GetRemainingBytes() const;
+	UINT64				GetTransferredBytes() const;
+	std::string			GetLocalPath(const DownloadFile& file) const;
+	const std::wstring&	GetJournalPath() const { return m_strJournalPath; }
+
+	static bool			MatchWildcard(const char* pszPattern, const char* pszName);
+
+private:
+	struct PriorityOrder
+	{
+		const std::vector<DownloadFile>*	pFiles;
+		bool operator()(size_t a, size_t b) const;
+	};
+
+	static bool			AddEntry(void* pUser, const std::string& strPath, const RemoteFileInfo& info);
+	void				SetState(DownloadFile& file, DownloadState eState);
+	bool				CreateLocalDirectory(const std::wstring& strDirectory);
+	void				Journal(const DownloadFile& file);
+
+	RemoteTreeCache&			m_cache;
+	std::string					m_strRemoteRoot;
+	std::string					m_strLocalRoot;
+	std::wstring				m_strJournalPath;
+	FILE*						m_pJournal;
+	std::vector<DownloadFile>	m_files;
+	std::vector<size_t>			m_order;
+	size_t						m_uNext;		// In m_order
+	std::deque<size_t>			m_retries;
+	std::map<UINT32, size_t>	m_inFlight;		// File of each transfer
+	std::map<std::wstring, bool> m_directories;	// Local ones known to exist
+	UINT32						m_auCounts[DLS_COUNT];
+	UINT64						m_uTotalBytes;
+	bool						m_bCancel;
+};
+
+#endif
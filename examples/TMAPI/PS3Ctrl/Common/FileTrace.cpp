@@ -0,0 +1,532 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "FileTrace.h"
+#include <string.h>
+
+#define FILE_TRACE_WINDOW_SIZE		(64 * 1024 * 1024)
+
+namespace
+{
+	// Bounds-checked view of the type-specific data following the header
+	// and back-trace.
+	class DataCursor
+	{
+	public:
+		DataCursor(const BYTE* pData, const BYTE* pEnd) : m_pCur(pData), m_pEnd(pEnd) {}
+
+		template <class T> const T* Get()
+		{
+			if ((size_t)(m_pEnd - m_pCur) < sizeof(T))
+				return NULL;
+			const T* p = reinterpret_cast<const T*>(m_pCur);
+			m_pCur += sizeof(T);
+			return p;
+		}
+
+		bool GetString(UINT32 uLength, const char*& pString, UINT32& uStringLength)
+		{
+			if ((size_t)(m_pEnd - m_pCur) < uLength)
+				return false;
+
+			pString = reinterpret_cast<const char*>(m_pCur);
+			m_pCur += uLength;
+
+			// Lengths may or may not count the terminator.
+			uStringLength = uLength;
+			while (uStringLength && pString[uStringLength - 1] == '\0')
+				--uStringLength;
+			return true;
+		}
+
+		bool Skip(UINT32 uLength)
+		{
+			if ((size_t)(m_pEnd - m_pCur) < uLength)
+				return false;
+			m_pCur += uLength;
+			return true;
+		}
+
+	private:
+		const BYTE*	m_pCur;
+		const BYTE*	m_pEnd;
+	};
+
+	void SetHandle(FileTraceRecord& record, const SNPS3_FT_PROCESS_INFO& info)
+	{
+		record.bHasHandle = true;
+		record.uVfsId = info.ulVFSID;
+		record.uFd = info.ulFD;
+	}
+}
+
+bool ParseFileTraceRecord(const BYTE* pData, UINT32 uLength, FileTraceRecord& record)
+{
+	memset(&record, 0, sizeof(record));
+
+	if (uLength < sizeof(SNPS3_FILE_TRACE_LOG))
+		return false;
+
+	const SNPS3_FILE_TRACE_LOG* pLog = reinterpret_cast<const SNPS3_FILE_TRACE_LOG*>(pData);
+	record.uSerialId = pLog->ulSerialID;
+	record.uApiType = pLog->ulAPIType;
+	record.uStatus = pLog->ulStatus;
+	record.uProcessId = pLog->ulProcessID;
+	record.uThreadId = pLog->ulThreadID;
+	record.uTimeBase = pLog->ulTimeBase;
+
+	DataCursor data(pData + sizeof(SNPS3_FILE_TRACE_LOG), pData + uLength);
+
+	record.pBackTrace = pData + sizeof(SNPS3_FILE_TRACE_LOG);
+	record.uBackTraceLength = pLog->ulBackTraceLength;
+	if (!data.Skip(pLog->ulBackTraceLength))
+		return false;
+
+	switch (record.uApiType)
+	{
+	case SNPS3_FT_GET_BLOCK_SIZE: case SNPS3_FT_STAT: case SNPS3_FT_WIDGET_STAT: case SNPS3_FT_UNLINK:
+	case SNPS3_FT_WIDGET_UNLINK: case SNPS3_FT_RMDIR: case SNPS3_FT_WIDGET_RMDIR:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_1* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_1>();
+			return p && data.GetString(p->ulPathLength, record.pPath, record.uPathLength);
+		}
+
+	case SNPS3_FT_RENAME: case SNPS3_FT_WIDGET_RENAME:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_2* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_2>();
+			return p && data.GetString(p->ulPathLength1, record.pPath, record.uPathLength) &&
+				data.GetString(p->ulPathLength2, record.pPath2, record.uPath2Length);
+		}
+
+	case SNPS3_FT_TRUNCATE: case SNPS3_FT_TRUNCATE_NO_ALLOC: case SNPS3_FT_TRUNCATE2: case SNPS3_FT_TRUNCATE2_NO_INIT:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_3* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_3>();
+			if (!p)
+				return false;
+			record.uSize = p->ulArg;
+			return data.GetString(p->ulPathLength, record.pPath, record.uPathLength);
+		}
+
+	case SNPS3_FT_OPENDIR: case SNPS3_FT_WIDGET_OPENDIR: case SNPS3_FT_CHMOD: case SNPS3_FT_MKDIR:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_4* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_4>();
+			return p && data.GetString(p->ulPathLength, record.pPath, record.uPathLength);
+		}
+
+	case SNPS3_FT_UTIME:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_6* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_6>();
+			return p && data.GetString(p->ulPathLength, record.pPath, record.uPathLength);
+		}
+
+	case SNPS3_FT_OPEN: case SNPS3_FT_WIDGET_OPEN:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_8* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_8>();
+			if (!p || !data.Skip(p->ulVArgLength))
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			return data.GetString(p->ulPathLength, record.pPath, record.uPathLength);
+		}
+
+	case SNPS3_FT_CLOSE: case SNPS3_FT_CLOSEDIR: case SNPS3_FT_FSYNC: case SNPS3_FT_READDIR:
+	case SNPS3_FT_FSTAT: case SNPS3_FT_FGET_BLOCK_SIZE:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_9* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_9>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			return true;
+		}
+
+	case SNPS3_FT_READ: case SNPS3_FT_WRITE: case SNPS3_FT_GET_DIR_ENTRIES:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_10* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_10>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			record.uSize = p->ulSize;
+			record.uTxSize = p->ulTxSize;
+			return true;
+		}
+
+	case SNPS3_FT_READ_OFFSET: case SNPS3_FT_WRITE_OFFSET:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_11* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_11>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			record.uSize = p->ulSize;
+			record.uTxSize = p->ulTxSize;
+			record.uOffset = p->ulOffset;
+			return true;
+		}
+
+	case SNPS3_FT_FTRUNCATE: case SNPS3_FT_FTRUNCATE_NO_ALLOC:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_12* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_12>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			record.uSize = p->ulTargetSize;
+			return true;
+		}
+
+	case SNPS3_FT_LSEEK:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_13* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_13>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			record.uOffset = p->ulOffset;
+			return true;
+		}
+
+	case SNPS3_FT_SET_IO_BUFFER:
+		{
+			const SNPS3_FILE_TRACE_LOG_TYPE_14* p = data.Get<SNPS3_FILE_TRACE_LOG_TYPE_14>();
+			if (!p)
+				return false;
+			SetHandle(record, p->ProcessInfo);
+			return true;
+		}
+
+	default:
+		// Unknown or marker records (SNPS3_FT_OFFLINE_END) carry no data we use.
+		return true;
+	}
+}
+
+FileTraceApiClass GetFileTraceApiClass(UINT32 uApiType)
+{
+	switch (uApiType)
+	{
+	case SNPS3_FT_OPEN: case SNPS3_FT_WIDGET_OPEN:
+		return FTC_OPEN;
+	case SNPS3_FT_CLOSE:
+		return FTC_CLOSE;
+	case SNPS3_FT_READ: case SNPS3_FT_READ_OFFSET:
+		return FTC_READ;
+	case SNPS3_FT_WRITE: case SNPS3_FT_WRITE_OFFSET:
+		return FTC_WRITE;
+	case SNPS3_FT_LSEEK:
+		return FTC_SEEK;
+	default:
+		return FTC_OTHER;
+	}
+}
+
+const char* GetFileTraceApiName(UINT32 uApiType)
+{
+	switch (uApiType)
+	{
+	case SNPS3_FT_GET_BLOCK_SIZE:		return "get_block_size";
+	case SNPS3_FT_STAT:					return "stat";
+	case SNPS3_FT_WIDGET_STAT:			return "widget_stat";
+	case SNPS3_FT_UNLINK:				return "unlink";
+	case SNPS3_FT_WIDGET_UNLINK:		return "widget_unlink";
+	case SNPS3_FT_RMDIR:				return "rmdir";
+	case SNPS3_FT_WIDGET_RMDIR:			return "widget_rmdir";
+	case SNPS3_FT_RENAME:				return "rename";
+	case SNPS3_FT_WIDGET_RENAME:		return "widget_rename";
+	case SNPS3_FT_TRUNCATE:				return "truncate";
+	case SNPS3_FT_TRUNCATE_NO_ALLOC:	return "truncate_no_alloc";
+	case SNPS3_FT_TRUNCATE2:			return "truncate2";
+	case SNPS3_FT_TRUNCATE2_NO_INIT:	return "truncate2_no_init";
+	case SNPS3_FT_OPENDIR:				return "opendir";
+	case SNPS3_FT_WIDGET_OPENDIR:		return "widget_opendir";
+	case SNPS3_FT_CHMOD:				return "chmod";
+	case SNPS3_FT_MKDIR:				return "mkdir";
+	case SNPS3_FT_UTIME:				return "utime";
+	case SNPS3_FT_OPEN:					return "open";
+	case SNPS3_FT_WIDGET_OPEN:			return "widget_open";
+	case SNPS3_FT_CLOSE:				return "close";
+	case SNPS3_FT_CLOSEDIR:				return "closedir";
+	case SNPS3_FT_FSYNC:				return "fsync";
+	case SNPS3_FT_READDIR:				return "readdir";
+	case SNPS3_FT_FSTAT:				return "fstat";
+	case SNPS3_FT_FGET_BLOCK_SIZE:		return "fget_block_size";
+	case SNPS3_FT_READ:					return "read";
+	case SNPS3_FT_WRITE:				return "write";
+	case SNPS3_FT_GET_DIR_ENTRIES:		return "get_dir_entries";
+	case SNPS3_FT_READ_OFFSET:			return "read_offset";
+	case SNPS3_FT_WRITE_OFFSET:			return "write_offset";
+	case SNPS3_FT_FTRUNCATE:			return "ftruncate";
+	case SNPS3_FT_FTRUNCATE_NO_ALLOC:	return "ftruncate_no_alloc";
+	case SNPS3_FT_LSEEK:				return "lseek";
+	case SNPS3_FT_SET_IO_BUFFER:		return "set_io_buffer";
+	case SNPS3_FT_OFFLINE_END:			return "offline_end";
+	default:							return "unknown";
+	}
+}
+
+bool IsFileTraceComplete(UINT32 uStatus)
+{
+	return uStatus == SNPS3_FILE_TRACE_STATUS_PROCESSED || uStatus == SNPS3_FILE_TRACE_STATUS_FINISHED;
+}
+
+FileTraceWriter::FileTraceWriter()
+: m_pFile(NULL)
+, m_uBlockRecords(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+FileTraceWriter::~FileTraceWriter()
+{
+	Close();
+}
+
+bool FileTraceWriter::Open(const WCHAR* pszPath, UINT64 uTimebaseFrequency)
+{
+	Close();
+
+	m_pFile = _wfopen(pszPath, L"wb");
+	if (!m_pFile)
+		return false;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.uMagic = FILE_TRACE_MAGIC;
+	m_header.uVersion = FILE_TRACE_VERSION;
+	m_header.uTimebaseFrequency = uTimebaseFrequency;
+
+	m_block.clear();
+	m_block.reserve(FILE_TRACE_BLOCK_SIZE);
+	m_uBlockRecords = 0;
+
+	if (fwrite(&m_header, sizeof(m_header), 1, m_pFile) != 1)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool FileTraceWriter::Write(const BYTE* pRecord, UINT32 uLength)
+{
+	if (!m_pFile || uLength > FILE_TRACE_MAX_RECORD)
+		return false;
+
+	if (m_block.size() + sizeof(UINT32) + uLength > FILE_TRACE_BLOCK_SIZE - sizeof(FileTraceBlockHeader) && !Flush())
+		return false;
+
+	const BYTE* pLength = reinterpret_cast<const BYTE*>(&uLength);
+	m_block.insert(m_block.end(), pLength, pLength + sizeof(uLength));
+	m_block.insert(m_block.end(), pRecord, pRecord + uLength);
+	++m_uBlockRecords;
+	++m_header.uRecordCount;
+	return true;
+}
+
+bool FileTraceWriter::Flush()
+{
+	if (!m_pFile)
+		return false;
+
+	if (m_uBlockRecords == 0)
+		return true;
+
+	FileTraceBlockHeader block;
+	block.uMagic = FILE_TRACE_BLOCK_MAGIC;
+	block.uSize = (UINT32)m_block.size();
+	block.uRecordCount = m_uBlockRecords;
+	block.uReserved = 0;
+
+	if (fwrite(&block, sizeof(block), 1, m_pFile) != 1 ||
+		fwrite(&m_block[0], m_block.size(), 1, m_pFile) != 1)
+		return false;
+
+	m_block.clear();
+	m_uBlockRecords = 0;
+	return true;
+}
+
+bool FileTraceWriter::Close()
+{
+	if (!m_pFile)
+		return true;
+
+	bool bOK = Flush();
+	if (bOK)
+		bOK = fseek(m_pFile, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, m_pFile) == 1;
+
+	if (fclose(m_pFile) != 0)
+		bOK = false;
+
+	m_pFile = NULL;
+	return bOK;
+}
+
+FileTraceReader::FileTraceReader()
+: m_hFile(INVALID_HANDLE_VALUE)
+, m_hMapping(NULL)
+, m_pView(NULL)
+, m_uViewOffset(0)
+, m_uViewSize(0)
+, m_uFileSize(0)
+, m_uGranularity(64 * 1024)
+, m_bCorrupt(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+FileTraceReader::~FileTraceReader()
+{
+	Close();
+}
+
+bool FileTraceReader::Open(const WCHAR* pszPath)
+{
+	Close();
+
+	m_hFile = CreateFileW(pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || (UINT64)size.QuadPart < sizeof(FileTraceFileHeader))
+	{
+		Close();
+		return false;
+	}
+	m_uFileSize = (UINT64)size.QuadPart;
+
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	m_uGranularity = sysInfo.dwAllocationGranularity;
+
+	if (!MapWindow(0, sizeof(FileTraceFileHeader)))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&m_header, m_pView, sizeof(m_header));
+	if (m_header.uMagic != FILE_TRACE_MAGIC || m_header.uVersion != FILE_TRACE_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	if (m_header.uTimebaseFrequency == 0)
+		m_header.uTimebaseFrequency = FILE_TRACE_DEFAULT_TIMEBASE;
+
+	m_bCorrupt = false;
+	return true;
+}
+
+void FileTraceReader::Close()
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = NULL;
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_uViewOffset = 0;
+	m_uViewSize = 0;
+}
+
+bool FileTraceReader::MapWindow(UINT64 uOffset, UINT32 uSize)
+{
+	if (uOffset + uSize > m_uFileSize)
+		return false;
+
+	if (m_pView && uOffset >= m_uViewOffset && uOffset + uSize <= m_uViewOffset + m_uViewSize)
+		return true;
+
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = NULL;
+	}
+
+	UINT64 uStart = uOffset - uOffset % m_uGranularity;
+	UINT64 uLength = FILE_TRACE_WINDOW_SIZE;
+	if (uLength < uOffset + uSize - uStart)
+		uLength = uOffset + uSize - uStart;
+	if (uStart + uLength > m_uFileSize)
+		uLength = m_uFileSize - uStart;
+
+	m_pView = static_cast<const BYTE*>(MapViewOfFile(m_hMapping, FILE_MAP_READ,
+		(DWORD)(uStart >> 32), (DWORD)uStart, (SIZE_T)uLength));
+	if (!m_pView)
+		return false;
+
+	m_uViewOffset = uStart;
+	m_uViewSize = uLength;
+	return true;
+}
+
+bool FileTraceReader::MapBlock(UINT64 uOffset, const BYTE*& pRecords, FileTraceBlockHeader& block, UINT64& uNextOffset)
+{
+	if (m_bCorrupt || uOffset >= m_uFileSize)
+		return false;
+
+	// A trace that was not closed may end part way through a block.
+	if (!MapWindow(uOffset, sizeof(FileTraceBlockHeader)))
+	{
+		m_bCorrupt = true;
+		return false;
+	}
+
+	memcpy(&block, m_pView + (uOffset - m_uViewOffset), sizeof(block));
+	if (block.uMagic != FILE_TRACE_BLOCK_MAGIC || block.uSize > FILE_TRACE_BLOCK_SIZE ||
+		!MapWindow(uOffset, sizeof(FileTraceBlockHeader) + block.uSize))
+	{
+		m_bCorrupt = true;
+		return false;
+	}
+
+	pRecords = m_pView + (uOffset - m_uViewOffset) + sizeof(FileTraceBlockHeader);
+	uNextOffset = uOffset + sizeof(FileTraceBlockHeader) + block.uSize;
+	return true;
+}
+
+bool FileTraceBlockCursor::Next(const BYTE*& pRecord, UINT32& uLength, bool& bCorrupt)
+{
+	bCorrupt = false;
+
+	if (m_uRemaining == 0)
+		return false;
+
+	if ((size_t)(m_pEnd - m_pCur) < sizeof(UINT32))
+	{
+		bCorrupt = true;
+		return false;
+	}
+
+	memcpy(&uLength, m_pCur, sizeof(UINT32));
+	m_pCur += sizeof(UINT32);
+
+	if ((size_t)(m_pEnd - m_pCur) < uLength)
+	{
+		bCorrupt = true;
+		return false;
+	}
+
+	pRecord = m_pCur;
+	m_pCur += uLength;
+	--m_uRemaining;
+	return true;
+}
@@ -0,0 +1,163 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef FILE_TRACE_H
+#define FILE_TRACE_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <vector>
+#include "TmapiTrace.h"
+
+// A parsed SNPS3_FILE_TRACE_LOG record. Pointers refer into the record
+// buffer, so parsing copies nothing and the view is only valid while the
+// buffer is.
+struct FileTraceRecord
+{
+	UINT64			uSerialId;
+	UINT32			uApiType;
+	UINT32			uStatus;
+	UINT32			uProcessId;
+	UINT32			uThreadId;
+	UINT64			uTimeBase;
+	const BYTE*		pBackTrace;
+	UINT32			uBackTraceLength;
+
+	// Fields decoded from the type-specific data; absent ones are zero.
+	bool			bHasHandle;
+	UINT64			uVfsId;
+	UINT64			uFd;
+	const char*		pPath;
+	UINT32			uPathLength;
+	const char*		pPath2;
+	UINT32			uPath2Length;
+	UINT64			uSize;			// Requested size (read/write) or target size (truncate)
+	UINT64			uTxSize;		// Bytes actually transferred (read/write)
+	UINT64			uOffset;		// Explicit offset (read/write offset, lseek)
+};
+
+enum FileTraceApiClass
+{
+	FTC_OTHER,
+	FTC_OPEN,
+	FTC_CLOSE,
+	FTC_READ,
+	FTC_WRITE,
+	FTC_SEEK
+};
+
+// Parses one record of uLength bytes. Returns false if the record is
+// truncated or its lengths are inconsistent.
+bool				ParseFileTraceRecord(const BYTE* pData, UINT32 uLength, FileTraceRecord& record);
+FileTraceApiClass	GetFileTraceApiClass(UINT32 uApiType);
+const char*			GetFileTraceApiName(UINT32 uApiType);
+bool				IsFileTraceComplete(UINT32 uStatus);
+
+// Saved trace file:
+//
+//   FileTraceFileHeader
+//   FileTraceBlockHeader, { UINT32 length, record bytes } * uRecordCount
+//   ...
+//
+// Records are stored exactly as delivered by the file trace callback. Blocks
+// are at most FILE_TRACE_BLOCK_SIZE bytes so readers can map them one window
+// at a time and split a trace between workers at block boundaries.
+
+#define FILE_TRACE_MAGIC			(0x43525446)	// 'FTRC'
+#define FILE_TRACE_BLOCK_MAGIC		(0x4b425446)	// 'FTBK'
+#define FILE_TRACE_VERSION			(1)
+#define FILE_TRACE_BLOCK_SIZE		(1024 * 1024)
+#define FILE_TRACE_MAX_RECORD		(FILE_TRACE_BLOCK_SIZE - 64)
+#define FILE_TRACE_DEFAULT_TIMEBASE	(79800000)
+
+struct FileTraceFileHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT64	uTimebaseFrequency;
+	UINT64	uRecordCount;		// 0 if the trace was not closed
+	UINT64	uReserved;
+};
+
+struct FileTraceBlockHeader
+{
+	UINT32	uMagic;
+	UINT32	uSize;				// Bytes of records following the header
+	UINT32	uRecordCount;
+	UINT32	uReserved;
+};
+
+class FileTraceWriter
+{
+public:
+					FileTraceWriter();
+					~FileTraceWriter();
+
+	bool			Open(const WCHAR* pszPath, UINT64 uTimebaseFrequency);
+	bool			Write(const BYTE* pRecord, UINT32 uLength);
+	bool			Flush();
+	bool			Close();
+	UINT64			GetRecordCount() const { return m_header.uRecordCount; }
+
+private:
+	FILE*				m_pFile;
+	FileTraceFileHeader	m_header;
+	std::vector<BYTE>	m_block;
+	UINT32				m_uBlockRecords;
+};
+
+// Reads a saved trace through a sliding memory-mapped window, so traces
+// larger than the address space can be read without copying records.
+class FileTraceReader
+{
+public:
+					FileTraceReader();
+					~FileTraceReader();
+
+	bool			Open(const WCHAR* pszPath);
+	void			Close();
+	const FileTraceFileHeader& GetHeader() const { return m_header; }
+	UINT64			GetFileSize() const { return m_uFileSize; }
+
+	// Maps the block at uOffset. On success pBlock points at its records
+	// and uNextOffset at the following block; the pointer stays valid until
+	// the next call.
+	bool			MapBlock(UINT64 uOffset, const BYTE*& pRecords, FileTraceBlockHeader& block, UINT64& uNextOffset);
+	UINT64			GetFirstBlockOffset() const { return sizeof(FileTraceFileHeader); }
+	bool			IsCorrupt() const { return m_bCorrupt; }
+
+private:
+	bool			MapWindow(UINT64 uOffset, UINT32 uSize);
+
+	HANDLE				m_hFile;
+	HANDLE				m_hMapping;
+	const BYTE*			m_pView;
+	UINT64				m_uViewOffset;
+	UINT64				m_uViewSize;
+	UINT64				m_uFileSize;
+	UINT32				m_uGranularity;
+	FileTraceFileHeader	m_header;
+	bool				m_bCorrupt;
+};
+
+// Walks the records in a mapped block.
+class FileTraceBlockCursor
+{
+public:
+					FileTraceBlockCursor(const BYTE* pRecords, const FileTraceBlockHeader& block)
+					: m_pCur(pRecords), m_pEnd(pRecords + block.uSize), m_uRemaining(block.uRecordCount) {}
+
+	// Returns false at the end of the block, or with bCorrupt set if a
+	// record length runs past it.
+	bool			Next(const BYTE*& pRecord, UINT32& uLength, bool& bCorrupt);
+
+private:
+	const BYTE*		m_pCur;
+	const BYTE*		m_pEnd;
+	UINT32			m_uRemaining;
+};
+
+#endif
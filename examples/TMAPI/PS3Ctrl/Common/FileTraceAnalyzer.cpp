@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "FileTraceAnalyzer.h"
+#include <algorithm>
+
+namespace
+{
+	struct CompareIoTime
+	{
+		CompareIoTime(const std::vector<FileTraceFileStats>& files) : m_files(files) {}
+
+		bool operator()(UINT32 a, UINT32 b) const
+		{
+			return m_files[a].uIoTime > m_files[b].uIoTime;
+		}
+
+		const std::vector<FileTraceFileStats>& m_files;
+	};
+}
+
+FileTraceAnalyzer::FileTraceAnalyzer(UINT64 uTimebaseFrequency)
+: m_uTimebaseFrequency(uTimebaseFrequency ? uTimebaseFrequency : FILE_TRACE_DEFAULT_TIMEBASE)
+, m_uRecords(0)
+, m_uMalformed(0)
+, m_uCalls(0)
+, m_uUnpaired(0)
+, m_uFirstTimeBase(~0ULL)
+, m_uLastTimeBase(0)
+{
+	m_files.reserve(64);
+	m_files.push_back(FileTraceFileStats("<unknown>"));
+	m_files.push_back(FileTraceFileStats("<other>"));
+}
+
+void FileTraceAnalyzer::SetTimebaseFrequency(UINT64 uTimebaseFrequency)
+{
+	if (uTimebaseFrequency)
+		m_uTimebaseFrequency = uTimebaseFrequency;
+}
+
+UINT64 FileTraceAnalyzer::TicksToMicroseconds(UINT64 uTicks) const
+{
+	return (UINT64)((double)uTicks * 1000000.0 / m_uTimebaseFrequency);
+}
+
+double FileTraceAnalyzer::GetDuration() const
+{
+	if (m_uLastTimeBase < m_uFirstTimeBase)
+		return 0.0;
+
+	return (double)(m_uLastTimeBase - m_uFirstTimeBase) / m_uTimebaseFrequency;
+}
+
+UINT32 FileTraceAnalyzer::GetFileIndex(const char* pPath, UINT32 uLength)
+{
+	if (uLength == 0)
+		return FILE_TRACE_FILE_UNKNOWN;
+
+	std::string strPath(pPath, uLength);
+	PathMap::const_iterator iter = m_paths.find(strPath);
+	if (iter != m_paths.end())
+		return iter->second;
+
+	if (m_files.size() >= FILE_TRACE_MAX_FILES)
+		return FILE_TRACE_FILE_OTHER;
+
+	UINT32 uIndex = (UINT32)m_files.size();
+	m_files.push_back(FileTraceFileStats(strPath));
+	m_paths[strPath] = uIndex;
+	return uIndex;
+}
+
+UINT32 FileTraceAnalyzer::GetHandleFile(const FileTraceRecord& record) const
+{
+	HandleKey key = { record.uProcessId, record.uVfsId, record.uFd };
+	const UINT32* pIndex = m_handles.Find(key);
+	return pIndex ? *pIndex : FILE_TRACE_FILE_UNKNOWN;
+}
+
+bool FileTraceAnalyzer::AddRecord(const BYTE* pData, UINT32 uLength)
+{
+	FileTraceRecord record;
+	if (!ParseFileTraceRecord(pData, uLength, record))
+	{
+		++m_uRecords;
+		++m_uMalformed;
+		return false;
+	}
+
+	AddRecord(record);
+	return true;
+}
+
+void FileTraceAnalyzer::AddRecord(const FileTraceRecord& record)
+{
+	++m_uRecords;
+
+	if (record.uApiType == SNPS3_FT_OFFLINE_END)
+		return;
+
+	if (record.uTimeBase < m_uFirstTimeBase)
+		m_uFirstTimeBase = record.uTimeBase;
+	if (record.uTimeBase > m_uLastTimeBase)
+		m_uLastTimeBase = record.uTimeBase;
+
+	if (!IsFileTraceComplete(record.uStatus))
+	{
+		// Keep the earliest time the call was seen.
+		if (!m_pending.Find(record.uSerialId) && m_pending.Set(record.uSerialId, record.uTimeBase))
+			++m_uUnpaired;
+		return;
+	}
+
+	++m_uCalls;
+
+	bool bTimed = false;
+	UINT64 uLatency = 0;
+	const UINT64* pStart = m_pending.Find(record.uSerialId);
+	if (pStart)
+	{
+		if (record.uTimeBase >= *pStart)
+		{
+			uLatency = TicksToMicroseconds(record.uTimeBase - *pStart);
+			bTimed = true;
+		}
+		m_pending.Erase(record.uSerialId);
+	}
+	else
+	{
+		++m_uUnpaired;
+	}
+
+	FileTraceApiStats& api = m_apiStats[record.uApiType];
+	++api.uCalls;
+	if (bTimed)
+		api.latency.Record(uLatency);
+
+	if (!record.bHasHandle)
+		return;
+
+	FileTraceFileStats* pFile = NULL;
+	HandleKey key = { record.uProcessId, record.uVfsId, record.uFd };
+
+	switch (GetFileTraceApiClass(record.uApiType))
+	{
+	case FTC_OPEN:
+		{
+			UINT32 uIndex = GetFileIndex(record.pPath, record.uPathLength);
+			m_handles.Set(key, uIndex);
+
+			pFile = &m_files[uIndex];
+			++pFile->uOpens;
+		}
+		break;
+
+	case FTC_CLOSE:
+		pFile = &m_files[GetHandleFile(record)];
+		m_handles.Erase(key);
+		break;
+
+	case FTC_READ:
+		pFile = &m_files[GetHandleFile(record)];
+		++pFile->uReads;
+		pFile->uBytesRead += record.uTxSize;
+		api.uBytes += record.uTxSize;
+		break;
+
+	case FTC_WRITE:
+		pFile = &m_files[GetHandleFile(record)];
+		++pFile->uWrites;
+		pFile->uBytesWritten += record.uTxSize;
+		api.uBytes += record.uTxSize;
+		break;
+
+	case FTC_SEEK:
+		pFile = &m_files[GetHandleFile(record)];
+		++pFile->uSeeks;
+		break;
+
+	default:
+		pFile = &m_files[GetHandleFile(record)];
+		break;
+	}
+
+	if (bTimed)
+	{
+		pFile->uIoTime += uLatency;
+		pFile->latency.Record(uLatency);
+	}
+}
+
+void FileTraceAnalyzer::GetHotFiles(UINT32 uCount, std::vector<UINT32>& files) const
+{
+	files.clear();
+	for (UINT32 i = 0; i < m_files.size(); ++i)
+	{
+		if (m_files[i].uIoTime)
+			files.push_back(i);
+	}
+
+	if (files.size() > uCount)
+	{
+		std::partial_sort(files.begin(), files.begin() + uCount, files.end(), CompareIoTime(m_files));
+		files.resize(uCount);
+	}
+	else
+	{
+		std::sort(files.begin(), files.end(), CompareIoTime(m_files));
+	}
+}
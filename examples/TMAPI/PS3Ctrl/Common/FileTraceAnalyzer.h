@@ -0,0 +1,196 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef FILE_TRACE_ANALYZER_H
+#define FILE_TRACE_ANALYZER_H
+
+#include <windows.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "FileTrace.h"
+#include "HdrHistogram.h"
+
+// Limits that keep memory bounded however long the trace is. Calls still in
+// flight and open handles beyond these are dropped oldest first; files beyond
+// FILE_TRACE_MAX_FILES are accounted to a single "<other>" entry.
+#define FILE_TRACE_MAX_PENDING		(64 * 1024)
+#define FILE_TRACE_MAX_HANDLES		(64 * 1024)
+#define FILE_TRACE_MAX_FILES		(4096)
+
+#define FILE_TRACE_FILE_UNKNOWN		(0)		// Handles opened before the trace started
+#define FILE_TRACE_FILE_OTHER		(1)		// Files beyond FILE_TRACE_MAX_FILES
+
+// A map of at most MaxSize entries, which drops the entry set longest ago to
+// make room for another.
+template <typename Key, typename Value, size_t MaxSize>
+class FileTraceBoundedMap
+{
+public:
+	Value* Find(const Key& key)
+	{
+		typename EntryMap::iterator iter = m_entries.find(key);
+		return iter != m_entries.end() ? &iter->second.value : NULL;
+	}
+
+	const Value* Find(const Key& key) const
+	{
+		typename EntryMap::const_iterator iter = m_entries.find(key);
+		return iter != m_entries.end() ? &iter->second.value : NULL;
+	}
+
+	// Sets the value for key, which becomes the newest entry. Returns true
+	// if the oldest entry was dropped to make room.
+	bool Set(const Key& key, const Value& value)
+	{
+		typename EntryMap::iterator iter = m_entries.find(key);
+		if (iter != m_entries.end())
+		{
+			iter->second.value = value;
+			m_order.splice(m_order.end(), m_order, iter->second.order);
+			return false;
+		}
+
+		bool bDropped = false;
+		if (m_entries.size() >= MaxSize)
+		{
+			m_entries.erase(m_order.front());
+			m_order.pop_front();
+			bDropped = true;
+		}
+
+		Entry& entry = m_entries[key];
+		entry.value = value;
+		entry.order = m_order.insert(m_order.end(), key);
+		return bDropped;
+	}
+
+	void Erase(const Key& key)
+	{
+		typename EntryMap::iterator iter = m_entries.find(key);
+		if (iter != m_entries.end())
+		{
+			m_order.erase(iter->second.order);
+			m_entries.erase(iter);
+		}
+	}
+
+	size_t	Size() const	{ return m_entries.size(); }
+	void	Clear()			{ m_entries.clear(); m_order.clear(); }
+
+private:
+	typedef std::list<Key> OrderList;
+
+	struct Entry
+	{
+		Value								value;
+		typename OrderList::iterator		order;
+	};
+
+	typedef std::map<Key, Entry> EntryMap;
+
+	EntryMap	m_entries;
+	OrderList	m_order;		// Oldest first
+};
+
+struct FileTraceApiStats
+{
+					FileTraceApiStats() : uCalls(0), uBytes(0), latency(60ULL * 1000 * 1000, 2) {}
+
+	UINT64			uCalls;
+	UINT64			uBytes;
+	HdrHistogram	latency;			// Microseconds
+};
+
+struct FileTraceFileStats
+{
+					FileTraceFileStats(const std::string& strPath)
+					: strPath(strPath), uOpens(0), uReads(0), uWrites(0), uSeeks(0)
+					, uBytesRead(0), uBytesWritten(0), uIoTime(0), latency(60ULL * 1000 * 1000, 1) {}
+
+	std::string		strPath;
+	UINT64			uOpens;
+	UINT64			uReads;
+	UINT64			uWrites;
+	UINT64			uSeeks;
+	UINT64			uBytesRead;
+	UINT64			uBytesWritten;
+	UINT64			uIoTime;			// Microseconds spent in calls on this file
+	HdrHistogram	latency;			// Microseconds
+};
+
+// Aggregates file trace records in a single pass. A call is reported as
+// several records sharing a serial ID as it moves through the queue; the
+// first one seen starts the call and the first completed one ends it.
+// Handles are tracked from open to close so reads, writes and seeks can be
+// attributed to the file they act on.
+class FileTraceAnalyzer
+{
+public:
+	typedef std::map<UINT32, FileTraceApiStats> ApiStatsMap;
+
+					FileTraceAnalyzer(UINT64 uTimebaseFrequency = FILE_TRACE_DEFAULT_TIMEBASE);
+
+	void			SetTimebaseFrequency(UINT64 uTimebaseFrequency);
+
+	// Returns false if the record could not be parsed.
+	bool			AddRecord(const BYTE* pData, UINT32 uLength);
+	void			AddRecord(const FileTraceRecord& record);
+
+	UINT64			GetRecordCount() const { return m_uRecords; }
+	UINT64			GetMalformedCount() const { return m_uMalformed; }
+	UINT64			GetCallCount() const { return m_uCalls; }
+	// Calls whose start was not seen, or that never completed.
+	UINT64			GetUnpairedCount() const { return m_uUnpaired + m_pending.Size(); }
+	double			GetDuration() const;
+
+	const ApiStatsMap&						GetApiStats() const { return m_apiStats; }
+	const std::vector<FileTraceFileStats>&	GetFiles() const { return m_files; }
+
+	// Indices into GetFiles() of the uCount files with the most I/O time.
+	void			GetHotFiles(UINT32 uCount, std::vector<UINT32>& files) const;
+
+private:
+	struct HandleKey
+	{
+		UINT32		uProcessId;
+		UINT64		uVfsId;
+		UINT64		uFd;
+
+		bool operator<(const HandleKey& other) const
+		{
+			if (uProcessId != other.uProcessId)
+				return uProcessId < other.uProcessId;
+			if (uVfsId != other.uVfsId)
+				return uVfsId < other.uVfsId;
+			return uFd < other.uFd;
+		}
+	};
+
+	typedef FileTraceBoundedMap<UINT64, UINT64, FILE_TRACE_MAX_PENDING>		PendingMap;		// Serial ID -> start time base
+	typedef FileTraceBoundedMap<HandleKey, UINT32, FILE_TRACE_MAX_HANDLES>	HandleMap;		// Handle -> file index
+	typedef std::map<std::string, UINT32>		PathMap;		// Path -> file index
+
+	UINT64			TicksToMicroseconds(UINT64 uTicks) const;
+	UINT32			GetFileIndex(const char* pPath, UINT32 uLength);
+	UINT32			GetHandleFile(const FileTraceRecord& record) const;
+
+	UINT64							m_uTimebaseFrequency;
+	UINT64							m_uRecords;
+	UINT64							m_uMalformed;
+	UINT64							m_uCalls;
+	UINT64							m_uUnpaired;
+	UINT64							m_uFirstTimeBase;
+	UINT64							m_uLastTimeBase;
+	PendingMap						m_pending;
+	HandleMap						m_handles;
+	PathMap							m_paths;
+	ApiStatsMap						m_apiStats;
+	std::vector<FileTraceFileStats>	m_files;
+};
+
+#endif
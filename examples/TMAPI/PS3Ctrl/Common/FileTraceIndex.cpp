@@ -0,0 +1,737 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "FileTraceIndex.h"
+#include "WorkerThreads.h"
+#include <string.h>
+
+#define FILE_TRACE_COPY_BUFFER		(1024 * 1024)
+
+namespace
+{
+	bool WritePadding(FILE* pFile, UINT64& uOffset)
+	{
+		static const BYTE s_zeros[8] = { 0 };
+		UINT32 uPad = (UINT32)((8 - (uOffset & 7)) & 7);
+		if (uPad && fwrite(s_zeros, uPad, 1, pFile) != 1)
+			return false;
+		uOffset += uPad;
+		return true;
+	}
+
+	bool WriteTable(FILE* pFile, UINT64& uOffset, const std::vector<std::string>& entries)
+	{
+		std::vector<UINT64> offsets(entries.size() + 1);
+		UINT64 uSize = 0;
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			offsets[i] = uSize;
+			uSize += entries[i].size();
+		}
+		offsets[entries.size()] = uSize;
+
+		if (fwrite(&offsets[0], sizeof(UINT64), offsets.size(), pFile) != offsets.size())
+			return false;
+
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (!entries[i].empty() && fwrite(entries[i].data(), entries[i].size(), 1, pFile) != 1)
+				return false;
+		}
+
+		uOffset += offsets.size() * sizeof(UINT64) + uSize;
+		return true;
+	}
+
+	template <class T> bool WriteColumn(FILE* pFile, const std::vector<T>& values)
+	{
+		return values.empty() || fwrite(&values[0], sizeof(T), values.size(), pFile) == values.size();
+	}
+}
+
+UINT32 GetFileTraceColumnWidth(FileTraceColumn column)
+{
+	switch (column)
+	{
+	case FTCOL_TIMEBASE:	return sizeof(UINT64);
+	case FTCOL_DURATION:	return sizeof(UINT32);
+	case FTCOL_API:			return sizeof(UINT16);
+	case FTCOL_FILE:		return sizeof(UINT32);
+	case FTCOL_HANDLE:		return sizeof(UINT64);
+	case FTCOL_SIZE:		return sizeof(UINT64);
+	case FTCOL_BACKTRACE:	return sizeof(UINT32);
+	default:				return 0;
+	}
+}
+
+FileTraceIndexer::FileTraceIndexer()
+: m_nNextChunk(0)
+, m_hWindow(NULL)
+, m_nAbort(0)
+, m_uRecords(0)
+, m_uMalformed(0)
+, m_bCorrupt(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+	for (UINT32 i = 0; i < FTCOL_COUNT; ++i)
+		m_columns[i] = NULL;
+}
+
+FileTraceIndexer::~FileTraceIndexer()
+{
+	Cleanup();
+}
+
+void FileTraceIndexer::Cleanup()
+{
+	for (size_t i = 0; i < m_chunks.size(); ++i)
+	{
+		if (m_chunks[i]->hDone)
+			CloseHandle(m_chunks[i]->hDone);
+		delete m_chunks[i];
+	}
+	m_chunks.clear();
+
+	if (m_hWindow)
+	{
+		CloseHandle(m_hWindow);
+		m_hWindow = NULL;
+	}
+
+	for (UINT32 i = 0; i < FTCOL_COUNT; ++i)
+	{
+		if (m_columns[i])
+		{
+			fclose(m_columns[i]);
+			m_columns[i] = NULL;
+		}
+		if (!m_columnPaths[i].empty())
+		{
+			_wremove(m_columnPaths[i].c_str());
+			m_columnPaths[i].clear();
+		}
+	}
+}
+
+UINT32 FileTraceIndexer::Intern(Dictionary& dictionary, std::vector<std::string>& entries, const char* pData, size_t uLength)
+{
+	std::string strKey(pData, uLength);
+	Dictionary::const_iterator iter = dictionary.find(strKey);
+	if (iter != dictionary.end())
+		return iter->second;
+
+	UINT32 uId = (UINT32)entries.size();
+	entries.push_back(strKey);
+	dictionary[strKey] = uId;
+	return uId;
+}
+
+bool FileTraceIndexer::Build(const WCHAR* pszTracePath, const WCHAR* pszIndexPath, UINT32 uThreads)
+{
+	Cleanup();
+
+	m_strTracePath = pszTracePath;
+	m_blockOffsets.clear();
+	m_pathIds.clear();
+	m_paths.clear();
+	m_backTraceIds.clear();
+	m_backTraces.clear();
+	m_pending.Clear();
+	m_handles.Clear();
+	m_uRecords = 0;
+	m_uMalformed = 0;
+	m_bCorrupt = false;
+	m_nNextChunk = 0;
+	m_nAbort = 0;
+
+	// Hop over the block headers to find the chunk boundaries.
+	FileTraceReader reader;
+	if (!reader.Open(pszTracePath))
+		return false;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.uMagic = FILE_TRACE_INDEX_MAGIC;
+	m_header.uVersion = FILE_TRACE_INDEX_VERSION;
+	m_header.uTimebaseFrequency = reader.GetHeader().uTimebaseFrequency;
+
+	const BYTE* pRecords;
+	FileTraceBlockHeader block;
+	UINT64 uOffset = reader.GetFirstBlockOffset();
+	UINT64 uNext;
+	while (reader.MapBlock(uOffset, pRecords, block, uNext))
+	{
+		m_blockOffsets.push_back(uOffset);
+		uOffset = uNext;
+	}
+	m_bCorrupt = reader.IsCorrupt();
+	reader.Close();
+
+	for (size_t i = 0; i < m_blockOffsets.size(); i += FILE_TRACE_CHUNK_BLOCKS)
+	{
+		Chunk* pChunk = new Chunk();
+		pChunk->uFirstBlock = i;
+		pChunk->uBlockCount = m_blockOffsets.size() - i < FILE_TRACE_CHUNK_BLOCKS ? m_blockOffsets.size() - i : FILE_TRACE_CHUNK_BLOCKS;
+		pChunk->uRecords = 0;
+		pChunk->uMalformed = 0;
+		pChunk->bCorrupt = false;
+		pChunk->hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+		m_chunks.push_back(pChunk);
+
+		if (!pChunk->hDone)
+		{
+			Cleanup();
+			return false;
+		}
+	}
+
+	for (UINT32 i = 0; i < FTCOL_COUNT; ++i)
+	{
+		WCHAR szSuffix[16];
+		swprintf(szSuffix, _countof(szSuffix), L".col%u", i);
+		m_columnPaths[i] = std::wstring(pszIndexPath) + szSuffix;
+		m_columns[i] = _wfopen(m_columnPaths[i].c_str(), L"w+b");
+		if (!m_columns[i])
+		{
+			Cleanup();
+			return false;
+		}
+	}
+
+	if (uThreads == 0)
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		uThreads = si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+	}
+	if (uThreads > m_chunks.size())
+		uThreads = (UINT32)m_chunks.size();
+
+	// Workers may run this many chunks ahead of the merge.
+	m_hWindow = CreateSemaphore(NULL, uThreads * 2, 0x7fffffff, NULL);
+	if (!m_hWindow)
+	{
+		Cleanup();
+		return false;
+	}
+
+	WorkerThreads workers;
+	bool bOK = workers.Start<FileTraceIndexer, &FileTraceIndexer::WorkerThread>(uThreads, this) || m_chunks.empty();
+	for (size_t i = 0; bOK && i < m_chunks.size(); ++i)
+	{
+		Chunk& chunk = *m_chunks[i];
+		WaitForSingleObject(chunk.hDone, INFINITE);
+
+		bOK = MergeChunk(chunk);
+
+		// Release the chunk's memory; only its event is kept.
+		std::vector<ChunkRow>().swap(chunk.rows);
+		std::vector<std::string>().swap(chunk.paths);
+		std::vector<std::string>().swap(chunk.backTraces);
+		std::vector<ChunkStart>().swap(chunk.starts);
+
+		ReleaseSemaphore(m_hWindow, 1, NULL);
+	}
+
+	if (!bOK)
+	{
+		InterlockedExchange(&m_nAbort, 1);
+		ReleaseSemaphore(m_hWindow, (LONG)workers.GetCount(), NULL);
+	}
+
+	workers.Wait(INFINITE);
+
+	if (bOK)
+		bOK = WriteIndex(pszIndexPath);
+
+	Cleanup();
+	return bOK;
+}
+
+void FileTraceIndexer::WorkerThread()
+{
+	// Each worker maps its own window onto the trace.
+	FileTraceReader reader;
+	bool bOpen = reader.Open(m_strTracePath.c_str());
+
+	for (;;)
+	{
+		WaitForSingleObject(m_hWindow, INFINITE);
+		if (m_nAbort)
+			break;
+
+		LONG nChunk = InterlockedIncrement(&m_nNextChunk) - 1;
+		if (nChunk >= (LONG)m_chunks.size())
+		{
+			ReleaseSemaphore(m_hWindow, 1, NULL);
+			break;
+		}
+
+		Chunk& chunk = *m_chunks[nChunk];
+		if (bOpen)
+			ParseChunk(reader, chunk);
+		else
+			chunk.bCorrupt = true;
+
+		SetEvent(chunk.hDone);
+	}
+}
+
+void FileTraceIndexer::ParseChunk(FileTraceReader& reader, Chunk& chunk)
+{
+	Dictionary pathIds;
+	Dictionary backTraceIds;
+
+	for (size_t b = chunk.uFirstBlock; b < chunk.uFirstBlock + chunk.uBlockCount && !chunk.bCorrupt; ++b)
+	{
+		const BYTE* pRecords;
+		FileTraceBlockHeader block;
+		UINT64 uNext;
+		if (!reader.MapBlock(m_blockOffsets[b], pRecords, block, uNext))
+		{
+			chunk.bCorrupt = true;
+			break;
+		}
+
+		FileTraceBlockCursor cursor(pRecords, block);
+		const BYTE* pData;
+		UINT32 uLength;
+		while (cursor.Next(pData, uLength, chunk.bCorrupt))
+		{
+			++chunk.uRecords;
+
+			FileTraceRecord record;
+			if (!ParseFileTraceRecord(pData, uLength, record))
+			{
+				++chunk.uMalformed;
+				continue;
+			}
+
+			if (record.uApiType == SNPS3_FT_OFFLINE_END)
+				continue;
+
+			// Which call a start belongs to can depend on earlier chunks.
+			if (!IsFileTraceComplete(record.uStatus))
+			{
+				ChunkStart start;
+				start.uSerialId = record.uSerialId;
+				start.uTimeBase = record.uTimeBase;
+				start.uRow = chunk.rows.size();
+				chunk.starts.push_back(start);
+				continue;
+			}
+
+			ChunkRow row;
+			row.uSerialId = record.uSerialId;
+			row.uTimeBase = record.uTimeBase;
+			row.uVfsId = record.uVfsId;
+			row.uFd = record.uFd;
+			row.uProcessId = record.uProcessId;
+			row.uApiType = (UINT16)record.uApiType;
+			row.bHasHandle = record.bHasHandle;
+
+			FileTraceApiClass apiClass = GetFileTraceApiClass(record.uApiType);
+			row.uSize = (apiClass == FTC_READ || apiClass == FTC_WRITE) ? record.uTxSize : record.uSize;
+
+			row.uPath = record.uPathLength ? Intern(pathIds, chunk.paths, record.pPath, record.uPathLength) : FILE_TRACE_NO_ID;
+			row.uBackTrace = record.uBackTraceLength ?
+				Intern(backTraceIds, chunk.backTraces, reinterpret_cast<const char*>(record.pBackTrace), record.uBackTraceLength) : FILE_TRACE_NO_ID;
+
+			chunk.rows.push_back(row);
+		}
+	}
+}
+
+bool FileTraceIndexer::MergeChunk(Chunk& chunk)
+{
+	m_uRecords += chunk.uRecords;
+	m_uMalformed += chunk.uMalformed;
+	if (chunk.bCorrupt)
+		m_bCorrupt = true;
+
+	std::vector<UINT32> pathRemap(chunk.paths.size());
+	for (size_t i = 0; i < chunk.paths.size(); ++i)
+		pathRemap[i] = Intern(m_pathIds, m_paths, chunk.paths[i].data(), chunk.paths[i].size());
+
+	std::vector<UINT32> backTraceRemap(chunk.backTraces.size());
+	for (size_t i = 0; i < chunk.backTraces.size(); ++i)
+		backTraceRemap[i] = Intern(m_backTraceIds, m_backTraces, chunk.backTraces[i].data(), chunk.backTraces[i].size());
+
+	size_t uRows = chunk.rows.size();
+	std::vector<UINT64> timeBase(uRows);
+	std::vector<UINT32> duration(uRows);
+	std::vector<UINT16> api(uRows);
+	std::vector<UINT32> file(uRows);
+	std::vector<UINT64> handle(uRows);
+	std::vector<UINT64> size(uRows);
+	std::vector<UINT32> backTrace(uRows);
+
+	double fTicksToMicroseconds = 1000000.0 / m_header.uTimebaseFrequency;
+
+	size_t uNextStart = 0;
+	for (size_t i = 0; i < uRows; ++i)
+	{
+		const ChunkRow& row = chunk.rows[i];
+
+		// The calls started before this row, in this chunk or an earlier one.
+		for (; uNextStart < chunk.starts.size() && chunk.starts[uNextStart].uRow <= i; ++uNextStart)
+			AddPending(chunk.starts[uNextStart]);
+
+		UINT64 uStart = ~0ULL;
+		const UINT64* pStart = m_pending.Find(row.uSerialId);
+		if (pStart)
+		{
+			uStart = *pStart;
+			m_pending.Erase(row.uSerialId);
+		}
+
+		UINT32 uDuration = FILE_TRACE_NO_DURATION;
+		if (uStart != ~0ULL && row.uTimeBase >= uStart)
+		{
+			double fDuration = (row.uTimeBase - uStart) * fTicksToMicroseconds;
+			uDuration = fDuration < FILE_TRACE_NO_DURATION - 1 ? (UINT32)fDuration : FILE_TRACE_NO_DURATION - 1;
+		}
+
+		UINT32 uPath = row.uPath != FILE_TRACE_NO_ID ? pathRemap[row.uPath] : FILE_TRACE_NO_ID;
+		UINT32 uFile = uPath;
+		if (row.bHasHandle)
+		{
+			HandleKey key = { row.uProcessId, row.uVfsId, row.uFd };
+			FileTraceApiClass apiClass = GetFileTraceApiClass(row.uApiType);
+
+			if (apiClass == FTC_OPEN)
+			{
+				m_handles.Set(key, uPath);
+			}
+			else
+			{
+				const UINT32* pFile = m_handles.Find(key);
+				uFile = pFile ? *pFile : FILE_TRACE_NO_ID;
+				if (apiClass == FTC_CLOSE)
+					m_handles.Erase(key);
+			}
+		}
+
+		timeBase[i] = row.uTimeBase;
+		duration[i] = uDuration;
+		api[i] = row.uApiType;
+		file[i] = uFile;
+		handle[i] = row.uFd;
+		size[i] = row.uSize;
+		backTrace[i] = row.uBackTrace != FILE_TRACE_NO_ID ? backTraceRemap[row.uBackTrace] : FILE_TRACE_NO_ID;
+	}
+
+	// Calls still running at the end of this chunk may finish in a later one.
+	for (; uNextStart < chunk.starts.size(); ++uNextStart)
+		AddPending(chunk.starts[uNextStart]);
+
+	m_header.uRowCount += uRows;
+
+	return WriteColumn(m_columns[FTCOL_TIMEBASE], timeBase) &&
+		WriteColumn(m_columns[FTCOL_DURATION], duration) &&
+		WriteColumn(m_columns[FTCOL_API], api) &&
+		WriteColumn(m_columns[FTCOL_FILE], file) &&
+		WriteColumn(m_columns[FTCOL_HANDLE], handle) &&
+		WriteColumn(m_columns[FTCOL_SIZE], size) &&
+		WriteColumn(m_columns[FTCOL_BACKTRACE], backTrace);
+}
+
+void FileTraceIndexer::AddPending(const ChunkStart& start)
+{
+	// A call already started keeps its first start.
+	if (!m_pending.Find(start.uSerialId))
+		m_pending.Set(start.uSerialId, start.uTimeBase);
+}
+
+bool FileTraceIndexer::WriteIndex(const WCHAR* pszIndexPath)
+{
+	FILE* pFile = _wfopen(pszIndexPath, L"wb");
+	if (!pFile)
+		return false;
+
+	bool bOK = fwrite(&m_header, sizeof(m_header), 1, pFile) == 1;
+	UINT64 uOffset = sizeof(m_header);
+
+	std::vector<BYTE> buffer(FILE_TRACE_COPY_BUFFER);
+	for (UINT32 i = 0; bOK && i < FTCOL_COUNT; ++i)
+	{
+		bOK = WritePadding(pFile, uOffset) && fflush(m_columns[i]) == 0 && fseek(m_columns[i], 0, SEEK_SET) == 0;
+		m_header.uColumnOffset[i] = uOffset;
+
+		UINT64 uRemaining = m_header.uRowCount * GetFileTraceColumnWidth((FileTraceColumn)i);
+		while (bOK && uRemaining)
+		{
+			size_t uCount = uRemaining < buffer.size() ? (size_t)uRemaining : buffer.size();
+			bOK = fread(&buffer[0], uCount, 1, m_columns[i]) == 1 && fwrite(&buffer[0], uCount, 1, pFile) == 1;
+			uRemaining -= uCount;
+			uOffset += uCount;
+		}
+	}
+
+	if (bOK)
+	{
+		bOK = WritePadding(pFile, uOffset);
+		m_header.uPathTableOffset = uOffset;
+		m_header.uPathCount = m_paths.size();
+		bOK = bOK && WriteTable(pFile, uOffset, m_paths);
+	}
+
+	if (bOK)
+	{
+		bOK = WritePadding(pFile, uOffset);
+		m_header.uBackTraceTableOffset = uOffset;
+		m_header.uBackTraceCount = m_backTraces.size();
+		bOK = bOK && WriteTable(pFile, uOffset, m_backTraces);
+	}
+
+	if (bOK)
+		bOK = fseek(pFile, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, pFile) == 1;
+
+	if (fclose(pFile) != 0)
+		bOK = false;
+
+	if (!bOK)
+		_wremove(pszIndexPath);
+
+	return bOK;
+}
+
+FileTraceIndex::FileTraceIndex()
+: m_hFile(INVALID_HANDLE_VALUE)
+, m_hMapping(NULL)
+, m_pView(NULL)
+, m_uFileSize(0)
+, m_pHeader(NULL)
+, m_pTimeBase(NULL)
+, m_pDuration(NULL)
+, m_pApi(NULL)
+, m_pFile(NULL)
+, m_pHandle(NULL)
+, m_pSize(NULL)
+, m_pBackTrace(NULL)
+{
+
+}
+
+FileTraceIndex::~FileTraceIndex()
+{
+	Close();
+}
+
+bool FileTraceIndex::Open(const WCHAR* pszPath)
+{
+	Close();
+
+	m_hFile = CreateFileW(pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size) || (UINT64)size.QuadPart < sizeof(FileTraceIndexHeader) ||
+		(UINT64)size.QuadPart != (SIZE_T)size.QuadPart)
+	{
+		Close();
+		return false;
+	}
+	m_uFileSize = (UINT64)size.QuadPart;
+
+	// The whole index is mapped; the columns are small next to the trace.
+	m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping)
+		m_pView = static_cast<const BYTE*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, (SIZE_T)m_uFileSize));
+	if (!m_pView)
+	{
+		Close();
+		return false;
+	}
+
+	const FileTraceIndexHeader* pHeader = reinterpret_cast<const FileTraceIndexHeader*>(m_pView);
+	if (pHeader->uMagic != FILE_TRACE_INDEX_MAGIC || pHeader->uVersion != FILE_TRACE_INDEX_VERSION ||
+		pHeader->uTimebaseFrequency == 0)
+	{
+		Close();
+		return false;
+	}
+
+	for (UINT32 i = 0; i < FTCOL_COUNT; ++i)
+	{
+		UINT64 uWidth = GetFileTraceColumnWidth((FileTraceColumn)i);
+		if (pHeader->uColumnOffset[i] > m_uFileSize || pHeader->uRowCount > (m_uFileSize - pHeader->uColumnOffset[i]) / uWidth ||
+			(pHeader->uColumnOffset[i] & 7))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	if (pHeader->uPathTableOffset > m_uFileSize || pHeader->uPathCount >= (m_uFileSize - pHeader->uPathTableOffset) / sizeof(UINT64) ||
+		pHeader->uBackTraceTableOffset > m_uFileSize || pHeader->uBackTraceCount >= (m_uFileSize - pHeader->uBackTraceTableOffset) / sizeof(UINT64))
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	m_pTimeBase = reinterpret_cast<const UINT64*>(m_pView + pHeader->uColumnOffset[FTCOL_TIMEBASE]);
+	m_pDuration = reinterpret_cast<const UINT32*>(m_pView + pHeader->uColumnOffset[FTCOL_DURATION]);
+	m_pApi = reinterpret_cast<const UINT16*>(m_pView + pHeader->uColumnOffset[FTCOL_API]);
+	m_pFile = reinterpret_cast<const UINT32*>(m_pView + pHeader->uColumnOffset[FTCOL_FILE]);
+	m_pHandle = reinterpret_cast<const UINT64*>(m_pView + pHeader->uColumnOffset[FTCOL_HANDLE]);
+	m_pSize = reinterpret_cast<const UINT64*>(m_pView + pHeader->uColumnOffset[FTCOL_SIZE]);
+	m_pBackTrace = reinterpret_cast<const UINT32*>(m_pView + pHeader->uColumnOffset[FTCOL_BACKTRACE]);
+	return true;
+}
+
+void FileTraceIndex::Close()
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = NULL;
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_pHeader = NULL;
+	m_uFileSize = 0;
+}
+
+bool FileTraceIndex::GetTableEntry(UINT64 uTableOffset, UINT64 uCount, UINT32 uId, const BYTE*& pData, UINT64& uLength) const
+{
+	if (!m_pHeader || uId >= uCount)
+		return false;
+
+	const UINT64* pOffsets = reinterpret_cast<const UINT64*>(m_pView + uTableOffset);
+	UINT64 uBase = uTableOffset + (uCount + 1) * sizeof(UINT64);
+	if (pOffsets[uId] > pOffsets[uId + 1] || pOffsets[uId + 1] > m_uFileSize - uBase)
+		return false;
+
+	pData = m_pView + uBase + pOffsets[uId];
+	uLength = pOffsets[uId + 1] - pOffsets[uId];
+	return true;
+}
+
+std::string FileTraceIndex::GetPath(UINT32 uId) const
+{
+	const BYTE* pData;
+	UINT64 uLength;
+	if (!GetTableEntry(m_pHeader ? m_pHeader->uPathTableOffset : 0, GetPathCount(), uId, pData, uLength))
+		return std::string();
+
+	return std::string(reinterpret_cast<const char*>(pData), (size_t)uLength);
+}
+
+bool FileTraceIndex::GetBackTrace(UINT32 uId, const BYTE*& pData, UINT32& uLength) const
+{
+	UINT64 uTableLength;
+	if (!GetTableEntry(m_pHeader ? m_pHeader->uBackTraceTableOffset : 0, GetBackTraceCount(), uId, pData, uTableLength))
+		return false;
+
+	uLength = (UINT32)uTableLength;
+	return true;
+}
+
+void FileTraceIndex::Query(const FileTraceQuery& query, std::vector<UINT64>& rows) const
+{
+	rows.clear();
+	if (!m_pHeader)
+		return;
+
+	// Resolve the predicates on the dictionaries first, so the row passes
+	// are table lookups.
+	std::vector<BYTE> fileMatch;
+	bool bFileFilter = !query.strPath.empty();
+	if (bFileFilter)
+	{
+		fileMatch.resize((size_t)GetPathCount() + 1, 0);
+		for (UINT32 i = 0; i < GetPathCount(); ++i)
+			fileMatch[i] = GetPath(i).find(query.strPath) != std::string::npos;
+	}
+
+	std::vector<BYTE> apiMatch;
+	if (!query.bAnyApi)
+	{
+		apiMatch.resize(0x10000);
+		for (UINT32 i = 0; i < apiMatch.size(); ++i)
+			apiMatch[i] = GetFileTraceApiClass(i) == query.uApiClass;
+	}
+
+	UINT32 uPathCount = (UINT32)GetPathCount();
+	UINT64 uRowCount = m_pHeader->uRowCount;
+	std::vector<UINT32> selection(FILE_TRACE_QUERY_BATCH);
+	UINT32* pSel = &selection[0];
+
+	for (UINT64 uBase = 0; uBase < uRowCount; uBase += FILE_TRACE_QUERY_BATCH)
+	{
+		UINT32 uBatch = uRowCount - uBase < FILE_TRACE_QUERY_BATCH ? (UINT32)(uRowCount - uBase) : FILE_TRACE_QUERY_BATCH;
+		UINT32 uCount = 0;
+
+		if (query.uMinDuration)
+		{
+			const UINT32* pDuration = m_pDuration + uBase;
+			for (UINT32 i = 0; i < uBatch; ++i)
+			{
+				pSel[uCount] = i;
+				uCount += (pDuration[i] >= query.uMinDuration) & (pDuration[i] != FILE_TRACE_NO_DURATION);
+			}
+		}
+		else
+		{
+			for (UINT32 i = 0; i < uBatch; ++i)
+				pSel[i] = i;
+			uCount = uBatch;
+		}
+
+		if (!query.bAnyApi)
+		{
+			const UINT16* pApi = m_pApi + uBase;
+			UINT32 uKept = 0;
+			for (UINT32 j = 0; j < uCount; ++j)
+			{
+				UINT32 i = pSel[j];
+				pSel[uKept] = i;
+				uKept += apiMatch[pApi[i]];
+			}
+			uCount = uKept;
+		}
+
+		if (bFileFilter)
+		{
+			const UINT32* pFile = m_pFile + uBase;
+			UINT32 uKept = 0;
+			for (UINT32 j = 0; j < uCount; ++j)
+			{
+				UINT32 i = pSel[j];
+				UINT32 uFile = pFile[i] < uPathCount ? pFile[i] : uPathCount;
+				pSel[uKept] = i;
+				uKept += fileMatch[uFile];
+			}
+			uCount = uKept;
+		}
+
+		if (query.uMinSize)
+		{
+			const UINT64* pSize = m_pSize + uBase;
+			UINT32 uKept = 0;
+			for (UINT32 j = 0; j < uCount; ++j)
+			{
+				UINT32 i = pSel[j];
+				pSel[uKept] = i;
+				uKept += pSize[i] >= query.uMinSize;
+			}
+			uCount = uKept;
+		}
+
+		for (UINT32 j = 0; j < uCount; ++j)
+			rows.push_back(uBase + pSel[j]);
+	}
+}
@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef FILE_TRACE_INDEX_H
+#define FILE_TRACE_INDEX_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "FileTrace.h"
+#include "FileTraceAnalyzer.h"
+
+// File trace index:
+//
+//   FileTraceIndexHeader
+//   one array per column, uRowCount entries each, 8 byte aligned
+//   path table
+//   back-trace table
+//
+// There is one row per completed call. A table is UINT64 offsets[count + 1]
+// relative to the end of the offsets, followed by the entry bytes; paths and
+// back-traces are stored once however many rows refer to them.
+
+#define FILE_TRACE_INDEX_MAGIC			(0x58495446)	// 'FTIX'
+#define FILE_TRACE_INDEX_VERSION		(1)
+#define FILE_TRACE_NO_ID				(0xffffffff)
+#define FILE_TRACE_NO_DURATION			(0xffffffff)
+
+#define FILE_TRACE_CHUNK_BLOCKS			(8)				// Blocks parsed by a worker at a time
+#define FILE_TRACE_QUERY_BATCH			(4096)			// Rows filtered per column pass
+
+enum FileTraceColumn
+{
+	FTCOL_TIMEBASE,			// UINT64, time base at completion
+	FTCOL_DURATION,			// UINT32, microseconds or FILE_TRACE_NO_DURATION
+	FTCOL_API,				// UINT16, SNPS3_FT_*
+	FTCOL_FILE,				// UINT32, path table index or FILE_TRACE_NO_ID
+	FTCOL_HANDLE,			// UINT64, file descriptor
+	FTCOL_SIZE,				// UINT64, bytes transferred or size argument
+	FTCOL_BACKTRACE,		// UINT32, back-trace table index or FILE_TRACE_NO_ID
+	FTCOL_COUNT
+};
+
+struct FileTraceIndexHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT64	uTimebaseFrequency;
+	UINT64	uRowCount;
+	UINT64	uColumnOffset[FTCOL_COUNT];
+	UINT64	uPathTableOffset;
+	UINT64	uPathCount;
+	UINT64	uBackTraceTableOffset;
+	UINT64	uBackTraceCount;
+};
+
+UINT32 GetFileTraceColumnWidth(FileTraceColumn column);
+
+// Builds an index from a trace saved by FileTraceWriter. Blocks are split
+// into chunks that worker threads parse in parallel; chunks are then merged
+// in trace order, which is where calls are paired with their starts, and
+// handles with their opens, as a single pass over the trace would, and the
+// per-chunk dictionaries are folded together. Only a window of chunks is in
+// memory at once.
+class FileTraceIndexer
+{
+public:
+					FileTraceIndexer();
+					~FileTraceIndexer();
+
+	bool			Build(const WCHAR* pszTracePath, const WCHAR* pszIndexPath, UINT32 uThreads);
+
+	UINT64			GetRecordCount() const { return m_uRecords; }
+	UINT64			GetMalformedCount() const { return m_uMalformed; }
+	UINT64			GetRowCount() const { return m_header.uRowCount; }
+	UINT64			GetPathCount() const { return m_paths.size(); }
+	UINT64			GetBackTraceCount() const { return m_backTraces.size(); }
+	bool			IsCorrupt() const { return m_bCorrupt; }
+
+private:
+	struct ChunkRow
+	{
+		UINT64		uSerialId;
+		UINT64		uTimeBase;
+		UINT64		uVfsId;
+		UINT64		uFd;
+		UINT64		uSize;
+		UINT32		uProcessId;
+		UINT32		uPath;			// Chunk path index or FILE_TRACE_NO_ID
+		UINT32		uBackTrace;		// Chunk back-trace index or FILE_TRACE_NO_ID
+		UINT16		uApiType;
+		bool		bHasHandle;
+	};
+
+	typedef std::map<std::string, UINT32>	Dictionary;
+
+	// A call that has started; paired up when its chunk is merged.
+	struct ChunkStart
+	{
+		UINT64		uSerialId;
+		UINT64		uTimeBase;
+		size_t		uRow;			// Rows of the chunk before it
+	};
+
+	struct Chunk
+	{
+		size_t						uFirstBlock;
+		size_t						uBlockCount;
+		std::vector<ChunkRow>		rows;
+		std::vector<std::string>	paths;
+		std::vector<std::string>	backTraces;
+		std::vector<ChunkStart>		starts;
+		UINT64						uRecords;
+		UINT64						uMalformed;
+		bool						bCorrupt;
+		HANDLE						hDone;
+	};
+
+	struct HandleKey
+	{
+		UINT32		uProcessId;
+		UINT64		uVfsId;
+		UINT64		uFd;
+
+		bool operator<(const HandleKey& other) const
+		{
+			if (uProcessId != other.uProcessId)
+				return uProcessId < other.uProcessId;
+			if (uVfsId != other.uVfsId)
+				return uVfsId < other.uVfsId;
+			return uFd < other.uFd;
+		}
+	};
+
+	typedef FileTraceBoundedMap<UINT64, UINT64, FILE_TRACE_MAX_PENDING>		PendingMap;		// Serial ID -> start time base
+	typedef FileTraceBoundedMap<HandleKey, UINT32, FILE_TRACE_MAX_HANDLES>	HandleMap;		// Handle -> path ID
+
+	void			WorkerThread();
+	void			ParseChunk(FileTraceReader& reader, Chunk& chunk);
+	bool			MergeChunk(Chunk& chunk);
+	void			AddPending(const ChunkStart& start);
+	bool			WriteIndex(const WCHAR* pszIndexPath);
+	void			Cleanup();
+
+	static UINT32	Intern(Dictionary& dictionary, std::vector<std::string>& entries, const char* pData, size_t uLength);
+
+	std::wstring				m_strTracePath;
+	std::vector<UINT64>			m_blockOffsets;
+	std::vector<Chunk*>			m_chunks;
+	volatile LONG				m_nNextChunk;
+	HANDLE						m_hWindow;		// Limits chunks parsed ahead of the merge
+	volatile LONG				m_nAbort;
+
+	FileTraceIndexHeader		m_header;
+	FILE*						m_columns[FTCOL_COUNT];
+	std::wstring				m_columnPaths[FTCOL_COUNT];
+	Dictionary					m_pathIds;
+	std::vector<std::string>	m_paths;
+	Dictionary					m_backTraceIds;
+	std::vector<std::string>	m_backTraces;
+	PendingMap					m_pending;
+	HandleMap					m_handles;
+	UINT64						m_uRecords;
+	UINT64						m_uMalformed;
+	bool						m_bCorrupt;
+};
+
+struct FileTraceQuery
+{
+					FileTraceQuery() : uApiClass(FTC_OTHER), bAnyApi(true), uMinDuration(0), uMinSize(0) {}
+
+	FileTraceApiClass	uApiClass;
+	bool				bAnyApi;
+	UINT32				uMinDuration;		// Microseconds
+	UINT64				uMinSize;
+	std::string			strPath;			// Substring of the path, empty for any file
+};
+
+// Read-only view of an index. Queries filter whole column batches at a time
+// into a selection vector, so each pass is a tight loop over one array.
+class FileTraceIndex
+{
+public:
+					FileTraceIndex();
+					~FileTraceIndex();
+
+	bool			Open(const WCHAR* pszPath);
+	void			Close();
+
+	const FileTraceIndexHeader& GetHeader() const { return *m_pHeader; }
+	UINT64			GetRowCount() const { return m_pHeader ? m_pHeader->uRowCount : 0; }
+
+	void			Query(const FileTraceQuery& query, std::vector<UINT64>& rows) const;
+
+	UINT64			GetTimeBase(UINT64 uRow) const		{ return m_pTimeBase[uRow]; }
+	UINT32			GetDuration(UINT64 uRow) const		{ return m_pDuration[uRow]; }
+	UINT16			GetApiType(UINT64 uRow) const		{ return m_pApi[uRow]; }
+	UINT32			GetFile(UINT64 uRow) const			{ return m_pFile[uRow]; }
+	UINT64			GetHandle(UINT64 uRow) const		{ return m_pHandle[uRow]; }
+	UINT64			GetSize(UINT64 uRow) const			{ return m_pSize[uRow]; }
+	UINT32			GetBackTrace(UINT64 uRow) const		{ return m_pBackTrace[uRow]; }
+
+	UINT64			GetPathCount() const { return m_pHeader ? m_pHeader->uPathCount : 0; }
+	std::string		GetPath(UINT32 uId) const;
+	UINT64			GetBackTraceCount() const { return m_pHeader ? m_pHeader->uBackTraceCount : 0; }
+	bool			GetBackTrace(UINT32 uId, const BYTE*& pData, UINT32& uLength) const;
+
+private:
+	bool			GetTableEntry(UINT64 uTableOffset, UINT64 uCount, UINT32 uId, const BYTE*& pData, UINT64& uLength) const;
+
+	HANDLE						m_hFile;
+	HANDLE						m_hMapping;
+	const BYTE*					m_pView;
+	UINT64						m_uFileSize;
+	const FileTraceIndexHeader*	m_pHeader;
+	const UINT64*				m_pTimeBase;
+	const UINT32*				m_pDuration;
+	const UINT16*				m_pApi;
+	const UINT32*				m_pFile;
+	const UINT64*				m_pHandle;
+	const UINT64*				m_pSize;
+	const UINT32*				m_pBackTrace;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "HdrHistogram.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Index of the highest set bit; uValue must be non-zero.
+	UINT32 HighestBit(UINT64 uValue)
+	{
+#ifdef _MSC_VER
+		unsigned long uIndex;
+		if (_BitScanReverse(&uIndex, (unsigned long)(uValue >> 32)))
+			return uIndex + 32;
+		_BitScanReverse(&uIndex, (unsigned long)uValue);
+		return uIndex;
+#else
+		return 63 - __builtin_clzll(uValue);
+#endif
+	}
+}
+
+HdrHistogram::HdrHistogram(UINT64 uHighestTrackable, UINT32 uSignificantDigits)
+: m_uHighestTrackable(uHighestTrackable < 2 ? 2 : uHighestTrackable)
+, m_uSignificantDigits(uSignificantDigits < 1 ? 1 : (uSignificantDigits > 5 ? 5 : uSignificantDigits))
+{
+	// Values below this are recorded exactly.
+	UINT64 uSingleUnitRange = 2;
+	for (UINT32 i = 0; i < m_uSignificantDigits; ++i)
+		uSingleUnitRange *= 10;
+
+	UINT32 uSubBucketCountMagnitude = HighestBit(uSingleUnitRange - 1) + 1;
+	m_uSubBucketHalfCountMagnitude = uSubBucketCountMagnitude - 1;
+	m_uSubBucketCount = 1 << uSubBucketCountMagnitude;
+	m_uSubBucketHalfCount = m_uSubBucketCount / 2;
+	m_uSubBucketMask = m_uSubBucketCount - 1;
+
+	UINT32 uBucketCount = 1;
+	UINT64 uSmallestUntrackable = m_uSubBucketCount;
+	while (uSmallestUntrackable <= m_uHighestTrackable && uBucketCount < 64 - uSubBucketCountMagnitude)
+	{
+		uSmallestUntrackable <<= 1;
+		++uBucketCount;
+	}
+
+	m_counts.resize((uBucketCount + 1) * m_uSubBucketHalfCount);
+	Reset();
+}
+
+void HdrHistogram::Reset()
+{
+	std::fill(m_counts.begin(), m_counts.end(), 0);
+	m_uTotalCount = 0;
+	m_uTotal = 0;
+	m_uMin = ~0ULL;
+	m_uMax = 0;
+	m_uSaturated = 0;
+}
+
+UINT32 HdrHistogram::GetCountsIndex(UINT64 uValue) const
+{
+	UINT32 uBucketIndex = HighestBit(uValue | m_uSubBucketMask) - m_uSubBucketHalfCountMagnitude;
+	UINT32 uSubBucketIndex = (UINT32)(uValue >> uBucketIndex);
+	return (uBucketIndex << m_uSubBucketHalfCountMagnitude) + uSubBucketIndex;
+}
+
+UINT64 HdrHistogram::GetValueFromIndex(UINT32 uIndex) const
+{
+	INT32 nBucketIndex = (INT32)(uIndex >> m_uSubBucketHalfCountMagnitude) - 1;
+	UINT32 uSubBucketIndex = (uIndex & (m_uSubBucketHalfCount - 1)) + m_uSubBucketHalfCount;
+	if (nBucketIndex < 0)
+	{
+		uSubBucketIndex -= m_uSubBucketHalfCount;
+		nBucketIndex = 0;
+	}
+	return (UINT64)uSubBucketIndex << nBucketIndex;
+}
+
+UINT64 HdrHistogram::GetHighestEquivalentValue(UINT64 uValue) const
+{
+	UINT32 uBucketIndex = HighestBit(uValue | m_uSubBucketMask) - m_uSubBucketHalfCountMagnitude;
+	UINT64 uLowest = uValue & ~((1ULL << uBucketIndex) - 1);
+	return uLowest + (1ULL << uBucketIndex) - 1;
+}
+
+void HdrHistogram::RecordN(UINT64 uValue, UINT64 uCount)
+{
+	if (uValue > m_uHighestTrackable)
+	{
+		uValue = m_uHighestTrackable;
+		m_uSaturated += uCount;
+	}
+
+	UINT32 uIndex = GetCountsIndex(uValue);
+	if (uIndex >= m_counts.size())
+		uIndex = (UINT32)m_counts.size() - 1;
+
+	m_counts[uIndex] += uCount;
+	m_uTotalCount += uCount;
+	m_uTotal += uValue * uCount;
+	if (uValue < m_uMin)
+		m_uMin = uValue;
+	if (uValue > m_uMax)
+		m_uMax = uValue;
+}
+
+void HdrHistogram::Add(const HdrHistogram& other)
+{
+	if (other.m_uTotalCount == 0)
+		return;
+
+	if (other.m_counts.size() == m_counts.size() && other.m_uSubBucketCount == m_uSubBucketCount)
+	{
+		for (size_t i = 0; i < m_counts.size(); ++i)
+			m_counts[i] += other.m_counts[i];
+
+		m_uTotalCount += other.m_uTotalCount;
+		m_uTotal += other.m_uTotal;
+		m_uSaturated += other.m_uSaturated;
+		if (other.m_uMin < m_uMin)
+			m_uMin = other.m_uMin;
+		if (other.m_uMax > m_uMax)
+			m_uMax = other.m_uMax;
+		return;
+	}
+
+	// Different layouts: re-record each populated bucket at its value.
+	for (UINT32 i = 0; i < other.m_counts.size(); ++i)
+	{
+		if (other.m_counts[i])
+			RecordN(other.GetValueFromIndex(i), other.m_counts[i]);
+	}
+}
+
+double HdrHistogram::GetMean() const
+{
+	return m_uTotalCount ? (double)m_uTotal / m_uTotalCount : 0.0;
+}
+
+UINT64 HdrHistogram::GetValueAtPercentile(double fPercentile) const
+{
+	if (m_uTotalCount == 0)
+		return 0;
+
+	if (fPercentile > 100.0)
+		fPercentile = 100.0;
+
+	UINT64 uTarget = (UINT64)(fPercentile / 100.0 * m_uTotalCount + 0.5);
+	if (uTarget < 1)
+		uTarget = 1;
+
+	UINT64 uSeen = 0;
+	for (UINT32 i = 0; i < m_counts.size(); ++i)
+	{
+		uSeen += m_counts[i];
+		if (uSeen >= uTarget)
+		{
+			UINT64 uValue = GetHighestEquivalentValue(GetValueFromIndex(i));
+			return uValue < m_uMax ? uValue : m_uMax;
+		}
+	}
+
+	return m_uMax;
+}
@@ -0,0 +1,55 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <windows.h>
+#include <vector>
+
+// High dynamic range histogram: values from 1 to uHighestTrackable are
+// recorded with a fixed number of significant decimal digits, using
+// log2(range) buckets of linear sub-buckets. Recording is a couple of
+// shifts and an increment, and memory does not grow with the sample count.
+class HdrHistogram
+{
+public:
+				HdrHistogram(UINT64 uHighestTrackable = 3600ULL * 1000 * 1000, UINT32 uSignificantDigits = 3);
+
+	void		Record(UINT64 uValue)						{ RecordN(uValue, 1); }
+	void		RecordN(UINT64 uValue, UINT64 uCount);
+	void		Add(const HdrHistogram& other);
+	void		Reset();
+
+	UINT64		GetCount() const							{ return m_uTotalCount; }
+	UINT64		GetMin() const								{ return m_uTotalCount ? m_uMin : 0; }
+	UINT64		GetMax() const								{ return m_uMax; }
+	UINT64		GetTotal() const							{ return m_uTotal; }
+	double		GetMean() const;
+	UINT64		GetValueAtPercentile(double fPercentile) const;
+	UINT64		GetSaturatedCount() const					{ return m_uSaturated; }
+	size_t		GetMemorySize() const						{ return m_counts.size() * sizeof(UINT64); }
+
+private:
+	UINT32		GetCountsIndex(UINT64 uValue) const;
+	UINT64		GetValueFromIndex(UINT32 uIndex) const;
+	UINT64		GetHighestEquivalentValue(UINT64 uValue) const;
+
+	UINT64				m_uHighestTrackable;
+	UINT32				m_uSignificantDigits;
+	UINT32				m_uSubBucketHalfCountMagnitude;
+	UINT32				m_uSubBucketHalfCount;
+	UINT64				m_uSubBucketMask;
+	UINT32				m_uSubBucketCount;
+	std::vector<UINT64>	m_counts;
+	UINT64				m_uTotalCount;
+	UINT64				m_uTotal;
+	UINT64				m_uMin;
+	UINT64				m_uMax;
+	UINT64				m_uSaturated;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "InstallLedger.h"
+#include "RecordFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PKG_MAGIC					(0x7f504b47)	// '\x7fPKG'
+#define PKG_CONTENT_ID_OFFSET		(0x30)
+#define PKG_CONTENT_ID_SIZE			(36)
+#define PKG_DIGEST_OFFSET			(0x60)
+#define PKG_DIGEST_SIZE				(16)
+#define PKG_HEADER_SIZE				(PKG_DIGEST_OFFSET + PKG_DIGEST_SIZE)
+#define PKG_TITLE_ID_OFFSET			(7)
+#define PKG_TITLE_ID_SIZE			(9)
+
+#define SFO_MAX_PARAMETER			(256)
+
+#define INSTALL_LEDGER_FILE_NAME	L"PS3Ctrl_install.ledger"
+#define INSTALL_LEDGER_HEADER		"# PS3Ctrl install ledger 1: target, title, version, stamp, source"
+
+namespace
+{
+	UINT64 HashBytes(UINT64 uHash, const void* pData, size_t uSize)
+	{
+		// FNV-1a
+		const BYTE* pBytes = (const BYTE*)pData;
+		for (size_t i = 0; i < uSize; ++i)
+		{
+			uHash ^= pBytes[i];
+			uHash *= 0x100000001b3ULL;
+		}
+		return uHash;
+	}
+
+	const UINT64 HASH_SEED = 0xcbf29ce484222325ULL;
+
+	// Hashes the relative name, size and write time of every file under
+	// strDirectory. FindFirstFile() returns entries in the order the file
+	// system keeps them, which for NTFS is sorted, so the stamp is stable.
+	UINT64 StampDirectory(const std::wstring& strDirectory, const std::wstring& strRelative, UINT64 uHash)
+	{
+		WIN32_FIND_DATAW data;
+		HANDLE hFind = ::FindFirstFileW((strDirectory + L"\\*").c_str(), &data);
+		if (hFind == INVALID_HANDLE_VALUE)
+			return uHash;
+
+		do
+		{
+			if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+				continue;
+
+			std::wstring strName = strRelative + data.cFileName;
+			uHash = HashBytes(uHash, strName.c_str(), (strName.size() + 1) * sizeof(WCHAR));
+
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{
+				uHash = StampDirectory(strDirectory + L"\\" + data.cFileName, strName + L"\\", uHash);
+			}
+			else
+			{
+				UINT64 uSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+				UINT64 uTime = ((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+				uHash = HashBytes(uHash, &uSize, sizeof(uSize));
+				uHash = HashBytes(uHash, &uTime, sizeof(uTime));
+			}
+		}
+		while (::FindNextFileW(hFind, &data));
+
+		::FindClose(hFind);
+		return uHash;
+	}
+
+	SNRESULT ReadGameParameter(const char* pszSfoPath, const char* pszKey, std::string& strValue)
+	{
+		BYTE buffer[SFO_MAX_PARAMETER];
+		UINT32 uSize = sizeof(buffer);
+
+		SNRESULT snr = SNPS3ExtractGameParameter(pszSfoPath, pszKey, &uSize, buffer);
+		if (SN_FAILED(snr))
+			return snr;
+
+		// Strings in PARAM.SFO are NUL terminated, but the size can include padding.
+		strValue.assign((const char*)buffer, strnlen((const char*)buffer, uSize));
+		return snr;
+	}
+}
+
+SNRESULT ReadGameIdentity(const std::string& strSfoPath, InstallIdentity& identity)
+{
+	SNRESULT snr;
+	if (SN_FAILED(snr = ReadGameParameter(strSfoPath.c_str(), "TITLE_ID", identity.strTitleId)))
+		return snr;
+
+	if (SN_FAILED(snr = ReadGameParameter(strSfoPath.c_str(), "VERSION", identity.strVersion)))
+		return snr;
+
+	std::wstring strDirectory = UTF8ToWChar(strSfoPath);
+	size_t uSlash = strDirectory.find_last_of(L"\\/");
+	strDirectory = uSlash == std::wstring::npos ? L"." : strDirectory.substr(0, uSlash);
+
+	identity.uContentStamp = StampDirectory(strDirectory, L"", HASH_SEED);
+	return snr;
+}
+
+bool ReadPackageIdentity(const std::string& strPkgPath, InstallIdentity& identity)
+{
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, UTF8ToWChar(strPkgPath).c_str(), L"rb") != 0 || !pFile)
+		return false;
+
+	BYTE header[PKG_HEADER_SIZE];
+	bool bRead = fread(header, 1, sizeof(header), pFile) == sizeof(header);
+	fclose(pFile);
+
+	if (!bRead)
+		return false;
+
+	UINT32 uMagic = ((UINT32)header[0] << 24) | ((UINT32)header[1] << 16) | ((UINT32)header[2] << 8) | header[3];
+	if (uMagic != PKG_MAGIC)
+		return false;
+
+	const char* pszContentId = (const char*)header + PKG_CONTENT_ID_OFFSET;
+	identity.strVersion.assign(pszContentId, strnlen(pszContentId, PKG_CONTENT_ID_SIZE));
+	if (identity.strVersion.size() < PKG_TITLE_ID_OFFSET + PKG_TITLE_ID_SIZE)
+		return false;
+
+	identity.strTitleId = identity.strVersion.substr(PKG_TITLE_ID_OFFSET, PKG_TITLE_ID_SIZE);
+	identity.uContentStamp = HashBytes(HASH_SEED, header + PKG_DIGEST_OFFSET, PKG_DIGEST_SIZE);
+	return true;
+}
+
+bool InstallLedger::Load(const WCHAR* pszPath)
+{
+	m_records.clear();
+
+	RecordFileReader reader;
+	if (!reader.Open(pszPath))
+		return false;
+
+	// target, title, version, stamp, source
+	char* apFields[5];
+	while (UINT32 uFields = reader.Next(apFields, _countof(apFields)))
+	{
+		if (uFields != _countof(apFields) || apFields[0][0] == '\0' || apFields[1][0] == '\0')
+			continue;
+
+		InstallRecord record;
+		record.strTarget = apFields[0];
+		record.strTitleId = apFields[1];
+		record.strVersion = apFields[2];
+		record.uContentStamp = _strtoui64(apFields[3], NULL, 16);
+		record.strSource = apFields[4];
+		Set(record);
+	}
+
+	return true;
+}
+
+bool InstallLedger::Save(const WCHAR* pszPath) const
+{
+	RecordFileWriter writer;
+	if (!writer.Open(pszPath, INSTALL_LEDGER_HEADER))
+		return false;
+
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		const InstallRecord& record = m_records[i];
+		writer.Print("%s\t%s\t%s\t%016llx\t%s\n", record.strTarget.c_str(), record.strTitleId.c_str(),
+			record.strVersion.c_str(), record.uContentStamp, record.strSource.c_str());
+	}
+
+	return writer.Commit();
+}
+
+const InstallRecord* InstallLedger::Find(const std::string& strTarget, const std::string& strTitleId) const
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == strTarget && m_records[i].strTitleId == strTitleId)
+			return &m_records[i];
+	}
+	return NULL;
+}
+
+bool InstallLedger::IsInstalled(const std::string& strTarget, const InstallIdentity& identity) const
+{
+	const InstallRecord* pRecord = Find(strTarget, identity.strTitleId);
+	return pRecord && pRecord->strVersion == identity.strVersion && pRecord->uContentStamp == identity.uContentStamp;
+}
+
+void InstallLedger::Set(const InstallRecord& record)
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == record.strTarget && m_records[i].strTitleId == record.strTitleId)
+		{
+			m_records[i] = record;
+			return;
+		}
+	}
+	m_records.push_back(record);
+}
+
+void InstallLedger::Remove(const std::string& strTarget, const std::string& strTitleId)
+{
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].strTarget == strTarget && m_records[i].strTitleId == strTitleId)
+		{
+			m_records.erase(m_records.begin() + i);
+			return;
+		}
+	}
+}
+
+std::wstring InstallLedger::GetDefaultPath()
+{
+	WCHAR szTemp[MAX_PATH + 1];
+	DWORD dwLength = ::GetTempPathW(_countof(szTemp), szTemp);
+
+	std::wstring strPath = dwLength && dwLength < _countof(szTemp) ? szTemp : L"";
+	strPath += INSTALL_LEDGER_FILE_NAME;
+	return strPath;
+}
@@ -0,0 +1,67 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef INSTALL_LEDGER_H
+#define INSTALL_LEDGER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+
+// TMAPI cannot list the titles installed on a target, so the ledger is the
+// host's record of the last successful install of each title on each target.
+// A target whose record matches the content about to be installed is skipped.
+//
+// uContentStamp tells apart builds that share a version string: for a game
+// directory it hashes the name, size and write time of every file next to
+// PARAM.SFO, for a package it is taken from the digest in the package header.
+// Packages carry their PARAM.SFO encrypted, so their version is the content
+// ID from the header.
+
+struct InstallIdentity
+{
+	std::string		strTitleId;
+	std::string		strVersion;
+	UINT64			uContentStamp;
+};
+
+struct InstallRecord
+{
+	std::string		strTarget;
+	std::string		strTitleId;
+	std::string		strVersion;
+	UINT64			uContentStamp;
+	std::string		strSource;		// SFO or package path installed from
+};
+
+// Reads TITLE_ID and VERSION from PARAM.SFO with SNPS3ExtractGameParameter()
+// and stamps the files of the directory holding it.
+SNRESULT ReadGameIdentity(const std::string& strSfoPath, InstallIdentity& identity);
+
+// Reads the content ID and digest from a package header. The title ID is the
+// nine characters after the publisher code, as in UP0001-BLUS12345_00-....
+bool ReadPackageIdentity(const std::string& strPkgPath, InstallIdentity& identity);
+
+class InstallLedger
+{
+public:
+	// A missing ledger loads as empty.
+	bool			Load(const WCHAR* pszPath);
+	bool			Save(const WCHAR* pszPath) const;
+
+	const InstallRecord* Find(const std::string& strTarget, const std::string& strTitleId) const;
+	bool			IsInstalled(const std::string& strTarget, const InstallIdentity& identity) const;
+	void			Set(const InstallRecord& record);
+	void			Remove(const std::string& strTarget, const std::string& strTitleId);
+
+	static std::wstring	GetDefaultPath();
+
+private:
+	std::vector<InstallRecord>	m_records;
+};
+
+#endif
@@ -0,0 +1,292 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "MatWatch.h"
+#include <algorithm>
+
+#define MAT_PAGE_MASK		(~(UINT32)(MAT_PAGE_SIZE - 1))
+
+MatWatchManager::MatWatchManager(HTARGET hTarget, UINT32 uProcessId)
+: m_hTarget(hTarget)
+, m_uProcessId(uProcessId)
+, m_uNextId(1)
+, m_uAppliedRanges(0)
+, m_uAppliedPages(0)
+{
+}
+
+SNRESULT MatWatchManager::Init()
+{
+	m_ranges.clear();
+
+	UINT32 uCount = 0;
+	SNRESULT snr = SNPS3GetMATRanges(m_hTarget, m_uProcessId, &uCount, NULL);
+	if (SN_FAILED(snr) || uCount == 0)
+		return snr;
+
+	std::vector<BYTE> ranges(uCount * sizeof(SNPS3MATRange));
+	if (SN_FAILED(snr = SNPS3GetMATRanges(m_hTarget, m_uProcessId, &uCount, &ranges[0])))
+		return snr;
+
+	UINT32 uRangeCount = uCount;
+	UINT32 uBufSize = 0;
+	if (SN_FAILED(snr = SNPS3GetMATConditions(m_hTarget, m_uProcessId, &uRangeCount, &ranges[0], &uBufSize, NULL)))
+		return snr;
+
+	std::vector<BYTE> conditions(uBufSize);
+	uRangeCount = uCount;
+	if (uBufSize == 0 || SN_FAILED(snr = SNPS3GetMATConditions(m_hTarget, m_uProcessId, &uRangeCount, &ranges[0], &uBufSize, &conditions[0])))
+		return snr;
+
+	std::vector<SNPS3MATRange*> pointers(uRangeCount);
+	if (uRangeCount == 0 || SN_FAILED(snr = SNPS3GetMATRangePointers(uRangeCount, &conditions[0], &pointers[0])))
+		return snr;
+
+	for (UINT32 i = 0; i < uRangeCount; ++i)
+	{
+		Range range;
+		range.uStart = pointers[i]->uStartAddress;
+		range.uSize = pointers[i]->uSize;
+		range.original.assign(pointers[i]->aPageConditions, pointers[i]->aPageConditions + range.uSize / MAT_PAGE_SIZE);
+		m_ranges.push_back(range);
+	}
+
+	std::sort(m_ranges.begin(), m_ranges.end(), StartsBefore);
+
+	return snr;
+}
+
+UINT32 MatWatchManager::Add(UINT32 uAddress, UINT32 uSize, BYTE uCondition, const std::string& strOwner)
+{
+	if (uSize == 0 || (uCondition != SNPS3_MAT_COND_WRITE && uCondition != SNPS3_MAT_COND_READ_WRITE))
+		return 0;
+
+	UINT32 uLast = uAddress + (uSize - 1);
+	const Range* pRange = FindRange(uAddress);
+	if (uLast < uAddress || !pRange || uLast - pRange->uStart >= pRange->uSize)
+		return 0;
+
+	UINT32 uFirstPage = uAddress & MAT_PAGE_MASK;
+	UINT32 uLastPage = uLast & MAT_PAGE_MASK;
+
+	// Pages the target cannot trap
+	for (UINT32 uPage = uFirstPage; ; uPage += MAT_PAGE_SIZE)
+	{
+		if (pRange->original[(uPage - pRange->uStart) / MAT_PAGE_SIZE] == SNPS3_MAT_COND_ERR)
+			return 0;
+		if (uPage == uLastPage)
+			break;
+	}
+
+	UINT32 uId = m_uNextId++;
+	MatWatch& watch = m_watches[uId];
+	watch.uAddress = uAddress;
+	watch.uSize = uSize;
+	watch.uCondition = uCondition;
+	watch.strOwner = strOwner;
+
+	for (UINT32 uPage = uFirstPage; ; uPage += MAT_PAGE_SIZE)
+	{
+		std::map<UINT32, Page>::iterator it = m_pages.find(uPage);
+		if (it == m_pages.end())
+		{
+			Page page;
+			page.uWrite = 0;
+			page.uReadWrite = 0;
+			page.uOriginal = pRange->original[(uPage - pRange->uStart) / MAT_PAGE_SIZE];
+			page.uApplied = page.uOriginal;
+			it = m_pages.insert(std::make_pair(uPage, page)).first;
+		}
+
+		if (uCondition == SNPS3_MAT_COND_READ_WRITE)
+			it->second.uReadWrite++;
+		else
+			it->second.uWrite++;
+		it->second.watches.push_back(uId);
+		m_dirty.insert(uPage);
+
+		if (uPage == uLastPage)
+			break;
+	}
+
+	return uId;
+}
+
+bool MatWatchManager::Remove(UINT32 uId)
+{
+	std::map<UINT32, MatWatch>::iterator watch = m_watches.find(uId);
+	if (watch == m_watches.end())
+		return false;
+
+	UINT32 uFirstPage = watch->second.uAddress & MAT_PAGE_MASK;
+	UINT32 uLastPage = (watch->second.uAddress + (watch->second.uSize - 1)) & MAT_PAGE_MASK;
+
+	for (UINT32 uPage = uFirstPage; ; uPage += MAT_PAGE_SIZE)
+	{
+		Page& page = m_pages[uPage];
+		if (watch->second.uCondition == SNPS3_MAT_COND_READ_WRITE)
+			page.uReadWrite--;
+		else
+			page.uWrite--;
+		page.watches.erase(std::find(page.watches.begin(), page.watches.end(), uId));
+		m_dirty.insert(uPage);
+
+		if (uPage == uLastPage)
+			break;
+	}
+
+	m_watches.erase(watch);
+	return true;
+}
+
+void MatWatchManager::RemoveAll()
+{
+	while (!m_watches.empty())
+		Remove(m_watches.begin()->first);
+}
+
+SNRESULT MatWatchManager::Apply()
+{
+	std::vector<UINT32> changed;
+	for (std::set<UINT32>::const_iterator it = m_dirty.begin(); it != m_dirty.end(); ++it)
+	{
+		const Page& page = m_pages[*it];
+		if (GetWanted(page) != page.uApplied)
+			changed.push_back(*it);
+	}
+
+	m_uAppliedRanges = 0;
+	m_uAppliedPages = 0;
+
+	if (!changed.empty())
+	{
+		// Each range costs a header, so pages left as they are between two
+		// changed ones are sent too while there are fewer of them than its bytes.
+		std::vector<BYTE> buffer;
+		size_t i = 0;
+		while (i < changed.size())
+		{
+			const Range* pRange = FindRange(changed[i]);
+			UINT32 uRangeLastPage = pRange->uStart + (pRange->uSize - MAT_PAGE_SIZE);
+			UINT32 uStart = changed[i];
+			UINT32 uLastPage = uStart;
+
+			for (++i; i < changed.size() && changed[i] <= uRangeLastPage; ++i)
+			{
+				if ((changed[i] - uLastPage) / MAT_PAGE_SIZE - 1 >= sizeof(SNPS3MATRange))
+					break;
+				uLastPage = changed[i];
+			}
+
+			UINT32 uPages = (uLastPage - uStart) / MAT_PAGE_SIZE + 1;
+			size_t uOffset = buffer.size();
+			buffer.resize(uOffset + sizeof(SNPS3MATRange) + uPages);
+
+			SNPS3MATRange header;
+			header.uStartAddress = uStart;
+			header.uSize = uPages * MAT_PAGE_SIZE;
+			memcpy(&buffer[uOffset], &header, sizeof(SNPS3MATRange));
+
+			for (UINT32 uPage = 0; uPage < uPages; ++uPage)
+				buffer[uOffset + sizeof(SNPS3MATRange) + uPage] = GetWanted(uStart + uPage * MAT_PAGE_SIZE);
+
+			m_uAppliedRanges++;
+			m_uAppliedPages += uPages;
+		}
+
+		SNRESULT snr = SNPS3SetMATConditions(m_hTarget, m_uProcessId, m_uAppliedRanges, (UINT32)buffer.size(), &buffer[0]);
+		if (SN_FAILED(snr))
+		{
+			// Still dirty, for the next one.
+			m_uAppliedRanges = 0;
+			m_uAppliedPages = 0;
+			return snr;
+		}
+	}
+
+	for (std::set<UINT32>::const_iterator it = m_dirty.begin(); it != m_dirty.end(); ++it)
+	{
+		std::map<UINT32, Page>::iterator page = m_pages.find(*it);
+		page->second.uApplied = GetWanted(page->second);
+		if (page->second.watches.empty() && page->second.uApplied == page->second.uOriginal)
+			m_pages.erase(page);
+	}
+	m_dirty.clear();
+
+	return SN_S_OK;
+}
+
+void MatWatchManager::FindHits(UINT64 uAddress, bool bStore, std::vector<UINT32>& hits) const
+{
+	std::vector<UINT32> watches;
+	GetPageWatches(uAddress, watches);
+
+	for (size_t i = 0; i < watches.size(); ++i)
+	{
+		const MatWatch& watch = m_watches.find(watches[i])->second;
+		if (uAddress - watch.uAddress < watch.uSize && (bStore || watch.uCondition == SNPS3_MAT_COND_READ_WRITE))
+			hits.push_back(watches[i]);
+	}
+}
+
+void MatWatchManager::GetPageWatches(UINT64 uAddress, std::vector<UINT32>& watches) const
+{
+	if (uAddress > 0xFFFFFFFF)
+		return;
+
+	std::map<UINT32, Page>::const_iterator page = m_pages.find((UINT32)uAddress & MAT_PAGE_MASK);
+	if (page != m_pages.end())
+		watches.insert(watches.end(), page->second.watches.begin(), page->second.watches.end());
+}
+
+const MatWatch* MatWatchManager::GetWatch(UINT32 uId) const
+{
+	std::map<UINT32, MatWatch>::const_iterator it = m_watches.find(uId);
+	return it == m_watches.end() ? NULL : &it->second;
+}
+
+UINT32 MatWatchManager::GetPageCount() const
+{
+	UINT32 uCount = 0;
+	for (std::map<UINT32, Page>::const_iterator it = m_pages.begin(); it != m_pages.end(); ++it)
+	{
+		if (!it->second.watches.empty())
+			uCount++;
+	}
+	return uCount;
+}
+
+bool MatWatchManager::StartsBefore(const Range& a, const Range& b)
+{
+	return a.uStart < b.uStart;
+}
+
+const MatWatchManager::Range* MatWatchManager::FindRange(UINT32 uAddress) const
+{
+	for (size_t i = 0; i < m_ranges.size() && m_ranges[i].uStart <= uAddress; ++i)
+	{
+		if (uAddress - m_ranges[i].uStart < m_ranges[i].uSize)
+			return &m_ranges[i];
+	}
+	return NULL;
+}
+
+BYTE MatWatchManager::GetWanted(const Page& page) const
+{
+	// The strongest of the watches, and of what the page had before them.
+	BYTE uWanted = page.uReadWrite ? SNPS3_MAT_COND_READ_WRITE : page.uWrite ? SNPS3_MAT_COND_WRITE : SNPS3_MAT_COND_TRANSPARENT;
+	return uWanted > page.uOriginal ? uWanted : page.uOriginal;
+}
+
+BYTE MatWatchManager::GetWanted(UINT32 uPage) const
+{
+	std::map<UINT32, Page>::const_iterator it = m_pages.find(uPage);
+	if (it != m_pages.end())
+		return GetWanted(it->second);
+
+	const Range* pRange = FindRange(uPage);
+	return pRange->original[(uPage - pRange->uStart) / MAT_PAGE_SIZE];
+}
@@ -0,0 +1,92 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef MAT_WATCH_H
+#define MAT_WATCH_H
+
+#include "TmapiTrace.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#define MAT_PAGE_SIZE			(0x1000)
+#define MAT_DSISR_STORE			(0x02000000)	// Set in the DSISR of a MAT exception for a store
+
+struct MatWatch
+{
+	UINT32			uAddress;
+	UINT32			uSize;
+	BYTE			uCondition;			// SNPS3_MAT_COND_WRITE or SNPS3_MAT_COND_READ_WRITE
+	std::string		strOwner;			// Who asked for it, to report its hits to
+};
+
+// Keeps the memory access traps of a process for any number of byte range
+// watches. MAT works on whole 4KB pages, so each page is trapped for the
+// strongest condition of the watches on it, and goes back to the condition
+// it had before once none are left. Apply() sends only the pages that have
+// changed since the last one, merged into as few ranges as it pays to.
+class MatWatchManager
+{
+public:
+						MatWatchManager(HTARGET hTarget, UINT32 uProcessId);
+
+	// Reads the ranges traps can be set in, and the conditions they have.
+	SNRESULT			Init();
+
+	// Returns the id of the new watch, or 0 if it is not within the ranges.
+	UINT32				Add(UINT32 uAddress, UINT32 uSize, BYTE uCondition, const std::string& strOwner);
+	bool				Remove(UINT32 uId);
+	void				RemoveAll();
+	SNRESULT			Apply();
+
+	// The watches a MAT exception at uAddress is for; loads only hit read/write
+	// watches. A trapped page can be hit outside any of its watches.
+	void				FindHits(UINT64 uAddress, bool bStore, std::vector<UINT32>& hits) const;
+	void				GetPageWatches(UINT64 uAddress, std::vector<UINT32>& watches) const;
+
+	const MatWatch*		GetWatch(UINT32 uId) const;
+	UINT32				GetWatchCount() const { return (UINT32)m_watches.size(); }
+	UINT32				GetPageCount() const;
+	UINT32				GetRangeCount() const { return (UINT32)m_ranges.size(); }
+	// Sent by the last Apply()
+	UINT32				GetAppliedRanges() const { return m_uAppliedRanges; }
+	UINT32				GetAppliedPages() const { return m_uAppliedPages; }
+
+private:
+	struct Range
+	{
+		UINT32				uStart;
+		UINT32				uSize;
+		std::vector<BYTE>	original;		// Condition of each page before any watch
+	};
+
+	struct Page
+	{
+		UINT32				uWrite;			// Watches on the page by condition
+		UINT32				uReadWrite;
+		BYTE				uApplied;		// As last sent to the target
+		BYTE				uOriginal;
+		std::vector<UINT32>	watches;
+	};
+
+	static bool			StartsBefore(const Range& a, const Range& b);
+	const Range*		FindRange(UINT32 uAddress) const;
+	BYTE				GetWanted(const Page& page) const;
+	BYTE				GetWanted(UINT32 uPage) const;
+
+	HTARGET							m_hTarget;
+	UINT32							m_uProcessId;
+	std::vector<Range>				m_ranges;		// By start address
+	std::map<UINT32, MatWatch>		m_watches;
+	std::map<UINT32, Page>			m_pages;		// By address, only those with watches or not yet restored
+	std::set<UINT32>				m_dirty;		// Pages changed since the last Apply()
+	UINT32							m_uNextId;
+	UINT32							m_uAppliedRanges;
+	UINT32							m_uAppliedPages;
+};
+
+#endif
@@ -0,0 +1,398 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "PadRecording.h"
+#include <string.h>
+
+namespace
+{
+	void PutVarint(std::vector<BYTE>& out, UINT64 uValue)
+	{
+		while (uValue >= 0x80)
+		{
+			out.push_back((BYTE)(uValue | 0x80));
+			uValue >>= 7;
+		}
+		out.push_back((BYTE)uValue);
+	}
+
+	bool GetVarint(const BYTE*& pCur, const BYTE* pEnd, UINT64& uValue)
+	{
+		uValue = 0;
+		for (UINT32 uShift = 0; uShift < 64; uShift += 7)
+		{
+			if (pCur == pEnd)
+				return false;
+
+			BYTE b = *pCur++;
+			uValue |= (UINT64)(b & 0x7f) << uShift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	UINT64 ZigZag(INT64 nValue)
+	{
+		return ((UINT64)nValue << 1) ^ (UINT64)(nValue >> 63);
+	}
+
+	INT64 UnZigZag(UINT64 uValue)
+	{
+		return (INT64)(uValue >> 1) ^ -(INT64)(uValue & 1);
+	}
+}
+
+void PadDeltaCodec::Reset()
+{
+	memset(m_prev, 0, sizeof(m_prev));
+	memset(m_prevDelta, 0, sizeof(m_prevDelta));
+	for (UINT32 i = 0; i < PAD_MAX_PORTS; ++i)
+		m_prev[i].ucPort = (UCHAR)i;
+	m_lastPort = 0;
+}
+
+void PadDeltaCodec::Encode(const SNPS3PadData& data, std::vector<BYTE>& out)
+{
+	SNPS3PadData& prev = m_prev[data.ucPort];
+	INT64& prevDelta = m_prevDelta[data.ucPort];
+	BYTE tag = 0;
+
+	if (data.ucPort != m_lastPort)
+		tag |= PAD_TAG_PORT;
+
+	if (data.ucPortStatus != prev.ucPortStatus || data.ucLength != prev.ucLength)
+		tag |= PAD_TAG_STATUS;
+
+	if (data.ulReserved0 != prev.ulReserved0 || data.ulReserved1 != prev.ulReserved1 ||
+		data.ucReserved2 != prev.ucReserved2 || data.ulReserved3 != prev.ulReserved3)
+		tag |= PAD_TAG_RESERVED;
+
+	UINT32 uChanged = 0;
+	for (UINT32 i = 0; i < PAD_BUTTON_COUNT; ++i)
+	{
+		if (data.arrButtons[i] != prev.arrButtons[i])
+			uChanged |= 1 << i;
+	}
+	if (uChanged)
+		tag |= PAD_TAG_BUTTONS;
+
+	out.push_back(tag);
+
+	if (tag & PAD_TAG_PORT)
+		out.push_back(data.ucPort);
+
+	INT64 nDelta = (INT64)(PadTimestamp(data) - PadTimestamp(prev));
+	PutVarint(out, ZigZag(nDelta - prevDelta));
+	prevDelta = nDelta;
+
+	if (tag & PAD_TAG_STATUS)
+	{
+		out.push_back(data.ucPortStatus);
+		out.push_back(data.ucLength);
+	}
+
+	if (tag & PAD_TAG_RESERVED)
+	{
+		PutVarint(out, data.ulReserved0);
+		PutVarint(out, data.ulReserved1);
+		PutVarint(out, data.ucReserved2);
+		PutVarint(out, data.ulReserved3);
+	}
+
+	if (tag & PAD_TAG_BUTTONS)
+	{
+		PutVarint(out, uChanged);
+		for (UINT32 i = 0; i < PAD_BUTTON_COUNT; ++i)
+		{
+			if (uChanged & (1 << i))
+				PutVarint(out, ZigZag((INT16)(data.arrButtons[i] - prev.arrButtons[i])));
+		}
+	}
+
+	prev = data;
+	m_lastPort = data.ucPort;
+}
+
+bool PadDeltaCodec::Decode(const BYTE*& pCur, const BYTE* pEnd, SNPS3PadData& data)
+{
+	if (pCur == pEnd)
+		return false;
+
+	BYTE tag = *pCur++;
+	if (tag & ~PAD_TAG_MASK)
+		return false;
+
+	UCHAR port = m_lastPort;
+	if (tag & PAD_TAG_PORT)
+	{
+		if (pCur == pEnd)
+			return false;
+		port = *pCur++;
+	}
+
+	SNPS3PadData& prev = m_prev[port];
+	INT64& prevDelta = m_prevDelta[port];
+	data = prev;
+
+	UINT64 uValue;
+	if (!GetVarint(pCur, pEnd, uValue))
+		return false;
+
+	prevDelta += UnZigZag(uValue);
+	UINT64 uTimestamp = PadTimestamp(prev) + (UINT64)prevDelta;
+	data.ulTimeHi = (UINT32)(uTimestamp >> 32);
+	data.ulTimeLo = (UINT32)uTimestamp;
+
+	if (tag & PAD_TAG_STATUS)
+	{
+		if (pEnd - pCur < 2)
+			return false;
+		data.ucPortStatus = *pCur++;
+		data.ucLength = *pCur++;
+	}
+
+	if (tag & PAD_TAG_RESERVED)
+	{
+		UINT64 uReserved[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			if (!GetVarint(pCur, pEnd, uReserved[i]))
+				return false;
+		}
+		data.ulReserved0 = (UINT32)uReserved[0];
+		data.ulReserved1 = (UINT32)uReserved[1];
+		data.ucReserved2 = (UCHAR)uReserved[2];
+		data.ulReserved3 = (UINT32)uReserved[3];
+	}
+
+	if (tag & PAD_TAG_BUTTONS)
+	{
+		UINT64 uChanged;
+		if (!GetVarint(pCur, pEnd, uChanged) || uChanged >> PAD_BUTTON_COUNT)
+			return false;
+
+		for (UINT32 i = 0; i < PAD_BUTTON_COUNT; ++i)
+		{
+			if (uChanged & (1 << i))
+			{
+				if (!GetVarint(pCur, pEnd, uValue))
+					return false;
+				data.arrButtons[i] = (UINT16)(prev.arrButtons[i] + UnZigZag(uValue));
+			}
+		}
+	}
+
+	prev = data;
+	m_lastPort = port;
+	return true;
+}
+
+PadRecordWriter::PadRecordWriter()
+: m_pFile(NULL)
+, m_uBlockRecords(0)
+, m_uBytesWritten(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+PadRecordWriter::~PadRecordWriter()
+{
+	Close();
+}
+
+bool PadRecordWriter::Open(const WCHAR* pszPath, UINT64 uTimebaseFrequency)
+{
+	Close();
+
+	m_pFile = _wfopen(pszPath, L"wb");
+	if (!m_pFile)
+		return false;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.uMagic = PAD_RECORDING_MAGIC;
+	m_header.uVersion = PAD_RECORDING_VERSION;
+	m_header.uTimebaseFrequency = uTimebaseFrequency;
+
+	m_codec.Reset();
+	m_block.clear();
+	m_block.reserve(PAD_BLOCK_SIZE + 256);
+	m_uBlockRecords = 0;
+
+	if (fwrite(&m_header, sizeof(m_header), 1, m_pFile) != 1)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+		return false;
+	}
+
+	m_uBytesWritten = sizeof(m_header);
+	return true;
+}
+
+bool PadRecordWriter::Write(const SNPS3PadData* pRecords, UINT32 uCount)
+{
+	if (!m_pFile)
+		return false;
+
+	for (UINT32 i = 0; i < uCount; ++i)
+	{
+		if (m_header.uRecordCount == 0)
+			m_header.uFirstTimestamp = PadTimestamp(pRecords[i]);
+		m_header.uLastTimestamp = PadTimestamp(pRecords[i]);
+		++m_header.uRecordCount;
+
+		m_codec.Encode(pRecords[i], m_block);
+		++m_uBlockRecords;
+
+		if (m_block.size() >= PAD_BLOCK_SIZE && !Flush())
+			return false;
+	}
+
+	return true;
+}
+
+bool PadRecordWriter::Flush()
+{
+	if (!m_pFile)
+		return false;
+
+	if (m_uBlockRecords == 0)
+		return true;
+
+	PadBlockHeader block;
+	block.uSize = (UINT32)m_block.size();
+	block.uRecordCount = m_uBlockRecords;
+
+	if (fwrite(&block, sizeof(block), 1, m_pFile) != 1 ||
+		fwrite(&m_block[0], m_block.size(), 1, m_pFile) != 1 ||
+		fflush(m_pFile) != 0)
+		return false;
+
+	m_uBytesWritten += sizeof(block) + m_block.size();
+	m_block.clear();
+	m_uBlockRecords = 0;
+	m_codec.Reset();
+	return true;
+}
+
+bool PadRecordWriter::Close()
+{
+	if (!m_pFile)
+		return true;
+
+	bool bOK = Flush();
+
+	// Only a closed recording gets its totals filled in.
+	if (bOK)
+		bOK = fseek(m_pFile, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, m_pFile) == 1;
+
+	if (fclose(m_pFile) != 0)
+		bOK = false;
+
+	m_pFile = NULL;
+	return bOK;
+}
+
+PadRecordReader::PadRecordReader()
+: m_pFile(NULL)
+, m_bCorrupt(false)
+, m_uFileSize(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+PadRecordReader::~PadRecordReader()
+{
+	Close();
+}
+
+bool PadRecordReader::Open(const WCHAR* pszPath)
+{
+	Close();
+
+	m_pFile = _wfopen(pszPath, L"rb");
+	if (!m_pFile)
+		return false;
+
+	if (fread(&m_header, sizeof(m_header), 1, m_pFile) != 1 ||
+		m_header.uMagic != PAD_RECORDING_MAGIC ||
+		m_header.uVersion != PAD_RECORDING_VERSION ||
+		m_header.uTimebaseFrequency == 0)
+	{
+		Close();
+		return false;
+	}
+
+	if (_fseeki64(m_pFile, 0, SEEK_END) == 0)
+		m_uFileSize = (UINT64)_ftelli64(m_pFile);
+	_fseeki64(m_pFile, sizeof(m_header), SEEK_SET);
+
+	m_bCorrupt = false;
+	return true;
+}
+
+void PadRecordReader::Close()
+{
+	if (m_pFile)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+	}
+}
+
+bool PadRecordReader::ReadBlock(std::vector<SNPS3PadData>& records)
+{
+	records.clear();
+
+	if (!m_pFile || m_bCorrupt)
+		return false;
+
+	PadBlockHeader block;
+	size_t nRead = fread(&block, 1, sizeof(block), m_pFile);
+	if (nRead == 0)
+		return false;
+
+	// No more records can be decoded than the block has room for, so the
+	// count is bounded before it sizes anything.
+	if (nRead != sizeof(block) || block.uSize == 0 || block.uSize > PAD_MAX_BLOCK_SIZE || block.uRecordCount == 0 ||
+		block.uRecordCount > block.uSize / PAD_MIN_RECORD_SIZE)
+	{
+		m_bCorrupt = true;
+		return false;
+	}
+
+	m_block.resize(block.uSize);
+	if (fread(&m_block[0], block.uSize, 1, m_pFile) != 1)
+	{
+		m_bCorrupt = true;
+		return false;
+	}
+
+	PadDeltaCodec codec;
+	const BYTE* pCur = &m_block[0];
+	const BYTE* pEnd = pCur + m_block.size();
+
+	records.resize(block.uRecordCount);
+	for (UINT32 i = 0; i < block.uRecordCount; ++i)
+	{
+		if (!codec.Decode(pCur, pEnd, records[i]))
+		{
+			records.clear();
+			m_bCorrupt = true;
+			return false;
+		}
+	}
+
+	if (pCur != pEnd)
+	{
+		records.clear();
+		m_bCorrupt = true;
+		return false;
+	}
+
+	return true;
+}
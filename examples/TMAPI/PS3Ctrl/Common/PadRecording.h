@@ -0,0 +1,137 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef PAD_RECORDING_H
+#define PAD_RECORDING_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <vector>
+#include "TmapiTrace.h"
+
+// Pad recording file:
+//
+//   PadRecordingHeader
+//   PadBlockHeader, encoded records
+//   PadBlockHeader, encoded records
+//   ...
+//
+// Each block starts from a zeroed codec state, so blocks decode on their own
+// and a recording cut short by a crash is readable up to its last complete
+// block. Records are delta-encoded against the previous record from the same
+// port, so interleaved pads do not disturb each other:
+//
+//   tag byte (PAD_TAG_*)
+//   [port]											if PAD_TAG_PORT (differs from the last record)
+//   timestamp delta-of-delta, zigzag varint
+//   [port status, length]							if PAD_TAG_STATUS
+//   [reserved0, reserved1, reserved2, reserved3 varints]	if PAD_TAG_RESERVED
+//   [changed mask varint, zigzag varint delta per set bit]	if PAD_TAG_BUTTONS
+//
+// A pad sampled at a steady rate with nothing pressed encodes to 2 bytes,
+// the least any record takes.
+
+#define PAD_RECORDING_MAGIC		(0x52444150)	// 'PADR'
+#define PAD_RECORDING_VERSION	(1)
+#define PAD_BUTTON_COUNT		(24)
+#define PAD_BLOCK_SIZE			(64 * 1024)
+#define PAD_MAX_BLOCK_SIZE		(16 * 1024 * 1024)
+#define PAD_MIN_RECORD_SIZE		(2)				// Tag byte and timestamp varint
+
+#define PAD_MAX_PORTS			(256)
+
+#define PAD_TAG_PORT			(0x01)
+#define PAD_TAG_STATUS			(0x02)
+#define PAD_TAG_RESERVED		(0x04)
+#define PAD_TAG_BUTTONS			(0x08)
+#define PAD_TAG_MASK			(0x0f)
+
+struct PadRecordingHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT64	uTimebaseFrequency;
+	UINT64	uRecordCount;		// 0 if the recording was not closed
+	UINT64	uFirstTimestamp;
+	UINT64	uLastTimestamp;
+	UINT64	uReserved;
+};
+
+struct PadBlockHeader
+{
+	UINT32	uSize;				// Encoded bytes following the header
+	UINT32	uRecordCount;
+};
+
+inline UINT64 PadTimestamp(const SNPS3PadData& data)
+{
+	return ((UINT64)data.ulTimeHi << 32) | data.ulTimeLo;
+}
+
+class PadDeltaCodec
+{
+public:
+					PadDeltaCodec() { Reset(); }
+
+	void			Reset();
+	void			Encode(const SNPS3PadData& data, std::vector<BYTE>& out);
+	bool			Decode(const BYTE*& pCur, const BYTE* pEnd, SNPS3PadData& data);
+
+private:
+	UCHAR			m_lastPort;
+	SNPS3PadData	m_prev[PAD_MAX_PORTS];
+	INT64			m_prevDelta[PAD_MAX_PORTS];
+};
+
+class PadRecordWriter
+{
+public:
+					PadRecordWriter();
+					~PadRecordWriter();
+
+	bool			Open(const WCHAR* pszPath, UINT64 uTimebaseFrequency);
+	bool			Write(const SNPS3PadData* pRecords, UINT32 uCount);
+	// Writes out the current block, so little is lost if the host goes down.
+	bool			Flush();
+	bool			Close();
+
+	UINT64			GetRecordCount() const { return m_header.uRecordCount; }
+	UINT64			GetBytesWritten() const { return m_uBytesWritten; }
+
+private:
+	FILE*				m_pFile;
+	PadRecordingHeader	m_header;
+	PadDeltaCodec		m_codec;
+	std::vector<BYTE>	m_block;
+	UINT32				m_uBlockRecords;
+	UINT64				m_uBytesWritten;
+};
+
+class PadRecordReader
+{
+public:
+					PadRecordReader();
+					~PadRecordReader();
+
+	bool			Open(const WCHAR* pszPath);
+	void			Close();
+	const PadRecordingHeader& GetHeader() const { return m_header; }
+
+	// Decodes the next block. Returns false at the end of the recording;
+	// IsCorrupt() then says whether it ended on a damaged block.
+	bool			ReadBlock(std::vector<SNPS3PadData>& records);
+	bool			IsCorrupt() const { return m_bCorrupt; }
+	UINT64			GetFileSize() const { return m_uFileSize; }
+
+private:
+	FILE*				m_pFile;
+	PadRecordingHeader	m_header;
+	std::vector<BYTE>	m_block;
+	bool				m_bCorrupt;
+	UINT64				m_uFileSize;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "ProcessStop.h"
+
+// Enough for the information of a thread or SPU thread group, their name
+// and the ids of the threads of a group.
+#define PROCESS_STOP_INFO_BYTES		(512)
+
+ProcessStop::ProcessStop(HTARGET hTarget, UINT32 uProcessId)
+: m_hTarget(hTarget)
+, m_uProcessId(uProcessId)
+, m_bAllRunning(false)
+, m_bStopped(false)
+{
+}
+
+SNRESULT ProcessStop::Stop()
+{
+	m_bStopped = false;
+
+	SNRESULT snr = GetRunning(m_bAllRunning);
+	if (SN_FAILED(snr))
+		return snr;
+
+	// Already stopped, by the user or at breakpoints.
+	if (m_threads.empty() && m_groups.empty())
+		return SN_S_OK;
+
+	// A thread that stops at a breakpoint between the two is continued with
+	// the rest; its hit is still reported.
+	snr = SNPS3ProcessStop(m_hTarget, m_uProcessId);
+	if (SN_SUCCEEDED(snr))
+		m_bStopped = true;
+
+	return snr;
+}
+
+SNRESULT ProcessStop::Continue()
+{
+	if (!m_bStopped)
+		return SN_S_OK;
+
+	m_bStopped = false;
+
+	if (m_bAllRunning)
+		return SNPS3ProcessContinue(m_hTarget, m_uProcessId);
+
+	SNRESULT snrResult = SN_S_OK;
+	for (size_t i = 0; i < m_threads.size(); ++i)
+	{
+		SNRESULT snr = SNPS3ThreadContinue(m_hTarget, PS3_UI_CPU, m_uProcessId, m_threads[i]);
+		if (SN_FAILED(snr) && SN_SUCCEEDED(snrResult))
+			snrResult = snr;
+	}
+
+	for (size_t i = 0; i < m_groups.size(); ++i)
+	{
+		SNRESULT snr = SNPS3SPUThreadGroupContinue(m_hTarget, m_uProcessId, m_groups[i]);
+		if (SN_FAILED(snr) && SN_SUCCEEDED(snrResult))
+			snrResult = snr;
+	}
+
+	return snrResult;
+}
+
+SNRESULT ProcessStop::GetRunning(bool& bAllRunning)
+{
+	m_threads.clear();
+	m_groups.clear();
+	bAllRunning = true;
+
+	// Threads can start between asking how many there are and listing them.
+	std::vector<UINT64> threads;
+	std::vector<UINT64> groups;
+	SNRESULT snr;
+	do
+	{
+		UINT32 uThreads = 0;
+		UINT32 uGroups = 0;
+		snr = SNPS3ThreadList(m_hTarget, m_uProcessId, &uThreads, NULL, &uGroups, NULL);
+		if (SN_FAILED(snr))
+			return snr;
+
+		threads.resize(uThreads + 1);
+		groups.resize(uGroups + 1);
+		uThreads = (UINT32)threads.size();
+		uGroups = (UINT32)groups.size();
+		snr = SNPS3ThreadList(m_hTarget, m_uProcessId, &uThreads, &threads[0], &uGroups, &groups[0]);
+		threads.resize(uThreads);
+		groups.resize(uGroups);
+	}
+	while (snr == SN_E_OUT_OF_MEM);
+
+	if (SN_FAILED(snr))
+		return snr;
+
+	// Stopped by a debugger shows as suspended; a thread whose state cannot
+	// be read is taken as running, as SNPS3ProcessContinue() would take it.
+	BYTE info[PROCESS_STOP_INFO_BYTES];
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		UINT32 uSize = sizeof(info);
+		UINT32 uState = SNPS3_PPU_RUNNABLE;
+		if (SN_SUCCEEDED(SNPS3ThreadInfo(m_hTarget, PS3_UI_CPU, m_uProcessId, threads[i], &uSize, info)))
+			uState = ((SNPS3_PPU_THREAD_INFO*)info)->uState;
+
+		switch (uState)
+		{
+		case SNPS3_PPU_SUSPENDED:
+		case SNPS3_PPU_SLEEP_SUSPENDED:
+		case SNPS3_PPU_STOP:
+			bAllRunning = false;
+			break;
+		case SNPS3_PPU_ZOMBIE:
+		case SNPS3_PPU_DELETED:
+			break;
+		default:
+			m_threads.push_back(threads[i]);
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		UINT32 uSize = sizeof(info);
+		UINT32 uState = SNPS3_SPU_RUNNING;
+		if (SN_SUCCEEDED(SNPS3GetSPUThreadGroupInfo(m_hTarget, m_uProcessId, groups[i], &uSize, info)))
+			uState = ((SNPS3_SPU_THREADGROUP_INFO*)info)->uState;
+
+		switch (uState)
+		{
+		case SNPS3_SPU_READY:
+		case SNPS3_SPU_WAITING:
+		case SNPS3_SPU_RUNNING:
+			m_groups.push_back(groups[i]);
+			break;
+		case SNPS3_SPU_SUSPENDED:
+		case SNPS3_SPU_WAITINGSUSPENDED:
+			bAllRunning = false;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return SN_S_OK;
+}
@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef PROCESS_STOP_H
+#define PROCESS_STOP_H
+
+#include "TmapiTrace.h"
+#include <vector>
+
+// Stops a process for a change that needs all of it stopped, such as its
+// breakpoints or DABR, and afterwards continues only what it stopped.
+// SNPS3ProcessContinue() would also continue threads stopped at a
+// breakpoint, or a process the user had stopped.
+//
+// Stop() notes the PPU threads and SPU thread groups that are running
+// before stopping the process; if none are, the process is left as it is.
+// Continue() continues those it noted, with one SNPS3ProcessContinue() when
+// that was all of them.
+class ProcessStop
+{
+public:
+						ProcessStop(HTARGET hTarget, UINT32 uProcessId);
+
+	SNRESULT			Stop();
+	SNRESULT			Continue();
+
+	// Whether Stop() stopped the process, rather than finding it stopped.
+	bool				HasStopped() const { return m_bStopped; }
+
+private:
+	SNRESULT			GetRunning(bool& bAllRunning);
+
+	HTARGET				m_hTarget;
+	UINT32				m_uProcessId;
+	std::vector<UINT64>	m_threads;			// PPU threads that were running
+	std::vector<UINT64>	m_groups;			// SPU thread groups that were running
+	bool				m_bAllRunning;
+	bool				m_bStopped;
+};
+
+#endif
@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "RecordFile.h"
+#include <stdarg.h>
+#include <string.h>
+
+RecordFileReader::RecordFileReader()
+: m_pFile(NULL)
+{
+}
+
+RecordFileReader::~RecordFileReader()
+{
+	if (m_pFile)
+		fclose(m_pFile);
+}
+
+bool RecordFileReader::Open(const WCHAR* pszPath)
+{
+	_ASSERT(!m_pFile);
+
+	if (::GetFileAttributesW(pszPath) == INVALID_FILE_ATTRIBUTES)
+		return true;
+
+	return _wfopen_s(&m_pFile, pszPath, L"r") == 0 && m_pFile;
+}
+
+UINT32 RecordFileReader::Next(char** apFields, UINT32 uMaxFields)
+{
+	if (!m_pFile)
+		return 0;
+
+	while (fgets(m_szLine, sizeof(m_szLine), m_pFile))
+	{
+		if (m_szLine[0] == '#')
+			continue;
+
+		m_szLine[strcspn(m_szLine, "\r\n")] = '\0';
+
+		UINT32 uFields = 0;
+		char* pField = m_szLine;
+		while (uFields < uMaxFields)
+		{
+			apFields[uFields++] = pField;
+			char* pTab = strchr(pField, '\t');
+			if (!pTab || uFields == uMaxFields)
+				break;
+			*pTab = '\0';
+			pField = pTab + 1;
+		}
+
+		return uFields;
+	}
+
+	return 0;
+}
+
+RecordFileWriter::RecordFileWriter()
+: m_pFile(NULL)
+, m_bOK(false)
+{
+}
+
+RecordFileWriter::~RecordFileWriter()
+{
+	Discard();
+}
+
+bool RecordFileWriter::Open(const WCHAR* pszPath, const char* pszHeader)
+{
+	_ASSERT(!m_pFile);
+
+	m_strPath = pszPath;
+	m_strTemp = m_strPath + L".tmp";
+	if (_wfopen_s(&m_pFile, m_strTemp.c_str(), L"w") != 0 || !m_pFile)
+	{
+		m_pFile = NULL;
+		return false;
+	}
+
+	m_bOK = true;
+	Print("%s\n", pszHeader);
+	return m_bOK;
+}
+
+void RecordFileWriter::Print(const char* pszFormat, ...)
+{
+	if (!m_pFile || !m_bOK)
+		return;
+
+	va_list args;
+	va_start(args, pszFormat);
+	if (vfprintf(m_pFile, pszFormat, args) < 0)
+		m_bOK = false;
+	va_end(args);
+}
+
+bool RecordFileWriter::Commit()
+{
+	if (!m_pFile)
+		return false;
+
+	FILE* pFile = m_pFile;
+	m_pFile = NULL;
+	if (fclose(pFile) != 0)
+		m_bOK = false;
+
+	if (!m_bOK || !::MoveFileExW(m_strTemp.c_str(), m_strPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		_wremove(m_strTemp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void RecordFileWriter::Discard()
+{
+	if (!m_pFile)
+		return;
+
+	fclose(m_pFile);
+	m_pFile = NULL;
+	_wremove(m_strTemp.c_str());
+}
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef RECORD_FILE_H
+#define RECORD_FILE_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+
+#define RECORD_FILE_MAX_LINE		(4096)
+
+// The text files the ledgers, profiles and journals are kept in: a # header
+// line naming the format, then one record a line, its fields separated by
+// tabs. Lines starting # are comments.
+
+class RecordFileReader
+{
+public:
+					RecordFileReader();
+					~RecordFileReader();
+
+	// A file that does not exist opens as one with no records.
+	bool			Open(const WCHAR* pszPath);
+	// Splits the next record into up to uMaxFields fields, the last taking
+	// the rest of the line, and returns how many; 0 at the end of the file.
+	UINT32			Next(char** apFields, UINT32 uMaxFields);
+
+private:
+	FILE*			m_pFile;
+	char			m_szLine[RECORD_FILE_MAX_LINE];
+};
+
+// Writes the file aside and renames it over the old one, so an interrupted
+// save leaves the previous one intact. It is discarded unless committed.
+class RecordFileWriter
+{
+public:
+					RecordFileWriter();
+					~RecordFileWriter();
+
+	bool			Open(const WCHAR* pszPath, const char* pszHeader);
+	// Appends to the current record; a failure is reported by Commit().
+	void			Print(const char* pszFormat, ...);
+	bool			Commit();
+
+private:
+	void			Discard();
+
+	std::wstring	m_strPath;
+	std::wstring	m_strTemp;
+	FILE*			m_pFile;
+	bool			m_bOK;
+};
+
+#endif
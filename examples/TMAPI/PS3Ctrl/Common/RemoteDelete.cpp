@@ -0,0 +1,246 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "RemoteDelete.h"
+#include <limits.h>
+
+RemoteDeleter::RemoteDeleter(RemoteTreeCache& cache, int nTimeoutMs)
+: m_cache(cache)
+, m_nTimeoutMs(nTimeoutMs)
+, m_uThreads(0)
+, m_hReady(NULL)
+, m_uLeft(0)
+, m_lInFlight(0)
+, m_bCancel(false)
+, m_uFrequency(1)
+, m_uStart(0)
+, m_uElapsedMs(0)
+{
+	::InitializeCriticalSection(&m_lock);
+
+	LARGE_INTEGER frequency;
+	if (::QueryPerformanceFrequency(&frequency) && frequency.QuadPart)
+		m_uFrequency = frequency.QuadPart;
+}
+
+RemoteDeleter::~RemoteDeleter()
+{
+	Cancel();
+	Wait(INFINITE);
+	::DeleteCriticalSection(&m_lock);
+}
+
+void RemoteDeleter::Add(const std::string& strPath)
+{
+	RemoteDeleteItem item;
+	item.strPath = RemoteTreeCache::Normalize(strPath);
+	item.snr = SN_S_OK;
+	item.uElapsedMs = 0;
+	item.bSkipped = false;
+	item.bRequested = true;
+	item.nParent = -1;
+	item.uChildrenLeft = 0;
+
+	// A path that cannot be stat'd is still deleted, for the error.
+	RemoteFileInfo info;
+	item.bDirectory = SN_SUCCEEDED(m_cache.Stat(item.strPath, info)) && info.uType == SNPS3_DIRENT_TYPE_DIRECTORY;
+
+	m_items.push_back(item);
+}
+
+void RemoteDeleter::Split(UINT32 uMaxInFlight)
+{
+	size_t uWanted = (size_t)uMaxInFlight * REMOTE_DELETE_SPLIT_FACTOR;
+	size_t uLevel = 0;
+
+	for (UINT32 uDepth = 0; uDepth < REMOTE_DELETE_SPLIT_DEPTH; ++uDepth)
+	{
+		size_t uLeaves = 0;
+		for (size_t i = 0; i < m_items.size(); ++i)
+		{
+			if (m_items[i].uChildrenLeft == 0)
+				uLeaves++;
+		}
+
+		if (uLeaves >= uWanted)
+			break;
+
+		size_t uEnd = m_items.size();
+		for (size_t i = uLevel; i < uEnd; ++i)
+		{
+			if (!m_items[i].bDirectory)
+				continue;
+
+			RemoteListing listing;
+			if (SN_FAILED(m_cache.List(m_items[i].strPath, listing)))
+				continue;
+
+			// Files are left to the delete of their directory; one call each
+			// would cost more than it saved.
+			for (size_t j = 0; j < listing.size(); ++j)
+			{
+				if (listing[j].second.uType != SNPS3_DIRENT_TYPE_DIRECTORY)
+					continue;
+
+				RemoteDeleteItem child;
+				child.strPath = RemoteTreeCache::Join(m_items[i].strPath, listing[j].first);
+				child.bDirectory = true;
+				child.snr = SN_S_OK;
+				child.uElapsedMs = 0;
+				child.bSkipped = false;
+				child.bRequested = false;
+				child.nParent = (int)i;
+				child.uChildrenLeft = 0;
+
+				m_items.push_back(child);
+				m_items[i].uChildrenLeft++;
+			}
+		}
+
+		uLevel = uEnd;
+	}
+}
+
+bool RemoteDeleter::Start(UINT32 uMaxInFlight)
+{
+	_ASSERT(m_workers.IsEmpty());
+
+	m_bCancel = false;
+	m_lInFlight = 0;
+	m_uElapsedMs = 0;
+	m_uLeft = m_items.size();
+
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	m_uStart = now.QuadPart;
+
+	if (m_items.empty())
+		return true;
+
+	m_ready.clear();
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		if (m_items[i].uChildrenLeft == 0)
+			m_ready.push_back(i);
+	}
+
+	m_uThreads = uMaxInFlight ? uMaxInFlight : REMOTE_TREE_DEFAULT_MAX;
+
+	m_hReady = ::CreateSemaphore(NULL, (LONG)m_ready.size(), LONG_MAX, NULL);
+	if (!m_hReady)
+		return false;
+
+	if (!m_workers.Start<RemoteDeleter, &RemoteDeleter::WorkerThread>(m_uThreads, this))
+	{
+		Cleanup();
+		return false;
+	}
+
+	return true;
+}
+
+bool RemoteDeleter::Wait(DWORD dwMilliseconds)
+{
+	if (m_workers.IsEmpty())
+		return true;
+
+	if (!m_workers.Wait(dwMilliseconds))
+		return false;
+
+	m_uElapsedMs = GetMilliseconds();
+	Cleanup();
+	return true;
+}
+
+void RemoteDeleter::Cancel()
+{
+	m_bCancel = true;
+}
+
+UINT32 RemoteDeleter::GetFailedCount() const
+{
+	UINT32 uCount = 0;
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		if (SN_FAILED(m_items[i].snr))
+			uCount++;
+	}
+	return uCount;
+}
+
+void RemoteDeleter::WorkerThread()
+{
+	for (;;)
+	{
+		::WaitForSingleObject(m_hReady, INFINITE);
+
+		// Nothing ready means everything has finished.
+		::EnterCriticalSection(&m_lock);
+		if (m_ready.empty())
+		{
+			::LeaveCriticalSection(&m_lock);
+			break;
+		}
+		size_t uItem = m_ready.front();
+		m_ready.pop_front();
+		::LeaveCriticalSection(&m_lock);
+
+		RemoteDeleteItem& item = m_items[uItem];
+		if (m_bCancel)
+		{
+			item.bSkipped = true;
+		}
+		else
+		{
+			::InterlockedIncrement(&m_lInFlight);
+			UINT64 uStartMs = GetMilliseconds();
+
+			item.snr = SNPS3DeleteEx(m_cache.GetTarget(), item.strPath.c_str(), m_nTimeoutMs);
+
+			item.uElapsedMs = GetMilliseconds() - uStartMs;
+			::InterlockedDecrement(&m_lInFlight);
+
+			// Even a failed delete may have removed some of the tree.
+			m_cache.Invalidate(item.strPath);
+		}
+
+		::EnterCriticalSection(&m_lock);
+		Finished(uItem);
+		::LeaveCriticalSection(&m_lock);
+	}
+}
+
+void RemoteDeleter::Finished(size_t uItem)
+{
+	// A directory is deleted once the trees split from it are, whether or not
+	// they could be; deleting it reports whatever is left.
+	int nParent = m_items[uItem].nParent;
+	if (nParent >= 0 && --m_items[nParent].uChildrenLeft == 0)
+	{
+		m_ready.push_back(nParent);
+		::ReleaseSemaphore(m_hReady, 1, NULL);
+	}
+
+	// The last one wakes every thread to find nothing ready.
+	if (--m_uLeft == 0)
+		::ReleaseSemaphore(m_hReady, m_uThreads, NULL);
+}
+
+UINT64 RemoteDeleter::GetMilliseconds() const
+{
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return (UINT64)(now.QuadPart - m_uStart) * 1000 / m_uFrequency;
+}
+
+void RemoteDeleter::Cleanup()
+{
+	if (m_hReady)
+	{
+		::CloseHandle(m_hReady);
+		m_hReady = NULL;
+	}
+}
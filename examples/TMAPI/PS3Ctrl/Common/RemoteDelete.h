@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef REMOTE_DELETE_H
+#define REMOTE_DELETE_H
+
+#include "RemoteTree.h"
+
+#define REMOTE_DELETE_SPLIT_DEPTH		(3)		// Levels a tree is split into
+#define REMOTE_DELETE_SPLIT_FACTOR		(4)		// Deletes wanted per one in flight
+
+struct RemoteDeleteItem
+{
+	std::string		strPath;
+	bool			bDirectory;
+	SNRESULT		snr;
+	UINT64			uElapsedMs;
+
+	bool			bSkipped;			// Cancelled before it was started
+	bool			bRequested;			// Passed to Add(), rather than split from one
+	int				nParent;			// Deleted once its children are, or -1
+	UINT32			uChildrenLeft;
+};
+
+// Deletes target files and directories with up to uMaxInFlight deletes in
+// flight. SNPS3DeleteEx() removes a directory and everything under it in one
+// call, which keeps one deep tree to one delete at a time; so directories
+// are split into the directories under them, as far as needed to keep the
+// window full, and each directory is only deleted once those are gone.
+//
+// Everything deleted is invalidated in the cache.
+class RemoteDeleter
+{
+public:
+						RemoteDeleter(RemoteTreeCache& cache, int nTimeoutMs);
+						~RemoteDeleter();
+
+	void				Add(const std::string& strPath);
+	// Splits the directories added so far, listing them through the cache.
+	void				Split(UINT32 uMaxInFlight);
+
+	bool				Start(UINT32 uMaxInFlight);
+	// Returns true once every delete has finished.
+	bool				Wait(DWORD dwMilliseconds);
+	// Deletes not yet started are skipped; those in flight finish.
+	void				Cancel();
+	bool				IsCancelled() const { return m_bCancel; }
+
+	size_t				GetCount() const { return m_items.size(); }
+	const RemoteDeleteItem& GetItem(size_t uItem) const { return m_items[uItem]; }
+	UINT32				GetFailedCount() const;
+	UINT32				GetInFlight() const { return (UINT32)m_lInFlight; }
+	UINT64				GetElapsedMilliseconds() const { return m_uElapsedMs; }
+
+private:
+	void				WorkerThread();
+	void				Finished(size_t uItem);
+	UINT64				GetMilliseconds() const;
+	void				Cleanup();
+
+	RemoteTreeCache&				m_cache;
+	int								m_nTimeoutMs;
+	std::vector<RemoteDeleteItem>	m_items;
+	WorkerThreads					m_workers;
+	UINT32							m_uThreads;
+	HANDLE							m_hReady;		// Counts ready items
+	CRITICAL_SECTION				m_lock;
+	std::deque<size_t>				m_ready;
+	size_t							m_uLeft;		// Not yet finished
+	volatile LONG					m_lInFlight;
+	volatile bool					m_bCancel;
+	UINT64							m_uFrequency;
+	UINT64							m_uStart;
+	UINT64							m_uElapsedMs;
+};
+
+#endif
@@ -0,0 +1,400 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "RemoteTree.h"
+#include <limits.h>
+#include <string.h>
+
+#define REMOTE_TREE_LIST_ATTEMPTS	(4)		// Listings of a directory that keeps growing
+
+namespace
+{
+	void CopyInfo(const SNPS3DirEntryEx& entry, RemoteFileInfo& info)
+	{
+		info.uType = entry.Type;
+		info.uMode = entry.Mode;
+		info.uAccessTime = entry.AccessTimeUTC;
+		info.uModifiedTime = entry.ModifiedTimeUTC;
+		info.uCreateTime = entry.CreateTimeUTC;
+		info.uSize = entry.Size;
+	}
+
+	bool IsUnder(const std::string& strPath, const std::string& strPrefix)
+	{
+		return strPath.compare(0, strPrefix.size(), strPrefix) == 0;
+	}
+
+	// Erases the keys that start with strPrefix, which sort together.
+	template <class Map>
+	void ErasePrefix(Map& map, const std::string& strPrefix)
+	{
+		typename Map::iterator it = map.lower_bound(strPrefix);
+		while (it != map.end() && IsUnder(it->first, strPrefix))
+			map.erase(it++);
+	}
+}
+
+RemoteTreeCache::RemoteTreeCache(HTARGET hTarget)
+: m_hTarget(hTarget)
+, m_lHits(0)
+, m_lTargetCalls(0)
+{
+	::InitializeCriticalSection(&m_lock);
+}
+
+RemoteTreeCache::~RemoteTreeCache()
+{
+	::DeleteCriticalSection(&m_lock);
+}
+
+SNRESULT RemoteTreeCache::Stat(const std::string& strPath, RemoteFileInfo& info)
+{
+	std::string strKey = Normalize(strPath);
+
+	::EnterCriticalSection(&m_lock);
+	EntryMap::const_iterator it = m_entries.find(strKey);
+	bool bFound = it != m_entries.end();
+	bool bMissing = !bFound && IsKnownMissing(strKey);
+	if (bFound)
+		info = it->second;
+	::LeaveCriticalSection(&m_lock);
+
+	if (bFound || bMissing)
+	{
+		::InterlockedIncrement(&m_lHits);
+		return bFound ? SN_S_OK : SN_E_FILE_ERROR;
+	}
+
+	::InterlockedIncrement(&m_lTargetCalls);
+
+	SNPS3DirEntryEx entry;
+	SNRESULT snr = SNPS3StatTargetFileEx(m_hTarget, strKey.c_str(), &entry, NULL);
+	if (SN_FAILED(snr))
+		return snr;
+
+	CopyInfo(entry, info);
+
+	::EnterCriticalSection(&m_lock);
+	m_entries[strKey] = info;
+	::LeaveCriticalSection(&m_lock);
+
+	return snr;
+}
+
+bool RemoteTreeCache::IsKnownMissing(const std::string& strPath) const
+{
+	// The nearest listed directory above the path decides: the path cannot
+	// exist if the step down from there towards it is missing, or is not a
+	// directory.
+	std::string strChild = strPath;
+	for (;;)
+	{
+		std::string strParent = GetParent(strChild);
+		if (strParent.empty() || strParent == strChild)
+			return false;
+
+		if (m_listings.find(strParent) != m_listings.end())
+		{
+			EntryMap::const_iterator it = m_entries.find(strChild);
+			if (it == m_entries.end())
+				return true;
+			return strChild != strPath && it->second.uType != SNPS3_DIRENT_TYPE_DIRECTORY;
+		}
+
+		strChild = strParent;
+	}
+}
+
+SNRESULT RemoteTreeCache::List(const std::string& strDirectory, RemoteListing& listing)
+{
+	std::string strKey = Normalize(strDirectory);
+	listing.clear();
+
+	::EnterCriticalSection(&m_lock);
+	ListingMap::const_iterator it = m_listings.find(strKey);
+	bool bFound = it != m_listings.end();
+	if (bFound)
+	{
+		const std::vector<std::string>& names = it->second;
+		listing.reserve(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			EntryMap::const_iterator entry = m_entries.find(Join(strKey, names[i]));
+			if (entry != m_entries.end())
+				listing.push_back(std::make_pair(names[i], entry->second));
+		}
+	}
+	::LeaveCriticalSection(&m_lock);
+
+	if (bFound)
+	{
+		::InterlockedIncrement(&m_lHits);
+		return SN_S_OK;
+	}
+
+	SNRESULT snr = ListFromTarget(strKey, listing);
+	if (SN_FAILED(snr))
+		return snr;
+
+	std::vector<std::string> names;
+	names.reserve(listing.size());
+
+	::EnterCriticalSection(&m_lock);
+	for (size_t i = 0; i < listing.size(); ++i)
+	{
+		names.push_back(listing[i].first);
+		m_entries[Join(strKey, listing[i].first)] = listing[i].second;
+	}
+	m_listings[strKey].swap(names);
+	::LeaveCriticalSection(&m_lock);
+
+	return snr;
+}
+
+SNRESULT RemoteTreeCache::ListFromTarget(const std::string& strDirectory, RemoteListing& listing)
+{
+	::EnterCriticalSection(&m_lock);
+	std::map<std::string, UINT32>::const_iterator hint = m_hints.find(strDirectory);
+	UINT32 uHint = hint != m_hints.end() ? hint->second : 0;
+	::LeaveCriticalSection(&m_lock);
+
+	// Rather than ask for the count first, the listing is asked for with room
+	// for as many entries as last time, or a guess. Only a directory that has
+	// outgrown the room is listed twice, which is no worse than the probe.
+	UINT32 uCapacity = uHint ? uHint + uHint / 8 + 4 : REMOTE_TREE_DEFAULT_CAPACITY;
+	std::vector<SNPS3DirEntryEx> buffer;
+	UINT32 uCount = 0;
+	SNRESULT snr = SN_E_OUT_OF_MEM;
+
+	for (UINT32 uAttempt = 0; uAttempt < REMOTE_TREE_LIST_ATTEMPTS; ++uAttempt)
+	{
+		buffer.resize(uCapacity);
+		uCount = uCapacity;
+
+		::InterlockedIncrement(&m_lTargetCalls);
+		snr = SNPS3GetDirectoryListEx(m_hTarget, strDirectory.c_str(), &uCount, &buffer[0], NULL);
+
+		if ((snr == SN_E_OUT_OF_MEM || SN_SUCCEEDED(snr)) && uCount > uCapacity)
+		{
+			snr = SN_E_OUT_OF_MEM;
+			uCapacity = uCount + uCount / 8 + 4;
+			continue;
+		}
+		break;
+	}
+
+	if (SN_FAILED(snr))
+		return snr;
+
+	::EnterCriticalSection(&m_lock);
+	m_hints[strDirectory] = uCount;
+	::LeaveCriticalSection(&m_lock);
+
+	listing.reserve(uCount);
+	for (UINT32 i = 0; i < uCount; ++i)
+	{
+		const SNPS3DirEntryEx& entry = buffer[i];
+		if (strcmp(entry.Name, ".") == 0 || strcmp(entry.Name, "..") == 0)
+			continue;
+
+		RemoteFileInfo info;
+		CopyInfo(entry, info);
+		listing.push_back(std::make_pair(std::string(entry.Name), info));
+	}
+
+	return snr;
+}
+
+void RemoteTreeCache::Invalidate(const std::string& strPath)
+{
+	std::string strKey = Normalize(strPath);
+	std::string strPrefix = strKey == "/" ? strKey : strKey + "/";
+
+	::EnterCriticalSection(&m_lock);
+	m_entries.erase(strKey);
+	m_listings.erase(strKey);
+	ErasePrefix(m_entries, strPrefix);
+	ErasePrefix(m_listings, strPrefix);
+	m_listings.erase(GetParent(strKey));
+	::LeaveCriticalSection(&m_lock);
+}
+
+void RemoteTreeCache::Clear()
+{
+	::EnterCriticalSection(&m_lock);
+	m_entries.clear();
+	m_listings.clear();
+	::LeaveCriticalSection(&m_lock);
+}
+
+std::string RemoteTreeCache::Normalize(const std::string& strPath)
+{
+	std::string strResult = strPath;
+	while (strResult.size() > 1 && strResult[strResult.size() - 1] == '/')
+		strResult.erase(strResult.size() - 1);
+	return strResult;
+}
+
+std::string RemoteTreeCache::Join(const std::string& strDirectory, const std::string& strName)
+{
+	if (!strDirectory.empty() && strDirectory[strDirectory.size() - 1] == '/')
+		return strDirectory + strName;
+	return strDirectory + "/" + strName;
+}
+
+std::string RemoteTreeCache::GetParent(const std::string& strPath)
+{
+	size_t uSlash = strPath.find_last_of('/');
+	if (uSlash == std::string::npos)
+		return "";
+	return uSlash == 0 ? "/" : strPath.substr(0, uSlash);
+}
+
+RemoteTreeWalker::RemoteTreeWalker(RemoteTreeCache& cache)
+: m_cache(cache)
+, m_bRecursive(false)
+, m_pfnEntry(NULL)
+, m_pUser(NULL)
+, m_uThreads(0)
+, m_hWork(NULL)
+, m_uOutstanding(0)
+, m_bCancel(false)
+, m_snr(SN_S_OK)
+, m_uDirectories(0)
+, m_uFailed(0)
+, m_uEntries(0)
+{
+	::InitializeCriticalSection(&m_lock);
+}
+
+RemoteTreeWalker::~RemoteTreeWalker()
+{
+	Cancel();
+	Wait(INFINITE);
+	::DeleteCriticalSection(&m_lock);
+}
+
+bool RemoteTreeWalker::Start(const std::string& strRoot, bool bRecursive, UINT32 uMaxInFlight, EntryFunction pfnEntry, void* pUser)
+{
+	_ASSERT(m_workers.IsEmpty());
+
+	m_strRoot = RemoteTreeCache::Normalize(strRoot);
+	m_bRecursive = bRecursive;
+	m_pfnEntry = pfnEntry;
+	m_pUser = pUser;
+	m_bCancel = false;
+	m_snr = SN_S_OK;
+	m_uDirectories = 0;
+	m_uFailed = 0;
+	m_uEntries = 0;
+
+	// A walk that is not recursive only lists the root.
+	m_uThreads = uMaxInFlight ? uMaxInFlight : REMOTE_TREE_DEFAULT_MAX;
+	if (!bRecursive)
+		m_uThreads = 1;
+
+	m_queue.clear();
+	m_queue.push_back(m_strRoot);
+	m_uOutstanding = 1;
+
+	m_hWork = ::CreateSemaphore(NULL, 1, LONG_MAX, NULL);
+	if (!m_hWork)
+		return false;
+
+	if (!m_workers.Start<RemoteTreeWalker, &RemoteTreeWalker::WorkerThread>(m_uThreads, this))
+	{
+		Cleanup();
+		return false;
+	}
+
+	return true;
+}
+
+bool RemoteTreeWalker::Wait(DWORD dwMilliseconds)
+{
+	if (m_workers.IsEmpty())
+		return true;
+
+	if (!m_workers.Wait(dwMilliseconds))
+		return false;
+
+	Cleanup();
+	return true;
+}
+
+void RemoteTreeWalker::Cancel()
+{
+	m_bCancel = true;
+}
+
+void RemoteTreeWalker::WorkerThread()
+{
+	for (;;)
+	{
+		::WaitForSingleObject(m_hWork, INFINITE);
+
+		// An empty queue means the walk is over.
+		::EnterCriticalSection(&m_lock);
+		if (m_queue.empty())
+		{
+			::LeaveCriticalSection(&m_lock);
+			break;
+		}
+		std::string strDirectory = m_queue.front();
+		m_queue.pop_front();
+		bool bSkip = m_bCancel;
+		::LeaveCriticalSection(&m_lock);
+
+		RemoteListing listing;
+		SNRESULT snr = bSkip ? SN_S_OK : m_cache.List(strDirectory, listing);
+
+		::EnterCriticalSection(&m_lock);
+		if (!bSkip)
+		{
+			m_uDirectories++;
+			if (SN_FAILED(snr))
+			{
+				m_uFailed++;
+				if (SN_SUCCEEDED(m_snr))
+					m_snr = snr;
+			}
+
+			for (size_t i = 0; i < listing.size() && !m_bCancel; ++i)
+			{
+				std::string strPath = RemoteTreeCache::Join(strDirectory, listing[i].first);
+				const RemoteFileInfo& info = listing[i].second;
+				m_uEntries++;
+
+				if (m_pfnEntry && !m_pfnEntry(m_pUser, strPath, info))
+				{
+					m_bCancel = true;
+					break;
+				}
+
+				if (m_bRecursive && info.uType == SNPS3_DIRENT_TYPE_DIRECTORY)
+				{
+					m_queue.push_back(strPath);
+					m_uOutstanding++;
+					::ReleaseSemaphore(m_hWork, 1, NULL);
+				}
+			}
+		}
+
+		// The last directory wakes every thread to find the queue empty.
+		if (--m_uOutstanding == 0)
+			::ReleaseSemaphore(m_hWork, m_uThreads, NULL);
+		::LeaveCriticalSection(&m_lock);
+	}
+}
+
+void RemoteTreeWalker::Cleanup()
+{
+	if (m_hWork)
+	{
+		::CloseHandle(m_hWork);
+		m_hWork = NULL;
+	}
+}
@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef REMOTE_TREE_H
+#define REMOTE_TREE_H
+
+#include <windows.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+#include "WorkerThreads.h"
+
+#define REMOTE_TREE_DEFAULT_CAPACITY	(64)	// Entries asked for when a directory has no hint
+#define REMOTE_TREE_DEFAULT_MAX			(8)
+
+// The SNPS3DirEntryEx fields of a target file, without its name.
+struct RemoteFileInfo
+{
+	UINT32		uType;			// SNPS3_DIRENT_TYPE_*
+	UINT32		uMode;
+	UINT64		uAccessTime;	// time_t, UTC
+	UINT64		uModifiedTime;
+	UINT64		uCreateTime;
+	UINT64		uSize;
+};
+
+typedef std::vector<std::pair<std::string, RemoteFileInfo> > RemoteListing;
+
+// Metadata of the files on one target, keyed by full path, filled in as
+// directories are listed and files are stat'd. A directory that has been
+// listed also answers for the names it does not contain, so "does this
+// exist" checks under it cost nothing.
+//
+// Entries are only dropped by Invalidate(), which callers must use for
+// anything they write or delete; changes made on the target by anyone
+// else are not seen. All methods may be called from any thread.
+class RemoteTreeCache
+{
+public:
+						RemoteTreeCache(HTARGET hTarget);
+						~RemoteTreeCache();
+
+	HTARGET				GetTarget() const { return m_hTarget; }
+
+	// Cached if possible, else SNPS3StatTargetFileEx(). A path that a listed
+	// directory above it shows cannot exist fails with SN_E_FILE_ERROR.
+	SNRESULT			Stat(const std::string& strPath, RemoteFileInfo& info);
+	// Cached if listed before, else SNPS3GetDirectoryListEx(). The names are
+	// relative to the directory, without "." and "..".
+	SNRESULT			List(const std::string& strDirectory, RemoteListing& listing);
+
+	// Forgets the path, everything under it and the listing it is in.
+	void				Invalidate(const std::string& strPath);
+	void				Clear();
+
+	UINT64				GetHits() const { return (UINT64)m_lHits; }
+	UINT64				GetTargetCalls() const { return (UINT64)m_lTargetCalls; }
+
+	static std::string	Normalize(const std::string& strPath);
+	static std::string	Join(const std::string& strDirectory, const std::string& strName);
+	static std::string	GetParent(const std::string& strPath);
+
+private:
+	bool				IsKnownMissing(const std::string& strPath) const;
+	SNRESULT			ListFromTarget(const std::string& strDirectory, RemoteListing& listing);
+
+	typedef std::map<std::string, RemoteFileInfo>			EntryMap;
+	typedef std::map<std::string, std::vector<std::string> >	ListingMap;
+
+	HTARGET							m_hTarget;
+	mutable CRITICAL_SECTION		m_lock;
+	EntryMap						m_entries;
+	ListingMap						m_listings;		// Names in each listed directory
+	std::map<std::string, UINT32>	m_hints;		// Entry counts, kept when invalidated
+	volatile LONG					m_lHits;
+	volatile LONG					m_lTargetCalls;
+};
+
+// Walks the tree under a target directory, listing up to uMaxInFlight
+// directories at a time through the cache.
+class RemoteTreeWalker
+{
+public:
+	// Called for each entry found, one at a time, on a worker thread; returns
+	// false to stop the walk.
+	typedef bool (*EntryFunction)(void* pUser, const std::string& strPath, const RemoteFileInfo& info);
+
+						RemoteTreeWalker(RemoteTreeCache& cache);
+						~RemoteTreeWalker();
+
+	bool				Start(const std::string& strRoot, bool bRecursive, UINT32 uMaxInFlight, EntryFunction pfnEntry, void* pUser);
+	// Returns true once the walk has finished.
+	bool				Wait(DWORD dwMilliseconds);
+	// Directories not yet listed are skipped; those being listed finish.
+	void				Cancel();
+	bool				IsCancelled() const { return m_bCancel; }
+
+	// Of the root listing, or else the first directory that could not be listed.
+	SNRESULT			GetResult() const { return m_snr; }
+	UINT32				GetDirectoryCount() const { return m_uDirectories; }
+	UINT32				GetFailedCount() const { return m_uFailed; }
+	UINT64				GetEntryCount() const { return m_uEntries; }
+
+private:
+	void				WorkerThread();
+	void				Cleanup();
+
+	RemoteTreeCache&			m_cache;
+	std::string					m_strRoot;
+	bool						m_bRecursive;
+	EntryFunction				m_pfnEntry;
+	void*						m_pUser;
+	WorkerThreads				m_workers;
+	UINT32						m_uThreads;
+	HANDLE						m_hWork;		// Counts queued directories
+	CRITICAL_SECTION			m_lock;
+	std::deque<std::string>		m_queue;
+	UINT32						m_uOutstanding;	// Queued and being listed
+	volatile bool				m_bCancel;
+	SNRESULT					m_snr;
+	UINT32						m_uDirectories;
+	UINT32						m_uFailed;
+	UINT64						m_uEntries;
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include "TargetCommand.h"
+#include "TimeoutProfile.h"
+#include <conio.h>
 
 VecCommandType g_Commands;
 
@@ -24,6 +26,7 @@ TargetCommand::TargetCommand(bool bConnectToTarget/* = true*/)
 , m_bDCifNotConnected(false)
 , m_bForceDC(false)
 , m_bWasOriginallyConnected(false)
+, m_uConnectTime(0)
 , m_targetId(INVALID_TARGET)
 , m_bLogToFile(false)
 , m_bSurpressErrorLogging(false)
@@ -710,6 +713,7 @@ bool TargetCommand::ConnectToActiveTarget()
 {
 	char* pszUsage = NULL;
 	SNRESULT snr;
+	UINT64 uStart = GetMonotonicMilliseconds();
 	// Connect to the target.
 	if (SN_FAILED(snr = SNPS3Connect(m_targetId, NULL)))
 	{
@@ -737,6 +741,9 @@ bool TargetCommand::ConnectToActiveTarget()
 		m_bWasOriginallyConnected = (snr == SN_S_NO_ACTION);
 	}
 
+	if (!m_bWasOriginallyConnected)
+		m_uConnectTime = (UINT32)(GetMonotonicMilliseconds() - uStart);
+
 	PrintMessage(ML_INFO, L"Connected to target\n");
 	return true;
 }
@@ -860,6 +867,16 @@ bool TargetCommand::ExtractTargetDetails(std::string& str, TARGET_ADD_DATA& data
 	return true;
 }
 
+bool TargetCommand::CheckForEscape()
+{
+	while (_kbhit())
+	{
+		if (_getch() == ESCAPE_KEY)
+			return true;
+	}
+	return false;
+}
+
 std::string TargetCommand::GetTargetType(std::string& str)
 {
 	if (str == "PS3_DEH_TCP" || str == "ref1000")
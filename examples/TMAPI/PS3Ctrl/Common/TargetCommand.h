@@ -8,7 +8,7 @@
 #define TARGET_COMMAND_H
 
 #include "CommandLineTools.h"
-#include "ps3tmapi.h"
+#include "TmapiTrace.h"
 #include "tmver.h"
 #include "Defines.h"
 #include <windows.h>
@@ -105,6 +105,8 @@ protected:
 	void			SetExitCode(UINT32 exitCode);
 	void			DisplayCommonOptions() const;
 	void			ShowUsage() const;
+	// Whether ESC was pressed since the last call; other keys are dropped.
+	bool			CheckForEscape();
 
 	commandargutils::CommandLineHandler m_cmdLineHandler;
 
@@ -115,6 +117,7 @@ protected:
 	bool							m_bDCifNotConnected;
 	bool							m_bForceDC;
 	bool							m_bWasOriginallyConnected;
+	UINT32							m_uConnectTime;			// Milliseconds connecting took, 0 if it was connected
 	HTARGET							m_targetId;
 	bool							m_bLogToFile;
 	std::string						m_logFilePath;
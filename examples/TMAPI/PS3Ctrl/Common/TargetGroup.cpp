@@ -0,0 +1,270 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "TargetGroup.h"
+#include "TargetCommand.h"
+
+TargetGroup::TargetGroup()
+: m_pfnWork(NULL)
+, m_pUser(NULL)
+, m_lNext(0)
+, m_lInFlight(0)
+, m_bCancel(false)
+, m_uFrequency(1)
+, m_uStart(0)
+, m_uElapsedMs(0)
+{
+	LARGE_INTEGER frequency;
+	if (::QueryPerformanceFrequency(&frequency) && frequency.QuadPart)
+		m_uFrequency = frequency.QuadPart;
+}
+
+TargetGroup::~TargetGroup()
+{
+	Cancel();
+	Wait(INFINITE);
+}
+
+bool TargetGroup::Resolve(const std::string& strList)
+{
+	m_members.clear();
+
+	if (TargetCommand::ms_Targets.empty())
+	{
+		SNRESULT snr;
+		if (SN_FAILED( snr = SNPS3EnumerateTargets(TargetCommand::EnumCallBack) ))
+		{
+			TargetCommand::PrintError(snr, L"Failed to enumerate targets");
+			return false;
+		}
+	}
+
+	std::vector<std::string> names;
+	if (strList == TARGET_GROUP_ALL)
+	{
+		for (size_t i = 0; i < TargetCommand::ms_Targets.size(); ++i)
+			names.push_back(TargetCommand::ms_Targets[i]->pszName);
+	}
+	else
+	{
+		size_t uStart = 0;
+		while (uStart <= strList.size())
+		{
+			size_t uEnd = strList.find(',', uStart);
+			if (uEnd == std::string::npos)
+				uEnd = strList.size();
+
+			std::string strName = strList.substr(uStart, uEnd - uStart);
+			size_t uFirst = strName.find_first_not_of(" \t");
+			if (uFirst != std::string::npos)
+				names.push_back(strName.substr(uFirst, strName.find_last_not_of(" \t") - uFirst + 1));
+
+			uStart = uEnd + 1;
+		}
+	}
+
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		TargetGroupMember member;
+		member.strName = names[i];
+		member.result = TGR_PENDING;
+		member.snr = SN_S_OK;
+		member.uStartMs = 0;
+		member.uElapsedMs = 0;
+
+		SNRESULT snr;
+		if (SN_FAILED( snr = SNPS3GetTargetFromName(member.strName.c_str(), &member.hTarget) ))
+		{
+			if (!TargetCommand::GetTargetFromAddress(member.strName.c_str(), member.hTarget))
+			{
+				TargetCommand::PrintError(snr, L"Failed to find target %s", UTF8ToWChar(member.strName).c_str());
+				return false;
+			}
+		}
+
+		// Members go by the name Target Manager knows them by, however they
+		// were named on the command line.
+		SNPS3TargetInfo ti = {};
+		ti.hTarget = member.hTarget;
+		ti.nFlags = SN_TI_TARGETID;
+		if (SN_S_OK == SNPS3GetTargetInfo(&ti) && ti.pszName)
+			member.strName = ti.pszName;
+
+		// A target named twice, or by name and by address, is only worked on once.
+		bool bDuplicate = false;
+		for (size_t j = 0; j < m_members.size() && !bDuplicate; ++j)
+			bDuplicate = m_members[j].hTarget == member.hTarget;
+
+		if (!bDuplicate)
+			m_members.push_back(member);
+	}
+
+	if (m_members.empty())
+	{
+		TargetCommand::PrintMessage(ML_ERROR, L"No targets in group \"%s\"", UTF8ToWChar(strList).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool TargetGroup::Start(WorkFunction pfnWork, void* pUser, UINT32 uMaxInFlight)
+{
+	_ASSERT(m_workers.IsEmpty());
+
+	m_pfnWork = pfnWork;
+	m_pUser = pUser;
+	m_lNext = 0;
+	m_lInFlight = 0;
+	m_bCancel = false;
+	m_uElapsedMs = 0;
+
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	m_uStart = now.QuadPart;
+
+	UINT32 uPending = GetResultCount(TGR_PENDING);
+	UINT32 uThreads = uMaxInFlight && uMaxInFlight < uPending ? uMaxInFlight : uPending;
+
+	if (uThreads && !m_workers.Start<TargetGroup, &TargetGroup::WorkerThread>(uThreads, this))
+	{
+		TargetCommand::PrintMessage(ML_ERROR, L"Failed to create worker threads");
+		return false;
+	}
+
+	return true;
+}
+
+bool TargetGroup::Wait(DWORD dwMilliseconds)
+{
+	if (m_workers.IsEmpty())
+		return true;
+
+	if (!m_workers.Wait(dwMilliseconds))
+		return false;
+
+	m_uElapsedMs = GetMilliseconds();
+	return true;
+}
+
+void TargetGroup::Cancel()
+{
+	m_bCancel = true;
+}
+
+UINT32 TargetGroup::GetResultCount(TargetGroupResult result) const
+{
+	UINT32 uCount = 0;
+	for (size_t i = 0; i < m_members.size(); ++i)
+	{
+		if (m_members[i].result == result)
+			uCount++;
+	}
+	return uCount;
+}
+
+UINT64 TargetGroup::GetElapsedMilliseconds() const
+{
+	return m_workers.IsEmpty() ? m_uElapsedMs : GetMilliseconds();
+}
+
+void TargetGroup::PrintReport(const WCHAR* pszAction) const
+{
+	UINT64 uSerialMs = 0;
+	for (size_t i = 0; i < m_members.size(); ++i)
+	{
+		const TargetGroupMember& member = m_members[i];
+		uSerialMs += member.uElapsedMs;
+
+		MSG_LEVEL level = member.result == TGR_FAILED ? ML_ERROR : member.result == TGR_CANCELLED ? ML_WARN : ML_INFO;
+		TargetCommand::PrintMessage(level, L"  %-24s %-9s %8.1fs  %s", UTF8ToWChar(member.strName).c_str(),
+			GetResultText(member.result), member.uElapsedMs / 1000.0, UTF8ToWChar(member.strDetail).c_str());
+	}
+
+	UINT64 uElapsedMs = GetElapsedMilliseconds();
+	TargetCommand::PrintMessage(ML_INFO, L"%s %u of %u targets: %u skipped, %u failed, %u cancelled in %.1fs (%.1fs one at a time)",
+		pszAction, GetResultCount(TGR_SUCCEEDED), (UINT32)m_members.size(), GetResultCount(TGR_SKIPPED),
+		GetResultCount(TGR_FAILED), GetResultCount(TGR_CANCELLED), uElapsedMs / 1000.0, uSerialMs / 1000.0);
+}
+
+bool TargetGroup::Connect(TargetGroupMember& member, bool bForce, bool& bWasConnected)
+{
+	SNRESULT snr = SNPS3Connect(member.hTarget, NULL);
+	if (snr == SN_E_TARGET_IN_USE && bForce)
+	{
+		if (SN_SUCCEEDED( snr = SNPS3ForceDisconnect(member.hTarget) ))
+			snr = SNPS3Connect(member.hTarget, NULL);
+	}
+
+	if (SN_FAILED(snr))
+	{
+		Fail(member, snr, "Failed to connect");
+		return false;
+	}
+
+	bWasConnected = (snr == SN_S_NO_ACTION);
+	return true;
+}
+
+TargetGroupResult TargetGroup::Fail(TargetGroupMember& member, SNRESULT snr, const char* pszWhat)
+{
+	const char* pszError = NULL;
+	SNPS3TranslateError(snr, &pszError);
+
+	member.snr = snr;
+	member.strDetail = pszWhat;
+	member.strDetail += ": ";
+	member.strDetail += pszError ? pszError : "Unknown";
+	return TGR_FAILED;
+}
+
+const WCHAR* TargetGroup::GetResultText(TargetGroupResult result)
+{
+	switch (result)
+	{
+	case TGR_PENDING:	return L"Pending";
+	case TGR_SUCCEEDED:	return L"OK";
+	case TGR_SKIPPED:	return L"Skipped";
+	case TGR_FAILED:	return L"Failed";
+	case TGR_CANCELLED:	return L"Cancelled";
+	default:			return L"Unknown";
+	}
+}
+
+void TargetGroup::WorkerThread()
+{
+	for (;;)
+	{
+		LONG lMember = ::InterlockedIncrement(&m_lNext) - 1;
+		if (lMember >= (LONG)m_members.size())
+			break;
+
+		TargetGroupMember& member = m_members[lMember];
+		if (member.result != TGR_PENDING)
+			continue;
+
+		if (m_bCancel)
+		{
+			member.result = TGR_CANCELLED;
+			continue;
+		}
+
+		::InterlockedIncrement(&m_lInFlight);
+		member.uStartMs = GetMilliseconds();
+
+		member.result = m_pfnWork(m_pUser, member);
+
+		member.uElapsedMs = GetMilliseconds() - member.uStartMs;
+		::InterlockedDecrement(&m_lInFlight);
+	}
+}
+
+UINT64 TargetGroup::GetMilliseconds() const
+{
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return (UINT64)(now.QuadPart - m_uStart) * 1000 / m_uFrequency;
+}
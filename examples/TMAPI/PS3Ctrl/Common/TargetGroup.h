@@ -0,0 +1,98 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TARGET_GROUP_H
+#define TARGET_GROUP_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+#include "WorkerThreads.h"
+
+// A set of targets a command works on at once, named on the command line as
+// a comma separated list of target names or addresses, or TARGET_GROUP_ALL
+// for every target known to Target Manager.
+
+#define TARGET_GROUP_ALL			"all"
+#define TARGET_GROUP_DEFAULT_MAX	(8)
+
+enum TargetGroupResult
+{
+	TGR_PENDING,
+	TGR_SUCCEEDED,
+	TGR_SKIPPED,
+	TGR_FAILED,
+	TGR_CANCELLED,
+	TGR_COUNT
+};
+
+struct TargetGroupMember
+{
+	std::string			strName;
+	HTARGET				hTarget;
+	TargetGroupResult	result;
+	SNRESULT			snr;			// Of the call that failed
+	std::string			strDetail;		// Shown in the report
+	UINT64				uStartMs;		// Since Start()
+	UINT64				uElapsedMs;
+};
+
+// Runs the work for each pending member on its own thread, with at most
+// uMaxInFlight members being worked on at a time. The work function is called
+// on a worker thread, so it must only touch its own member and anything it
+// locks; it returns the member's result.
+class TargetGroup
+{
+public:
+	typedef TargetGroupResult (*WorkFunction)(void* pUser, TargetGroupMember& member);
+
+						TargetGroup();
+						~TargetGroup();
+
+	bool				Resolve(const std::string& strList);
+	size_t				GetCount() const { return m_members.size(); }
+	TargetGroupMember&	GetMember(size_t uMember) { return m_members[uMember]; }
+	const TargetGroupMember& GetMember(size_t uMember) const { return m_members[uMember]; }
+
+	bool				Start(WorkFunction pfnWork, void* pUser, UINT32 uMaxInFlight);
+	// Returns true once every member has finished.
+	bool				Wait(DWORD dwMilliseconds);
+	// Members not yet started are marked cancelled; those in flight finish.
+	void				Cancel();
+	bool				IsCancelled() const { return m_bCancel; }
+
+	UINT32				GetResultCount(TargetGroupResult result) const;
+	UINT32				GetInFlight() const { return (UINT32)m_lInFlight; }
+	UINT64				GetElapsedMilliseconds() const;
+
+	// Prints a line per member and a summary with the time saved over
+	// working on the members one after another.
+	void				PrintReport(const WCHAR* pszAction) const;
+
+	// Connects the member's target, forcing off another user if bForce.
+	static bool			Connect(TargetGroupMember& member, bool bForce, bool& bWasConnected);
+	// Records the call that failed in the member's report line.
+	static TargetGroupResult Fail(TargetGroupMember& member, SNRESULT snr, const char* pszWhat);
+	static const WCHAR*	GetResultText(TargetGroupResult result);
+
+private:
+	void				WorkerThread();
+	UINT64				GetMilliseconds() const;
+
+	std::vector<TargetGroupMember>	m_members;
+	WorkerThreads					m_workers;
+	WorkFunction					m_pfnWork;
+	void*							m_pUser;
+	volatile LONG					m_lNext;
+	volatile LONG					m_lInFlight;
+	volatile bool					m_bCancel;
+	UINT64							m_uFrequency;
+	UINT64							m_uStart;
+	UINT64							m_uElapsedMs;	// Set once finished
+};
+
+#endif
@@ -0,0 +1,244 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "TimeoutProfile.h"
+#include "HdrHistogram.h"
+#include "RecordFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMEOUT_PROFILE_FILE_NAME		L"PS3Ctrl_timeouts.profile"
+#define TIMEOUT_PROFILE_HEADER			"# PS3Ctrl timeout profile 1: target, operation, milliseconds oldest first"
+
+#define TIMEOUT_PROFILE_MAX_SAMPLES		(50)		// Kept for each target and operation
+#define TIMEOUT_PROFILE_MIN_SAMPLES		(5)			// Before a timeout is derived
+#define TIMEOUT_PROFILE_PERCENTILE		(99.0)
+#define TIMEOUT_PROFILE_SLACK_MS		(2000)
+#define TIMEOUT_PROFILE_MIN_MS			(5000)
+#define TIMEOUT_PROFILE_MAX_MS			(10 * 60 * 1000)
+
+namespace
+{
+	const char* g_apszOperationNames[TOP_COUNT] = { "reset", "connect", "load", "exit" };
+
+	// The target manager timeout each operation is bounded by. RESET_TIMEOUT
+	// is a wait before reconnecting rather than a limit, so a reset is
+	// bounded by the time allowed to reconnect after it.
+	const SNPS3_TM_TIMEOUT g_aTimeoutIds[TOP_COUNT] = { RECONNECT_TIMEOUT, CONNECT_TIMEOUT, LOAD_TIMEOUT, GAMEEXIT_TIMEOUT };
+}
+
+UINT64 GetMonotonicMilliseconds()
+{
+	static LARGE_INTEGER s_frequency = { 0 };
+	if (s_frequency.QuadPart == 0)
+		::QueryPerformanceFrequency(&s_frequency);
+
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return (UINT64)(now.QuadPart / s_frequency.QuadPart * 1000 + now.QuadPart % s_frequency.QuadPart * 1000 / s_frequency.QuadPart);
+}
+
+bool TimeoutProfile::Load(const WCHAR* pszPath)
+{
+	m_series.clear();
+
+	RecordFileReader reader;
+	if (!reader.Open(pszPath))
+		return false;
+
+	// target, operation, samples
+	char* apFields[3];
+	while (UINT32 uFields = reader.Next(apFields, _countof(apFields)))
+	{
+		if (uFields != _countof(apFields) || apFields[0][0] == '\0')
+			continue;
+
+		const char* pszTarget = apFields[0];
+		const char* pOperation = apFields[1];
+		char* pSamples = apFields[2];
+
+		int nOperation = 0;
+		while (nOperation < TOP_COUNT && strcmp(pOperation, g_apszOperationNames[nOperation]) != 0)
+			nOperation++;
+		if (nOperation == TOP_COUNT)
+			continue;
+
+		char* pEnd = pSamples;
+		while (*pEnd)
+		{
+			char* pSample = pEnd;
+			UINT32 uSample = strtoul(pSample, &pEnd, 10);
+			if (pEnd == pSample)
+				break;
+			Record(pszTarget, (TimedOperation)nOperation, uSample);
+			if (*pEnd != ',')
+				break;
+			pEnd++;
+		}
+	}
+
+	return true;
+}
+
+bool TimeoutProfile::Save(const WCHAR* pszPath) const
+{
+	RecordFileWriter writer;
+	if (!writer.Open(pszPath, TIMEOUT_PROFILE_HEADER))
+		return false;
+
+	for (size_t i = 0; i < m_series.size(); ++i)
+	{
+		const Series& series = m_series[i];
+		writer.Print("%s\t%s\t", series.strTarget.c_str(), g_apszOperationNames[series.eOperation]);
+		for (size_t j = 0; j < series.samples.size(); ++j)
+			writer.Print(j ? ",%u" : "%u", series.samples[j]);
+		writer.Print("\n");
+	}
+
+	return writer.Commit();
+}
+
+void TimeoutProfile::Record(const std::string& strTarget, TimedOperation eOperation, UINT32 uMilliseconds)
+{
+	Series* pSeries = NULL;
+	for (size_t i = 0; i < m_series.size() && !pSeries; ++i)
+	{
+		if (m_series[i].strTarget == strTarget && m_series[i].eOperation == eOperation)
+			pSeries = &m_series[i];
+	}
+
+	if (!pSeries)
+	{
+		Series series;
+		series.strTarget = strTarget;
+		series.eOperation = eOperation;
+		m_series.push_back(series);
+		pSeries = &m_series.back();
+	}
+
+	// Only the recent ones, as a target's speed changes with its firmware
+	// and what it is plugged into.
+	if (pSeries->samples.size() >= TIMEOUT_PROFILE_MAX_SAMPLES)
+		pSeries->samples.erase(pSeries->samples.begin());
+	pSeries->samples.push_back(uMilliseconds);
+}
+
+void TimeoutProfile::RecordTimeout(const std::string& strTarget, TimedOperation eOperation, UINT32 uTimeout)
+{
+	UINT32 uLonger = uTimeout * 2 > TIMEOUT_PROFILE_MAX_MS ? TIMEOUT_PROFILE_MAX_MS : uTimeout * 2;
+	Record(strTarget, eOperation, uLonger);
+}
+
+void TimeoutProfile::RecordResult(const std::string& strTarget, TimedOperation eOperation, UINT64 uStart, SNRESULT snr)
+{
+	UINT64 uElapsed = GetMonotonicMilliseconds() - uStart;
+	UINT32 uMilliseconds = uElapsed > TIMEOUT_PROFILE_MAX_MS ? TIMEOUT_PROFILE_MAX_MS : (UINT32)uElapsed;
+
+	if (SN_SUCCEEDED(snr))
+	{
+		Record(strTarget, eOperation, uMilliseconds);
+	}
+	else if (snr == SN_E_TIMEOUT)
+	{
+		// Without a timeout from here it had the target manager's, which is
+		// about as long as it took to fail.
+		UINT32 uTimeout = GetTimeout(strTarget, eOperation);
+		RecordTimeout(strTarget, eOperation, uTimeout > uMilliseconds ? uTimeout : uMilliseconds);
+	}
+}
+
+UINT32 TimeoutProfile::GetTimeout(const std::string& strTarget, TimedOperation eOperation) const
+{
+	const Series* pSeries = Find(strTarget, eOperation);
+	if (!pSeries || pSeries->samples.size() < TIMEOUT_PROFILE_MIN_SAMPLES)
+		return 0;
+
+	HdrHistogram latency(TIMEOUT_PROFILE_MAX_MS * 4ULL, 2);
+	for (size_t i = 0; i < pSeries->samples.size(); ++i)
+		latency.Record(pSeries->samples[i] ? pSeries->samples[i] : 1);
+
+	UINT64 uTimeout = latency.GetValueAtPercentile(TIMEOUT_PROFILE_PERCENTILE);
+	uTimeout += uTimeout / 2 + TIMEOUT_PROFILE_SLACK_MS;
+
+	if (uTimeout < TIMEOUT_PROFILE_MIN_MS)
+		uTimeout = TIMEOUT_PROFILE_MIN_MS;
+	if (uTimeout > TIMEOUT_PROFILE_MAX_MS)
+		uTimeout = TIMEOUT_PROFILE_MAX_MS;
+	return (UINT32)uTimeout;
+}
+
+UINT32 TimeoutProfile::GetSampleCount(const std::string& strTarget, TimedOperation eOperation) const
+{
+	const Series* pSeries = Find(strTarget, eOperation);
+	return pSeries ? (UINT32)pSeries->samples.size() : 0;
+}
+
+SNRESULT TimeoutProfile::Apply(HTARGET hTarget, const std::string& strTarget, UINT32& uApplied) const
+{
+	uApplied = 0;
+
+	SNPS3_TM_TIMEOUT aIds[TOP_COUNT];
+	UINT32 aValues[TOP_COUNT];
+	UINT32 uCount = 0;
+	for (int i = 0; i < TOP_COUNT; ++i)
+	{
+		UINT32 uTimeout = GetTimeout(strTarget, (TimedOperation)i);
+		if (uTimeout)
+		{
+			aIds[uCount] = g_aTimeoutIds[i];
+			aValues[uCount++] = uTimeout;
+		}
+	}
+
+	if (uCount == 0)
+		return SN_S_OK;
+
+	SNRESULT snr = SNPS3SetTimeouts(hTarget, uCount, aIds, aValues);
+	if (SN_SUCCEEDED(snr))
+	{
+		uApplied = uCount;
+		return snr;
+	}
+
+	// A target that rejects any one of the timeouts fails the lot, and which
+	// it rejects is not documented, so they are tried one at a time.
+	if (snr != SN_E_BAD_PARAM || uCount == 1)
+		return snr;
+
+	for (UINT32 i = 0; i < uCount; ++i)
+	{
+		if (SN_SUCCEEDED(SNPS3SetTimeouts(hTarget, 1, &aIds[i], &aValues[i])))
+			uApplied++;
+	}
+
+	return uApplied ? SN_S_OK : snr;
+}
+
+const char* TimeoutProfile::GetOperationName(TimedOperation eOperation)
+{
+	return g_apszOperationNames[eOperation];
+}
+
+std::wstring TimeoutProfile::GetDefaultPath()
+{
+	WCHAR szTemp[MAX_PATH + 1];
+	DWORD dwLength = ::GetTempPathW(_countof(szTemp), szTemp);
+
+	std::wstring strPath = dwLength && dwLength < _countof(szTemp) ? szTemp : L"";
+	strPath += TIMEOUT_PROFILE_FILE_NAME;
+	return strPath;
+}
+
+const TimeoutProfile::Series* TimeoutProfile::Find(const std::string& strTarget, TimedOperation eOperation) const
+{
+	for (size_t i = 0; i < m_series.size(); ++i)
+	{
+		if (m_series[i].strTarget == strTarget && m_series[i].eOperation == eOperation)
+			return &m_series[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TIMEOUT_PROFILE_H
+#define TIMEOUT_PROFILE_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+
+enum TimedOperation
+{
+	TOP_RESET,
+	TOP_CONNECT,
+	TOP_LOAD,
+	TOP_EXIT,
+	TOP_COUNT
+};
+
+// Milliseconds from a clock that only goes forward, unlike the time of day.
+UINT64 GetMonotonicMilliseconds();
+
+// How long each operation has taken on each target, kept on the host across
+// runs. Targets differ too much in speed for one set of timeouts to suit them
+// all, so each gets timeouts from the high percentiles of its own recent
+// operations, with some slack. Operations that timed out are recorded at
+// twice the timeout they had, so a target that has got slower is given longer.
+class TimeoutProfile
+{
+public:
+	// A missing profile loads as empty.
+	bool			Load(const WCHAR* pszPath);
+	bool			Save(const WCHAR* pszPath) const;
+
+	void			Record(const std::string& strTarget, TimedOperation eOperation, UINT32 uMilliseconds);
+	void			RecordTimeout(const std::string& strTarget, TimedOperation eOperation, UINT32 uTimeout);
+	// Records an operation started at uStart, by GetMonotonicMilliseconds(),
+	// that has just returned snr. Failures other than timeouts say nothing
+	// about how long it takes, so are left out.
+	void			RecordResult(const std::string& strTarget, TimedOperation eOperation, UINT64 uStart, SNRESULT snr);
+
+	// 0 until there are enough samples to go by.
+	UINT32			GetTimeout(const std::string& strTarget, TimedOperation eOperation) const;
+	UINT32			GetSampleCount(const std::string& strTarget, TimedOperation eOperation) const;
+
+	// Sets the target manager's timeouts of the target for the operations
+	// there are timeouts for; uApplied is how many were set.
+	SNRESULT		Apply(HTARGET hTarget, const std::string& strTarget, UINT32& uApplied) const;
+
+	static const char*	GetOperationName(TimedOperation eOperation);
+	static std::wstring	GetDefaultPath();
+
+private:
+	struct Series
+	{
+		std::string			strTarget;
+		TimedOperation		eOperation;
+		std::vector<UINT32>	samples;		// Oldest first
+	};
+
+	const Series*	Find(const std::string& strTarget, TimedOperation eOperation) const;
+
+	std::vector<Series>	m_series;
+};
+
+#endif
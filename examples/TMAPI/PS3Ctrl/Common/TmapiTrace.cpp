@@ -0,0 +1,477 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+// The wrappers below call the real functions.
+#define TMAPI_TRACE_NO_REDIRECT
+#include "TmapiTrace.h"
+
+#ifdef TMAPI_TRACE
+
+#include "HdrHistogram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef _MSC_VER
+// Deprecated functions are wrapped too.
+#pragma warning(disable: 4995 4996)
+#endif
+
+#define TMAPI_TRACE_ENVIRONMENT		"PS3CTRL_TMAPI_TRACE"
+#define TMAPI_TRACE_HIGHEST_NS		(3600ULL * 1000 * 1000 * 1000)
+#define TMAPI_TRACE_DIGITS			(2)
+#define TMAPI_TRACE_RESULT_SLOTS	(4)
+#define TMAPI_TRACE_SPAN_CHUNK		(64 * 1024)
+#define TMAPI_TRACE_MAX_SPANS		(64 * TMAPI_TRACE_SPAN_CHUNK)	// Per thread
+#define TMAPI_TRACE_SHOWN_RESULTS	(3)
+
+namespace
+{
+	// The few platform calls the tracer needs, so that it can also be built
+	// and tested on Linux against stub TMAPI functions.
+#ifdef _WIN32
+	#define TRACE_THREAD_LOCAL	__declspec(thread)
+
+	inline UINT64 Now()
+	{
+		LARGE_INTEGER now;
+		::QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+
+	inline UINT64 GetFrequency()
+	{
+		LARGE_INTEGER frequency;
+		::QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+	}
+
+	inline UINT32 GetThreadId()		{ return ::GetCurrentThreadId(); }
+	inline UINT32 GetProcessId()	{ return ::GetCurrentProcessId(); }
+
+	inline void* CompareExchange(void* volatile* ppDestination, void* pExchange, void* pComparand)
+	{
+		return ::InterlockedCompareExchangePointer(ppDestination, pExchange, pComparand);
+	}
+#else
+	#define TRACE_THREAD_LOCAL	__thread
+	#define sprintf_s			snprintf
+
+	inline UINT64 Now()
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (UINT64)now.tv_sec * 1000000000 + now.tv_nsec;
+	}
+
+	inline UINT64 GetFrequency()	{ return 1000000000; }
+	inline UINT32 GetThreadId()		{ return (UINT32)syscall(SYS_gettid); }
+	inline UINT32 GetProcessId()	{ return (UINT32)getpid(); }
+
+	inline void* CompareExchange(void* volatile* ppDestination, void* pExchange, void* pComparand)
+	{
+		return __sync_val_compare_and_swap(ppDestination, pComparand, pExchange);
+	}
+#endif
+
+	struct Counters
+	{
+		Counters()
+		: latency(TMAPI_TRACE_HIGHEST_NS, TMAPI_TRACE_DIGITS)
+		, uBytes(0)
+		, uFailures(0)
+		, uOtherResults(0)
+		{
+			memset(aResults, 0, sizeof(aResults));
+			memset(auResultCounts, 0, sizeof(auResultCounts));
+		}
+
+		HdrHistogram	latency;		// Nanoseconds
+		UINT64			uBytes;
+		UINT64			uFailures;
+		SNRESULT		aResults[TMAPI_TRACE_RESULT_SLOTS];
+		UINT64			auResultCounts[TMAPI_TRACE_RESULT_SLOTS];
+		UINT64			uOtherResults;	// Calls whose result found no free slot
+	};
+
+	struct Span
+	{
+		UINT64			uStart;			// Ticks
+		UINT64			uTicks;
+		UINT64			uBytes;
+		UINT32			uFunction;
+		SNRESULT		snr;
+	};
+
+	// Only written by its own thread; read when the trace is stopped.
+	struct ThreadState
+	{
+		ThreadState()
+		: pNext(NULL)
+		, uThreadId(GetThreadId())
+		, uSpanCount(0)
+		, uDroppedSpans(0)
+		{
+			memset(apCounters, 0, sizeof(apCounters));
+		}
+
+		ThreadState*		pNext;
+		UINT32				uThreadId;
+		Counters*			apCounters[TMAPI_TRACE_FUNCTION_COUNT];
+		std::vector<Span*>	spanChunks;
+		UINT32				uSpanCount;
+		UINT64				uDroppedSpans;
+	};
+
+	const char* const g_apszNames[] =
+	{
+#define TMAPI_TRACE_FUNCTION(name, parameters, arguments, bytes) #name,
+#include "TmapiTraceFunctions.inl"
+#undef TMAPI_TRACE_FUNCTION
+	};
+
+	volatile bool				g_bEnabled = false;
+	bool						g_bSpans = false;
+	std::string					g_strTracePath;
+	UINT64						g_uStart = 0;
+	double						g_fNanosecondsPerTick = 1.0;
+	ThreadState* volatile		g_pThreads = NULL;
+	UINT32						g_uGeneration = 1;		// Moves on each time the threads are released
+	TRACE_THREAD_LOCAL ThreadState* t_pThread = NULL;
+	TRACE_THREAD_LOCAL UINT32	t_uGeneration = 0;
+
+	ThreadState* RegisterThread()
+	{
+		ThreadState* pThread = new ThreadState();
+
+		// Pushed onto the list without a lock; the list is only released once
+		// tracing has stopped.
+		ThreadState* pHead;
+		do
+		{
+			pHead = g_pThreads;
+			pThread->pNext = pHead;
+		}
+		while (CompareExchange((void* volatile*)&g_pThreads, pThread, pHead) != pHead);
+
+		t_pThread = pThread;
+		t_uGeneration = g_uGeneration;
+		return pThread;
+	}
+
+	// Frees what every thread recorded. A thread's t_pThread is left behind,
+	// so the generation tells it to register again next time.
+	void ReleaseThreads()
+	{
+		ThreadState* pThread = g_pThreads;
+		g_pThreads = NULL;
+		g_uGeneration++;
+
+		while (pThread)
+		{
+			ThreadState* pNext = pThread->pNext;
+			for (UINT32 i = 0; i < TMAPI_TRACE_FUNCTION_COUNT; ++i)
+				delete pThread->apCounters[i];
+			for (size_t i = 0; i < pThread->spanChunks.size(); ++i)
+				delete[] pThread->spanChunks[i];
+			delete pThread;
+			pThread = pNext;
+		}
+	}
+
+	void Record(UINT32 uFunction, UINT64 uStart, UINT64 uEnd, SNRESULT snr, UINT64 uBytes)
+	{
+		ThreadState* pThread = t_pThread && t_uGeneration == g_uGeneration ? t_pThread : RegisterThread();
+
+		Counters* pCounters = pThread->apCounters[uFunction];
+		if (!pCounters)
+			pCounters = pThread->apCounters[uFunction] = new Counters();
+
+		UINT64 uTicks = uEnd - uStart;
+		pCounters->latency.Record((UINT64)(uTicks * g_fNanosecondsPerTick));
+		pCounters->uBytes += uBytes;
+		if (SN_FAILED(snr))
+			pCounters->uFailures++;
+
+		UINT32 uSlot = 0;
+		while (uSlot < TMAPI_TRACE_RESULT_SLOTS && pCounters->auResultCounts[uSlot] && pCounters->aResults[uSlot] != snr)
+			uSlot++;
+
+		if (uSlot < TMAPI_TRACE_RESULT_SLOTS)
+		{
+			pCounters->aResults[uSlot] = snr;
+			pCounters->auResultCounts[uSlot]++;
+		}
+		else
+		{
+			pCounters->uOtherResults++;
+		}
+
+		if (g_bSpans)
+		{
+			if (pThread->uSpanCount >= TMAPI_TRACE_MAX_SPANS)
+			{
+				pThread->uDroppedSpans++;
+				return;
+			}
+
+			UINT32 uChunk = pThread->uSpanCount / TMAPI_TRACE_SPAN_CHUNK;
+			if (uChunk == pThread->spanChunks.size())
+				pThread->spanChunks.push_back(new Span[TMAPI_TRACE_SPAN_CHUNK]);
+
+			Span& span = pThread->spanChunks[uChunk][pThread->uSpanCount % TMAPI_TRACE_SPAN_CHUNK];
+			span.uStart = uStart;
+			span.uTicks = uTicks;
+			span.uBytes = uBytes;
+			span.uFunction = uFunction;
+			span.snr = snr;
+			pThread->uSpanCount++;
+		}
+	}
+
+	// Size of a file about to be transferred; only looked up once the call has
+	// been timed.
+	UINT64 TmapiTraceHostFileSize(const char* pszPath)
+	{
+		if (!pszPath)
+			return 0;
+
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!::GetFileAttributesExW(UTF8ToWChar(pszPath).c_str(), GetFileExInfoStandard, &data))
+			return 0;
+		return ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+		struct stat info;
+		return stat(pszPath, &info) == 0 ? (UINT64)info.st_size : 0;
+#endif
+	}
+
+	struct Summary
+	{
+		Summary()
+		: uFunction(0)
+		, latency(TMAPI_TRACE_HIGHEST_NS, TMAPI_TRACE_DIGITS)
+		, uBytes(0)
+		, uFailures(0)
+		, uOtherResults(0)
+		{
+		}
+
+		UINT32						uFunction;
+		HdrHistogram				latency;
+		UINT64						uBytes;
+		UINT64						uFailures;
+		std::map<SNRESULT, UINT64>	results;
+		UINT64						uOtherResults;
+	};
+
+	bool CompareTotal(const Summary* pLeft, const Summary* pRight)
+	{
+		return pLeft->latency.GetTotal() > pRight->latency.GetTotal();
+	}
+
+	void PrintSummary(UINT64 uWallNs)
+	{
+		// Only the functions that were called get a summary.
+		std::vector<Summary*> functions(TMAPI_TRACE_FUNCTION_COUNT, (Summary*)NULL);
+		for (ThreadState* pThread = g_pThreads; pThread; pThread = pThread->pNext)
+		{
+			for (UINT32 i = 0; i < TMAPI_TRACE_FUNCTION_COUNT; ++i)
+			{
+				const Counters* pCounters = pThread->apCounters[i];
+				if (!pCounters)
+					continue;
+
+				if (!functions[i])
+				{
+					functions[i] = new Summary();
+					functions[i]->uFunction = i;
+				}
+
+				Summary& summary = *functions[i];
+				summary.latency.Add(pCounters->latency);
+				summary.uBytes += pCounters->uBytes;
+				summary.uFailures += pCounters->uFailures;
+				summary.uOtherResults += pCounters->uOtherResults;
+				for (UINT32 uSlot = 0; uSlot < TMAPI_TRACE_RESULT_SLOTS; ++uSlot)
+				{
+					if (pCounters->auResultCounts[uSlot])
+						summary.results[pCounters->aResults[uSlot]] += pCounters->auResultCounts[uSlot];
+				}
+			}
+		}
+
+		std::vector<Summary*> summaries;
+		UINT64 uCalls = 0;
+		UINT64 uTotalNs = 0;
+		for (size_t i = 0; i < functions.size(); ++i)
+		{
+			if (functions[i])
+			{
+				summaries.push_back(functions[i]);
+				uCalls += functions[i]->latency.GetCount();
+				uTotalNs += functions[i]->latency.GetTotal();
+			}
+		}
+		std::sort(summaries.begin(), summaries.end(), CompareTotal);
+
+		fprintf(stderr, "\nTMAPI: %llu calls taking %.1f ms, over %.1f ms\n", (unsigned long long)uCalls, uTotalNs / 1e6, uWallNs / 1e6);
+
+		fprintf(stderr, "%-34s %9s %7s %9s %9s %9s %9s %10s %6s %12s  %s\n", "Function", "Calls", "Failed",
+			"p50 us", "p90 us", "p99 us", "Max us", "Total ms", "%Wall", "Bytes", "Results");
+
+		for (size_t i = 0; i < summaries.size(); ++i)
+		{
+			const Summary& summary = *summaries[i];
+			const HdrHistogram& latency = summary.latency;
+
+			// Most frequent results first.
+			std::vector<std::pair<UINT64, SNRESULT> > results;
+			for (std::map<SNRESULT, UINT64>::const_iterator it = summary.results.begin(); it != summary.results.end(); ++it)
+				results.push_back(std::make_pair(it->second, it->first));
+			std::sort(results.rbegin(), results.rend());
+
+			std::string strResults;
+			UINT64 uOther = summary.uOtherResults;
+			for (size_t j = 0; j < results.size(); ++j)
+			{
+				if (j < TMAPI_TRACE_SHOWN_RESULTS)
+				{
+					char szResult[64];
+					sprintf_s(szResult, sizeof(szResult), "%s0x%08x x%llu", j ? " " : "", (UINT32)results[j].second, (unsigned long long)results[j].first);
+					strResults += szResult;
+				}
+				else
+				{
+					uOther += results[j].first;
+				}
+			}
+
+			if (uOther)
+			{
+				char szOther[32];
+				sprintf_s(szOther, sizeof(szOther), " other x%llu", (unsigned long long)uOther);
+				strResults += szOther;
+			}
+
+			fprintf(stderr, "%-34s %9llu %7llu %9.1f %9.1f %9.1f %9.1f %10.2f %5.1f%% %12llu  %s\n", g_apszNames[summary.uFunction],
+				(unsigned long long)latency.GetCount(), (unsigned long long)summary.uFailures,
+				latency.GetValueAtPercentile(50.0) / 1e3, latency.GetValueAtPercentile(90.0) / 1e3,
+				latency.GetValueAtPercentile(99.0) / 1e3, latency.GetMax() / 1e3, latency.GetTotal() / 1e6,
+				uWallNs ? 100.0 * latency.GetTotal() / uWallNs : 0.0, (unsigned long long)summary.uBytes, strResults.c_str());
+		}
+
+		for (size_t i = 0; i < summaries.size(); ++i)
+			delete summaries[i];
+	}
+
+	// Chrome trace event format: complete ("X") events with microsecond times.
+	bool WriteTrace(const char* pszPath)
+	{
+		FILE* pFile = fopen(pszPath, "w");
+		if (!pFile)
+			return false;
+
+		UINT32 uProcessId = GetProcessId();
+		UINT64 uSpans = 0;
+		UINT64 uDropped = 0;
+
+		fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		bool bFirst = true;
+		for (ThreadState* pThread = g_pThreads; pThread; pThread = pThread->pNext)
+		{
+			fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+				bFirst ? "" : ",\n", uProcessId, pThread->uThreadId, pThread->uThreadId);
+			bFirst = false;
+
+			for (UINT32 i = 0; i < pThread->uSpanCount; ++i)
+			{
+				const Span& span = pThread->spanChunks[i / TMAPI_TRACE_SPAN_CHUNK][i % TMAPI_TRACE_SPAN_CHUNK];
+				fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"tmapi\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+					"\"args\":{\"result\":\"0x%08x\",\"bytes\":%llu}}", g_apszNames[span.uFunction], uProcessId, pThread->uThreadId,
+					(span.uStart - g_uStart) * g_fNanosecondsPerTick / 1e3, span.uTicks * g_fNanosecondsPerTick / 1e3,
+					(UINT32)span.snr, (unsigned long long)span.uBytes);
+			}
+
+			uSpans += pThread->uSpanCount;
+			uDropped += pThread->uDroppedSpans;
+		}
+		fprintf(pFile, "\n]}\n");
+
+		bool bOK = !ferror(pFile);
+		if (fclose(pFile) != 0)
+			bOK = false;
+
+		fprintf(stderr, "TMAPI: %llu calls traced to %s", (unsigned long long)uSpans, pszPath);
+		if (uDropped)
+			fprintf(stderr, ", %llu more not kept", (unsigned long long)uDropped);
+		fprintf(stderr, "\n");
+
+		return bOK;
+	}
+}
+
+#define TMAPI_TRACE_FUNCTION(name, parameters, arguments, bytes)	\
+	SNRESULT TmapiTrace_##name parameters							\
+	{																\
+		if (!g_bEnabled)											\
+			return name arguments;									\
+		/* Named so as not to hide any of the parameters. */		\
+		UINT64 uTraceStart = Now();									\
+		SNRESULT snrTraced = name arguments;						\
+		UINT64 uTraceEnd = Now();									\
+		Record(TMAPI_TRACE_ID_##name, uTraceStart, uTraceEnd,		\
+			snrTraced, bytes);										\
+		return snrTraced;											\
+	}
+#include "TmapiTraceFunctions.inl"
+#undef TMAPI_TRACE_FUNCTION
+
+void TmapiTraceStart()
+{
+	if (g_bEnabled)
+		return;
+
+	const char* pszPath = getenv(TMAPI_TRACE_ENVIRONMENT);
+	g_strTracePath = pszPath ? pszPath : "";
+	g_bSpans = !g_strTracePath.empty();
+
+	UINT64 uFrequency = GetFrequency();
+	g_fNanosecondsPerTick = uFrequency ? 1e9 / uFrequency : 1.0;
+	g_uStart = Now();
+	g_bEnabled = true;
+}
+
+void TmapiTraceStop()
+{
+	if (!g_bEnabled)
+		return;
+
+	// Called once the command has finished, so no other thread is recording.
+	g_bEnabled = false;
+	UINT64 uWallNs = (UINT64)((Now() - g_uStart) * g_fNanosecondsPerTick);
+
+	PrintSummary(uWallNs);
+
+	if (g_bSpans && !WriteTrace(g_strTracePath.c_str()))
+		fprintf(stderr, "TMAPI: Could not write trace to %s\n", g_strTracePath.c_str());
+
+	ReleaseThreads();
+}
+
+#endif
@@ -0,0 +1,60 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TMAPI_TRACE_H
+#define TMAPI_TRACE_H
+
+#include "ps3tmapi.h"
+
+// TMAPI call tracing. Sources include this header instead of ps3tmapi.h.
+// When built with TMAPI_TRACE defined, every SNPS3* call is redirected to a
+// wrapper that times it and records, per function:
+//
+//   a latency histogram, HdrHistogram in nanoseconds
+//   a count of each result code
+//   bytes moved, for memory and file transfer calls
+//
+// Each thread records into its own histograms, so recording takes no locks.
+// TmapiTraceStop() merges them, prints a summary table to stderr and frees
+// them, so tracing can be started again. If the
+// PS3CTRL_TMAPI_TRACE environment variable names a file, every call is also
+// kept as a span and written there as Chrome trace events, which can be
+// loaded by chrome://tracing.
+//
+// The wrappers and redirects are generated from ps3tmapi.h by
+// Tools/GenerateTmapiTrace.py; without TMAPI_TRACE the calls go straight
+// to TMAPI and the functions below do nothing.
+
+#ifdef TMAPI_TRACE
+
+#define TMAPI_TRACE_FUNCTION(name, parameters, arguments, bytes) TMAPI_TRACE_ID_##name,
+enum TmapiTraceFunction
+{
+#include "TmapiTraceFunctions.inl"
+	TMAPI_TRACE_FUNCTION_COUNT
+};
+#undef TMAPI_TRACE_FUNCTION
+
+#define TMAPI_TRACE_FUNCTION(name, parameters, arguments, bytes) SNRESULT TmapiTrace_##name parameters;
+#include "TmapiTraceFunctions.inl"
+#undef TMAPI_TRACE_FUNCTION
+
+void			TmapiTraceStart();
+void			TmapiTraceStop();
+
+// Defined by TmapiTrace.cpp, which calls the real functions.
+#ifndef TMAPI_TRACE_NO_REDIRECT
+#include "TmapiTraceRedirect.inl"
+#endif
+
+#else
+
+inline void		TmapiTraceStart() {}
+inline void		TmapiTraceStop() {}
+
+#endif
+
+#endif
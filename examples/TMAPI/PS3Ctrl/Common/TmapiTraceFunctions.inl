@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Generated by Tools/GenerateTmapiTrace.py from ps3tmapi.h. Do not edit.
+
+TMAPI_TRACE_FUNCTION(SNPS3TranslateError, (SNRESULT snr, const char **ppszErrorString), (snr, ppszErrorString), (0))
+TMAPI_TRACE_FUNCTION(SNPS3InitTargetComms, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3CloseTargetComms, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ListTargetTypes, (UINT32 *puNumTypes, TMAPI_TARGET_TYPE *pTypes), (puNumTypes, pTypes), (0))
+TMAPI_TRACE_FUNCTION(SNPS3AddTarget, (const char *pszName, const char *pszType, UINT32 uConnParamSize, BYTE *pConnParams, HTARGET *pnTarget), (pszName, pszType, uConnParamSize, pConnParams, pnTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDefaultTarget, (HTARGET *pTarget), (pTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDefaultTarget, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3DeleteTarget, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnumTargets, (TMAPI_EnumTargetsCB pfnCallBack), (pfnCallBack), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnumTargetsEx, (TMAPI_EnumTargetsExCB pfnCallBack, void *pArg), (pfnCallBack, pArg), (0))
+TMAPI_TRACE_FUNCTION(SNPS3PickTarget, (HWND hWndOwner, HTARGET *phTarget), (hWndOwner, phTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Connect, (HTARGET hTarget, const char *pszApplication), (hTarget, pszApplication), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ConnectEx, (HTARGET hTarget, const char *pszApplication, BOOL bForceFlag), (hTarget, pszApplication, bForceFlag), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Disconnect, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ForceDisconnect, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetConnectStatus, (HTARGET hTarget, ECONNECTSTATUS *puConnectStatus, char **ppszUsage), (hTarget, puConnectStatus, ppszUsage), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ListTTYStreams, (HTARGET hTarget, UINT32 *puNumTTYStreams, TTYSTREAM *pStreams), (hTarget, puNumTTYStreams, pStreams), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Kick, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterTTYEvents, (HTARGET hTarget, UINT32 uStream, TMAPI_HandleEventCB pfnCallBack, void *pUserData), (hTarget, uStream, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterTTYEventHandler, (HTARGET hTarget, UINT32 uStream, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, uStream, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3CancelTTYEvents, (HTARGET hTarget, UINT32 uStream), (hTarget, uStream), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SendTTY, (HTARGET hTarget, UINT32 uStream, const char *pszText), (hTarget, uStream, pszText), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterTargetEvents, (HTARGET hTarget, TMAPI_HandleEventCB pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3CancelTargetEvents, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetTargetInfo, (SNPS3TargetInfo *pTargetInfo), (pTargetInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetAPIVersion, (char **ppszVersion), (ppszVersion), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetTMVersion, (char **ppszVersion), (ppszVersion), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetTargetInfo, (SNPS3TargetInfo *pTargetInfo), (pTargetInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetTargetFromName, (const char *pszTgtName, HTARGET *phTarget), (pszTgtName, phTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetNumTargets, (UINT32 *puNumTargets), (puNumTargets), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetStatus, (HTARGET hTarget, UINT32 uUnit, long *pnUnitStatus, long *pnReasonCode), (hTarget, uUnit, pnUnitStatus, pnReasonCode), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Reset, (HTARGET hTarget, UINT64 uReset), (hTarget, uReset), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessLoad, (HTARGET hTarget, UINT32 uPriority, const char *pszFilename, int argc, const char** argv, int envc, const char** envv, UINT32 *puProcessID, UINT64 *puThreadID, UINT32 uDebugFlags), (hTarget, uPriority, pszFilename, argc, argv, envc, envv, puProcessID, puThreadID, uDebugFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessList, (HTARGET hTarget, UINT32 *puCount, UINT32 *puBuffer), (hTarget, puCount, puBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetModuleInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uModuleID, UINT64 *puBufferSize, SNPS3MODULEINFO *pModuleInfo), (hTarget, uProcessID, uModuleID, puBufferSize, pModuleInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetModuleInfoEx, (HTARGET hTarget, UINT32 uProcessID, UINT32 uModuleID, UINT64 *puBufferSize, SNPS3MODULEINFOEX *pModuleInfo, SNPS3MSELFINFO** ppMSELFInfo, SNPS3EXTRAMODULEINFO *pExtraModuleInfo), (hTarget, uProcessID, uModuleID, puBufferSize, pModuleInfo, ppMSELFInfo, pExtraModuleInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetModuleList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *puBuffer), (hTarget, uProcessID, puCount, puBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetConnectionInfo, (HTARGET hTarget, TMAPI_TCPIP_CONNECT_PROP *pConnection), (hTarget, pConnection), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puBufferSize, SNPS3PROCESSINFO *pProcessInfo), (hTarget, uProcessID, puBufferSize, pProcessInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessInfoEx, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puBufferSize, SNPS3PROCESSINFO *pProcessInfo, SNPS3EXTRAPROCESSINFO *pExtra), (hTarget, uProcessID, puBufferSize, pProcessInfo, pExtra), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessInfoEx2, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puBufferSize, SNPS3PROCESSINFO *pProcessInfo, SNPS3EXTRAPROCESSINFO *pExtra, SNPS3PROCESSLOADINFO *pDebug), (hTarget, uProcessID, puBufferSize, pProcessInfo, pExtra, pDebug), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessContinue, (HTARGET hTarget, UINT32 uProcessID), (hTarget, uProcessID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessStop, (HTARGET hTarget, UINT32 uProcessID), (hTarget, uProcessID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessKill, (HTARGET hTarget, UINT32 uProcessID), (hTarget, uProcessID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessGetMemory, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT64 uAddress, int nCount, BYTE *pBuffer), (hTarget, uUnit, uProcessID, uThreadID, uAddress, nCount, pBuffer), (SN_SUCCEEDED(snrTraced) && nCount > 0 ? (UINT64)nCount : 0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessSetMemory, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT64 uAddress, int nCount, const BYTE *pBuffer), (hTarget, uUnit, uProcessID, uThreadID, uAddress, nCount, pBuffer), (SN_SUCCEEDED(snrTraced) && nCount > 0 ? (UINT64)nCount : 0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puNumPPUThreads, UINT64 *pPPUThreadIDs, UINT32 *puNumSPUThreadGroups, UINT64 *pSPUThreadGroupIDs), (hTarget, uProcessID, puNumPPUThreads, pPPUThreadIDs, puNumSPUThreadGroups, pSPUThreadGroupIDs), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSPUThreadGroupInfo, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadGroupID, UINT32 *puBufferSize ,BYTE *pBuffer), (hTarget, uProcessID, uThreadGroupID, puBufferSize, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadInfo, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT32 *puBufferSize, BYTE *pBuffer), (hTarget, uUnit, uProcessID, uThreadID, puBufferSize, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3PPUThreadInfoEx, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadID, UINT32 *puBufferSize, BYTE *pBuffer), (hTarget, uProcessID, uThreadID, puBufferSize, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadContinue, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID), (hTarget, uUnit, uProcessID, uThreadID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadStop, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID), (hTarget, uUnit, uProcessID, uThreadID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadGetRegisters, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT32 uNumRegisters, UINT32 *puNum, BYTE *pRegBuffer), (hTarget, uUnit, uProcessID, uThreadID, uNumRegisters, puNum, pRegBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadSetRegisters, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT32 uNumRegisters, UINT32 *puNum, const BYTE *pRegBuffer), (hTarget, uUnit, uProcessID, uThreadID, uNumRegisters, puNum, pRegBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnableAutoStatusUpdate, (HTARGET hTarget, UINT32 uEnabled, UINT32 *puPrevState), (hTarget, uEnabled, puPrevState), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDefaultPPUThreadStackSize, (HTARGET hTarget, UINT32 uSize), (hTarget, uSize), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDefaultPPUThreadStackSize, (HTARGET hTarget, UINT32 *puSize), (hTarget, puSize), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetPowerStatus, (HTARGET hTarget, long *pnStatus), (hTarget, pnStatus), (0))
+TMAPI_TRACE_FUNCTION(SNPS3PowerOn, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3PowerOff, (HTARGET hTarget, UINT32 uForce), (hTarget, uForce), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ResetEx, (HTARGET hTarget, UINT64 uBoot, UINT64 uBootMask, UINT64 uReset, UINT64 uResetMask, UINT64 uSystem, UINT64 uSystemMask), (hTarget, uBoot, uBootMask, uReset, uResetMask, uSystem, uSystemMask), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetResetParameters, (HTARGET hTarget, UINT64 *puBoot, UINT64 *puBootMask, UINT64 *puReset, UINT64 *puResetMask, UINT64 *puSystem, UINT64 *puSystemMask), (hTarget, puBoot, puBootMask, puReset, puResetMask, puSystem, puSystemMask), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetCurrentBootParameter, (HTARGET hTarget, UINT64 *puBoot), (hTarget, puBoot), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetBootParameter, (HTARGET hTarget, UINT64 uBoot, UINT64 uBootMask), (hTarget, uBoot, uBootMask), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetSystemParameter, (HTARGET hTarget, UINT64 uSystem, UINT64 uSystemMask), (hTarget, uSystem, uSystemMask), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnumerateTargets, (TMAPI_EnumTargetsCallback pfnCallBack), (pfnCallBack), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnumerateTargetsEx, (TMAPI_EnumTargetsExCallback pfnCallBack, void *pArg), (pfnCallBack, pArg), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterTargetEventHandler, (HTARGET hTarget, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterServerEventHandler, (TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterServerEventHandler, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UploadFile, (HTARGET hTarget, const char* pSource, const char* pDestination, UINT32* pTXID), (hTarget, pSource, pDestination, pTXID), (SN_SUCCEEDED(snrTraced) ? TmapiTraceHostFileSize(pSource) : 0))
+TMAPI_TRACE_FUNCTION(SNPS3CancelFileTransfer, (HTARGET hTarget, UINT32 uTXID), (hTarget, uTXID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RetryFileTransfer, (HTARGET hTarget, UINT32 uTXID, UINT32 uForce), (hTarget, uTXID, uForce), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDirectoryList, (HTARGET hTarget, const char* pDirectory, UINT32* puCount, SNPS3DirEntry* pDirectoryList), (hTarget, pDirectory, puCount, pDirectoryList), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDirectoryListEx, (HTARGET hTarget, const char* pDirectory, UINT32* puCount, SNPS3DirEntryEx* pDirectoryList, SNPS3TargetTimezone* pTZ), (hTarget, pDirectory, puCount, pDirectoryList, pTZ), (0))
+TMAPI_TRACE_FUNCTION(SNPS3MakeDirectory, (HTARGET hTarget, const char* pDirectory, UINT32 uMode), (hTarget, pDirectory, uMode), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Rename, (HTARGET hTarget, const char* pSource, const char* pDestination), (hTarget, pSource, pDestination), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterCustomProtocol, (HTARGET hTarget, UINT32 uProtocol, UINT32 uPort, const char* pszLPAR, UINT32 uPriority, SNPS3Protocol *pProto, SNPS3CustomProtocolCallback pfnCallBack, void *pUser), (hTarget, uProtocol, uPort, pszLPAR, uPriority, pProto, pfnCallBack, pUser), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterCustomProtocolEx, (HTARGET hTarget, UINT32 uProtocol, UINT32 uPort, const char* pszLPAR, UINT32 uPriority, SNPS3Protocol *pProto, SNPS3CustomProtocolCallbackEx pfnCallBack, void *pUser), (hTarget, uProtocol, uPort, pszLPAR, uPriority, pProto, pfnCallBack, pUser), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SendCustomProtocolData, (HTARGET hTarget, SNPS3Protocol* pProto, BYTE* pData, UINT32 uLength), (hTarget, pProto, pData, uLength), (SN_SUCCEEDED(snrTraced) ? (UINT64)uLength : 0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterCustomProtocol, (HTARGET hTarget, SNPS3Protocol* pProto), (hTarget, pProto), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ForceUnRegisterCustomProtocol, (HTARGET hTarget, SNPS3Protocol* pProto), (hTarget, pProto), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSyncPrimitiveCounts, (HTARGET hTarget, UINT32 uProcessID, UINT32* pNumMutexes, UINT32* pNumCondVars, UINT32* pNumRWLocks, UINT32* pNumLWMutexes, UINT32* pNumEventQueues, UINT32* pNumSemaphores), (hTarget, uProcessID, pNumMutexes, pNumCondVars, pNumRWLocks, pNumLWMutexes, pNumEventQueues, pNumSemaphores), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMutexList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMutexInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uMutexID, UINT32 *puBufferSize, SNPS3MutexInfo *pInfo), (hTarget, uProcessID, uMutexID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetConditionalVariableList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetConditionalVariableInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uCondVarID, UINT32 *puBufferSize, SNPS3ConditionalInfo *pInfo), (hTarget, uProcessID, uCondVarID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetReadWriteLockList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetReadWriteLockInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uRWLockID, UINT32 *puBufferSize, SNPS3RWLockInfo *pInfo), (hTarget, uProcessID, uRWLockID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetLightWeightMutexList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetLightWeightMutexInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uLWMutexID, UINT32 *puBufferSize, SNPS3LWMutexInfo *pInfo), (hTarget, uProcessID, uLWMutexID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetEventQueueList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetEventQueueInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uEventQueueID, UINT32 *puBufferSize, SNPS3EventQueueInfo *pInfo), (hTarget, uProcessID, uEventQueueID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSemaphoreList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSemaphoreInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uSemaphoreID, UINT32 *puBufferSize, SNPS3SemaphoreInfo *pInfo), (hTarget, uProcessID, uSemaphoreID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetEventFlagList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetEventFlagInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uEventFlagID, UINT32 *puBufferSize, SNPS3EventFlagInfo *pInfo), (hTarget, uProcessID, uEventFlagID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterFTPEventHandler, (HTARGET hTarget, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Delete, (HTARGET hTarget, const char* pPath), (hTarget, pPath), (0))
+TMAPI_TRACE_FUNCTION(SNPS3DeleteEx, (HTARGET hTarget, const char* pPath, const unsigned int nMillisecondTimeout), (hTarget, pPath, nMillisecondTimeout), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSystemInfo, (HTARGET hTarget, UINT32 uReserved, UINT32 *puMask, SNPS3SystemInfo *pInfo), (hTarget, uReserved, puMask, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetExtraLoadFlags, (HTARGET hTarget, UINT64* puExtraLoadFlags), (hTarget, puExtraLoadFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetExtraLoadFlags, (HTARGET hTarget, UINT64 uFlags, UINT64 uMask), (hTarget, uFlags, uMask), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSDKVersion, (HTARGET hTarget, UINT64* puSDKVersion), (hTarget, puSDKVersion), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetCPVersion, (HTARGET hTarget, UINT64* puCPVersion), (hTarget, puCPVersion), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetLightWeightConditionalList, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puCount, UINT32 *pBuffer), (hTarget, uProcessID, puCount, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetLightWeightConditionalInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32 uLWCondVarID, UINT32 *puBufferSize, SNPS3LWConditionalInfo *pInfo), (hTarget, uProcessID, uLWCondVarID, puBufferSize, pInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetUserMemoryStats, (HTARGET hTarget, UINT32 uProcessID, SNPS3UserMemoryStats* pStats), (hTarget, uProcessID, pStats), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetSyncPrimitiveCountsEx, (HTARGET hTarget, UINT32 uProcessID, UINT32* puBufferSize, UINT32* puCounts), (hTarget, uProcessID, puBufferSize, puCounts), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDefaultLoadPriority, (HTARGET hTarget, UINT32 uPriority), (hTarget, uPriority), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDefaultLoadPriority, (HTARGET hTarget, UINT32* pPriority), (hTarget, pPriority), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetGamePortIPAddrData, (HTARGET hTarget, const char* szDeviceName, SNPS3GamePortIPAddressData* pData), (hTarget, szDeviceName, pData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetGamePortDebugIPAddrData, (HTARGET hTarget, const char* szDeviceName, SNPS3GamePortIPAddressData* pData), (hTarget, szDeviceName, pData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SPUThreadGroupContinue, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadGroupID), (hTarget, uProcessID, uThreadGroupID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3DownloadFile, (HTARGET hTarget, const char* pSource, const char* pDest, UINT32* pTXID), (hTarget, pSource, pDest, pTXID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3DownloadDirectory, (HTARGET hTarget, const char* pSource, const char* pDest, UINT32* pLastTXID), (hTarget, pSource, pDest, pLastTXID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3CancelFTPEvents, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StatTargetFile, (HTARGET hTarget, const char* pFile, SNPS3DirEntry* pEntry), (hTarget, pFile, pEntry), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StatTargetFileEx, (HTARGET hTarget, const char* pFile, SNPS3DirEntryEx* pEntry, SNPS3TargetTimezone* pTZ), (hTarget, pFile, pEntry, pTZ), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UploadDirectory, (HTARGET hTarget, const char* pSource, const char* pDestination, UINT32* pLastTXID), (hTarget, pSource, pDestination, pLastTXID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3TerminateGameProcess, (HTARGET hTarget, UINT32 uProcessID, UINT32 uTimeout), (hTarget, uProcessID, uTimeout), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetProcessTree, (HTARGET hTarget, UINT32 *puProcessCount, SNPS3ProcessTreeBranch *pProcessTree), (hTarget, puProcessCount, pProcessTree), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMacAddress, (HTARGET hTarget, char **ppszMacAddress), (hTarget, ppszMacAddress), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetTimeouts, (HTARGET hTarget, UINT32 uNoTimeouts, SNPS3_TM_TIMEOUT *pTimeoutIDs, UINT32 *puTimeoutValues), (hTarget, uNoTimeouts, pTimeoutIDs, puTimeoutValues), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetTimeouts, (HTARGET hTarget, UINT32 *puNoTimeouts, SNPS3_TM_TIMEOUT *auTimeoutIDs, UINT32 *auTimeoutValues), (hTarget, puNoTimeouts, auTimeoutIDs, auTimeoutValues), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetCoreDumpFlags, (HTARGET hTarget, UINT64 *pu64Flags), (hTarget, pu64Flags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetCoreDumpFlags, (HTARGET hTarget, UINT64 u64Flags), (hTarget, u64Flags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetConnectionInfo, (HTARGET hTarget, TMAPI_TCPIP_CONNECT_PROP *pConnection), (hTarget, pConnection), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SPUThreadGroupStop, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadGroupID), (hTarget, uProcessID, uThreadGroupID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetCaseSensitiveFileServing, (HTARGET hTarget, BOOL bOn, BOOL *pbOldSetting), (hTarget, bOn, pbOldSetting), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetFileServingEventFlags, (HTARGET hTarget, UINT64 uFileServingEventFlags), (hTarget, uFileServingEventFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetFileServingEventFlags, (HTARGET hTarget, UINT64 *puFileServingEventFlags), (hTarget, puFileServingEventFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetVirtualMemoryInfo, (HTARGET hTarget, UINT32 uPID, BOOL bStatsOnly, UINT32 *puAreaCount, UINT32 *puBufferSize, BYTE *pBuffer), (hTarget, uPID, bStatsOnly, puAreaCount, puBufferSize, pBuffer), (SN_SUCCEEDED(snrTraced) && pBuffer && puBufferSize ? (UINT64)*puBufferSize : 0))
+TMAPI_TRACE_FUNCTION(SNPS3FlashTarget, (HTARGET hTarget, const char* pszUpdaterTool, const char* pszFlashImage), (hTarget, pszUpdaterTool, pszFlashImage), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetSPULoopPoint, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadID, UINT32 uAddress, BOOL bCurrentPC), (hTarget, uProcessID, uThreadID, uAddress, bCurrentPC), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ClearSPULoopPoint, (HTARGET hTarget, UINT32 uProcessID, UINT64 uThreadID, UINT32 uAddress, BOOL bCurrentPC), (hTarget, uProcessID, uThreadID, uAddress, bCurrentPC), (0))
+TMAPI_TRACE_FUNCTION(SNPS3TriggerCoreDump, (HTARGET hTarget, UINT32 uProcessID, UINT64 uUserData1, UINT64 uUserData2, UINT64 uUserData3), (hTarget, uProcessID, uUserData1, uUserData2, uUserData3), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetVRAMInformation, (HTARGET hTarget, UINT32 uProcessID, SNPS3VRAMInfo *pPrimary, SNPS3VRAMInfo *pSecondary), (hTarget, uProcessID, pPrimary, pSecondary), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDABR, (HTARGET hTarget, UINT32 uProcessID, UINT64 uAddr), (hTarget, uProcessID, uAddr), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDABR, (HTARGET hTarget, UINT32 uProcessID, UINT64 *puAddr), (hTarget, uProcessID, puAddr), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetErrorQualifier, (UINT32 *pQualifier, char **ppszErrorString), (pQualifier, ppszErrorString), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMemoryCompressed, (HTARGET hTarget, UINT32 uProcessID, UINT32 uLevel, UINT32 uAddr, UINT32 uSize, BYTE* pBuffer), (hTarget, uProcessID, uLevel, uAddr, uSize, pBuffer), (SN_SUCCEEDED(snrTraced) ? (UINT64)uSize : 0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMemory64Compressed, (HTARGET hTarget, UINT32 uProcessID, UINT32 uLevel, UINT64 uAddr, UINT32 uSize, BYTE* pBuffer), (hTarget, uProcessID, uLevel, uAddr, uSize, pBuffer), (SN_SUCCEEDED(snrTraced) ? (UINT64)uSize : 0))
+TMAPI_TRACE_FUNCTION(SNPS3SetBreakPoint, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT64 uAddress), (hTarget, uUnit, uProcessID, uThreadID, uAddress), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ClearBreakPoint, (HTARGET hTarget, UINT32 uUnit, UINT32 uProcessID, UINT64 uThreadID, UINT64 uAddress), (hTarget, uUnit, uProcessID, uThreadID, uAddress), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetBreakPoints, (HTARGET hTarget, UINT32 uUnit, UINT32 uPID, UINT64 u64TID, UINT32 *puBPCount, UINT64 *au64BPAddress), (hTarget, uUnit, uPID, u64TID, puBPCount, au64BPAddress), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetDebugThreadControlInfo, (HTARGET hTarget, UINT32 uProcessID, UINT32* puBufferSize, SNPS3DebugThreadControlInfo* pBuffer), (hTarget, uProcessID, puBufferSize, pBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDebugThreadControlInfo, (HTARGET hTarget, UINT32 uProcessID, SNPS3DebugThreadControlInfo* pInfo, UINT32 *puMaxEntries), (hTarget, uProcessID, pInfo, puMaxEntries), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessAttach, (HTARGET hTarget, UINT32 uUnitID, UINT32 uProcessID), (hTarget, uUnitID, uProcessID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetMATConditions, (HTARGET hTarget, UINT32 uProcessID, UINT32 uRangeCount, UINT32 uBufSize, BYTE *pBuf), (hTarget, uProcessID, uRangeCount, uBufSize, pBuf), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMATRanges, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puRangeCount, BYTE *pBuf), (hTarget, uProcessID, puRangeCount, pBuf), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMATConditions, (HTARGET hTarget, UINT32 uProcessID, UINT32 *puRangeCount, BYTE *pRanges, UINT32 *puBufSize, BYTE *pBuf), (hTarget, uProcessID, puRangeCount, pRanges, puBufSize, pBuf), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetMATRangePointers, (UINT32 uRangeCount, BYTE *pBuf, SNPS3MATRange **ppRanges), (uRangeCount, pBuf, ppRanges), (0))
+TMAPI_TRACE_FUNCTION(SNPS3Exit, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ExitEx, (const UINT32 nMillisecondTimeout), (nMillisecondTimeout), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SaveSettings, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetRawSPULogicalIDs, (HTARGET hTarget, UINT32 uProcessID, UINT64 *pu64LogicalIDs), (hTarget, uProcessID, pu64LogicalIDs), (0))
+TMAPI_TRACE_FUNCTION(SNPS3FootswitchControl, (HTARGET hTarget, UINT32 uEnabled), (hTarget, uEnabled), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StartFileTrace, (HTARGET hTarget, UINT32 uPID, UINT32 uSize, const char *pszFileName), (hTarget, uPID, uSize, pszFileName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StopFileTrace, (HTARGET hTarget, UINT32 uPID), (hTarget, uPID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StartPadCapture, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StopPadCapture, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StartPadPlayback, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StopPadPlayback, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterPadCaptureHandler, (HTARGET hTarget, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterPadCaptureHandler, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SendPadPlaybackData, (HTARGET hTarget, SNPS3PadData* pData), (hTarget, pData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterPadPlaybackNotificationHandler, (HTARGET hTarget, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterPadPlaybackNotificationHandler, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ClearTTYCache, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessOfflineFileTrace, (HTARGET hTarget, const char* pszPath), (hTarget, pszPath), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterFileTraceHandler, (HTARGET hTarget, TMAPI_HandleEventCallback pfnCallBack, void *pUserData), (hTarget, pfnCallBack, pUserData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterFileTraceHandler, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UserProcessList, (HTARGET hTarget, UINT32 *puCount, UINT32 *puBuffer), (hTarget, puCount, puBuffer), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessScatteredSetMemory, (HTARGET hTarget, UINT32 uPID, UINT32 uNumWrites, UINT32 uWriteSize, SNPS3ScatteredWrite *pWrites, UINT32 *puErrorCode, UINT32 *puFailedAddress), (hTarget, uPID, uNumWrites, uWriteSize, pWrites, puErrorCode, puFailedAddress), (SN_SUCCEEDED(snrTraced) ? (UINT64)uNumWrites * uWriteSize : 0))
+TMAPI_TRACE_FUNCTION(SNPS3SetRSXProfilingFlags, (HTARGET hTarget, UINT64 uRSXFlags), (hTarget, uRSXFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetRSXProfilingFlags, (HTARGET hTarget, UINT64 * puRSXFlags), (hTarget, puRSXFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetVRAMCaptureFlags, (HTARGET hTarget, UINT64 uVRAMFlags), (hTarget, uVRAMFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetVRAMCaptureFlags, (HTARGET hTarget, UINT64 * puVRAMFlags), (hTarget, puVRAMFlags), (0))
+TMAPI_TRACE_FUNCTION(SNPS3VRAMCapture, (HTARGET hTarget, UINT32 uPID, SNPS3VRAMInfo *pVRAMInfo, const char *czpFileName), (hTarget, uPID, pVRAMInfo, czpFileName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnableVRAMCapture, (HTARGET hTarget), (hTarget), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ThreadExceptionClean, (HTARGET hTarget, UINT32 uPID, UINT64 uTID), (hTarget, uPID, uTID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetFileTransferInfo, (HTARGET hTarget, const UINT32 uTXID, SNPS3Transfer *pTransferInfo), (hTarget, uTXID, pTransferInfo), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetFileTransferList, (HTARGET hTarget, UINT32 *puCount, SNPS3Transfer * pTransferList), (hTarget, puCount, pTransferList), (0))
+TMAPI_TRACE_FUNCTION(SNPS3InstallGame, (HTARGET hTarget, const char *pszPath), (hTarget, pszPath), (0))
+TMAPI_TRACE_FUNCTION(SNPS3InstallGameEx, (HTARGET hTarget, const char *pszPath, char **pszTitleId, char **pszTargetPath, UINT32* puTXID), (hTarget, pszPath, pszTitleId, pszTargetPath, puTXID), (0))
+TMAPI_TRACE_FUNCTION(SNPS3InstallPackage, (HTARGET hTarget, const char *pszPkgPath), (hTarget, pszPkgPath), (0))
+TMAPI_TRACE_FUNCTION(SNPS3WaitForFileTransfer, (HTARGET hTarget, const UINT32 uTXID, TMAPI_FT_NOTIFY *pFTValue, const UINT32 nMillisecondTimeout), (hTarget, uTXID, pFTValue, nMillisecondTimeout), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RemoveTransferItemsByStatus, (HTARGET hTarget, UINT32 filter), (hTarget, filter), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UninstallGame, (HTARGET hTarget, const char *pszTitleId), (hTarget, pszTitleId), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UninstallGameEx, (HTARGET hTarget, const char *pszTitleId, UINT timeoutMs), (hTarget, pszTitleId, timeoutMs), (0))
+TMAPI_TRACE_FUNCTION(SNPS3CHMod, (HTARGET hTarget, const char *pszFilePath, UINT32 uMode), (hTarget, pszFilePath, uMode), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetFileTime, (HTARGET hTarget, const char *pszFilePath, UINT64 uActTimeT, UINT64 uModTimeT), (hTarget, pszFilePath, uActTimeT, uModTimeT), (0))
+TMAPI_TRACE_FUNCTION(SNPS3FSGetFreeSize, (HTARGET hTarget, const char *fileSystemDir, UINT32* pBlockSize, UINT64* pFreeBlockCount), (hTarget, fileSystemDir, pBlockSize, pFreeBlockCount), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetXMBSettings, (HTARGET hTarget, char *pSettings, UINT *puSize, BOOL bUpdateCache), (hTarget, pSettings, puSize, bUpdateCache), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetXMBSettings, (HTARGET hTarget, const char *pSettings, BOOL bResetAfter), (hTarget, pSettings, bResetAfter), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnableXMBSettings, (HTARGET hTarget, BOOL bEnable), (hTarget, bEnable), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetCustomParamSFOMappingDirectory, (HTARGET hTarget, const char *pParamSfoPath), (hTarget, pParamSfoPath), (0))
+TMAPI_TRACE_FUNCTION(SNPS3FormatHDD, (HTARGET hTarget, UINT32 initRegistry), (hTarget, initRegistry), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetLogOptions, (TMAPI_LOG_CATEGORY categories), (categories), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetLogOptions, (TMAPI_LOG_CATEGORY* categories), (categories), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessGetTestParam, (HTARGET hTarget, BYTE *pResult, BYTE* paData), (hTarget, pResult, paData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ProcessSetTestParam, (HTARGET hTarget, BYTE *pResult, BYTE* paData), (hTarget, pResult, paData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3EnableInternalKick, (BOOL bEnable), (bEnable), (0))
+TMAPI_TRACE_FUNCTION(SNPS3RegisterIdleWorker, (TMAPI_IdleWorker pfnIdleWorkerCallback, void* pData), (pfnIdleWorkerCallback, pData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnRegisterIdleWorker, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3BDTransferImage, (HTARGET hTarget, const char* pszSourceFileName, const char* pszDestinationDevice, UINT32* puTransferId), (hTarget, pszSourceFileName, pszDestinationDevice, puTransferId), (SN_SUCCEEDED(snrTraced) ? TmapiTraceHostFileSize(pszSourceFileName) : 0))
+TMAPI_TRACE_FUNCTION(SNPS3BDInsert, (HTARGET hTarget, const char* pszDeviceName), (hTarget, pszDeviceName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3BDEject, (HTARGET hTarget, const char* pszDeviceName), (hTarget, pszDeviceName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3BDFormat, (HTARGET hTarget, const char* pszDeviceName, UINT32 uFormatMode), (hTarget, pszDeviceName, uFormatMode), (0))
+TMAPI_TRACE_FUNCTION(SNPS3BDQuery, (HTARGET hTarget, const char* pszDeviceName, SNPS3_BD_QUERY_DATA * pData), (hTarget, pszDeviceName, pData), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SearchForTargets, (const char* szIpAddressFrom, const char* szIpAddressTo, TMAPI_SearchTargetsCallback pfnCallback, void* pUserData, int nPort), (szIpAddressFrom, szIpAddressTo, pfnCallback, pUserData, nPort), (0))
+TMAPI_TRACE_FUNCTION(SNPS3StopSearchForTargets, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3IsScanning, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3IsValidResolution, (UINT32 uMonitorType, UINT32 uStartupResolution), (uMonitorType, uStartupResolution), (0))
+TMAPI_TRACE_FUNCTION(SNPS3SetDisplaySettings, (HTARGET hTarget, const char* szExecutable, UINT32 uMonitorType, UINT32 uConnectorType, UINT32 uStartupResolution, bool bHDCP, bool bResetAfter), (hTarget, szExecutable, uMonitorType, uConnectorType, uStartupResolution, bHDCP, bResetAfter), (0))
+TMAPI_TRACE_FUNCTION(SNPS3MapFileSystem, (char driveLetter), (driveLetter), (0))
+TMAPI_TRACE_FUNCTION(SNPS3UnmapFileSystem, (), (), (0))
+TMAPI_TRACE_FUNCTION(SNPS3GetFileSystem, (char* driveLetter), (driveLetter), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ImportTargetSettings, (HTARGET hTarget, const char* szFileName), (hTarget, szFileName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ExportTargetSettings, (HTARGET hTarget, const char* szFileName), (hTarget, szFileName), (0))
+TMAPI_TRACE_FUNCTION(SNPS3ExtractGameParameter, (const char* szFileName, const char* szKey, UINT32* puBufferSize, BYTE* pBuffer), (szFileName, szKey, puBufferSize, pBuffer), (0))
@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Generated by Tools/GenerateTmapiTrace.py from ps3tmapi.h. Do not edit.
+
+#define SNPS3TranslateError TmapiTrace_SNPS3TranslateError
+#define SNPS3InitTargetComms TmapiTrace_SNPS3InitTargetComms
+#define SNPS3CloseTargetComms TmapiTrace_SNPS3CloseTargetComms
+#define SNPS3ListTargetTypes TmapiTrace_SNPS3ListTargetTypes
+#define SNPS3AddTarget TmapiTrace_SNPS3AddTarget
+#define SNPS3GetDefaultTarget TmapiTrace_SNPS3GetDefaultTarget
+#define SNPS3SetDefaultTarget TmapiTrace_SNPS3SetDefaultTarget
+#define SNPS3DeleteTarget TmapiTrace_SNPS3DeleteTarget
+#define SNPS3EnumTargets TmapiTrace_SNPS3EnumTargets
+#define SNPS3EnumTargetsEx TmapiTrace_SNPS3EnumTargetsEx
+#define SNPS3PickTarget TmapiTrace_SNPS3PickTarget
+#define SNPS3Connect TmapiTrace_SNPS3Connect
+#define SNPS3ConnectEx TmapiTrace_SNPS3ConnectEx
+#define SNPS3Disconnect TmapiTrace_SNPS3Disconnect
+#define SNPS3ForceDisconnect TmapiTrace_SNPS3ForceDisconnect
+#define SNPS3GetConnectStatus TmapiTrace_SNPS3GetConnectStatus
+#define SNPS3ListTTYStreams TmapiTrace_SNPS3ListTTYStreams
+#define SNPS3Kick TmapiTrace_SNPS3Kick
+#define SNPS3RegisterTTYEvents TmapiTrace_SNPS3RegisterTTYEvents
+#define SNPS3RegisterTTYEventHandler TmapiTrace_SNPS3RegisterTTYEventHandler
+#define SNPS3CancelTTYEvents TmapiTrace_SNPS3CancelTTYEvents
+#define SNPS3SendTTY TmapiTrace_SNPS3SendTTY
+#define SNPS3RegisterTargetEvents TmapiTrace_SNPS3RegisterTargetEvents
+#define SNPS3CancelTargetEvents TmapiTrace_SNPS3CancelTargetEvents
+#define SNPS3GetTargetInfo TmapiTrace_SNPS3GetTargetInfo
+#define SNPS3GetAPIVersion TmapiTrace_SNPS3GetAPIVersion
+#define SNPS3GetTMVersion TmapiTrace_SNPS3GetTMVersion
+#define SNPS3SetTargetInfo TmapiTrace_SNPS3SetTargetInfo
+#define SNPS3GetTargetFromName TmapiTrace_SNPS3GetTargetFromName
+#define SNPS3GetNumTargets TmapiTrace_SNPS3GetNumTargets
+#define SNPS3GetStatus TmapiTrace_SNPS3GetStatus
+#define SNPS3Reset TmapiTrace_SNPS3Reset
+#define SNPS3ProcessLoad TmapiTrace_SNPS3ProcessLoad
+#define SNPS3ProcessList TmapiTrace_SNPS3ProcessList
+#define SNPS3GetModuleInfo TmapiTrace_SNPS3GetModuleInfo
+#define SNPS3GetModuleInfoEx TmapiTrace_SNPS3GetModuleInfoEx
+#define SNPS3GetModuleList TmapiTrace_SNPS3GetModuleList
+#define SNPS3GetConnectionInfo TmapiTrace_SNPS3GetConnectionInfo
+#define SNPS3ProcessInfo TmapiTrace_SNPS3ProcessInfo
+#define SNPS3ProcessInfoEx TmapiTrace_SNPS3ProcessInfoEx
+#define SNPS3ProcessInfoEx2 TmapiTrace_SNPS3ProcessInfoEx2
+#define SNPS3ProcessContinue TmapiTrace_SNPS3ProcessContinue
+#define SNPS3ProcessStop TmapiTrace_SNPS3ProcessStop
+#define SNPS3ProcessKill TmapiTrace_SNPS3ProcessKill
+#define SNPS3ProcessGetMemory TmapiTrace_SNPS3ProcessGetMemory
+#define SNPS3ProcessSetMemory TmapiTrace_SNPS3ProcessSetMemory
+#define SNPS3ThreadList TmapiTrace_SNPS3ThreadList
+#define SNPS3GetSPUThreadGroupInfo TmapiTrace_SNPS3GetSPUThreadGroupInfo
+#define SNPS3ThreadInfo TmapiTrace_SNPS3ThreadInfo
+#define SNPS3PPUThreadInfoEx TmapiTrace_SNPS3PPUThreadInfoEx
+#define SNPS3ThreadContinue TmapiTrace_SNPS3ThreadContinue
+#define SNPS3ThreadStop TmapiTrace_SNPS3ThreadStop
+#define SNPS3ThreadGetRegisters TmapiTrace_SNPS3ThreadGetRegisters
+#define SNPS3ThreadSetRegisters TmapiTrace_SNPS3ThreadSetRegisters
+#define SNPS3EnableAutoStatusUpdate TmapiTrace_SNPS3EnableAutoStatusUpdate
+#define SNPS3SetDefaultPPUThreadStackSize TmapiTrace_SNPS3SetDefaultPPUThreadStackSize
+#define SNPS3GetDefaultPPUThreadStackSize TmapiTrace_SNPS3GetDefaultPPUThreadStackSize
+#define SNPS3GetPowerStatus TmapiTrace_SNPS3GetPowerStatus
+#define SNPS3PowerOn TmapiTrace_SNPS3PowerOn
+#define SNPS3PowerOff TmapiTrace_SNPS3PowerOff
+#define SNPS3ResetEx TmapiTrace_SNPS3ResetEx
+#define SNPS3GetResetParameters TmapiTrace_SNPS3GetResetParameters
+#define SNPS3GetCurrentBootParameter TmapiTrace_SNPS3GetCurrentBootParameter
+#define SNPS3SetBootParameter TmapiTrace_SNPS3SetBootParameter
+#define SNPS3SetSystemParameter TmapiTrace_SNPS3SetSystemParameter
+#define SNPS3EnumerateTargets TmapiTrace_SNPS3EnumerateTargets
+#define SNPS3EnumerateTargetsEx TmapiTrace_SNPS3EnumerateTargetsEx
+#define SNPS3RegisterTargetEventHandler TmapiTrace_SNPS3RegisterTargetEventHandler
+#define SNPS3RegisterServerEventHandler TmapiTrace_SNPS3RegisterServerEventHandler
+#define SNPS3UnRegisterServerEventHandler TmapiTrace_SNPS3UnRegisterServerEventHandler
+#define SNPS3UploadFile TmapiTrace_SNPS3UploadFile
+#define SNPS3CancelFileTransfer TmapiTrace_SNPS3CancelFileTransfer
+#define SNPS3RetryFileTransfer TmapiTrace_SNPS3RetryFileTransfer
+#define SNPS3GetDirectoryList TmapiTrace_SNPS3GetDirectoryList
+#define SNPS3GetDirectoryListEx TmapiTrace_SNPS3GetDirectoryListEx
+#define SNPS3MakeDirectory TmapiTrace_SNPS3MakeDirectory
+#define SNPS3Rename TmapiTrace_SNPS3Rename
+#define SNPS3RegisterCustomProtocol TmapiTrace_SNPS3RegisterCustomProtocol
+#define SNPS3RegisterCustomProtocolEx TmapiTrace_SNPS3RegisterCustomProtocolEx
+#define SNPS3SendCustomProtocolData TmapiTrace_SNPS3SendCustomProtocolData
+#define SNPS3UnRegisterCustomProtocol TmapiTrace_SNPS3UnRegisterCustomProtocol
+#define SNPS3ForceUnRegisterCustomProtocol TmapiTrace_SNPS3ForceUnRegisterCustomProtocol
+#define SNPS3GetSyncPrimitiveCounts TmapiTrace_SNPS3GetSyncPrimitiveCounts
+#define SNPS3GetMutexList TmapiTrace_SNPS3GetMutexList
+#define SNPS3GetMutexInfo TmapiTrace_SNPS3GetMutexInfo
+#define SNPS3GetConditionalVariableList TmapiTrace_SNPS3GetConditionalVariableList
+#define SNPS3GetConditionalVariableInfo TmapiTrace_SNPS3GetConditionalVariableInfo
+#define SNPS3GetReadWriteLockList TmapiTrace_SNPS3GetReadWriteLockList
+#define SNPS3GetReadWriteLockInfo TmapiTrace_SNPS3GetReadWriteLockInfo
+#define SNPS3GetLightWeightMutexList TmapiTrace_SNPS3GetLightWeightMutexList
+#define SNPS3GetLightWeightMutexInfo TmapiTrace_SNPS3GetLightWeightMutexInfo
+#define SNPS3GetEventQueueList TmapiTrace_SNPS3GetEventQueueList
+#define SNPS3GetEventQueueInfo TmapiTrace_SNPS3GetEventQueueInfo
+#define SNPS3GetSemaphoreList TmapiTrace_SNPS3GetSemaphoreList
+#define SNPS3GetSemaphoreInfo TmapiTrace_SNPS3GetSemaphoreInfo
+#define SNPS3GetEventFlagList TmapiTrace_SNPS3GetEventFlagList
+#define SNPS3GetEventFlagInfo TmapiTrace_SNPS3GetEventFlagInfo
+#define SNPS3RegisterFTPEventHandler TmapiTrace_SNPS3RegisterFTPEventHandler
+#define SNPS3Delete TmapiTrace_SNPS3Delete
+#define SNPS3DeleteEx TmapiTrace_SNPS3DeleteEx
+#define SNPS3GetSystemInfo TmapiTrace_SNPS3GetSystemInfo
+#define SNPS3GetExtraLoadFlags TmapiTrace_SNPS3GetExtraLoadFlags
+#define SNPS3SetExtraLoadFlags TmapiTrace_SNPS3SetExtraLoadFlags
+#define SNPS3GetSDKVersion TmapiTrace_SNPS3GetSDKVersion
+#define SNPS3GetCPVersion TmapiTrace_SNPS3GetCPVersion
+#define SNPS3GetLightWeightConditionalList TmapiTrace_SNPS3GetLightWeightConditionalList
+#define SNPS3GetLightWeightConditionalInfo TmapiTrace_SNPS3GetLightWeightConditionalInfo
+#define SNPS3GetUserMemoryStats TmapiTrace_SNPS3GetUserMemoryStats
+#define SNPS3GetSyncPrimitiveCountsEx TmapiTrace_SNPS3GetSyncPrimitiveCountsEx
+#define SNPS3SetDefaultLoadPriority TmapiTrace_SNPS3SetDefaultLoadPriority
+#define SNPS3GetDefaultLoadPriority TmapiTrace_SNPS3GetDefaultLoadPriority
+#define SNPS3GetGamePortIPAddrData TmapiTrace_SNPS3GetGamePortIPAddrData
+#define SNPS3GetGamePortDebugIPAddrData TmapiTrace_SNPS3GetGamePortDebugIPAddrData
+#define SNPS3SPUThreadGroupContinue TmapiTrace_SNPS3SPUThreadGroupContinue
+#define SNPS3DownloadFile TmapiTrace_SNPS3DownloadFile
+#define SNPS3DownloadDirectory TmapiTrace_SNPS3DownloadDirectory
+#define SNPS3CancelFTPEvents TmapiTrace_SNPS3CancelFTPEvents
+#define SNPS3StatTargetFile TmapiTrace_SNPS3StatTargetFile
+#define SNPS3StatTargetFileEx TmapiTrace_SNPS3StatTargetFileEx
+#define SNPS3UploadDirectory TmapiTrace_SNPS3UploadDirectory
+#define SNPS3TerminateGameProcess TmapiTrace_SNPS3TerminateGameProcess
+#define SNPS3GetProcessTree TmapiTrace_SNPS3GetProcessTree
+#define SNPS3GetMacAddress TmapiTrace_SNPS3GetMacAddress
+#define SNPS3SetTimeouts TmapiTrace_SNPS3SetTimeouts
+#define SNPS3GetTimeouts TmapiTrace_SNPS3GetTimeouts
+#define SNPS3GetCoreDumpFlags TmapiTrace_SNPS3GetCoreDumpFlags
+#define SNPS3SetCoreDumpFlags TmapiTrace_SNPS3SetCoreDumpFlags
+#define SNPS3SetConnectionInfo TmapiTrace_SNPS3SetConnectionInfo
+#define SNPS3SPUThreadGroupStop TmapiTrace_SNPS3SPUThreadGroupStop
+#define SNPS3SetCaseSensitiveFileServing TmapiTrace_SNPS3SetCaseSensitiveFileServing
+#define SNPS3SetFileServingEventFlags TmapiTrace_SNPS3SetFileServingEventFlags
+#define SNPS3GetFileServingEventFlags TmapiTrace_SNPS3GetFileServingEventFlags
+#define SNPS3GetVirtualMemoryInfo TmapiTrace_SNPS3GetVirtualMemoryInfo
+#define SNPS3FlashTarget TmapiTrace_SNPS3FlashTarget
+#define SNPS3SetSPULoopPoint TmapiTrace_SNPS3SetSPULoopPoint
+#define SNPS3ClearSPULoopPoint TmapiTrace_SNPS3ClearSPULoopPoint
+#define SNPS3TriggerCoreDump TmapiTrace_SNPS3TriggerCoreDump
+#define SNPS3GetVRAMInformation TmapiTrace_SNPS3GetVRAMInformation
+#define SNPS3SetDABR TmapiTrace_SNPS3SetDABR
+#define SNPS3GetDABR TmapiTrace_SNPS3GetDABR
+#define SNPS3GetErrorQualifier TmapiTrace_SNPS3GetErrorQualifier
+#define SNPS3GetMemoryCompressed TmapiTrace_SNPS3GetMemoryCompressed
+#define SNPS3GetMemory64Compressed TmapiTrace_SNPS3GetMemory64Compressed
+#define SNPS3SetBreakPoint TmapiTrace_SNPS3SetBreakPoint
+#define SNPS3ClearBreakPoint TmapiTrace_SNPS3ClearBreakPoint
+#define SNPS3GetBreakPoints TmapiTrace_SNPS3GetBreakPoints
+#define SNPS3GetDebugThreadControlInfo TmapiTrace_SNPS3GetDebugThreadControlInfo
+#define SNPS3SetDebugThreadControlInfo TmapiTrace_SNPS3SetDebugThreadControlInfo
+#define SNPS3ProcessAttach TmapiTrace_SNPS3ProcessAttach
+#define SNPS3SetMATConditions TmapiTrace_SNPS3SetMATConditions
+#define SNPS3GetMATRanges TmapiTrace_SNPS3GetMATRanges
+#define SNPS3GetMATConditions TmapiTrace_SNPS3GetMATConditions
+#define SNPS3GetMATRangePointers TmapiTrace_SNPS3GetMATRangePointers
+#define SNPS3Exit TmapiTrace_SNPS3Exit
+#define SNPS3ExitEx TmapiTrace_SNPS3ExitEx
+#define SNPS3SaveSettings TmapiTrace_SNPS3SaveSettings
+#define SNPS3GetRawSPULogicalIDs TmapiTrace_SNPS3GetRawSPULogicalIDs
+#define SNPS3FootswitchControl TmapiTrace_SNPS3FootswitchControl
+#define SNPS3StartFileTrace TmapiTrace_SNPS3StartFileTrace
+#define SNPS3StopFileTrace TmapiTrace_SNPS3StopFileTrace
+#define SNPS3StartPadCapture TmapiTrace_SNPS3StartPadCapture
+#define SNPS3StopPadCapture TmapiTrace_SNPS3StopPadCapture
+#define SNPS3StartPadPlayback TmapiTrace_SNPS3StartPadPlayback
+#define SNPS3StopPadPlayback TmapiTrace_SNPS3StopPadPlayback
+#define SNPS3RegisterPadCaptureHandler TmapiTrace_SNPS3RegisterPadCaptureHandler
+#define SNPS3UnRegisterPadCaptureHandler TmapiTrace_SNPS3UnRegisterPadCaptureHandler
+#define SNPS3SendPadPlaybackData TmapiTrace_SNPS3SendPadPlaybackData
+#define SNPS3RegisterPadPlaybackNotificationHandler TmapiTrace_SNPS3RegisterPadPlaybackNotificationHandler
+#define SNPS3UnRegisterPadPlaybackNotificationHandler TmapiTrace_SNPS3UnRegisterPadPlaybackNotificationHandler
+#define SNPS3ClearTTYCache TmapiTrace_SNPS3ClearTTYCache
+#define SNPS3ProcessOfflineFileTrace TmapiTrace_SNPS3ProcessOfflineFileTrace
+#define SNPS3RegisterFileTraceHandler TmapiTrace_SNPS3RegisterFileTraceHandler
+#define SNPS3UnRegisterFileTraceHandler TmapiTrace_SNPS3UnRegisterFileTraceHandler
+#define SNPS3UserProcessList TmapiTrace_SNPS3UserProcessList
+#define SNPS3ProcessScatteredSetMemory TmapiTrace_SNPS3ProcessScatteredSetMemory
+#define SNPS3SetRSXProfilingFlags TmapiTrace_SNPS3SetRSXProfilingFlags
+#define SNPS3GetRSXProfilingFlags TmapiTrace_SNPS3GetRSXProfilingFlags
+#define SNPS3SetVRAMCaptureFlags TmapiTrace_SNPS3SetVRAMCaptureFlags
+#define SNPS3GetVRAMCaptureFlags TmapiTrace_SNPS3GetVRAMCaptureFlags
+#define SNPS3VRAMCapture TmapiTrace_SNPS3VRAMCapture
+#define SNPS3EnableVRAMCapture TmapiTrace_SNPS3EnableVRAMCapture
+#define SNPS3ThreadExceptionClean TmapiTrace_SNPS3ThreadExceptionClean
+#define SNPS3GetFileTransferInfo TmapiTrace_SNPS3GetFileTransferInfo
+#define SNPS3GetFileTransferList TmapiTrace_SNPS3GetFileTransferList
+#define SNPS3InstallGame TmapiTrace_SNPS3InstallGame
+#define SNPS3InstallGameEx TmapiTrace_SNPS3InstallGameEx
+#define SNPS3InstallPackage TmapiTrace_SNPS3InstallPackage
+#define SNPS3WaitForFileTransfer TmapiTrace_SNPS3WaitForFileTransfer
+#define SNPS3RemoveTransferItemsByStatus TmapiTrace_SNPS3RemoveTransferItemsByStatus
+#define SNPS3UninstallGame TmapiTrace_SNPS3UninstallGame
+#define SNPS3UninstallGameEx TmapiTrace_SNPS3UninstallGameEx
+#define SNPS3CHMod TmapiTrace_SNPS3CHMod
+#define SNPS3SetFileTime TmapiTrace_SNPS3SetFileTime
+#define SNPS3FSGetFreeSize TmapiTrace_SNPS3FSGetFreeSize
+#define SNPS3GetXMBSettings TmapiTrace_SNPS3GetXMBSettings
+#define SNPS3SetXMBSettings TmapiTrace_SNPS3SetXMBSettings
+#define SNPS3EnableXMBSettings TmapiTrace_SNPS3EnableXMBSettings
+#define SNPS3SetCustomParamSFOMappingDirectory TmapiTrace_SNPS3SetCustomParamSFOMappingDirectory
+#define SNPS3FormatHDD TmapiTrace_SNPS3FormatHDD
+#define SNPS3SetLogOptions TmapiTrace_SNPS3SetLogOptions
+#define SNPS3GetLogOptions TmapiTrace_SNPS3GetLogOptions
+#define SNPS3ProcessGetTestParam TmapiTrace_SNPS3ProcessGetTestParam
+#define SNPS3ProcessSetTestParam TmapiTrace_SNPS3ProcessSetTestParam
+#define SNPS3EnableInternalKick TmapiTrace_SNPS3EnableInternalKick
+#define SNPS3RegisterIdleWorker TmapiTrace_SNPS3RegisterIdleWorker
+#define SNPS3UnRegisterIdleWorker TmapiTrace_SNPS3UnRegisterIdleWorker
+#define SNPS3BDTransferImage TmapiTrace_SNPS3BDTransferImage
+#define SNPS3BDInsert TmapiTrace_SNPS3BDInsert
+#define SNPS3BDEject TmapiTrace_SNPS3BDEject
+#define SNPS3BDFormat TmapiTrace_SNPS3BDFormat
+#define SNPS3BDQuery TmapiTrace_SNPS3BDQuery
+#define SNPS3SearchForTargets TmapiTrace_SNPS3SearchForTargets
+#define SNPS3StopSearchForTargets TmapiTrace_SNPS3StopSearchForTargets
+#define SNPS3IsScanning TmapiTrace_SNPS3IsScanning
+#define SNPS3IsValidResolution TmapiTrace_SNPS3IsValidResolution
+#define SNPS3SetDisplaySettings TmapiTrace_SNPS3SetDisplaySettings
+#define SNPS3MapFileSystem TmapiTrace_SNPS3MapFileSystem
+#define SNPS3UnmapFileSystem TmapiTrace_SNPS3UnmapFileSystem
+#define SNPS3GetFileSystem TmapiTrace_SNPS3GetFileSystem
+#define SNPS3ImportTargetSettings TmapiTrace_SNPS3ImportTargetSettings
+#define SNPS3ExportTargetSettings TmapiTrace_SNPS3ExportTargetSettings
+#define SNPS3ExtractGameParameter TmapiTrace_SNPS3ExtractGameParameter
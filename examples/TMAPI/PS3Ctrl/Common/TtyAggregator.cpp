@@ -0,0 +1,395 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "TtyAggregator.h"
+#include <string.h>
+
+#define TTY_LOG_BUFFER_BYTES		(64 * 1024)
+#define TTY_FILETIME_UNIX_EPOCH		(116444736000000000ULL)		// 100ns intervals from 1601 to 1970
+
+namespace
+{
+	// Target and stream names as file names.
+	std::wstring ToFileName(const std::string& strName)
+	{
+		std::string strFile = strName;
+		for (size_t i = 0; i < strFile.size(); ++i)
+		{
+			if (strchr("\\/:*?\"<>| ", strFile[i]))
+				strFile[i] = '_';
+		}
+		return UTF8ToWChar(strFile);
+	}
+
+	// The segment after the last one an earlier run left of a stream, so
+	// segments keep running in time order from one run to the next.
+	UINT32 FindNextSegment(const std::wstring& strDirectory, const std::wstring& strStream)
+	{
+		UINT32 uNext = 0;
+		WIN32_FIND_DATAW data;
+		HANDLE hFind = ::FindFirstFileW((strDirectory + L"\\" + strStream + L".*.log").c_str(), &data);
+		if (hFind == INVALID_HANDLE_VALUE)
+			return uNext;
+
+		do
+		{
+			// The wildcard also matches longer stream names that have a '.'.
+			const WCHAR* pszSegment = data.cFileName + strStream.size() + 1;
+			WCHAR* pszEnd = NULL;
+			unsigned long uSegment = wcstoul(pszSegment, &pszEnd, 10);
+			if (pszEnd != pszSegment && *pszSegment >= L'0' && *pszSegment <= L'9' && wcscmp(pszEnd, L".log") == 0 && uSegment >= uNext)
+				uNext = (UINT32)uSegment + 1;
+		}
+		while (::FindNextFileW(hFind, &data));
+
+		::FindClose(hFind);
+		return uNext;
+	}
+}
+
+TtyAggregator::TtyAggregator()
+: m_uMaxSegmentBytes(TTY_DEFAULT_SEGMENT_BYTES)
+, m_uSequence(0)
+, m_uLines(0)
+, m_uBytes(0)
+, m_uLoggedBytes(0)
+, m_uStoreErrors(0)
+{
+	FILETIME now;
+	::GetSystemTimeAsFileTime(&now);
+	UINT64 uNow = ((UINT64)now.dwHighDateTime << 32) | now.dwLowDateTime;
+	m_uStartTime = (uNow - TTY_FILETIME_UNIX_EPOCH) / 10;
+
+	::QueryPerformanceFrequency(&m_frequency);
+	::QueryPerformanceCounter(&m_start);
+}
+
+TtyAggregator::~TtyAggregator()
+{
+	for (size_t i = 0; i < m_targets.size(); ++i)
+	{
+		Target* pTarget = m_targets[i];
+		if (pTarget->bSubscribed)
+			Unsubscribe((UINT32)i);
+
+		for (std::map<UINT32, Stream*>::iterator it = pTarget->streams.begin(); it != pTarget->streams.end(); ++it)
+		{
+			CloseSegment(*it->second);
+			delete it->second;
+		}
+		delete pTarget;
+	}
+}
+
+bool TtyAggregator::SetStore(const std::wstring& strDirectory, UINT64 uSegmentBytes)
+{
+	m_strDirectory = strDirectory;
+	while (!m_strDirectory.empty() && (m_strDirectory[m_strDirectory.size() - 1] == L'\\' || m_strDirectory[m_strDirectory.size() - 1] == L'/'))
+		m_strDirectory.erase(m_strDirectory.size() - 1);
+
+	m_uMaxSegmentBytes = uSegmentBytes ? uSegmentBytes : TTY_DEFAULT_SEGMENT_BYTES;
+
+	if (m_strDirectory.empty())
+		return true;
+	return ::CreateDirectoryW(m_strDirectory.c_str(), NULL) || ::GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+UINT32 TtyAggregator::AddTarget(HTARGET hTarget, const std::string& strName)
+{
+	Target* pTarget = new Target;
+	pTarget->pThis = this;
+	pTarget->uTarget = (UINT32)m_targets.size();
+	pTarget->hTarget = hTarget;
+	pTarget->strName = strName;
+	pTarget->bSubscribed = false;
+	m_targets.push_back(pTarget);
+	return pTarget->uTarget;
+}
+
+void TtyAggregator::SetStreamName(UINT32 uTarget, UINT32 uStream, const std::string& strName)
+{
+	GetStream(*m_targets[uTarget], uStream).strName = strName;
+}
+
+SNRESULT TtyAggregator::Subscribe(UINT32 uTarget)
+{
+	// The target comes back as the user data, which tells apart targets
+	// whose events share the one callback.
+	Target* pTarget = m_targets[uTarget];
+	SNRESULT snr = SNPS3RegisterTTYEventHandler(pTarget->hTarget, SNPS3_TTY_ALL_STREAMS, TtyCallback, pTarget);
+	if (SN_SUCCEEDED(snr))
+		pTarget->bSubscribed = true;
+	return snr;
+}
+
+SNRESULT TtyAggregator::Unsubscribe(UINT32 uTarget)
+{
+	Target* pTarget = m_targets[uTarget];
+	if (!pTarget->bSubscribed)
+		return SN_S_NO_ACTION;
+
+	pTarget->bSubscribed = false;
+	return SNPS3CancelTTYEvents(pTarget->hTarget, SNPS3_TTY_ALL_STREAMS);
+}
+
+void TtyAggregator::Flush(bool bAll)
+{
+	DWORD dwNow = ::GetTickCount();
+
+	for (size_t i = 0; i < m_targets.size(); ++i)
+	{
+		for (std::map<UINT32, Stream*>::iterator it = m_targets[i]->streams.begin(); it != m_targets[i]->streams.end(); ++it)
+		{
+			Stream& stream = *it->second;
+
+			// A prompt, or a line cut off by a crash, still gets seen.
+			if (!stream.strPartial.empty() && (bAll || dwNow - stream.dwPartialTick >= TTY_PARTIAL_HOLD_MS))
+				EndLine(stream);
+
+			if (stream.pLog && (fflush(stream.pLog) != 0 || fflush(stream.pIndex) != 0))
+				m_uStoreErrors++;
+		}
+	}
+}
+
+void TtyAggregator::Merge(std::vector<TtyRecord>& records)
+{
+	// Lines not yet ended started no earlier than this, and any still to
+	// come will start later.
+	UINT64 uWatermark = GetTime();
+	for (size_t i = 0; i < m_targets.size(); ++i)
+	{
+		for (std::map<UINT32, Stream*>::const_iterator it = m_targets[i]->streams.begin(); it != m_targets[i]->streams.end(); ++it)
+		{
+			if (!it->second->strPartial.empty() && it->second->uPartialTime < uWatermark)
+				uWatermark = it->second->uPartialTime;
+		}
+	}
+
+	while (!m_merge.empty() && m_merge.top().uTime <= uWatermark)
+	{
+		Stream* pStream = m_merge.top().pStream;
+		m_merge.pop();
+
+		records.push_back(TtyRecord());
+		records.back().strText.swap(pStream->lines.front().strText);
+		records.back().uTarget = pStream->uTarget;
+		records.back().uStream = pStream->uStream;
+		records.back().uTime = pStream->lines.front().uTime;
+		records.back().uSequence = pStream->lines.front().uSequence;
+		pStream->lines.pop_front();
+
+		if (!pStream->lines.empty())
+		{
+			MergeEntry entry;
+			entry.uTime = pStream->lines.front().uTime;
+			entry.uSequence = pStream->lines.front().uSequence;
+			entry.pStream = pStream;
+			m_merge.push(entry);
+		}
+	}
+}
+
+std::string TtyAggregator::GetStreamName(UINT32 uTarget, UINT32 uStream) const
+{
+	std::map<UINT32, Stream*>::const_iterator it = m_targets[uTarget]->streams.find(uStream);
+	if (it != m_targets[uTarget]->streams.end() && !it->second->strName.empty())
+		return it->second->strName;
+
+	char szName[16];
+	sprintf_s(szName, _countof(szName), "%u", uStream);
+	return szName;
+}
+
+UINT64 TtyAggregator::GetTime() const
+{
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	UINT64 uTicks = (UINT64)(now.QuadPart - m_start.QuadPart);
+	UINT64 uFrequency = (UINT64)m_frequency.QuadPart;
+	return m_uStartTime + uTicks / uFrequency * 1000000 + uTicks % uFrequency * 1000000 / uFrequency;
+}
+
+bool TtyAggregator::MergeEntry::operator<(const MergeEntry& other) const
+{
+	// priority_queue gives the greatest first, so this is the wrong way round.
+	if (uTime != other.uTime)
+		return uTime > other.uTime;
+	return uSequence > other.uSequence;
+}
+
+void __stdcall TtyAggregator::TtyCallback(HTARGET /*hTarget*/, UINT uType, UINT uStream, SNRESULT snr, UINT uLength, BYTE* pData, void* pUser)
+{
+	if (uType != SN_EVENT_TTY || SN_FAILED(snr) || !pUser)
+		return;
+
+	Target* pTarget = static_cast<Target*>(pUser);
+	pTarget->pThis->OnTty(*pTarget, uStream, (const char*)pData, uLength);
+}
+
+void TtyAggregator::OnTty(Target& target, UINT32 uStream, const char* pText, UINT uLength)
+{
+	Stream& stream = GetStream(target, uStream);
+	m_uBytes += uLength;
+
+	UINT64 uNow = GetTime();
+	DWORD dwNow = ::GetTickCount();
+
+	const char* pEnd = pText + uLength;
+	while (pText < pEnd)
+	{
+		const char* pNewline = (const char*)memchr(pText, '\n', pEnd - pText);
+		const char* pPieceEnd = pNewline ? pNewline : pEnd;
+
+		if (stream.strPartial.empty())
+		{
+			stream.uPartialTime = uNow;
+			stream.dwPartialTick = dwNow;
+		}
+
+		for (const char* p = pText; p < pPieceEnd; ++p)
+		{
+			// Carriage returns and the ^Z some streams end with are not text.
+			if (*p != '\r' && *p != 26 && *p != '\0')
+				stream.strPartial += *p;
+		}
+
+		if (!pNewline)
+			break;
+
+		EndLine(stream);
+		pText = pNewline + 1;
+	}
+}
+
+TtyAggregator::Stream& TtyAggregator::GetStream(Target& target, UINT32 uStream)
+{
+	std::map<UINT32, Stream*>::iterator it = target.streams.find(uStream);
+	if (it != target.streams.end())
+		return *it->second;
+
+	Stream* pStream = new Stream;
+	pStream->uTarget = target.uTarget;
+	pStream->uStream = uStream;
+	pStream->uPartialTime = 0;
+	pStream->dwPartialTick = 0;
+	pStream->pLog = NULL;
+	pStream->pIndex = NULL;
+	pStream->uSegment = 0;
+	pStream->bSegmentFound = false;
+	pStream->uSegmentBytes = 0;
+	pStream->uNextIndexAt = 0;
+	target.streams[uStream] = pStream;
+	return *pStream;
+}
+
+void TtyAggregator::EndLine(Stream& stream)
+{
+	TtyRecord record;
+	record.uTarget = stream.uTarget;
+	record.uStream = stream.uStream;
+	record.uTime = stream.uPartialTime;
+	record.uSequence = m_uSequence++;
+	record.strText.swap(stream.strPartial);
+	m_uLines++;
+
+	if (!m_strDirectory.empty())
+		Store(stream, record);
+
+	if (stream.lines.empty())
+	{
+		MergeEntry entry;
+		entry.uTime = record.uTime;
+		entry.uSequence = record.uSequence;
+		entry.pStream = &stream;
+		m_merge.push(entry);
+	}
+	stream.lines.push_back(record);
+}
+
+void TtyAggregator::Store(Stream& stream, const TtyRecord& record)
+{
+	if (stream.pLog && stream.uSegmentBytes >= m_uMaxSegmentBytes)
+	{
+		CloseSegment(stream);
+		stream.uSegment++;
+	}
+
+	if (!stream.pLog && !OpenSegment(stream))
+	{
+		m_uStoreErrors++;
+		return;
+	}
+
+	if (stream.uSegmentBytes >= stream.uNextIndexAt)
+	{
+		fprintf(stream.pIndex, "%llu\t%llu\n", record.uTime, stream.uSegmentBytes);
+		stream.uNextIndexAt = stream.uSegmentBytes + TTY_INDEX_INTERVAL_BYTES;
+	}
+
+	int nWritten = fprintf(stream.pLog, "%llu\t%s\n", record.uTime, record.strText.c_str());
+	if (nWritten < 0)
+	{
+		m_uStoreErrors++;
+		return;
+	}
+
+	stream.uSegmentBytes += nWritten;
+	m_uLoggedBytes += nWritten;
+}
+
+bool TtyAggregator::OpenSegment(Stream& stream)
+{
+	std::wstring strDirectory = m_strDirectory + L"\\" + ToFileName(m_targets[stream.uTarget]->strName);
+	if (!::CreateDirectoryW(strDirectory.c_str(), NULL) && ::GetLastError() != ERROR_ALREADY_EXISTS)
+		return false;
+
+	std::wstring strStream = ToFileName(GetStreamName(stream.uTarget, stream.uStream));
+	if (!stream.bSegmentFound)
+	{
+		stream.uSegment = FindNextSegment(strDirectory, strStream);
+		stream.bSegmentFound = true;
+	}
+
+	WCHAR szSegment[32];
+	swprintf_s(szSegment, _countof(szSegment), L".%04u", stream.uSegment);
+	std::wstring strBase = strDirectory + L"\\" + strStream + szSegment;
+
+	// Binary, so the offsets in the index are those of the file.
+	if (_wfopen_s(&stream.pLog, (strBase + L".log").c_str(), L"ab") != 0 || !stream.pLog)
+	{
+		stream.pLog = NULL;
+		return false;
+	}
+
+	if (_wfopen_s(&stream.pIndex, (strBase + L".idx").c_str(), L"ab") != 0 || !stream.pIndex)
+	{
+		fclose(stream.pLog);
+		stream.pLog = NULL;
+		stream.pIndex = NULL;
+		return false;
+	}
+
+	setvbuf(stream.pLog, NULL, _IOFBF, TTY_LOG_BUFFER_BYTES);
+
+	fseek(stream.pLog, 0, SEEK_END);
+	stream.uSegmentBytes = (UINT64)_ftelli64(stream.pLog);
+	stream.uNextIndexAt = stream.uSegmentBytes;
+	return true;
+}
+
+void TtyAggregator::CloseSegment(Stream& stream)
+{
+	if (stream.pLog)
+		fclose(stream.pLog);
+	if (stream.pIndex)
+		fclose(stream.pIndex);
+
+	stream.pLog = NULL;
+	stream.pIndex = NULL;
+	stream.uSegmentBytes = 0;
+	stream.uNextIndexAt = 0;
+}
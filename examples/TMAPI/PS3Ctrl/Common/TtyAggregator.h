@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TTY_AGGREGATOR_H
+#define TTY_AGGREGATOR_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+
+#define TTY_DEFAULT_SEGMENT_BYTES	(64 * 1024 * 1024)
+#define TTY_INDEX_INTERVAL_BYTES	(64 * 1024)		// Log bytes between time index entries
+#define TTY_PARTIAL_HOLD_MS			(500)			// Before text without a newline is taken as a line
+
+// A line of TTY. Times are microseconds since 1970 UTC, taken from the host's
+// clock once and advanced by a monotonic one, so they never go backwards
+// within a run.
+struct TtyRecord
+{
+	UINT32			uTarget;			// As returned by AddTarget()
+	UINT32			uStream;
+	UINT64			uTime;				// When the first of its text arrived
+	UINT64			uSequence;			// Orders records with the same time
+	std::string		strText;			// Without the newline
+};
+
+// Takes the TTY of every stream of any number of targets, from one event
+// handler registered for each target with the target as its user data, and
+// splits it into lines per target and stream.
+//
+// If given a directory, each stream is logged to
+// <directory>\<target>\<stream>.<segment>.log, a line of
+// "<time>\t<text>" at a time, starting a new segment when one reaches the
+// segment size. A run starts after the segments earlier runs left, so the
+// numbers of segments follow time. Next to each segment,
+// <stream>.<segment>.idx has a "<time>\t<offset>" line for about every
+// TTY_INDEX_INTERVAL_BYTES of it, so a reader can seek to a time without
+// scanning.
+//
+// Merge() gives the lines of all streams in time order, by a k-way merge of
+// the lines of each stream. A line is only given once no stream can still
+// produce an earlier one, that is once it is older than the start of every
+// line still being received.
+//
+// Everything is called on the thread that calls SNPS3Kick().
+class TtyAggregator
+{
+public:
+						TtyAggregator();
+						~TtyAggregator();
+
+	// An empty directory logs nothing.
+	bool				SetStore(const std::wstring& strDirectory, UINT64 uSegmentBytes);
+
+	UINT32				AddTarget(HTARGET hTarget, const std::string& strName);
+	void				SetStreamName(UINT32 uTarget, UINT32 uStream, const std::string& strName);
+	SNRESULT			Subscribe(UINT32 uTarget);
+	SNRESULT			Unsubscribe(UINT32 uTarget);
+
+	// Lines still being received for longer than TTY_PARTIAL_HOLD_MS, or all
+	// of them if bAll, are taken as ended; and the logs are flushed.
+	void				Flush(bool bAll);
+	// Appends the lines that are ready, in time order.
+	void				Merge(std::vector<TtyRecord>& records);
+
+	UINT32				GetTargetCount() const { return (UINT32)m_targets.size(); }
+	const std::string&	GetTargetName(UINT32 uTarget) const { return m_targets[uTarget]->strName; }
+	std::string			GetStreamName(UINT32 uTarget, UINT32 uStream) const;
+	UINT64				GetStartTime() const { return m_uStartTime; }
+	UINT64				GetLineCount() const { return m_uLines; }
+	UINT64				GetByteCount() const { return m_uBytes; }
+	UINT64				GetLoggedBytes() const { return m_uLoggedBytes; }
+	UINT32				GetStoreErrors() const { return m_uStoreErrors; }
+
+	UINT64				GetTime() const;
+
+private:
+	struct Stream
+	{
+		UINT32				uTarget;
+		UINT32				uStream;
+		std::string			strName;
+		std::string			strPartial;		// Text received since the last newline
+		UINT64				uPartialTime;	// When it started, while there is any
+		DWORD				dwPartialTick;
+		std::deque<TtyRecord> lines;		// Ended, not yet merged
+
+		FILE*				pLog;
+		FILE*				pIndex;
+		UINT32				uSegment;
+		bool				bSegmentFound;	// Whether uSegment follows those of earlier runs
+		UINT64				uSegmentBytes;
+		UINT64				uNextIndexAt;
+	};
+
+	struct Target
+	{
+		TtyAggregator*		pThis;
+		UINT32				uTarget;
+		HTARGET				hTarget;
+		std::string			strName;
+		bool				bSubscribed;
+		std::map<UINT32, Stream*> streams;
+	};
+
+	// The head of a stream's lines, in the merge.
+	struct MergeEntry
+	{
+		UINT64				uTime;
+		UINT64				uSequence;
+		Stream*				pStream;
+		bool operator<(const MergeEntry& other) const;
+	};
+
+	static void __stdcall	TtyCallback(HTARGET hTarget, UINT uType, UINT uStream, SNRESULT snr, UINT uLength, BYTE* pData, void* pUser);
+	void				OnTty(Target& target, UINT32 uStream, const char* pText, UINT uLength);
+	Stream&				GetStream(Target& target, UINT32 uStream);
+	void				EndLine(Stream& stream);
+	void				Store(Stream& stream, const TtyRecord& record);
+	bool				OpenSegment(Stream& stream);
+	void				CloseSegment(Stream& stream);
+
+	std::vector<Target*>			m_targets;
+	std::priority_queue<MergeEntry>	m_merge;
+	std::wstring					m_strDirectory;
+	UINT64							m_uMaxSegmentBytes;
+	UINT64							m_uStartTime;
+	LARGE_INTEGER					m_frequency;
+	LARGE_INTEGER					m_start;
+	UINT64							m_uSequence;
+	UINT64							m_uLines;
+	UINT64							m_uBytes;
+	UINT64							m_uLoggedBytes;
+	UINT32							m_uStoreErrors;
+};
+
+#endif
@@ -0,0 +1,704 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "TtyArchive.h"
+#include <string.h>
+#include <algorithm>
+
+#define TTY_ARCHIVE_MAX_NAME			(4096)
+
+namespace
+{
+	void PutVarint(std::vector<BYTE>& out, UINT64 uValue)
+	{
+		while (uValue >= 0x80)
+		{
+			out.push_back((BYTE)(uValue | 0x80));
+			uValue >>= 7;
+		}
+		out.push_back((BYTE)uValue);
+	}
+
+	bool GetVarint(const BYTE*& pCur, const BYTE* pEnd, UINT64& uValue)
+	{
+		uValue = 0;
+		for (UINT32 uShift = 0; uShift < 64; uShift += 7)
+		{
+			if (pCur == pEnd)
+				return false;
+
+			BYTE b = *pCur++;
+			uValue |= (UINT64)(b & 0x7f) << uShift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	UINT32 HashTrigram(const BYTE* p)
+	{
+		UINT32 uHash = (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16);
+		uHash ^= uHash >> 16;
+		uHash *= 0x85ebca6b;
+		uHash ^= uHash >> 13;
+		uHash *= 0xc2b2ae35;
+		uHash ^= uHash >> 16;
+
+		// 0 marks an empty slot in the writer's hash set.
+		return uHash ? uHash : 1;
+	}
+
+	// The bits of a hash are found by double hashing, from the two halves of
+	// it. uBits is a power of two.
+	UINT32 GetBloomBit(UINT32 uHash, UINT32 uIndex, UINT32 uBits)
+	{
+		UINT32 uStep = ((uHash >> 16) | (uHash << 16)) | 1;
+		return (uHash + uIndex * uStep) & (uBits - 1);
+	}
+
+	void PutLength(std::vector<BYTE>& out, UINT32 uLength)
+	{
+		while (uLength >= 255)
+		{
+			out.push_back(255);
+			uLength -= 255;
+		}
+		out.push_back((BYTE)uLength);
+	}
+
+	bool GetLength(const BYTE*& pCur, const BYTE* pEnd, UINT32 uMax, UINT32& uLength)
+	{
+		for (;;)
+		{
+			if (pCur == pEnd || uLength > uMax)
+				return false;
+
+			BYTE b = *pCur++;
+			uLength += b;
+			if (b != 255)
+				return true;
+		}
+	}
+
+	// A match of 0 is the literals at the end.
+	void PutSequence(std::vector<BYTE>& out, const BYTE* pLiterals, UINT32 uLiterals, UINT32 uOffset, UINT32 uMatch)
+	{
+		UINT32 uMatchCode = uMatch ? uMatch - TTY_LZ_MIN_MATCH : 0;
+		out.push_back((BYTE)((std::min<UINT32>(uLiterals, 15) << 4) | std::min<UINT32>(uMatchCode, 15)));
+		if (uLiterals >= 15)
+			PutLength(out, uLiterals - 15);
+		out.insert(out.end(), pLiterals, pLiterals + uLiterals);
+
+		if (!uMatch)
+			return;
+
+		out.push_back((BYTE)uOffset);
+		out.push_back((BYTE)(uOffset >> 8));
+		if (uMatchCode >= 15)
+			PutLength(out, uMatchCode - 15);
+	}
+
+	bool IsValidBlock(const TtyBlockHeader& header, UINT64 uOffset, UINT64 uFileSize)
+	{
+		if (uOffset < sizeof(TtyArchiveHeader) || uOffset + sizeof(header) + header.uSize > uFileSize)
+			return false;
+
+		if (header.uType == TTY_BLOCK_STREAM)
+			return header.uSize <= TTY_ARCHIVE_MAX_NAME;
+
+		// The bloom filter's size is a power of two no smaller than the
+		// writer makes one, and some bytes of compressed lines follow it.
+		return header.uType == TTY_BLOCK_LINES &&
+			header.uSize <= TTY_ARCHIVE_MAX_BLOCK_BYTES &&
+			header.uBloomBytes >= TTY_ARCHIVE_BLOOM_MIN_BYTES && header.uBloomBytes < header.uSize &&
+			(header.uBloomBytes & (header.uBloomBytes - 1)) == 0 &&
+			header.uRawSize && header.uRawSize <= TTY_ARCHIVE_MAX_BLOCK_BYTES && header.uLineCount &&
+			header.uFirstTime <= header.uLastTime;
+	}
+
+	struct LineOrder
+	{
+		bool operator()(const TtyArchiveLine& a, const TtyArchiveLine& b) const
+		{
+			if (a.uTime != b.uTime)
+				return a.uTime < b.uTime;
+			return a.uStream < b.uStream;
+		}
+	};
+
+	struct BlockOrder
+	{
+		const std::vector<TtyBlockEntry>*	pBlocks;
+		bool operator()(size_t a, size_t b) const
+		{
+			return (*pBlocks)[a].header.uFirstTime < (*pBlocks)[b].header.uFirstTime;
+		}
+	};
+}
+
+void TtyCompress(const BYTE* pData, UINT32 uSize, std::vector<BYTE>& out)
+{
+	out.clear();
+	out.reserve(uSize / 2 + 16);
+
+	// Where each hash of four bytes was last seen, plus one.
+	UINT32 auTable[1 << TTY_LZ_HASH_BITS];
+	memset(auTable, 0, sizeof(auTable));
+
+	UINT32 uAnchor = 0;
+	UINT32 uPos = 0;
+	while (uPos + TTY_LZ_MIN_MATCH <= uSize)
+	{
+		UINT32 uSequence;
+		memcpy(&uSequence, pData + uPos, sizeof(uSequence));
+		UINT32 uHash = (uSequence * 2654435761U) >> (32 - TTY_LZ_HASH_BITS);
+		UINT32 uCandidate = auTable[uHash];
+		auTable[uHash] = uPos + 1;
+
+		if (!uCandidate || uPos + 1 - uCandidate > TTY_LZ_MAX_OFFSET || memcmp(pData + uCandidate - 1, &uSequence, sizeof(uSequence)) != 0)
+		{
+			uPos++;
+			continue;
+		}
+
+		uCandidate--;
+		UINT32 uLength = TTY_LZ_MIN_MATCH;
+		while (uPos + uLength < uSize && pData[uCandidate + uLength] == pData[uPos + uLength])
+			uLength++;
+
+		PutSequence(out, pData + uAnchor, uPos - uAnchor, uPos - uCandidate, uLength);
+		uPos += uLength;
+		uAnchor = uPos;
+	}
+
+	PutSequence(out, pData + uAnchor, uSize - uAnchor, 0, 0);
+}
+
+bool TtyDecompress(const BYTE* pData, UINT32 uSize, BYTE* pOut, UINT32 uOutSize)
+{
+	const BYTE* pCur = pData;
+	const BYTE* pEnd = pData + uSize;
+	UINT32 uPos = 0;
+
+	while (pCur < pEnd)
+	{
+		BYTE token = *pCur++;
+
+		UINT32 uLiterals = token >> 4;
+		if (uLiterals == 15 && !GetLength(pCur, pEnd, uOutSize, uLiterals))
+			return false;
+		if (uLiterals > (UINT32)(pEnd - pCur) || uLiterals > uOutSize - uPos)
+			return false;
+
+		memcpy(pOut + uPos, pCur, uLiterals);
+		pCur += uLiterals;
+		uPos += uLiterals;
+
+		if (pCur == pEnd)
+			break;
+
+		if (pEnd - pCur < 2)
+			return false;
+		UINT32 uOffset = pCur[0] | ((UINT32)pCur[1] << 8);
+		pCur += 2;
+
+		UINT32 uMatch = token & 15;
+		if (uMatch == 15 && !GetLength(pCur, pEnd, uOutSize, uMatch))
+			return false;
+		uMatch += TTY_LZ_MIN_MATCH;
+
+		if (uOffset == 0 || uOffset > uPos || uMatch > uOutSize - uPos)
+			return false;
+
+		// The match may overlap what it writes, so a byte at a time.
+		for (UINT32 i = 0; i < uMatch; ++i)
+			pOut[uPos + i] = pOut[uPos - uOffset + i];
+		uPos += uMatch;
+	}
+
+	return uPos == uOutSize;
+}
+
+TtyArchiveWriter::TtyArchiveWriter()
+: m_pFile(NULL)
+, m_uOffset(0)
+, m_bFailed(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+TtyArchiveWriter::~TtyArchiveWriter()
+{
+	Close();
+}
+
+bool TtyArchiveWriter::Open(const WCHAR* pszPath, UINT64 uStartTime)
+{
+	Close();
+
+	if (_wfopen_s(&m_pFile, pszPath, L"wb") != 0 || !m_pFile)
+	{
+		m_pFile = NULL;
+		return false;
+	}
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.uMagic = TTY_ARCHIVE_MAGIC;
+	m_header.uVersion = TTY_ARCHIVE_VERSION;
+	m_header.uStartTime = uStartTime;
+
+	m_pending.clear();
+	m_directory.clear();
+	m_bFailed = false;
+
+	if (fwrite(&m_header, sizeof(m_header), 1, m_pFile) != 1)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+		return false;
+	}
+
+	m_uOffset = sizeof(m_header);
+	return true;
+}
+
+UINT32 TtyArchiveWriter::AddStream(const std::string& strName)
+{
+	UINT32 uStream = (UINT32)m_pending.size();
+	m_pending.push_back(PendingBlock());
+	m_pending.back().uLineCount = 0;
+
+	std::string strStored = strName.substr(0, TTY_ARCHIVE_MAX_NAME);
+
+	TtyBlockHeader header;
+	memset(&header, 0, sizeof(header));
+	header.uType = TTY_BLOCK_STREAM;
+	header.uStream = uStream;
+	header.uSize = (UINT32)strStored.size();
+	WriteBlock(header, (const BYTE*)strStored.c_str(), header.uSize, NULL, 0);
+
+	return uStream;
+}
+
+bool TtyArchiveWriter::Write(UINT32 uStream, UINT64 uTime, const std::string& strText)
+{
+	if (!m_pFile || m_bFailed || uStream >= m_pending.size())
+		return false;
+
+	PendingBlock& block = m_pending[uStream];
+	if (block.uLineCount == 0)
+	{
+		block.uFirstTime = uTime;
+		block.uLastTime = uTime;
+		block.dwStartTick = ::GetTickCount();
+	}
+
+	if (uTime < block.uLastTime)
+		uTime = block.uLastTime;
+
+	PutVarint(block.lines, uTime - block.uLastTime);
+	PutVarint(block.lines, strText.size());
+	block.lines.insert(block.lines.end(), strText.begin(), strText.end());
+
+	const BYTE* pText = (const BYTE*)strText.c_str();
+	for (size_t i = 0; i + 2 < strText.size(); ++i)
+		block.trigrams.push_back(HashTrigram(pText + i));
+
+	block.uLastTime = uTime;
+	block.uLineCount++;
+	m_header.uLineCount++;
+
+	if (block.lines.size() >= TTY_ARCHIVE_BLOCK_BYTES)
+		return WriteLines(uStream);
+	return true;
+}
+
+bool TtyArchiveWriter::Flush(bool bAll)
+{
+	if (!m_pFile)
+		return false;
+
+	DWORD dwNow = ::GetTickCount();
+	for (UINT32 i = 0; i < m_pending.size(); ++i)
+	{
+		if (m_pending[i].uLineCount && (bAll || dwNow - m_pending[i].dwStartTick >= TTY_ARCHIVE_BLOCK_MS))
+			WriteLines(i);
+	}
+
+	if (fflush(m_pFile) != 0)
+		m_bFailed = true;
+	return !m_bFailed;
+}
+
+bool TtyArchiveWriter::Close()
+{
+	if (!m_pFile)
+		return true;
+
+	bool bOK = Flush(true);
+
+	// Only a closed archive gets its directory, and its totals filled in.
+	if (bOK && !m_directory.empty())
+	{
+		m_header.uBlockCount = m_directory.size();
+		m_header.uDirectoryOffset = m_uOffset;
+		bOK = fwrite(&m_directory[0], sizeof(TtyBlockEntry), m_directory.size(), m_pFile) == m_directory.size() &&
+			fseek(m_pFile, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, m_pFile) == 1;
+	}
+
+	if (fclose(m_pFile) != 0)
+		bOK = false;
+
+	m_pFile = NULL;
+	return bOK;
+}
+
+bool TtyArchiveWriter::WriteBlock(TtyBlockHeader& header, const BYTE* pPayload1, UINT32 uSize1, const BYTE* pPayload2, UINT32 uSize2)
+{
+	if (m_bFailed)
+		return false;
+
+	if (fwrite(&header, sizeof(header), 1, m_pFile) != 1 ||
+		(uSize1 && fwrite(pPayload1, uSize1, 1, m_pFile) != 1) ||
+		(uSize2 && fwrite(pPayload2, uSize2, 1, m_pFile) != 1))
+	{
+		m_bFailed = true;
+		return false;
+	}
+
+	TtyBlockEntry entry;
+	entry.uOffset = m_uOffset;
+	entry.header = header;
+	m_directory.push_back(entry);
+
+	m_uOffset += sizeof(header) + header.uSize;
+	return true;
+}
+
+bool TtyArchiveWriter::WriteLines(UINT32 uStream)
+{
+	PendingBlock& block = m_pending[uStream];
+
+	// Sized for the distinct trigrams, so a block of a few lines has a
+	// small filter. They are found with a hash set rather than by sorting,
+	// which for a full block took longer than compressing it.
+	UINT32 uSlots = 1;
+	while (uSlots < block.trigrams.size() * 2)
+		uSlots <<= 1;
+	m_seen.assign(uSlots, 0);
+
+	size_t uDistinct = 0;
+	for (size_t i = 0; i < block.trigrams.size(); ++i)
+	{
+		UINT32 uHash = block.trigrams[i];
+		UINT32 uSlot = uHash & (uSlots - 1);
+		while (m_seen[uSlot] && m_seen[uSlot] != uHash)
+			uSlot = (uSlot + 1) & (uSlots - 1);
+
+		if (!m_seen[uSlot])
+		{
+			m_seen[uSlot] = uHash;
+			block.trigrams[uDistinct++] = uHash;
+		}
+	}
+	block.trigrams.resize(uDistinct);
+
+	UINT32 uBits = TTY_ARCHIVE_BLOOM_MIN_BYTES * 8;
+	while (uBits < block.trigrams.size() * TTY_ARCHIVE_BLOOM_BITS)
+		uBits <<= 1;
+
+	m_bloom.assign(uBits / 8, 0);
+	for (size_t i = 0; i < block.trigrams.size(); ++i)
+	{
+		for (UINT32 j = 0; j < TTY_ARCHIVE_BLOOM_HASHES; ++j)
+		{
+			UINT32 uBit = GetBloomBit(block.trigrams[i], j, uBits);
+			m_bloom[uBit >> 3] |= (BYTE)(1 << (uBit & 7));
+		}
+	}
+
+	TtyCompress(&block.lines[0], (UINT32)block.lines.size(), m_compressed);
+
+	TtyBlockHeader header;
+	header.uType = TTY_BLOCK_LINES;
+	header.uStream = uStream;
+	header.uSize = (UINT32)(m_bloom.size() + m_compressed.size());
+	header.uBloomBytes = (UINT32)m_bloom.size();
+	header.uRawSize = (UINT32)block.lines.size();
+	header.uLineCount = block.uLineCount;
+	header.uFirstTime = block.uFirstTime;
+	header.uLastTime = block.uLastTime;
+
+	bool bOK = WriteBlock(header, &m_bloom[0], (UINT32)m_bloom.size(), &m_compressed[0], (UINT32)m_compressed.size());
+
+	m_header.uRawBytes += block.lines.size();
+	block.lines.clear();
+	block.trigrams.clear();
+	block.uLineCount = 0;
+	return bOK;
+}
+
+TtyArchiveReader::TtyArchiveReader()
+: m_pFile(NULL)
+, m_uFileSize(0)
+, m_bCorrupt(false)
+, m_uCandidateBlocks(0)
+, m_uDecompressedBlocks(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+TtyArchiveReader::~TtyArchiveReader()
+{
+	Close();
+}
+
+bool TtyArchiveReader::Open(const WCHAR* pszPath)
+{
+	Close();
+
+	if (_wfopen_s(&m_pFile, pszPath, L"rb") != 0 || !m_pFile)
+	{
+		m_pFile = NULL;
+		return false;
+	}
+
+	if (_fseeki64(m_pFile, 0, SEEK_END) == 0)
+		m_uFileSize = (UINT64)_ftelli64(m_pFile);
+
+	if (!ReadAt(0, &m_header, sizeof(m_header)) ||
+		m_header.uMagic != TTY_ARCHIVE_MAGIC ||
+		m_header.uVersion != TTY_ARCHIVE_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	// A directory that does not fit the file, as when a closed archive is
+	// cut short, is ignored.
+	std::vector<TtyBlockEntry> entries;
+	if (m_header.uBlockCount && !ReadDirectory(entries))
+	{
+		m_header.uBlockCount = 0;
+		m_bCorrupt = true;
+		entries.clear();
+	}
+
+	if (!m_header.uBlockCount)
+		WalkBlocks(entries);
+
+	// Stream blocks come before the lines of their streams.
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const TtyBlockHeader& header = entries[i].header;
+		if (header.uType == TTY_BLOCK_LINES)
+		{
+			if (header.uStream < m_streams.size())
+				m_blocks.push_back(entries[i]);
+			else
+				m_bCorrupt = true;
+			continue;
+		}
+
+		std::string strName(header.uSize, '\0');
+		if (header.uSize && !ReadAt(entries[i].uOffset + sizeof(header), &strName[0], header.uSize))
+		{
+			m_bCorrupt = true;
+			break;
+		}
+
+		// The writer numbers streams in the order it names them.
+		if (header.uStream != m_streams.size())
+		{
+			m_bCorrupt = true;
+			break;
+		}
+		m_streams.push_back(strName);
+	}
+
+	return true;
+}
+
+void TtyArchiveReader::Close()
+{
+	if (m_pFile)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+	}
+
+	m_blocks.clear();
+	m_streams.clear();
+	m_uFileSize = 0;
+	m_bCorrupt = false;
+}
+
+void TtyArchiveReader::Query(const TtyArchiveQuery& query, UINT64 uLimit, std::vector<TtyArchiveLine>& lines)
+{
+	lines.clear();
+	m_uCandidateBlocks = 0;
+	m_uDecompressedBlocks = 0;
+
+	if (!m_pFile || uLimit == 0)
+		return;
+
+	std::vector<bool> streams(m_streams.size(), query.strStream.empty());
+	for (size_t i = 0; i < m_streams.size() && !query.strStream.empty(); ++i)
+	{
+		size_t uSlash = m_streams[i].rfind('/');
+		streams[i] = _stricmp(m_streams[i].c_str(), query.strStream.c_str()) == 0 ||
+			(uSlash != std::string::npos && _stricmp(m_streams[i].c_str() + uSlash + 1, query.strStream.c_str()) == 0);
+	}
+
+	// Text shorter than a trigram cannot be looked for in the filters.
+	std::vector<UINT32> trigrams;
+	const BYTE* pText = (const BYTE*)query.strText.c_str();
+	for (size_t i = 0; i + 2 < query.strText.size(); ++i)
+		trigrams.push_back(HashTrigram(pText + i));
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < m_blocks.size(); ++i)
+	{
+		const TtyBlockHeader& header = m_blocks[i].header;
+		if (streams[header.uStream] && header.uLastTime >= query.uFrom && header.uFirstTime <= query.uUntil)
+			candidates.push_back(i);
+	}
+
+	BlockOrder order;
+	order.pBlocks = &m_blocks;
+	std::stable_sort(candidates.begin(), candidates.end(), order);
+	m_uCandidateBlocks = candidates.size();
+
+	// Once there are enough lines, blocks starting after the last of them
+	// cannot give an earlier one.
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const TtyBlockEntry& entry = m_blocks[candidates[i]];
+		if (lines.size() >= uLimit && entry.header.uFirstTime > lines.back().uTime)
+			break;
+
+		SearchBlock(entry, query, trigrams, lines);
+
+		if (lines.size() >= uLimit)
+		{
+			std::stable_sort(lines.begin(), lines.end(), LineOrder());
+			lines.resize((size_t)uLimit);
+		}
+	}
+
+	std::stable_sort(lines.begin(), lines.end(), LineOrder());
+}
+
+bool TtyArchiveReader::ReadDirectory(std::vector<TtyBlockEntry>& entries)
+{
+	UINT64 uSize = m_header.uBlockCount * sizeof(TtyBlockEntry);
+	if (m_header.uBlockCount > m_uFileSize / sizeof(TtyBlockEntry) || m_header.uDirectoryOffset + uSize != m_uFileSize)
+		return false;
+
+	entries.resize((size_t)m_header.uBlockCount);
+	if (!ReadAt(m_header.uDirectoryOffset, &entries[0], (size_t)uSize))
+		return false;
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!IsValidBlock(entries[i].header, entries[i].uOffset, m_header.uDirectoryOffset))
+			return false;
+	}
+	return true;
+}
+
+void TtyArchiveReader::WalkBlocks(std::vector<TtyBlockEntry>& entries)
+{
+	// Up to the first block that was not written whole.
+	UINT64 uOffset = sizeof(m_header);
+	while (uOffset < m_uFileSize)
+	{
+		TtyBlockEntry entry;
+		entry.uOffset = uOffset;
+		if (!ReadAt(uOffset, &entry.header, sizeof(entry.header)) || !IsValidBlock(entry.header, uOffset, m_uFileSize))
+		{
+			m_bCorrupt = true;
+			break;
+		}
+
+		entries.push_back(entry);
+		uOffset += sizeof(entry.header) + entry.header.uSize;
+	}
+}
+
+bool TtyArchiveReader::ReadAt(UINT64 uOffset, void* pData, size_t uSize)
+{
+	return _fseeki64(m_pFile, (__int64)uOffset, SEEK_SET) == 0 && fread(pData, 1, uSize, m_pFile) == uSize;
+}
+
+void TtyArchiveReader::SearchBlock(const TtyBlockEntry& entry, const TtyArchiveQuery& query, const std::vector<UINT32>& trigrams,
+	std::vector<TtyArchiveLine>& lines)
+{
+	const TtyBlockHeader& header = entry.header;
+	UINT64 uPayload = entry.uOffset + sizeof(header);
+
+	if (!trigrams.empty())
+	{
+		m_bloom.resize(header.uBloomBytes);
+		if (!ReadAt(uPayload, &m_bloom[0], m_bloom.size()))
+		{
+			m_bCorrupt = true;
+			return;
+		}
+
+		UINT32 uBits = header.uBloomBytes * 8;
+		for (size_t i = 0; i < trigrams.size(); ++i)
+		{
+			for (UINT32 j = 0; j < TTY_ARCHIVE_BLOOM_HASHES; ++j)
+			{
+				UINT32 uBit = GetBloomBit(trigrams[i], j, uBits);
+				if (!(m_bloom[uBit >> 3] & (1 << (uBit & 7))))
+					return;
+			}
+		}
+	}
+
+	m_compressed.resize(header.uSize - header.uBloomBytes);
+	m_raw.resize(header.uRawSize);
+	if (!ReadAt(uPayload + header.uBloomBytes, &m_compressed[0], m_compressed.size()) ||
+		!TtyDecompress(&m_compressed[0], (UINT32)m_compressed.size(), &m_raw[0], (UINT32)m_raw.size()))
+	{
+		m_bCorrupt = true;
+		return;
+	}
+	m_uDecompressedBlocks++;
+
+	const BYTE* pCur = &m_raw[0];
+	const BYTE* pEnd = pCur + m_raw.size();
+	const BYTE* pText = (const BYTE*)query.strText.c_str();
+	UINT64 uTime = header.uFirstTime;
+
+	for (UINT32 i = 0; i < header.uLineCount; ++i)
+	{
+		UINT64 uDelta, uLength;
+		if (!GetVarint(pCur, pEnd, uDelta) || !GetVarint(pCur, pEnd, uLength) || uLength > (UINT64)(pEnd - pCur))
+		{
+			m_bCorrupt = true;
+			return;
+		}
+
+		uTime += uDelta;
+		const BYTE* pLine = pCur;
+		pCur += uLength;
+
+		if (uTime < query.uFrom || uTime > query.uUntil)
+			continue;
+		if (!query.strText.empty() && std::search(pLine, pCur, pText, pText + query.strText.size()) == pCur)
+			continue;
+
+		lines.push_back(TtyArchiveLine());
+		lines.back().uStream = header.uStream;
+		lines.back().uTime = uTime;
+		lines.back().strText.assign((const char*)pLine, (size_t)uLength);
+	}
+}
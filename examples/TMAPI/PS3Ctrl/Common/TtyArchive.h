@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef TTY_ARCHIVE_H
+#define TTY_ARCHIVE_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// TTY archive:
+//
+//   TtyArchiveHeader
+//   TtyBlockHeader, payload
+//   TtyBlockHeader, payload
+//   ...
+//   TtyBlockEntry directory[uBlockCount]
+//
+// A stream block names a stream, and comes before its first lines. A lines
+// block holds lines of one stream in time order; its payload is a bloom
+// filter of the trigrams of their text, uBloomBytes long, then the lines
+// compressed. Decompressed, each line is:
+//
+//   time since the previous line of the block (or uFirstTime), varint
+//   length, varint
+//   text
+//
+// Compression is LZ77, as sequences of:
+//
+//   token byte					literal count in the high nibble, match length
+//								less TTY_LZ_MIN_MATCH in the low one
+//   [255s and a final byte]	added to a nibble of 15
+//   literals
+//   offset, UINT16				not after the last literals
+//   [255s and a final byte]
+//
+// The directory has the header of every block and where it is, so a query
+// picks blocks by time and stream without reading them, then reads the
+// bloom filter of each before decompressing it. An archive that was not
+// closed has no directory; it is found again by walking the block headers.
+
+#define TTY_ARCHIVE_MAGIC				(0x41595454)	// 'TTYA'
+#define TTY_ARCHIVE_VERSION				(1)
+#define TTY_ARCHIVE_BLOCK_BYTES			(128 * 1024)	// Of lines, before compression
+#define TTY_ARCHIVE_MAX_BLOCK_BYTES		(64 * 1024 * 1024)
+#define TTY_ARCHIVE_BLOCK_MS			(10000)			// Before a block still filling is written anyway
+#define TTY_ARCHIVE_BLOOM_BITS			(8)				// Per distinct trigram
+#define TTY_ARCHIVE_BLOOM_MIN_BYTES		(64)
+#define TTY_ARCHIVE_BLOOM_HASHES		(3)
+
+#define TTY_LZ_MIN_MATCH				(4)
+#define TTY_LZ_HASH_BITS				(13)
+#define TTY_LZ_MAX_OFFSET				(0xffff)
+
+#define TTY_BLOCK_STREAM				(0)
+#define TTY_BLOCK_LINES					(1)
+
+struct TtyArchiveHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT64	uStartTime;			// Microseconds since 1970 UTC, as are line times
+	UINT64	uBlockCount;		// 0 if the archive was not closed
+	UINT64	uDirectoryOffset;
+	UINT64	uLineCount;
+	UINT64	uRawBytes;			// Of the lines as decompressed
+};
+
+struct TtyBlockHeader
+{
+	UINT32	uType;				// TTY_BLOCK_*
+	UINT32	uStream;
+	UINT32	uSize;				// Payload bytes following the header
+	UINT32	uBloomBytes;
+	UINT32	uRawSize;			// Of the lines once decompressed
+	UINT32	uLineCount;
+	UINT64	uFirstTime;
+	UINT64	uLastTime;
+};
+
+struct TtyBlockEntry
+{
+	UINT64			uOffset;	// Of the block header
+	TtyBlockHeader	header;
+};
+
+void TtyCompress(const BYTE* pData, UINT32 uSize, std::vector<BYTE>& out);
+bool TtyDecompress(const BYTE* pData, UINT32 uSize, BYTE* pOut, UINT32 uOutSize);
+
+// Archives lines as they come, keeping a block filling for each stream. It
+// all happens on the caller's thread, a block at a time, so archiving keeps
+// up with TTY at well over the rate targets produce it.
+class TtyArchiveWriter
+{
+public:
+					TtyArchiveWriter();
+					~TtyArchiveWriter();
+
+	bool			Open(const WCHAR* pszPath, UINT64 uStartTime);
+	UINT32			AddStream(const std::string& strName);
+	// Times must not go backwards within a stream.
+	bool			Write(UINT32 uStream, UINT64 uTime, const std::string& strText);
+	// Writes out blocks that have been filling for longer than
+	// TTY_ARCHIVE_BLOCK_MS, or all of them if bAll.
+	bool			Flush(bool bAll);
+	bool			Close();
+	bool			IsOpen() const { return m_pFile != NULL; }
+
+	UINT64			GetLineCount() const { return m_header.uLineCount; }
+	UINT64			GetRawBytes() const { return m_header.uRawBytes; }
+	UINT64			GetBytesWritten() const { return m_uOffset; }
+	UINT64			GetBlockCount() const { return m_directory.size(); }
+
+private:
+	struct PendingBlock
+	{
+		std::vector<BYTE>	lines;
+		std::vector<UINT32>	trigrams;		// Hashes, with repeats
+		UINT32				uLineCount;
+		UINT64				uFirstTime;
+		UINT64				uLastTime;
+		DWORD				dwStartTick;
+	};
+
+	bool			WriteBlock(TtyBlockHeader& header, const BYTE* pPayload1, UINT32 uSize1, const BYTE* pPayload2, UINT32 uSize2);
+	bool			WriteLines(UINT32 uStream);
+
+	FILE*						m_pFile;
+	TtyArchiveHeader			m_header;
+	std::vector<PendingBlock>	m_pending;		// By stream
+	std::vector<TtyBlockEntry>	m_directory;
+	std::vector<BYTE>			m_compressed;
+	std::vector<BYTE>			m_bloom;
+	std::vector<UINT32>			m_seen;			// Hash set of a block's trigrams
+	UINT64						m_uOffset;
+	bool						m_bFailed;
+};
+
+struct TtyArchiveQuery
+{
+					TtyArchiveQuery() : uFrom(0), uUntil(~0ULL) {}
+
+	std::string		strText;			// Case sensitive, empty for any line
+	std::string		strStream;			// Full name, or the part after the '/'; empty for any
+	UINT64			uFrom;				// Times as lines have them, inclusive
+	UINT64			uUntil;
+};
+
+struct TtyArchiveLine
+{
+	UINT32			uStream;
+	UINT64			uTime;
+	std::string		strText;
+};
+
+class TtyArchiveReader
+{
+public:
+					TtyArchiveReader();
+					~TtyArchiveReader();
+
+	bool			Open(const WCHAR* pszPath);
+	void			Close();
+	const TtyArchiveHeader& GetHeader() const { return m_header; }
+	// Whether it was closed; if not, its blocks were found by walking them.
+	bool			IsClosed() const { return m_header.uBlockCount != 0; }
+	// Whether it ended on a damaged block, or one was damaged in a query.
+	bool			IsCorrupt() const { return m_bCorrupt; }
+
+	UINT32			GetStreamCount() const { return (UINT32)m_streams.size(); }
+	const std::string& GetStreamName(UINT32 uStream) const { return m_streams[uStream]; }
+	UINT64			GetBlockCount() const { return m_blocks.size(); }
+
+	// Gives the first uLimit matching lines in time order.
+	void			Query(const TtyArchiveQuery& query, UINT64 uLimit, std::vector<TtyArchiveLine>& lines);
+
+	// Of the last query
+	UINT64			GetCandidateBlocks() const { return m_uCandidateBlocks; }
+	UINT64			GetDecompressedBlocks() const { return m_uDecompressedBlocks; }
+
+private:
+	bool			ReadDirectory(std::vector<TtyBlockEntry>& entries);
+	void			WalkBlocks(std::vector<TtyBlockEntry>& entries);
+	bool			ReadAt(UINT64 uOffset, void* pData, size_t uSize);
+	void			SearchBlock(const TtyBlockEntry& entry, const TtyArchiveQuery& query, const std::vector<UINT32>& trigrams,
+						std::vector<TtyArchiveLine>& lines);
+
+	FILE*						m_pFile;
+	TtyArchiveHeader			m_header;
+	UINT64						m_uFileSize;
+	std::vector<TtyBlockEntry>	m_blocks;		// Lines blocks only
+	std::vector<std::string>	m_streams;
+	std::vector<BYTE>			m_bloom;
+	std::vector<BYTE>			m_compressed;
+	std::vector<BYTE>			m_raw;
+	bool						m_bCorrupt;
+	UINT64						m_uCandidateBlocks;
+	UINT64						m_uDecompressedBlocks;
+};
+
+#endif
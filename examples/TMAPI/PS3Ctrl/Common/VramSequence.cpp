@@ -0,0 +1,651 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "VramSequence.h"
+#include <emmintrin.h>
+#include <string.h>
+
+#define VRAM_BITMAP_MIN_HEADER		(54)			// BITMAPFILEHEADER + BITMAPINFOHEADER
+#define VRAM_MAX_BITMAP_SIZE		(256 * 1024 * 1024)
+
+namespace
+{
+	inline bool BlockEqual(const BYTE* pA, const BYTE* pB)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pA));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pB));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff;
+	}
+
+	inline void XorBlocks(BYTE* pOut, const BYTE* pA, const BYTE* pB, UINT32 uBlocks)
+	{
+		for (UINT32 i = 0; i < uBlocks; ++i, pOut += VRAM_BLOCK_SIZE, pA += VRAM_BLOCK_SIZE, pB += VRAM_BLOCK_SIZE)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pA));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pB));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_xor_si128(a, b));
+		}
+	}
+
+	inline void AppendToken(std::vector<BYTE>& out, UINT32 uToken)
+	{
+		size_t uPos = out.size();
+		out.resize(uPos + sizeof(UINT32));
+		memcpy(&out[uPos], &uToken, sizeof(UINT32));
+	}
+
+	bool ReadWholeFile(const WCHAR* pszPath, std::vector<BYTE>& data)
+	{
+		FILE* pFile = NULL;
+		if (_wfopen_s(&pFile, pszPath, L"rb") != 0 || !pFile)
+			return false;
+
+		bool bOK = _fseeki64(pFile, 0, SEEK_END) == 0;
+		__int64 nSize = bOK ? _ftelli64(pFile) : -1;
+		bOK = nSize > 0 && nSize <= VRAM_MAX_BITMAP_SIZE && _fseeki64(pFile, 0, SEEK_SET) == 0;
+		if (bOK)
+		{
+			data.resize((size_t)nSize);
+			bOK = fread(&data[0], data.size(), 1, pFile) == 1;
+		}
+
+		fclose(pFile);
+		return bOK;
+	}
+}
+
+void VramEncodeDelta(const BYTE* pFrame, const BYTE* pPrevious, UINT32 uSize, std::vector<BYTE>& out)
+{
+	UINT32 uBlocks = uSize / VRAM_BLOCK_SIZE;
+	UINT32 uBlock = 0;
+
+	out.clear();
+
+	while (uBlock < uBlocks)
+	{
+		UINT32 uStart = uBlock;
+		while (uBlock < uBlocks && uBlock - uStart < VRAM_RUN_MAX &&
+			BlockEqual(pFrame + uBlock * VRAM_BLOCK_SIZE, pPrevious + uBlock * VRAM_BLOCK_SIZE))
+			++uBlock;
+		if (uBlock > uStart)
+			AppendToken(out, uBlock - uStart);
+
+		uStart = uBlock;
+		while (uBlock < uBlocks && uBlock - uStart < VRAM_RUN_MAX &&
+			!BlockEqual(pFrame + uBlock * VRAM_BLOCK_SIZE, pPrevious + uBlock * VRAM_BLOCK_SIZE))
+			++uBlock;
+		if (uBlock > uStart)
+		{
+			UINT32 uCount = uBlock - uStart;
+			AppendToken(out, VRAM_RUN_LITERAL | uCount);
+
+			size_t uPos = out.size();
+			out.resize(uPos + (size_t)uCount * VRAM_BLOCK_SIZE);
+			XorBlocks(&out[uPos], pFrame + uStart * VRAM_BLOCK_SIZE, pPrevious + uStart * VRAM_BLOCK_SIZE, uCount);
+		}
+	}
+}
+
+bool VramApplyDelta(const BYTE* pDelta, UINT32 uDeltaSize, BYTE* pFrame, UINT32 uSize)
+{
+	UINT32 uBlocks = uSize / VRAM_BLOCK_SIZE;
+	UINT32 uBlock = 0;
+	UINT32 uPos = 0;
+
+	while (uPos < uDeltaSize)
+	{
+		UINT32 uToken;
+		if (uDeltaSize - uPos < sizeof(UINT32))
+			return false;
+		memcpy(&uToken, pDelta + uPos, sizeof(UINT32));
+		uPos += sizeof(UINT32);
+
+		UINT32 uCount = uToken & VRAM_RUN_MAX;
+		if (uCount == 0 || uCount > uBlocks - uBlock)
+			return false;
+
+		if (uToken & VRAM_RUN_LITERAL)
+		{
+			if ((uDeltaSize - uPos) / VRAM_BLOCK_SIZE < uCount)
+				return false;
+
+			BYTE* pOut = pFrame + uBlock * VRAM_BLOCK_SIZE;
+			XorBlocks(pOut, pOut, pDelta + uPos, uCount);
+			uPos += uCount * VRAM_BLOCK_SIZE;
+		}
+
+		uBlock += uCount;
+	}
+
+	return uBlock == uBlocks;
+}
+
+bool VramReadBitmap(const WCHAR* pszPath, std::vector<BYTE>& header, std::vector<BYTE>& pixels)
+{
+	std::vector<BYTE> data;
+	if (!ReadWholeFile(pszPath, data) || data.size() < VRAM_BITMAP_MIN_HEADER || data[0] != 'B' || data[1] != 'M')
+		return false;
+
+	UINT32 uPixelOffset;
+	memcpy(&uPixelOffset, &data[10], sizeof(UINT32));	// BITMAPFILEHEADER::bfOffBits
+	if (uPixelOffset < VRAM_BITMAP_MIN_HEADER || uPixelOffset >= data.size())
+		return false;
+
+	header.assign(data.begin(), data.begin() + uPixelOffset);
+	pixels.assign(data.begin() + uPixelOffset, data.end());
+	return true;
+}
+
+VramSequenceWriter::VramSequenceWriter()
+: m_pFile(NULL)
+, m_uOffset(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+VramSequenceWriter::~VramSequenceWriter()
+{
+	Close();
+}
+
+bool VramSequenceWriter::Open(const WCHAR* pszPath, const VramSequenceHeader& info, const BYTE* pBitmapHeader)
+{
+	Close();
+
+	if (_wfopen_s(&m_pFile, pszPath, L"wb") != 0 || !m_pFile)
+	{
+		m_pFile = NULL;
+		return false;
+	}
+
+	m_header = info;
+	m_header.uMagic = VRAM_SEQUENCE_MAGIC;
+	m_header.uVersion = VRAM_SEQUENCE_VERSION;
+	m_header.uFrameCount = 0;
+	m_header.uFrameTableOffset = 0;
+	m_frameOffsets.clear();
+
+	if (fwrite(&m_header, sizeof(m_header), 1, m_pFile) != 1 ||
+		fwrite(pBitmapHeader, m_header.uBitmapHeaderSize, 1, m_pFile) != 1)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+		return false;
+	}
+
+	m_uOffset = sizeof(m_header) + m_header.uBitmapHeaderSize;
+	return true;
+}
+
+bool VramSequenceWriter::WriteFrame(UINT32 uType, UINT64 uTimestamp, const BYTE* pPayload, UINT32 uSize)
+{
+	if (!m_pFile)
+		return false;
+
+	VramFrameHeader frame;
+	frame.uType = uType;
+	frame.uSize = uSize;
+	frame.uTimestamp = uTimestamp;
+
+	if (fwrite(&frame, sizeof(frame), 1, m_pFile) != 1 || (uSize && fwrite(pPayload, uSize, 1, m_pFile) != 1))
+		return false;
+
+	m_frameOffsets.push_back(m_uOffset);
+	m_uOffset += sizeof(frame) + uSize;
+	return true;
+}
+
+bool VramSequenceWriter::Close()
+{
+	if (!m_pFile)
+		return true;
+
+	m_header.uFrameCount = (UINT32)m_frameOffsets.size();
+	m_header.uFrameTableOffset = m_uOffset;
+
+	bool bOK = m_frameOffsets.empty() ||
+		fwrite(&m_frameOffsets[0], sizeof(UINT64), m_frameOffsets.size(), m_pFile) == m_frameOffsets.size();
+	m_uOffset += m_frameOffsets.size() * sizeof(UINT64);
+
+	// The frame count is only filled in once the table is there.
+	if (bOK)
+		bOK = _fseeki64(m_pFile, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, m_pFile) == 1;
+
+	if (fclose(m_pFile) != 0)
+		bOK = false;
+	m_pFile = NULL;
+	return bOK;
+}
+
+VramSequenceReader::VramSequenceReader()
+: m_pFile(NULL)
+, m_uCurrent(~0u)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+VramSequenceReader::~VramSequenceReader()
+{
+	Close();
+}
+
+bool VramSequenceReader::Open(const WCHAR* pszPath)
+{
+	Close();
+
+	if (_wfopen_s(&m_pFile, pszPath, L"rb") != 0 || !m_pFile)
+	{
+		m_pFile = NULL;
+		return false;
+	}
+
+	if (fread(&m_header, sizeof(m_header), 1, m_pFile) != 1 || m_header.uMagic != VRAM_SEQUENCE_MAGIC ||
+		m_header.uVersion != VRAM_SEQUENCE_VERSION || m_header.uBitmapHeaderSize > VRAM_MAX_BITMAP_SIZE ||
+		m_header.uPixelBytes == 0 || m_header.uPixelBytes > VRAM_MAX_BITMAP_SIZE || m_header.uFrameCount == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_bitmapHeader.resize(m_header.uBitmapHeaderSize);
+	m_frameOffsets.resize(m_header.uFrameCount);
+	if (fread(&m_bitmapHeader[0], m_bitmapHeader.size(), 1, m_pFile) != 1 ||
+		_fseeki64(m_pFile, (__int64)m_header.uFrameTableOffset, SEEK_SET) != 0 ||
+		fread(&m_frameOffsets[0], sizeof(UINT64), m_frameOffsets.size(), m_pFile) != m_frameOffsets.size())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void VramSequenceReader::Close()
+{
+	if (m_pFile)
+	{
+		fclose(m_pFile);
+		m_pFile = NULL;
+	}
+	m_uCurrent = ~0u;
+}
+
+bool VramSequenceReader::ReadFrameHeader(UINT32 uFrame, VramFrameHeader& frame)
+{
+	return uFrame < m_header.uFrameCount && _fseeki64(m_pFile, (__int64)m_frameOffsets[uFrame], SEEK_SET) == 0 &&
+		fread(&frame, sizeof(frame), 1, m_pFile) == 1;
+}
+
+bool VramSequenceReader::ReadFrame(UINT32 uFrame, std::vector<BYTE>& pixels)
+{
+	if (!m_pFile || uFrame >= m_header.uFrameCount)
+		return false;
+
+	UINT32 uSize = VramPaddedSize(m_header.uPixelBytes);
+
+	// Back to the key frame this one depends on, unless the frame already
+	// decoded is on the way.
+	UINT32 uFirst = uFrame;
+	VramFrameHeader frame;
+	for (;;)
+	{
+		if (m_uCurrent != ~0u && m_uCurrent <= uFrame && m_uCurrent >= uFirst)
+		{
+			uFirst = m_uCurrent + 1;
+			break;
+		}
+		if (!ReadFrameHeader(uFirst, frame))
+			return false;
+		if (frame.uType == VRAM_FRAME_KEY)
+			break;
+		if (uFirst == 0)
+			return false;
+		--uFirst;
+	}
+
+	for (UINT32 i = uFirst; i <= uFrame; ++i)
+	{
+		m_uCurrent = ~0u;
+
+		if (!ReadFrameHeader(i, frame) || frame.uSize > uSize + uSize / VRAM_BLOCK_SIZE * sizeof(UINT32))
+			return false;
+
+		m_payload.resize(frame.uSize);
+		if (frame.uSize && fread(&m_payload[0], frame.uSize, 1, m_pFile) != 1)
+			return false;
+
+		if (frame.uType == VRAM_FRAME_KEY)
+		{
+			if (frame.uSize != uSize)
+				return false;
+			m_current.swap(m_payload);
+		}
+		else if (m_current.size() != uSize || !VramApplyDelta(frame.uSize ? &m_payload[0] : NULL, frame.uSize, &m_current[0], uSize))
+		{
+			return false;
+		}
+
+		m_uCurrent = i;
+	}
+
+	pixels.assign(m_current.begin(), m_current.begin() + m_header.uPixelBytes);
+	return true;
+}
+
+bool VramSequenceReader::WriteBitmap(UINT32 uFrame, const WCHAR* pszPath)
+{
+	std::vector<BYTE> pixels;
+	if (!ReadFrame(uFrame, pixels))
+		return false;
+
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszPath, L"wb") != 0 || !pFile)
+		return false;
+
+	bool bOK = fwrite(&m_bitmapHeader[0], m_bitmapHeader.size(), 1, pFile) == 1 &&
+		fwrite(&pixels[0], pixels.size(), 1, pFile) == 1;
+
+	if (fclose(pFile) != 0)
+		bOK = false;
+	return bOK;
+}
+
+VramCapturePipeline::VramCapturePipeline()
+: m_hWindow(NULL)
+, m_hJobs(NULL)
+, m_pLast(NULL)
+, m_pWritten(NULL)
+, m_uSubmitted(0)
+, m_uWritten(0)
+, m_uKeyFrames(0)
+, m_uFailed(0)
+, m_uEncodeMicroseconds(0)
+, m_uFrequency(0)
+, m_bWriteFailed(false)
+{
+	memset(&m_info, 0, sizeof(m_info));
+	InitializeCriticalSection(&m_lock);
+}
+
+VramCapturePipeline::~VramCapturePipeline()
+{
+	Finish();
+	DeleteCriticalSection(&m_lock);
+}
+
+bool VramCapturePipeline::Start(const WCHAR* pszPath, const VramSequenceHeader& info, UINT32 uThreads)
+{
+	Finish();
+
+	m_strPath = pszPath;
+	m_info = info;
+	m_info.uCapturedBytes = 0;
+	if (m_info.uKeyInterval == 0)
+		m_info.uKeyInterval = VRAM_DEFAULT_KEY_INTERVAL;
+	m_bitmapHeader.clear();
+	m_uSubmitted = 0;
+	m_uWritten = 0;
+	m_uKeyFrames = 0;
+	m_uFailed = 0;
+	m_uEncodeMicroseconds = 0;
+	m_bWriteFailed = false;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_uFrequency = (UINT64)frequency.QuadPart;
+
+	if (uThreads == 0)
+	{
+		// Leave a core for the capture itself.
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		uThreads = si.dwNumberOfProcessors > 1 ? si.dwNumberOfProcessors - 1 : 1;
+	}
+
+	// Frames from submission until the frame after them is written.
+	m_hWindow = CreateSemaphore(NULL, uThreads * 2 + 2, 0x7fffffff, NULL);
+	m_hJobs = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+	if (!m_hWindow || !m_hJobs)
+	{
+		Cleanup();
+		return false;
+	}
+
+	if (!m_workers.Start<VramCapturePipeline, &VramCapturePipeline::WorkerThread>(uThreads, this))
+	{
+		Cleanup();
+		return false;
+	}
+
+	return true;
+}
+
+bool VramCapturePipeline::Submit(const WCHAR* pszBitmapPath, UINT64 uTimestamp)
+{
+	if (m_workers.IsEmpty() || m_bWriteFailed)
+		return false;
+
+	// Writing what has finished may be what frees up the window.
+	while (WaitForSingleObject(m_hWindow, 10) == WAIT_TIMEOUT)
+	{
+		if (!Drain(false))
+			return false;
+	}
+
+	Frame* pFrame = new Frame;
+	pFrame->strPath = pszBitmapPath;
+	pFrame->uTimestamp = uTimestamp;
+	pFrame->uFileBytes = 0;
+	pFrame->uType = VRAM_FRAME_KEY;
+	pFrame->uEncodeMicroseconds = 0;
+	pFrame->bFailed = false;
+	pFrame->bDropped = false;
+	pFrame->pPrevious = m_uSubmitted % m_info.uKeyInterval ? m_pLast : NULL;
+	pFrame->hDecoded = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pFrame->hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	m_pLast = pFrame;
+	++m_uSubmitted;
+
+	EnterCriticalSection(&m_lock);
+	m_queued.push_back(pFrame);
+	m_frames.push_back(pFrame);
+	LeaveCriticalSection(&m_lock);
+
+	ReleaseSemaphore(m_hJobs, 1, NULL);
+	return true;
+}
+
+void VramCapturePipeline::WorkerThread()
+{
+	for (;;)
+	{
+		WaitForSingleObject(m_hJobs, INFINITE);
+
+		// Frames are claimed in order, so the previous frame is always
+		// already being loaded by another worker.
+		EnterCriticalSection(&m_lock);
+		Frame* pFrame = NULL;
+		if (!m_queued.empty())
+		{
+			pFrame = m_queued.front();
+			m_queued.pop_front();
+		}
+		LeaveCriticalSection(&m_lock);
+
+		if (!pFrame)
+			break;
+
+		ProcessFrame(*pFrame);
+		SetEvent(pFrame->hDone);
+	}
+}
+
+void VramCapturePipeline::ProcessFrame(Frame& frame)
+{
+	LARGE_INTEGER start, end;
+	QueryPerformanceCounter(&start);
+
+	frame.bFailed = !VramReadBitmap(frame.strPath.c_str(), frame.header, frame.pixels);
+	if (!frame.bFailed)
+	{
+		frame.uFileBytes = frame.header.size() + frame.pixels.size();
+		frame.pixels.resize(VramPaddedSize((UINT32)frame.pixels.size()), 0);
+	}
+	_wremove(frame.strPath.c_str());
+	SetEvent(frame.hDecoded);
+
+	if (frame.bFailed)
+		return;
+
+	Frame* pPrevious = frame.pPrevious;
+	if (pPrevious)
+	{
+		WaitForSingleObject(pPrevious->hDecoded, INFINITE);
+
+		if (!pPrevious->bFailed && pPrevious->header == frame.header && pPrevious->pixels.size() == frame.pixels.size())
+		{
+			VramEncodeDelta(&frame.pixels[0], &pPrevious->pixels[0], (UINT32)frame.pixels.size(), frame.payload);
+			if (frame.payload.size() < frame.pixels.size())
+				frame.uType = VRAM_FRAME_DELTA;
+			else
+				frame.payload.clear();
+		}
+	}
+
+	QueryPerformanceCounter(&end);
+	frame.uEncodeMicroseconds = (UINT64)(end.QuadPart - start.QuadPart) * 1000000 / m_uFrequency;
+}
+
+bool VramCapturePipeline::WriteFrame(Frame& frame)
+{
+	if (frame.bFailed)
+	{
+		++m_uFailed;
+		frame.bDropped = true;
+		return true;
+	}
+
+	if (m_bitmapHeader.empty())
+	{
+		m_bitmapHeader = frame.header;
+		m_info.uBitmapHeaderSize = (UINT32)frame.header.size();
+		m_info.uPixelBytes = (UINT32)(frame.uFileBytes - frame.header.size());
+		if (!m_writer.Open(m_strPath.c_str(), m_info, &m_bitmapHeader[0]))
+			return false;
+	}
+
+	// A capture whose format changed mid-sequence, after a resolution
+	// switch say, cannot share the sequence's bitmap header.
+	if (frame.header != m_bitmapHeader || frame.pixels.size() != VramPaddedSize(m_info.uPixelBytes))
+	{
+		++m_uFailed;
+		frame.bDropped = true;
+		return true;
+	}
+
+	// A delta is only valid against the frame written before it.
+	if (frame.uType == VRAM_FRAME_DELTA && (m_pWritten == NULL || m_pWritten->bDropped || frame.pPrevious != m_pWritten))
+	{
+		frame.uType = VRAM_FRAME_KEY;
+		frame.payload.clear();
+	}
+
+	const std::vector<BYTE>& payload = frame.uType == VRAM_FRAME_KEY ? frame.pixels : frame.payload;
+	if (!m_writer.WriteFrame(frame.uType, frame.uTimestamp, &payload[0], (UINT32)payload.size()))
+		return false;
+
+	if (frame.uType == VRAM_FRAME_KEY)
+		++m_uKeyFrames;
+	++m_uWritten;
+	m_info.uCapturedBytes += frame.uFileBytes;
+	m_uEncodeMicroseconds += frame.uEncodeMicroseconds;
+	return true;
+}
+
+bool VramCapturePipeline::Drain(bool bWait)
+{
+	for (;;)
+	{
+		EnterCriticalSection(&m_lock);
+		Frame* pFrame = m_frames.empty() ? NULL : m_frames.front();
+		LeaveCriticalSection(&m_lock);
+
+		if (!pFrame || WaitForSingleObject(pFrame->hDone, bWait ? INFINITE : 0) != WAIT_OBJECT_0)
+			return !m_bWriteFailed;
+
+		EnterCriticalSection(&m_lock);
+		m_frames.pop_front();
+		LeaveCriticalSection(&m_lock);
+
+		if (!m_bWriteFailed && !WriteFrame(*pFrame))
+			m_bWriteFailed = true;
+
+		// The frame before this one was only kept for its delta. This one
+		// is kept even if it was dropped, the next frame's worker may still
+		// be looking at it.
+		if (m_pWritten)
+			FreeFrame(m_pWritten);
+		m_pWritten = pFrame;
+	}
+}
+
+void VramCapturePipeline::FreeFrame(Frame* pFrame)
+{
+	if (pFrame == m_pLast)
+		m_pLast = NULL;
+
+	CloseHandle(pFrame->hDecoded);
+	CloseHandle(pFrame->hDone);
+	delete pFrame;
+
+	ReleaseSemaphore(m_hWindow, 1, NULL);
+}
+
+bool VramCapturePipeline::Finish()
+{
+	if (m_workers.IsEmpty())
+		return !m_bWriteFailed;
+
+	bool bOK = Drain(true);
+
+	// Wake every worker; with nothing queued each one exits.
+	ReleaseSemaphore(m_hJobs, (LONG)m_workers.GetCount(), NULL);
+	m_workers.Wait(INFINITE);
+
+	if (m_writer.IsOpen() && !m_writer.Close())
+		bOK = false;
+
+	Cleanup();
+	return bOK && !m_bWriteFailed;
+}
+
+void VramCapturePipeline::Cleanup()
+{
+	if (m_pWritten)
+	{
+		FreeFrame(m_pWritten);
+		m_pWritten = NULL;
+	}
+	while (!m_frames.empty())
+	{
+		FreeFrame(m_frames.front());
+		m_frames.pop_front();
+	}
+	m_queued.clear();
+	m_pLast = NULL;
+
+	if (m_hWindow)
+	{
+		CloseHandle(m_hWindow);
+		m_hWindow = NULL;
+	}
+	if (m_hJobs)
+	{
+		CloseHandle(m_hJobs);
+		m_hJobs = NULL;
+	}
+}
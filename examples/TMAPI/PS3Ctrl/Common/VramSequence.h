@@ -0,0 +1,200 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef VRAM_SEQUENCE_H
+#define VRAM_SEQUENCE_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "WorkerThreads.h"
+
+// VRAM capture sequence:
+//
+//   VramSequenceHeader
+//   bitmap file and info headers, uBitmapHeaderSize bytes, shared by all frames
+//   VramFrameHeader, payload
+//   VramFrameHeader, payload
+//   ...
+//   UINT64 frame offsets[uFrameCount]
+//
+// A frame is the pixel bytes of one SNPS3VRAMCapture() bitmap, padded with
+// zeros to a multiple of VRAM_BLOCK_SIZE. Key frames store them as they are.
+// Delta frames store the XOR with the previous frame as runs of blocks:
+//
+//   UINT32 token, VRAM_RUN_LITERAL set		count in the low bits, followed by
+//											count blocks of XORed bytes
+//   UINT32 token, VRAM_RUN_LITERAL clear	count blocks unchanged
+//
+// A key frame is written every uKeyInterval frames, and whenever a delta
+// would be no smaller, so a frame decodes from the key frame before it.
+
+#define VRAM_SEQUENCE_MAGIC			(0x51534356)	// 'VCSQ'
+#define VRAM_SEQUENCE_VERSION		(1)
+#define VRAM_BLOCK_SIZE				(16)
+#define VRAM_RUN_LITERAL			(0x80000000)
+#define VRAM_RUN_MAX				(0x7fffffff)
+#define VRAM_DEFAULT_KEY_INTERVAL	(30)
+
+#define VRAM_FRAME_KEY				(0)
+#define VRAM_FRAME_DELTA			(1)
+
+struct VramSequenceHeader
+{
+	UINT32	uMagic;
+	UINT32	uVersion;
+	UINT32	uWidth;					// From SNPS3GetVRAMInformation()
+	UINT32	uHeight;
+	UINT32	uPitch;
+	UINT32	uColour;
+	UINT32	uKeyInterval;
+	UINT32	uBitmapHeaderSize;
+	UINT32	uPixelBytes;			// Before padding
+	UINT32	uFrameCount;			// 0 if the sequence was not closed
+	UINT64	uFrameTableOffset;
+	UINT64	uCapturedBytes;			// Total size of the bitmaps captured
+};
+
+struct VramFrameHeader
+{
+	UINT32	uType;					// VRAM_FRAME_*
+	UINT32	uSize;					// Payload bytes following the header
+	UINT64	uTimestamp;				// Milliseconds since the first capture
+};
+
+inline UINT32 VramPaddedSize(UINT32 uPixelBytes)
+{
+	return (uPixelBytes + VRAM_BLOCK_SIZE - 1) & ~(VRAM_BLOCK_SIZE - 1);
+}
+
+// uSize must be a multiple of VRAM_BLOCK_SIZE.
+void VramEncodeDelta(const BYTE* pFrame, const BYTE* pPrevious, UINT32 uSize, std::vector<BYTE>& out);
+bool VramApplyDelta(const BYTE* pDelta, UINT32 uDeltaSize, BYTE* pFrame, UINT32 uSize);
+
+// Splits a bitmap file into its headers and pixel bytes.
+bool VramReadBitmap(const WCHAR* pszPath, std::vector<BYTE>& header, std::vector<BYTE>& pixels);
+
+class VramSequenceWriter
+{
+public:
+					VramSequenceWriter();
+					~VramSequenceWriter();
+
+	bool			Open(const WCHAR* pszPath, const VramSequenceHeader& info, const BYTE* pBitmapHeader);
+	bool			WriteFrame(UINT32 uType, UINT64 uTimestamp, const BYTE* pPayload, UINT32 uSize);
+	bool			Close();
+
+	bool			IsOpen() const { return m_pFile != NULL; }
+	UINT64			GetBytesWritten() const { return m_uOffset; }
+
+private:
+	FILE*				m_pFile;
+	VramSequenceHeader	m_header;
+	std::vector<UINT64>	m_frameOffsets;
+	UINT64				m_uOffset;
+};
+
+class VramSequenceReader
+{
+public:
+					VramSequenceReader();
+					~VramSequenceReader();
+
+	bool			Open(const WCHAR* pszPath);
+	void			Close();
+	const VramSequenceHeader& GetHeader() const { return m_header; }
+
+	// Decodes forward from the key frame at or before uFrame, or carries on
+	// from the last frame read when reading in order.
+	bool			ReadFrame(UINT32 uFrame, std::vector<BYTE>& pixels);
+	bool			WriteBitmap(UINT32 uFrame, const WCHAR* pszPath);
+
+private:
+	bool			ReadFrameHeader(UINT32 uFrame, VramFrameHeader& frame);
+
+	FILE*				m_pFile;
+	VramSequenceHeader	m_header;
+	std::vector<BYTE>	m_bitmapHeader;
+	std::vector<UINT64>	m_frameOffsets;
+	std::vector<BYTE>	m_current;
+	UINT32				m_uCurrent;		// Frame in m_current, or ~0
+	std::vector<BYTE>	m_payload;
+};
+
+// Turns a stream of captured bitmaps into a sequence. Worker threads load
+// and encode frames while the caller captures the next one; each delta only
+// needs the previous frame's pixels, so frames encode in parallel. Encoded
+// frames are written in order by Drain(), which the caller runs between
+// captures. Only a window of frames is held in memory.
+class VramCapturePipeline
+{
+public:
+					VramCapturePipeline();
+					~VramCapturePipeline();
+
+	bool			Start(const WCHAR* pszPath, const VramSequenceHeader& info, UINT32 uThreads);
+	// Queues a captured bitmap, which is deleted once encoded. Blocks while
+	// the window is full.
+	bool			Submit(const WCHAR* pszBitmapPath, UINT64 uTimestamp);
+	// Writes frames that have finished encoding; with bWait, all of them.
+	bool			Drain(bool bWait);
+	bool			Finish();
+
+	UINT32			GetFrameCount() const { return m_uWritten; }
+	UINT32			GetKeyFrameCount() const { return m_uKeyFrames; }
+	UINT32			GetFailedCount() const { return m_uFailed; }
+	UINT64			GetCapturedBytes() const { return m_info.uCapturedBytes; }
+	UINT64			GetBytesWritten() const { return m_writer.GetBytesWritten(); }
+	UINT64			GetEncodeMicroseconds() const { return m_uEncodeMicroseconds; }
+
+private:
+	struct Frame
+	{
+		std::wstring		strPath;
+		UINT64				uTimestamp;
+		UINT64				uFileBytes;
+		std::vector<BYTE>	header;
+		std::vector<BYTE>	pixels;
+		std::vector<BYTE>	payload;
+		UINT32				uType;
+		UINT64				uEncodeMicroseconds;
+		bool				bFailed;		// Could not be loaded, set by the worker
+		bool				bDropped;		// Not written, set by Drain()
+		Frame*				pPrevious;
+		HANDLE				hDecoded;
+		HANDLE				hDone;
+	};
+
+	void			WorkerThread();
+	void			ProcessFrame(Frame& frame);
+	bool			WriteFrame(Frame& frame);
+	void			FreeFrame(Frame* pFrame);
+	void			Cleanup();
+
+	std::wstring				m_strPath;
+	VramSequenceHeader			m_info;
+	VramSequenceWriter			m_writer;
+	std::vector<BYTE>			m_bitmapHeader;
+	WorkerThreads				m_workers;
+	HANDLE						m_hWindow;		// Limits frames held in memory
+	HANDLE						m_hJobs;
+	CRITICAL_SECTION			m_lock;
+	std::deque<Frame*>			m_queued;		// Submitted, not yet claimed by a worker
+	std::deque<Frame*>			m_frames;		// Submitted, not yet written
+	Frame*						m_pLast;		// Last frame submitted
+	Frame*						m_pWritten;		// Last frame drained, kept for the next delta
+	UINT32						m_uSubmitted;
+	UINT32						m_uWritten;
+	UINT32						m_uKeyFrames;
+	UINT32						m_uFailed;
+	UINT64						m_uEncodeMicroseconds;
+	UINT64						m_uFrequency;
+	bool						m_bWriteFailed;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "WorkerThreads.h"
+
+WorkerThreads::WorkerThreads()
+{
+}
+
+WorkerThreads::~WorkerThreads()
+{
+	Close();
+}
+
+bool WorkerThreads::StartThreads(UINT32 uCount, LPTHREAD_START_ROUTINE pfnEntry, void* pParam)
+{
+	_ASSERT(m_threads.empty());
+
+	for (UINT32 i = 0; i < uCount; ++i)
+	{
+		HANDLE hThread = ::CreateThread(NULL, 0, pfnEntry, pParam, 0, NULL);
+		if (!hThread)
+			break;
+		m_threads.push_back(hThread);
+	}
+
+	return !m_threads.empty();
+}
+
+bool WorkerThreads::Wait(DWORD dwMilliseconds)
+{
+	if (m_threads.empty())
+		return true;
+
+	// WaitForMultipleObjects() takes at most MAXIMUM_WAIT_OBJECTS handles.
+	DWORD dwStart = ::GetTickCount();
+	for (size_t i = 0; i < m_threads.size(); i += MAXIMUM_WAIT_OBJECTS)
+	{
+		DWORD dwCount = (DWORD)(m_threads.size() - i < MAXIMUM_WAIT_OBJECTS ? m_threads.size() - i : MAXIMUM_WAIT_OBJECTS);
+		DWORD dwWait = dwMilliseconds;
+		if (dwMilliseconds != INFINITE)
+		{
+			DWORD dwSpent = ::GetTickCount() - dwStart;
+			dwWait = dwSpent < dwMilliseconds ? dwMilliseconds - dwSpent : 0;
+		}
+
+		if (::WaitForMultipleObjects(dwCount, &m_threads[i], TRUE, dwWait) == WAIT_TIMEOUT)
+			return false;
+	}
+
+	Close();
+	return true;
+}
+
+void WorkerThreads::Close()
+{
+	for (size_t i = 0; i < m_threads.size(); ++i)
+		::CloseHandle(m_threads[i]);
+	m_threads.clear();
+}
@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef WORKER_THREADS_H
+#define WORKER_THREADS_H
+
+#include <windows.h>
+#include <vector>
+
+// A set of threads that each run one member function of an object until it
+// returns. How the work is shared out between them is up to the object;
+// it must make every thread return before it goes away, and Wait() for them.
+class WorkerThreads
+{
+public:
+						WorkerThreads();
+						~WorkerThreads();
+
+	// Starts up to uCount threads calling (pObject->*Work)(), and returns
+	// whether any started. Those already started must have been waited for.
+	template <class T, void (T::*Work)()>
+	bool				Start(UINT32 uCount, T* pObject)
+	{
+		return StartThreads(uCount, &Entry<T, Work>, pObject);
+	}
+
+	// Whether they have all returned, waiting at most dwMilliseconds; once
+	// they have, there are none. Any number of threads can be waited for.
+	bool				Wait(DWORD dwMilliseconds);
+
+	UINT32				GetCount() const { return (UINT32)m_threads.size(); }
+	bool				IsEmpty() const { return m_threads.empty(); }
+
+private:
+	template <class T, void (T::*Work)()>
+	static DWORD WINAPI	Entry(LPVOID pParam)
+	{
+		(static_cast<T*>(pParam)->*Work)();
+		return 0;
+	}
+
+	bool				StartThreads(UINT32 uCount, LPTHREAD_START_ROUTINE pfnEntry, void* pParam);
+	void				Close();
+
+	std::vector<HANDLE>	m_threads;
+};
+
+#endif
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "XmbSettings.h"
+#include <stdio.h>
+#include <string.h>
+
+#define XMB_PROFILE_HEADER			"# PS3Ctrl XMB settings profile 1: key=value"
+#define XMB_PROFILE_MAX_LINE		(4096)
+
+namespace
+{
+	// Those the system software reads as it boots. The rest are read when a
+	// game starts or the setting's menu is opened, so take effect without a
+	// reset.
+	const char* g_apszResetKeyPrefixes[] =
+	{
+		"Network/",
+		"Display/",
+		"Sound/",
+		"Device/",
+		"System/matEnable",
+		"System/powerOnReset",
+		"System/wolDex",
+	};
+
+	std::string Trim(const std::string& str)
+	{
+		size_t uFirst = str.find_first_not_of(" \t\r\n");
+		if (uFirst == std::string::npos)
+			return "";
+		return str.substr(uFirst, str.find_last_not_of(" \t\r\n") - uFirst + 1);
+	}
+}
+
+SNRESULT GetXmbSettingString(HTARGET hTarget, bool bSync, std::string& strSettings)
+{
+	strSettings.clear();
+
+	UINT uSize = 0;
+	SNRESULT snr = SNPS3GetXMBSettings(hTarget, NULL, &uSize, bSync);
+	if (SN_FAILED(snr))
+		return snr;
+
+	// The size asked for includes the terminator. The settings are already
+	// cached by the first call, so the second reads the same ones.
+	std::vector<char> buffer(uSize + 1, '\0');
+	uSize = (UINT)buffer.size();
+	snr = SNPS3GetXMBSettings(hTarget, &buffer[0], &uSize, FALSE);
+	if (SN_FAILED(snr))
+		return snr;
+
+	buffer.back() = '\0';
+	strSettings = &buffer[0];
+	return snr;
+}
+
+SNRESULT GetXmbSettings(HTARGET hTarget, bool bSync, XmbSettingMap& settings)
+{
+	std::string strSettings;
+	SNRESULT snr = GetXmbSettingString(hTarget, bSync, strSettings);
+	if (SN_SUCCEEDED(snr))
+		ParseXmbSettings(strSettings.c_str(), settings);
+	return snr;
+}
+
+void ParseXmbSettings(const char* pszSettings, XmbSettingMap& settings)
+{
+	settings.clear();
+
+	std::string strSettings = pszSettings ? pszSettings : "";
+	std::string strLastKey;
+
+	size_t uStart = 0;
+	while (uStart <= strSettings.size())
+	{
+		size_t uEnd = strSettings.find(',', uStart);
+		if (uEnd == std::string::npos)
+			uEnd = strSettings.size();
+
+		std::string strPart = strSettings.substr(uStart, uEnd - uStart);
+		uStart = uEnd + 1;
+		if (Trim(strPart).empty())
+			continue;
+
+		size_t uEquals = strPart.find('=');
+		if (uEquals == std::string::npos || uEquals == 0)
+		{
+			if (!strLastKey.empty())
+				settings[strLastKey] = Trim(settings[strLastKey] + "," + strPart);
+			continue;
+		}
+
+		strLastKey = Trim(strPart.substr(0, uEquals));
+		if (!strLastKey.empty())
+			settings[strLastKey] = Trim(strPart.substr(uEquals + 1));
+	}
+}
+
+std::string FormatXmbSettings(const XmbSettingMap& settings)
+{
+	// The version says how to read the rest, so it goes first.
+	std::string strSettings;
+	XmbSettingMap::const_iterator version = settings.find(XMB_SETTINGS_VERSION_KEY);
+	if (version != settings.end())
+		strSettings = version->first + "=" + version->second;
+
+	for (XmbSettingMap::const_iterator it = settings.begin(); it != settings.end(); ++it)
+	{
+		if (it == version)
+			continue;
+		if (!strSettings.empty())
+			strSettings += ",";
+		strSettings += it->first + "=" + it->second;
+	}
+	return strSettings;
+}
+
+bool LoadXmbProfile(const WCHAR* pszPath, XmbSettingMap& settings, UINT32& uErrorLine)
+{
+	settings.clear();
+	uErrorLine = 0;
+
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszPath, L"r") != 0 || !pFile)
+		return false;
+
+	bool bOK = true;
+	UINT32 uLine = 0;
+	char szLine[XMB_PROFILE_MAX_LINE];
+	while (bOK && fgets(szLine, sizeof(szLine), pFile))
+	{
+		uLine++;
+
+		std::string strLine = Trim(szLine);
+		if (strLine.empty() || strLine[0] == '#')
+			continue;
+
+		size_t uEquals = strLine.find('=');
+		std::string strKey = uEquals == std::string::npos ? "" : Trim(strLine.substr(0, uEquals));
+		if (strKey.empty())
+		{
+			uErrorLine = uLine;
+			bOK = false;
+			continue;
+		}
+
+		settings[strKey] = Trim(strLine.substr(uEquals + 1));
+	}
+
+	fclose(pFile);
+	return bOK;
+}
+
+bool SaveXmbProfile(const WCHAR* pszPath, const XmbSettingMap& settings, const std::string& strSource)
+{
+	FILE* pFile = NULL;
+	if (_wfopen_s(&pFile, pszPath, L"w") != 0 || !pFile)
+		return false;
+
+	bool bOK = fprintf(pFile, "%s\n# From %s\n", XMB_PROFILE_HEADER, strSource.c_str()) > 0;
+	for (XmbSettingMap::const_iterator it = settings.begin(); it != settings.end() && bOK; ++it)
+		bOK = fprintf(pFile, "%s=%s\n", it->first.c_str(), it->second.c_str()) > 0;
+
+	if (fclose(pFile) != 0)
+		bOK = false;
+	return bOK;
+}
+
+void DiffXmbSettings(const XmbSettingMap& actual, const XmbSettingMap& golden, std::vector<XmbSettingChange>& changes)
+{
+	changes.clear();
+
+	for (XmbSettingMap::const_iterator it = golden.begin(); it != golden.end(); ++it)
+	{
+		// The version is of the format, not a setting.
+		if (it->first == XMB_SETTINGS_VERSION_KEY)
+			continue;
+
+		XmbSettingMap::const_iterator found = actual.find(it->first);
+		if (found != actual.end() && found->second == it->second)
+			continue;
+
+		XmbSettingChange change;
+		change.strKey = it->first;
+		change.strActual = found != actual.end() ? found->second : "";
+		change.strWanted = it->second;
+		change.bMissing = found == actual.end();
+		change.bNeedsReset = XmbSettingNeedsReset(it->first);
+		changes.push_back(change);
+	}
+}
+
+bool XmbSettingNeedsReset(const std::string& strKey)
+{
+	for (size_t i = 0; i < _countof(g_apszResetKeyPrefixes); ++i)
+	{
+		if (strKey.compare(0, strlen(g_apszResetKeyPrefixes[i]), g_apszResetKeyPrefixes[i]) == 0)
+			return true;
+	}
+	return false;
+}
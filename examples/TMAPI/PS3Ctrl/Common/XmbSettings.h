@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef XMB_SETTINGS_H
+#define XMB_SETTINGS_H
+
+#include <windows.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "TmapiTrace.h"
+
+// The XMB settings of a target as keys and values, such as
+// System/nickname=devkit01. TMAPI passes them as one string of
+// key1=value1,key2=value2; a profile on the host holds one key=value a line,
+// with # comments, so profiles diff and merge like any other text file.
+
+#define XMB_SETTINGS_VERSION_KEY	"version"
+
+typedef std::map<std::string, std::string> XmbSettingMap;
+
+struct XmbSettingChange
+{
+	std::string		strKey;
+	std::string		strActual;
+	std::string		strWanted;
+	bool			bMissing;			// The target does not have the key
+	bool			bNeedsReset;
+};
+
+// Reads them straight from the target if bSync, otherwise from Target
+// Manager's copy, sizing the buffer to fit.
+SNRESULT GetXmbSettingString(HTARGET hTarget, bool bSync, std::string& strSettings);
+SNRESULT GetXmbSettings(HTARGET hTarget, bool bSync, XmbSettingMap& settings);
+
+// Keys and values are trimmed. A value holding a comma comes back split, so
+// a part without an = is joined back onto the value before it.
+void ParseXmbSettings(const char* pszSettings, XmbSettingMap& settings);
+std::string FormatXmbSettings(const XmbSettingMap& settings);
+
+// The line of the first error is returned in uErrorLine, 0 if the file could
+// not be read.
+bool LoadXmbProfile(const WCHAR* pszPath, XmbSettingMap& settings, UINT32& uErrorLine);
+bool SaveXmbProfile(const WCHAR* pszPath, const XmbSettingMap& settings, const std::string& strSource);
+
+// A golden profile need only name the keys that matter, so only those are
+// compared; keys the target has that the profile does not are left alone.
+void DiffXmbSettings(const XmbSettingMap& actual, const XmbSettingMap& golden, std::vector<XmbSettingChange>& changes);
+
+// Whether the system software only takes up a new value of the key when it
+// next boots.
+bool XmbSettingNeedsReset(const std::string& strKey);
+
+#endif
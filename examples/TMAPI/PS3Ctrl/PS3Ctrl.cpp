@@ -28,6 +28,13 @@
 #include "SettingsCommand.h"
 #include "DeleteCommand.h"
 #include "ListCommand.h"
+#include "PadCommand.h"
+#include "FileTraceCommand.h"
+#include "DirCommand.h"
+#include "WatchCommand.h"
+#include "BreakCommand.h"
+#include "TtyLogCommand.h"
+#include "TmapiTrace.h"
 
 using namespace commandargutils;
 
@@ -80,6 +87,12 @@ int RunPs3Ctrl(std::vector<std::string>& arguments)
 	g_Commands.push_back(CommandType("settings"			, SettingsCommandFactory));
 	g_Commands.push_back(CommandType("delete"			, DeleteCommandFactory));
 	g_Commands.push_back(CommandType("list"				, ListCommandFactory));
+	g_Commands.push_back(CommandType("pad"				, PadCommandFactory));
+	g_Commands.push_back(CommandType("filetrace"		, FileTraceCommandFactory));
+	g_Commands.push_back(CommandType("dir"				, DirCommandFactory));
+	g_Commands.push_back(CommandType("watch"			, WatchCommandFactory));
+	g_Commands.push_back(CommandType("break"			, BreakCommandFactory));
+	g_Commands.push_back(CommandType("ttylog"			, TtyLogCommandFactory));
 
 	arguments.erase(arguments.begin()); // remove the program name from command line args
 
@@ -125,8 +138,12 @@ int RunPs3Ctrl(std::vector<std::string>& arguments)
 		}
 	}
 
+	TmapiTraceStart();
+
 	retVal = ExecuteTargetCommand(pTargetCommandObj, arguments);
 	delete pTargetCommandObj;
+
+	TmapiTraceStop();
 	
 	return retVal;
 }
@@ -0,0 +1,130 @@
+#########################################################################
+#
+# Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+#
+#########################################################################
+#
+# Generates the TMAPI call tracing tables from ps3tmapi.h:
+#
+#   Common/TmapiTraceFunctions.inl	TMAPI_TRACE_FUNCTION(name, (parameters), (arguments), bytes)
+#									for every SNAPI SNRESULT SNPS3* function
+#   Common/TmapiTraceRedirect.inl	#define SNPS3Xxx TmapiTrace_SNPS3Xxx for each of them
+#
+# Run it again whenever the SDK is updated:
+#
+#   python Tools/GenerateTmapiTrace.py ../../../sdk/include/ps3tmapi.h Common
+#
+# With --stubs <file> it also writes an implementation of every function
+# that returns SN_S_OK, so the tracing layer can be built and exercised
+# without the TMAPI DLL, including on Linux with a windows.h shim.
+
+import os
+import re
+import sys
+
+# Bytes moved by a call, as an expression of its parameters and snrTraced,
+# evaluated once the call has returned. Transfers that are queued and
+# completed later are counted by the size of the host file when queued;
+# downloads are not counted, since their size is not known until then.
+BYTES = {
+	'SNPS3ProcessGetMemory':			'SN_SUCCEEDED(snrTraced) && nCount > 0 ? (UINT64)nCount : 0',
+	'SNPS3ProcessSetMemory':			'SN_SUCCEEDED(snrTraced) && nCount > 0 ? (UINT64)nCount : 0',
+	'SNPS3ProcessScatteredSetMemory':	'SN_SUCCEEDED(snrTraced) ? (UINT64)uNumWrites * uWriteSize : 0',
+	'SNPS3GetMemoryCompressed':			'SN_SUCCEEDED(snrTraced) ? (UINT64)uSize : 0',
+	'SNPS3GetMemory64Compressed':		'SN_SUCCEEDED(snrTraced) ? (UINT64)uSize : 0',
+	'SNPS3GetVirtualMemoryInfo':		'SN_SUCCEEDED(snrTraced) && pBuffer && puBufferSize ? (UINT64)*puBufferSize : 0',
+	'SNPS3SendCustomProtocolData':		'SN_SUCCEEDED(snrTraced) ? (UINT64)uLength : 0',
+	'SNPS3UploadFile':					'SN_SUCCEEDED(snrTraced) ? TmapiTraceHostFileSize(pSource) : 0',
+	'SNPS3BDTransferImage':				'SN_SUCCEEDED(snrTraced) ? TmapiTraceHostFileSize(pszSourceFileName) : 0',
+}
+
+DECLARATION = re.compile(r'^SNAPI\s+SNRESULT\s+(SNPS3\w+)\s*\(([^;]*?)\)\s*;', re.M)
+PARAMETER_NAME = re.compile(r'(\w+)\s*(\[[^\]]*\])?$')
+
+# Locals of the wrappers in TmapiTrace.cpp, which no parameter may share.
+WRAPPER_LOCALS = ('uTraceStart', 'uTraceEnd', 'snrTraced')
+
+BANNER = '''/////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2013, Sony Computer Entertainment Inc. / SN Systems Limited
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Generated by Tools/GenerateTmapiTrace.py from ps3tmapi.h. Do not edit.
+
+'''
+
+def strip_comments(text):
+	text = re.sub(r'/\*.*?\*/', ' ', text, flags=re.S)
+	return re.sub(r'//[^\n]*', '', text)
+
+def parse(header):
+	functions = []
+	seen = set()
+	for match in DECLARATION.finditer(strip_comments(header)):
+		name = match.group(1)
+		if name in seen:
+			continue
+		seen.add(name)
+
+		parameters = ' '.join(match.group(2).split())
+		if parameters in ('', 'void'):
+			functions.append((name, '', []))
+			continue
+
+		arguments = []
+		for parameter in parameters.split(','):
+			found = PARAMETER_NAME.search(parameter.strip())
+			if not found:
+				raise ValueError('Cannot find the name of parameter "%s" of %s' % (parameter, name))
+			if found.group(1) in WRAPPER_LOCALS:
+				raise ValueError('Parameter "%s" of %s hides a local of the wrapper' % (found.group(1), name))
+			arguments.append(found.group(1))
+		functions.append((name, parameters, arguments))
+
+	return functions
+
+def write(path, text):
+	# The tree uses CRLF line endings.
+	with open(path, 'wb') as output:
+		output.write(text.replace('\n', '\r\n').encode('utf-8'))
+
+def main(args):
+	stubs = None
+	if '--stubs' in args:
+		index = args.index('--stubs')
+		stubs = args[index + 1]
+		del args[index:index + 2]
+
+	if len(args) != 2:
+		sys.stderr.write('Usage: GenerateTmapiTrace.py <ps3tmapi.h> <output directory> [--stubs <file>]\n')
+		return 1
+
+	with open(args[0], 'rb') as header:
+		functions = parse(header.read().decode('latin-1'))
+
+	unknown = set(BYTES) - set(name for name, parameters, arguments in functions)
+	if unknown:
+		sys.stderr.write('Byte counts given for functions not in the header: %s\n' % ', '.join(sorted(unknown)))
+		return 1
+
+	table = [BANNER]
+	redirect = [BANNER]
+	for name, parameters, arguments in functions:
+		table.append('TMAPI_TRACE_FUNCTION(%s, (%s), (%s), (%s))\n' % (name, parameters, ', '.join(arguments), BYTES.get(name, '0')))
+		redirect.append('#define %s TmapiTrace_%s\n' % (name, name))
+
+	write(os.path.join(args[1], 'TmapiTraceFunctions.inl'), ''.join(table))
+	write(os.path.join(args[1], 'TmapiTraceRedirect.inl'), ''.join(redirect))
+
+	if stubs:
+		lines = [BANNER, '#include "ps3tmapi.h"\n\n']
+		for name, parameters, arguments in functions:
+			lines.append('SNAPI SNRESULT %s(%s)\n{\n\treturn SN_S_OK;\n}\n\n' % (name, parameters))
+		write(stubs, ''.join(lines))
+
+	sys.stdout.write('%d functions, %d with byte counts\n' % (len(functions), len(BYTES)))
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv[1:]))
@@ -11,7 +11,6 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string>
-#include <time.h>
 #include <vector>
 
 #include "tmver.h"
@@ -223,8 +222,8 @@ static UINT								g_nNumTTYStreams = 0;
 static bool								g_bQuit = false;
 static int								g_nExitCode = PS3RUN_EXIT_OK;
 static std::wstring						g_TTYBuffer;
-static __time64_t						g_TimeoutTime = 0;
-static __time64_t						g_AbsoluteTimeoutTime = 0;
+static UINT64							g_TimeoutTime = 0;
+static UINT64							g_AbsoluteTimeoutTime = 0;
 static bool								g_bAbortTextFound = false;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -339,6 +338,23 @@ static void PrintError(SNRESULT snr, const WCHAR* pszMessage, ...)
 
 }
 
+//////////////////////////////////////////////////////////////////////////////
+///  @anchor    GetMonotonicMilliseconds
+///  @brief     Milliseconds from a clock that is not changed by adjusting
+///             the system time, unlike _time64.
+//////////////////////////////////////////////////////////////////////////////
+
+static UINT64 GetMonotonicMilliseconds()
+{
+	static LARGE_INTEGER s_frequency = { 0 };
+	if (s_frequency.QuadPart == 0)
+		::QueryPerformanceFrequency(&s_frequency);
+
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return (UINT64)(now.QuadPart / s_frequency.QuadPart * 1000 + now.QuadPart % s_frequency.QuadPart * 1000 / s_frequency.QuadPart);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 ///  @anchor    UpdateTimeout
 ///  @brief     Update the timeout time.
@@ -348,12 +364,11 @@ static void UpdateTimeout()
 {
 	if (g_TargetOpt.nCmdFlags & PS3RUN_CMD_CHECK_REL_TIMEOUT)
 	{
-		__time64_t uNow;
-		_time64(&uNow);
+		UINT64 uNow = GetMonotonicMilliseconds();
 
 		// Comment out this line if you want an absolute timeout
 		// rather than relative to the last event.
-		g_TimeoutTime = uNow + g_TargetOpt.uTimeoutDuration;
+		g_TimeoutTime = uNow + g_TargetOpt.uTimeoutDuration * 1000;
 	}
 }
 
@@ -369,8 +384,7 @@ static void CheckTimeout()
 
 	if (g_TargetOpt.nCmdFlags & (PS3RUN_CMD_CHECK_REL_TIMEOUT|PS3RUN_CMD_CHECK_ABS_TIMEOUT))
 	{
-		__time64_t uNow;
-		_time64(&uNow);
+		UINT64 uNow = GetMonotonicMilliseconds();
 
 		if ((g_TargetOpt.nCmdFlags&PS3RUN_CMD_CHECK_REL_TIMEOUT) && uNow > g_TimeoutTime)
 		{
@@ -1981,8 +1995,7 @@ static bool ProcessEvents(void)
 	// Initialize the the timeout time
 	if (g_TargetOpt.nCmdFlags & PS3RUN_CMD_CHECK_REL_TIMEOUT) 
 	{
-		 _time64(&g_TimeoutTime);
-		 g_TimeoutTime += g_TargetOpt.uTimeoutDuration;
+		 g_TimeoutTime = GetMonotonicMilliseconds() + g_TargetOpt.uTimeoutDuration * 1000;
 	}
 
 	if (IS_VERBOSE)
@@ -2474,8 +2487,7 @@ static int ProcessCmdLine(void)
 	// Initialize the (absolute) timeout
 	if (g_TargetOpt.nCmdFlags & PS3RUN_CMD_CHECK_ABS_TIMEOUT)
 	{
-		_time64(&g_AbsoluteTimeoutTime);
-		g_AbsoluteTimeoutTime += g_TargetOpt.uAbsTimeoutDuration;
+		g_AbsoluteTimeoutTime = GetMonotonicMilliseconds() + g_TargetOpt.uAbsTimeoutDuration * 1000;
 	}
 
 	// Check if we've registered for any events.
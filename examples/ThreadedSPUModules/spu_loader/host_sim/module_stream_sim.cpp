@@ -0,0 +1,462 @@
+/*
+*  Description:
+*  Host simulation of the double buffered module loader (module_stream.h).
+*  Local store and main memory are host buffers and the MFC is modelled with
+*  a latency and a bandwidth shared by all tags; data only lands in local
+*  store when the loader waits on its tag, so code that runs or validates a
+*  module before waiting sees stale bytes. Fake modules check their own image
+*  and BSS when called, then burn modelled time.
+*
+*  Build:
+*    g++ -std=c++11 -O2 -I.. -I../../../../spu/include/sn module_stream_sim.cpp -o module_stream_sim
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+static void			sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag);
+static void			sim_wait(uint32_t tag);
+static uint32_t		sim_time();
+static uint32_t		sim_call(const uint8_t *ls);
+
+#define MS_GET(ls, ea, size, tag)		sim_get((ls), (ea), (size), (tag))
+#define MS_WAIT(tag)					sim_wait(tag)
+#define MS_TIME()						sim_time()
+#define MS_CALL(ls)						sim_call(ls)
+
+#include "module_stream.h"
+
+static const uint32_t LS_SIZE			= 256 * 1024;
+static const uint32_t SLOT_SIZE			= 48 * 1024;
+static const uint64_t EA_BASE			= 0x100000;
+static const uint32_t MAIN_SIZE			= 4 * 1024 * 1024;
+static const uint32_t MODULE_MAGIC		= 0x4d4f4453;		// 'MODS'
+static const uint32_t MARKER			= 0x534e4d48;
+static const uint8_t  STALE				= 0xcd;
+
+// What a fake module has at its entry point.
+struct FakeCode
+{
+	uint32_t	magic;
+	uint32_t	result;
+	uint32_t	work_ns;
+	uint32_t	image_size;		//bytes covered by checksum, from the start of the image
+	uint32_t	checksum;
+	uint32_t	bss_start;		//0 if none
+	uint32_t	bss_size;
+	uint32_t	pad;
+};
+
+struct SimDma
+{
+	uint8_t*	ls;
+	uint64_t	ea;
+	uint32_t	size;
+	uint32_t	tag;
+	uint64_t	done;
+};
+
+struct Sim
+{
+	std::vector<uint8_t>	ls;
+	std::vector<uint8_t>	main;
+	std::vector<SimDma>		pending;
+	uint64_t				now;			//ns
+	uint64_t				channel_free;
+	uint32_t				latency_ns;
+	uint32_t				bytes_per_ns;
+	uint32_t				calls;
+	uint32_t				errors;
+};
+
+static Sim g_sim;
+static ModuleStream g_stream;		//stands in for the loader's own local store variables
+
+static void fail(const char *message)
+{
+	printf("FAILED: %s\n", message);
+	exit(1);
+}
+
+static uint8_t* main_at(uint64_t ea, uint32_t size)
+{
+	if (ea < EA_BASE || ea + size > EA_BASE + g_sim.main.size())
+		fail("DMA outside main memory");
+	return &g_sim.main[ea - EA_BASE];
+}
+
+static void sim_get(void *ls, uint64_t ea, uint32_t size, uint32_t tag)
+{
+	uint8_t *p = (uint8_t*)ls;
+	SimDma dma;
+
+	if (size == 0 || size > MS_DMA_MAX || (size & 15) || ((uintptr_t)p & 15) || (ea & 15))
+		fail("DMA size or alignment");
+	if ((p < g_sim.ls.data() || p + size > g_sim.ls.data() + g_sim.ls.size())
+		&& (p < (uint8_t*)&g_stream || p + size > (uint8_t*)(&g_stream + 1)))
+		fail("DMA outside local store");
+	main_at(ea, size);
+
+	uint64_t start = g_sim.now > g_sim.channel_free ? g_sim.now : g_sim.channel_free;
+	g_sim.channel_free = start + size / g_sim.bytes_per_ns;
+
+	dma.ls = p;
+	dma.ea = ea;
+	dma.size = size;
+	dma.tag = tag;
+	dma.done = g_sim.channel_free + g_sim.latency_ns;
+	g_sim.pending.push_back(dma);
+}
+
+static void sim_wait(uint32_t tag)
+{
+	for (size_t i = 0; i < g_sim.pending.size(); )
+	{
+		SimDma &dma = g_sim.pending[i];
+		if (dma.tag != tag)
+		{
+			i++;
+			continue;
+		}
+		if (dma.done > g_sim.now)
+			g_sim.now = dma.done;
+		memcpy(dma.ls, main_at(dma.ea, dma.size), dma.size);
+		g_sim.pending.erase(g_sim.pending.begin() + i);
+	}
+}
+
+static uint32_t sim_time()
+{
+	return (uint32_t)g_sim.now;
+}
+
+static uint32_t checksum(const uint8_t *data, uint32_t size, uint32_t skip_offset)
+{
+	uint32_t sum = 2166136261u;
+	for (uint32_t i = 0; i < size; i++)
+	{
+		//The checksum field itself is not covered...
+		uint8_t byte = (i >= skip_offset && i < skip_offset + 4) ? 0 : data[i];
+		sum = (sum ^ byte) * 16777619u;
+	}
+	return sum;
+}
+
+static uint32_t sim_call(const uint8_t *ls)
+{
+	FakeCode code;
+	const uint8_t *image;
+	uint32_t entry;
+
+	memcpy(&code, ls, sizeof(code));
+	g_sim.calls++;
+
+	if (code.magic != MODULE_MAGIC)
+		fail("called a module that has not arrived");
+
+	//Find the slot this module runs from...
+	image = ls - (ls - g_sim.ls.data()) % SLOT_SIZE;
+	entry = (uint32_t)(ls - image);
+
+	for (size_t i = 0; i < g_sim.pending.size(); i++)
+	{
+		const SimDma &dma = g_sim.pending[i];
+		if (dma.ls < image + SLOT_SIZE && dma.ls + dma.size > image)
+			fail("DMA in flight into the slot of a running module");
+	}
+
+	if (checksum(image, code.image_size, entry + offsetof(FakeCode, checksum)) != code.checksum)
+		fail("module image corrupt");
+
+	if (code.bss_size)
+	{
+		uint8_t *bss = (uint8_t*)image + code.bss_start;
+		for (uint32_t i = 0; i < code.bss_size; i++)
+			if (bss[i])
+				fail("BSS not cleared");
+		//Leave it dirty so a later load into this slot has to clear it again...
+		memset(bss, 0x5a, code.bss_size);
+	}
+
+	g_sim.now += code.work_ns;
+	return code.result;
+}
+
+//
+// Module images
+//
+
+struct ModuleSpec
+{
+	uint32_t	size;
+	uint32_t	work_ns;
+	bool		header;
+	uint32_t	bss_start;
+	uint32_t	bss_size;
+	uint32_t	result;
+	int			corrupt;		//expected status if not MS_STATUS_OK
+};
+
+struct Image
+{
+	uint64_t	ea;
+	uint32_t	size;
+	uint32_t	entry;
+};
+
+static uint64_t g_next_ea;
+
+static Image make_image(const ModuleSpec &spec)
+{
+	Image image;
+	uint8_t *p;
+	FakeCode code;
+
+	image.ea = g_next_ea;
+	image.size = spec.size;
+	image.entry = spec.header ? 0x20 : 0x10;
+	g_next_ea += (spec.size + 127) & ~127;
+	if (g_next_ea > EA_BASE + MAIN_SIZE)
+		fail("out of simulated main memory");
+
+	p = main_at(image.ea, spec.size);
+	for (uint32_t i = 0; i < spec.size; i++)
+		p[i] = (uint8_t)(i * 7 + spec.result);
+
+	if (spec.header)
+	{
+		spu_mod_hdr header;
+		header.mark1 = MARKER;
+		header.rand1 = rand();
+		header.rand2 = rand();
+		header.mark2 = MARKER;
+		header.entry = image.entry;
+		header.bss_start = spec.bss_start;
+		header.bss_size = spec.bss_size;
+		header.pad = 0;
+
+		if (spec.corrupt == MS_STATUS_BAD_MARKERS)
+			header.mark2 ^= 1;
+		else if (spec.corrupt == MS_STATUS_BAD_ENTRY)
+			header.entry = spec.size + 64;
+		else if (spec.corrupt == MS_STATUS_BAD_BSS)
+			header.bss_size = SLOT_SIZE;
+		memcpy(p, &header, sizeof(header));
+	}
+	else
+	{
+		memset(p, 0x47, 16);		//SPU GUID
+	}
+
+	code.magic = MODULE_MAGIC;
+	code.result = spec.result;
+	code.work_ns = spec.work_ns;
+	code.image_size = spec.bss_size && spec.bss_start < spec.size ? spec.bss_start : spec.size;
+	code.checksum = 0;
+	code.bss_start = spec.header ? spec.bss_start : 0;
+	code.bss_size = spec.header ? spec.bss_size : 0;
+	code.pad = 0;
+	memcpy(p + image.entry, &code, sizeof(code));
+	code.checksum = checksum(p, code.image_size, image.entry + offsetof(FakeCode, checksum));
+	memcpy(p + image.entry, &code, sizeof(code));
+
+	return image;
+}
+
+struct RunResult
+{
+	uint32_t	total;
+	uint64_t	elapsed_ns;
+	uint64_t	stall_ns;
+	uint64_t	exec_ns;
+	uint64_t	load_ns;
+	std::vector<ModuleStreamStats> stats;
+};
+
+static RunResult run_list(const std::vector<ModuleSpec> &specs, bool prefetch, uint32_t latency_ns, uint32_t bytes_per_ns)
+{
+	std::vector<Image> images;
+	RunResult result;
+	uint64_t ea_list, ea_zero;
+
+	g_sim.ls.assign(LS_SIZE, STALE);
+	g_sim.main.assign(MAIN_SIZE, 0);
+	g_sim.pending.clear();
+	g_sim.now = 0;
+	g_sim.channel_free = 0;
+	g_sim.latency_ns = latency_ns;
+	g_sim.bytes_per_ns = bytes_per_ns;
+	g_sim.calls = 0;
+
+	ea_zero = EA_BASE;
+	ea_list = EA_BASE + MS_ZERO_BLOCK_SIZE;
+	g_next_ea = ea_list + ((MS_MAX_MODULES * sizeof(ModuleStreamDesc) + 127) & ~127);
+
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		Image image = make_image(specs[i]);
+		ModuleStreamDesc desc;
+
+		desc.ea = (uint32_t)image.ea;
+		desc.size = image.size;
+		desc.entry = image.entry;
+		desc.flags = specs[i].header ? MS_MODULE_HEADER : 0;
+		memcpy(main_at(ea_list + i * sizeof(desc), sizeof(desc)), &desc, sizeof(desc));
+	}
+
+	//The slots live in the simulated local store...
+	if (ms_init(&g_stream, ea_list, (uint32_t)specs.size(), ea_zero, &g_sim.ls[SLOT_SIZE], &g_sim.ls[SLOT_SIZE * 2], SLOT_SIZE) != 0)
+		fail("ms_init");
+	g_stream.prefetch = prefetch;
+
+	uint64_t start = g_sim.now;
+	result.total = ms_run(&g_stream);
+	result.elapsed_ns = g_sim.now - start;
+
+	if (!g_sim.pending.empty())
+		fail("DMA left in flight after the run");
+
+	result.stall_ns = result.exec_ns = result.load_ns = 0;
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		result.stats.push_back(g_stream.stats[i]);
+		result.stall_ns += g_stream.stats[i].stall_ticks;
+		result.exec_ns += g_stream.stats[i].exec_ticks;
+		result.load_ns += g_stream.stats[i].load_ticks;
+	}
+
+	return result;
+}
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("check failed: %s\n", message);
+		g_sim.errors++;
+	}
+}
+
+static void testCorrectness()
+{
+	std::vector<ModuleSpec> specs;
+	uint32_t expected = 0;
+
+	//Plain and header modules, sizes over one DMA, unaligned and zero BSS...
+	const ModuleSpec list[] =
+	{
+		{ 1280,		2000,	false,	0,		0,		11,		MS_STATUS_OK },
+		{ 4096,		3000,	true,	3000,	1000,	22,		MS_STATUS_OK },
+		{ 40000,	5000,	true,	20013,	9003,	33,		MS_STATUS_OK },
+		{ 640,		100,	true,	256,	0,		44,		MS_STATUS_OK },
+		{ 1024,		1000,	true,	1024,	40000,	55,		MS_STATUS_OK },		//BSS past the image
+		{ 32768,	2000,	false,	0,		0,		66,		MS_STATUS_OK },
+		{ 2048,		1000,	true,	1037,	3,		77,		MS_STATUS_OK },		//tiny, unaligned
+	};
+
+	for (int pass = 0; pass < 3; pass++)
+	{
+		for (size_t i = 0; i < sizeof(list) / sizeof(list[0]); i++)
+		{
+			specs.push_back(list[i]);
+			expected += list[i].result;
+		}
+	}
+
+	for (int prefetch = 0; prefetch < 2; prefetch++)
+	{
+		RunResult r = run_list(specs, prefetch != 0, 500, 8);
+		check(r.total == expected, "sum of module results");
+		check(g_sim.calls == specs.size(), "every module ran");
+		for (size_t i = 0; i < r.stats.size(); i++)
+		{
+			check(r.stats[i].status == MS_STATUS_OK, "module status");
+			check(r.stats[i].result == specs[i].result, "module result");
+			check(r.stats[i].bss_size == (specs[i].header ? specs[i].bss_size : 0), "bss size");
+		}
+	}
+}
+
+static void testValidation()
+{
+	const ModuleSpec list[] =
+	{
+		{ 2048,		1000,	true,	1024,	512,	1,		MS_STATUS_OK },
+		{ 2048,		1000,	true,	1024,	512,	2,		MS_STATUS_BAD_MARKERS },
+		{ 2048,		1000,	true,	1024,	512,	4,		MS_STATUS_OK },
+		{ 2048,		1000,	true,	1024,	512,	8,		MS_STATUS_BAD_ENTRY },
+		{ 2048,		1000,	true,	1024,	512,	16,		MS_STATUS_BAD_BSS },
+		{ SLOT_SIZE + 128, 1000, false,	0,	0,		32,		MS_STATUS_TOO_LARGE },
+		{ 2048,		1000,	false,	0,		0,		64,		MS_STATUS_OK },
+		{ SLOT_SIZE + 128, 1000, false,	0,	0,		128,	MS_STATUS_TOO_LARGE },
+		{ 2048,		1000,	true,	1024,	512,	256,	MS_STATUS_OK },
+	};
+	std::vector<ModuleSpec> specs(list, list + sizeof(list) / sizeof(list[0]));
+
+	for (int prefetch = 0; prefetch < 2; prefetch++)
+	{
+		RunResult r = run_list(specs, prefetch != 0, 500, 8);
+		check(r.total == 1 + 4 + 64 + 256, "only valid modules ran");
+		for (size_t i = 0; i < specs.size(); i++)
+			check(r.stats[i].status == (uint32_t)specs[i].corrupt, "rejected with the right status");
+	}
+}
+
+static void benchmark(uint32_t modules, uint32_t size, uint32_t work_ns, uint32_t bytes_per_ns)
+{
+	std::vector<ModuleSpec> specs;
+	RunResult r[2];
+
+	for (uint32_t i = 0; i < modules; i++)
+	{
+		ModuleSpec spec = { size, work_ns, true, size - 256, 4096, i + 1, MS_STATUS_OK };
+		specs.push_back(spec);
+	}
+
+	r[0] = run_list(specs, false, 500, bytes_per_ns);
+	r[1] = run_list(specs, true, 500, bytes_per_ns);
+	check(r[0].total == r[1].total, "serial and double buffered results agree");
+
+	for (int i = 0; i < 2; i++)
+	{
+		printf("  %-15s %3u x %6u byte modules, %6u ns work: %9.1f us total, %8.1f us stalled, %8.1f us executing, %5.1f%% stalled\n",
+			i ? "double buffered" : "serial", modules, size, work_ns,
+			r[i].elapsed_ns / 1000.0, r[i].stall_ns / 1000.0, r[i].exec_ns / 1000.0,
+			100.0 * r[i].stall_ns / r[i].elapsed_ns);
+	}
+	printf("  speedup %.2fx\n", (double)r[0].elapsed_ns / r[1].elapsed_ns);
+
+	//With loads no longer than the work, only the first load is exposed...
+	if (r[1].stall_ns > 0 && (uint64_t)size / bytes_per_ns + 500 < work_ns)
+		check(r[1].stall_ns <= r[1].stats[0].stall_ticks + modules * 16, "only the first load stalls when loads fit under the work");
+	check(r[1].elapsed_ns <= r[0].elapsed_ns, "double buffering is never slower");
+}
+
+int main()
+{
+	srand(1);
+
+	printf("correctness\n");
+	testCorrectness();
+
+	printf("validation\n");
+	testValidation();
+
+	printf("overlap\n");
+	benchmark(32, 16384, 20000, 8);		//load shorter than the work
+	benchmark(32, 32768, 1024, 8);		//load dominates
+	benchmark(32, 8192, 1024, 8);		//balanced
+
+	if (g_sim.errors)
+	{
+		printf("%u checks failed\n", g_sim.errors);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,285 @@
+#ifndef __MODULE_STREAM_H__
+#define __MODULE_STREAM_H__
+
+// Streams a list of code modules through two local store slots: while
+// module N runs from one slot, module N+1 is fetched into the other on its
+// own tag, so the loader only waits for code the DMA has not yet delivered.
+//
+// The PPU passes a list of ModuleStreamDesc entries and gets a
+// ModuleStreamStats entry back for each. A module either starts with an
+// spu_mod_hdr (MS_MODULE_HEADER), whose markers are checked and whose BSS
+// is cleared before it runs, or is a plain image with the entry point offset
+// given in its descriptor, as the threaded modules in this sample are.
+//
+// The types are shared with the PPU. The loader itself is written against
+// primitives the includer defines, so it builds for the SPU and for the host
+// simulation in host_sim/:
+//
+//	MS_GET(ls, ea, size, tag)		start a DMA of up to MS_DMA_MAX bytes into local store
+//	MS_WAIT(tag)					wait for all DMAs on tag
+//	MS_TIME()						32 bit time stamp that counts up
+//	MS_CALL(ls)						run the module entry point at ls, returns its result
+
+#include <stdint.h>
+
+#define MS_MAX_MODULES			64
+#define MS_SLOTS				2
+#define MS_TAG_SLOT				0		//slot n loads on tag MS_TAG_SLOT + n
+#define MS_TAG_LIST				2
+#define MS_DMA_MAX				16384
+#define MS_ZERO_BLOCK_SIZE		16384	//zeroed, 128 byte aligned block the PPU provides for BSS clears
+
+#define MS_MODULE_HEADER		0x1		//image starts with an spu_mod_hdr
+
+#define MS_STATUS_OK			0
+#define MS_STATUS_TOO_LARGE		1		//does not fit a slot, or is not 16 byte aligned
+#define MS_STATUS_BAD_MARKERS	2
+#define MS_STATUS_BAD_ENTRY		3
+#define MS_STATUS_BAD_BSS		4
+
+typedef struct ModuleStreamDesc
+{
+	uint32_t	ea;				//128 byte aligned
+	uint32_t	size;			//bytes, rounded up to 16 when loaded
+	uint32_t	entry;			//entry point offset, ignored with MS_MODULE_HEADER
+	uint32_t	flags;
+
+} ModuleStreamDesc;
+
+typedef struct ModuleStreamStats
+{
+	uint32_t	load_ticks;		//from issuing the load to the loader seeing it complete
+	uint32_t	stall_ticks;	//of those, time the loader spent waiting
+	uint32_t	bss_ticks;
+	uint32_t	exec_ticks;
+	uint32_t	result;
+	uint32_t	status;
+	uint32_t	bss_size;
+	uint32_t	pad;
+
+} ModuleStreamStats;
+
+#ifdef MS_GET
+
+#ifdef __SPU__
+#include <libsn_spu.h>
+#else
+#include "LibSN_Module.h"
+#endif
+
+typedef struct ModuleStream
+{
+	ModuleStreamDesc	modules[MS_MAX_MODULES] __attribute__((__aligned__(128)));
+	ModuleStreamStats	stats[MS_MAX_MODULES] __attribute__((__aligned__(128)));
+	uint32_t			count;
+
+	uint8_t*			slot[MS_SLOTS];
+	uint32_t			slot_capacity;
+	uint32_t			issue_time[MS_SLOTS];
+
+	uint64_t			ea_zero;
+	int					prefetch;		//load the next module while one runs
+
+} ModuleStream;
+
+static inline uint32_t ms_image_size(const ModuleStreamDesc *module)
+{
+	return (module->size + 15) & ~15;
+}
+
+static inline void ms_get_large(void *ls, uint64_t ea, uint32_t size, uint32_t tag)
+{
+	while (size)
+	{
+		uint32_t chunk = size < MS_DMA_MAX ? size : MS_DMA_MAX;
+		MS_GET(ls, ea, chunk, tag);
+		ls = (uint8_t*)ls + chunk;
+		ea += chunk;
+		size -= chunk;
+	}
+}
+
+// Zeroes size bytes at ls by DMA from the PPU's zero block; only the
+// unaligned ends, at most 15 bytes each, are stored directly.
+static inline void ms_clear(ModuleStream *s, uint8_t *ls, uint32_t size, uint32_t tag)
+{
+	uint32_t head = (uint32_t)(-(uintptr_t)ls & 15);
+
+	if (head > size)
+		head = size;
+	size -= head;
+	while (head--)
+		*ls++ = 0;
+
+	while (size >= 16)
+	{
+		uint32_t chunk = size & ~15;
+		if (chunk > MS_ZERO_BLOCK_SIZE)
+			chunk = MS_ZERO_BLOCK_SIZE;
+		MS_GET(ls, s->ea_zero, chunk, tag);
+		ls += chunk;
+		size -= chunk;
+	}
+
+	while (size--)
+		*ls++ = 0;
+}
+
+// Fetches the module list; ea_list and count come from the PPU.
+static inline int ms_init(ModuleStream *s, uint64_t ea_list, uint32_t count, uint64_t ea_zero, void *slot0, void *slot1, uint32_t slot_capacity)
+{
+	if (count > MS_MAX_MODULES || (ea_list & 15) || (ea_zero & 15))
+		return -1;
+
+	s->count = count;
+	s->slot[0] = (uint8_t*)slot0;
+	s->slot[1] = (uint8_t*)slot1;
+	s->slot_capacity = slot_capacity;
+	s->issue_time[0] = 0;
+	s->issue_time[1] = 0;
+	s->ea_zero = ea_zero;
+	s->prefetch = 1;
+
+	if (count)
+	{
+		ms_get_large(s->modules, ea_list, count * sizeof(ModuleStreamDesc), MS_TAG_LIST);
+		MS_WAIT(MS_TAG_LIST);
+	}
+
+	return 0;
+}
+
+static inline void ms_start_load(ModuleStream *s, uint32_t index)
+{
+	const ModuleStreamDesc *module = &s->modules[index];
+	uint32_t slot = index & 1;
+	uint32_t size = ms_image_size(module);
+
+	if (size == 0 || size > s->slot_capacity || (module->ea & 15))
+	{
+		s->stats[index].status = MS_STATUS_TOO_LARGE;
+		return;
+	}
+
+	s->issue_time[slot] = MS_TIME();
+	ms_get_large(s->slot[slot], module->ea, size, MS_TAG_SLOT + slot);
+}
+
+// Checks a loaded module and returns its entry and BSS range, relative to
+// the start of the slot.
+static inline uint32_t ms_validate(const ModuleStream *s, uint32_t index, uint32_t *entry, uint32_t *bss_start, uint32_t *bss_size)
+{
+	const ModuleStreamDesc *module = &s->modules[index];
+	const uint8_t *image = s->slot[index & 1];
+	uint32_t size = ms_image_size(module);
+
+	*bss_start = 0;
+	*bss_size = 0;
+
+	if (module->flags & MS_MODULE_HEADER)
+	{
+		const spu_mod_hdr *header = (const spu_mod_hdr*)image;
+
+		if (size < sizeof(spu_mod_hdr) || header->mark1 == 0 || header->mark1 != header->mark2)
+			return MS_STATUS_BAD_MARKERS;
+
+		*entry = header->entry;
+		if (*entry < sizeof(spu_mod_hdr))
+			return MS_STATUS_BAD_ENTRY;
+
+		if (header->bss_size)
+		{
+			if (header->bss_start < sizeof(spu_mod_hdr) || header->bss_start > s->slot_capacity
+				|| header->bss_size > s->slot_capacity - header->bss_start)
+				return MS_STATUS_BAD_BSS;
+
+			*bss_start = header->bss_start;
+			*bss_size = header->bss_size;
+		}
+	}
+	else
+	{
+		*entry = module->entry;
+	}
+
+	if (*entry >= size || (*entry & 3))
+		return MS_STATUS_BAD_ENTRY;
+
+	return MS_STATUS_OK;
+}
+
+// Runs every module in the list in order and returns the sum of their
+// results. Per module statistics are left in s->stats.
+static inline uint32_t ms_run(ModuleStream *s)
+{
+	uint32_t total = 0;
+	uint32_t i;
+
+	for (i = 0; i < s->count; i++)
+		s->stats[i].status = MS_STATUS_OK;
+
+	if (s->count && s->prefetch)
+		ms_start_load(s, 0);
+
+	for (i = 0; i < s->count; i++)
+	{
+		ModuleStreamStats *stats = &s->stats[i];
+		uint32_t slot = i & 1;
+		uint32_t tag = MS_TAG_SLOT + slot;
+		uint32_t entry = 0, bss_start = 0, bss_size = 0;
+		uint32_t start, ready;
+
+		stats->load_ticks = 0;
+		stats->stall_ticks = 0;
+		stats->bss_ticks = 0;
+		stats->exec_ticks = 0;
+		stats->result = 0;
+		stats->bss_size = 0;
+
+		if (!s->prefetch)
+			ms_start_load(s, i);
+
+		if (stats->status == MS_STATUS_OK)
+		{
+			start = MS_TIME();
+			MS_WAIT(tag);
+			ready = MS_TIME();
+			stats->stall_ticks = ready - start;
+			stats->load_ticks = ready - s->issue_time[slot];
+
+			stats->status = ms_validate(s, i, &entry, &bss_start, &bss_size);
+		}
+
+		if (stats->status == MS_STATUS_OK && bss_size)
+		{
+			start = MS_TIME();
+			ms_clear(s, s->slot[slot] + bss_start, bss_size, tag);
+			stats->bss_size = bss_size;
+		}
+
+		//The other slot's module has finished, so its slot can be refilled...
+		if (s->prefetch && i + 1 < s->count)
+			ms_start_load(s, i + 1);
+
+		if (stats->status != MS_STATUS_OK)
+			continue;
+
+		if (bss_size)
+		{
+			MS_WAIT(tag);
+			stats->bss_ticks = MS_TIME() - start;
+		}
+
+		start = MS_TIME();
+		stats->result = MS_CALL(s->slot[slot] + entry);
+		stats->exec_ticks = MS_TIME() - start;
+
+		total += stats->result;
+	}
+
+	return total;
+}
+
+#endif //#ifdef MS_GET
+
+#endif //#ifndef __MODULE_STREAM_H__
@@ -15,51 +15,45 @@
 
 typedef qword uint128_t;
 
-#define BUF_SIZE  1280
+#define SLOT_SIZE  (16 * 1024)
 
-unsigned int dma_buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
-unsigned int code1Buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
-unsigned int code2Buffer[BUF_SIZE / sizeof(unsigned int)]__attribute__((aligned(128)));
+#define MS_GET(ls, ea, size, tag)	spu_mfcdma64((ls), (unsigned int)((ea) >> 32), (unsigned int)(ea), (size), (tag), MFC_GET_CMD)
+#define MS_WAIT(tag)				(spu_writech(MFC_WrTagMask, 1 << (tag)), spu_mfcstat(MFC_TAG_UPDATE_ALL))
+#define MS_TIME()					(0 - spu_readch(SPU_RdDec))
+#define MS_CALL(ls)					(spu_sync(), ((LoadedFunc)(ls))())
 
-void DmaIn( void* spu_addr, unsigned int ydram_addr, unsigned int length, unsigned int id )
-{
-	spu_mfcdma64( spu_addr, 0, ydram_addr, length, id, MFC_GET_CMD);
-}
+typedef unsigned int (*LoadedFunc)( void );
 
-void DmaStall( void )
-{
-	spu_writech(MFC_WrTagMask, 0xFFFFFFFF);
-	spu_mfcstat(2);
-}
+#include "module_stream.h"
+
+unsigned char codeSlot0[SLOT_SIZE]__attribute__((aligned(128)));
+unsigned char codeSlot1[SLOT_SIZE]__attribute__((aligned(128)));
+
+ModuleStream stream;
 
 int main(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
 {
 	//Read pointers passed from PPU.
-	unsigned int code1Addr = arg1;
-	unsigned int code1Size = arg2;
-	unsigned int code2Addr = arg3;
-	unsigned int code2Size = arg4;
-
-	//DMA modules into SPU memory...
-	DmaIn( code1Buffer, code1Addr, code1Size, 0 );
-	DmaIn( code2Buffer, code2Addr, code2Size, 1 );
-	DmaStall();
-
-	//Get pointers to module entry points...
-	typedef unsigned int (*LoadedFunc)( void );
-
-	unsigned int uCode1Entry = (unsigned int)code1Buffer + 0x10;// + sizeof spuGUID section
-	unsigned int uCode2Entry = (unsigned int)code2Buffer + 0x10;// + sizeof spuGUID section
-
-	LoadedFunc loadedFuncPtr1 = (LoadedFunc) (uCode1Entry);
-	LoadedFunc loadedFuncPtr2 = (LoadedFunc) (uCode2Entry);
-
-	//Call modules...
-	unsigned int ret1 = loadedFuncPtr1();
-	unsigned int ret2 = loadedFuncPtr2();
-
-	//Add up the return values...
-	unsigned int total = ret1 + ret2;
+	unsigned int moduleListAddr = arg1;
+	unsigned int moduleCount = arg2;
+	unsigned int zeroBlockAddr = arg3;
+	unsigned int statsAddr = arg4;
+
+	//Run the decrementer so module load and run times can be reported...
+	spu_writech(SPU_WrDec, 0xFFFFFFFF);
+
+	if (ms_init(&stream, moduleListAddr, moduleCount, zeroBlockAddr, codeSlot0, codeSlot1, SLOT_SIZE) != 0)
+		sys_spu_thread_exit(-1);
+
+	//Each module is fetched into one slot while the previous one runs from the other...
+	unsigned int total = ms_run(&stream);
+
+	//Send the per module timings back...
+	if (moduleCount)
+	{
+		spu_mfcdma64(stream.stats, 0, statsAddr, moduleCount * sizeof(ModuleStreamStats), MS_TAG_LIST, MFC_PUT_CMD);
+		MS_WAIT(MS_TAG_LIST);
+	}
 
 	//Return result to ppu in exit status
 	sys_spu_thread_exit(total);
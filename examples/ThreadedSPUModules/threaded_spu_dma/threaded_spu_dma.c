@@ -17,9 +17,11 @@
 #include <sys/ppu_thread.h>
 #include <sys/interrupt.h>
 #include <sys/spu_thread_group.h>
+#include "../spu_loader/module_stream.h"
 
 #define NUM_SPU_THREADS	1
 #define PRIORITY            100
+#define NUM_PASSES			4		//times the module pair is streamed through the loader
 
 #define SPU_PROG	"/app_home/spu_loader.elf"
 
@@ -39,6 +41,23 @@ extern const char _binary_spu_module_2_bin_size[];
 
 int LoadFile( const char* filename, void **ppData, uint32_t *puSize );
 
+static ModuleStreamDesc moduleList[NUM_PASSES * 2] __attribute__((aligned(128)));
+static ModuleStreamStats moduleStats[NUM_PASSES * 2] __attribute__((aligned(128)));
+static const unsigned char zeroBlock[MS_ZERO_BLOCK_SIZE] __attribute__((aligned(128))) = {0};
+
+static const char* StatusName(uint32_t status)
+{
+	switch (status)
+	{
+	case MS_STATUS_OK:				return "ok";
+	case MS_STATUS_TOO_LARGE:		return "too large";
+	case MS_STATUS_BAD_MARKERS:		return "bad markers";
+	case MS_STATUS_BAD_ENTRY:		return "bad entry";
+	case MS_STATUS_BAD_BSS:			return "bad bss";
+	default:						return "?";
+	}
+}
+
 int main(int argc, char **argv)
 {
     int ret;
@@ -90,11 +109,24 @@ int main(int argc, char **argv)
 		return -1;
 */
 
-	//Pass the address & size of each module to the spu loader via args
-	spu_args.arg1 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)_binary_spu_module_1_bin_start);
-	spu_args.arg2 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)(((size_t )_binary_spu_module_1_bin_size + 127) & ~127));
-	spu_args.arg3 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)_binary_spu_module_2_bin_start);
-	spu_args.arg4 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)(((size_t )_binary_spu_module_2_bin_size + 127) & ~127));
+	//Build the list of modules for the spu loader to stream; the modules
+	//carry an SPU GUID rather than an spu_mod_hdr, so entry is given here...
+	for (int i = 0; i < NUM_PASSES * 2; i++)
+	{
+		const char *start = (i & 1) ? _binary_spu_module_2_bin_start : _binary_spu_module_1_bin_start;
+		size_t size = (i & 1) ? (size_t)_binary_spu_module_2_bin_size : (size_t)_binary_spu_module_1_bin_size;
+
+		moduleList[i].ea = (uint32_t)start;
+		moduleList[i].size = (uint32_t)((size + 127) & ~127);
+		moduleList[i].entry = 0x10;		// + sizeof spuGUID section
+		moduleList[i].flags = 0;
+	}
+
+	//Pass the module list, a zero block for clearing BSS and somewhere for the timings via args
+	spu_args.arg1 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)moduleList);
+	spu_args.arg2 = SYS_SPU_THREAD_ARGUMENT_LET_32(NUM_PASSES * 2);
+	spu_args.arg3 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)zeroBlock);
+	spu_args.arg4 = SYS_SPU_THREAD_ARGUMENT_LET_32((unsigned int)moduleStats);
 
 	//Initialise the spu
 	ret = sys_spu_thread_initialize(&thread, group, 0, &spu_img, &thread_attr, &spu_args);
@@ -134,6 +166,14 @@ int main(int argc, char **argv)
 				fprintf(stderr, "sys_spu_thread_get_exit_status failed:%.8x\n", ret);
 			}
 			printf("Result from spu 0x%02x (via exit status) = %d\n", thread, thr_exit_status);
+
+			printf("module  status       load ticks  stall ticks  bss ticks  exec ticks  result\n");
+			for (int i = 0; i < NUM_PASSES * 2; i++)
+			{
+				const ModuleStreamStats *stats = &moduleStats[i];
+				printf("%6d  %-11s  %10u  %11u  %9u  %10u  %u\n", (i & 1) + 1, StatusName(stats->status),
+					stats->load_ticks, stats->stall_ticks, stats->bss_ticks, stats->exec_ticks, stats->result);
+			}
 		}
 		break;
 	case SYS_SPU_THREAD_GROUP_JOIN_TERMINATED: